@@ -70,6 +70,7 @@ CLANG_DIAG_ON(unknown-pragmas)
 #include "Engine/KnobFile.h"
 #include "Engine/ReadNode.h"
 #include "Engine/RenderQueue.h"
+#include "Engine/RenderTracer.h"
 #include "Engine/SerializableWindow.h"
 #include "Engine/Settings.h"
 #include "Engine/PyPanelI.h"
@@ -629,6 +630,11 @@ AppInstance::loadInternal(const CLArgs& cl,
             }
         }
 
+        // Record the timeline of the renders along with the statistics
+        if ( cl.areRenderStatsEnabled() ) {
+            RenderTracer::setEnabled(true);
+        }
+
         _imp->renderQueue->createRenderRequestsFromCommandLineArgs(cl, writersWork);
 
         ///Set reader parameters if specified from the command-line
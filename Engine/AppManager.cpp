@@ -89,6 +89,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include <QtCore/QDateTime>
 #include <QtCore/QDebug>
 #include <QtCore/QDir>
+#include <QtCore/QFile>
 #include <QtCore/QTextCodec>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QSettings>
@@ -150,6 +151,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/ViewerNode.h"
 #include "Engine/WriteNode.h"
 
+#include "Serialization/BinaryProjectSerialization.h"
 #include "Serialization/NodeSerialization.h"
 #include "Serialization/SerializationIO.h"
 
@@ -450,11 +452,77 @@ AppManager::getGILLockedCount() const
     return _imp->pythonGILRCount;
 }
 
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// A binary project file mapped in memory. The mapping is released once all nodes read from it are decoded
+class MappedBinaryProjectFile
+    : public SERIALIZATION_NAMESPACE::BinaryProjectData
+{
+    QFile _file;
+    uchar* _data;
+
+public:
+
+    explicit MappedBinaryProjectFile(const QString& filename)
+    : SERIALIZATION_NAMESPACE::BinaryProjectData()
+    , _file(filename)
+    , _data(0)
+    {
+    }
+
+    virtual ~MappedBinaryProjectFile()
+    {
+        if (_data) {
+            _file.unmap(_data);
+        }
+    }
+
+    bool map()
+    {
+        if ( !_file.open(QIODevice::ReadOnly) || (_file.size() == 0) ) {
+            return false;
+        }
+        _data = _file.map( 0, _file.size() );
+
+        return _data != 0;
+    }
+
+    virtual const char* getData() const OVERRIDE FINAL
+    {
+        return (const char*)_data;
+    }
+
+    virtual std::size_t getSize() const OVERRIDE FINAL
+    {
+        return (std::size_t)_file.size();
+    }
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
 void
 AppManager::loadProjectFromFileFunction(std::istream& ifile, const std::string& filename, const AppInstancePtr& /*app*/, SERIALIZATION_NAMESPACE::ProjectSerialization* obj)
 {
     try {
-        SERIALIZATION_NAMESPACE::read(NATRON_PROJECT_FILE_HEADER,  ifile, obj);
+        if ( SERIALIZATION_NAMESPACE::isBinaryProject(ifile) ) {
+            // Only the index of the nodes is read here: each node is decoded from the mapping
+            // when it is created in createNodeForProjectLoading()
+            boost::shared_ptr<MappedBinaryProjectFile> mappedFile( new MappedBinaryProjectFile( QString::fromUtf8( filename.c_str() ) ) );
+            SERIALIZATION_NAMESPACE::BinaryProjectDataPtr data;
+            if ( mappedFile->map() ) {
+                data = mappedFile;
+            } else {
+                FStreamsSupport::ifstream binaryFile;
+                FStreamsSupport::open(&binaryFile, filename, std::ios_base::in | std::ios_base::binary);
+                if (!binaryFile) {
+                    throw std::runtime_error( tr("Failed to open %1").arg( QString::fromUtf8( filename.c_str() ) ).toStdString() );
+                }
+                data.reset( new SERIALIZATION_NAMESPACE::BinaryProjectBuffer(binaryFile) );
+            }
+            SERIALIZATION_NAMESPACE::readBinaryProject(data, obj, true);
+        } else {
+            SERIALIZATION_NAMESPACE::read(NATRON_PROJECT_FILE_HEADER,  ifile, obj);
+        }
     } catch (SERIALIZATION_NAMESPACE::InvalidSerializationFileException& e) {
         throw std::runtime_error(tr("Failed to open %1: This file does not appear to be a %2 project file").arg(QString::fromUtf8(filename.c_str())).arg(QString::fromUtf8(NATRON_APPLICATION_NAME)).toStdString());
     }
@@ -695,6 +763,7 @@ AppManager::~AppManager()
 
     ///Caches may have launched some threads to delete images, wait for them to be done
     QThreadPool::globalInstance()->waitForDone();
+    _imp->renderThreadPool->waitForDone();
 
     tearDownPython();
     _imp->tearDownGL();
@@ -977,6 +1046,9 @@ AppManager::loadInternal(const CLArgs& cl)
 
 
     _imp->tileCache->setMaximumCacheSize(_imp->_settings->getTileCacheSize());
+    _imp->tileCache->setMaximumCompressedTilesSize(_imp->_settings->getCompressedTileCacheSize());
+    _imp->tileCache->setEvictionPolicy(_imp->_settings->getCacheEvictionPolicy());
+    _imp->tileCache->setTileStorageMemoryHints(_imp->_settings->isCacheHugePagesEnabled(), _imp->_settings->isCacheSpreadOnNUMANodesEnabled());
     _imp->generalPurposeCache->setMaximumCacheSize(_imp->_settings->getGeneralPurposeCacheSize());
 
     _imp->storageDeleteThread.reset(new StorageDeleterThread);
@@ -2547,6 +2619,8 @@ AppManager::getPluginBinary(const QString & pluginId,
 NodePtr
 AppManager::createNodeForProjectLoading(const SERIALIZATION_NAMESPACE::NodeSerializationPtr& serialization, const NodeCollectionPtr& group)
 {
+    // Nodes read from a binary project are decoded when they are created
+    serialization->decodeIfNeeded();
 
     NodePtr retNode = group->getNodeByName(serialization->_nodeScriptName);
 
@@ -2679,6 +2753,12 @@ AppManager::getTasksQueueManager() const
     return _imp->tasksQueueManager;
 }
 
+WorkStealingThreadPool*
+AppManager::getRenderThreadPool() const
+{
+    return _imp->renderThreadPool.get();
+}
+
 bool
 AppManager::isAggressiveCachingEnabled() const
 {
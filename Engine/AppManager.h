@@ -500,6 +500,12 @@ public:
 
     TreeRenderQueueManagerPtr getTasksQueueManager() const;
 
+    /**
+     * @brief Returns the thread pool used to run render tasks and multi-thread suite tasks.
+     * Other asynchronous tasks still use the global QThreadPool.
+     **/
+    WorkStealingThreadPool* getRenderThreadPool() const;
+
 
 public Q_SLOTS:
 
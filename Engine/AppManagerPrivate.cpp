@@ -40,6 +40,7 @@
 #include <QtCore/QDebug>
 #include <QtCore/QProcess>
 #include <QtCore/QTemporaryFile>
+#include <QtCore/QThread>
 #include <QtCore/QCoreApplication>
 #include <QtNetwork/QLocalServer>
 #include <QtNetwork/QLocalSocket>
@@ -118,9 +119,13 @@ AppManagerPrivate::AppManagerPrivate()
     , renderingContextPool()
     , openGLRenderers()
     , tasksQueueManager()
+    , renderThreadPool()
 {
     setMaxCacheFiles();
     tasksQueueManager.reset(new TreeRenderQueueManager);
+
+    // The max thread count is set by the settings
+    renderThreadPool.reset( new WorkStealingThreadPool( QThread::idealThreadCount() ) );
 }
 
 AppManagerPrivate::~AppManagerPrivate()
@@ -55,6 +55,7 @@ CLANG_DIAG_ON(uninitialized)
 #include "Engine/Image.h"
 #include "Engine/GPUContextPool.h"
 #include "Engine/GenericSchedulerThreadWatcher.h"
+#include "Engine/ThreadPool.h"
 #include "Engine/TreeRenderQueueManager.h"
 #include "Engine/TLSHolder.h"
 
@@ -207,6 +208,9 @@ public:
     // The application global manager that schedules render and maximizes CPU utilization
     TreeRenderQueueManagerPtr tasksQueueManager;
 
+    // The threads running render tasks and multi-thread suite tasks
+    boost::scoped_ptr<WorkStealingThreadPool> renderThreadPool;
+
 public:
     AppManagerPrivate();
 
@@ -341,6 +341,9 @@ CLArgs::printUsage(const std::string& programName)
         "     each frame in form of a file located next to the image produced by\n"
         "     the Writer node, with the same name and a -stats.txt extension. The\n"
         "     breakdown contains informations about each nodes, render times etc...\n"
+        "     A timeline of the tasks run by each thread during the render is also\n"
+        "     written with a -trace.json extension, in the Chrome trace event format\n"
+        "     that can be opened in chrome://tracing or https://ui.perfetto.dev.\n"
         "     This option is useful for debugging purposes or to control that a render\n"
         "     is working correctly.\n"
         "     **Please note** that it does not work when writing video files."
@@ -25,9 +25,11 @@
 #include "Cache.h"
 
 #include <cassert>
+#include <cstring>
 #include <stdexcept>
 #include <set>
 #include <list>
+#include <map>
 
 #ifdef __NATRON_UNIX__
 #include <time.h>
@@ -65,6 +67,9 @@ GCC_DIAG_OFF(unused-parameter)
 #include <boost/thread/shared_mutex.hpp> // local r-w mutex
 #include <boost/thread/locks.hpp>
 #include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp> // tiles compression thread
+#include <boost/bind.hpp>
+#include <boost/thread/tss.hpp> // thread local free tiles
 
 #include <boost/lexical_cast.hpp> // to convert uuid to string
 #include <boost/uuid/uuid_io.hpp>
@@ -83,6 +88,8 @@ GCC_DIAG_ON(unused-parameter)
 #include "Global/QtCompat.h"
 
 #include "Engine/AppManager.h"
+#include "Engine/CacheEvictionPolicy.h"
+#include "Engine/CompressedTilesStorage.h"
 #include "Engine/StorageDeleterThread.h"
 #include "Global/FStreamsSupport.h"
 #include "Engine/EffectInstanceActionResults.h"
@@ -94,6 +101,7 @@ GCC_DIAG_ON(unused-parameter)
 #include "Engine/Settings.h"
 #include "Engine/StandardPaths.h"
 #include "Engine/RamBuffer.h"
+#include "Engine/RenderTracer.h"
 #include "Engine/Timer.h"
 #include "Engine/ThreadPool.h"
 #include "Engine/TreeRenderQueueManager.h"
@@ -113,7 +121,10 @@ NATRON_NAMESPACE_ENTER
 #define NATRON_CACHE_BUCKET_TOC_FILE_GROW_N_BYTES 524288 // = 512 * 1024
 
 // If we change the MemorySegmentEntryHeader struct, we must increment this version so we do not attempt to read an invalid structure.
-#define NATRON_MEMORY_SEGMENT_ENTRY_HEADER_VERSION 4
+// The entries are indexed by their hash, so the version also encodes the Hash64 algorithm: a cache written with a
+// different hash function is wiped when opened.
+#define NATRON_MEMORY_SEGMENT_ENTRY_HEADER_STRUCT_VERSION 5
+#define NATRON_MEMORY_SEGMENT_ENTRY_HEADER_VERSION ( (NATRON_MEMORY_SEGMENT_ENTRY_HEADER_STRUCT_VERSION << 8) | NATRON_HASH64_ALGORITHM_VERSION )
 
 // After this amount of milliseconds, if a thread is not able to access a mutex, the cache is assumed to be inconsistent
 #define NATRON_CACHE_INTERPROCESS_MUTEX_TIMEOUT_MS 10000
@@ -123,6 +134,49 @@ NATRON_NAMESPACE_ENTER
 #define NATRON_NUM_TILES_PER_FILE (NATRON_NUM_TILES_PER_BUCKET_FILE * NATRON_CACHE_BUCKETS_COUNT)
 #define NATRON_TILE_STORAGE_FILE_SIZE (NATRON_TILE_SIZE_BYTES * NATRON_NUM_TILES_PER_FILE)
 
+// When defined, each thread allocating tiles keeps its own stack of free tiles, refilled in batches of
+// NATRON_CACHE_THREAD_LOCAL_TILES_BATCH_SIZE tiles from the bucket free tiles lists. Tiles released by this thread
+// go back to its stack as long as it holds less than NATRON_CACHE_THREAD_LOCAL_TILES_MAX_COUNT tiles, the others
+// go back to their bucket.
+// This way retrieveAndLockTiles and unLockTiles lock a bucket once per batch of tiles instead of once per tile.
+// The free tiles held by threads are not counted as free by the buckets: the maximum count is kept small so that the
+// cache does not create new tile storage files whilst threads hold free tiles, and so that few tiles are missing from
+// the free tiles lists of a persistent cache if the process crashes before they are given back to their bucket, which
+// happens when the thread exits or when the cache is destroyed.
+#define NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+#define NATRON_CACHE_THREAD_LOCAL_TILES_BATCH_SIZE 16
+#define NATRON_CACHE_THREAD_LOCAL_TILES_MAX_COUNT 32
+
+// Free tiles held by a thread are invisible to other processes, which is not suitable when the free tiles lists are shared
+// by multiple processes. In centralized mode the single free tiles list is locked only once per call anyway.
+#if defined(NATRON_CACHE_INTERPROCESS_ROBUST) || defined(NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED)
+#undef NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+#endif
+
+// When defined, tiles of entries evicted from the persistent cache are compressed to a second tier on disk
+// (see CompressedTilesStorage) from which they can be restored with restoreCompressedTiles.
+// Tiles are identified by their TileHash which is only known when not in centralized mode, and the
+// tier is local to the process, hence it cannot be used when the cache is shared by multiple processes.
+// Tiles are compressed by a separate thread: the thread evicting entries only copies them, as long as less than
+// NATRON_CACHE_COMPRESSION_QUEUE_MAX_BYTES are waiting to be compressed. Tiles beyond that are not compressed.
+#define NATRON_CACHE_COMPRESSED_TILES_TIER
+#define NATRON_CACHE_COMPRESSION_QUEUE_MAX_BYTES (64 * 1024 * 1024)
+#if defined(NATRON_CACHE_INTERPROCESS_ROBUST) || defined(NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED)
+#undef NATRON_CACHE_COMPRESSED_TILES_TIER
+#endif
+
+// When defined, the entries to evict are selected by a CacheEvictionPolicy which tracks all the entries of the cache,
+// instead of comparing the LRU entry of each bucket. Accesses to entries are buffered in their bucket and reported to the
+// policy in batches of NATRON_CACHE_EVICTION_POLICY_ACCESS_BATCH_SIZE so that get() does not contend on the policy mutex.
+// Accesses are only reported synchronously if the policy is busy for more than NATRON_CACHE_EVICTION_POLICY_MAX_PENDING_ACCESSES accesses.
+// The policy is local to the process, hence it cannot be used when the cache is shared by multiple processes.
+#define NATRON_CACHE_EVICTION_POLICY
+#define NATRON_CACHE_EVICTION_POLICY_ACCESS_BATCH_SIZE 64
+#define NATRON_CACHE_EVICTION_POLICY_MAX_PENDING_ACCESSES 1024
+#ifdef NATRON_CACHE_INTERPROCESS_ROBUST
+#undef NATRON_CACHE_EVICTION_POLICY
+#endif
+
 
 #ifdef DEBUG
 // When defined, tiles memory chunk are initialized to NaN by default and also checked against NaN
@@ -666,6 +720,33 @@ inline bool operator==(const TileInternalIndex& lhs, const TileInternalIndex& rh
 //typedef boost::interprocess::set<TileInternalIndex, TileInternalIndexCompareLess, TileInternalIndexAllocator> TileInternalIndexSet;
 typedef boost::interprocess::list<TileInternalIndex, TileInternalIndexAllocator> TileInternalIndexList;
 
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+/**
+ * @brief What is needed to compress a tile to the compressed tiles storage once its entry is evicted.
+ **/
+struct CompressedTileInfo
+{
+    // The hash with which the tile was allocated
+    TileHash hash;
+
+    // The size in bytes of a pixel component of the tile, @see CacheEntryBase::getTilesElementSize
+    int elementSize;
+};
+
+typedef std::map<TileInternalIndex, CompressedTileInfo, TileInternalIndexCompareLess> CompressedTileInfoMap;
+
+/**
+ * @brief A copy of the tiles of an evicted entry so that they can be compressed once the cache is unlocked.
+ **/
+struct TilesToCompress
+{
+    std::vector<CompressedTileInfo> tiles;
+
+    // The content of the tiles, NATRON_TILE_SIZE_BYTES for each tile
+    std::vector<char> data;
+};
+#endif
+
 /**
  * @brief Unique identifier for a process mapped to the Cache
  **/
@@ -896,6 +977,22 @@ int getBucketStorageIndex(U64 hash)
 
 
 
+#ifdef NATRON_CACHE_EVICTION_POLICY
+/**
+ * @brief An access to a cache entry that was not yet reported to the eviction policy
+ **/
+struct CacheEntryAccess
+{
+    U64 hash;
+
+    // Size of the entry including its tiles
+    std::size_t size;
+
+    // Time of the access in seconds since the cache creation
+    double time;
+};
+#endif
+
 /**
  * @brief All IPC data that are shared accross processes for this bucket. This object lives in the ToC memory mapped file.
  **/
@@ -997,12 +1094,26 @@ struct CacheBucket
     // as long as tocFile is mapped
     IPCData *ipc;
 
+#ifdef NATRON_CACHE_EVICTION_POLICY
+    // Accesses to the entries of this bucket not yet reported to the eviction policy.
+    // Protected by the bucket lruListMutex
+    std::vector<CacheEntryAccess> pendingAccesses;
+#endif
+
+    // Number of times this process locked the free tiles list of this bucket, @see CacheTierStats.
+    // Protected by the bucket mutex
+    U64 nFreeTilesListAccesses;
+
     CacheBucket()
     : cache()
     , tocFileManager()
     , bucketIndex(-1)
     , tocFile()
     , ipc(0)
+#ifdef NATRON_CACHE_EVICTION_POLICY
+    , pendingAccesses()
+#endif
+    , nFreeTilesListAccesses(0)
     {
 
     }
@@ -1300,6 +1411,69 @@ struct MappedProcessData
 };
 
 
+#ifdef NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+template <bool persistent>
+struct ThreadLocalFreeTilesRegistry;
+
+/**
+ * @brief Free tiles owned by a thread, @see NATRON_CACHE_THREAD_LOCAL_FREE_TILES.
+ * Only the owning thread accesses the tiles, except when the thread exits or when the cache is destroyed.
+ * This lives in process memory.
+ **/
+template <bool persistent>
+struct ThreadLocalFreeTiles
+{
+    // Tiles that were removed from their bucket free tiles list. They are popped from the back.
+    std::vector<TileInternalIndex> tiles;
+
+    // The value of CachePrivate::tilesStorageGeneration when the tiles were obtained. If it is different,
+    // the tiles storage was wiped in the meantime and the tiles are no longer valid.
+    U64 generation;
+
+    // The registry of the cache which created this object
+    boost::shared_ptr<ThreadLocalFreeTilesRegistry<persistent> > registry;
+
+    ThreadLocalFreeTiles()
+    : tiles()
+    , generation(0)
+    , registry()
+    {
+
+    }
+};
+
+/**
+ * @brief Shared between the cache and each ThreadLocalFreeTiles so that tiles held by a thread are given back to their
+ * bucket either when the thread exits or when the cache is destroyed, whichever comes first.
+ **/
+template <bool persistent>
+struct ThreadLocalFreeTilesRegistry
+{
+    // Protects all members
+    boost::mutex lock;
+
+    // The cache, set to NULL when the cache is destroyed
+    CachePrivate<persistent>* cache;
+
+    // All objects created by the cache which are still alive
+    std::set<ThreadLocalFreeTiles<persistent>*> threadsFreeTiles;
+
+    ThreadLocalFreeTilesRegistry(CachePrivate<persistent>* cache)
+    : lock()
+    , cache(cache)
+    , threadsFreeTiles()
+    {
+
+    }
+};
+
+template <bool persistent>
+static void onThreadLocalFreeTilesDestroyed(ThreadLocalFreeTiles<persistent>* threadTiles);
+#endif // NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+
+template <bool persistent>
+struct CacheTilesLockImpl;
+
 template <bool persistent>
 struct CachePrivate
 {
@@ -1388,6 +1562,73 @@ struct CachePrivate
 
     bool useTileStorage;
 
+    // Incremented each time the tiles storage is wiped.
+    // Protected by tilesStorageMutex
+    U64 tilesStorageGeneration;
+
+    // @see setTileStorageMemoryHints. Protected by tilesStorageMutex
+    bool tilesStorageUseHugePages;
+    bool tilesStorageSpreadOnNUMANodes;
+
+    // The number of NUMA nodes the tile storage is spread on, 1 if tilesStorageSpreadOnNUMANodes is false.
+    // Protected by tilesStorageMutex
+    int tilesStorageNUMANodesCount;
+
+    // If false, tiles are always allocated from and released to their bucket.
+    // This is only used to compare both strategies, @see setThreadLocalFreeTilesEnabled
+    bool useThreadLocalFreeTiles;
+
+#ifdef NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+    boost::shared_ptr<ThreadLocalFreeTilesRegistry<persistent> > threadLocalFreeTilesRegistry;
+
+    // The free tiles of the calling thread
+    boost::thread_specific_ptr<ThreadLocalFreeTiles<persistent> > threadLocalFreeTiles;
+#endif
+
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+    // Tiles of evicted entries are compressed in this storage. Only valid for a persistent cache.
+    boost::scoped_ptr<CompressedTilesStorage> compressedTiles;
+
+    // Protects entriesWithLockedTiles
+    boost::mutex compressedTilesMutex;
+
+    // For each bucket, the tiles of the entries of the bucket that were allocated while the compressed tiles storage
+    // was enabled, to identify them in the compressed tiles storage once their entry is evicted.
+    // Each map is protected by the bucketMutex of its bucket and is only accessed with the tilesStorageMutex taken:
+    // taking the tilesStorageMutex in write mode protects all of them.
+    CompressedTileInfoMap bucketsTilesInfo[NATRON_CACHE_BUCKETS_COUNT];
+
+    // Entries for which tiles were allocated in retrieveAndLockTiles but not yet unlocked:
+    // the tiles content is not written yet so they must not be compressed if the entry gets evicted.
+    std::multiset<U64> entriesWithLockedTiles;
+
+    // Tiles of evicted entries waiting to be compressed by compressionThread, @see queueTilesToCompress.
+    // The size includes the tiles being compressed. Protected by tilesToCompressMutex
+    boost::mutex tilesToCompressMutex;
+    boost::condition_variable tilesToCompressCond;
+    std::list<boost::shared_ptr<TilesToCompress> > tilesToCompressQueue;
+    std::size_t tilesToCompressQueueBytes;
+    bool compressionThreadMustQuit;
+
+    // Started the first time tiles are queued
+    boost::scoped_ptr<boost::thread> compressionThread;
+#endif
+
+    // Tiles found in the cache (hits) and allocated (misses) for the uncompressed tiles tier
+    // and tiles restored (hits) or not available (misses) for the compressed tiles tier.
+    // Protected by tierStatsMutex
+    boost::mutex tierStatsMutex;
+    U64 tilesHits, tilesMisses, compressedTilesHits, compressedTilesMisses;
+
+#ifdef NATRON_CACHE_EVICTION_POLICY
+    // Selects the entries to evict in evictLRUEntries. Protected by evictionPolicyMutex
+    boost::mutex evictionPolicyMutex;
+    CacheEvictionPolicyPtr evictionPolicy;
+
+    // Accesses are reported to the policy in seconds elapsed since this timestamp
+    TimestampVal creationTimestamp;
+#endif
+
     CachePrivate(Cache<persistent>* publicInterface, bool enableTileStorage)
     : _publicInterface(publicInterface)
     , maximumSize((std::size_t)8 * 1024 * 1024 * 1024) // 8GB max by default
@@ -1411,6 +1652,37 @@ struct CachePrivate
     , nThreadsTimedOutFailed(0)
     , nThreadsTimedOutFailedCond()
     , useTileStorage(enableTileStorage)
+    , tilesStorageGeneration(0)
+    , tilesStorageUseHugePages(false)
+    , tilesStorageSpreadOnNUMANodes(false)
+    , tilesStorageNUMANodesCount(1)
+    , useThreadLocalFreeTiles(true)
+#ifdef NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+    , threadLocalFreeTilesRegistry(new ThreadLocalFreeTilesRegistry<persistent>(this))
+    , threadLocalFreeTiles(&onThreadLocalFreeTilesDestroyed<persistent>)
+#endif
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+    , compressedTiles()
+    , compressedTilesMutex()
+    , bucketsTilesInfo()
+    , entriesWithLockedTiles()
+    , tilesToCompressMutex()
+    , tilesToCompressCond()
+    , tilesToCompressQueue()
+    , tilesToCompressQueueBytes(0)
+    , compressionThreadMustQuit(false)
+    , compressionThread()
+#endif
+    , tierStatsMutex()
+    , tilesHits(0)
+    , tilesMisses(0)
+    , compressedTilesHits(0)
+    , compressedTilesMisses(0)
+#ifdef NATRON_CACHE_EVICTION_POLICY
+    , evictionPolicyMutex()
+    , evictionPolicy( CacheEvictionPolicy::create(eCacheEvictionPolicyTypeLRU) )
+    , creationTimestamp( getTimestampInSeconds() )
+#endif
     {
         boost::uuids::random_generator gen;
         sessionUUID = gen();
@@ -1418,6 +1690,27 @@ struct CachePrivate
 
     virtual ~CachePrivate()
     {
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+        // Tiles still in the queue are not compressed
+        {
+            boost::unique_lock<boost::mutex> k(tilesToCompressMutex);
+            compressionThreadMustQuit = true;
+            tilesToCompressCond.notify_all();
+        }
+        if (compressionThread) {
+            compressionThread->join();
+        }
+#endif
+#ifdef NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+        // Give back to the buckets the tiles held by all threads, otherwise they would never be
+        // free again in a persistent cache. Threads that are still alive delete their object when exiting.
+        boost::unique_lock<boost::mutex> k(threadLocalFreeTilesRegistry->lock);
+        for (typename std::set<ThreadLocalFreeTiles<persistent>*>::iterator it = threadLocalFreeTilesRegistry->threadsFreeTiles.begin(); it != threadLocalFreeTilesRegistry->threadsFreeTiles.end(); ++it) {
+            releaseThreadLocalFreeTiles(*it);
+        }
+        threadLocalFreeTilesRegistry->threadsFreeTiles.clear();
+        threadLocalFreeTilesRegistry->cache = 0;
+#endif
     }
 
 
@@ -1445,29 +1738,124 @@ struct CachePrivate
      **/
     void recoverFromInconsistentState(boost::scoped_ptr<SharedMemoryProcessLocalReadLocker<persistent> >& shmReader);
 
+#ifdef NATRON_CACHE_EVICTION_POLICY
+    /**
+     * @brief Buffers an access to the given entry in its bucket, to be reported later on to the eviction policy.
+     * The bucket lruListMutex must be taken.
+     **/
+    void recordEntryAccess(CacheBucket<persistent>* bucket, U64 hash, const MemorySegmentEntryHeader<persistent>& entry);
+
+    /**
+     * @brief Report to the eviction policy all accesses buffered in the given bucket.
+     * The bucket lruListMutex and the evictionPolicyMutex must be taken.
+     **/
+    void flushBucketEntryAccesses(CacheBucket<persistent>* bucket);
+
+    /**
+     * @brief Report to the eviction policy all accesses buffered in all buckets.
+     **/
+    void flushEntryAccesses();
+
     /**
-     * @brief Retrieves 1 tile from the tile storage. Allocates new memory mapped file backend if not enough space.
+     * @brief Adds to the eviction policy all entries of the cache with their last access time.
+     * This must be called whenever the policy is created since the persistent cache may already contain entries.
+     **/
+    void populateEvictionPolicy(boost::scoped_ptr<SharedMemoryProcessLocalReadLocker<persistent> >& shmReader);
+
+    /**
+     * @brief Returns the time in seconds passed to the eviction policy for the given timestamp.
+     **/
+    double getEvictionPolicyTime(const TimestampVal& timestamp) const
+    {
+        return getTimeElapsed(creationTimestamp, timestamp, timerFrequency);
+    }
+#endif
+
+    /**
+     * @brief Retrieves at least 1 and up to nTiles tiles from the tile storage and appends them to indices.
+     * Allocates new memory mapped file backend if not enough space.
      **/
 #ifdef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
-    TileInternalIndex getOrCreateTileStorage(boost::shared_ptr<Sharable_ReadLock>& tilesReadLock,
-                                             boost::shared_ptr<Sharable_WriteLock>& tilesWriteLock
+    void getOrCreateTileStorage(boost::shared_ptr<Sharable_ReadLock>& tilesReadLock,
+                                boost::shared_ptr<Sharable_WriteLock>& tilesWriteLock
 #ifdef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
                                ,boost::shared_ptr<Sharable_WriteLock>& bucketWriteLock,
                                boost::shared_ptr<Sharable_ReadLock>& tocReadLock,
                                boost::shared_ptr<Sharable_WriteLock>& tocWriteLock
 #endif
-    );
+                                , std::size_t nTiles,
+                                std::vector<TileInternalIndex>* indices);
 #else
-    TileInternalIndex getOrCreateTileStorage(boost::shared_ptr<Sharable_ReadLock>& tilesReadLock,
-                                             boost::shared_ptr<Sharable_WriteLock>& tilesWriteLock, int requestingBucketIndex);
+    void getOrCreateTileStorage(boost::shared_ptr<Sharable_ReadLock>& tilesReadLock,
+                                boost::shared_ptr<Sharable_WriteLock>& tilesWriteLock,
+                                int requestingBucketIndex,
+                                std::size_t nTiles,
+                                std::vector<TileInternalIndex>* indices);
+#endif
+
+    /**
+     * @brief Removes up to nTiles tiles from the free tiles list of the bucket and appends them to indices.
+     * @param keepSpareTiles If true, at most half of the free tiles of the bucket are removed so that
+     * the bucket is not drained.
+     * @returns The number of tiles appended
+     **/
+    std::size_t getFreeTilesInternal(
+#ifndef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
+                                     int requestingBucketIndex,
 #endif
+                                     std::size_t nTiles,
+                                     std::vector<TileInternalIndex>* indices,
+                                     bool keepSpareTiles = false);
 
+    /**
+     * @brief Advise the system how the given tile storage is accessed and where its memory should be allocated,
+     * according to tilesStorageUseHugePages and tilesStorageSpreadOnNUMANodes.
+     * The tilesStorageMutex must be taken.
+     **/
+    void applyTileStorageMemoryHints(const StoragePtrType& storage);
 
-    bool getFreeTileInternal(
 #ifndef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
-                             int requestingBucketIndex,
+    /**
+     * @brief Returns the buckets [*firstBucket, *endBucket) from which the calling thread allocates tiles.
+     * When the tile storage is spread on NUMA nodes and the calling thread is pinned to a node, these are the buckets
+     * whose tiles are allocated on that node, @see applyTileStorageMemoryHints. Otherwise these are all the buckets.
+     * The tilesStorageMutex must be taken.
+     **/
+    void getTilesAllocationBuckets(int* firstBucket, int* endBucket) const;
+#endif
+
+#ifdef NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+    /**
+     * @brief Returns the free tiles of the calling thread, creating them if needed.
+     * The tilesStorageMutex must be taken.
+     **/
+    ThreadLocalFreeTiles<persistent>* getThreadLocalFreeTiles();
+
+    /**
+     * @brief Refills the given thread free tiles with up to NATRON_CACHE_THREAD_LOCAL_TILES_BATCH_SIZE tiles.
+     * Tiles are taken from the buckets in [firstBucket, endBucket) which have spare free tiles, starting with
+     * requestingBucketIndex, so that a new tile storage file is only created when these buckets are short of free tiles.
+     * The tilesStorageMutex must be taken.
+     **/
+    void refillThreadLocalFreeTiles(boost::shared_ptr<Sharable_ReadLock>& tilesReadLock,
+                                    boost::shared_ptr<Sharable_WriteLock>& tilesWriteLock,
+                                    int requestingBucketIndex,
+                                    int firstBucket,
+                                    int endBucket,
+                                    ThreadLocalFreeTiles<persistent>* threadTiles);
+
+    /**
+     * @brief Gives back the given thread free tiles to their bucket free tiles list.
+     * This does not use the weak pointer to the cache held by the buckets since it is called
+     * when the cache is destroyed.
+     **/
+    void releaseThreadLocalFreeTiles(ThreadLocalFreeTiles<persistent>* threadTiles);
 #endif
-                             TileInternalIndex* index);
+
+    /**
+     * @brief Invalidates the memory of a tile that was released so that it does not get written on disk.
+     **/
+    void invalidateTileMemory(const TileInternalIndex& index);
 
     void createTileStorageInternal(
 #ifdef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
@@ -1510,6 +1898,42 @@ struct CachePrivate
      **/
     void reOpenTileStorage();
 
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+    bool isCompressedTilesTierEnabled() const
+    {
+        return compressedTiles && compressedTiles->isEnabled();
+    }
+
+    /**
+     * @brief Copies the tiles of the given entry before the entry gets deallocated, so that they can be compressed
+     * once queued with queueTilesToCompress(). Tiles are not copied if NATRON_CACHE_COMPRESSION_QUEUE_MAX_BYTES are
+     * already waiting to be compressed.
+     * The tilesStorageMutex must be taken as well as the entry bucket mutex.
+     **/
+    void copyEntryTilesToCompress(U64 entryHash, int bucketIndex, const EntryType& cacheEntry, TilesToCompress* tilesToCompress);
+
+    /**
+     * @brief Moves the given tiles to the queue of the compression thread, starting it if needed.
+     **/
+    void queueTilesToCompress(TilesToCompress* tilesToCompress);
+
+    /**
+     * @brief Removes the tiles that are waiting to be compressed.
+     **/
+    void clearTilesToCompress();
+
+    /**
+     * @brief The compression thread function: compresses the queued tiles to the compressed tiles storage until
+     * compressionThreadMustQuit is set. No lock of the cache is taken.
+     **/
+    void runTilesCompression();
+
+    /**
+     * @brief Indicates that the tiles allocated in the call to retrieveAndLockTiles that created tilesLock may now be compressed.
+     **/
+    void unregisterLockedTiles(CacheTilesLockImpl<persistent>* tilesLock);
+#endif
+
     bool isUUIDCurrentlyActive(const boost::uuids::uuid& tag) const;
 
 };
@@ -2073,6 +2497,10 @@ CacheBucket<persistent>::readFromSharedMemoryEntryImpl(EntryType* cacheEntry,
 
         // Update the entry access timestamp
         cacheEntry->timestamp = getTimestampInSeconds();
+
+#ifdef NATRON_CACHE_EVICTION_POLICY
+        c->_imp->recordEntryAccess(this, hash, *cacheEntry);
+#endif
     } // lruWriteLock
 
     return eShmEntryReadRetCodeOk;
@@ -2089,7 +2517,7 @@ inline char* getTileIndexPointer(char* basePtr, const TileInternalIndex& index)
 }
 
 TileHash
-CacheBase::makeTileCacheIndex(int tx, int ty, unsigned int mipMapLevel, int channelIndex, U64 entryHash)
+CacheBase::makeTileCacheIndex(int tx, int ty, unsigned int mipMapLevel, int channelIndex, U64 entryHash, bool draft)
 {
     TileHash ret;
     Hash64 hash;
@@ -2098,6 +2526,10 @@ CacheBase::makeTileCacheIndex(int tx, int ty, unsigned int mipMapLevel, int chan
     hash.append(mipMapLevel);
     hash.append(tx);
     hash.append(ty);
+    if (draft) {
+        // Draft tiles must never be mistaken for full quality tiles
+        hash.append( (U64)1 );
+    }
     hash.computeHash();
     ret.index = hash.value();
     return ret;
@@ -2168,6 +2600,11 @@ CacheBucket<persistent>::deallocateCacheEntryImpl(typename EntriesMap::iterator
 
         // Remove this entry's node from the list
         disconnectLinkedListNode(&cacheEntryIt->second->lruNode);
+
+#ifdef NATRON_CACHE_EVICTION_POLICY
+        boost::unique_lock<boost::mutex> policyLock(c->_imp->evictionPolicyMutex);
+        c->_imp->evictionPolicy->removeEntry(cacheEntryIt->first);
+#endif
     }
     try {
         tocFileManager->destroy_ptr<EntryType>(cacheEntryIt->second.get());
@@ -2777,6 +3214,13 @@ CacheEntryLockerPrivate<persistent>::insertInternal()
         // Update the entry access timestamp
         cacheEntryIt->second->timestamp = getTimestampInSeconds();
 
+#ifdef NATRON_CACHE_EVICTION_POLICY
+        {
+            boost::unique_lock<boost::mutex> policyLock(cache->_imp->evictionPolicyMutex);
+            cache->_imp->evictionPolicy->insertEntry(hash, cacheEntryIt->second->size, cache->_imp->getEvictionPolicyTime(cacheEntryIt->second->timestamp));
+        }
+#endif
+
     } // lruWriteLock
     cacheEntryIt->second->computeThreadMagic = 0;
     cacheEntryIt->second->status = MemorySegmentEntryHeaderBase::eEntryStatusReady;
@@ -2867,6 +3311,8 @@ CacheEntryLocker<persistent>::waitForPendingEntry(std::size_t timeout)
     assert(_imp->status == eCacheEntryStatusComputationPending);
     assert(_imp->processLocalEntry);
 
+    NATRON_RENDER_TRACE_SCOPE("cache", "Wait for pending entry");
+
     // If this thread is a threadpool thread, it may wait for a while that results gets available.
     // Release the thread to the thread pool so that it may use this thread for other runnables
     // and reserve it back when done waiting.
@@ -2891,6 +3337,7 @@ CacheEntryLocker<persistent>::waitForPendingEntry(std::size_t timeout)
     // Instead we chose a "polling" method: we lookup the entry every X ms: this has the advantage not to retain any cache mutex
     // so the amount of time we wait is really just imparing this thead rather than the whole cache bucket.
 
+    TimeLapse waitTimer;
     std::size_t timeSpentWaitingForPendingEntryMS = 0;
     std::size_t timeToWaitMS = 20;
 
@@ -2900,14 +3347,18 @@ CacheEntryLocker<persistent>::waitForPendingEntry(std::size_t timeout)
 
         if (_imp->status == eCacheEntryStatusComputationPending) {
 
-            timeSpentWaitingForPendingEntryMS += timeToWaitMS;
             if (timeout == 0 || timeSpentWaitingForPendingEntryMS < timeout) {
-                CacheEntryLockerBase::sleep_milliseconds(timeToWaitMS);
-
-                // Increase the time to wait at the next iteration
-                timeToWaitMS *= 1.2;
+                // Rather than sleeping, run a task that may not block, if any
+                if ( !appPTR->getRenderThreadPool()->runPendingTaskWhileWaiting() ) {
+                    CacheEntryLockerBase::sleep_milliseconds(timeToWaitMS);
 
+                    // Increase the time to wait at the next iteration
+                    timeToWaitMS *= 1.2;
+                }
             }
+
+            // A task may run for much longer than a sleep: measure the time spent rather than counting it
+            timeSpentWaitingForPendingEntryMS = (std::size_t)(waitTimer.getTimeSinceCreation() * 1000.);
         }
 
     } while(_imp->status == eCacheEntryStatusComputationPending);
@@ -3077,6 +3528,11 @@ Cache<persistent>::initialize(const boost::shared_ptr<Cache<persistent> >& thisS
         }
         std::string fileLockFilename = cacheDir + "Lock";
 
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+        // Disabled until setMaximumCompressedTilesSize is called
+        _imp->compressedTiles.reset( new CompressedTilesStorage(cacheDir + "CompressedTiles") );
+#endif
+
         // Ensure the file lock file exists in read/write mode
         {
             _imp->fileLockFile.reset(new FStreamsSupport::ofstream);
@@ -3306,8 +3762,11 @@ Cache<persistent>::initialize(const boost::shared_ptr<Cache<persistent> >& thisS
             clear();
         }
     } // persistent
-    
-    
+
+#ifdef NATRON_CACHE_EVICTION_POLICY
+    // The persistent cache may already contain entries from a previous session
+    _imp->populateEvictionPolicy(shmReader);
+#endif
 
 } // initialize
 
@@ -3336,8 +3795,13 @@ struct CacheTilesLockImpl
     // List of allocated tiles
     std::vector<TileInternalIndex> allocatedTiles;
 
+    // True if entryHash was added to the entries with locked tiles, @see CachePrivate::entriesWithLockedTiles
+    bool hasRegisteredLockedTiles;
+
     CacheTilesLockImpl()
     : entryHash(0)
+    , allocatedTiles()
+    , hasRegisteredLockedTiles(false)
     {
 
     }
@@ -3375,6 +3839,7 @@ CachePrivate<persistent>::createTileStorageInternal(
             openStorage(data, ss.str(), (int)MemoryFile::eFileOpenModeOpenOrCreate);
         }
         resizeStorage(data, NATRON_TILE_STORAGE_FILE_SIZE);
+        applyTileStorageMemoryHints(data);
 
         fileIndex = tilesStorage.size();
         tilesStorage.push_back(data);
@@ -3496,12 +3961,14 @@ CachePrivate<persistent>::createTileStorageInternal(
 } // createTileStorageInternal
 
 template <bool persistent>
-bool
-CachePrivate<persistent>::getFreeTileInternal(
+std::size_t
+CachePrivate<persistent>::getFreeTilesInternal(
 #ifndef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
-                                              int requestingBucketIndex,
+                                               int requestingBucketIndex,
 #endif
-                                              TileInternalIndex* index)
+                                               std::size_t nTiles,
+                                               std::vector<TileInternalIndex>* indices,
+                                               bool keepSpareTiles)
 {
 #ifdef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
     CacheBucket<persistent>& bucket = buckets[0];
@@ -3521,7 +3988,14 @@ CachePrivate<persistent>::getFreeTileInternal(
 
 #endif
 
-    if (!bucket.ipc->freeTiles->empty()) {
+    ++bucket.nFreeTilesListAccesses;
+
+    if (keepSpareTiles) {
+        nTiles = std::min(nTiles, (std::size_t)bucket.ipc->freeTiles->size() / 2);
+    }
+
+    std::size_t nFound = 0;
+    while (nFound < nTiles && !bucket.ipc->freeTiles->empty()) {
         TileInternalIndex freeTileEncodedIndex;
         {
             TileInternalIndexImplList::iterator freeTileIt = bucket.ipc->freeTiles->begin();
@@ -3533,38 +4007,43 @@ CachePrivate<persistent>::getFreeTileInternal(
             qDebug() << "Bucket" << (int)requestingBucketIndex << "allocating tile index" << (int)freeTileEncodedIndex.index.tileIndex << "from file index" << (int)freeTileEncodedIndex.index.fileIndex << " Nb free tiles left in bucket:" << bucket.ipc->freeTiles->size();
 #endif
         }
-        *index = freeTileEncodedIndex;
-        return true;
+        indices->push_back(freeTileEncodedIndex);
+        ++nFound;
     }
-    return false;
-}
+    return nFound;
+} // getFreeTilesInternal
 
 template <bool persistent>
-TileInternalIndex
+void
 #ifdef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
 CachePrivate<persistent>::getOrCreateTileStorage(boost::shared_ptr<Sharable_WriteLock>& bucketWriteLock,
                                                  boost::shared_ptr<Sharable_ReadLock>& tocReadLock,
-                                                 boost::shared_ptr<Sharable_WriteLock>& tocWriteLock)
+                                                 boost::shared_ptr<Sharable_WriteLock>& tocWriteLock,
+                                                 std::size_t nTiles,
+                                                 std::vector<TileInternalIndex>* indices)
 #else
 CachePrivate<persistent>::getOrCreateTileStorage(boost::shared_ptr<Sharable_ReadLock>& tilesReadLock,
-                                                 boost::shared_ptr<Sharable_WriteLock>& tilesWriteLock, int requestingBucketIndex)
+                                                 boost::shared_ptr<Sharable_WriteLock>& tilesWriteLock,
+                                                 int requestingBucketIndex,
+                                                 std::size_t nTiles,
+                                                 std::vector<TileInternalIndex>* indices)
 #endif
 {
     // The tile storage mutex must be taken!
     assert(!ipc->tilesStorageMutex.try_lock());
 
     assert(useTileStorage);
+    assert(nTiles > 0);
 #ifndef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
     assert(requestingBucketIndex >= 0 && requestingBucketIndex < NATRON_CACHE_BUCKETS_COUNT);
 #endif
 
-    TileInternalIndex encodedTileIndex;
-    if (getFreeTileInternal(
+    if (getFreeTilesInternal(
 #ifndef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
-                            requestingBucketIndex,
+                             requestingBucketIndex,
 #endif
-                            &encodedTileIndex)) {
-        return encodedTileIndex;
+                             nTiles, indices)) {
+        return;
     }
 
     // If we have a read lock on the tiles storage, take a write lock now:
@@ -3575,12 +4054,12 @@ CachePrivate<persistent>::getOrCreateTileStorage(boost::shared_ptr<Sharable_Read
 
         // Now that we obtained the write lock, another thread might have created tile storage, so attempt
         // one more time to get a free tile
-        if (getFreeTileInternal(
+        if (getFreeTilesInternal(
 #ifndef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
-                                requestingBucketIndex,
+                                 requestingBucketIndex,
 #endif
-                                &encodedTileIndex)) {
-            return encodedTileIndex;
+                                 nTiles, indices)) {
+            return;
         }
     }
 
@@ -3592,16 +4071,157 @@ CachePrivate<persistent>::getOrCreateTileStorage(boost::shared_ptr<Sharable_Read
 #endif
     );
 
-    bool ok = getFreeTileInternal(
+    std::size_t nFound = getFreeTilesInternal(
 #ifndef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
-                                  requestingBucketIndex,
+                                              requestingBucketIndex,
 #endif
-                                  &encodedTileIndex);
-    assert(ok);
-    (void)ok;
-    return encodedTileIndex;
+                                              nTiles, indices);
+    assert(nFound > 0);
+    (void)nFound;
 } // createTileStorage
 
+template <bool persistent>
+void
+CachePrivate<persistent>::invalidateTileMemory(const TileInternalIndex& index)
+{
+    if (!persistent) {
+        return;
+    }
+    // Invalidate this portion of the memory mapped file so it doesn't get written on disk
+    StoragePtrType storage;
+    if (index.index.fileIndex < tilesStorage.size()) {
+        storage = tilesStorage[index.index.fileIndex];
+    }
+    if (storage) {
+        char* ptr = getTileIndexPointer((char*)storage->getData(), index);
+        flushMemory(storage, (int)MemoryFile::eFlushTypeInvalidate, ptr, NATRON_TILE_SIZE_BYTES);
+    }
+} // invalidateTileMemory
+
+#ifdef NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+template <bool persistent>
+static void
+onThreadLocalFreeTilesDestroyed(ThreadLocalFreeTiles<persistent>* threadTiles)
+{
+    // Called when the owning thread exits or when the thread_specific_ptr is reset.
+    // Hold a reference to the registry since the cache may be destroyed already.
+    boost::shared_ptr<ThreadLocalFreeTilesRegistry<persistent> > registry = threadTiles->registry;
+    {
+        boost::unique_lock<boost::mutex> k(registry->lock);
+        if (registry->cache) {
+            registry->cache->releaseThreadLocalFreeTiles(threadTiles);
+        }
+        registry->threadsFreeTiles.erase(threadTiles);
+    }
+    delete threadTiles;
+} // onThreadLocalFreeTilesDestroyed
+
+template <bool persistent>
+ThreadLocalFreeTiles<persistent>*
+CachePrivate<persistent>::getThreadLocalFreeTiles()
+{
+    // The tile storage mutex must be taken!
+    assert(!ipc->tilesStorageMutex.try_lock());
+
+    ThreadLocalFreeTiles<persistent>* threadTiles = threadLocalFreeTiles.get();
+
+    // The thread_specific_ptr is identified by its address: the object may have been created by a previous cache
+    // which lived at the same address. In this case, reset() will delete it.
+    if (!threadTiles || threadTiles->registry != threadLocalFreeTilesRegistry) {
+        threadTiles = new ThreadLocalFreeTiles<persistent>;
+        threadTiles->registry = threadLocalFreeTilesRegistry;
+        threadTiles->generation = tilesStorageGeneration;
+        {
+            boost::unique_lock<boost::mutex> k(threadLocalFreeTilesRegistry->lock);
+            threadLocalFreeTilesRegistry->threadsFreeTiles.insert(threadTiles);
+        }
+        threadLocalFreeTiles.reset(threadTiles);
+    } else if (threadTiles->generation != tilesStorageGeneration) {
+        // The tiles storage was wiped, these indices do no longer exist
+        threadTiles->tiles.clear();
+        threadTiles->generation = tilesStorageGeneration;
+    }
+    return threadTiles;
+} // getThreadLocalFreeTiles
+
+template <bool persistent>
+void
+CachePrivate<persistent>::refillThreadLocalFreeTiles(boost::shared_ptr<Sharable_ReadLock>& tilesReadLock,
+                                                     boost::shared_ptr<Sharable_WriteLock>& tilesWriteLock,
+                                                     int requestingBucketIndex,
+                                                     int firstBucket,
+                                                     int endBucket,
+                                                     ThreadLocalFreeTiles<persistent>* threadTiles)
+{
+    // The tile storage mutex must be taken!
+    assert(!ipc->tilesStorageMutex.try_lock());
+    assert(requestingBucketIndex >= firstBucket && requestingBucketIndex < endBucket);
+
+    // Do not drain a single bucket: this would create a new tile storage file whilst other buckets have free tiles.
+    const int nBuckets = endBucket - firstBucket;
+    std::size_t nFound = 0;
+    for (int i = 0; i < nBuckets && nFound < NATRON_CACHE_THREAD_LOCAL_TILES_BATCH_SIZE; ++i) {
+        int bucketIndex = firstBucket + (requestingBucketIndex - firstBucket + i) % nBuckets;
+        nFound += getFreeTilesInternal(bucketIndex, NATRON_CACHE_THREAD_LOCAL_TILES_BATCH_SIZE - nFound, &threadTiles->tiles, true /*keepSpareTiles*/);
+    }
+    if (nFound > 0) {
+        return;
+    }
+
+    // All buckets are short of free tiles: take the last ones or create a new tile storage file.
+    getOrCreateTileStorage(tilesReadLock, tilesWriteLock, requestingBucketIndex, NATRON_CACHE_THREAD_LOCAL_TILES_BATCH_SIZE, &threadTiles->tiles);
+} // refillThreadLocalFreeTiles
+
+template <bool persistent>
+void
+CachePrivate<persistent>::releaseThreadLocalFreeTiles(ThreadLocalFreeTiles<persistent>* threadTiles)
+{
+    if (threadTiles->tiles.empty()) {
+        return;
+    }
+    try {
+        SharedMemoryProcessLocalReadLocker<persistent> shmAccess(this);
+
+        boost::scoped_ptr<Sharable_ReadLock> tilesReadLock;
+        createLock<Sharable_ReadLock>(this, tilesReadLock, &ipc->tilesStorageMutex);
+
+        if (threadTiles->generation != tilesStorageGeneration) {
+            // The tiles storage was wiped, these indices do no longer exist
+            threadTiles->tiles.clear();
+            return;
+        }
+
+        // Sort the tiles by bucket so that each bucket is locked once
+        std::vector<TileInternalIndex>& tiles = threadTiles->tiles;
+        std::sort(tiles.begin(), tiles.end(), TileInternalIndexCompareLess());
+
+        std::size_t i = 0;
+        while (i < tiles.size()) {
+            const int bucketIndex = tiles[i].bucketIndex;
+
+            // The mapping of the ToC is valid under the read lock since only this process uses the cache.
+            boost::scoped_ptr<Sharable_ReadLock> tocReadLock;
+            createLock<Sharable_ReadLock>(this, tocReadLock, &ipc->bucketsData[bucketIndex].tocData.segmentMutex);
+
+            boost::scoped_ptr<Sharable_WriteLock> bucketWriteLock;
+            createLock<Sharable_WriteLock>(this, bucketWriteLock, &ipc->bucketsData[bucketIndex].bucketMutex);
+
+            for (; i < tiles.size() && tiles[i].bucketIndex == bucketIndex; ++i) {
+                try {
+                    buckets[bucketIndex].ipc->freeTiles->push_back(tiles[i].index);
+                } catch (const bip::bad_alloc&) {
+                    // The ToC cannot be grown here since the buckets may not reference the cache anymore:
+                    // the tile will not be available until the cache is cleared.
+                }
+            }
+        }
+    } catch (...) {
+        // Nothing to do, this is called when a thread exits or when the cache is destroyed.
+    }
+    threadTiles->tiles.clear();
+} // releaseThreadLocalFreeTiles
+#endif // NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+
 template <>
 void
 CachePrivate<false>::reOpenTileStorage() {}
@@ -3629,33 +4249,101 @@ CachePrivate<true>::reOpenTileStorage()
             if ((data)->size() != NATRON_TILE_STORAGE_FILE_SIZE) {
                 (data)->resize(NATRON_TILE_STORAGE_FILE_SIZE, false);
             }
+            applyTileStorageMemoryHints(data);
             tilesStorage.push_back(data);
         }
     }
     
 }
 
-inline int getBucketIndexForTile(TileHash tileIndex)
+/**
+ * @brief Returns the contiguous group of buckets [*firstBucket, *endBucket) whose tiles are allocated on the given
+ * node when the tile storage is spread on nNodes NUMA nodes.
+ **/
+inline void getNUMANodeBuckets(int node, int nNodes, int* firstBucket, int* endBucket)
 {
-    return CacheBase::getBucketCacheBucketIndex(tileIndex.index);
-    //(Cache::getBucketCacheBucketIndex(entryHash) + (*tilesToAlloc)[i]) % NATRON_CACHE_BUCKETS_COUNT;
+    *firstBucket = node * NATRON_CACHE_BUCKETS_COUNT / nNodes;
+    *endBucket = (node + 1) * NATRON_CACHE_BUCKETS_COUNT / nNodes;
 }
 
 template <bool persistent>
-bool
-Cache<persistent>::retrieveAndLockTiles(const CacheEntryBasePtr& entry,
-                                        const std::vector<TileInternalIndex>* tileIndices,
-#ifdef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
-                                        std::size_t nTilesToAlloc,
-#else
-                                        const std::vector<TileHash>* tilesToAlloc,
-#endif
-                                        std::vector<void*>* existingTilesData,
-                                        std::vector<std::pair<TileInternalIndex, void*> >* allocatedTilesData,
-                                        void** cacheData)
+void
+CachePrivate<persistent>::applyTileStorageMemoryHints(const StoragePtrType& storage)
 {
-    assert(_imp->useTileStorage);
-    assert(cacheData);
+    // The lock must be taken in write mode
+    assert(!ipc->tilesStorageMutex.try_lock());
+
+    char* data = storage->getData();
+    if (!data) {
+        return;
+    }
+
+    // Tiles are accessed in no particular order: reading ahead from the backing file would
+    // only waste I/O and memory.
+    MemoryFile::adviseAccessPattern(MemoryFile::eAccessPatternRandom, data, NATRON_TILE_STORAGE_FILE_SIZE);
+
+    if (tilesStorageUseHugePages) {
+        MemoryFile::adviseHugePages(data, NATRON_TILE_STORAGE_FILE_SIZE);
+    }
+
+    if (tilesStorageSpreadOnNUMANodes) {
+        // Each bucket owns NATRON_NUM_TILES_PER_BUCKET_FILE contiguous tiles in each file, @see getTileIndexPointer.
+        // Split the buckets in as many contiguous groups as there are nodes and allocate the tiles of each group
+        // on its own node. Threads then allocate tiles from the buckets of their own node, @see getTilesAllocationBuckets.
+        const int nNodes = tilesStorageNUMANodesCount;
+        if (nNodes > 1) {
+            const std::size_t bucketBytes = NATRON_NUM_TILES_PER_BUCKET_FILE * NATRON_TILE_SIZE_BYTES;
+            for (int node = 0; node < nNodes; ++node) {
+                int firstBucket, endBucket;
+                getNUMANodeBuckets(node, nNodes, &firstBucket, &endBucket);
+                MemoryFile::bindToNUMANode(node, data + firstBucket * bucketBytes, (endBucket - firstBucket) * bucketBytes);
+            }
+        }
+    }
+} // applyTileStorageMemoryHints
+
+#ifndef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
+template <bool persistent>
+void
+CachePrivate<persistent>::getTilesAllocationBuckets(int* firstBucket, int* endBucket) const
+{
+    // The tile storage mutex must be taken!
+    assert(!ipc->tilesStorageMutex.try_lock());
+
+    // Only threads pinned to a node allocate from the buckets of their node: other threads may be moved
+    // to another node at any time and allocate from all buckets depending on the tile hash.
+    const int nNodes = tilesStorageNUMANodesCount;
+    const int node = nNodes > 1 ? ProcInfo::getCurrentThreadPinnedNUMANode() : -1;
+    if ( (node < 0) || (node >= nNodes) ) {
+        *firstBucket = 0;
+        *endBucket = NATRON_CACHE_BUCKETS_COUNT;
+        return;
+    }
+    getNUMANodeBuckets(node, nNodes, firstBucket, endBucket);
+}
+#endif
+
+inline int getBucketIndexForTile(TileHash tileIndex)
+{
+    return CacheBase::getBucketCacheBucketIndex(tileIndex.index);
+    //(Cache::getBucketCacheBucketIndex(entryHash) + (*tilesToAlloc)[i]) % NATRON_CACHE_BUCKETS_COUNT;
+}
+
+template <bool persistent>
+bool
+Cache<persistent>::retrieveAndLockTiles(const CacheEntryBasePtr& entry,
+                                        const std::vector<TileInternalIndex>* tileIndices,
+#ifdef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
+                                        std::size_t nTilesToAlloc,
+#else
+                                        const std::vector<TileHash>* tilesToAlloc,
+#endif
+                                        std::vector<void*>* existingTilesData,
+                                        std::vector<std::pair<TileInternalIndex, void*> >* allocatedTilesData,
+                                        void** cacheData)
+{
+    assert(_imp->useTileStorage);
+    assert(cacheData);
     *cacheData = 0;
 
 #ifdef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
@@ -3671,6 +4359,11 @@ Cache<persistent>::retrieveAndLockTiles(const CacheEntryBasePtr& entry,
     std::size_t nTilesToAlloc = tilesToAlloc ? tilesToAlloc->size() : 0;
 #endif
 
+    {
+        boost::unique_lock<boost::mutex> k(_imp->tierStatsMutex);
+        _imp->tilesHits += tileIndices ? tileIndices->size() : 0;
+        _imp->tilesMisses += nTilesToAlloc;
+    }
 
     // Get the bucket corresponding to the hash
     // Each tile gets a different hash since all tiles of an image share the same base hash
@@ -3719,6 +4412,17 @@ Cache<persistent>::retrieveAndLockTiles(const CacheEntryBasePtr& entry,
             createLock<Sharable_WriteLock>(_imp.get(), bucketWriteLock, &_imp->ipc->bucketsData[0].bucketMutex);
 #endif
 
+#ifdef NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+            ThreadLocalFreeTiles<persistent>* threadTiles = _imp->useThreadLocalFreeTiles ? _imp->getThreadLocalFreeTiles() : 0;
+#endif
+            std::vector<TileInternalIndex> freeTileIndices;
+
+#ifndef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
+            // When the tile storage is spread on NUMA nodes, a thread pinned to a node only allocates from the buckets of its node
+            int firstBucket, endBucket;
+            _imp->getTilesAllocationBuckets(&firstBucket, &endBucket);
+#endif
+
             allocatedTilesData->resize(nTilesToAlloc);
             tilesLock->allocatedTiles.resize(nTilesToAlloc);
             for (std::size_t i = 0; i < nTilesToAlloc; ++i) {
@@ -3726,15 +4430,30 @@ Cache<persistent>::retrieveAndLockTiles(const CacheEntryBasePtr& entry,
                 // The bucket index for the tile depends on the bucket of the cache entry + a number based off the tile index so that
                 // we ensure that we distribute uniformly all tiles across buckets.
 #ifndef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
-                int bucketIndex = getBucketIndexForTile((*tilesToAlloc)[i]);
+                int bucketIndex = firstBucket + getBucketIndexForTile((*tilesToAlloc)[i]) % (endBucket - firstBucket);
 #endif
 
                 TileInternalIndex freeTileEncodedIndex;
+#ifdef NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+                if (threadTiles) {
+                    // Only lock the buckets when this thread has no free tile left. Since the first bucket used to refill
+                    // depends on the tile hash, tiles remain uniformly distributed across buckets.
+                    if (threadTiles->tiles.empty()) {
+                        _imp->refillThreadLocalFreeTiles(tilesLock->tileReadLock, tilesLock->tileWriteLock, bucketIndex, firstBucket, endBucket, threadTiles);
+                    }
+                    freeTileEncodedIndex = threadTiles->tiles.back();
+                    threadTiles->tiles.pop_back();
+                } else
+#endif
+                {
+                    freeTileIndices.clear();
 #ifdef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
-                freeTileEncodedIndex = _imp->getOrCreateTileStorage(tilesLock->tileReadLock, tilesLock->tileWriteLock, bucketWriteLock, tocReadLock, tocWriteLock);
+                    _imp->getOrCreateTileStorage(tilesLock->tileReadLock, tilesLock->tileWriteLock, bucketWriteLock, tocReadLock, tocWriteLock, 1, &freeTileIndices);
 #else
-                freeTileEncodedIndex = _imp->getOrCreateTileStorage(tilesLock->tileReadLock, tilesLock->tileWriteLock, bucketIndex);
+                    _imp->getOrCreateTileStorage(tilesLock->tileReadLock, tilesLock->tileWriteLock, bucketIndex, 1, &freeTileIndices);
 #endif
+                    freeTileEncodedIndex = freeTileIndices.front();
+                }
 
 
                 // Get the pointer to the data corresponding to the free tile index
@@ -3766,6 +4485,17 @@ Cache<persistent>::retrieveAndLockTiles(const CacheEntryBasePtr& entry,
             } // for each tile to allocate
         } // nTilesToAlloc
 
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+        // The tiles must not be compressed if the entry gets evicted before the caller wrote them.
+        // This must be done before adding the tiles to the entry.
+        const bool compressTilesOnEviction = nTilesToAlloc && _imp->isCompressedTilesTierEnabled();
+        if (compressTilesOnEviction) {
+            boost::unique_lock<boost::mutex> k(_imp->compressedTilesMutex);
+            _imp->entriesWithLockedTiles.insert(entryHash);
+            tilesLock->hasRegisteredLockedTiles = true;
+        }
+#endif
+
         // Now for each tile to allocate, add the tile cache indices to the corresponding cache entry so that when deallocating
         // the entry, we can also properly free the tiles.
         if (nTilesToAlloc) {
@@ -3811,6 +4541,25 @@ Cache<persistent>::retrieveAndLockTiles(const CacheEntryBasePtr& entry,
 
                 cacheEntry->size += nTilesToAlloc * NATRON_TILE_SIZE_BYTES;
 
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+                // Remember the hash of the tiles so that they can be compressed when the entry gets evicted.
+                // The tiles are added to the entry under the same bucket lock.
+                CompressedTileInfoMap& tilesInfo = _imp->bucketsTilesInfo[cacheEntryBucketIndex];
+                if (compressTilesOnEviction) {
+                    CompressedTileInfo info;
+                    info.elementSize = entry->getTilesElementSize();
+                    for (std::size_t i = 0; i < nTilesToAlloc; ++i) {
+                        info.hash = (*tilesToAlloc)[i];
+                        tilesInfo[(*allocatedTilesData)[i].first] = info;
+                    }
+                } else if ( !tilesInfo.empty() ) {
+                    // Do not keep the hash of a previous use of these tiles
+                    for (std::size_t i = 0; i < nTilesToAlloc; ++i) {
+                        tilesInfo.erase((*allocatedTilesData)[i].first);
+                    }
+                }
+#endif
+
 
 #ifdef CACHE_TRACE_SIZE
                 qDebug() << entryHash << "Entry += " << nTilesToAlloc * NATRON_TILE_SIZE_BYTES;
@@ -3914,6 +4663,9 @@ Cache<persistent>::retrieveAndLockTiles(const CacheEntryBasePtr& entry,
 
         // Any exception caught here means the cache is corrupted
         _imp->recoverFromInconsistentState(tilesLock->shmAccess);
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+        _imp->unregisterLockedTiles(tilesLock);
+#endif
         delete tilesLock;
         *cacheData = 0;
         return false;
@@ -4011,11 +4763,135 @@ Cache<persistent>::unLockTiles(void* cacheData, bool invalidate)
             _imp->recoverFromInconsistentState(tilesLock->shmAccess);
         }
 
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+    // The caller is done writing the tiles, they may now be compressed
+    _imp->unregisterLockedTiles(tilesLock);
+#endif
 
     delete tilesLock;
     
 } // unLockTiles
 
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+template <bool persistent>
+void
+CachePrivate<persistent>::unregisterLockedTiles(CacheTilesLockImpl<persistent>* tilesLock)
+{
+    if (!tilesLock->hasRegisteredLockedTiles) {
+        return;
+    }
+    boost::unique_lock<boost::mutex> k(compressedTilesMutex);
+    std::multiset<U64>::iterator found = entriesWithLockedTiles.find(tilesLock->entryHash);
+    assert( found != entriesWithLockedTiles.end() );
+    if ( found != entriesWithLockedTiles.end() ) {
+        entriesWithLockedTiles.erase(found);
+    }
+    tilesLock->hasRegisteredLockedTiles = false;
+}
+
+template <bool persistent>
+void
+CachePrivate<persistent>::copyEntryTilesToCompress(U64 entryHash, int bucketIndex, const EntryType& cacheEntry, TilesToCompress* tilesToCompress)
+{
+    const CompressedTileInfoMap& tilesInfo = bucketsTilesInfo[bucketIndex];
+    if ( cacheEntry.tileIndices.empty() || tilesInfo.empty() || !isCompressedTilesTierEnabled() ) {
+        return;
+    }
+
+    {
+        boost::unique_lock<boost::mutex> k(compressedTilesMutex);
+
+        // Tiles of the entry are being written by another thread
+        if ( entriesWithLockedTiles.find(entryHash) != entriesWithLockedTiles.end() ) {
+            return;
+        }
+    }
+
+    // Bound the memory and the time spent copying if the compression thread cannot keep up
+    std::size_t maxBytes = 0;
+    {
+        boost::unique_lock<boost::mutex> k(tilesToCompressMutex);
+        if (tilesToCompressQueueBytes < NATRON_CACHE_COMPRESSION_QUEUE_MAX_BYTES) {
+            maxBytes = NATRON_CACHE_COMPRESSION_QUEUE_MAX_BYTES - tilesToCompressQueueBytes;
+        }
+    }
+
+    // Copying is much faster than compressing: the locks are held for a short time only
+    for (TileInternalIndexList::const_iterator it = cacheEntry.tileIndices.begin(); it != cacheEntry.tileIndices.end(); ++it) {
+        if (tilesToCompress->data.size() + NATRON_TILE_SIZE_BYTES > maxBytes) {
+            break;
+        }
+        typename CompressedTileInfoMap::const_iterator found = tilesInfo.find(*it);
+        if ( (found == tilesInfo.end()) || (it->index.fileIndex >= tilesStorage.size()) ) {
+            continue;
+        }
+        const char* ptr = getTileIndexPointer( (char*)tilesStorage[it->index.fileIndex]->getData(), *it );
+        std::size_t offset = tilesToCompress->data.size();
+        tilesToCompress->data.resize(offset + NATRON_TILE_SIZE_BYTES);
+        std::memcpy(&tilesToCompress->data[offset], ptr, NATRON_TILE_SIZE_BYTES);
+        tilesToCompress->tiles.push_back(found->second);
+    }
+} // copyEntryTilesToCompress
+
+template <bool persistent>
+void
+CachePrivate<persistent>::queueTilesToCompress(TilesToCompress* tilesToCompress)
+{
+    boost::shared_ptr<TilesToCompress> queued(new TilesToCompress);
+    queued->tiles.swap(tilesToCompress->tiles);
+    queued->data.swap(tilesToCompress->data);
+
+    boost::unique_lock<boost::mutex> k(tilesToCompressMutex);
+    if (compressionThreadMustQuit) {
+        return;
+    }
+    tilesToCompressQueueBytes += queued->data.size();
+    tilesToCompressQueue.push_back(queued);
+    if (!compressionThread) {
+        compressionThread.reset( new boost::thread( boost::bind(&CachePrivate<persistent>::runTilesCompression, this) ) );
+    }
+    tilesToCompressCond.notify_one();
+} // queueTilesToCompress
+
+template <bool persistent>
+void
+CachePrivate<persistent>::clearTilesToCompress()
+{
+    boost::unique_lock<boost::mutex> k(tilesToCompressMutex);
+    for (std::list<boost::shared_ptr<TilesToCompress> >::iterator it = tilesToCompressQueue.begin(); it != tilesToCompressQueue.end(); ++it) {
+        tilesToCompressQueueBytes -= (*it)->data.size();
+    }
+    tilesToCompressQueue.clear();
+}
+
+template <bool persistent>
+void
+CachePrivate<persistent>::runTilesCompression()
+{
+    for (;;) {
+        boost::shared_ptr<TilesToCompress> tilesToCompress;
+        {
+            boost::unique_lock<boost::mutex> k(tilesToCompressMutex);
+            while ( tilesToCompressQueue.empty() && !compressionThreadMustQuit ) {
+                tilesToCompressCond.wait(k);
+            }
+            if (compressionThreadMustQuit) {
+                return;
+            }
+            tilesToCompress = tilesToCompressQueue.front();
+            tilesToCompressQueue.pop_front();
+        }
+
+        for (std::size_t i = 0; i < tilesToCompress->tiles.size(); ++i) {
+            compressedTiles->insertTile(tilesToCompress->tiles[i].hash.index, &tilesToCompress->data[i * NATRON_TILE_SIZE_BYTES], NATRON_TILE_SIZE_BYTES, tilesToCompress->tiles[i].elementSize);
+        }
+
+        boost::unique_lock<boost::mutex> k(tilesToCompressMutex);
+        tilesToCompressQueueBytes -= tilesToCompress->data.size();
+    }
+} // runTilesCompression
+#endif // NATRON_CACHE_COMPRESSED_TILES_TIER
+
 template <bool persistent>
 void
 CachePrivate<persistent>::releaseTilesInternal(int cacheEntryBucketIndex,
@@ -4085,6 +4961,18 @@ CachePrivate<persistent>::releaseTilesInternal(int cacheEntryBucketIndex,
         cacheEntry->tileIndices.clear();
     }
 
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+    {
+        // Protected by the entry bucket lock
+        CompressedTileInfoMap& tilesInfo = bucketsTilesInfo[cacheEntryBucketIndex];
+        if ( !tilesInfo.empty() ) {
+            for (std::size_t i = 0; i < tilesToDeallocate.size(); ++i) {
+                tilesInfo.erase(tilesToDeallocate[i]);
+            }
+        }
+    }
+#endif
+
 #ifdef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
     boost::shared_ptr<Sharable_WriteLock> bucket0WriteLock;
     boost::shared_ptr<Sharable_ReadLock> toc0ReadLock;
@@ -4098,12 +4986,34 @@ CachePrivate<persistent>::releaseTilesInternal(int cacheEntryBucketIndex,
         // Lock the bucket in write mode to edit the freeTiles list
         createLock<Sharable_WriteLock>(this, bucket0WriteLock, &ipc->bucketsData[0].bucketMutex);
     }
+    ++buckets[0].nFreeTilesListAccesses;
+#else
+    // Give back the tiles bucket by bucket, so that each bucket is locked once instead of once per tile
+    std::sort(tilesToDeallocate.begin(), tilesToDeallocate.end(), TileInternalIndexCompareLess());
+    int lockedBucketIndex = -1;
+    boost::shared_ptr<Sharable_WriteLock> bucketWriteLock;
+    boost::shared_ptr<Sharable_ReadLock> tocReadLock;
+    boost::shared_ptr<Sharable_WriteLock> tocWriteLock;
 #endif
 
     if (!tilesWriteLock && !tilesReadLock) {
         createLock<Sharable_ReadLock>(this, tilesReadLock, &ipc->tilesStorageMutex);
     }
 
+#ifdef NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+    // If this thread allocates tiles, give back the tiles to its free tiles first so we do not have to lock their bucket.
+    // Threads that only evict entries do not hold free tiles.
+    ThreadLocalFreeTiles<persistent>* threadTiles = useThreadLocalFreeTiles ? threadLocalFreeTiles.get() : 0;
+    if (threadTiles && (threadTiles->registry != threadLocalFreeTilesRegistry || threadTiles->generation != tilesStorageGeneration)) {
+        threadTiles = 0;
+    }
+    // Only keep the tiles that this thread would allocate, @see getTilesAllocationBuckets
+    int threadFirstBucket = 0, threadEndBucket = NATRON_CACHE_BUCKETS_COUNT;
+    if (threadTiles) {
+        getTilesAllocationBuckets(&threadFirstBucket, &threadEndBucket);
+    }
+#endif
+
     // Remove the given tiles, or the cache entry tiles if NULL
 
     // Some tiles may already be deallocated, we only count tiles that were
@@ -4111,6 +5021,15 @@ CachePrivate<persistent>::releaseTilesInternal(int cacheEntryBucketIndex,
     std::size_t nSuccessfulDeallocation = 0;
     for (std::size_t i = 0; i < tilesToDeallocate.size(); ++i) {
 
+#ifdef NATRON_CACHE_THREAD_LOCAL_FREE_TILES
+        if ( threadTiles && (threadTiles->tiles.size() < NATRON_CACHE_THREAD_LOCAL_TILES_MAX_COUNT) &&
+             (tilesToDeallocate[i].bucketIndex >= threadFirstBucket) && (tilesToDeallocate[i].bucketIndex < threadEndBucket) ) {
+            invalidateTileMemory(tilesToDeallocate[i]);
+            threadTiles->tiles.push_back(tilesToDeallocate[i]);
+            ++nSuccessfulDeallocation;
+            continue;
+        }
+#endif
 
 #ifdef NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
         int bucketIndex = 0;
@@ -4124,26 +5043,30 @@ CachePrivate<persistent>::releaseTilesInternal(int cacheEntryBucketIndex,
 
 #else
 
-
-        boost::shared_ptr<Sharable_WriteLock> bucketWriteLock;
-        boost::shared_ptr<Sharable_ReadLock> tocReadLock;
-        boost::shared_ptr<Sharable_WriteLock> tocWriteLock;
-
         const TileInternalIndex& internalIndex = tilesToDeallocate[i];
         CacheBucket<persistent>& tileBucket = buckets[internalIndex.bucketIndex];
 
-        // Take the bucket mutex only if it was not taken before
-        if (internalIndex.bucketIndex != cacheEntryBucketIndex) {
-            // Take the read lock on the toc file mapping
-            tileBucket.checkToCMemorySegmentStatus(&tocReadLock, &tocWriteLock);
+        if (internalIndex.bucketIndex != lockedBucketIndex) {
+            // Release the previous bucket before locking the next one
+            bucketWriteLock.reset();
+            tocReadLock.reset();
+            tocWriteLock.reset();
 
+            // Take the bucket mutex only if it was not taken before
+            if (internalIndex.bucketIndex != cacheEntryBucketIndex) {
+                // Take the read lock on the toc file mapping
+                tileBucket.checkToCMemorySegmentStatus(&tocReadLock, &tocWriteLock);
 
-            // Lock the bucket in write mode to edit the freeTiles list
-            createLock<Sharable_WriteLock>(this, bucketWriteLock, &ipc->bucketsData[internalIndex.bucketIndex].bucketMutex);
-        } else {
-            bucketWriteLock = cacheEntryBucketLock;
-            tocReadLock = cacheEntryBucketToCReadLock;
-            tocWriteLock = cacheEntryBucketToCWriteLock;
+
+                // Lock the bucket in write mode to edit the freeTiles list
+                createLock<Sharable_WriteLock>(this, bucketWriteLock, &ipc->bucketsData[internalIndex.bucketIndex].bucketMutex);
+            } else {
+                bucketWriteLock = cacheEntryBucketLock;
+                tocReadLock = cacheEntryBucketToCReadLock;
+                tocWriteLock = cacheEntryBucketToCWriteLock;
+            }
+            lockedBucketIndex = internalIndex.bucketIndex;
+            ++tileBucket.nFreeTilesListAccesses;
         }
 #endif
 
@@ -4178,19 +5101,7 @@ CachePrivate<persistent>::releaseTilesInternal(int cacheEntryBucketIndex,
             }
         }
 
-        if (persistent) {
-            // Invalidate this portion of the memory mapped file so it doesn't get written on disk
-
-            StoragePtrType storage;
-            if (internalIndex.index.fileIndex < tilesStorage.size()) {
-                storage = tilesStorage[internalIndex.index.fileIndex];
-            }
-            if (storage) {
-                char* ptr = getTileIndexPointer((char*)storage->getData(), internalIndex);
-                flushMemory(storage, (int)MemoryFile::eFlushTypeInvalidate, ptr, NATRON_TILE_SIZE_BYTES);
-            }
-
-        }
+        invalidateTileMemory(internalIndex);
     } // foreach tile to dealloc
 
     // Remove from the bucket size the tiles that we deallocated
@@ -4451,6 +5362,13 @@ Cache<persistent>::setMaximumCacheSize(std::size_t size)
     }
 }
 
+template <bool persistent>
+void
+Cache<persistent>::setThreadLocalFreeTilesEnabled(bool enabled)
+{
+    _imp->useThreadLocalFreeTiles = enabled;
+}
+
 template <bool persistent>
 std::size_t
 Cache<persistent>::getMaximumCacheSize() const
@@ -4461,6 +5379,231 @@ Cache<persistent>::getMaximumCacheSize() const
     }
 }
 
+template <bool persistent>
+void
+Cache<persistent>::setMaximumCompressedTilesSize(std::size_t size)
+{
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+    if (!_imp->compressedTiles) {
+        return;
+    }
+    // Tiles allocated from now on are not remembered in bucketsTilesInfo: the others are removed when released
+    _imp->compressedTiles->setMaximumSize(size);
+#else
+    (void)size;
+#endif
+}
+
+template <bool persistent>
+std::size_t
+Cache<persistent>::getMaximumCompressedTilesSize() const
+{
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+    if (_imp->compressedTiles) {
+        return _imp->compressedTiles->getMaximumSize();
+    }
+#endif
+    return 0;
+}
+
+template <bool persistent>
+void
+Cache<persistent>::hasCompressedTiles(const std::vector<TileHash>& tileHashes, std::vector<bool>* available) const
+{
+    available->resize(tileHashes.size());
+    std::size_t nAvailable = 0;
+    for (std::size_t i = 0; i < tileHashes.size(); ++i) {
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+        (*available)[i] = _imp->compressedTiles && _imp->compressedTiles->containsTile(tileHashes[i].index);
+#else
+        (*available)[i] = false;
+#endif
+        if ((*available)[i]) {
+            ++nAvailable;
+        }
+    }
+
+    // Available tiles are only counted as hits once restoreCompressedTiles succeeds
+    boost::unique_lock<boost::mutex> k(_imp->tierStatsMutex);
+    _imp->compressedTilesMisses += tileHashes.size() - nAvailable;
+}
+
+template <bool persistent>
+bool
+Cache<persistent>::restoreCompressedTiles(const CacheEntryBasePtr& entry,
+                                          const std::vector<TileHash>& tileHashes,
+                                          std::vector<std::pair<TileInternalIndex, void*> >* restoredTilesData,
+                                          void** cacheData)
+{
+    assert(cacheData);
+    *cacheData = 0;
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+    if ( tileHashes.empty() || !_imp->isCompressedTilesTierEnabled() ) {
+        return false;
+    }
+
+    // Allocate the tiles as if they were rendered
+    if ( !retrieveAndLockTiles(entry, 0, &tileHashes, 0, restoredTilesData, cacheData) ) {
+        if (*cacheData) {
+            unLockTiles(*cacheData, true /*invalidate*/);
+            *cacheData = 0;
+        }
+        boost::unique_lock<boost::mutex> k(_imp->tierStatsMutex);
+        _imp->compressedTilesMisses += tileHashes.size();
+        return false;
+    }
+
+    bool ok = true;
+    for (std::size_t i = 0; i < tileHashes.size(); ++i) {
+        if ( !_imp->compressedTiles->restoreTile(tileHashes[i].index, (*restoredTilesData)[i].second, NATRON_TILE_SIZE_BYTES, false) ) {
+            ok = false;
+            break;
+        }
+    }
+
+    {
+        boost::unique_lock<boost::mutex> k(_imp->tierStatsMutex);
+        if (ok) {
+            _imp->compressedTilesHits += tileHashes.size();
+        } else {
+            _imp->compressedTilesMisses += tileHashes.size();
+        }
+    }
+
+    if (!ok) {
+        // A tile was dropped from the storage in the meantime: free all tiles
+        unLockTiles(*cacheData, true /*invalidate*/);
+        *cacheData = 0;
+        restoredTilesData->clear();
+        return false;
+    }
+
+    // The tiles are back in the uncompressed tier, they will be compressed again if evicted
+    for (std::size_t i = 0; i < tileHashes.size(); ++i) {
+        _imp->compressedTiles->removeTile(tileHashes[i].index);
+    }
+    return true;
+#else
+    (void)entry;
+    (void)tileHashes;
+    (void)restoredTilesData;
+    return false;
+#endif
+} // restoreCompressedTiles
+
+template <bool persistent>
+void
+Cache<persistent>::getTilesTierStats(CacheTierStats* tilesTier, CacheTierStats* compressedTilesTier) const
+{
+    {
+        boost::unique_lock<boost::mutex> k(_imp->tierStatsMutex);
+        tilesTier->nHits = _imp->tilesHits;
+        tilesTier->nMisses = _imp->tilesMisses;
+        compressedTilesTier->nHits = _imp->compressedTilesHits;
+        compressedTilesTier->nMisses = _imp->compressedTilesMisses;
+    }
+
+    tilesTier->nBytes = tilesTier->nUncompressedBytes = getCurrentSize();
+    tilesTier->nTiles = tilesTier->nBytes / NATRON_TILE_SIZE_BYTES;
+
+    tilesTier->nFreeTilesListAccesses = 0;
+    if (_imp->useTileStorage) {
+        boost::scoped_ptr<SharedMemoryProcessLocalReadLocker<persistent> > shmReader(new SharedMemoryProcessLocalReadLocker<persistent>(_imp.get()));
+        for (int i = 0; i < NATRON_CACHE_BUCKETS_COUNT; ++i) {
+            try {
+                boost::shared_ptr<Sharable_ReadLock> tocReadLock;
+                boost::shared_ptr<Sharable_WriteLock> tocWriteLock;
+                _imp->buckets[i].checkToCMemorySegmentStatus(&tocReadLock, &tocWriteLock);
+
+                boost::scoped_ptr<Sharable_ReadLock> locker;
+                createLock<Sharable_ReadLock>(_imp.get(), locker, &_imp->ipc->bucketsData[i].bucketMutex);
+                tilesTier->nFreeTilesListAccesses += _imp->buckets[i].nFreeTilesListAccesses;
+            } catch (...) {
+                // Any exception caught here means the cache is corrupted
+                _imp->recoverFromInconsistentState(shmReader);
+                break;
+            }
+        }
+    }
+
+    compressedTilesTier->nTiles = compressedTilesTier->nBytes = compressedTilesTier->nUncompressedBytes = 0;
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+    if (_imp->compressedTiles) {
+        _imp->compressedTiles->getStats(&compressedTilesTier->nTiles, &compressedTilesTier->nBytes, &compressedTilesTier->nUncompressedBytes);
+    }
+#endif
+}
+
+template <bool persistent>
+void
+Cache<persistent>::setTileStorageMemoryHints(bool useHugePages, bool spreadOnNUMANodes)
+{
+    if (!_imp->useTileStorage) {
+        return;
+    }
+    boost::scoped_ptr<SharedMemoryProcessLocalReadLocker<persistent> > shmReader(new SharedMemoryProcessLocalReadLocker<persistent>(_imp.get()));
+
+    try {
+        boost::scoped_ptr<Sharable_WriteLock> tileWriteLock;
+        createLock<Sharable_WriteLock>(_imp.get(), tileWriteLock, &_imp->ipc->tilesStorageMutex);
+        if (_imp->tilesStorageUseHugePages == useHugePages && _imp->tilesStorageSpreadOnNUMANodes == spreadOnNUMANodes) {
+            return;
+        }
+        _imp->tilesStorageUseHugePages = useHugePages;
+        _imp->tilesStorageSpreadOnNUMANodes = spreadOnNUMANodes;
+        _imp->tilesStorageNUMANodesCount = spreadOnNUMANodes ? std::max(1, ProcInfo::getNUMANodesCount()) : 1;
+        for (std::size_t i = 0; i < _imp->tilesStorage.size(); ++i) {
+            _imp->applyTileStorageMemoryHints(_imp->tilesStorage[i]);
+        }
+    } catch (...) {
+        // The hints are only an optimization
+    }
+} // setTileStorageMemoryHints
+
+template <bool persistent>
+void
+Cache<persistent>::setEvictionPolicy(CacheEvictionPolicyTypeEnum policy)
+{
+#ifdef NATRON_CACHE_EVICTION_POLICY
+    {
+        boost::unique_lock<boost::mutex> policyLock(_imp->evictionPolicyMutex);
+        if (_imp->evictionPolicy->getType() == policy) {
+            return;
+        }
+        _imp->evictionPolicy = CacheEvictionPolicy::create(policy);
+    }
+    boost::scoped_ptr<SharedMemoryProcessLocalReadLocker<persistent> > shmReader(new SharedMemoryProcessLocalReadLocker<persistent>(_imp.get()));
+    _imp->populateEvictionPolicy(shmReader);
+#else
+    (void)policy;
+#endif
+}
+
+template <bool persistent>
+CacheEvictionPolicyTypeEnum
+Cache<persistent>::getEvictionPolicy() const
+{
+#ifdef NATRON_CACHE_EVICTION_POLICY
+    boost::unique_lock<boost::mutex> policyLock(_imp->evictionPolicyMutex);
+    return _imp->evictionPolicy->getType();
+#else
+    return eCacheEvictionPolicyTypeLRU;
+#endif
+}
+
+template <bool persistent>
+void
+Cache<persistent>::addEntryComputeCost(U64 hash, double timeSpentSeconds)
+{
+#ifdef NATRON_CACHE_EVICTION_POLICY
+    boost::unique_lock<boost::mutex> policyLock(_imp->evictionPolicyMutex);
+    _imp->evictionPolicy->addEntryCost(hash, timeSpentSeconds);
+#else
+    (void)hash;
+    (void)timeSpentSeconds;
+#endif
+}
+
 template <bool persistent>
 std::size_t
 Cache<persistent>::getCurrentSize() const
@@ -4618,6 +5761,7 @@ template <bool persistent>
 CacheEntryLockerBasePtr
 Cache<persistent>::get(const CacheEntryBasePtr& entry) const
 {
+    NATRON_RENDER_TRACE_SCOPE("cache", "Cache lookup");
     return CacheEntryLocker<persistent>::create(_imp->buckets[0].cache.lock(), entry);
 } // get
 
@@ -4719,6 +5863,105 @@ CachePrivate<persistent>::recoverFromInconsistentState(boost::scoped_ptr<SharedM
     shmAccess.reset(new SharedMemoryProcessLocalReadLocker<persistent>(this));
 } // recoverFromInconsistentState
 
+#ifdef NATRON_CACHE_EVICTION_POLICY
+template <bool persistent>
+void
+CachePrivate<persistent>::recordEntryAccess(CacheBucket<persistent>* bucket, U64 hash, const MemorySegmentEntryHeader<persistent>& entry)
+{
+    CacheEntryAccess access;
+    access.hash = hash;
+    // The size of the entry includes its tiles
+    access.size = entry.size;
+    access.time = getEvictionPolicyTime(entry.timestamp);
+    bucket->pendingAccesses.push_back(access);
+
+    if (bucket->pendingAccesses.size() < NATRON_CACHE_EVICTION_POLICY_ACCESS_BATCH_SIZE) {
+        return;
+    }
+
+    // Do not wait for the policy unless too many accesses are pending: another thread is already updating it.
+    boost::unique_lock<boost::mutex> policyLock(evictionPolicyMutex, boost::try_to_lock);
+    if ( !policyLock.owns_lock() ) {
+        if (bucket->pendingAccesses.size() < NATRON_CACHE_EVICTION_POLICY_MAX_PENDING_ACCESSES) {
+            return;
+        }
+        policyLock.lock();
+    }
+    flushBucketEntryAccesses(bucket);
+} // recordEntryAccess
+
+template <bool persistent>
+void
+CachePrivate<persistent>::flushBucketEntryAccesses(CacheBucket<persistent>* bucket)
+{
+    for (std::size_t i = 0; i < bucket->pendingAccesses.size(); ++i) {
+        const CacheEntryAccess& access = bucket->pendingAccesses[i];
+        evictionPolicy->touchEntry(access.hash, access.size, access.time);
+    }
+    bucket->pendingAccesses.clear();
+}
+
+template <bool persistent>
+void
+CachePrivate<persistent>::flushEntryAccesses()
+{
+    for (int bucket_i = 0; bucket_i < NATRON_CACHE_BUCKETS_COUNT; ++bucket_i) {
+        boost::scoped_ptr<ExclusiveLock> lruWriteLock;
+        createLock<ExclusiveLock>(this, lruWriteLock, &ipc->bucketsData[bucket_i].lruListMutex);
+        if ( buckets[bucket_i].pendingAccesses.empty() ) {
+            continue;
+        }
+        boost::unique_lock<boost::mutex> policyLock(evictionPolicyMutex);
+        flushBucketEntryAccesses(&buckets[bucket_i]);
+    }
+}
+
+template <bool persistent>
+void
+CachePrivate<persistent>::populateEvictionPolicy(boost::scoped_ptr<SharedMemoryProcessLocalReadLocker<persistent> >& shmReader)
+{
+    for (int bucket_i = 0; bucket_i < NATRON_CACHE_BUCKETS_COUNT; ++bucket_i) {
+        CacheBucket<persistent>& bucket = buckets[bucket_i];
+
+        try {
+            // Take the read lock on the toc file mapping
+            boost::shared_ptr<Sharable_ReadLock> tocReadLock;
+            boost::shared_ptr<Sharable_WriteLock> tocWriteLock;
+            bucket.checkToCMemorySegmentStatus(&tocReadLock, &tocWriteLock);
+
+            // Take read lock on the bucket so that entries cannot be removed
+            boost::scoped_ptr<Sharable_ReadLock> bucketLock;
+            createLock<Sharable_ReadLock>(this, bucketLock, &ipc->bucketsData[bucket_i].bucketMutex);
+
+            boost::scoped_ptr<ExclusiveLock> lruWriteLock;
+            createLock<ExclusiveLock>(this, lruWriteLock, &ipc->bucketsData[bucket_i].lruListMutex);
+
+            boost::unique_lock<boost::mutex> policyLock(evictionPolicyMutex);
+
+            // Accesses buffered so far are older than the entries timestamps
+            bucket.pendingAccesses.clear();
+
+            bip::offset_ptr<LRUListNode> it = bucket.ipc->lruListFront;
+            while (it) {
+                typename CacheBucket<persistent>::EntriesMap::iterator cacheEntryIt;
+                typename CacheBucket<persistent>::EntriesMap* storage;
+                if ( bucket.tryCacheLookupImpl(it->hash, &cacheEntryIt, &storage) ) {
+                    const MemorySegmentEntryHeader<persistent>& entry = *cacheEntryIt->second;
+                    // Entries of a previous session get a negative time
+                    evictionPolicy->insertEntry( it->hash, entry.size, getEvictionPolicyTime(entry.timestamp) );
+                }
+                it = it->next;
+            }
+        } catch (...) {
+            // Any exception caught here means the cache is corrupted
+            recoverFromInconsistentState(shmReader);
+
+            return;
+        }
+    } // for each bucket
+} // populateEvictionPolicy
+#endif // NATRON_CACHE_EVICTION_POLICY
+
 template <bool persistent>
 void
 CachePrivate<persistent>::clearCacheBucket(int bucket_i)
@@ -4771,6 +6014,28 @@ Cache<persistent>::clear()
             clearStorage(_imp->tilesStorage[i]);
         }
         _imp->tilesStorage.clear();
+
+        // Tiles held by threads are no longer valid
+        ++_imp->tilesStorageGeneration;
+
+#ifdef NATRON_CACHE_EVICTION_POLICY
+        {
+            boost::unique_lock<boost::mutex> policyLock(_imp->evictionPolicyMutex);
+            _imp->evictionPolicy->clear();
+        }
+#endif
+
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+        // Protected by the tilesStorageMutex taken in write mode
+        for (int bucket_i = 0; bucket_i < NATRON_CACHE_BUCKETS_COUNT; ++bucket_i) {
+            _imp->bucketsTilesInfo[bucket_i].clear();
+        }
+        _imp->clearTilesToCompress();
+        if (_imp->compressedTiles) {
+            _imp->compressedTiles->clear();
+        }
+#endif
+
         // Ensure we initialize the cache with at least one tile storage file
 #ifdef NATRON_CACHE_TILES_MEMORY_ALLOCATOaR_CENTRALIZED
 
@@ -4854,17 +6119,33 @@ Cache<persistent>::evictLRUEntries(std::size_t nBytesToFree)
 
     std::size_t curSize = getCurrentSize();
 
+#ifdef NATRON_CACHE_EVICTION_POLICY
+    if (curSize > maxSize) {
+        boost::scoped_ptr<SharedMemoryProcessLocalReadLocker<persistent> > shmReader(new SharedMemoryProcessLocalReadLocker<persistent>(_imp.get()));
+        _imp->flushEntryAccesses();
+    }
+#endif
+
     while (curSize > maxSize) {
 
         boost::scoped_ptr<SharedMemoryProcessLocalReadLocker<persistent> > shmReader(new SharedMemoryProcessLocalReadLocker<persistent>(_imp.get()));
 
-        // Cycle through each bucket, and establish which LRU entry of the buckets is the entry that
-        // has the oldest timestamp
         U64 oldestEntryHash = (U64)-1;
         bool oldestEntryTimeStampSet = false;
         TimestampVal oldestEntryTimeStamp;
 
-        for (int bucket_i = 0; bucket_i < NATRON_CACHE_BUCKETS_COUNT; ++bucket_i) {
+        bool gotEntryFromPolicy = false;
+#ifdef NATRON_CACHE_EVICTION_POLICY
+        {
+            boost::unique_lock<boost::mutex> policyLock(_imp->evictionPolicyMutex);
+            // The victim stays in the policy until deallocateCacheEntryImpl removes it
+            gotEntryFromPolicy = _imp->evictionPolicy->peekVictim(&oldestEntryHash);
+        }
+#endif
+
+        // If the policy does not know any entry, cycle through each bucket, and establish which LRU entry of the buckets is the entry that
+        // has the oldest timestamp
+        for (int bucket_i = 0; !gotEntryFromPolicy && bucket_i < NATRON_CACHE_BUCKETS_COUNT; ++bucket_i) {
             CacheBucket<persistent> & bucket = _imp->buckets[bucket_i];
 
             try {
@@ -4923,7 +6204,7 @@ Cache<persistent>::evictLRUEntries(std::size_t nBytesToFree)
 
         } // for each bucket
 
-        if (!oldestEntryTimeStampSet) {
+        if (!gotEntryFromPolicy && !oldestEntryTimeStampSet) {
             break;
         }
 
@@ -4951,9 +6232,21 @@ Cache<persistent>::evictLRUEntries(std::size_t nBytesToFree)
         typename CacheBucket<persistent>::EntriesMap::iterator cacheEntryIt;
         typename CacheBucket<persistent>::EntriesMap* storage;
         if (!bucket.tryCacheLookupImpl(oldestEntryHash, &cacheEntryIt, &storage)) {
+#ifdef NATRON_CACHE_EVICTION_POLICY
+            if (gotEntryFromPolicy) {
+                // The entry is no longer in the cache: it was removed by another thread after we selected it.
+                // Stop tracking it, otherwise it would be selected again. The bucket is locked: if the entry
+                // is inserted again, it will be tracked again once the insertion is reported to the policy.
+                boost::unique_lock<boost::mutex> policyLock(_imp->evictionPolicyMutex);
+                _imp->evictionPolicy->removeEntry(oldestEntryHash);
+            }
+#endif
             continue;
         }
 
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+        TilesToCompress tilesToCompress;
+#endif
         try {
             BucketStateHandler_RAII<persistent> bucketStateHandler(&bucket);
 
@@ -4962,6 +6255,11 @@ Cache<persistent>::evictLRUEntries(std::size_t nBytesToFree)
             assert(curSize >= entrySize);
             curSize -= entrySize;
 
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+            // Keep a copy of the tiles before they are freed
+            _imp->copyEntryTilesToCompress(oldestEntryHash, bucket_i, *cacheEntryIt->second, &tilesToCompress);
+#endif
+
             bucket.deallocateCacheEntryImpl(cacheEntryIt, bucketLock, tocReadLock, tocWriteLock, tilesReadLock, storage);
         } catch (...) {
             // Any exception caught here means the cache is corrupted
@@ -4972,6 +6270,13 @@ Cache<persistent>::evictLRUEntries(std::size_t nBytesToFree)
             _imp->recoverFromInconsistentState(shmReader);
             return;
         }
+
+#ifdef NATRON_CACHE_COMPRESSED_TILES_TIER
+        if ( !tilesToCompress.tiles.empty() ) {
+            // Compressing is done by the compression thread so that eviction is not slowed down
+            _imp->queueTilesToCompress(&tilesToCompress);
+        }
+#endif
     } // while(curSize < maxSize)
     
 } // evictLRUEntries
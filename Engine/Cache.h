@@ -172,6 +172,8 @@
 // has to sequentially lock and unlock each bucket mutex that proctects the free tiles list. The thread could not take all 256 bucket mutexes
 // otherwise we would be sure to end-up with a deadlock if multiple threads were to call this function at the same time, plus it would be just
 // about the same as in the NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED mode.
+// To avoid this, each thread keeps a small stack of free tiles which is refilled in batches from the bucket
+// of the tile being allocated, and to which freed tiles are given back (see NATRON_CACHE_THREAD_LOCAL_FREE_TILES in the cpp).
 //#define NATRON_CACHE_TILES_MEMORY_ALLOCATOR_CENTRALIZED
 
 NATRON_NAMESPACE_ENTER
@@ -190,6 +192,38 @@ struct CacheReportInfo
     }
 };
 
+/**
+ * @brief Statistics of a tier of the tiles storage, @see CacheBase::getTilesTierStats
+ **/
+struct CacheTierStats
+{
+    // Number of tiles looked-up that were found in the tier, or not
+    U64 nHits, nMisses;
+
+    // Number of tiles in the tier, the number of bytes they take and the number of bytes they take uncompressed
+    std::size_t nTiles, nBytes, nUncompressedBytes;
+
+    // For the uncompressed tiles tier, the number of times this process locked the free tiles list of a bucket
+    // to take free tiles from it or give tiles back to it
+    U64 nFreeTilesListAccesses;
+
+    CacheTierStats()
+    : nHits(0)
+    , nMisses(0)
+    , nTiles(0)
+    , nBytes(0)
+    , nUncompressedBytes(0)
+    , nFreeTilesListAccesses(0)
+    {
+
+    }
+
+    double getCompressionRatio() const
+    {
+        return nBytes ? (double)nUncompressedBytes / nBytes : 1.;
+    }
+};
+
 template <bool persistent>
 struct CacheBucket;
 
@@ -358,8 +392,10 @@ public:
      * @brief Creates a TileHash that uniquely identifies a tile to the cache.
      * Since all tiles in the cache share the same cache entry (same image) we want the allocation of the tiles from the cache to
      * come from different buckets so that we distribute uniformly the tile file storage.
+     * @param draft Tiles rendered in draft mode get a different hash so that they cannot be restored from the
+     * compressed tiles tier as full quality tiles.
      **/
-    static TileHash makeTileCacheIndex(int tx, int ty, unsigned int mipMapLevel, int channelIndex, U64 entryHash);
+    static TileHash makeTileCacheIndex(int tx, int ty, unsigned int mipMapLevel, int channelIndex, U64 entryHash, bool draft = false);
 
     /**
      * @brief Check if the given file exists on disk
@@ -399,11 +435,79 @@ public:
      **/
     virtual std::size_t getMaximumCacheSize() const = 0;
 
+    /**
+     * @brief When enabled (the default), each thread allocating tiles keeps a few free tiles that are
+     * refilled in batches from the buckets, so that retrieveAndLockTiles does not lock a bucket for each tile.
+     * This should not be called whilst tiles are being allocated and is mainly intended to compare both strategies.
+     **/
+    virtual void setThreadLocalFreeTilesEnabled(bool enabled) = 0;
+
     /**
      * @breif Returns the actual size taken in memory for the given storagE.
      **/
     virtual std::size_t getCurrentSize() const = 0;
 
+    /**
+     * @brief Controls how the memory of the tile storage is backed, this is only an optimization.
+     * @param useHugePages If true, ask the system to back the tile storage with transparent huge pages.
+     * To use explicit huge pages with the persistent cache, the cache directory must be on a hugetlbfs mount point.
+     * @param spreadOnNUMANodes If true and the system has several NUMA nodes, buckets are split in as many groups as
+     * there are nodes and the tiles of each group are allocated on their own node. Threads pinned to a NUMA node
+     * then allocate tiles from the group of their node, other threads allocate from all buckets.
+     * Enabled hints are applied to the existing tile storage files as well as to the ones created afterwards.
+     * Disabling a hint does not move or re-advise memory that was already touched.
+     **/
+    virtual void setTileStorageMemoryHints(bool useHugePages, bool spreadOnNUMANodes) = 0;
+
+    /**
+     * @brief Set the policy used by evictLRUEntries() to select which entries to evict. The policy applies to all
+     * the entries of the cache at once. The default is eCacheEvictionPolicyTypeLRU.
+     * When the persistent cache is shared by multiple processes, entries are always evicted
+     * in an approximate LRU order and this has no effect.
+     **/
+    virtual void setEvictionPolicy(CacheEvictionPolicyTypeEnum policy) = 0;
+
+    virtual CacheEvictionPolicyTypeEnum getEvictionPolicy() const = 0;
+
+    /**
+     * @brief Report the time it took to compute the entry with the given hash. Cost aware eviction policies evict
+     * first the entries that are the cheapest to compute again.
+     **/
+    virtual void addEntryComputeCost(U64 hash, double timeSpentSeconds) = 0;
+
+    /**
+     * @brief Set the maximum size on disk of the compressed tiles tier: the tiles of entries evicted from the cache
+     * are compressed and kept in this tier so that they can be restored with restoreCompressedTiles() instead of being rendered again.
+     * 0 disables the tier, which is the default. This is only supported by the persistent cache.
+     **/
+    virtual void setMaximumCompressedTilesSize(std::size_t size) = 0;
+
+    virtual std::size_t getMaximumCompressedTilesSize() const = 0;
+
+    /**
+     * @brief For each tile hash, set in available whether the tile can be restored from the compressed tiles tier.
+     **/
+    virtual void hasCompressedTiles(const std::vector<TileHash>& tileHashes, std::vector<bool>* available) const = 0;
+
+    /**
+     * @brief Allocates a tile for each given hash, as retrieveAndLockTiles would, and decompresses in it the corresponding
+     * tile of the compressed tiles tier. Restored tiles are removed from the compressed tiles tier.
+     * Either all tiles are restored or none.
+     * @returns True upon success, in which case you must call unLockTiles(cacheData, false) once done with the tiles pointers.
+     **/
+    virtual bool restoreCompressedTiles(const CacheEntryBasePtr& entry,
+                                        const std::vector<TileHash>& tileHashes,
+                                        std::vector<std::pair<TileInternalIndex, void*> >* restoredTilesData,
+                                        void** cacheData) = 0;
+
+    /**
+     * @brief Returns the statistics of the uncompressed tiles tier and of the compressed tiles tier.
+     * For the uncompressed tier, hits are tiles fetched from the cache and misses tiles that had to be allocated.
+     * For the compressed tier, hits are tiles restored by restoreCompressedTiles() and misses tiles that were not
+     * available in hasCompressedTiles() or that could not be restored.
+     **/
+    virtual void getTilesTierStats(CacheTierStats* tilesTier, CacheTierStats* compressedTilesTier) const = 0;
+
     /**
      * @brief Look-up the cache for the given entry's key.
      * The entry is assumed to have its key set.
@@ -596,7 +700,20 @@ public:
     virtual std::string getCacheDirectoryPath() const OVERRIDE FINAL;
     virtual void setMaximumCacheSize(std::size_t size) OVERRIDE FINAL;
     virtual std::size_t getMaximumCacheSize() const OVERRIDE FINAL;
+    virtual void setThreadLocalFreeTilesEnabled(bool enabled) OVERRIDE FINAL;
     virtual std::size_t getCurrentSize() const OVERRIDE FINAL;
+    virtual void setTileStorageMemoryHints(bool useHugePages, bool spreadOnNUMANodes) OVERRIDE FINAL;
+    virtual void setEvictionPolicy(CacheEvictionPolicyTypeEnum policy) OVERRIDE FINAL;
+    virtual CacheEvictionPolicyTypeEnum getEvictionPolicy() const OVERRIDE FINAL;
+    virtual void addEntryComputeCost(U64 hash, double timeSpentSeconds) OVERRIDE FINAL;
+    virtual void setMaximumCompressedTilesSize(std::size_t size) OVERRIDE FINAL;
+    virtual std::size_t getMaximumCompressedTilesSize() const OVERRIDE FINAL;
+    virtual void hasCompressedTiles(const std::vector<TileHash>& tileHashes, std::vector<bool>* available) const OVERRIDE FINAL;
+    virtual bool restoreCompressedTiles(const CacheEntryBasePtr& entry,
+                                        const std::vector<TileHash>& tileHashes,
+                                        std::vector<std::pair<TileInternalIndex, void*> >* restoredTilesData,
+                                        void** cacheData) OVERRIDE FINAL;
+    virtual void getTilesTierStats(CacheTierStats* tilesTier, CacheTierStats* compressedTilesTier) const OVERRIDE FINAL;
     virtual CacheEntryLockerBasePtr get(const CacheEntryBasePtr& entry) const OVERRIDE FINAL;
     virtual bool retrieveAndLockTiles(const CacheEntryBasePtr& entry,
                                       const std::vector<TileInternalIndex>* tileIndices,
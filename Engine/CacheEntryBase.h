@@ -165,6 +165,16 @@ public:
     {
         return false;
     }
+
+    /**
+     * @brief Returns the size in bytes of a pixel component in the tiles allocated for this entry with
+     * Cache::retrieveAndLockTiles. This is used to compress the tiles efficiently.
+     * The base class version assumes 32-bit floating point tiles.
+     **/
+    virtual int getTilesElementSize() const
+    {
+        return 4;
+    }
 private:
 
     boost::scoped_ptr<CacheEntryBasePrivate> _imp;
@@ -54,6 +54,7 @@ NATRON_NAMESPACE_ENTER
 #define kCacheKeyUniqueIDGetComponentsResults 6
 #define kCacheKeyUniqueIDGetFrameRangeResults 7
 #define kCacheKeyUniqueIDGetDistortionResults 9
+#define kCacheKeyUniqueIDGetRegionsOfInterestResults 10
 
 
 
@@ -0,0 +1,437 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "CacheEvictionPolicy.h"
+
+#include <algorithm>
+#include <cassert>
+#include <list>
+#include <map>
+#include <set>
+#include <utility>
+
+// Entries for which no render time was reported are assumed to have been computed in that many seconds
+#define NATRON_CACHE_EVICTION_DEFAULT_COST 1e-3
+
+NATRON_NAMESPACE_ENTER
+
+namespace {
+
+/**
+ * @brief Exact LRU: entries are ordered by their last access time.
+ **/
+class LRUCacheEvictionPolicy
+    : public CacheEvictionPolicy
+{
+    typedef std::pair<double, U64> AccessKey;
+
+    // Entries sorted by access time, the first one is the least recently used
+    std::set<AccessKey> _order;
+
+    // The last access time of each entry
+    std::map<U64, double> _entries;
+
+public:
+
+    LRUCacheEvictionPolicy()
+    : CacheEvictionPolicy()
+    , _order()
+    , _entries()
+    {
+    }
+
+    virtual ~LRUCacheEvictionPolicy()
+    {
+    }
+
+    virtual CacheEvictionPolicyTypeEnum getType() const OVERRIDE FINAL
+    {
+        return eCacheEvictionPolicyTypeLRU;
+    }
+
+    virtual void insertEntry(U64 hash, std::size_t /*size*/, double time) OVERRIDE FINAL
+    {
+        std::pair<std::map<U64, double>::iterator, bool> ret = _entries.insert( std::make_pair(hash, time) );
+        if (!ret.second) {
+            touchInternal(ret.first, time);
+        } else {
+            _order.insert( std::make_pair(time, hash) );
+        }
+    }
+
+    virtual void touchEntry(U64 hash, std::size_t /*size*/, double time) OVERRIDE FINAL
+    {
+        std::map<U64, double>::iterator found = _entries.find(hash);
+        if ( found != _entries.end() ) {
+            touchInternal(found, time);
+        }
+    }
+
+    virtual void addEntryCost(U64 /*hash*/, double /*timeSpentSeconds*/) OVERRIDE FINAL
+    {
+    }
+
+    virtual void removeEntry(U64 hash) OVERRIDE FINAL
+    {
+        std::map<U64, double>::iterator found = _entries.find(hash);
+        if ( found != _entries.end() ) {
+            _order.erase( std::make_pair(found->second, hash) );
+            _entries.erase(found);
+        }
+    }
+
+    virtual bool peekVictim(U64* hash) OVERRIDE FINAL
+    {
+        if ( _order.empty() ) {
+            return false;
+        }
+        *hash = _order.begin()->second;
+
+        return true;
+    }
+
+    virtual std::size_t getNumEntries() const OVERRIDE FINAL
+    {
+        return _entries.size();
+    }
+
+    virtual void clear() OVERRIDE FINAL
+    {
+        _order.clear();
+        _entries.clear();
+    }
+
+private:
+
+    void touchInternal(std::map<U64, double>::iterator it, double time)
+    {
+        // Accesses may be reported out of order, only keep the most recent
+        if (time <= it->second) {
+            return;
+        }
+        _order.erase( std::make_pair(it->second, it->first) );
+        it->second = time;
+        _order.insert( std::make_pair(time, it->first) );
+    }
+};
+
+/**
+ * @brief CLOCK (second chance): entries are kept in a circular list. An access only sets the referenced flag
+ * of the entry. To find a victim, the hand sweeps the list clearing referenced flags until it finds an
+ * entry that was not referenced since the last sweep.
+ **/
+class ClockCacheEvictionPolicy
+    : public CacheEvictionPolicy
+{
+    struct ClockEntry
+    {
+        U64 hash;
+        bool referenced;
+    };
+
+    typedef std::list<ClockEntry> ClockList;
+
+    ClockList _clock;
+    std::map<U64, ClockList::iterator> _entries;
+
+    // Points to the next entry to inspect, or _clock.end() in which case we restart from the beginning
+    ClockList::iterator _hand;
+
+public:
+
+    ClockCacheEvictionPolicy()
+    : CacheEvictionPolicy()
+    , _clock()
+    , _entries()
+    , _hand( _clock.end() )
+    {
+    }
+
+    virtual ~ClockCacheEvictionPolicy()
+    {
+    }
+
+    virtual CacheEvictionPolicyTypeEnum getType() const OVERRIDE FINAL
+    {
+        return eCacheEvictionPolicyTypeCLOCK;
+    }
+
+    virtual void insertEntry(U64 hash, std::size_t size, double time) OVERRIDE FINAL
+    {
+        std::map<U64, ClockList::iterator>::iterator found = _entries.find(hash);
+        if ( found != _entries.end() ) {
+            found->second->referenced = true;
+            return;
+        }
+        (void)size;
+        (void)time;
+
+        // Insert just behind the hand so that the new entry is the last one to be inspected
+        ClockEntry e;
+        e.hash = hash;
+        e.referenced = false;
+        ClockList::iterator it = _clock.insert(_hand, e);
+        _entries.insert( std::make_pair(hash, it) );
+    }
+
+    virtual void touchEntry(U64 hash, std::size_t /*size*/, double /*time*/) OVERRIDE FINAL
+    {
+        std::map<U64, ClockList::iterator>::iterator found = _entries.find(hash);
+        if ( found != _entries.end() ) {
+            found->second->referenced = true;
+        }
+    }
+
+    virtual void addEntryCost(U64 /*hash*/, double /*timeSpentSeconds*/) OVERRIDE FINAL
+    {
+    }
+
+    virtual void removeEntry(U64 hash) OVERRIDE FINAL
+    {
+        std::map<U64, ClockList::iterator>::iterator found = _entries.find(hash);
+        if ( found == _entries.end() ) {
+            return;
+        }
+        eraseInternal(found->second);
+        _entries.erase(found);
+    }
+
+    virtual bool peekVictim(U64* hash) OVERRIDE FINAL
+    {
+        if ( _clock.empty() ) {
+            return false;
+        }
+        // At most 2 turns: after the first one all referenced flags are cleared.
+        // The hand stays on the victim, removeEntry moves it to the next entry.
+        for (;;) {
+            if ( _hand == _clock.end() ) {
+                _hand = _clock.begin();
+            }
+            if (_hand->referenced) {
+                _hand->referenced = false;
+                ++_hand;
+                continue;
+            }
+            *hash = _hand->hash;
+
+            return true;
+        }
+    }
+
+    virtual std::size_t getNumEntries() const OVERRIDE FINAL
+    {
+        return _entries.size();
+    }
+
+    virtual void clear() OVERRIDE FINAL
+    {
+        _clock.clear();
+        _entries.clear();
+        _hand = _clock.end();
+    }
+
+private:
+
+    void eraseInternal(ClockList::iterator it)
+    {
+        if (it == _hand) {
+            _hand = _clock.erase(it);
+        } else {
+            _clock.erase(it);
+        }
+    }
+};
+
+/**
+ * @brief GreedyDual-Size: each entry has a priority equal to L + cost / size where cost is the time spent to
+ * compute the entry and L an inflation value set to the priority of the last selected victim.
+ * The entry with the lowest priority is evicted first: among entries of the same size, the cheapest to recompute
+ * go first, while the inflation value ages entries that are not accessed anymore, however expensive they are.
+ **/
+class CostAwareCacheEvictionPolicy
+    : public CacheEvictionPolicy
+{
+    struct PriorityKey
+    {
+        double priority;
+
+        // Break ties with the access time so that among entries of equal priority the LRU is evicted first
+        double time;
+        U64 hash;
+
+        bool operator<(const PriorityKey& other) const
+        {
+            if (priority != other.priority) {
+                return priority < other.priority;
+            }
+            if (time != other.time) {
+                return time < other.time;
+            }
+
+            return hash < other.hash;
+        }
+    };
+
+    struct CostEntry
+    {
+        PriorityKey key;
+        std::size_t size;
+        double cost;
+    };
+
+    std::set<PriorityKey> _queue;
+    std::map<U64, CostEntry> _entries;
+
+    // The priority of the last selected victim
+    double _inflation;
+
+public:
+
+    CostAwareCacheEvictionPolicy()
+    : CacheEvictionPolicy()
+    , _queue()
+    , _entries()
+    , _inflation(0)
+    {
+    }
+
+    virtual ~CostAwareCacheEvictionPolicy()
+    {
+    }
+
+    virtual CacheEvictionPolicyTypeEnum getType() const OVERRIDE FINAL
+    {
+        return eCacheEvictionPolicyTypeCostAware;
+    }
+
+    virtual void insertEntry(U64 hash, std::size_t size, double time) OVERRIDE FINAL
+    {
+        std::map<U64, CostEntry>::iterator found = _entries.find(hash);
+        if ( found != _entries.end() ) {
+            updateInternal(found, size, std::max(time, found->second.key.time));
+
+            return;
+        }
+        CostEntry e;
+        e.size = size;
+        e.cost = 0;
+        e.key.hash = hash;
+        e.key.time = time;
+        e.key.priority = getPriority(e);
+        _queue.insert(e.key);
+        _entries.insert( std::make_pair(hash, e) );
+    }
+
+    virtual void touchEntry(U64 hash, std::size_t size, double time) OVERRIDE FINAL
+    {
+        std::map<U64, CostEntry>::iterator found = _entries.find(hash);
+        if ( found != _entries.end() ) {
+            updateInternal(found, size, std::max(time, found->second.key.time));
+        }
+    }
+
+    virtual void addEntryCost(U64 hash, double timeSpentSeconds) OVERRIDE FINAL
+    {
+        std::map<U64, CostEntry>::iterator found = _entries.find(hash);
+        if ( found == _entries.end() ) {
+            return;
+        }
+        found->second.cost += timeSpentSeconds;
+        updateInternal(found, found->second.size, found->second.key.time);
+    }
+
+    virtual void removeEntry(U64 hash) OVERRIDE FINAL
+    {
+        std::map<U64, CostEntry>::iterator found = _entries.find(hash);
+        if ( found != _entries.end() ) {
+            _queue.erase(found->second.key);
+            _entries.erase(found);
+        }
+    }
+
+    virtual bool peekVictim(U64* hash) OVERRIDE FINAL
+    {
+        if ( _queue.empty() ) {
+            return false;
+        }
+        std::set<PriorityKey>::iterator first = _queue.begin();
+        *hash = first->hash;
+        // The lowest priority never decreases, so this is correct even if the victim cannot be evicted
+        _inflation = first->priority;
+
+        return true;
+    }
+
+    virtual std::size_t getNumEntries() const OVERRIDE FINAL
+    {
+        return _entries.size();
+    }
+
+    virtual void clear() OVERRIDE FINAL
+    {
+        _queue.clear();
+        _entries.clear();
+        _inflation = 0;
+    }
+
+private:
+
+    double getPriority(const CostEntry& e) const
+    {
+        // Express the size in MiB, otherwise cost/size is too small compared to the inflation
+        double sizeMB = std::max( (double)e.size / (1024. * 1024.), 1e-3 );
+        double cost = e.cost > 0 ? e.cost : NATRON_CACHE_EVICTION_DEFAULT_COST;
+
+        return _inflation + cost / sizeMB;
+    }
+
+    void updateInternal(std::map<U64, CostEntry>::iterator it, std::size_t size, double time)
+    {
+        _queue.erase(it->second.key);
+        it->second.size = size;
+        it->second.key.time = time;
+        it->second.key.priority = getPriority(it->second);
+        _queue.insert(it->second.key);
+    }
+};
+
+} // anon namespace
+
+CacheEvictionPolicyPtr
+CacheEvictionPolicy::create(CacheEvictionPolicyTypeEnum type)
+{
+    switch (type) {
+    case eCacheEvictionPolicyTypeLRU:
+        return CacheEvictionPolicyPtr(new LRUCacheEvictionPolicy);
+    case eCacheEvictionPolicyTypeCLOCK:
+        return CacheEvictionPolicyPtr(new ClockCacheEvictionPolicy);
+    case eCacheEvictionPolicyTypeCostAware:
+        return CacheEvictionPolicyPtr(new CostAwareCacheEvictionPolicy);
+    }
+    assert(false);
+
+    return CacheEvictionPolicyPtr(new LRUCacheEvictionPolicy);
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,107 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_CACHEEVICTIONPOLICY_H
+#define NATRON_ENGINE_CACHEEVICTIONPOLICY_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+#include "Global/Enums.h"
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Decides which entry of the cache should be evicted next. The policy sees all the entries of the cache
+ * at once, as opposed to the LRU lists of the buckets which only order entries within a bucket.
+ *
+ * Entries are identified by their hash. The time passed to the functions is a time in seconds which must
+ * increase with each access: it is used to order accesses that may be reported to the policy out of order.
+ *
+ * Implementations are not thread-safe: the cache protects the policy with its own mutex.
+ **/
+class CacheEvictionPolicy
+{
+public:
+
+    /**
+     * @brief Creates a new policy of the given type with no entries.
+     **/
+    static CacheEvictionPolicyPtr create(CacheEvictionPolicyTypeEnum type);
+
+    CacheEvictionPolicy()
+    {
+    }
+
+    virtual ~CacheEvictionPolicy()
+    {
+    }
+
+    virtual CacheEvictionPolicyTypeEnum getType() const = 0;
+
+    /**
+     * @brief Start tracking an entry, or if already tracked, update its size and mark it accessed.
+     * @param size The number of bytes taken by the entry and its tiles in the cache
+     **/
+    virtual void insertEntry(U64 hash, std::size_t size, double time) = 0;
+
+    /**
+     * @brief Mark the entry accessed. Does nothing if the entry is not tracked (it may have been removed
+     * before the access was reported).
+     **/
+    virtual void touchEntry(U64 hash, std::size_t size, double time) = 0;
+
+    /**
+     * @brief Adds to the time that was spent computing the entry. Only used by cost aware policies.
+     **/
+    virtual void addEntryCost(U64 hash, double timeSpentSeconds) = 0;
+
+    /**
+     * @brief Stop tracking the entry. Does nothing if the entry is not tracked.
+     **/
+    virtual void removeEntry(U64 hash) = 0;
+
+    /**
+     * @brief Returns in hash the entry to evict next. The entry is still tracked: call removeEntry() once it
+     * was actually evicted, so that an entry that could not be evicted keeps its place.
+     * @returns False if there is no entry tracked
+     **/
+    virtual bool peekVictim(U64* hash) = 0;
+
+    virtual std::size_t getNumEntries() const = 0;
+
+    virtual void clear() = 0;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_CACHEEVICTIONPOLICY_H
@@ -0,0 +1,546 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "CompressedTilesStorage.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <QDir>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+#endif
+
+#include "Engine/AppManager.h"
+#include "Engine/Hash64.h"
+#include "Engine/MemoryFile.h"
+#include "Engine/TileCompression.h"
+
+// Each segment of the log is a memory mapped file of this size
+#define NATRON_COMPRESSED_TILES_SEGMENT_SIZE 67108864 // = 64 * 1024 * 1024
+
+// Magic numbers identifying segments and records
+#define NATRON_COMPRESSED_TILES_SEGMENT_MAGIC 0x5354434E // "NCTS"
+#define NATRON_COMPRESSED_TILES_RECORD_MAGIC 0x5243544E // "NTCR"
+#define NATRON_COMPRESSED_TILES_REMOVED_RECORD_MAGIC 0x4D52544E // "NTRM"
+
+// Increment when the layout of segments or records or the compression format changes
+#define NATRON_COMPRESSED_TILES_VERSION ( (1 << 8) | NATRON_HASH64_ALGORITHM_VERSION )
+
+NATRON_NAMESPACE_ENTER
+
+namespace {
+
+struct SegmentHeader
+{
+    U32 magic;
+    U32 version;
+
+    // Incremented each time a segment is recycled: the segment with the highest serial is the one being written.
+    // Records are tagged with the serial of the segment at the time they were written so that records
+    // left over from a previous use of the segment are ignored when scanning. 0 means the segment is empty.
+    U64 serial;
+};
+
+struct RecordHeader
+{
+    U32 magic;
+    U32 compressedSize;
+    U64 tileHash;
+    U64 checksum;
+    U64 serial;
+    U32 uncompressedSize;
+    U32 elementSize;
+};
+
+struct RecordLocation
+{
+    int segmentIndex;
+    std::size_t offset;
+    std::size_t compressedSize;
+    std::size_t uncompressedSize;
+};
+
+typedef std::map<U64, RecordLocation> RecordsMap;
+
+inline std::size_t
+alignRecordSize(std::size_t size)
+{
+    return (size + 7) & ~( (std::size_t)7 );
+}
+
+U64
+computeChecksum(const unsigned char* data, std::size_t nBytes)
+{
+    // Hash64 works on 64-bit values: pad the last value with zeroes
+    std::size_t nValues = nBytes / sizeof(U64);
+    std::vector<U64> values(nValues + 1, 0);
+    if (nBytes) {
+        std::memcpy(&values[0], data, nBytes);
+    }
+    Hash64 hash;
+    hash.appendValues(&values[0], nBytes % sizeof(U64) ? nValues + 1 : nValues);
+    hash.append( (U64)nBytes );
+    hash.computeHash();
+    return hash.value();
+}
+
+} // anon namespace
+
+struct CompressedTilesStoragePrivate
+{
+    std::string directoryPath;
+
+    // 1 if segments is not empty. This is read without taking the lock so that the cache does not lock
+    // the storage for each allocation when it is disabled.
+    QAtomicInt enabled;
+
+    // Protects all members below
+    mutable boost::mutex lock;
+
+    std::size_t maximumSize;
+
+    std::vector<MemoryFilePtr> segments;
+
+    // For each segment, the hashes of the tiles written in it. An entry may be stale
+    // if the tile was re-inserted elsewhere or removed.
+    std::vector<std::vector<U64> > segmentsTiles;
+
+    // The segment currently written and the offset at which the next record goes
+    int currentSegment;
+    std::size_t writeOffset;
+    U64 currentSerial;
+
+    RecordsMap records;
+
+    std::size_t nCompressedBytes, nUncompressedBytes;
+
+    CompressedTilesStoragePrivate(const std::string& directoryPath)
+    : directoryPath(directoryPath)
+    , enabled(0)
+    , lock()
+    , maximumSize(0)
+    , segments()
+    , segmentsTiles()
+    , currentSegment(0)
+    , writeOffset(0)
+    , currentSerial(0)
+    , records()
+    , nCompressedBytes(0)
+    , nUncompressedBytes(0)
+    {
+    }
+
+    std::string getSegmentFilePath(int index) const
+    {
+        std::stringstream ss;
+        ss << directoryPath << "/CompressedTiles" << index;
+        return ss.str();
+    }
+
+    SegmentHeader* getSegmentHeader(int index) const
+    {
+        return reinterpret_cast<SegmentHeader*>(segments[index]->getData());
+    }
+
+    void openSegments(int nSegments);
+
+    void closeSegments(bool removeFiles);
+
+    void scanSegment(int index);
+
+    void eraseRecord(RecordsMap::iterator it);
+
+    void recycleNextSegment();
+};
+
+CompressedTilesStorage::CompressedTilesStorage(const std::string& directoryPath)
+: _imp(new CompressedTilesStoragePrivate(directoryPath))
+{
+}
+
+CompressedTilesStorage::~CompressedTilesStorage()
+{
+    boost::unique_lock<boost::mutex> k(_imp->lock);
+    _imp->closeSegments(false);
+}
+
+void
+CompressedTilesStoragePrivate::closeSegments(bool removeFiles)
+{
+    for (std::size_t i = 0; i < segments.size(); ++i) {
+        if (removeFiles) {
+            segments[i]->remove();
+        } else {
+            segments[i]->flush(MemoryFile::eFlushTypeAsync, NULL, 0);
+            segments[i]->close();
+        }
+    }
+    segments.clear();
+    enabled.fetchAndStoreOrdered(0);
+    segmentsTiles.clear();
+    records.clear();
+    nCompressedBytes = nUncompressedBytes = 0;
+    currentSegment = 0;
+    writeOffset = 0;
+    currentSerial = 0;
+}
+
+void
+CompressedTilesStoragePrivate::openSegments(int nSegments)
+{
+    assert(segments.empty());
+    {
+        QDir d = QDir::root();
+        d.mkpath( QString::fromUtf8( directoryPath.c_str() ) );
+    }
+
+    try {
+        for (int i = 0; i < nSegments; ++i) {
+            MemoryFilePtr file(new MemoryFile);
+            file->open(getSegmentFilePath(i), MemoryFile::eFileOpenModeOpenOrCreate);
+            if (file->size() != NATRON_COMPRESSED_TILES_SEGMENT_SIZE) {
+                file->resize(NATRON_COMPRESSED_TILES_SEGMENT_SIZE, false);
+            }
+            segments.push_back(file);
+        }
+    } catch (const std::exception& e) {
+        if (appPTR) {
+            appPTR->writeToErrorLog_mt_safe( QCoreApplication::translate("CompressedTilesStorage", "Cache"), QDateTime::currentDateTime(),
+                                             QCoreApplication::translate("CompressedTilesStorage", "Failed to open the compressed tiles storage: %1").arg( QString::fromUtf8( e.what() ) ) );
+        }
+        closeSegments(false);
+        return;
+    }
+    segmentsTiles.resize(nSegments);
+    enabled.fetchAndStoreOrdered(1);
+
+    // Rebuild the records index from what was written in a previous session
+    currentSegment = -1;
+    for (int i = 0; i < nSegments; ++i) {
+        SegmentHeader* header = getSegmentHeader(i);
+        if ( (header->magic != NATRON_COMPRESSED_TILES_SEGMENT_MAGIC) || (header->version != NATRON_COMPRESSED_TILES_VERSION) ) {
+            header->magic = NATRON_COMPRESSED_TILES_SEGMENT_MAGIC;
+            header->version = NATRON_COMPRESSED_TILES_VERSION;
+            header->serial = 0;
+            continue;
+        }
+        if (header->serial == 0) {
+            continue;
+        }
+        if ( (currentSegment == -1) || (header->serial > currentSerial) ) {
+            currentSegment = i;
+            currentSerial = header->serial;
+        }
+    }
+
+    if (currentSegment == -1) {
+        // Empty storage, start writing in the first segment
+        currentSegment = 0;
+        currentSerial = 1;
+        getSegmentHeader(0)->serial = currentSerial;
+        writeOffset = sizeof(SegmentHeader);
+        return;
+    }
+
+    // Scan from the oldest segment so that the most recent record wins for a given tile
+    for (int i = 1; i <= nSegments; ++i) {
+        scanSegment( (currentSegment + i) % nSegments );
+    }
+} // openSegments
+
+void
+CompressedTilesStoragePrivate::scanSegment(int index)
+{
+    const SegmentHeader* header = getSegmentHeader(index);
+    if (header->serial == 0) {
+        return;
+    }
+    char* data = segments[index]->getData();
+
+    // Records are read in order while scanning, then tiles are restored in no particular order
+    MemoryFile::adviseAccessPattern(MemoryFile::eAccessPatternSequential, data, NATRON_COMPRESSED_TILES_SEGMENT_SIZE);
+    std::size_t offset = sizeof(SegmentHeader);
+    while (offset + sizeof(RecordHeader) <= NATRON_COMPRESSED_TILES_SEGMENT_SIZE) {
+        const RecordHeader* record = reinterpret_cast<const RecordHeader*>(data + offset);
+        if ( ( (record->magic != NATRON_COMPRESSED_TILES_RECORD_MAGIC) && (record->magic != NATRON_COMPRESSED_TILES_REMOVED_RECORD_MAGIC) ) ||
+             (record->serial != header->serial) ||
+             (record->compressedSize > NATRON_COMPRESSED_TILES_SEGMENT_SIZE - offset - sizeof(RecordHeader)) ) {
+            break;
+        }
+        if (record->magic == NATRON_COMPRESSED_TILES_REMOVED_RECORD_MAGIC) {
+            offset += alignRecordSize(sizeof(RecordHeader) + record->compressedSize);
+            continue;
+        }
+
+        // Checksums are verified when restoring the tile
+        RecordsMap::iterator found = records.find(record->tileHash);
+        if ( found != records.end() ) {
+            eraseRecord(found);
+        }
+        RecordLocation& location = records[record->tileHash];
+        location.segmentIndex = index;
+        location.offset = offset;
+        location.compressedSize = record->compressedSize;
+        location.uncompressedSize = record->uncompressedSize;
+        nCompressedBytes += location.compressedSize;
+        nUncompressedBytes += location.uncompressedSize;
+        segmentsTiles[index].push_back(record->tileHash);
+
+        offset += alignRecordSize(sizeof(RecordHeader) + record->compressedSize);
+    }
+    if (index == currentSegment) {
+        writeOffset = offset;
+    }
+    MemoryFile::adviseAccessPattern(MemoryFile::eAccessPatternRandom, data, NATRON_COMPRESSED_TILES_SEGMENT_SIZE);
+} // scanSegment
+
+void
+CompressedTilesStoragePrivate::eraseRecord(RecordsMap::iterator it)
+{
+    assert(nCompressedBytes >= it->second.compressedSize && nUncompressedBytes >= it->second.uncompressedSize);
+    nCompressedBytes -= it->second.compressedSize;
+    nUncompressedBytes -= it->second.uncompressedSize;
+
+    // Flag the record on disk so that it is not indexed again when re-opening the storage
+    RecordHeader* header = reinterpret_cast<RecordHeader*>(segments[it->second.segmentIndex]->getData() + it->second.offset);
+    header->magic = NATRON_COMPRESSED_TILES_REMOVED_RECORD_MAGIC;
+    records.erase(it);
+}
+
+void
+CompressedTilesStoragePrivate::recycleNextSegment()
+{
+    currentSegment = (currentSegment + 1) % (int)segments.size();
+
+    // Drop all tiles that still live in the segment
+    std::vector<U64>& tiles = segmentsTiles[currentSegment];
+    for (std::size_t i = 0; i < tiles.size(); ++i) {
+        RecordsMap::iterator found = records.find(tiles[i]);
+        if ( (found != records.end()) && (found->second.segmentIndex == currentSegment) ) {
+            eraseRecord(found);
+        }
+    }
+    tiles.clear();
+
+    ++currentSerial;
+    getSegmentHeader(currentSegment)->serial = currentSerial;
+    writeOffset = sizeof(SegmentHeader);
+}
+
+void
+CompressedTilesStorage::setMaximumSize(std::size_t size)
+{
+    int nSegments = 0;
+    if (size > 0) {
+        // Rotating needs at least 2 segments otherwise all tiles would be lost at once
+        nSegments = std::max( (std::size_t)2, size / NATRON_COMPRESSED_TILES_SEGMENT_SIZE );
+    }
+
+    boost::unique_lock<boost::mutex> k(_imp->lock);
+    _imp->maximumSize = size;
+    if ( (int)_imp->segments.size() == nSegments ) {
+        return;
+    }
+
+    // The number of segments changed: start from scratch, we would otherwise have to
+    // re-order the segments
+    _imp->closeSegments(true);
+    if (nSegments > 0) {
+        _imp->openSegments(nSegments);
+    }
+}
+
+std::size_t
+CompressedTilesStorage::getMaximumSize() const
+{
+    boost::unique_lock<boost::mutex> k(_imp->lock);
+    return _imp->maximumSize;
+}
+
+bool
+CompressedTilesStorage::isEnabled() const
+{
+    return (int)_imp->enabled != 0;
+}
+
+bool
+CompressedTilesStorage::insertTile(U64 tileHash, const void* data, std::size_t nBytes, int elementSize)
+{
+    // Compress outside of the lock
+    std::vector<unsigned char> compressed( TileCompression::getCompressBound(nBytes) );
+    std::size_t compressedSize = TileCompression::compress(data, nBytes, elementSize, &compressed[0], compressed.size());
+    if (!compressedSize) {
+        return false;
+    }
+    U64 checksum = computeChecksum(&compressed[0], compressedSize);
+
+    std::size_t recordSize = alignRecordSize(sizeof(RecordHeader) + compressedSize);
+    if (recordSize > NATRON_COMPRESSED_TILES_SEGMENT_SIZE - sizeof(SegmentHeader)) {
+        return false;
+    }
+
+    boost::unique_lock<boost::mutex> k(_imp->lock);
+    if ( _imp->segments.empty() ) {
+        return false;
+    }
+
+    if (_imp->writeOffset + recordSize > NATRON_COMPRESSED_TILES_SEGMENT_SIZE) {
+        _imp->recycleNextSegment();
+    }
+
+    RecordsMap::iterator found = _imp->records.find(tileHash);
+    if ( found != _imp->records.end() ) {
+        _imp->eraseRecord(found);
+    }
+
+    char* ptr = _imp->segments[_imp->currentSegment]->getData() + _imp->writeOffset;
+    RecordHeader* header = reinterpret_cast<RecordHeader*>(ptr);
+    header->magic = NATRON_COMPRESSED_TILES_RECORD_MAGIC;
+    header->compressedSize = (U32)compressedSize;
+    header->tileHash = tileHash;
+    header->checksum = checksum;
+    header->serial = _imp->currentSerial;
+    header->uncompressedSize = (U32)nBytes;
+    header->elementSize = (U32)elementSize;
+    std::memcpy(ptr + sizeof(RecordHeader), &compressed[0], compressedSize);
+
+    RecordLocation& location = _imp->records[tileHash];
+    location.segmentIndex = _imp->currentSegment;
+    location.offset = _imp->writeOffset;
+    location.compressedSize = compressedSize;
+    location.uncompressedSize = nBytes;
+    _imp->nCompressedBytes += compressedSize;
+    _imp->nUncompressedBytes += nBytes;
+    _imp->segmentsTiles[_imp->currentSegment].push_back(tileHash);
+
+    _imp->writeOffset += recordSize;
+
+    // Make sure the next record does not look valid when scanning the segment
+    if (_imp->writeOffset + sizeof(RecordHeader) <= NATRON_COMPRESSED_TILES_SEGMENT_SIZE) {
+        reinterpret_cast<RecordHeader*>(_imp->segments[_imp->currentSegment]->getData() + _imp->writeOffset)->magic = 0;
+    }
+    return true;
+} // insertTile
+
+bool
+CompressedTilesStorage::containsTile(U64 tileHash) const
+{
+    boost::unique_lock<boost::mutex> k(_imp->lock);
+    return _imp->records.find(tileHash) != _imp->records.end();
+}
+
+bool
+CompressedTilesStorage::restoreTile(U64 tileHash, void* data, std::size_t nBytes, bool eraseAfterRestore)
+{
+    std::vector<unsigned char> compressed;
+    int elementSize;
+    U64 checksum;
+
+    // The record that was read, to remove it if corrupted
+    int segmentIndex;
+    std::size_t offset;
+    U64 serial;
+    {
+        boost::unique_lock<boost::mutex> k(_imp->lock);
+        RecordsMap::iterator found = _imp->records.find(tileHash);
+        if ( found == _imp->records.end() ) {
+            return false;
+        }
+        const RecordLocation& location = found->second;
+        if (location.uncompressedSize != nBytes) {
+            return false;
+        }
+        const char* ptr = _imp->segments[location.segmentIndex]->getData() + location.offset;
+        const RecordHeader* header = reinterpret_cast<const RecordHeader*>(ptr);
+        elementSize = (int)header->elementSize;
+        checksum = header->checksum;
+        segmentIndex = location.segmentIndex;
+        offset = location.offset;
+        serial = header->serial;
+
+        // Copy the data so that the segment may be recycled while we decompress
+        compressed.resize(location.compressedSize);
+        std::memcpy(&compressed[0], ptr + sizeof(RecordHeader), location.compressedSize);
+        if (eraseAfterRestore) {
+            _imp->eraseRecord(found);
+        }
+    }
+
+    if ( (computeChecksum(&compressed[0], compressed.size()) != checksum) ||
+         !TileCompression::decompress(&compressed[0], compressed.size(), elementSize, data, nBytes) ) {
+        if (!eraseAfterRestore) {
+            // The tile may have been inserted again while we were decompressing: only remove the corrupted record
+            boost::unique_lock<boost::mutex> k(_imp->lock);
+            RecordsMap::iterator found = _imp->records.find(tileHash);
+            if ( (found != _imp->records.end()) && (found->second.segmentIndex == segmentIndex) && (found->second.offset == offset) &&
+                 (_imp->getSegmentHeader(segmentIndex)->serial == serial) ) {
+                _imp->eraseRecord(found);
+            }
+        }
+        return false;
+    }
+    return true;
+} // restoreTile
+
+void
+CompressedTilesStorage::removeTile(U64 tileHash)
+{
+    boost::unique_lock<boost::mutex> k(_imp->lock);
+    RecordsMap::iterator found = _imp->records.find(tileHash);
+    if ( found != _imp->records.end() ) {
+        _imp->eraseRecord(found);
+    }
+}
+
+void
+CompressedTilesStorage::clear()
+{
+    boost::unique_lock<boost::mutex> k(_imp->lock);
+    int nSegments = (int)_imp->segments.size();
+    _imp->closeSegments(true);
+    if (nSegments > 0) {
+        _imp->openSegments(nSegments);
+    }
+}
+
+void
+CompressedTilesStorage::getStats(std::size_t* nTiles, std::size_t* nCompressedBytes, std::size_t* nUncompressedBytes) const
+{
+    boost::unique_lock<boost::mutex> k(_imp->lock);
+    *nTiles = _imp->records.size();
+    *nCompressedBytes = _imp->nCompressedBytes;
+    *nUncompressedBytes = _imp->nUncompressedBytes;
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,123 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_COMPRESSEDTILESSTORAGE_H
+#define NATRON_ENGINE_COMPRESSEDTILESSTORAGE_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <string>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+struct CompressedTilesStoragePrivate;
+
+/**
+ * @brief A second tier for the tiles of the persistent cache: tiles evicted from the cache
+ * are compressed with TileCompression and appended to a log of memory mapped files on disk.
+ * When the log is full, the oldest segment is recycled, dropping the tiles it contained.
+ * Tiles are identified by the TileHash they were allocated with, hence a tile can be restored
+ * for the same image entry even after the entry was evicted from the cache.
+ *
+ * The segments are scanned when opening the storage so that the compressed tiles survive
+ * across sessions. All functions are thread-safe.
+ **/
+class CompressedTilesStorage
+{
+public:
+
+    /**
+     * @brief Creates a storage in the given directory. No file is created until setMaximumSize()
+     * is called with a non zero size.
+     **/
+    CompressedTilesStorage(const std::string& directoryPath);
+
+    ~CompressedTilesStorage();
+
+    /**
+     * @brief Set the maximum size of the files on disk. The size is rounded to a whole number of segments.
+     * If 0, the storage is disabled and its files are removed.
+     * Compressed tiles are preserved as long as the number of segments does not change.
+     **/
+    void setMaximumSize(std::size_t size);
+
+    std::size_t getMaximumSize() const;
+
+    /**
+     * @brief Returns true if setMaximumSize() was called with a non zero size
+     **/
+    bool isEnabled() const;
+
+    /**
+     * @brief Compresses nBytes from data and stores them for the given tile hash, replacing any
+     * previous tile with the same hash.
+     * @param elementSize The size of one element of the tile, @see TileCompression::compress
+     * @returns True if the tile could be stored
+     **/
+    bool insertTile(U64 tileHash, const void* data, std::size_t nBytes, int elementSize);
+
+    /**
+     * @brief Returns true if a tile is stored for the given hash.
+     **/
+    bool containsTile(U64 tileHash) const;
+
+    /**
+     * @brief Decompresses to data the tile stored for the given hash. Data must have room for nBytes.
+     * @param eraseAfterRestore If true, the tile is removed from the storage once decompressed
+     * @returns False if there is no such tile or if its data is corrupted, in which case it is removed.
+     **/
+    bool restoreTile(U64 tileHash, void* data, std::size_t nBytes, bool eraseAfterRestore);
+
+    /**
+     * @brief Removes the tile for the given hash, if any.
+     **/
+    void removeTile(U64 tileHash);
+
+    /**
+     * @brief Removes all tiles.
+     **/
+    void clear();
+
+    /**
+     * @brief Returns the number of tiles currently stored as well as the size they take on disk
+     * and the size they would take uncompressed.
+     **/
+    void getStats(std::size_t* nTiles, std::size_t* nCompressedBytes, std::size_t* nUncompressedBytes) const;
+
+private:
+
+    boost::scoped_ptr<CompressedTilesStoragePrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_COMPRESSEDTILESSTORAGE_H
@@ -156,6 +156,16 @@ ViewerCurrentFrameRequestScheduler::processFrame(const ProcessFrameArgsBase& inA
         QMutexLocker k(&_imp->renderAgeMutex);
         _imp->displayAge = args->age;
     }
+
+    // If this was the last render requested, the viewer is idle: render the frames likely to be displayed next
+    bool hasPendingRenders;
+    {
+        QMutexLocker k(&_imp->currentRendersMutex);
+        hasPendingRenders = !_imp->currentRenders.empty();
+    }
+    if (!hasPendingRenders && !args->results->frames.empty()) {
+        _imp->renderEngine.lock()->prefetchViewerFrames();
+    }
 } // processFrame
 
 void
@@ -423,7 +433,7 @@ ViewerCurrentFrameRequestScheduler::threadLoopOnce(const GenericThreadStartArgsP
     ViewerNodePtr viewerNode =  _imp->viewer.lock()->isEffectViewerNode();
 
     RenderFrameResultsContainerPtr results;
-    ActionRetCodeEnum stat = ViewerDisplayScheduler::createFrameRenderResultsGeneric(viewerNode, shared_from_this(), args->frame, false /*isPlayback*/, args->curStroke, args->viewsToRender, args->enableRenderStats, &results);
+    ActionRetCodeEnum stat = ViewerDisplayScheduler::createFrameRenderResultsGeneric(viewerNode, shared_from_this(), args->frame, eRenderPriorityInteractive, args->curStroke, args->viewsToRender, args->enableRenderStats, &results);
 
     if (isFailureRetCode(stat)) {
         return eThreadStateActive;
@@ -26,6 +26,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <stdexcept>
 
 #if !defined(SBK_RUN) && !defined(Q_MOC_RUN)
@@ -194,6 +195,147 @@ KeyFrame::getRightDerivative() const
     return _rightDerivative;
 }
 
+/************************************CURVESNAPSHOT************************************/
+
+std::size_t
+CurveSnapshot::findSegment(double* t,
+                           std::size_t hint) const
+{
+    assert( !times.empty() );
+    if (isPeriodic) {
+        // Same as KeyFrameInterpolator::ensureIteratorInPeriod
+        const double period = xMax - xMin;
+        const double minKeyFrameX = times.front() + xMin;
+        assert(xMin < xMax);
+        if ( (*t < minKeyFrameX) || (*t > minKeyFrameX + period) ) {
+            *t = std::fmod(*t - minKeyFrameX, period) + minKeyFrameX;
+            if (*t < minKeyFrameX) {
+                *t += period;
+            }
+        }
+    }
+
+    // The segment i contains the times in [times[i - 1], times[i])
+    const std::size_t nKeys = times.size();
+    for (std::size_t i = hint; i <= hint + 1 && i <= nKeys; ++i) {
+        if ( ( (i == 0) || (times[i - 1] <= *t) ) && ( (i == nKeys) || (*t < times[i]) ) ) {
+            return i;
+        }
+    }
+
+    return std::upper_bound(times.begin(), times.end(), *t) - times.begin();
+}
+
+double
+CurveSnapshot::evaluate(std::size_t segment,
+                        double t,
+                        bool clamp) const
+{
+    const CurveSnapshotSegment& s = segments[segment];
+    double v = Interpolation::evaluateCubic(s.coeffs, (t - s.start) / (s.end - s.start));
+
+    if (clamp) {
+        if (v > yMax) {
+            v = yMax;
+        } else if (v < yMin) {
+            v = yMin;
+        }
+    }
+    switch (type) {
+        case eCurveTypeString:
+        case eCurveTypeInt:
+            v = std::floor(v + 0.5);
+            break;
+        case eCurveTypeBool:
+            v = v >= 0.5 ? 1. : 0.;
+            break;
+        default:
+            break;
+    }
+
+    return v;
+}
+
+CurveSnapshotPtr
+CurvePrivate::getSnapshot() const
+{
+    CurveSnapshotPtr ret = boost::atomic_load(&snapshot);
+    if (ret) {
+        return ret;
+    }
+
+    QMutexLocker k(&_lock);
+    // Another thread may have created it while we were waiting for the lock
+    ret = boost::atomic_load(&snapshot);
+    if (!ret) {
+        ret = createSnapshot();
+        boost::atomic_store(&snapshot, ret);
+    }
+
+    return ret;
+}
+
+CurveSnapshotPtr
+CurvePrivate::createSnapshot() const
+{
+    // Must be called with the lock held
+    boost::shared_ptr<CurveSnapshot> ret(new CurveSnapshot);
+
+    ret->type = type;
+    ret->isPeriodic = isPeriodic;
+    ret->xMin = xMin;
+    ret->xMax = xMax;
+    ret->yMin = yMin;
+    ret->yMax = yMax;
+    ret->useCustomInterpolator = interpolator->isCustomInterpolator();
+    ret->keyFrames.assign( keyFrames.begin(), keyFrames.end() );
+    ret->times.reserve( keyFrames.size() );
+    for (KeyFrameSet::const_iterator it = keyFrames.begin(); it != keyFrames.end(); ++it) {
+        ret->times.push_back( it->getTime() );
+    }
+    if ( keyFrames.empty() || ret->useCustomInterpolator ) {
+        return ret;
+    }
+
+    // The segments use the same control points as KeyFrameInterpolator::interParams
+    const std::vector<KeyFrame>& keys = ret->keyFrames;
+    const std::size_t nKeys = keys.size();
+    ret->segments.resize(nKeys + 1);
+    for (std::size_t i = 1; i < nKeys; ++i) {
+        const KeyFrame& cur = keys[i - 1];
+        const KeyFrame& next = keys[i];
+        CurveSnapshotSegment& s = ret->segments[i];
+        Interpolation::getCubicCoefficients(cur.getTime(), cur.getValue(), cur.getRightDerivative(), next.getLeftDerivative(),
+                                            next.getTime(), next.getValue(), cur.getInterpolation(), next.getInterpolation(),
+                                            &s.start, &s.end, s.coeffs);
+    }
+
+    const KeyFrame& first = keys.front();
+    const KeyFrame& last = keys.back();
+    CurveSnapshotSegment& before = ret->segments.front();
+    CurveSnapshotSegment& after = ret->segments.back();
+    if (isPeriodic) {
+        // Both ends interpolate between the last keyframe and the first keyframe of the next period
+        const double period = xMax - xMin;
+        Interpolation::getCubicCoefficients(last.getTime() - period, last.getValue(), last.getRightDerivative(), first.getLeftDerivative(),
+                                            first.getTime(), first.getValue(), last.getInterpolation(), first.getInterpolation(),
+                                            &before.start, &before.end, before.coeffs);
+        Interpolation::getCubicCoefficients(last.getTime(), last.getValue(), last.getRightDerivative(), first.getLeftDerivative(),
+                                            first.getTime() + period, first.getValue(), last.getInterpolation(), first.getInterpolation(),
+                                            &after.start, &after.end, after.coeffs);
+    } else {
+        // Extrapolate with virtual keyframes 1 frame before the first and after the last
+        Interpolation::getCubicCoefficients(first.getTime() - 1., 0., 0., first.getLeftDerivative(),
+                                            first.getTime(), first.getValue(), eKeyframeTypeNone, first.getInterpolation(),
+                                            &before.start, &before.end, before.coeffs);
+        Interpolation::getCubicCoefficients(last.getTime(), last.getValue(), last.getRightDerivative(), 0.,
+                                            last.getTime() + 1., 0., last.getInterpolation(), eKeyframeTypeNone,
+                                            &after.start, &after.end, after.coeffs);
+    }
+
+    return ret;
+} // createSnapshot
+
 /************************************CURVEPATH************************************/
 
 Curve::Curve(CurveTypeEnum type)
@@ -255,6 +397,7 @@ Curve::setInterpolator(const KeyFrameInterpolatorPtr& interpolator)
     }
     QMutexLocker l(&_imp->_lock);
     _imp->interpolator = interpolator;
+    _imp->invalidateSnapshot();
 }
 
 void
@@ -263,6 +406,7 @@ Curve::setPeriodic(bool periodic)
     QMutexLocker k(&_imp->_lock);
     _imp->isPeriodic = periodic;
     _imp->keyFrames.clear();
+    _imp->invalidateSnapshot();
 }
 
 bool
@@ -283,6 +427,7 @@ Curve::clearKeyFrames()
     QMutexLocker l(&_imp->_lock);
 
     _imp->keyFrames.clear();
+    _imp->invalidateSnapshot();
 }
 
 bool
@@ -365,6 +510,7 @@ Curve::clone(const Curve & other)
 
         _imp->keyFrames.clear();
         _imp->keyFrames.insert( otherKeys.begin(), otherKeys.end() );
+        _imp->invalidateSnapshot();
         if (!listeners.empty()) {
             newKeys.reset(new KeyFrameSet);
             *newKeys = _imp->keyFrames;
@@ -393,6 +539,7 @@ Curve::cloneIndexRange(const Curve& other, int firstKeyIdx, int nKeys)
         }
 
         _imp->keyFrames.clear();
+        _imp->invalidateSnapshot();
         if (firstKeyIdx >= (int)otherKeys.size()) {
             if (!listeners.empty()) {
                 l.unlock();
@@ -411,6 +558,7 @@ Curve::cloneIndexRange(const Curve& other, int firstKeyIdx, int nKeys)
             std::advance(end, nKeys);
         }
         _imp->keyFrames.insert(start, end);
+        _imp->invalidateSnapshot();
         if (!listeners.empty()) {
             newKeys.reset(new KeyFrameSet);
             *newKeys = _imp->keyFrames;
@@ -454,6 +602,7 @@ Curve::cloneAndCheckIfChanged(const Curve& other, double offset, const RangeD* r
         KeyFrameSet::iterator oit = tmpSet.begin();
 
         _imp->keyFrames.clear();
+        _imp->invalidateSnapshot();
         for (KeyFrameSet::iterator it = otherKeys.begin(); it != otherKeys.end(); ++it) {
             TimeValue time = it->getTime();
             if ( range && ( (time < range->min) || (time > range->max) ) ) {
@@ -503,6 +652,7 @@ Curve::clone(const Curve & other,
             *oldKeys = _imp->keyFrames;
         }
         _imp->keyFrames.clear();
+        _imp->invalidateSnapshot();
         for (KeyFrameSet::iterator it = otherKeys.begin(); it != otherKeys.end(); ++it) {
             TimeValue time = it->getTime();
             if ( copyRange && ( (time < range->min) || (time > range->max) ) ) {
@@ -650,6 +800,7 @@ std::pair<KeyFrameSet::iterator, ValueChangedReturnCodeEnum> Curve::setOrUpdateK
     // PRIVATE - should not lock
     if (_imp->clampKeyFramesTimeToIntegers) {
         std::pair<KeyFrameSet::iterator, bool> newKey = _imp->keyFrames.insert(cp);
+        _imp->invalidateSnapshot();
         // keyframe at this time exists, erase and insert again
         if (newKey.second) {
             return std::make_pair(newKey.first, eValueChangedReturnCodeKeyframeAdded);
@@ -662,6 +813,7 @@ std::pair<KeyFrameSet::iterator, ValueChangedReturnCodeEnum> Curve::setOrUpdateK
             }
             _imp->keyFrames.erase(newKey.first);
             newKey = _imp->keyFrames.insert(tmp);
+            _imp->invalidateSnapshot();
             assert(newKey.second);
             return std::make_pair(newKey.first,  eValueChangedReturnCodeKeyframeModified);
 
@@ -680,11 +832,13 @@ std::pair<KeyFrameSet::iterator, ValueChangedReturnCodeEnum> Curve::setOrUpdateK
                 }
 
                 _imp->keyFrames.erase(it);
+                _imp->invalidateSnapshot();
                 retCode = eValueChangedReturnCodeKeyframeModified;
                 break;
             }
         }
         std::pair<KeyFrameSet::iterator, bool> newKey = _imp->keyFrames.insert(tmp);
+        _imp->invalidateSnapshot();
         return std::make_pair(newKey.first, retCode);
     }
 } // setOrUpdateKeyframeInternal
@@ -756,6 +910,7 @@ Curve::removeKeyFrame(KeyFrameSet::const_iterator it)
 
     KeyFrame removedKey = *it;
     _imp->keyFrames.erase(it);
+    _imp->invalidateSnapshot();
 
     if (mustRefreshPrev) {
         refreshDerivatives( eCurveChangedReasonDerivativesChanged, find( prevKey.getTime(), _imp->keyFrames.end()) );
@@ -828,6 +983,7 @@ Curve::removeKeyFramesBeforeTime(TimeValue time,
         }
 
         _imp->keyFrames = newSet;
+        _imp->invalidateSnapshot();
         if ( !_imp->keyFrames.empty() ) {
             refreshDerivatives( Curve::eCurveChangedReasonKeyframeChanged, _imp->keyFrames.begin() );
         }
@@ -867,6 +1023,7 @@ Curve::removeKeyFramesAfterTime(TimeValue time,
         }
 
         _imp->keyFrames = newSet;
+        _imp->invalidateSnapshot();
         if ( !_imp->keyFrames.empty() ) {
             KeyFrameSet::iterator last = _imp->keyFrames.end();
             --last;
@@ -1033,6 +1190,72 @@ Curve::getKeyFrameWithTime(TimeValue time,
 KeyFrame
 Curve::getValueAt(TimeValue t,
                   bool doClamp) const
+{
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
+
+    if ( snapshot->keyFrames.empty() ) {
+        // A curve with no control points is considered to be 0
+        // this is to avoid returning StatFailed when KnobParametric::getValue() is called on a parametric curve without control point.
+        return KeyFrame(t, 0.);
+    }
+    if (snapshot->useCustomInterpolator) {
+        return getValueAtWithInterpolator(t, doClamp);
+    }
+
+    double time = t;
+    const std::size_t segment = snapshot->findSegment(&time, 0);
+    const std::size_t nKeys = snapshot->keyFrames.size();
+
+    // Properties don't follow an interpolation unlike the value of the keyframe, thus copy the properties
+    // of the keyframe before t, as KeyFrameInterpolator::interpolate does
+    KeyFrame value;
+    if ( (segment == 0) && !snapshot->isPeriodic ) {
+        value.cloneProperties( snapshot->keyFrames.front() );
+        value.setRightDerivative(0.);
+        value.setInterpolation(eKeyframeTypeNone);
+    } else if ( (segment == 0) || (segment == nKeys) ) {
+        value = snapshot->keyFrames.back();
+    } else {
+        value = snapshot->keyFrames[segment - 1];
+    }
+    value.setTime( TimeValue(time) );
+    value.setValue( snapshot->evaluate(segment, time, doClamp) );
+
+    return value;
+} // getValueAt
+
+void
+Curve::getValuesAt(const TimeValue* times,
+                   std::size_t count,
+                   double* values,
+                   bool doClamp) const
+{
+    CurveSnapshotPtr snapshot = _imp->getSnapshot();
+
+    if ( snapshot->keyFrames.empty() ) {
+        std::fill(values, values + count, 0.);
+
+        return;
+    }
+    if (snapshot->useCustomInterpolator) {
+        for (std::size_t i = 0; i < count; ++i) {
+            values[i] = getValueAtWithInterpolator(times[i], doClamp).getValue();
+        }
+
+        return;
+    }
+
+    std::size_t segment = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        double time = times[i];
+        segment = snapshot->findSegment(&time, segment);
+        values[i] = snapshot->evaluate(segment, time, doClamp);
+    }
+} // getValuesAt
+
+KeyFrame
+Curve::getValueAtWithInterpolator(TimeValue t,
+                                  bool doClamp) const
 {
     QMutexLocker l(&_imp->_lock);
 
@@ -1087,7 +1310,7 @@ Curve::getValueAt(TimeValue t,
         value.setValue(v);
     }
     return value;
-} // getValueAt
+} // getValueAtWithInterpolator
 
 double
 Curve::getDerivativeAt(TimeValue t) const
@@ -1293,6 +1516,7 @@ Curve::setXRange(double a,
 
     _imp->xMin = a;
     _imp->xMax = b;
+    _imp->invalidateSnapshot();
 }
 
 std::pair<double, double> Curve::getXRange() const
@@ -1330,6 +1554,7 @@ Curve::setKeyFrameValueAndTimeNoUpdate(double value,
     newKey.setTime(time);
     newKey.setValue(value);
     _imp->keyFrames.erase(k);
+    _imp->invalidateSnapshot();
 
     return setOrUpdateKeyframeInternal(newKey).first;
 }
@@ -1540,6 +1765,7 @@ Curve::transformKeyframesValueAndTime(const std::list<double>& times,
 
         // Now move finalSet to the member keyframes
         _imp->keyFrames.clear();
+        _imp->invalidateSnapshot();
         for (KeyFrameSet::const_iterator it = finalSet.begin();
              it != finalSet.end();
              ++it) {
@@ -1877,11 +2103,13 @@ Curve::refreshDerivatives(Curve::CurveChangedReasonEnum reason,
     newKey.setRightDerivative(vcurDerivRight);
 
     std::pair<KeyFrameSet::iterator, bool> newKeyIt = _imp->keyFrames.insert(newKey);
+    _imp->invalidateSnapshot();
 
     // keyframe at this time exists, erase and insert again
     if (!newKeyIt.second) {
         _imp->keyFrames.erase(newKeyIt.first);
         newKeyIt = _imp->keyFrames.insert(newKey);
+        _imp->invalidateSnapshot();
         assert(newKeyIt.second);
     }
     key = newKeyIt.first;
@@ -2055,12 +2283,13 @@ Curve::setYRange(double yMin,
 
     _imp->yMin = yMin;
     _imp->yMax = yMax;
+    _imp->invalidateSnapshot();
 }
 
 void
 Curve::onCurveChanged()
 {
-
+    _imp->invalidateSnapshot();
 }
 
 void
@@ -2077,6 +2306,7 @@ Curve::fromSerialization(const SERIALIZATION_NAMESPACE::SerializationObjectBase&
 
 
         _imp->keyFrames.clear();
+        _imp->invalidateSnapshot();
         for (std::list<SERIALIZATION_NAMESPACE::KeyFrameSerialization>::const_iterator it = s->keys.begin(); it != s->keys.end(); ++it) {
             KeyFrame k;
             k.setTime(TimeValue(it->time));
@@ -2320,8 +2550,10 @@ Curve::setKeyframesInternal(const KeyFrameSet& keys, bool refreshDerivatives)
 
     if (!refreshDerivatives) {
         _imp->keyFrames = keys;
+        _imp->invalidateSnapshot();
     } else {
         _imp->keyFrames.clear();
+        _imp->invalidateSnapshot();
 
         // Now recompute auto tangents
         for (KeyFrameSet::iterator it = keys.begin(); it != keys.end(); ++it) {
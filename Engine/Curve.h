@@ -366,6 +366,12 @@ public:
      **/
     KeyFrame getValueAt(TimeValue t, bool clamp = true) const WARN_UNUSED_RETURN;
 
+    /**
+     * @brief Same as getValueAt(times[i], clamp).getValue() for each of the count times, into values.
+     * This is much faster to sample a curve, in particular when the times are increasing.
+     **/
+    void getValuesAt(const TimeValue* times, std::size_t count, double* values, bool clamp = true) const;
+
     double getDerivativeAt(TimeValue t) const WARN_UNUSED_RETURN;
 
     double getIntegrateFromTo(TimeValue t1, TimeValue t2) const WARN_UNUSED_RETURN;
@@ -706,6 +712,8 @@ private:
      **/
     void onCurveChanged();
 
+    KeyFrame getValueAtWithInterpolator(TimeValue t, bool clamp) const;
+
 private:
     boost::scoped_ptr<CurvePrivate> _imp;
 };
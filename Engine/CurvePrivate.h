@@ -31,6 +31,8 @@
 #include <boost/shared_ptr.hpp>
 #endif
 
+#include <vector>
+
 #include <QtCore/QMutex>
 
 #include "Engine/Variant.h"
@@ -46,8 +48,67 @@
 
 NATRON_NAMESPACE_ENTER
 
+// A segment of a CurveSnapshot: the value at time t is Interpolation::evaluateCubic(coeffs, (t - start) / (end - start))
+struct CurveSnapshotSegment
+{
+    double start, end;
+    double coeffs[4];
+};
+
+/**
+ * @brief An immutable copy of a curve, laid out to be evaluated quickly: the keyframe times are in a contiguous sorted
+ * array and the cubic of each segment between two keyframes is computed once when the snapshot is created.
+ * The curve publishes a snapshot after each change so that getValueAt() never takes the curve lock.
+ **/
+struct CurveSnapshot
+{
+    // The sorted keyframe times
+    std::vector<double> times;
+
+    // segments[0] is before the first keyframe, segments[i] is between keyframes i - 1 and i
+    // and segments[times.size()] is after the last keyframe
+    std::vector<CurveSnapshotSegment> segments;
+
+    // The keyframes, getValueAt() returns the properties of the keyframe before the given time
+    std::vector<KeyFrame> keyFrames;
+
+    CurveTypeEnum type;
+    bool isPeriodic;
+    double xMin, xMax;
+    double yMin, yMax;
+
+    // True if the curve has a custom interpolator: segments is then empty and the curve
+    // must be evaluated by the interpolator
+    bool useCustomInterpolator;
+
+    CurveSnapshot()
+    : times()
+    , segments()
+    , keyFrames()
+    , type(eCurveTypeDouble)
+    , isPeriodic(false)
+    , xMin(0)
+    , xMax(0)
+    , yMin(0)
+    , yMax(0)
+    , useCustomInterpolator(false)
+    {
+    }
 
+    /**
+     * @brief Returns the index of the segment containing t. For a periodic curve, t is first brought back in the period.
+     * @param hint The segment returned for the previous time evaluated: when evaluating increasing times
+     * the segment is most often the same or the next one and no search is needed.
+     **/
+    std::size_t findSegment(double* t, std::size_t hint) const;
+
+    /**
+     * @brief Returns the value at t, in the given segment, clamped and rounded like Curve::getValueAt().
+     **/
+    double evaluate(std::size_t segment, double t, bool clamp) const;
+};
 
+typedef boost::shared_ptr<const CurveSnapshot> CurveSnapshotPtr;
 
 struct CurvePrivate
 {
@@ -64,6 +125,10 @@ struct CurvePrivate
     bool isPeriodic;
     bool clampKeyFramesTimeToIntegers;
 
+    // Created on demand from the members above and reset whenever they change.
+    // Only accessed with boost::atomic_load and boost::atomic_store so that it can be read without the lock.
+    mutable CurveSnapshotPtr snapshot;
+
     CurvePrivate()
     : keyFrames()
     , interpolator(new KeyFrameInterpolator)
@@ -78,6 +143,7 @@ struct CurvePrivate
     , _lock(QMutex::Recursive)
     , isPeriodic(false)
     , clampKeyFramesTimeToIntegers(true)
+    , snapshot()
     {
     }
 
@@ -101,10 +167,26 @@ struct CurvePrivate
         displayMax = other.displayMax;
         isPeriodic = other.isPeriodic;
         clampKeyFramesTimeToIntegers = other.clampKeyFramesTimeToIntegers;
+        invalidateSnapshot();
+    }
+
+    /**
+     * @brief Must be called with the lock held after any change to the curve.
+     **/
+    void invalidateSnapshot()
+    {
+        boost::atomic_store( &snapshot, CurveSnapshotPtr() );
     }
 
+    /**
+     * @brief Returns the current snapshot of the curve, creating it if the curve changed. This only takes the lock
+     * to create the snapshot.
+     **/
+    CurveSnapshotPtr getSnapshot() const;
+
+private:
 
-    
+    CurveSnapshotPtr createSnapshot() const;
 };
 
 NATRON_NAMESPACE_EXIT
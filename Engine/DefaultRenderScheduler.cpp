@@ -34,6 +34,7 @@
 #include "Engine/EffectInstance.h"
 #include "Engine/Node.h"
 #include "Engine/RenderEngine.h"
+#include "Engine/Settings.h"
 #include "Engine/Timer.h"
 #include "Engine/TreeRender.h"
 #include "Engine/WriteNode.h"
@@ -176,6 +177,7 @@ DefaultScheduler::createFrameRenderResults(TimeValue time, const std::vector<Vie
             args->stats = stats;
             args->draftMode = false;
             args->playback = true;
+            args->priority = eRenderPriorityBatch;
             args->byPassCache = false;
 
             subResults->render = TreeRender::create(args);
@@ -359,6 +361,12 @@ DefaultScheduler::onRenderFailed(ActionRetCodeEnum status)
     }
 }
 
+bool
+DefaultScheduler::isRenderPipeliningEnabled() const
+{
+    return appPTR->getCurrentSettings()->isRenderPipeliningEnabled();
+}
+
 void
 DefaultScheduler::aboutToStartRender()
 {
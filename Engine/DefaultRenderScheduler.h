@@ -71,6 +71,7 @@ private:
     virtual void onRenderFailed(ActionRetCodeEnum status) OVERRIDE FINAL;
     virtual void aboutToStartRender() OVERRIDE FINAL;
     virtual void onRenderStopped(bool aborted) OVERRIDE FINAL;
+    virtual bool isRenderPipeliningEnabled() const OVERRIDE FINAL;
 
 private:
 
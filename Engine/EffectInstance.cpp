@@ -168,8 +168,15 @@ EffectInstance::createRenderCopy(const FrameViewRenderKey& key) const
     }
 
     EffectInstancePtr clone = createFunc(boost::const_pointer_cast<EffectInstance>(shared_from_this()), key);
-    
+    createRenderCloneInputs(clone, key);
 
+    return clone;
+}
+
+void
+EffectInstance::createRenderCloneInputs(const EffectInstancePtr& clone,
+                                        const FrameViewRenderKey& key) const
+{
     // Make a copy of the main instance input locally so the state of the graph does not change throughout the render
     int nInputs = getNInputs();
 
@@ -188,8 +195,33 @@ EffectInstance::createRenderCopy(const FrameViewRenderKey& key) const
 
         }
     }
+}
 
-    return clone;
+void
+EffectInstance::releaseRenderCloneData()
+{
+    KnobHolder::releaseRenderCloneData();
+
+    // Release the requests, results and input clones of the finished render, as well as the node
+    // so that a recycled clone does not keep it alive
+    _imp->renderData.reset(new RenderCloneData);
+}
+
+void
+EffectInstance::recycleRenderCopy(const KnobHolderPtr& clone,
+                                  const FrameViewRenderKey& key) const
+{
+    KnobHolder::recycleRenderCopy(clone, key);
+
+    EffectInstancePtr effectClone = toEffectInstance(clone);
+    assert(effectClone);
+    effectClone->_imp->renderData->node = getNode();
+    {
+        // The previous render may have changed the description of the clone
+        QMutexLocker k(&_imp->common->pluginsPropMutex);
+        effectClone->_imp->descriptionPtr->cloneProperties(*_imp->common->descriptor);
+    }
+    createRenderCloneInputs(effectClone, key);
 }
 
 RenderEnginePtr
@@ -866,6 +898,7 @@ EffectInstance::getImagePlane(const GetImageInArgs& inArgs, GetImageOutArgs* out
             }
             rargs->draftMode = isDraftMode;
             rargs->playback = isPlayback;
+            rargs->priority = currentRender ? currentRender->getPriority() : eRenderPriorityInteractive;
             rargs->byPassCache = false;
             TreeRenderPtr renderObject = TreeRender::create(rargs);
             if (!currentRender) {
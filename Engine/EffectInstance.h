@@ -786,6 +786,35 @@ public:
      **/
     ActionRetCodeEnum getFramesNeeded_public(TimeValue time, ViewIdx view, GetFramesNeededResultsPtr* results);
 
+    struct ActionCacheStats
+    {
+        // Number of times the getRegionsOfInterest action was called
+        U64 nRoICalls;
+
+        // Number of times the results of getRegionsOfInterest were found in the cache instead
+        U64 nRoICallsSaved;
+
+        // Number of times the getFramesNeeded action was called
+        U64 nFramesNeededCalls;
+
+        // Number of times the results of getFramesNeeded were found in the cache instead
+        U64 nFramesNeededCallsSaved;
+
+        ActionCacheStats()
+        : nRoICalls(0)
+        , nRoICallsSaved(0)
+        , nFramesNeededCalls(0)
+        , nFramesNeededCallsSaved(0)
+        {
+        }
+    };
+
+    /**
+     * @brief Returns how many calls to the getRegionsOfInterest and getFramesNeeded actions were made
+     * by this effect and its render clones, and how many were avoided thanks to the cache.
+     **/
+    void getActionCacheStats(ActionCacheStats* stats) const;
+
 protected:
 
 
@@ -1161,6 +1190,15 @@ public:
         return true;
     }
 
+    /**
+     * @brief Render clones of effects hold no state other than their RenderCloneData, they
+     * may be recycled by later renders
+     **/
+    virtual bool isRenderCloneRecyclable() const OVERRIDE
+    {
+        return true;
+    }
+
     //// Static properties
 
     /**
@@ -1343,9 +1381,16 @@ protected:
     // Overriden from KnobHolder when creating a render clone
     virtual KnobHolderPtr createRenderCopy(const FrameViewRenderKey& key) const OVERRIDE;
 
+    // Overriden from KnobHolder when recycling a render clone
+    virtual void releaseRenderCloneData() OVERRIDE;
+    virtual void recycleRenderCopy(const KnobHolderPtr& clone, const FrameViewRenderKey& key) const OVERRIDE;
+
 
 private:
 
+    // Fetch the render clones of the inputs of the given render clone of this effect
+    void createRenderCloneInputs(const EffectInstancePtr& clone, const FrameViewRenderKey& key) const;
+
     ActionRetCodeEnum launchRenderInternal(const TreeRenderExecutionDataPtr& requestPassSharedData, const FrameViewRequestPtr& requestData);
 
 
@@ -271,6 +271,60 @@ GetFramesNeededResults::fromMemorySegment(bool /*isLockedForWriting*/,
 
 
 
+void
+GetRegionsOfInterestKey::appendToHash(Hash64* hash) const
+{
+    EffectInstanceActionKeyBase::appendToHash(hash);
+    hash->append(_renderWindow.x1);
+    hash->append(_renderWindow.y1);
+    hash->append(_renderWindow.x2);
+    hash->append(_renderWindow.y2);
+}
+
+GetRegionsOfInterestResults::GetRegionsOfInterestResults()
+: CacheEntryBase(appPTR->getGeneralPurposeCache())
+, _rois()
+{
+
+}
+
+GetRegionsOfInterestResultsPtr
+GetRegionsOfInterestResults::create(const GetRegionsOfInterestKeyPtr& key)
+{
+    GetRegionsOfInterestResultsPtr ret(new GetRegionsOfInterestResults());
+    ret->setKey(key);
+    return ret;
+
+}
+
+void
+GetRegionsOfInterestResults::getRegionsOfInterest(std::map<int, RectD>* rois) const
+{
+    *rois = _rois;
+}
+
+void
+GetRegionsOfInterestResults::setRegionsOfInterest(const std::map<int, RectD>& rois)
+{
+    _rois = rois;
+}
+
+void
+GetRegionsOfInterestResults::toMemorySegment(IPCPropertyMap* /*properties*/) const
+{
+    assert(false);
+    throw std::runtime_error("GetRegionsOfInterestResults::toMemorySegment serialization to a persistent cache unimplemented");
+} // toMemorySegment
+
+CacheEntryBase::FromMemorySegmentRetCodeEnum
+GetRegionsOfInterestResults::fromMemorySegment(bool /*isLockedForWriting*/,
+                                               const IPCPropertyMap& /*properties*/)
+{
+    assert(false);
+    throw std::runtime_error("GetRegionsOfInterestResults::fromMemorySegment serialization from a persistent cache unimplemented");
+} // fromMemorySegment
+
+
 GetFrameRangeResults::GetFrameRangeResults()
 : CacheEntryBase(appPTR->getGeneralPurposeCache())
 , _range()
@@ -369,6 +369,79 @@ toGetFramesNeededResults(const CacheEntryBasePtr& entry)
 }
 
 
+class GetRegionsOfInterestKey : public EffectInstanceActionKeyBase
+{
+public:
+
+    GetRegionsOfInterestKey(U64 nodeTimeViewVariantHash,
+                            const RenderScale& scale,
+                            const RectD& renderWindow,
+                            const std::string& pluginID)
+    : EffectInstanceActionKeyBase(nodeTimeViewVariantHash, scale, pluginID)
+    , _renderWindow(renderWindow)
+    {
+
+    }
+
+    virtual ~GetRegionsOfInterestKey()
+    {
+
+    }
+
+    virtual int getUniqueID() const OVERRIDE FINAL
+    {
+        return kCacheKeyUniqueIDGetRegionsOfInterestResults;
+    }
+
+private:
+
+    virtual void appendToHash(Hash64* hash) const OVERRIDE FINAL;
+
+    // The regions of interest depend on the window rendered, in canonical coordinates
+    RectD _renderWindow;
+};
+
+
+class GetRegionsOfInterestResults : public CacheEntryBase
+{
+    GetRegionsOfInterestResults();
+
+public:
+
+    static GetRegionsOfInterestResultsPtr create(const GetRegionsOfInterestKeyPtr& key);
+
+    virtual ~GetRegionsOfInterestResults()
+    {
+
+    }
+
+    // This is thread-safe and doesn't require a mutex:
+    // The thread computing this entry and calling the setter is guaranteed
+    // to be the only one interacting with this object. Then all objects
+    // should call the getter.
+    //
+    // The regions of interest of each input, in canonical coordinates
+    void getRegionsOfInterest(std::map<int, RectD>* rois) const;
+    void setRegionsOfInterest(const std::map<int, RectD>& rois);
+
+    virtual void toMemorySegment(IPCPropertyMap* properties) const OVERRIDE FINAL;
+
+    virtual CacheEntryBase::FromMemorySegmentRetCodeEnum fromMemorySegment(bool isLockedForWriting,
+                                                                           const IPCPropertyMap& properties) OVERRIDE FINAL;
+
+private:
+
+    std::map<int, RectD> _rois;
+
+};
+
+inline GetRegionsOfInterestResultsPtr
+toGetRegionsOfInterestResults(const CacheEntryBasePtr& entry)
+{
+    return boost::dynamic_pointer_cast<GetRegionsOfInterestResults>(entry);
+}
+
+
 class GetFrameRangeKey : public EffectInstanceActionKeyBase
 {
 public:
@@ -40,6 +40,7 @@
 #include "Engine/Node.h"
 #include "Engine/NodeMetadata.h"
 #include "Engine/Project.h"
+#include "Engine/RenderTracer.h"
 #include "Engine/ThreadPool.h"
 
 
@@ -300,7 +301,11 @@ EffectInstance::getComponentsNeededInternal(TimeValue time,
     // call the getClipComponents action
     
 
-    ActionRetCodeEnum stat = getLayersProducedAndNeeded(time, view, inputLayersNeeded, layersProduced, passThroughTime, passThroughView, passThroughInputNb);
+    ActionRetCodeEnum stat;
+    {
+        NATRON_RENDER_TRACE_SCOPE_DETAIL("action", "getLayersProducedAndNeeded", getScriptName_mt_safe());
+        stat = getLayersProducedAndNeeded(time, view, inputLayersNeeded, layersProduced, passThroughTime, passThroughView, passThroughInputNb);
+    }
     if (isFailureRetCode(stat)) {
         return stat;
     } else if (stat == eActionStatusReplyDefault) {
@@ -696,6 +701,7 @@ EffectInstance::render_public(const RenderActionArgs & args)
 {
 
     REPORT_CURRENT_THREAD_ACTION( kOfxImageEffectActionRender, getNode() );
+    NATRON_RENDER_TRACE_SCOPE_DETAIL("action", "render", getScriptName_mt_safe());
 
     // Each render clone should hold the time and view passed to the render action
     assert(args.time == getCurrentRenderTime());
@@ -986,7 +992,11 @@ EffectInstance::isIdentity_public(bool useIdentityCache, // only set to true whe
             canonicalRenderWindow.toPixelEnclosing(mappedScale, par, &mappedRenderWindow);
         }
 
-        ActionRetCodeEnum stat = isIdentity(time, mappedScale, mappedRenderWindow, view, inputPlane, &identityTime, &identityView, &identityInputNb, &identityPlane);
+        ActionRetCodeEnum stat;
+        {
+            NATRON_RENDER_TRACE_SCOPE_DETAIL("action", "isIdentity", getScriptName_mt_safe());
+            stat = isIdentity(time, mappedScale, mappedRenderWindow, view, inputPlane, &identityTime, &identityView, &identityInputNb, &identityPlane);
+        }
         if (isFailureRetCode(stat)) {
             return stat;
         }
@@ -1149,7 +1159,11 @@ EffectInstance::getRegionOfDefinition_public(TimeValue inArgsTime,
 
 
             RectD rod;
-            ActionRetCodeEnum stat = getRegionOfDefinition(time, mappedScale, view, &rod);
+            ActionRetCodeEnum stat;
+            {
+                NATRON_RENDER_TRACE_SCOPE_DETAIL("action", "getRegionOfDefinition", getScriptName_mt_safe());
+                stat = getRegionOfDefinition(time, mappedScale, view, &rod);
+            }
 
             if (isFailureRetCode(stat)) {
                 return stat;
@@ -1362,6 +1376,51 @@ EffectInstance::getRegionsOfInterest_public(TimeValue inArgsTime,
 
     assert(renderWindow.x2 >= renderWindow.x1 && renderWindow.y2 >= renderWindow.y1);
 
+    // Snap the render window outwards to pixels at the render scale, so that windows differing
+    // only by a fraction of a pixel share the same results. The regions of interest may only be a bit larger.
+    RectD quantizedWindow = renderWindow;
+    if ( !renderWindow.isInfinite() ) {
+        double par = getAspectRatio(-1);
+        RectI pixelWindow;
+        renderWindow.toPixelEnclosing(scale, par, &pixelWindow);
+        pixelWindow.toCanonical_noClipping(scale, par, &quantizedWindow);
+    }
+
+    // Get a hash to cache the results
+    U64 hash;
+    {
+        ComputeHashArgs hashArgs;
+        hashArgs.time = time;
+        hashArgs.view = view;
+        hashArgs.hashType = HashableObject::eComputeHashTypeTimeViewVariant;
+        hash = computeHash(hashArgs);
+    }
+
+    GetRegionsOfInterestKeyPtr cacheKey( new GetRegionsOfInterestKey(hash, scale, quantizedWindow, getNode()->getPluginID()) );
+    GetRegionsOfInterestResultsPtr results = GetRegionsOfInterestResults::create(cacheKey);
+
+    // Ensure the cache fetcher lives as long as we compute the action
+    CacheEntryLockerBasePtr cacheAccess = results->getFromCache();
+    {
+        CacheEntryLockerBase::CacheEntryStatusEnum cacheStatus = cacheAccess->getStatus();
+        while (cacheStatus == CacheEntryLockerBase::eCacheEntryStatusComputationPending) {
+            cacheStatus = cacheAccess->waitForPendingEntry();
+        }
+
+        if (cacheStatus == CacheEntryLockerBase::eCacheEntryStatusCached) {
+            if (!cacheAccess->isPersistent()) {
+                results = toGetRegionsOfInterestResults(cacheAccess->getProcessLocalEntry());
+            }
+            results->getRegionsOfInterest(ret);
+            {
+                QMutexLocker k(&_imp->common->actionCacheStatsMutex);
+                ++_imp->common->actionCacheStats.nRoICallsSaved;
+            }
+            return eActionStatusOK;
+        }
+        assert(cacheStatus == CacheEntryLockerBase::eCacheEntryStatusMustCompute);
+    }
+
     int nInputs = getNInputs();
     for (int i = 0; i < nInputs; ++i) {
         if (!getNode()->isInputHostDescribed(i)) {
@@ -1370,7 +1429,7 @@ EffectInstance::getRegionsOfInterest_public(TimeValue inArgsTime,
         EffectInstancePtr input = getInputMainInstance(i);
         if (input) {
             RectD roi;
-            ActionRetCodeEnum stat = getDefaultRegionOfInterestForInput(input, i, time, scale, renderWindow, view, &roi);
+            ActionRetCodeEnum stat = getDefaultRegionOfInterestForInput(input, i, time, scale, quantizedWindow, view, &roi);
             if (isFailureRetCode(stat)) {
                 return stat;
             }
@@ -1378,7 +1437,23 @@ EffectInstance::getRegionsOfInterest_public(TimeValue inArgsTime,
         }
     }
 
-    return getRegionsOfInterest(time, mappedScale, renderWindow, view, ret);
+    ActionRetCodeEnum stat;
+    {
+        NATRON_RENDER_TRACE_SCOPE_DETAIL("action", "getRegionsOfInterest", getScriptName_mt_safe());
+        stat = getRegionsOfInterest(time, mappedScale, quantizedWindow, view, ret);
+    }
+    {
+        QMutexLocker k(&_imp->common->actionCacheStatsMutex);
+        ++_imp->common->actionCacheStats.nRoICalls;
+    }
+    if (isFailureRetCode(stat)) {
+        return stat;
+    }
+
+    results->setRegionsOfInterest(*ret);
+    cacheAccess->insertInCache();
+
+    return stat;
 
 } // getRegionsOfInterest_public
 
@@ -1487,6 +1562,10 @@ EffectInstance::getFramesNeeded_public(TimeValue inArgsTime,
             if (!cacheAccess->isPersistent()) {
                 *results = toGetFramesNeededResults(cacheAccess->getProcessLocalEntry());
             }
+            {
+                QMutexLocker k(&_imp->common->actionCacheStatsMutex);
+                ++_imp->common->actionCacheStats.nFramesNeededCallsSaved;
+            }
             return eActionStatusOK;
         }
         assert(cacheStatus == CacheEntryLockerBase::eCacheEntryStatusMustCompute);
@@ -1521,7 +1600,15 @@ EffectInstance::getFramesNeeded_public(TimeValue inArgsTime,
         }
 
 
-        ActionRetCodeEnum stat = getFramesNeeded(time, view, &framesNeeded);
+        ActionRetCodeEnum stat;
+        {
+            NATRON_RENDER_TRACE_SCOPE_DETAIL("action", "getFramesNeeded", getScriptName_mt_safe());
+            stat = getFramesNeeded(time, view, &framesNeeded);
+        }
+        {
+            QMutexLocker k(&_imp->common->actionCacheStatsMutex);
+            ++_imp->common->actionCacheStats.nFramesNeededCalls;
+        }
         if (isFailureRetCode(stat)) {
             return stat;
         }
@@ -1587,6 +1674,12 @@ EffectInstance::getFramesNeeded_public(TimeValue inArgsTime,
 
 
 
+void
+EffectInstance::getActionCacheStats(ActionCacheStats* stats) const
+{
+    QMutexLocker k(&_imp->common->actionCacheStatsMutex);
+    *stats = _imp->common->actionCacheStats;
+}
 
 ActionRetCodeEnum
 EffectInstance::getFrameRange(double *first,
@@ -2001,7 +2094,11 @@ EffectInstance::getTimeInvariantMetadata_public(GetTimeInvariantMetadataResultsP
 
         // If the node is disabled, don't call getClipPreferences on the plug-in:
         // we don't want it to change output Format or other metadata
-        ActionRetCodeEnum stat = getTimeInvariantMetadata(*metadata);
+        ActionRetCodeEnum stat;
+        {
+            NATRON_RENDER_TRACE_SCOPE_DETAIL("action", "getTimeInvariantMetadata", getScriptName_mt_safe());
+            stat = getTimeInvariantMetadata(*metadata);
+        }
         if (isFailureRetCode(stat)) {
             return stat;
         }
@@ -30,6 +30,7 @@
 #include <QDebug>
 
 #include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
 #include "Engine/Node.h"
 #include "Engine/NodeGroup.h"
 #include "Engine/OSGLContext.h"
@@ -39,6 +40,7 @@
 #include "Engine/Plugin.h"
 #include "Engine/Project.h"
 #include "Engine/TreeRender.h"
+#include "Engine/TreeRenderQueueManager.h"
 #include "Engine/RenderStats.h"
 #include "Engine/RotoStrokeItem.h"
 #include "Engine/ViewIdx.h"
@@ -271,6 +273,7 @@ EffectInstance::Implementation::launchIsolatedRender(const FrameViewRequestPtr&
     rargs->plane = requestPassData->getPlaneDesc();
     rargs->draftMode = requestPassData->getParentRender()->isDraftRender();
     rargs->playback = requestPassData->getParentRender()->isPlayback();
+    rargs->priority = requestPassData->getParentRender()->getPriority();
     rargs->byPassCache = false;
     TreeRenderPtr renderObject = TreeRender::create(rargs);
     _publicInterface->launchRender(renderObject);
@@ -294,6 +297,11 @@ EffectInstance::Implementation::tiledRenderingFunctor(const RectToRender & rectT
 
     TreeRenderPtr render = _publicInterface->getCurrentRender();
 
+    // Tile boundary: give the thread to renders of a higher priority if they are waiting for one
+    if (args.backendType == eRenderBackendTypeCPU) {
+        appPTR->getTasksQueueManager()->pauseIfPreempted(render);
+    }
+
     // Record the time spend to render for this frame/view for this thread
     TimeLapsePtr timeRecorder;
     RenderStatsPtr stats = render->getStatsObject();
@@ -340,6 +348,10 @@ EffectInstance::Implementation::tiledRenderingFunctor(const RectToRender & rectT
     if (timeRecorder) {
         stats->addRenderInfosForNode(_publicInterface->getNode(), timeRecorder->getTimeSinceCreation());
     }
+
+    if ( _publicInterface->getNode() == render->getOriginalTreeRoot()->getNode() ) {
+        render->notifyFirstPixelRendered();
+    }
     return render->isRenderAborted() ? eActionStatusAborted : eActionStatusOK;
 } // tiledRenderingFunctor
 
@@ -720,34 +732,17 @@ EffectInstance::Implementation::renderHandlerPostProcess(const RectToRender & re
     // Check for NaNs, copy to output image and mark for rendered
     for (std::map<ImagePlaneDesc, ImagePtr>::const_iterator it = args.cachedPlanes.begin(); it != args.cachedPlanes.end(); ++it) {
 
-        if (checkNaNs) {
-
-            bool foundNan = false;
-            ActionRetCodeEnum stat = eActionStatusOK;
+        // When mixing with the original image, NaNs are replaced in the same pass over the pixels as the mix
+        const bool checkNaNsInMaskMix = checkNaNs && useMaskMix;
+        bool foundNan = false;
+        if (checkNaNs && !checkNaNsInMaskMix) {
             if (it->second->getBitDepth() == eImageBitDepthFloat && it->second->getStorageMode() == eStorageModeRAM) {
-                stat = it->second->checkForNaNs(rectToRender.rect, &foundNan);
+                ActionRetCodeEnum stat = it->second->checkForNaNs(rectToRender.rect, &foundNan);
                 if (isFailureRetCode(stat)) {
                     return stat;
                 }
             }
-
-            if (!foundNan) {
-                _publicInterface->getNode()->clearPersistentMessage(kNatronPersistentWarningCheckForNan);
-            } else {
-                QString warning;
-                warning.append( tr("NaN values detected in (") );
-                warning.append( QString::number(rectToRender.rect.x1) );
-                warning.append( QChar::fromLatin1(',') );
-                warning.append( QString::number(rectToRender.rect.y1) );
-                warning.append( QString::fromUtf8(")-(") );
-                warning.append( QString::number(rectToRender.rect.x2) );
-                warning.append( QChar::fromLatin1(',') );
-                warning.append( QString::number(rectToRender.rect.y2) );
-                warning.append( QString::fromUtf8("). ") );
-                warning.append( tr("They have been converted to 1") );
-                _publicInterface->getNode()->setPersistentMessage( eMessageTypeWarning, kNatronPersistentWarningCheckForNan, warning.toStdString() );
-            }
-        } // checkNaNs
+        }
 
         ImagePtr mainInputImage;
         bool copyUnProcessed = it->second->canCallCopyUnProcessedChannels(processChannels);
@@ -781,12 +776,31 @@ EffectInstance::Implementation::renderHandlerPostProcess(const RectToRender & re
 
 
         if (useMaskMix) {
-            ActionRetCodeEnum stat = it->second->applyMaskMix(rectToRender.rect, maskImage, mainInputImage, maskImage.get() /*masked*/, false /*maskInvert*/, mix);
+            ActionRetCodeEnum stat = it->second->applyMaskMix(rectToRender.rect, maskImage, mainInputImage, maskImage.get() /*masked*/, false /*maskInvert*/, mix, checkNaNsInMaskMix ? &foundNan : 0);
             if (isFailureRetCode(stat)) {
                 return stat;
             }
         }
 
+        if (checkNaNs) {
+            if (!foundNan) {
+                _publicInterface->getNode()->clearPersistentMessage(kNatronPersistentWarningCheckForNan);
+            } else {
+                QString warning;
+                warning.append( tr("NaN values detected in (") );
+                warning.append( QString::number(rectToRender.rect.x1) );
+                warning.append( QChar::fromLatin1(',') );
+                warning.append( QString::number(rectToRender.rect.y1) );
+                warning.append( QString::fromUtf8(")-(") );
+                warning.append( QString::number(rectToRender.rect.x2) );
+                warning.append( QChar::fromLatin1(',') );
+                warning.append( QString::number(rectToRender.rect.y2) );
+                warning.append( QString::fromUtf8("). ") );
+                warning.append( tr("They have been converted to 1") );
+                _publicInterface->getNode()->setPersistentMessage( eMessageTypeWarning, kNatronPersistentWarningCheckForNan, warning.toStdString() );
+            }
+        } // checkNaNs
+
         
     } // for each plane to render
     return eActionStatusOK;
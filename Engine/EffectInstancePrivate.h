@@ -204,6 +204,11 @@ struct EffectInstanceCommonData
     // we keep another shared pointer for render clones only, in  RenderCloneData
     NodeWPtr node;
 
+    // Number of calls to the getRegionsOfInterest and getFramesNeeded actions, and of calls that were
+    // not made because the results were found in the cache. Protected by actionCacheStatsMutex
+    mutable QMutex actionCacheStatsMutex;
+    EffectInstance::ActionCacheStats actionCacheStats;
+
     EffectInstanceCommonData()
     : attachedContextsMutex(QMutex::Recursive)
     , attachedContexts()
@@ -216,6 +221,8 @@ struct EffectInstanceCommonData
     , interacts()
     , timelineInteracts()
     , node()
+    , actionCacheStatsMutex()
+    , actionCacheStats()
     {
 
     }
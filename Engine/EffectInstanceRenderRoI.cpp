@@ -912,7 +912,8 @@ EffectInstance::Implementation::handleUpstreamFramesNeeded(const TreeRenderExecu
     RenderScale combinedScale = EffectInstance::getCombinedScale(mipMapLevel, proxyScale);
 
     // Compute the regions of interest in input for this RoI.
-    // The regions of interest returned is only valid for this RoI, we don't cache it. Rather we cache on the input the bounding box
+    // The results are cached for this node hash and RoI in the general purpose cache, so that the action is not called again
+    // on the next render of the same window. We also cache on the input the bounding box
     // of all the calls of getRegionsOfInterest that were made down-stream so that the node gets rendered only once.
     RoIMap inputsRoi;
     {
@@ -1085,6 +1086,9 @@ EffectInstance::requestRender(TimeValue timeInArgs,
     if (!renderClone) {
         return eActionStatusFailed;
     }
+
+    // Evaluate the Python expressions of the clone at once before its actions read the knobs one by one
+    renderClone->evaluatePythonExpressionsForRender();
     if (createdRenderClone) {
         *createdRenderClone = renderClone;
     }
@@ -1601,7 +1605,8 @@ EffectInstance::launchNodeRender(const TreeRenderExecutionDataPtr& requestPassSh
 } // launchNodeRender
 
 static void finishProducedPlanesTilesStatesMap(const std::map<ImagePlaneDesc, ImagePtr>& producedPlanes,
-                                               bool aborted)
+                                               bool aborted,
+                                               double timeSpentRendering = 0.)
 {
     for (std::map<ImagePlaneDesc, ImagePtr>::const_iterator it = producedPlanes.begin(); it!=producedPlanes.end(); ++it) {
         ImageCacheEntryPtr entry = it->second->getCacheEntry();
@@ -1609,6 +1614,9 @@ static void finishProducedPlanesTilesStatesMap(const std::map<ImagePlaneDesc, Im
             entry->markCacheTilesAsAborted();
         } else {
             entry->markCacheTilesAsRendered();
+            if (timeSpentRendering > 0) {
+                entry->addRenderTime(timeSpentRendering);
+            }
         }
     }
 }
@@ -1708,8 +1716,12 @@ EffectInstance::launchRenderInternal(const TreeRenderExecutionDataPtr& requestPa
 
         // There may be no rectangles to render if all rectangles are pending (i.e: this render should wait for another thread
         // to complete the render first)
+        double timeSpentRendering = 0.;
         if (!renderRects.empty()) {
+            // The render time is used by the cache to keep images that are expensive to render
+            TimeLapse renderTimer;
             renderRetCode = _imp->launchRenderForSafetyAndBackend(requestData, mappedCombinedScale, backendType, renderRects, cachedImagePlanes);
+            timeSpentRendering = renderTimer.getTimeSinceCreation();
         }
 
         if (isFailureRetCode(renderRetCode)) {
@@ -1718,7 +1730,7 @@ EffectInstance::launchRenderInternal(const TreeRenderExecutionDataPtr& requestPa
         }
 
         // Mark what we rendered in the tiles state map
-        finishProducedPlanesTilesStatesMap(cachedImagePlanes, false /*aborted*/);
+        finishProducedPlanesTilesStatesMap(cachedImagePlanes, false /*aborted*/, timeSpentRendering);
 
         // Wait for any pending results for the requested plane.
         // After this line other threads that should have computed should be done
@@ -101,9 +101,11 @@ SOURCES += \
     Cache.cpp \
     CacheEntryBase.cpp \
     CacheEntryKeyBase.cpp \
+    CacheEvictionPolicy.cpp \
     CLArgs.cpp \
     CoonsRegularization.cpp \
     ColorParser.cpp \
+    CompressedTilesStorage.cpp \
     CornerPinOverlayInteract.cpp \
     CreateNodeArgs.cpp \
     Curve.cpp \
@@ -146,6 +148,7 @@ SOURCES += \
     ImageCopyChannels.cpp \
     ImageFill.cpp \
     ImagePrivate.cpp \
+    ImageSIMD.cpp \
     ImageMaskMix.cpp \
     ImageStorage.cpp \
     ImageTilesState.cpp \
@@ -228,6 +231,7 @@ SOURCES += \
     RectI.cpp \
     RemovePlaneNode.cpp \
     RenderStats.cpp \
+    RenderTracer.cpp \
     RenderQueue.cpp \
     RenderEngine.cpp \
     RotoBezierTriangulation.cpp \
@@ -254,6 +258,7 @@ SOURCES += \
     TabWidgetI.cpp \
     Texture.cpp \
     ThreadPool.cpp \
+    TileCompression.cpp \
     TimeLine.cpp \
     Timer.cpp \
     TrackArgs.cpp \
@@ -279,6 +284,7 @@ SOURCES += \
     ViewerNodePrivate.cpp \
     ViewerNodeKnobs.cpp \
     ViewerNodeOverlays.cpp \
+    ViewerPrefetchScheduler.cpp \
     ViewIdx.cpp \
     WriteNode.cpp \
     ../Global/glad_source.c \
@@ -359,11 +365,13 @@ HEADERS += \
     Cache.h \
     CacheEntryBase.h \
     CacheEntryKeyBase.h \
+    CacheEvictionPolicy.h \
     CoonsRegularization.h \
     CornerPinOverlayInteract.h \
     ChoiceOption.h \
     Color.h \
     ColorParser.h \
+    CompressedTilesStorage.h \
     CreateNodeArgs.h \
     CurrentFrameRequestScheduler.h \
     Curve.h \
@@ -403,6 +411,7 @@ HEADERS += \
     ImageCacheKey.h \
     ImagePrivate.h \
     ImagePlaneDesc.h \
+    ImageSIMD.h \
     InputDescription.h \
     Interpolation.h \
     IPCCommon.h \
@@ -417,6 +426,7 @@ HEADERS += \
     KnobImpl.h \
     KnobGetValueImpl.h \
     KnobSetValueImpl.h \
+    KnobExpressionResultsCache.h \
     KnobFactory.h \
     KnobFile.h \
     KnobTypes.h \
@@ -493,6 +503,8 @@ HEADERS += \
     RectD.h \
     RectI.h \
     RenderStats.h \
+    RenderTaskScheduling.h \
+    RenderTracer.h \
     RenderQueue.h \
     RotoBezierTriangulation.h \
     RotoDrawableItem.h \
@@ -520,6 +532,7 @@ HEADERS += \
     Texture.h \
     ThreadStorage.h \
     ThreadPool.h \
+    TileCompression.h \
     TimeLine.h \
     TimeLineKeys.h \
     Timer.h \
@@ -548,6 +561,7 @@ HEADERS += \
     ViewerInstance.h \
     ViewerNode.h \
     ViewerNodePrivate.h \
+    ViewerPrefetchScheduler.h \
     ViewIdx.h \
     WriteNode.h \
     ../Global/Enums.h \
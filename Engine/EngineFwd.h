@@ -137,6 +137,7 @@ class CacheSignalEmitter;
 class CacheEntryKeyBase;
 class CacheEntryBase;
 class CacheEntryLockerBase;
+class CacheEvictionPolicy;
 template<bool persistent> class CacheEntryLocker;
 class CompNodeItem;
 class CreateNodeArgs;
@@ -180,6 +181,8 @@ class GetTimeInvariantMetadataKey;
 class GetTimeInvariantMetadataResults;
 class GetComponentsKey;
 class GetComponentsResults;
+class GetRegionsOfInterestKey;
+class GetRegionsOfInterestResults;
 class GroupInput;
 class GroupOutput;
 class HistogramCPUThread;
@@ -316,6 +319,8 @@ class ViewerInstance;
 class ViewerNode;
 class ViewerCurrentFrameRequestScheduler;
 class ViewerCurrentFrameRequestRendererBackup;
+class ViewerPrefetchScheduler;
+class WorkStealingThreadPool;
 class WriteNode;
 
 namespace Color {
@@ -345,6 +350,7 @@ typedef boost::shared_ptr<Curve> CurvePtr;
 typedef boost::shared_ptr<CurveChangesListener> CurveChangesListenerPtr;
 typedef boost::shared_ptr<CacheEntryKeyBase> CacheEntryKeyBasePtr;
 typedef boost::shared_ptr<CacheEntryBase> CacheEntryBasePtr;
+typedef boost::shared_ptr<CacheEvictionPolicy> CacheEvictionPolicyPtr;
 typedef boost::shared_ptr<CreateNodeArgs> CreateNodeArgsPtr;
 typedef boost::shared_ptr<DiskCacheNode> DiskCacheNodePtr;
 typedef boost::shared_ptr<DistortionFunction2D> DistortionFunction2DPtr;
@@ -367,6 +373,8 @@ typedef boost::shared_ptr<GetDistortionResults> GetDistortionResultsPtr;
 typedef boost::shared_ptr<GetDistortionKey> GetDistortionKeyPtr;
 typedef boost::shared_ptr<GetFramesNeededKey> GetFramesNeededKeyPtr;
 typedef boost::shared_ptr<GetFramesNeededResults> GetFramesNeededResultsPtr;
+typedef boost::shared_ptr<GetRegionsOfInterestKey> GetRegionsOfInterestKeyPtr;
+typedef boost::shared_ptr<GetRegionsOfInterestResults> GetRegionsOfInterestResultsPtr;
 typedef boost::shared_ptr<GetFrameRangeKey> GetFrameRangeKeyPtr;
 typedef boost::shared_ptr<GetFrameRangeResults> GetFrameRangeResultsPtr;
 typedef boost::shared_ptr<GetTimeInvariantMetadataKey> GetTimeInvariantMetadataKeyPtr;
@@ -486,6 +494,7 @@ typedef boost::shared_ptr<UndoCommand> UndoCommandPtr;
 typedef boost::shared_ptr<ViewerInstance> ViewerInstancePtr;
 typedef boost::shared_ptr<ViewerNode> ViewerNodePtr;
 typedef boost::shared_ptr<ViewerCurrentFrameRequestScheduler> ViewerCurrentFrameRequestSchedulerPtr;
+typedef boost::shared_ptr<ViewerPrefetchScheduler> ViewerPrefetchSchedulerPtr;
 typedef boost::shared_ptr<WriteNode> WriteNodePtr;
 typedef boost::weak_ptr<AbortableRenderInfo> AbortableRenderInfoWPtr;
 typedef boost::weak_ptr<AnimatingObjectI> AnimatingObjectIWPtr;
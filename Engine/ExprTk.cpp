@@ -28,6 +28,9 @@
 #include <sstream> // stringstream
 #include <string>
 
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+
 #include "Engine/KnobItemsTable.h"
 #include "Engine/Noise.h"
 #include "Engine/PyExprUtils.h"
@@ -128,8 +131,8 @@ typedef std::map<KnobIWPtr, KnobFunctionData> KnobFunctionsMap;
 
 /**
  * @brief All data that must be kept around for the expression to work.
- * Since the expression is not thread safe, we compile 1 expression for each thread to enable
- * concurrent evaluation of the same expression.
+ * Since the expression is not thread safe, it is evaluated by a single thread at a time: to enable
+ * concurrent evaluation of the same expression, it is compiled again only when all the compiled ones are in use.
  **/
 struct KnobExprExprTk::ExpressionData
 {
@@ -894,6 +897,40 @@ static exprtk_igeneric_function_ptr findGenericFunction(const std::string& name,
     return exprtk_igeneric_function_ptr();
 }
 
+// Number of exprtk expressions of knobs compiled so far, see KnobHelper::getExprTkCompilationsCount()
+QAtomicInt exprTkCompilationsCount(0);
+
+// Puts back a compiled expression in the idle list of the knob expression once the evaluation is done,
+// so that other threads may evaluate it.
+class ExprTkDataReleaser
+{
+    KnobExprExprTk* _obj;
+    KnobExprExprTk::ExpressionDataPtr _data;
+
+public:
+
+    ExprTkDataReleaser(KnobExprExprTk* obj,
+                       const KnobExprExprTk::ExpressionDataPtr& data)
+    : _obj(obj)
+    , _data(data)
+    {
+    }
+
+    ~ExprTkDataReleaser()
+    {
+        if (_data) {
+            QMutexLocker k(&_obj->lock);
+            _obj->idleData.push_back(_data);
+        }
+    }
+
+    // The compiled expression is not valid and should not be used again
+    void discard()
+    {
+        _data.reset();
+    }
+};
+
 // Some functions (random) hold an internal state. Instead of using the same state for all threads,
 // We create a copy of the function update in this symbol table
 bool
@@ -926,6 +963,9 @@ resetStateFunctions(const KnobExprExprTk::ExpressionDataPtr& data,
             // and then fetch the knob clone on it
             KnobHolderPtr holderClone = knob->getHolder()->createRenderClone(renderKey);
             func->_knob = knob->getCloneForHolderInternal(holderClone);
+        } else {
+            // The compiled expression may have been used by a render clone before
+            func->_knob = knob;
         }
     }
     return true;
@@ -1750,12 +1790,8 @@ KnobHelperPrivate::validateExprTkExpression(const string& expression,
 
     // Symbol table containing all pre-declared variables (frame, view etc...)
     exprtk_symbol_table_t symbol_table;
-    QThread* curThread = QThread::currentThread();
 
-    KnobExprExprTk::ExpressionDataPtr& data = ret->data[curThread];
-    if (!data) {
-        data = KnobExprExprTk::createData();
-    }
+    KnobExprExprTk::ExpressionDataPtr data = KnobExprExprTk::createData();
     data->expressionObject.reset(new exprtk_expression_t);
     data->expressionObject->register_symbol_table(unknown_var_symbol_table);
     data->expressionObject->register_symbol_table(symbol_table);
@@ -1789,15 +1825,9 @@ KnobHelperPrivate::validateExprTkExpression(const string& expression,
 
         string error;
         if ( !parseExprtkExpression(expression, ret->modifiedExpression, parser, *data->expressionObject, &error) ) {
-            {
-                QMutexLocker k(&ret->lock);
-                KnobExprExprTk::PerThreadDataMap::iterator foundThreadData = ret->data.find(curThread);
-                if (foundThreadData != ret->data.end()) {
-                    ret->data.erase(foundThreadData);
-                }
-            }
             throw std::runtime_error(error);
         }
+        exprTkCompilationsCount.fetchAndAddOrdered(1);
     } // parser
 
     double retValueIsScalar;
@@ -1816,6 +1846,10 @@ KnobHelperPrivate::validateExprTkExpression(const string& expression,
     case KnobHelper::eExpressionReturnValueTypeString:
         break;
     }
+
+    // The expression compiled for validation can be evaluated by the first thread that needs it
+    QMutexLocker k(&ret->lock);
+    ret->idleData.push_back(data);
 } // validateExprTkExpression
 
 KnobHelper::ExpressionReturnValueTypeEnum
@@ -1828,12 +1862,15 @@ KnobHelper::executeExprTkExpression(TimeValue time,
 {
     shared_ptr<KnobExprExprTk> obj;
 
-    // Take the expression mutex. Copying the exprtk expression does not actually copy all variables and functions, it just
-    // increments a shared reference count.
-    // To be thread safe we have 2 solutions:
+    // An exprtk expression holds the values of its variables and functions with a state in its nodes, thus it
+    // cannot be evaluated by 2 threads at once.
+    // To be thread safe we have 3 solutions:
     // 1) Compile the expression for each thread and then run it without a mutex
     // 2) Compile only once and run the expression under a lock
-    // We picked solution 1)
+    // 3) Keep a list of compiled expressions that are not being evaluated: a thread takes one from the list
+    // (or compiles a new one if they are all in use) and puts it back once evaluated.
+    // We picked solution 3): render threads do not wait on each other and the expression is compiled at most
+    // as many times as it is evaluated concurrently instead of once for every thread that ever evaluated it.
     {
         QMutexLocker k(&_imp->common->expressionMutex);
         ExprPerViewMap::const_iterator foundView = _imp->common->expressions[dimension].find(view);
@@ -1848,22 +1885,20 @@ KnobHelper::executeExprTkExpression(TimeValue time,
         assert(obj);
     }
 
-    QThread* curThread = QThread::currentThread();
-
     KnobExprExprTk::ExpressionDataPtr data;
     {
         QMutexLocker k(&obj->lock);
-        KnobExprExprTk::PerThreadDataMap::iterator foundThreadData = obj->data.find(curThread);
-        if ( foundThreadData == obj->data.end() ) {
-            data = KnobExprExprTk::createData();
-            pair<KnobExprExprTk::PerThreadDataMap::iterator, bool> ret = obj->data.insert( make_pair(curThread, data) );
-            assert(ret.second);
-            foundThreadData = ret.first;
-        } else {
-            data = foundThreadData->second;
-            assert(data);
+        if ( !obj->idleData.empty() ) {
+            // Take the most recently used one, it is more likely to still be in the CPU cache
+            data = obj->idleData.back();
+            obj->idleData.pop_back();
         }
     }
+    if (!data) {
+        // All compiled expressions are being evaluated by other threads, compile a new one
+        data = KnobExprExprTk::createData();
+    }
+    ExprTkDataReleaser releaser(obj.get(), data);
 
     // If we are a render clone, we must also reference clones that are local to this render
     bool isRenderClone = getHolder()->isRenderClone();
@@ -1903,6 +1938,11 @@ KnobHelper::executeExprTkExpression(TimeValue time,
         // Remove from the symbol table functions that hold a state, and re-add a new fresh local copy of them so that the state
         // is local to this thread.
         if (!resetStateFunctions(data, time, isRenderClone, renderKey, error)){
+            // A parameter the expression depends on was removed: the other compiled expressions reference it as well
+            releaser.discard();
+            QMutexLocker k(&obj->lock);
+            obj->idleData.clear();
+
             return eExpressionReturnValueTypeError;
         }
     } else {
@@ -1937,15 +1977,11 @@ KnobHelper::executeExprTkExpression(TimeValue time,
         parser.enable_unknown_symbol_resolver(&musr);
 
         if ( !parseExprtkExpression(obj->expressionString, obj->modifiedExpression, parser, *data->expressionObject, error) ) {
-            {
-                QMutexLocker k(&obj->lock);
-                KnobExprExprTk::PerThreadDataMap::iterator foundThreadData = obj->data.find(curThread);
-                if (foundThreadData != obj->data.end()) {
-                    obj->data.erase(foundThreadData);
-                }
-            }
+            releaser.discard();
+
             return KnobHelper::eExpressionReturnValueTypeError;
         }
+        exprTkCompilationsCount.fetchAndAddOrdered(1);
     } else {
         for (std::map<string, EffectFunctionDependency>::const_iterator it = obj->effectDependencies.begin(); it != obj->effectDependencies.end(); ++it) {
             EffectInstancePtr effect = it->second.effect.lock();
@@ -1986,6 +2022,12 @@ KnobHelper::executeExprTkExpression(TimeValue time,
     return handleExprTkReturn(*data->expressionObject, retValueIsScalar, retValueIsString, error);
 } // executeExprTkExpression
 
+U64
+KnobHelper::getExprTkCompilationsCount()
+{
+    return (U64)(int)exprTkCompilationsCount;
+}
+
 KnobHelper::ExpressionReturnValueTypeEnum
 KnobHelper::executeExprTkExpression(const string& expr,
                                     double* retValueIsScalar,
@@ -24,13 +24,14 @@
 
 #include "Hash64.h"
 
-#include <algorithm>  // for std::for_each
 #include <cassert>
 #include <stdexcept>
 
+#ifdef NATRON_HASH64_USE_CRC64
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/crc.hpp>
 #endif
+#endif
 #include <QtCore/QString>
 
 #include "Engine/Node.h"
@@ -38,27 +39,180 @@
 
 NATRON_NAMESPACE_ENTER
 
+#ifdef NATRON_HASH64_USE_CRC64
+
+typedef boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, 0, 0, false, false> Crc64;
+
+void
+Hash64::resetState()
+{
+    crcRemainder = 0;
+}
+
+void
+Hash64::appendValues(const U64* values, std::size_t n)
+{
+    // With no reflection and no final xor, the checksum is the remainder itself
+    Crc64 crc_64(crcRemainder);
+    crc_64.process_bytes(values, n * sizeof(U64));
+    crcRemainder = crc_64.checksum();
+    nValues += n;
+    hashValid = false;
+}
+
 void
 Hash64::computeHash()
 {
     if (hashValid) {
         return;
     }
-    if ( node_values.empty() ) {
+    if (nValues == 0) {
         return;
     }
+    hash = crcRemainder;
+    hashValid = true;
+}
+
+#else // !NATRON_HASH64_USE_CRC64
+
+// xxHash64, see https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+// Values are hashed as little-endian 64-bit words, the seed is 0.
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline U64
+xxhRotl64(U64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline U64
+xxhRound(U64 acc, U64 input)
+{
+    acc += input * XXH_PRIME64_2;
+    acc = xxhRotl64(acc, 31);
+    acc *= XXH_PRIME64_1;
+    return acc;
+}
+
+static inline U64
+xxhMergeRound(U64 acc, U64 val)
+{
+    val = xxhRound(0, val);
+    acc ^= val;
+    acc = acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+    return acc;
+}
+
+void
+Hash64::resetState()
+{
+    lanes[0] = XXH_PRIME64_1 + XXH_PRIME64_2;
+    lanes[1] = XXH_PRIME64_2;
+    lanes[2] = 0;
+    lanes[3] = 0 - XXH_PRIME64_1;
+}
+
+void
+Hash64::processStripe()
+{
+    // The 4 lanes are independent, this lets the compiler interleave them
+    lanes[0] = xxhRound(lanes[0], pending[0]);
+    lanes[1] = xxhRound(lanes[1], pending[1]);
+    lanes[2] = xxhRound(lanes[2], pending[2]);
+    lanes[3] = xxhRound(lanes[3], pending[3]);
+}
 
-    const unsigned char* data = reinterpret_cast<const unsigned char*>( &node_values.front() );
-    boost::crc_optimal<64, 0x42F0E1EBA9EA3693ULL, 0, 0, false, false> crc_64;
-    crc_64.process_bytes(data, node_values.size() * sizeof(node_values[0]));
-    hash = crc_64.checksum();
+void
+Hash64::appendValues(const U64* values, std::size_t n)
+{
+    if (n == 0) {
+        return;
+    }
+    hashValid = false;
+
+    // Complete the pending stripe first
+    while ( n > 0 && (nValues & 3) != 0 ) {
+        pending[nValues & 3] = *values;
+        ++values;
+        --n;
+        ++nValues;
+        if ( (nValues & 3) == 0 ) {
+            processStripe();
+        }
+    }
+
+    // Process full stripes directly from the input, without copying them
+    U64 v0 = lanes[0], v1 = lanes[1], v2 = lanes[2], v3 = lanes[3];
+    const U64* end = values + (n & ~(std::size_t)3);
+    for (; values < end; values += 4) {
+        v0 = xxhRound(v0, values[0]);
+        v1 = xxhRound(v1, values[1]);
+        v2 = xxhRound(v2, values[2]);
+        v3 = xxhRound(v3, values[3]);
+    }
+    lanes[0] = v0;
+    lanes[1] = v1;
+    lanes[2] = v2;
+    lanes[3] = v3;
+    nValues += n & ~(std::size_t)3;
+
+    // Keep the remaining values for the next stripe
+    for (std::size_t i = 0; i < (n & 3); ++i) {
+        pending[i] = values[i];
+    }
+    nValues += n & 3;
+}
+
+void
+Hash64::computeHash()
+{
+    if (hashValid) {
+        return;
+    }
+    if (nValues == 0) {
+        return;
+    }
+
+    // Finalizing does not modify the state, so that more values may be appended afterwards
+    U64 h;
+    if (nValues >= 4) {
+        h = xxhRotl64(lanes[0], 1) + xxhRotl64(lanes[1], 7) + xxhRotl64(lanes[2], 12) + xxhRotl64(lanes[3], 18);
+        for (int i = 0; i < 4; ++i) {
+            h = xxhMergeRound(h, lanes[i]);
+        }
+    } else {
+        h = XXH_PRIME64_5;
+    }
+    h += nValues * sizeof(U64);
+
+    int nPending = (int)(nValues & 3);
+    for (int i = 0; i < nPending; ++i) {
+        h ^= xxhRound(0, pending[i]);
+        h = xxhRotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+
+    // Avalanche
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+
+    hash = h;
     hashValid = true;
 }
 
+#endif // NATRON_HASH64_USE_CRC64
+
 void
 Hash64::reset()
 {
-    node_values.clear();
+    nValues = 0;
+    resetState();
     hash = 0;
     hashValid = false;
 }
@@ -66,12 +220,8 @@ Hash64::reset()
 void
 Hash64::appendQString(const QString & str, Hash64* hash)
 {
-    std::size_t curSize = hash->node_values.size();
-    hash->node_values.resize(curSize + str.size());
-
-    int c = (int)curSize;
-    for (QString::const_iterator it = str.begin(); it != str.end(); ++it, ++c) {
-        hash->node_values[c] = toU64<unsigned short>(it->unicode());
+    for (QString::const_iterator it = str.begin(); it != str.end(); ++it) {
+        hash->append<unsigned short>(it->unicode());
     }
 }
 
@@ -80,21 +230,15 @@ Hash64::appendCurve(const CurvePtr& curve, Hash64* hash)
 {
     KeyFrameSet keys = curve->getKeyFrames_mt_safe();
 
-    std::size_t curSize = hash->node_values.size();
-    hash->node_values.resize(curSize + 4 * keys.size());
-
-
-    int c = curSize;
-    for (KeyFrameSet::const_iterator it = keys.begin(); it!=keys.end(); ++it, c += 4) {
-        hash->node_values[c] = toU64((double)it->getTime());
+    for (KeyFrameSet::const_iterator it = keys.begin(); it!=keys.end(); ++it) {
+        hash->append((double)it->getTime());
         if (it->hasProperty(kKeyFramePropString)) {
             std::string value;
             it->getPropertySafe(kKeyFramePropString, 0, &value);
             appendQString(QString::fromUtf8(value.c_str()), hash);
         } else {
-            hash->node_values[c + 1] = toU64(it->getValue());
-            hash->node_values[c + 2] = toU64(it->getLeftDerivative());
-            hash->node_values[c + 3] = toU64(it->getRightDerivative());
+            U64 values[3] = { toU64(it->getValue()), toU64(it->getLeftDerivative()), toU64(it->getRightDerivative()) };
+            hash->appendValues(values, 3);
         }
 
     }
@@ -39,7 +39,25 @@
 
 NATRON_NAMESPACE_ENTER
 
-/*The hash of a Node is the checksum of the vector of data containing:
+// The hash function used by Hash64 is selected at compile time:
+// - NATRON_HASH64_USE_CRC64: the legacy CRC-64 (ECMA polynomial), processed byte per byte.
+// - NATRON_HASH64_USE_XXH64 (default): xxHash64, which processes 4 independent 64-bit lanes
+//   per 32 bytes stripe, so that the rounds of each lane can be pipelined (or vectorized).
+// Both are streaming: values are mixed in the state as soon as they are appended, the hash
+// never needs to buffer the appended values.
+#if !defined(NATRON_HASH64_USE_CRC64) && !defined(NATRON_HASH64_USE_XXH64)
+#define NATRON_HASH64_USE_XXH64
+#endif
+
+// Identifies the hash function. Any hash that is persisted on disk (e.g: the keys of the persistent cache)
+// must be invalidated if this changes.
+#ifdef NATRON_HASH64_USE_CRC64
+#define NATRON_HASH64_ALGORITHM_VERSION 1
+#else
+#define NATRON_HASH64_ALGORITHM_VERSION 2
+#endif
+
+/*The hash of a Node is the checksum of the sequence of data containing:
     - the values of the current knob for this node + the name of the node
     - the hash values for the  tree upstream
  */
@@ -49,9 +67,10 @@ class Hash64
 public:
     Hash64()
     : hash(0)
-    , node_values()
+    , nValues(0)
     , hashValid(false)
     {
+        resetState();
     }
 
     ~Hash64()
@@ -65,7 +84,7 @@ public:
 
     bool isEmpty() const
     {
-        return node_values.empty();
+        return nValues == 0;
     }
 
     void computeHash();
@@ -106,24 +125,22 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 
     void insert(const std::vector<U64>& elements)
     {
-        std::size_t curSize = node_values.size();
-        node_values.resize(curSize + elements.size());
-
-        int c = curSize;
-        for (std::vector<U64>::const_iterator it = elements.begin(); it != elements.end(); ++it, ++c) {
-            node_values[c] = *it;
+        if ( !elements.empty() ) {
+            appendValues(&elements.front(), elements.size());
         }
-        hashValid = false;
-
     }
 
     template<typename T>
     void append(T value)
     {
-        node_values.push_back( toU64(value) );
-        hashValid = false;
+        appendValue( toU64(value) );
     }
 
+    /**
+     * @brief Append n values at once, this is faster than calling append() n times.
+     **/
+    void appendValues(const U64* values, std::size_t n);
+
 
     static void appendQString(const QString & str, Hash64* hash);
 
@@ -155,8 +172,42 @@ private:
         };
     };
 
+    void appendValue(U64 value)
+    {
+#ifdef NATRON_HASH64_USE_CRC64
+        appendValues(&value, 1);
+#else
+        pending[nValues & 3] = value;
+        ++nValues;
+        if ( (nValues & 3) == 0 ) {
+            processStripe();
+        }
+        hashValid = false;
+#endif
+    }
+
+    void resetState();
+
+#ifndef NATRON_HASH64_USE_CRC64
+    // Mix the 4 pending values in the lanes
+    void processStripe();
+#endif
+
     U64 hash;
-    std::vector<U64> node_values;
+
+    // The number of values appended so far
+    U64 nValues;
+
+#ifdef NATRON_HASH64_USE_CRC64
+    // The CRC remainder so far
+    U64 crcRemainder;
+#else
+    // The 4 accumulators, one per lane
+    U64 lanes[4];
+
+    // Values that were appended but do not yet form a full stripe (nValues % 4 of them)
+    U64 pending[4];
+#endif
     bool hashValid;
 };
 
@@ -24,6 +24,7 @@
 
 #include "HashableObject.h"
 #include <list>
+#include <map>
 #include <QMutex>
 
 #include "Engine/Hash64.h"
@@ -40,6 +41,9 @@ struct HashableObjectPrivate
     // The hash cache
     mutable FrameViewHashMap timeViewVariantHashCache;
 
+    // The time/view variant hash of each view for which the hash is constant over time
+    std::map<ViewIdx, U64> timeConstantHashCache;
+
     U64 timeViewInvariantCache;
 
     bool timeViewInvariantCacheValid;
@@ -58,6 +62,7 @@ struct HashableObjectPrivate
     : listeners()
     , dependencies()
     , timeViewVariantHashCache()
+    , timeConstantHashCache()
     , timeViewInvariantCache(0)
     , timeViewInvariantCacheValid(false)
     , metadataSlaveCache(0)
@@ -72,6 +77,7 @@ struct HashableObjectPrivate
     : listeners()
     , dependencies()
     , timeViewVariantHashCache()
+    , timeConstantHashCache()
     , timeViewInvariantCache()
     , timeViewInvariantCacheValid(false)
     , metadataSlaveCache()
@@ -81,6 +87,7 @@ struct HashableObjectPrivate
     {
         QMutexLocker k(&other.hashCacheMutex);
         timeViewVariantHashCache = other.timeViewVariantHashCache;
+        timeConstantHashCache = other.timeConstantHashCache;
         timeViewInvariantCache = other.timeViewInvariantCache;
         timeViewInvariantCacheValid = other.timeViewInvariantCacheValid;
         metadataSlaveCache = other.metadataSlaveCache;
@@ -139,8 +146,14 @@ bool
 HashableObjectPrivate::findCachedHashInternal(const HashableObject::FindHashArgs& args, U64 *hash) const
 {
     switch (args.hashType) {
-        case HashableObject::eComputeHashTypeTimeViewVariant:
+        case HashableObject::eComputeHashTypeTimeViewVariant: {
+            std::map<ViewIdx, U64>::const_iterator found = timeConstantHashCache.find(args.view);
+            if (found != timeConstantHashCache.end()) {
+                *hash = found->second;
+                return true;
+            }
             return findFrameViewHash(args.time, args.view, timeViewVariantHashCache, hash);
+        }
         case HashableObject::eComputeHashTypeTimeViewInvariant:
             if (!timeViewInvariantCacheValid) {
 
@@ -208,6 +221,8 @@ HashableObject::computeHash(const ComputeHashArgs& args)
         hash.computeHash();
         U64 hashValue = hash.value();
 
+        // Do not call the derived implementation under the mutex
+        bool isConstantOverTime = args.hashType == eComputeHashTypeTimeViewVariant && isHashConstantOverTime(args.view);
 
         QMutexLocker k(&_imp->hashCacheMutex);
 
@@ -221,8 +236,12 @@ HashableObject::computeHash(const ComputeHashArgs& args)
                 _imp->metadataSlaveCacheValid = true;
                 break;
             case eComputeHashTypeTimeViewVariant:
-                FrameViewPair fv = {roundImageTimeToEpsilon(args.time), args.view};
-                _imp->timeViewVariantHashCache[fv] = hashValue;
+                if (isConstantOverTime) {
+                    _imp->timeConstantHashCache[args.view] = hashValue;
+                } else {
+                    FrameViewPair fv = {roundImageTimeToEpsilon(args.time), args.view};
+                    _imp->timeViewVariantHashCache[fv] = hashValue;
+                }
                 break;
         }
 
@@ -256,6 +275,7 @@ HashableObject::invalidateHashCacheInternal(std::set<HashableObject*>* invalidat
         }
 #endif
         _imp->timeViewVariantHashCache.clear();
+        _imp->timeConstantHashCache.clear();
         _imp->timeViewInvariantCacheValid = false;
         _imp->metadataSlaveCacheValid = false;
     }
@@ -275,6 +295,12 @@ HashableObject::invalidateHashCache()
     invalidateHashCacheInternal(&objs);
 }
 
+bool
+HashableObject::isHashConstantOverTime(ViewIdx /*view*/) const
+{
+    return false;
+}
+
 void
 HashableObject::setHashCachingEnabled(bool enabled)
 {
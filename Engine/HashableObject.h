@@ -161,6 +161,14 @@ public:
      **/
     void invalidateHashCache();
 
+    /**
+     * @brief Returns true if the time/view variant hash of this object does not depend on the time for the given view,
+     * e.g: a knob that is neither animated nor driven by an expression.
+     * Such hashes are cached once per view instead of once per frame/view.
+     * Deriving classes must invalidate the hash cache whenever the returned value may change.
+     **/
+    virtual bool isHashConstantOverTime(ViewIdx view) const;
+
 
 protected:
 
@@ -39,6 +39,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include <QtCore/QThread>
 
 #include "Engine/ImagePrivate.h"
+#include "Engine/RenderTracer.h"
 
 
 #ifndef M_LN2
@@ -239,6 +240,7 @@ static bool isCopyPixelsNeeded(ImagePrivate* thisImage, ImagePrivate* otherImage
 ActionRetCodeEnum
 Image::copyPixels(const Image& other, const CopyPixelsArgs& args)
 {
+    NATRON_RENDER_TRACE_SCOPE("image", "Copy pixels");
 
     // First intersect the RoI with the destination image. If it does not, do nothing.
     RectI roi;
@@ -879,6 +881,9 @@ class MaskMixProcessor : public ImageMultiThreadProcessorBase
     Image::CPUData _srcTileData, _maskTileData, _dstTileData;
     double _mix;
     bool _maskInvert;
+    bool _checkNaNs;
+    mutable QMutex _foundNaNMutex;
+    bool _foundNan;
 public:
 
     MaskMixProcessor(const EffectInstancePtr& renderClone)
@@ -888,6 +893,9 @@ public:
     , _dstTileData()
     , _mix(0)
     , _maskInvert(false)
+    , _checkNaNs(false)
+    , _foundNaNMutex()
+    , _foundNan(false)
     {
 
     }
@@ -900,31 +908,46 @@ public:
                    const Image::CPUData& maskTileData,
                    const Image::CPUData& dstTileData,
                    double mix,
-                   bool maskInvert)
+                   bool maskInvert,
+                   bool checkNaNs)
     {
         _srcTileData = srcTileData;
         _maskTileData = maskTileData;
         _dstTileData = dstTileData;
         _mix = mix;
         _maskInvert = maskInvert;
+        _checkNaNs = checkNaNs;
+    }
+
+    bool hasNaN() const
+    {
+        QMutexLocker k(&_foundNaNMutex);
+        return _foundNan;
     }
 
 private:
 
     virtual ActionRetCodeEnum multiThreadProcessImages(const RectI& renderWindow) OVERRIDE FINAL
     {
-        return ImagePrivate::applyMaskMixCPU((const void**)_srcTileData.ptrs,
-                                             _srcTileData.bounds,
-                                             _srcTileData.nComps,
-                                             (const void**)_maskTileData.ptrs,
-                                             _maskTileData.bounds, _dstTileData.ptrs,
-                                             _dstTileData.bitDepth,
-                                             _dstTileData.nComps,
-                                             _mix,
-                                             _maskInvert,
-                                             _dstTileData.bounds,
-                                             renderWindow,
-                                             _effect);
+        bool foundNaN = false;
+        ActionRetCodeEnum stat = ImagePrivate::applyMaskMixCPU((const void**)_srcTileData.ptrs,
+                                                               _srcTileData.bounds,
+                                                               _srcTileData.nComps,
+                                                               (const void**)_maskTileData.ptrs,
+                                                               _maskTileData.bounds, _dstTileData.ptrs,
+                                                               _dstTileData.bitDepth,
+                                                               _dstTileData.nComps,
+                                                               _mix,
+                                                               _maskInvert,
+                                                               _dstTileData.bounds,
+                                                               renderWindow,
+                                                               _effect,
+                                                               _checkNaNs ? &foundNaN : 0);
+        if (foundNaN) {
+            QMutexLocker k(&_foundNaNMutex);
+            _foundNan = true;
+        }
+        return stat;
     }
 };
 
@@ -934,10 +957,18 @@ Image::applyMaskMix(const RectI& roi,
                     const ImagePtr& originalImg,
                     bool masked,
                     bool maskInvert,
-                    float mix)
+                    float mix,
+                    bool* foundNan)
 {
+    if (foundNan) {
+        *foundNan = false;
+    }
+
     // !masked && mix == 1: nothing to do
     if ( !masked && (mix == 1) ) {
+        if (foundNan && getBitDepth() == eImageBitDepthFloat && getStorageMode() != eStorageModeGLTex) {
+            return checkForNaNs(roi, foundNan);
+        }
         return eActionStatusOK;
     }
 
@@ -981,9 +1012,13 @@ Image::applyMaskMix(const RectI& roi,
     roi.intersect(dstImgData.bounds, &tileRoI);
 
     MaskMixProcessor processor(_imp->renderClone.lock());
-    processor.setValues(srcImgData, maskImgData, dstImgData, mix, maskInvert);
+    processor.setValues(srcImgData, maskImgData, dstImgData, mix, maskInvert, foundNan != 0);
     processor.setRenderWindow(tileRoI);
-    return processor.process();
+    ActionRetCodeEnum stat = processor.process();
+    if (foundNan) {
+        *foundNan = processor.hasNaN();
+    }
+    return stat;
 
 } // applyMaskMix
 
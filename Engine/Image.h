@@ -632,13 +632,16 @@ public:
 
     /**
      * @brief Mask the image by the given mask and also disolves it to the originalImg with the given mix.
+     * If foundNan is not NULL, NaNs are also replaced by 1 in the same pass, as checkForNaNs() does,
+     * and foundNan is set to true if any was found.
      **/
     ActionRetCodeEnum applyMaskMix(const RectI& roi,
                       const ImagePtr& maskImg,
                       const ImagePtr& originalImg,
                       bool masked,
                       bool maskInvert,
-                      float mix);
+                      float mix,
+                      bool* foundNan = 0);
 
     typedef void (*ImageCPUPixelShaderFloat)(const void* customData, int nComps, float* pixelsPtr[4]);
     typedef void (*ImageCPUPixelShaderShort)(const void* customData, int nComps, unsigned short* pixelsPtr[4]);
@@ -47,6 +47,7 @@
 #include "Engine/ImageTilesState.h"
 #include "Engine/MultiThread.h"
 #include "Engine/ThreadPool.h"
+#include "Engine/TreeRender.h"
 #include "Engine/TreeRenderQueueManager.h"
 #include "Engine/Timer.h"
 
@@ -175,6 +176,17 @@ public:
         return true;
     }
 
+    /**
+     * @brief Tiles all take NATRON_TILE_SIZE_BYTES: the tile size depends on the bitdepth.
+     **/
+    virtual int getTilesElementSize() const OVERRIDE FINAL
+    {
+        if (tileSizeX <= 0 || tileSizeY <= 0) {
+            return 4;
+        }
+        return NATRON_TILE_SIZE_BYTES / (tileSizeX * tileSizeY);
+    }
+
 };
 
 template <bool persistent>
@@ -278,6 +290,10 @@ struct DownscaleTile : public TileData
 {
     // Ptr to the src tiles. Non NULL when they are ready
     boost::shared_ptr<TileData> srcTiles[4];
+
+    // If the src tile must itself be downscaled from the upper level, this is the same
+    // pointer as in srcTiles, otherwise NULL
+    boost::shared_ptr<DownscaleTile> srcDownscaleTiles[4];
 };
 
 
@@ -472,6 +488,13 @@ struct ImageCacheEntryPrivate
      **/
     ActionRetCodeEnum fetchAndCopyCachedTiles() WARN_UNUSED_RETURN;
 
+    /**
+     * @brief Restores from the compressed tiles tier of the cache the tiles marked for rendering at the requested mipmap level.
+     * Restored tiles are marked rendered and moved to tilesToFetch so that they are copied in fetchAndCopyCachedTiles.
+     * This must be called after a call to readAndUpdateStateMap.
+     **/
+    void restoreCompressedTiles();
+
     /**
      * @brief Mark pending tiles as non rendered. Returns true if at least one tile state was changed.
      **/
@@ -814,6 +837,7 @@ protected:
 
     std::vector<boost::shared_ptr<DownscaleTile> > _tasks;
     int _tileSizeX, _tileSizeY;
+    bool _downscaleSrcTilesFirst;
 public:
 
     DownscaleMipMapProcessorBase(const EffectInstancePtr& renderClone)
@@ -821,6 +845,7 @@ public:
     , _tasks()
     , _tileSizeX(-1)
     , _tileSizeY(-1)
+    , _downscaleSrcTilesFirst(false)
     {
 
     }
@@ -829,11 +854,18 @@ public:
     {
     }
 
-    void setValues(int tileSizeX, int tileSizeY, const std::vector<boost::shared_ptr<DownscaleTile> >& tasks)
+    /**
+     * @brief If downscaleSrcTilesFirst is true, the src tiles of each task that must themselves be downscaled
+     * are processed first, recursively, by the same thread: this produces all the mipmap levels below the level of
+     * the tasks in a single depth-first pass, while the src tiles are still hot in the CPU cache.
+     * Each tile in the pyramid has a single parent, so the sub-pyramids of different tasks never overlap.
+     **/
+    void setValues(int tileSizeX, int tileSizeY, const std::vector<boost::shared_ptr<DownscaleTile> >& tasks, bool downscaleSrcTilesFirst)
     {
         _tileSizeX = tileSizeX;
         _tileSizeY = tileSizeY;
         _tasks = tasks;
+        _downscaleSrcTilesFirst = downscaleSrcTilesFirst;
     }
 
 };
@@ -857,6 +889,29 @@ public:
     {
     }
 
+private:
+
+    void downscaleTile(const DownscaleTile& task) const
+    {
+        if (_downscaleSrcTilesFirst) {
+            for (int i = 0; i < 4; ++i) {
+                if (task.srcDownscaleTiles[i]) {
+                    downscaleTile(*task.srcDownscaleTiles[i]);
+                }
+            }
+        }
+
+        const void* srcPtrs[4] = {
+            task.srcTiles[0] ? task.srcTiles[0]->ptr : 0,
+            task.srcTiles[1] ? task.srcTiles[1]->ptr : 0,
+            task.srcTiles[2] ? task.srcTiles[2]->ptr : 0,
+            task.srcTiles[3] ? task.srcTiles[3]->ptr : 0};
+
+        ImageCacheEntryProcessing::downscaleMipMapForDepth<PIX>((const PIX**)srcPtrs, (PIX*)task.ptr, task.bounds, _tileSizeX, _tileSizeY);
+    }
+
+public:
+
     virtual ActionRetCodeEnum multiThreadFunction(unsigned int threadID,
                                                   unsigned int nThreads) OVERRIDE FINAL WARN_UNUSED_RETURN
     {
@@ -872,20 +927,29 @@ public:
                 return eActionStatusAborted;
             }*/
 
-            const DownscaleTile& task = *_tasks[i];
-
-            const void* srcPtrs[4] = {
-                task.srcTiles[0] ? task.srcTiles[0]->ptr : 0,
-                task.srcTiles[1] ? task.srcTiles[1]->ptr : 0,
-                task.srcTiles[2] ? task.srcTiles[2]->ptr : 0,
-                task.srcTiles[3] ? task.srcTiles[3]->ptr : 0};
-
-            ImageCacheEntryProcessing::downscaleMipMapForDepth<PIX>((const PIX**)srcPtrs, (PIX*)task.ptr, task.bounds, _tileSizeX, _tileSizeY);
+            downscaleTile(*_tasks[i]);
         }
         return eActionStatusOK;
     } // multiThreadFunction
 };
 
+static DownscaleMipMapProcessorBase*
+createDownscaleMipMapProcessor(ImageBitDepthEnum bitdepth, const EffectInstancePtr& renderClone)
+{
+    switch (bitdepth) {
+        case eImageBitDepthByte:
+            return new DownscaleMipMapProcessor<unsigned char>(renderClone);
+        case eImageBitDepthShort:
+            return new DownscaleMipMapProcessor<unsigned short>(renderClone);
+        case eImageBitDepthFloat:
+            return new DownscaleMipMapProcessor<float>(renderClone);
+        default:
+            assert(false);
+            break;
+    }
+    return 0;
+}
+
 struct CacheDataLock_RAII
 {
     void* data;
@@ -1428,6 +1492,7 @@ ImageCacheEntryPrivate::readAndUpdateStateMap(bool hasExclusiveLock, bool allTil
  * to be allocated and recursively call the function upstream.
  **/
 static void fetchTileIndicesInPyramid(U64 entryHash,
+                                      bool isDraftModeEnabled,
                                       unsigned int lookupLevel,
                                       int tileSizeX,
                                       int tileSizeY,
@@ -1447,7 +1512,7 @@ static void fetchTileIndicesInPyramid(U64 entryHash,
         *tilesAllocNeeded += nComps;
 #else
         for (int c = 0; c < nComps; ++c) {
-            TileHash tileBucketHash = CacheBase::makeTileCacheIndex(tile.tx, tile.ty, lookupLevel, c, entryHash);
+            TileHash tileBucketHash = CacheBase::makeTileCacheIndex(tile.tx, tile.ty, lookupLevel, c, entryHash, isDraftModeEnabled);
             tilesAllocNeeded->push_back(tileBucketHash);
         }
 #endif
@@ -1457,7 +1522,7 @@ static void fetchTileIndicesInPyramid(U64 entryHash,
             assert(tile.upscaleTiles[i]);
             // Check that the upscaled tile exists and recurse: on the edges and corner of the images a tile may not necessarily have 4 upscaled tiles
             if (tile.upscaleTiles[i]->tx != -1) {
-                fetchTileIndicesInPyramid(entryHash, lookupLevel - 1, tileSizeX, tileSizeY, *tile.upscaleTiles[i], nComps, tileIndicesToFetch, tilesAllocNeeded);
+                fetchTileIndicesInPyramid(entryHash, isDraftModeEnabled, lookupLevel - 1, tileSizeX, tileSizeY, *tile.upscaleTiles[i], nComps, tileIndicesToFetch, tilesAllocNeeded);
             }
         }
     } else {
@@ -1526,8 +1591,12 @@ ImageCacheEntryPrivate::buildTaskPyramidRecursive(unsigned int lookupLevel,
                 // For each upscaled tiles, it returns us a vector of exactly nComps tasks.
                 std::vector<boost::shared_ptr<TileData> > upscaledTileTasks = buildTaskPyramidRecursive(lookupLevel - 1, *tile.upscaleTiles[i],  fetchedExistingTiles, allocatedTiles, existingTiles_i, allocatedTiles_i, tilesToCopy, downscaleTilesPerLevel);
                 assert((int)upscaledTileTasks.size() == nComps);
+                const bool upscaledTileIsDownscaled = tile.upscaleTiles[i]->upscaleTiles[0] != 0;
                 for (int c = 0; c < nComps; ++c) {
                     thisLevelTask[c]->srcTiles[i] = upscaledTileTasks[c];
+                    if (upscaledTileIsDownscaled) {
+                        thisLevelTask[c]->srcDownscaleTiles[i] = boost::static_pointer_cast<DownscaleTile>(upscaledTileTasks[c]);
+                    }
                 }
 
             }
@@ -1583,11 +1652,11 @@ ImageCacheEntryPrivate::fetchAndCopyCachedTiles()
 #endif
     for (std::size_t i = 0; i < tilesToFetch.size(); ++i) {
         // Fetch all tiles that should be copied from the cache. We don't need to allocate any tile in the cache, so pass a NULL pointer for the tilesAllocNeeded
-        fetchTileIndicesInPyramid(entryHash, mipMapLevel, localTilesState.tileSizeX, localTilesState.tileSizeY, tilesToFetch[i], nComps, &tileIndicesToFetch, 0);
+        fetchTileIndicesInPyramid(entryHash, isDraftModeEnabled, mipMapLevel, localTilesState.tileSizeX, localTilesState.tileSizeY, tilesToFetch[i], nComps, &tileIndicesToFetch, 0);
     }
     for (std::size_t i = 0; i < tilesToDownscale.size(); ++i) {
         // Fetch all tiles to downscale: it will recursively fetch upscaled tiles and mark new tiles to allocate in output
-        fetchTileIndicesInPyramid(entryHash, mipMapLevel, localTilesState.tileSizeX, localTilesState.tileSizeY, tilesToDownscale[i], nComps, &tileIndicesToFetch, &tilesAllocNeeded);
+        fetchTileIndicesInPyramid(entryHash, isDraftModeEnabled, mipMapLevel, localTilesState.tileSizeX, localTilesState.tileSizeY, tilesToDownscale[i], nComps, &tileIndicesToFetch, &tilesAllocNeeded);
     }
 
     if (tileIndicesToFetch.empty() &&
@@ -1652,7 +1721,31 @@ ImageCacheEntryPrivate::fetchAndCopyCachedTiles()
     // If we downscaled some tiles, we updated the tiles status map
     bool stateMapUpdated = false;
 
-    // Downscale in parallel each mipmap level tiles and then copy the last level tiles
+    // Downscaling level by level requires a full pass over the tiles of each level, by which time the tiles
+    // of the previous level are out of the CPU cache. Instead, produce all the levels up to the highest level
+    // that has at least one task per thread in a single depth-first pass: each thread downscales the whole
+    // sub-pyramid of its tiles. The levels above have too few tiles to keep all threads busy and are still
+    // processed level by level.
+    int fusedLevel = -1;
+    {
+        const std::size_t nCPUs = MultiThread::getNCPUsAvailable(renderClone);
+        for (int i = (int)mipMapLevel; i >= 0; --i) {
+            if (!perLevelTilesToDownscale[i].empty() && perLevelTilesToDownscale[i].size() >= nCPUs) {
+                fusedLevel = i;
+                break;
+            }
+        }
+    }
+    if (fusedLevel != -1) {
+        boost::scoped_ptr<DownscaleMipMapProcessorBase> processor(createDownscaleMipMapProcessor(bitdepth, renderClone));
+        processor->setValues(localTilesState.tileSizeX, localTilesState.tileSizeY, perLevelTilesToDownscale[fusedLevel], true /*downscaleSrcTilesFirst*/);
+        ActionRetCodeEnum downscaleStatus = processor->launchThreadsBlocking();
+        (void)downscaleStatus;
+        assert(downscaleStatus == eActionStatusOK);
+    }
+
+    // Downscale in parallel each mipmap level tiles and then copy the last level tiles.
+    // Every produced level is stored in the cache so that a later render at that level does not need to downscale again.
     std::vector<TilesSet> tilesToUpdate(perLevelTilesToDownscale.size());
     for (std::size_t i = 0; i < perLevelTilesToDownscale.size(); ++i) {
 
@@ -1663,26 +1756,14 @@ ImageCacheEntryPrivate::fetchAndCopyCachedTiles()
         TileStateHeader cacheStateMap = TileStateHeader(localTilesState.tileSizeX, localTilesState.tileSizeY, &internalCacheEntry->perMipMapTilesState[i]);
         assert(!cacheStateMap.state->tiles.empty());
 
-        // Downscale all tiles for the same mipmap level concurrently
-        boost::scoped_ptr<DownscaleMipMapProcessorBase> processor;
-        switch (bitdepth) {
-            case eImageBitDepthByte:
-                processor.reset(new DownscaleMipMapProcessor<unsigned char>(renderClone));
-                break;
-            case eImageBitDepthShort:
-                processor.reset(new DownscaleMipMapProcessor<unsigned short>(renderClone));
-                break;
-            case eImageBitDepthFloat:
-                processor.reset(new DownscaleMipMapProcessor<float>(renderClone));
-                break;
-            default:
-                assert(false);
-                break;
+        if ((int)i > fusedLevel) {
+            // Downscale all tiles for the same mipmap level concurrently
+            boost::scoped_ptr<DownscaleMipMapProcessorBase> processor(createDownscaleMipMapProcessor(bitdepth, renderClone));
+            processor->setValues(localTilesState.tileSizeX, localTilesState.tileSizeY, perLevelTilesToDownscale[i], false /*downscaleSrcTilesFirst*/);
+            ActionRetCodeEnum downscaleStatus = processor->launchThreadsBlocking();
+            (void)downscaleStatus;
+            assert(downscaleStatus == eActionStatusOK);
         }
-        processor->setValues(localTilesState.tileSizeX, localTilesState.tileSizeY, perLevelTilesToDownscale[i]);
-        ActionRetCodeEnum downscaleStatus = processor->launchThreadsBlocking();
-        (void)downscaleStatus;
-        assert(downscaleStatus == eActionStatusOK);
 
         stateMapUpdated = true;
 
@@ -1790,6 +1871,103 @@ ImageCacheEntryPrivate::fetchAndCopyCachedTiles()
 
 } // fetchAndCopyCachedTiles
 
+void
+ImageCacheEntryPrivate::restoreCompressedTiles()
+{
+    if ( (markedTiles.size() <= mipMapLevel) || markedTiles[mipMapLevel].empty() ) {
+        return;
+    }
+    CacheBasePtr cache = internalCacheEntry->getCache();
+    if ( !cache->getMaximumCompressedTilesSize() ) {
+        return;
+    }
+
+    U64 entryHash = internalCacheEntry->getHashKey();
+
+    // Only restore tiles for which all channels are available
+    std::vector<TileCoord> candidateTiles;
+    std::vector<TileHash> candidateHashes;
+    for (TilesSet::const_iterator it = markedTiles[mipMapLevel].begin(); it != markedTiles[mipMapLevel].end(); ++it) {
+        TileState* localTileState = localTilesState.getTileAt(it->tx, it->ty);
+        for (int c = 0; c < nComps; ++c) {
+            // Same hash as when the tile was allocated in markCacheTilesAsRendered
+            candidateHashes.push_back( CacheBase::makeTileCacheIndex(localTileState->bounds.x1, localTileState->bounds.y1, mipMapLevel, c, entryHash) );
+        }
+        candidateTiles.push_back(*it);
+    }
+
+    std::vector<bool> available;
+    cache->hasCompressedTiles(candidateHashes, &available);
+
+    std::vector<TileCoord> tilesToRestore;
+    std::vector<TileHash> hashesToRestore;
+    for (std::size_t i = 0; i < candidateTiles.size(); ++i) {
+        bool allChannelsAvailable = true;
+        for (int c = 0; c < nComps; ++c) {
+            if (!available[i * nComps + c]) {
+                allChannelsAvailable = false;
+                break;
+            }
+        }
+        if (allChannelsAvailable) {
+            tilesToRestore.push_back(candidateTiles[i]);
+            hashesToRestore.insert(hashesToRestore.end(), candidateHashes.begin() + i * nComps, candidateHashes.begin() + (i + 1) * nComps);
+        }
+    }
+    if ( tilesToRestore.empty() ) {
+        return;
+    }
+
+    std::vector<std::pair<TileInternalIndex, void*> > restoredTiles;
+    void* cacheData;
+    if ( !cache->restoreCompressedTiles(internalCacheEntry, hashesToRestore, &restoredTiles, &cacheData) ) {
+        return;
+    }
+
+    // Restored tiles take room in the cache just like rendered ones, @see markCacheTilesAsRendered
+    EffectInstancePtr renderClone = effect.lock();
+    TreeRenderPtr currentRender = renderClone ? renderClone->getCurrentRender() : TreeRenderPtr();
+    if (currentRender) {
+        currentRender->addCachedTilesSize(restoredTiles.size() * NATRON_TILE_SIZE_BYTES);
+    }
+
+    TileStateHeader cacheStateMap(localTilesState.tileSizeX, localTilesState.tileSizeY, &internalCacheEntry->perMipMapTilesState[mipMapLevel]);
+    std::vector<TilesSet> tilesToUpdate(mipMapLevel + 1);
+    for (std::size_t i = 0; i < tilesToRestore.size(); ++i) {
+        const TileCoord& coord = tilesToRestore[i];
+        TileState* cacheTileState = cacheStateMap.getTileAt(coord.tx, coord.ty);
+        TileState* localTileState = localTilesState.getTileAt(coord.tx, coord.ty);
+
+        TileCacheIndex tile;
+        tile.tx = coord.tx;
+        tile.ty = coord.ty;
+        for (int c = 0; c < nComps; ++c) {
+            const TileInternalIndex& index = restoredTiles[i * nComps + c].first;
+            cacheTileState->channelsTileStorageIndex[c] = index;
+            localTileState->channelsTileStorageIndex[c] = index;
+            tile.perChannelTileIndices[c] = index;
+        }
+
+        // We marked the tile pending in readAndUpdateStateMap, it is now rendered
+        assert(cacheTileState->status == eTileStatusPending);
+        cacheTileState->status = eTileStatusRenderedHighestQuality;
+        localTileState->status = eTileStatusRenderedHighestQuality;
+
+        TilesSet::iterator foundMarked = markedTiles[mipMapLevel].find(coord);
+        assert( foundMarked != markedTiles[mipMapLevel].end() );
+        tilesToUpdate[mipMapLevel].insert(*foundMarked);
+        markedTiles[mipMapLevel].erase(foundMarked);
+
+        // Copy it to the image along with the other cached tiles
+        tilesToFetch.push_back(tile);
+    }
+
+    // Release the tiles lock before calling updateCachedTilesStateMap which may try to take a write lock on an already taken read lock
+    cache->unLockTiles(cacheData, false);
+
+    updateCachedTilesStateMap(tilesToUpdate, false);
+} // restoreCompressedTiles
+
 ActionRetCodeEnum
 ImageCacheEntry::fetchCachedTilesAndUpdateStatus(bool readOnly, TileStateHeader* tileStatus, bool* hasUnRenderedTile, bool *hasPendingResults)
 {
@@ -1946,6 +2124,11 @@ ImageCacheEntry::fetchCachedTilesAndUpdateStatus(bool readOnly, TileStateHeader*
                 }
             }
 
+            // Tiles of an evicted entry may be restored from the compressed tiles tier instead of being rendered again
+            if (!_imp->updateStateMapReadOnly && _imp->internalCacheEntry->isPersistent()) {
+                _imp->restoreCompressedTiles();
+            }
+
             if (!_imp->updateStateMapReadOnly && (!_imp->tilesToDownscale.empty() || !_imp->tilesToFetch.empty())) {
                 boost::scoped_ptr<boost::unique_lock<boost::shared_mutex> > writeLock;
                 if (!_imp->internalCacheEntry->isPersistent()) {
@@ -2354,7 +2537,7 @@ ImageCacheEntry::markCacheTilesAsRendered()
     U64 entryHash = _imp->internalCacheEntry->getHashKey();
     std::vector<TileHash> tilesAllocNeeded(tilesToCopy.size());
     for (std::size_t i = 0; i < tilesToCopy.size(); ++i) {
-        tilesAllocNeeded[i] = CacheBase::makeTileCacheIndex(tilesToCopy[i]->bounds.x1, tilesToCopy[i]->bounds.y1, _imp->mipMapLevel, tilesToCopy[i]->channel_i, entryHash);
+        tilesAllocNeeded[i] = CacheBase::makeTileCacheIndex(tilesToCopy[i]->bounds.x1, tilesToCopy[i]->bounds.y1, _imp->mipMapLevel, tilesToCopy[i]->channel_i, entryHash, _imp->isDraftModeEnabled);
     }
 #endif
 
@@ -2376,6 +2559,14 @@ ImageCacheEntry::markCacheTilesAsRendered()
         return;
     }
 
+    EffectInstancePtr renderClone = _imp->effect.lock();
+
+    // Let the render know how much it added to the cache, e.g: to bound the memory taken by prefetched frames
+    TreeRenderPtr currentRender = renderClone ? renderClone->getCurrentRender() : TreeRenderPtr();
+    if (currentRender) {
+        currentRender->addCachedTilesSize(allocatedTiles.size() * NATRON_TILE_SIZE_BYTES);
+    }
+
     // This is the tiles state at the mipmap level of interest in the cache
     TileStateHeader cacheStateMap(_imp->localTilesState.tileSizeX, _imp->localTilesState.tileSizeY, &_imp->internalCacheEntry->perMipMapTilesState[_imp->mipMapLevel]);
     assert(!cacheStateMap.state->tiles.empty());
@@ -2399,8 +2590,6 @@ ImageCacheEntry::markCacheTilesAsRendered()
         localTileState->channelsTileStorageIndex[tilesToCopy[i]->channel_i] = allocatedTiles[i].first;
     }
 
-    EffectInstancePtr renderClone = _imp->effect.lock();
-
     // Finally copy over multiple threads each tile
     boost::scoped_ptr<CachePixelsTransferProcessorBase> processor;
     switch (_imp->bitdepth) {
@@ -2434,6 +2623,15 @@ ImageCacheEntry::markCacheTilesAsRendered()
     }
 } // markCacheTilesAsRendered
 
+void
+ImageCacheEntry::addRenderTime(double timeSpentSeconds)
+{
+    if (_imp->cachePolicy == eCacheAccessModeNone || !_imp->internalCacheEntry) {
+        return;
+    }
+    _imp->internalCacheEntry->getCache()->addEntryComputeCost(_imp->internalCacheEntry->getHashKey(), timeSpentSeconds);
+}
+
 bool
 ImageCacheEntry::waitForPendingTiles()
 {
@@ -2479,10 +2677,14 @@ ImageCacheEntry::waitForPendingTiles()
         if (hasPendingResults) {
 
             timeSpentWaitingForPendingEntryMS += timeToWaitMS;
-            CacheEntryLockerBase::sleep_milliseconds(timeToWaitMS);
 
-            // Increase the time to wait at the next iteration
-            timeToWaitMS *= 1.2;
+            // Rather than sleeping, run a task that may not block, if any
+            if ( !appPTR->getRenderThreadPool()->runPendingTaskWhileWaiting() ) {
+                CacheEntryLockerBase::sleep_milliseconds(timeToWaitMS);
+
+                // Increase the time to wait at the next iteration
+                timeToWaitMS *= 1.2;
+            }
 
 
         }
@@ -130,6 +130,12 @@ public:
      **/
     void markCacheTilesAsRendered();
 
+    /**
+     * @brief Report the time spent rendering tiles of this image so that the cache may keep images
+     * that are expensive to render longer, @see CacheBase::addEntryComputeCost
+     **/
+    void addRenderTime(double timeSpentSeconds);
+
     /**
      * @brief This function should be called if the render was aborted to mark tiles that were marked pending
      * in an unrendered state.
@@ -34,6 +34,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #endif
 
 #include "Engine/EngineFwd.h"
+#include "Engine/ImageSIMD.h"
 #include "Engine/RectI.h"
 #include "Global/GlobalDefines.h"
 
@@ -355,25 +356,18 @@ static void downscaleMipMapForDepth(const PIX* srcTilesPtr[4],
             const PIX* src_pixels_next = srcTilesPtr[t_i] + tileSizeX;
 
             for (int y = 0; y < halfTileSizeY; ++y) {
-                for (int x = 0; x < halfTileSizeX; ++x) {
-                    
-                    assert( !(boost::math::isnan)(*src_pixels) ); // NaN check
-                    assert( !(boost::math::isnan)(*(src_pixels + 1)) ); // NaN check
-                    assert( !(boost::math::isnan)(*(src_pixels_next)) ); // NaN check
-                    assert( !(boost::math::isnan)(*(src_pixels_next + 1)) ); // NaN check
-
-                    double sum = (double)*src_pixels + (double)*(src_pixels + 1);
-                    sum += ((double)*src_pixels_next + (double)*(src_pixels_next + 1));
-                    sum /= 4;
-                    *dst_pixels = (PIX)sum;
-
-                    src_pixels_next += 2;
-                    src_pixels += 2;
-                    ++dst_pixels;
+#ifndef NDEBUG
+                for (int x = 0; x < tileSizeX; ++x) {
+                    assert( !(boost::math::isnan)(src_pixels[x]) ); // NaN check
+                    assert( !(boost::math::isnan)(src_pixels_next[x]) ); // NaN check
                 }
-                src_pixels += tileSizeX;
-                src_pixels_next += tileSizeX;
-                dst_pixels += halfTileSizeX;
+#endif
+                // Each dst pixel is the average of the 2x2 src pixels above it
+                ImageSIMD::halveRow(src_pixels, src_pixels_next, dst_pixels, 1, halfTileSizeX);
+
+                src_pixels += 2 * tileSizeX;
+                src_pixels_next += 2 * tileSizeX;
+                dst_pixels += tileSizeX;
             }
         }
     }
@@ -396,7 +390,7 @@ static void downscaleMipMap(ImageBitDepthEnum depth,
 {
     switch (depth) {
         case eImageBitDepthByte:
-            downscaleMipMapForDepth<char>((const char**)srcTilesPtr, (char*)dstTilePtr, dstTileBounds, tileSizeX, tileSizeY);
+            downscaleMipMapForDepth<unsigned char>((const unsigned char**)srcTilesPtr, (unsigned char*)dstTilePtr, dstTileBounds, tileSizeX, tileSizeY);
             break;
         case eImageBitDepthShort:
             downscaleMipMapForDepth<unsigned short>((const unsigned short**)srcTilesPtr, (unsigned short*)dstTilePtr, dstTileBounds, tileSizeX, tileSizeY);
@@ -39,6 +39,8 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/AppManager.h"
 #include "Engine/Texture.h"
 #include "Engine/Lut.h"
+#include "Engine/RenderTracer.h"
+#include "Engine/ImageSIMD.h"
 
 NATRON_NAMESPACE_ENTER
 
@@ -209,6 +211,32 @@ convertToFormatInternal_sameComps(const RectI & renderWindow,
                 }
             }
 
+        } else if (!srcLut && !dstLut) {
+            // No color-space conversion: each channel is converted independently, use the vectorized kernels
+
+            const SRCPIX* srcPixelPtrs[4] = {NULL, NULL, NULL, NULL};
+            int srcPixelStride;
+            Image::getChannelPointers<SRCPIX>((const SRCPIX**)srcBufPtrs, renderWindow.x1, y, srcBounds, nComp, (SRCPIX**)srcPixelPtrs, &srcPixelStride);
+
+            DSTPIX* dstPixelPtrs[4] = {NULL, NULL, NULL, NULL};
+            int dstPixelStride;
+            Image::getChannelPointers<DSTPIX>((const DSTPIX**)dstBufPtrs, renderWindow.x1, y, dstBounds, nComp, (DSTPIX**)dstPixelPtrs, &dstPixelStride);
+
+            if ( (srcPixelStride == dstPixelStride) && (srcPixelStride > 1) ) {
+                // In packed RGBA mode the whole scan-line can be converted at once
+                ImageSIMD::convertPixelDepthRow(srcPixelPtrs[0], dstPixelPtrs[0], renderWindow.width() * nComp);
+            } else {
+                for (int c = 0; c < nComp; ++c) {
+                    if (!dstPixelPtrs[c]) {
+                        continue;
+                    }
+                    if (srcPixelPtrs[c]) {
+                        ImageSIMD::convertPixelDepthStrided(srcPixelPtrs[c], srcPixelStride, dstPixelPtrs[c], dstPixelStride, renderWindow.width());
+                    } else {
+                        ImageSIMD::fillStrided( (DSTPIX)0, dstPixelPtrs[c], dstPixelStride, renderWindow.width() );
+                    }
+                }
+            }
         } else {
             // Start of the line for error diffusion
             // coverity[dont_call]
@@ -325,6 +353,62 @@ convertToFormatInternal_sameComps(const RectI & renderWindow,
     return eActionStatusOK;
 } // convertToFormatInternal_sameComps
 
+/**
+ * @brief Converts a scan-line with a different number of components when no color-space conversion
+ * nor dithering is needed.
+ **/
+template <typename SRCPIX, typename DSTPIX, int dstMaxValue, int srcNComps, int dstNComps>
+void
+convertToFormatInternalLine(const RectI & renderWindow,
+                            int y,
+                            int conversionChannel,
+                            Image::AlphaChannelHandlingEnum alphaHandling,
+                            const void* srcBufPtrs[4],
+                            const RectI& srcBounds,
+                            void* dstBufPtrs[4],
+                            const RectI& dstBounds)
+{
+    const SRCPIX* srcPixelPtrs[4] = {NULL, NULL, NULL, NULL};
+    int srcPixelStride;
+    Image::getChannelPointers<SRCPIX, srcNComps>((const SRCPIX**)srcBufPtrs, renderWindow.x1, y, srcBounds, (SRCPIX**)srcPixelPtrs, &srcPixelStride);
+
+    DSTPIX* dstPixelPtrs[4] = {NULL, NULL, NULL, NULL};
+    int dstPixelStride;
+    Image::getChannelPointers<DSTPIX, dstNComps>((const DSTPIX**)dstBufPtrs, renderWindow.x1, y, dstBounds, (DSTPIX**)dstPixelPtrs, &dstPixelStride);
+
+    const int width = renderWindow.width();
+
+    for (int k = 0; k < 3 && k < dstNComps; ++k) {
+        assert(dstPixelPtrs[k]);
+        if (srcPixelPtrs[k]) {
+            ImageSIMD::convertPixelDepthStrided(srcPixelPtrs[k], srcPixelStride, dstPixelPtrs[k], dstPixelStride, width);
+        } else {
+            ImageSIMD::fillStrided( (DSTPIX)0, dstPixelPtrs[k], dstPixelStride, width );
+        }
+    }
+
+    if (dstPixelPtrs[3] && !srcPixelPtrs[3]) {
+        // we reach here only if converting RGB-->RGBA or XY--->RGBA
+        switch (alphaHandling) {
+            case Image::eAlphaChannelHandlingCreateFill0:
+            default:
+                ImageSIMD::fillStrided( (DSTPIX)0, dstPixelPtrs[3], dstPixelStride, width );
+                break;
+            case Image::eAlphaChannelHandlingCreateFill1:
+                ImageSIMD::fillStrided( (DSTPIX)dstMaxValue, dstPixelPtrs[3], dstPixelStride, width );
+                break;
+            case Image::eAlphaChannelHandlingFillFromChannel:
+                assert(conversionChannel >= 0 && conversionChannel < srcNComps);
+                if (srcPixelPtrs[conversionChannel]) {
+                    ImageSIMD::convertPixelDepthStrided(srcPixelPtrs[conversionChannel], srcPixelStride, dstPixelPtrs[3], dstPixelStride, width);
+                } else {
+                    ImageSIMD::fillStrided( (DSTPIX)dstMaxValue, dstPixelPtrs[3], dstPixelStride, width );
+                }
+                break;
+        }
+    }
+} // convertToFormatInternalLine
+
 template <typename SRCPIX, int srcMaxValue, typename DSTPIX, int dstMaxValue, int srcNComps, int dstNComps>
 ActionRetCodeEnum
 convertToFormatInternal(const RectI & renderWindow,
@@ -353,6 +437,13 @@ convertToFormatInternal(const RectI & renderWindow,
             return eActionStatusAborted;
         }
 
+        if (!srcLut && !dstLut && dstMaxValue != 255) {
+            // Without color-space conversion nor error diffusion, each channel is converted independently:
+            // use the vectorized kernels
+            convertToFormatInternalLine<SRCPIX, DSTPIX, dstMaxValue, srcNComps, dstNComps>(renderWindow, y, conversionChannel, alphaHandling, srcBufPtrs, srcBounds, dstBufPtrs, dstBounds);
+            continue;
+        }
+
         int start = rand() % renderWindow.width() + renderWindow.x1;
 
         const SRCPIX* srcPixelPtrs[4] = {NULL, NULL, NULL, NULL};
@@ -530,8 +621,6 @@ convertToMonoImage(const RectI & renderWindow,
 {
     assert(dstBufPtrs[0] && !dstBufPtrs[1] && !dstBufPtrs[2] && !dstBufPtrs[3]);
 
-    DSTPIX pix;
-
     for (int y = renderWindow.y1; y < renderWindow.y2; ++y) {
         // Start of the line for error diffusion
         // coverity[dont_call]
@@ -550,25 +639,18 @@ convertToMonoImage(const RectI & renderWindow,
         Image::getChannelPointers<DSTPIX, 1>((const DSTPIX**)dstBufPtrs, renderWindow.x1, y, dstBounds, (DSTPIX**)dstPixelPtrs, &dstPixelStride);
 
 
-        for (int x = renderWindow.x1; x < renderWindow.x2; ++x) {
-            switch (alphaHandling) {
-                case Image::eAlphaChannelHandlingCreateFill0:
-                    pix = 0;
-                    break;
-                case Image::eAlphaChannelHandlingCreateFill1:
-                    pix = (DSTPIX)dstMaxValue;
-                    break;
-                case Image::eAlphaChannelHandlingFillFromChannel:
-                    assert(conversionChannel >= 0 && conversionChannel < srcNComps);
-                    pix = Image::convertPixelDepth<SRCPIX, DSTPIX>(*srcPixelPtrs[conversionChannel]);
-                    // Only increment the conversion channel pointer, this is the only one we use
-                    srcPixelPtrs[conversionChannel] += srcPixelStride;
-                    break;
-                    
-            }
-            assert( !(boost::math::isnan)(pix) ); // Check for NaNs
-            *dstPixelPtrs[0] = pix;
-            dstPixelPtrs[0] += dstPixelStride;
+        switch (alphaHandling) {
+            case Image::eAlphaChannelHandlingCreateFill0:
+                ImageSIMD::fillStrided( (DSTPIX)0, dstPixelPtrs[0], dstPixelStride, renderWindow.width() );
+                break;
+            case Image::eAlphaChannelHandlingCreateFill1:
+                ImageSIMD::fillStrided( (DSTPIX)dstMaxValue, dstPixelPtrs[0], dstPixelStride, renderWindow.width() );
+                break;
+            case Image::eAlphaChannelHandlingFillFromChannel:
+                assert(conversionChannel >= 0 && conversionChannel < srcNComps);
+                // Only the conversion channel is used
+                ImageSIMD::convertPixelDepthStrided(srcPixelPtrs[conversionChannel], srcPixelStride, dstPixelPtrs[0], dstPixelStride, renderWindow.width());
+                break;
         }
     }
     return eActionStatusOK;
@@ -588,8 +670,6 @@ convertFromMonoImage(const RectI & renderWindow,
 
     assert(srcBufPtrs[0] && !srcBufPtrs[1] && !srcBufPtrs[2] && !srcBufPtrs[3]);
 
-    DSTPIX pix;
-
     for (int y = renderWindow.y1; y < renderWindow.y2; ++y) {
         // Start of the line for error diffusion
         // coverity[dont_call]
@@ -606,39 +686,30 @@ convertFromMonoImage(const RectI & renderWindow,
         int dstPixelStride;
         Image::getChannelPointers<DSTPIX, dstNComps>((const DSTPIX**)dstBufPtrs, renderWindow.x1, y, dstBounds, (DSTPIX**)dstPixelPtrs, &dstPixelStride);
 
-        for (int x = renderWindow.x1; x < renderWindow.x2; ++x) {
+        const int width = renderWindow.width();
 
-            pix = Image::convertPixelDepth<SRCPIX, DSTPIX>(*srcPixelPtrs[0]);
-            srcPixelPtrs[0] += srcPixelStride;
-
-            switch (monoConversion) {
-                case Image::eMonoToPackedConversionCopyToAll: {
-                    for (int c = 0; c < dstNComps; ++c) {
-                        *dstPixelPtrs[c] = pix;
-                        dstPixelPtrs[c] += dstPixelStride;
-                    }
-                }   break;
-                case Image::eMonoToPackedConversionCopyToChannelAndFillOthers: {
-                    assert(conversionChannel >= 0 && conversionChannel < dstNComps);
-                    for (int c = 0; c < dstNComps; ++c) {
-                        if (c == conversionChannel) {
-                            *dstPixelPtrs[c] = pix;
-                        } else {
-                            // Fill
-                            *dstPixelPtrs[c] = 0;
-                        }
-                        dstPixelPtrs[c] += dstPixelStride;
+        switch (monoConversion) {
+            case Image::eMonoToPackedConversionCopyToAll: {
+                for (int c = 0; c < dstNComps; ++c) {
+                    ImageSIMD::convertPixelDepthStrided(srcPixelPtrs[0], srcPixelStride, dstPixelPtrs[c], dstPixelStride, width);
+                }
+            }   break;
+            case Image::eMonoToPackedConversionCopyToChannelAndFillOthers: {
+                assert(conversionChannel >= 0 && conversionChannel < dstNComps);
+                for (int c = 0; c < dstNComps; ++c) {
+                    if (c == conversionChannel) {
+                        ImageSIMD::convertPixelDepthStrided(srcPixelPtrs[0], srcPixelStride, dstPixelPtrs[c], dstPixelStride, width);
+                    } else {
+                        // Fill
+                        ImageSIMD::fillStrided( (DSTPIX)0, dstPixelPtrs[c], dstPixelStride, width );
                     }
+                }
 
-                }   break;
-                case Image::eMonoToPackedConversionCopyToChannelAndLeaveOthers:
-                    *dstPixelPtrs[conversionChannel] = pix;
-
-                    // Don't increment other dst pixel pointers as we don't use them.
-                    dstPixelPtrs[conversionChannel] += dstPixelStride;
-                    break;
-
-            }
+            }   break;
+            case Image::eMonoToPackedConversionCopyToChannelAndLeaveOthers:
+                // Other dst channels are left untouched
+                ImageSIMD::convertPixelDepthStrided(srcPixelPtrs[0], srcPixelStride, dstPixelPtrs[conversionChannel], dstPixelStride, width);
+                break;
         }
     }
     return eActionStatusOK;
@@ -815,6 +886,8 @@ ImagePrivate::convertCPUImage(const RectI & renderWindow,
 {
     assert( srcBounds.contains(renderWindow) && dstBounds.contains(renderWindow) );
 
+    NATRON_RENDER_TRACE_SCOPE("image", "Convert planes");
+
     switch ( srcBitDepth ) {
         case eImageBitDepthByte:
             ///Same as a copy
@@ -24,6 +24,11 @@
 
 #include "ImagePrivate.h"
 
+#include <algorithm>
+#include <limits>
+
+#include "Engine/ImageSIMD.h"
+
 NATRON_NAMESPACE_ENTER
 
 template<int srcNComps, int dstNComps, typename PIX, int maxValue, bool masked, bool maskInvert>
@@ -36,7 +41,8 @@ applyMaskMixForMaskInvert(const void* originalImgPtrs[4],
                           double mix,
                           const RectI& bounds,
                           const RectI& roi,
-                          const EffectInstancePtr& renderClone)
+                          const EffectInstancePtr& renderClone,
+                          bool* foundNan)
 {
 
     PIX* dstPixelPtrs[4] = {NULL, NULL, NULL, NULL};
@@ -45,72 +51,115 @@ applyMaskMixForMaskInvert(const void* originalImgPtrs[4],
 
     const std::size_t dstRowElements = (std::size_t)bounds.width() * dstPixelStride;
 
+    // Integer images cannot hold NaNs
+    const bool checkNaNs = foundNan && std::numeric_limits<PIX>::has_quiet_NaN;
+
+    // The scan-lines are processed by chunks of pixels: for each chunk we compute the mix factor of each pixel
+    // and then dissolve the dst values to the original image values. If the dst image is packed, all channels of
+    // the chunk are processed at once, otherwise each channel is processed separately.
+    const bool dstPacked = dstPixelStride == dstNComps;
+    const int chunkElements = dstPacked ? dstNComps : 1;
+    float alpha[NATRON_IMAGE_SIMD_CHUNK_SIZE];
+    float alphaElements[NATRON_IMAGE_SIMD_CHUNK_SIZE * 4];
+    float srcF[NATRON_IMAGE_SIMD_CHUNK_SIZE * 4];
+    float dstF[NATRON_IMAGE_SIMD_CHUNK_SIZE * 4];
+
+    // Float images are processed in place, without conversion
+    const bool isFloat = std::numeric_limits<PIX>::has_quiet_NaN;
+
     for ( int y = roi.y1; y < roi.y2; ++y) {
 
         if (renderClone && renderClone->isRenderAborted()) {
             return eActionStatusAborted;
         }
-        for (int x = roi.x1; x < roi.x2; ++x) {
 
-            PIX* srcPixelPtrs[4] = {NULL, NULL, NULL, NULL};
-            int srcPixelStride = 0;
-            if (originalImgPtrs[0]) {
-                Image::getChannelPointers<PIX, srcNComps>((const PIX**)originalImgPtrs, x, y, originalImgBounds, (PIX**)srcPixelPtrs, &srcPixelStride);
-            }
+        const bool srcRowInBounds = srcNComps > 0 && originalImgPtrs[0] && originalImgBounds.y1 <= y && y < originalImgBounds.y2;
+        const bool maskRowInBounds = masked && maskImgBounds.y1 <= y && y < maskImgBounds.y2;
+
+        for (int x = roi.x1; x < roi.x2; x += NATRON_IMAGE_SIMD_CHUNK_SIZE) {
+
+            const int n = std::min(roi.x2 - x, NATRON_IMAGE_SIMD_CHUNK_SIZE);
 
-            float maskScale = 1.f;
             if (!masked) {
                 // just mix
-                float alpha = mix;
-                for (int c = 0; c < dstNComps; ++c) {
-                    float dstF = Image::convertPixelDepth<PIX, float>(*dstPixelPtrs[c]);
-                    float srcF;
-                    if (*srcPixelPtrs[c]) {
-                        srcF = Image::convertPixelDepth<PIX, float>(*srcPixelPtrs[c]);
-                        srcPixelPtrs[c] += srcPixelStride;
-                    } else {
-                        srcF = 0.;
+                std::fill(alpha, alpha + n, (float)mix);
+            } else {
+                // figure the scale factor from the mask pixels. Outside of the mask the scale factor is
+                // 0, or 1 if the mask is inverted.
+                std::fill(alpha, alpha + n, 0.f);
+                const int maskX1 = std::max(x, maskImgBounds.x1);
+                const int maskX2 = std::min(x + n, maskImgBounds.x2);
+                if (maskRowInBounds && maskX1 < maskX2) {
+                    PIX* maskPixelPtrs[4] = {NULL, NULL, NULL, NULL};
+                    int maskPixelStride;
+                    Image::getChannelPointers<PIX, 1>((const PIX**)maskImgPtrs, maskX1, y, maskImgBounds, (PIX**)maskPixelPtrs, &maskPixelStride);
+                    for (int i = maskX1; i < maskX2; ++i) {
+                        alpha[i - x] = *maskPixelPtrs[0] * (1.f / maxValue);
+                        maskPixelPtrs[0] += maskPixelStride;
                     }
-                    float v = dstF * alpha + (1.f - alpha) * srcF;
-                    *dstPixelPtrs[c] = Image::convertPixelDepth<float, PIX>(v);
+                }
+                ImageSIMD::maskMixAlphaRow(alpha, n, mix, maskInvert);
+            }
 
-                    dstPixelPtrs[c] += dstPixelStride;
+            const float* chunkAlpha = alpha;
+            if (chunkElements > 1) {
+                for (int i = 0; i < n; ++i) {
+                    for (int c = 0; c < chunkElements; ++c) {
+                        alphaElements[i * chunkElements + c] = alpha[i];
+                    }
                 }
-            } else {
+                chunkAlpha = alphaElements;
+            }
 
-                PIX* maskPixelPtrs[4] = {NULL, NULL, NULL, NULL};
-                int maskPixelStride;
-                Image::getChannelPointers<PIX, 1>((const PIX**)maskImgPtrs, x, y, maskImgBounds, (PIX**)maskPixelPtrs, &maskPixelStride);
+            // Original image pixels are 0 outside of its bounds
+            const int srcX1 = std::max(x, originalImgBounds.x1);
+            const int srcX2 = std::min(x + n, originalImgBounds.x2);
+            PIX* srcPixelPtrs[4] = {NULL, NULL, NULL, NULL};
+            int srcPixelStride = 0;
+            if (srcRowInBounds && srcX1 < srcX2) {
+                Image::getChannelPointers<PIX, srcNComps>((const PIX**)originalImgPtrs, srcX1, y, originalImgBounds, (PIX**)srcPixelPtrs, &srcPixelStride);
+            }
 
-                // figure the scale factor from that pixel
-                if (!maskPixelPtrs[0]) {
-                    maskScale = maskInvert ? 1.f : 0.f;
-                } else {
-                    maskScale = *maskPixelPtrs[0] * (1.f / maxValue);
-                    if (maskInvert) {
-                        maskScale = 1.f - maskScale;
-                    }
-                    maskPixelPtrs[0] += maskPixelStride;
+            for (int c = 0; c < dstNComps; c += chunkElements) {
+                PIX* dstPixels = dstPixelPtrs[c] + (x - roi.x1) * dstPixelStride;
+
+                float* dstValues = isFloat ? (float*)dstPixels : dstF;
+                if (!isFloat) {
+                    ImageSIMD::convertPixelDepthRow(dstPixels, dstF, n * chunkElements);
+                }
 
+                // Replace NaNs by 1 before mixing, as checkForNaNs would have done
+                if (checkNaNs && ImageSIMD::replaceNaNsRow(dstValues, n * chunkElements, 1.f)) {
+                    *foundNan = true;
                 }
-                float alpha = mix * maskScale;
-                for (int c = 0; c < dstNComps; ++c) {
-                    float dstF = Image::convertPixelDepth<PIX, float>(*dstPixelPtrs[c]);
-                    float srcF;
-                    if (*srcPixelPtrs[c]) {
-                        srcF = Image::convertPixelDepth<PIX, float>(*srcPixelPtrs[c]);
-                        srcPixelPtrs[c] += srcPixelStride;
-                    } else {
-                        srcF = 0.;
+
+                const bool sameLayout = (srcPixelStride == chunkElements) && (srcNComps == dstNComps);
+                const float* srcValues = srcF;
+                if ( isFloat && sameLayout && (srcX1 == x) && (srcX2 == x + n) ) {
+                    // The original image covers the chunk: read it directly
+                    srcValues = (const float*)srcPixelPtrs[c];
+                } else if (sameLayout) {
+                    std::fill(srcF, srcF + n * chunkElements, 0.f);
+                    ImageSIMD::convertPixelDepthRow((const PIX*)srcPixelPtrs[c], srcF + (srcX1 - x) * chunkElements, (srcX2 - srcX1) * chunkElements);
+                } else {
+                    std::fill(srcF, srcF + n * chunkElements, 0.f);
+                    float* srcFirstPixel = srcF + (srcX1 - x) * chunkElements;
+                    for (int k = 0; k < chunkElements; ++k) {
+                        if (srcPixelPtrs[c + k]) {
+                            ImageSIMD::convertPixelDepthStrided((const PIX*)srcPixelPtrs[c + k], srcPixelStride, srcFirstPixel + k, chunkElements, srcX2 - srcX1);
+                        }
                     }
-                    float v = dstF * alpha + (1.f - alpha) * srcF;
-                    *dstPixelPtrs[c] = Image::convertPixelDepth<float, PIX>(v);
-                    dstPixelPtrs[c] += dstPixelStride;
+                }
+
+                ImageSIMD::mixRow(srcValues, chunkAlpha, dstValues, n * chunkElements);
+
+                if (!isFloat) {
+                    ImageSIMD::convertPixelDepthRow((const float*)dstF, dstPixels, n * chunkElements);
                 }
             }
         }
         for (int c = 0; c < dstNComps; ++c) {
-            dstPixelPtrs[c] += (dstRowElements - roi.width() * dstPixelStride);
+            dstPixelPtrs[c] += dstRowElements;
         }
     }
     return eActionStatusOK;
@@ -127,12 +176,13 @@ applyMaskMixForMasked(const void* originalImgPtrs[4],
                       bool invertMask,
                       const RectI& bounds,
                       const RectI& roi,
-                      const EffectInstancePtr& renderClone)
+                      const EffectInstancePtr& renderClone,
+                      bool* foundNan)
 {
     if (invertMask) {
-        return applyMaskMixForMaskInvert<srcNComps, dstNComps, PIX, maxValue, masked, true>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, bounds, roi, renderClone);
+        return applyMaskMixForMaskInvert<srcNComps, dstNComps, PIX, maxValue, masked, true>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, bounds, roi, renderClone, foundNan);
     } else {
-        return applyMaskMixForMaskInvert<srcNComps, dstNComps, PIX, maxValue, masked, false>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, bounds, roi, renderClone);
+        return applyMaskMixForMaskInvert<srcNComps, dstNComps, PIX, maxValue, masked, false>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, bounds, roi, renderClone, foundNan);
     }
 }
 
@@ -147,12 +197,13 @@ applyMaskMixForDepth(const void* originalImgPtrs[4],
                      bool invertMask,
                      const RectI& bounds,
                      const RectI& roi,
-                     const EffectInstancePtr& renderClone)
+                     const EffectInstancePtr& renderClone,
+                     bool* foundNan)
 {
     if (maskImgPtrs[0]) {
-        return applyMaskMixForMasked<srcNComps, dstNComps, PIX, maxValue, true>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, invertMask, bounds, roi, renderClone);
+        return applyMaskMixForMasked<srcNComps, dstNComps, PIX, maxValue, true>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, invertMask, bounds, roi, renderClone, foundNan);
     } else {
-        return applyMaskMixForMasked<srcNComps, dstNComps, PIX, maxValue, false>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, invertMask, bounds, roi, renderClone);
+        return applyMaskMixForMasked<srcNComps, dstNComps, PIX, maxValue, false>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, invertMask, bounds, roi, renderClone, foundNan);
     }
 }
 
@@ -168,15 +219,16 @@ applyMaskMixForDstComponents(const void* originalImgPtrs[4],
                              bool invertMask,
                              const RectI& bounds,
                              const RectI& roi,
-                             const EffectInstancePtr& renderClone)
+                             const EffectInstancePtr& renderClone,
+                             bool* foundNan)
 {
     switch (dstImgBitDepth) {
         case eImageBitDepthByte:
-            return applyMaskMixForDepth<srcNComps, dstNComps, unsigned char, 255>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, invertMask, bounds, roi, renderClone);
+            return applyMaskMixForDepth<srcNComps, dstNComps, unsigned char, 255>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, invertMask, bounds, roi, renderClone, foundNan);
         case eImageBitDepthShort:
-            return applyMaskMixForDepth<srcNComps, dstNComps, unsigned short, 65535>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, invertMask, bounds, roi, renderClone);
+            return applyMaskMixForDepth<srcNComps, dstNComps, unsigned short, 65535>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, invertMask, bounds, roi, renderClone, foundNan);
         case eImageBitDepthFloat:
-            return applyMaskMixForDepth<srcNComps, dstNComps, float, 1>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, invertMask, bounds, roi, renderClone);
+            return applyMaskMixForDepth<srcNComps, dstNComps, float, 1>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, mix, invertMask, bounds, roi, renderClone, foundNan);
         default:
             assert(false);
             return eActionStatusFailed;
@@ -196,18 +248,19 @@ applyMaskMixForSrcComponents(const void* originalImgPtrs[4],
                              bool invertMask,
                              const RectI& bounds,
                              const RectI& roi,
-                             const EffectInstancePtr& renderClone)
+                             const EffectInstancePtr& renderClone,
+                             bool* foundNan)
 {
 
     switch (dstImgNComps) {
         case 1:
-            return applyMaskMixForDstComponents<srcNComps, 1>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, mix, invertMask, bounds, roi, renderClone);
+            return applyMaskMixForDstComponents<srcNComps, 1>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, mix, invertMask, bounds, roi, renderClone, foundNan);
         case 2:
-            return applyMaskMixForDstComponents<srcNComps, 2>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, mix, invertMask, bounds, roi, renderClone);
+            return applyMaskMixForDstComponents<srcNComps, 2>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, mix, invertMask, bounds, roi, renderClone, foundNan);
         case 3:
-            return applyMaskMixForDstComponents<srcNComps, 3>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, mix, invertMask, bounds, roi, renderClone);
+            return applyMaskMixForDstComponents<srcNComps, 3>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, mix, invertMask, bounds, roi, renderClone, foundNan);
         case 4:
-            return applyMaskMixForDstComponents<srcNComps, 4>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, mix, invertMask, bounds, roi, renderClone);
+            return applyMaskMixForDstComponents<srcNComps, 4>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, mix, invertMask, bounds, roi, renderClone, foundNan);
         default:
             return eActionStatusFailed;
     }
@@ -226,19 +279,23 @@ ImagePrivate::applyMaskMixCPU(const void* originalImgPtrs[4],
                               bool invertMask,
                               const RectI& bounds,
                               const RectI& roi,
-                              const EffectInstancePtr& renderClone)
+                              const EffectInstancePtr& renderClone,
+                              bool* foundNan)
 {
+    if (foundNan) {
+        *foundNan = false;
+    }
     switch (originalImgNComps) {
         case 1:
-            return applyMaskMixForSrcComponents<1>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, dstImgNComps, mix, invertMask, bounds, roi, renderClone);
+            return applyMaskMixForSrcComponents<1>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, dstImgNComps, mix, invertMask, bounds, roi, renderClone, foundNan);
         case 2:
-            return applyMaskMixForSrcComponents<2>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, dstImgNComps, mix, invertMask, bounds, roi, renderClone);
+            return applyMaskMixForSrcComponents<2>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, dstImgNComps, mix, invertMask, bounds, roi, renderClone, foundNan);
         case 3:
-            return applyMaskMixForSrcComponents<3>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, dstImgNComps, mix, invertMask, bounds, roi, renderClone);
+            return applyMaskMixForSrcComponents<3>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, dstImgNComps, mix, invertMask, bounds, roi, renderClone, foundNan);
         case 4:
-            return applyMaskMixForSrcComponents<4>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, dstImgNComps, mix, invertMask, bounds, roi, renderClone);
+            return applyMaskMixForSrcComponents<4>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, dstImgNComps, mix, invertMask, bounds, roi, renderClone, foundNan);
         default:
-            return applyMaskMixForSrcComponents<0>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, dstImgNComps, mix, invertMask, bounds, roi, renderClone);
+            return applyMaskMixForSrcComponents<0>(originalImgPtrs, originalImgBounds, maskImgPtrs, maskImgBounds, dstImgPtrs, dstImgBitDepth, dstImgNComps, mix, invertMask, bounds, roi, renderClone, foundNan);
     }
 
 }
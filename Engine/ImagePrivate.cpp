@@ -24,6 +24,9 @@
 
 #include "ImagePrivate.h"
 
+#include <algorithm>
+#include <limits>
+
 #if !defined(SBK_RUN) && !defined(Q_MOC_RUN)
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
 #include <boost/math/special_functions/fpclassify.hpp>
@@ -34,6 +37,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include <QThread>
 
 #include "Engine/Hash64.h"
+#include "Engine/ImageSIMD.h"
 #include "Engine/Node.h"
 
 NATRON_NAMESPACE_ENTER
@@ -342,6 +346,62 @@ ImagePrivate::checkIfCopyToTempImageIsNeeded(const Image& fromImage, const Image
     return eActionStatusOK;
 } // checkIfCopyToTempImageIsNeeded
 
+/**
+ * @brief Halve the dst pixels in [x1, x2[ of a scan-line, picking only the source samples that are within srcBounds.
+ * thisRowPtrs and nextRowPtrs point to the src pixel at srcBounds.x1 of the src rows y*2 and y*2+1, or are NULL
+ * if the row is not within srcBounds. dstPixelPtrs point to the dst pixel at x1.
+ **/
+template <typename PIX, int nComps>
+static void
+halveRowPartial(const PIX* thisRowPtrs[4],
+                const PIX* nextRowPtrs[4],
+                int srcPixelStride,
+                const RectI& srcBounds,
+                int x1,
+                int x2,
+                PIX* dstPixelPtrs[4],
+                int dstPixelStride)
+{
+    const bool pickThisRow = thisRowPtrs[0] != NULL;
+    const bool pickNextRow = nextRowPtrs[0] != NULL;
+    const int sumH = (int)pickNextRow + (int)pickThisRow;
+    assert(sumH == 1 || sumH == 2);
+
+    for (int x = x1; x < x2; ++x) {
+
+        // The current dst col, at y, covers the src cols x*2 (thisCol) and x*2+1 (nextCol).
+        const int srcx = x * 2;
+
+        // Check that we are within srcBounds.
+        const bool pickThisCol = srcBounds.x1 <= (srcx + 0) && (srcx + 0) < srcBounds.x2;
+        const bool pickNextCol = srcBounds.x1 <= (srcx + 1) && (srcx + 1) < srcBounds.x2;
+
+        const int sumW = (int)pickThisCol + (int)pickNextCol;
+        assert(sumW == 1 || sumW == 2);
+
+        const int sum = sumW * sumH;
+        assert(0 < sum && sum <= 4);
+
+        const int thisColOffset = (srcx - srcBounds.x1) * srcPixelStride;
+        const int nextColOffset = thisColOffset + srcPixelStride;
+        const int dstOffset = (x - x1) * dstPixelStride;
+
+        for (int k = 0; k < nComps; ++k) {
+
+            // Averaged pixels are as such:
+            // a b
+            // c d
+
+            const PIX a = (pickThisCol && pickThisRow) ? thisRowPtrs[k][thisColOffset] : 0;
+            const PIX b = (pickNextCol && pickThisRow) ? thisRowPtrs[k][nextColOffset] : 0;
+            const PIX c = (pickThisCol && pickNextRow) ? nextRowPtrs[k][thisColOffset] : 0;
+            const PIX d = (pickNextCol && pickNextRow) ? nextRowPtrs[k][nextColOffset] : 0;
+
+            dstPixelPtrs[k][dstOffset] = (a + b + c + d) / sum;
+        } // for each component
+    } // for each pixels on the line
+} // halveRowPartial
+
 template <typename PIX, int maxValue, int nComps>
 static ActionRetCodeEnum
 halveImageForInternal(const void* srcPtrs[4],
@@ -362,6 +422,15 @@ halveImageForInternal(const void* srcPtrs[4],
     const int dstRowElementsCount = dstBounds.width() * dstPixelStride;
     const int srcRowElementsCount = srcBounds.width() * srcPixelStride;
 
+    // Packed buffers are averaged in a single pass over all components, coplanar buffers one channel at a time.
+    // Other combinations of layouts are only handled by the scalar code.
+    const bool srcAndDstPacked = srcPixelStride == nComps && dstPixelStride == nComps;
+    const bool srcAndDstCoplanar = srcPixelStride == 1 && dstPixelStride == 1;
+
+    // Dst columns in [interiorX1, interiorX2[ cover 2 src columns within srcBounds
+    const int interiorX1 = std::min(dstBounds.x2, std::max(dstBounds.x1, (srcBounds.x1 + 1) >> 1));
+    const int interiorX2 = std::max(interiorX1, std::min(dstBounds.x2, srcBounds.x2 >> 1));
+    const bool canUseRowKernel = srcAndDstPacked || srcAndDstCoplanar;
 
     for (int y = dstBounds.y1; y < dstBounds.y2; ++y) {
 
@@ -375,52 +444,49 @@ halveImageForInternal(const void* srcPtrs[4],
         // Check that we are within srcBounds.
         const bool pickThisRow = srcBounds.y1 <= (srcy + 0) && (srcy + 0) < srcBounds.y2;
         const bool pickNextRow = srcBounds.y1 <= (srcy + 1) && (srcy + 1) < srcBounds.y2;
+        assert(pickThisRow || pickNextRow);
 
-        const int sumH = (int)pickNextRow + (int)pickThisRow;
-        assert(sumH == 1 || sumH == 2);
-
-        for (int x = dstBounds.x1; x < dstBounds.x2; ++x) {
-
-            // The current dst col, at y, covers the src cols x*2 (thisCol) and x*2+1 (nextCol).
-            const int srcx = x * 2;
-
-            // Check that we are within srcBounds.
-            const bool pickThisCol = srcBounds.x1 <= (srcx + 0) && (srcx + 0) < srcBounds.x2;
-            const bool pickNextCol = srcBounds.x1 <= (srcx + 1) && (srcx + 1) < srcBounds.x2;
-
-            const int sumW = (int)pickThisCol + (int)pickNextCol;
-            assert(sumW == 1 || sumW == 2);
+        const PIX* thisRowPtrs[4] = {NULL, NULL, NULL, NULL};
+        const PIX* nextRowPtrs[4] = {NULL, NULL, NULL, NULL};
+        PIX* dstRowPtrs[4] = {NULL, NULL, NULL, NULL};
+        for (int k = 0; k < nComps; ++k) {
+            if (pickThisRow) {
+                thisRowPtrs[k] = srcPixelPtrs[k] + (srcy - srcBounds.y1) * srcRowElementsCount;
+            }
+            if (pickNextRow) {
+                nextRowPtrs[k] = srcPixelPtrs[k] + (srcy + 1 - srcBounds.y1) * srcRowElementsCount;
+            }
+            dstRowPtrs[k] = dstPixelPtrs[k] + (y - dstBounds.y1) * dstRowElementsCount;
+        }
 
-            const int sum = sumW * sumH;
-            assert(0 < sum && sum <= 4);
+        if (!canUseRowKernel) {
+            halveRowPartial<PIX, nComps>(thisRowPtrs, nextRowPtrs, srcPixelStride, srcBounds, dstBounds.x1, dstBounds.x2, dstRowPtrs, dstPixelStride);
+            continue;
+        }
 
+        // Left edge
+        halveRowPartial<PIX, nComps>(thisRowPtrs, nextRowPtrs, srcPixelStride, srcBounds, dstBounds.x1, interiorX1, dstRowPtrs, dstPixelStride);
+
+        // Interior: if only one of the 2 src rows is within srcBounds, averaging it with itself
+        // gives the average of its 2 columns.
+        const PIX** row0 = pickThisRow ? thisRowPtrs : nextRowPtrs;
+        const PIX** row1 = pickNextRow ? nextRowPtrs : thisRowPtrs;
+        const int srcOffset = (interiorX1 * 2 - srcBounds.x1) * srcPixelStride;
+        const int dstOffset = (interiorX1 - dstBounds.x1) * dstPixelStride;
+        if (srcAndDstPacked) {
+            ImageSIMD::halveRow(row0[0] + srcOffset, row1[0] + srcOffset, dstRowPtrs[0] + dstOffset, nComps, interiorX2 - interiorX1);
+        } else {
             for (int k = 0; k < nComps; ++k) {
+                ImageSIMD::halveRow(row0[k] + srcOffset, row1[k] + srcOffset, dstRowPtrs[k] + dstOffset, 1, interiorX2 - interiorX1);
+            }
+        }
 
-                // Averaged pixels are as such:
-                // a b
-                // c d
-
-                const PIX a = (pickThisCol && pickThisRow) ? *(srcPixelPtrs[k]) : 0;
-                const PIX b = (pickNextCol && pickThisRow) ? *(srcPixelPtrs[k] + srcPixelStride) : 0;
-                const PIX c = (pickThisCol && pickNextRow) ? *(srcPixelPtrs[k] + srcRowElementsCount) : 0;
-                const PIX d = (pickNextCol && pickNextRow) ? *(srcPixelPtrs[k] + srcRowElementsCount + srcPixelStride)  : 0;
-
-                assert( sumW == 2 || ( sumW == 1 && ( (a == 0 && c == 0) || (b == 0 && d == 0) ) ) );
-                assert( sumH == 2 || ( sumH == 1 && ( (a == 0 && b == 0) || (c == 0 && d == 0) ) ) );
-
-                *dstPixelPtrs[k] = (a + b + c + d) / sum;
-
-                srcPixelPtrs[k] += srcPixelStride * 2;
-                dstPixelPtrs[k] += dstPixelStride;
-            } // for each component
-
-        } // for each pixels on the line
-
-        // Remove what was offset to the pointers during this scan-line and offset to the next
+        // Right edge
+        PIX* dstRightEdgePtrs[4] = {NULL, NULL, NULL, NULL};
         for (int k = 0; k < nComps; ++k) {
-            dstPixelPtrs[k] += (dstRowElementsCount - dstBounds.width() * dstPixelStride);
-            srcPixelPtrs[k] += ((srcRowElementsCount - dstBounds.width() * srcPixelStride) * 2);
+            dstRightEdgePtrs[k] = dstRowPtrs[k] + (interiorX2 - dstBounds.x1) * dstPixelStride;
         }
+        halveRowPartial<PIX, nComps>(thisRowPtrs, nextRowPtrs, srcPixelStride, srcBounds, interiorX2, dstBounds.x2, dstRightEdgePtrs, dstPixelStride);
     }  // for each scan line
     return eActionStatusOK;
 } // halveImageForInternal
@@ -483,29 +549,39 @@ checkForNaNsInternal(void* ptrs[4],
 {
     *foundNan = false;
 
+    // Integer images cannot hold NaNs
+    if (!std::numeric_limits<PIX>::has_quiet_NaN) {
+        return eActionStatusOK;
+    }
+
     PIX* dstPixelPtrs[4] = {NULL, NULL, NULL, NULL};
     int dstPixelStride;
     Image::getChannelPointers<PIX, nComps>((const PIX**)ptrs, roi.x1, roi.y1, bounds, (PIX**)dstPixelPtrs, &dstPixelStride);
     const int rowElementsCount = bounds.width() * dstPixelStride;
 
+    // With packed components a scan-line of the roi is contiguous, otherwise each channel is
+    assert(dstPixelStride == nComps || dstPixelStride == 1);
+    const bool packed = dstPixelStride == nComps;
+
     for (int y = roi.y1; y < roi.y2; ++y) {
         if (effect && effect->isRenderAborted()) {
             return eActionStatusAborted;
         }
-        for (int x = roi.x1; x < roi.x2; ++x) {
+        // we remove NaNs, but infinity values should pose no problem
+        // (if they do, please explain here which ones)
+        if (packed) {
+            if ( ImageSIMD::replaceNaNsRow(dstPixelPtrs[0], roi.width() * nComps, (PIX)1) ) {
+                *foundNan = true;
+            }
+        } else {
             for (int k = 0; k < nComps; ++k) {
-                // we remove NaNs, but infinity values should pose no problem
-                // (if they do, please explain here which ones)
-                if ( (boost::math::isnan)(*dstPixelPtrs[k]) ) { // check for NaN
-                    *dstPixelPtrs[k] = 1.;
+                if ( ImageSIMD::replaceNaNsRow(dstPixelPtrs[k], roi.width(), (PIX)1) ) {
                     *foundNan = true;
                 }
-                dstPixelPtrs[k] += dstPixelStride;
             }
         }
-        // Remove what was done at the previous scan-line and got to the next
         for (int k = 0; k < nComps; ++k) {
-            dstPixelPtrs[k] += (rowElementsCount - roi.width() * dstPixelStride);
+            dstPixelPtrs[k] += rowElementsCount;
         }
     } // for each scan-line
     return eActionStatusOK;
@@ -226,6 +226,10 @@ struct ImagePrivate
                                bool invertMask,
                                const RectI& roi);
 
+    /**
+     * @brief If foundNan is not NULL, NaNs in the dst image are also replaced by 1 before mixing,
+     * in the same pass over the pixels, and foundNan is set to true if any was found.
+     **/
     static ActionRetCodeEnum applyMaskMixCPU(const void* originalImgPtrs[4],
                                 const RectI& originalImgBounds,
                                 int originalImgNComps,
@@ -238,7 +242,8 @@ struct ImagePrivate
                                 bool invertMask,
                                 const RectI& dstBounds,
                                 const RectI& roi,
-                                const EffectInstancePtr& renderClone);
+                                const EffectInstancePtr& renderClone,
+                                bool* foundNan);
 
     static void copyUnprocessedChannelsGL(const GLImageStoragePtr& originalTexture,
                                           const GLImageStoragePtr& dstTexture,
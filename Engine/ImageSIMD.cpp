@@ -0,0 +1,1251 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ImageSIMD.h"
+
+// SSE2 is always available on x86-64
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NATRON_IMAGE_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+// AVX2 kernels are compiled for the avx2 target only and selected at runtime if the CPU supports it.
+// Older compilers cannot use AVX2 intrinsics in functions with a target attribute.
+#if defined(NATRON_IMAGE_SIMD_SSE2) && defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) ) && \
+    ( defined(__clang__) || (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) )
+#define NATRON_IMAGE_SIMD_AVX2
+#include <immintrin.h>
+#define NATRON_IMAGE_SIMD_AVX2_FUNCTION __attribute__( ( target("avx2") ) )
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define NATRON_IMAGE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#include <QtCore/QAtomicInt>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
+#include <boost/math/special_functions/fpclassify.hpp>
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+#endif
+
+#include "Engine/Lut.h"
+
+NATRON_NAMESPACE_ENTER
+
+namespace ImageSIMD {
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// 1 if enabled, set by setEnabled() while render threads may be reading it
+QAtomicInt simdEnabled(1);
+
+InstructionSetEnum
+detectInstructionSet()
+{
+#if defined(NATRON_IMAGE_SIMD_AVX2)
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") ) {
+        return eInstructionSetAVX2;
+    }
+#endif
+#if defined(NATRON_IMAGE_SIMD_SSE2)
+
+    return eInstructionSetSSE2;
+#elif defined(NATRON_IMAGE_SIMD_NEON)
+
+    return eInstructionSetNEON;
+#else
+
+    return eInstructionSetNone;
+#endif
+}
+
+InstructionSetEnum
+getSupportedInstructionSet()
+{
+    // Detection is cheap and always gives the same result: no need to protect it
+    static InstructionSetEnum supported = detectInstructionSet();
+
+    return supported;
+}
+
+/////////////// Scalar implementation, same as Image::convertPixelDepth
+
+inline unsigned char
+floatToByte(float pix)
+{
+    return (unsigned char)Color::floatToInt<256>(pix);
+}
+
+inline unsigned short
+floatToShort(float pix)
+{
+    return (unsigned short)Color::floatToInt<65536>(pix);
+}
+
+inline float
+byteToFloat(unsigned char pix)
+{
+    return Color::intToFloat<256>(pix);
+}
+
+inline float
+shortToFloat(unsigned short pix)
+{
+    return Color::intToFloat<65536>(pix);
+}
+
+inline unsigned short
+byteToShort(unsigned char pix)
+{
+    return (unsigned short)( (pix << 8) + pix );
+}
+
+inline unsigned char
+shortToByte(unsigned short pix)
+{
+    return (unsigned char)( ( (pix + 128UL) - ( (pix + 128UL) >> 8 ) ) >> 8 );
+}
+
+// Average of 2x2 pixels, see ImageCacheEntryProcessing::downscaleMipMapForDepth
+inline float
+average4(float a,
+         float b,
+         float c,
+         float d)
+{
+    double sum = (double)a + (double)b;
+
+    sum += ( (double)c + (double)d );
+
+    return (float)(sum / 4);
+}
+
+inline unsigned short
+average4(unsigned short a,
+         unsigned short b,
+         unsigned short c,
+         unsigned short d)
+{
+    return (unsigned short)( (a + b + c + d) >> 2 );
+}
+
+inline unsigned char
+average4(unsigned char a,
+         unsigned char b,
+         unsigned char c,
+         unsigned char d)
+{
+    return (unsigned char)( (a + b + c + d) >> 2 );
+}
+
+template <typename PIX>
+void
+halveRowScalar(const PIX* src0,
+               const PIX* src1,
+               PIX* dst,
+               int nComps,
+               std::size_t from,
+               std::size_t n)
+{
+    for (std::size_t p = from; p < n; ++p) {
+        const std::size_t srcIndex = 2 * p * nComps;
+        for (int k = 0; k < nComps; ++k) {
+            dst[p * nComps + k] = average4(src0[srcIndex + k], src0[srcIndex + nComps + k], src1[srcIndex + k], src1[srcIndex + nComps + k]);
+        }
+    }
+}
+
+inline unsigned int
+toBGRA(unsigned char r,
+       unsigned char g,
+       unsigned char b,
+       unsigned char a)
+{
+    return (a << 24) | (r << 16) | (g << 8) | b;
+}
+
+/////////////// SSE2
+
+#ifdef NATRON_IMAGE_SIMD_SSE2
+
+// Same as Color::floatToInt: 0 if v <= 0, maxValue if v >= 1, otherwise v * maxValue + 0.5 truncated
+inline __m128i
+floatToIntSSE2(__m128 v,
+               __m128 scale,
+               __m128i maxValue)
+{
+    __m128i i = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps(v, scale), _mm_set1_ps(0.5f) ) );
+    __m128i le0 = _mm_castps_si128( _mm_cmple_ps( v, _mm_setzero_ps() ) );
+    __m128i ge1 = _mm_castps_si128( _mm_cmpge_ps( v, _mm_set1_ps(1.f) ) );
+
+    i = _mm_andnot_si128(le0, i);
+
+    return _mm_or_si128( _mm_andnot_si128(ge1, i), _mm_and_si128(ge1, maxValue) );
+}
+
+std::size_t
+floatToByteSSE2(const float* src,
+                unsigned char* dst,
+                std::size_t n)
+{
+    const __m128 scale = _mm_set1_ps(255.f);
+    const __m128i maxValue = _mm_set1_epi32(255);
+    std::size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = floatToIntSSE2(_mm_loadu_ps(src + i), scale, maxValue);
+        __m128i b = floatToIntSSE2(_mm_loadu_ps(src + i + 4), scale, maxValue);
+        __m128i c = floatToIntSSE2(_mm_loadu_ps(src + i + 8), scale, maxValue);
+        __m128i d = floatToIntSSE2(_mm_loadu_ps(src + i + 12), scale, maxValue);
+        __m128i packed = _mm_packus_epi16( _mm_packs_epi32(a, b), _mm_packs_epi32(c, d) );
+        _mm_storeu_si128( (__m128i*)(dst + i), packed );
+    }
+
+    return i;
+}
+
+// There is no unsigned 32 to 16 bits packing in SSE2: offset the values to the signed range and back
+inline __m128i
+packUnsigned32To16SSE2(__m128i a,
+                       __m128i b)
+{
+    const __m128i offset = _mm_set1_epi32(32768);
+    __m128i packed = _mm_packs_epi32( _mm_sub_epi32(a, offset), _mm_sub_epi32(b, offset) );
+
+    return _mm_xor_si128( packed, _mm_set1_epi16( (short)0x8000 ) );
+}
+
+std::size_t
+floatToShortSSE2(const float* src,
+                 unsigned short* dst,
+                 std::size_t n)
+{
+    const __m128 scale = _mm_set1_ps(65535.f);
+    const __m128i maxValue = _mm_set1_epi32(65535);
+    std::size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = floatToIntSSE2(_mm_loadu_ps(src + i), scale, maxValue);
+        __m128i b = floatToIntSSE2(_mm_loadu_ps(src + i + 4), scale, maxValue);
+        _mm_storeu_si128( (__m128i*)(dst + i), packUnsigned32To16SSE2(a, b) );
+    }
+
+    return i;
+}
+
+std::size_t
+byteToFloatSSE2(const unsigned char* src,
+                float* dst,
+                std::size_t n)
+{
+    // Divide rather than multiply by the inverse to get the same result as Color::intToFloat
+    const __m128 maxValue = _mm_set1_ps(255.f);
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes = _mm_loadu_si128( (const __m128i*)(src + i) );
+        __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+        __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+        _mm_storeu_ps( dst + i, _mm_div_ps(_mm_cvtepi32_ps( _mm_unpacklo_epi16(lo, zero) ), maxValue) );
+        _mm_storeu_ps( dst + i + 4, _mm_div_ps(_mm_cvtepi32_ps( _mm_unpackhi_epi16(lo, zero) ), maxValue) );
+        _mm_storeu_ps( dst + i + 8, _mm_div_ps(_mm_cvtepi32_ps( _mm_unpacklo_epi16(hi, zero) ), maxValue) );
+        _mm_storeu_ps( dst + i + 12, _mm_div_ps(_mm_cvtepi32_ps( _mm_unpackhi_epi16(hi, zero) ), maxValue) );
+    }
+
+    return i;
+}
+
+std::size_t
+shortToFloatSSE2(const unsigned short* src,
+                 float* dst,
+                 std::size_t n)
+{
+    const __m128 maxValue = _mm_set1_ps(65535.f);
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i shorts = _mm_loadu_si128( (const __m128i*)(src + i) );
+        _mm_storeu_ps( dst + i, _mm_div_ps(_mm_cvtepi32_ps( _mm_unpacklo_epi16(shorts, zero) ), maxValue) );
+        _mm_storeu_ps( dst + i + 4, _mm_div_ps(_mm_cvtepi32_ps( _mm_unpackhi_epi16(shorts, zero) ), maxValue) );
+    }
+
+    return i;
+}
+
+std::size_t
+byteToShortSSE2(const unsigned char* src,
+                unsigned short* dst,
+                std::size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i factor = _mm_set1_epi16(257);
+    std::size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes = _mm_loadu_si128( (const __m128i*)(src + i) );
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm_mullo_epi16(_mm_unpacklo_epi8(bytes, zero), factor) );
+        _mm_storeu_si128( (__m128i*)(dst + i + 8), _mm_mullo_epi16(_mm_unpackhi_epi8(bytes, zero), factor) );
+    }
+
+    return i;
+}
+
+inline __m128i
+shortToByte32SSE2(__m128i v)
+{
+    v = _mm_add_epi32( v, _mm_set1_epi32(128) );
+
+    return _mm_srli_epi32(_mm_sub_epi32( v, _mm_srli_epi32(v, 8) ), 8);
+}
+
+std::size_t
+shortToByteSSE2(const unsigned short* src,
+                unsigned char* dst,
+                std::size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128( (const __m128i*)(src + i) );
+        __m128i b = _mm_loadu_si128( (const __m128i*)(src + i + 8) );
+        __m128i a16 = _mm_packs_epi32( shortToByte32SSE2( _mm_unpacklo_epi16(a, zero) ), shortToByte32SSE2( _mm_unpackhi_epi16(a, zero) ) );
+        __m128i b16 = _mm_packs_epi32( shortToByte32SSE2( _mm_unpacklo_epi16(b, zero) ), shortToByte32SSE2( _mm_unpackhi_epi16(b, zero) ) );
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm_packus_epi16(a16, b16) );
+    }
+
+    return i;
+}
+
+inline __m128
+average4SSE2(__m128 a,
+             __m128 b,
+             __m128 c,
+             __m128 d)
+{
+    const __m128d quarter = _mm_set1_pd(0.25);
+    __m128d lo = _mm_add_pd( _mm_add_pd( _mm_cvtps_pd(a), _mm_cvtps_pd(b) ), _mm_add_pd( _mm_cvtps_pd(c), _mm_cvtps_pd(d) ) );
+    __m128d hi = _mm_add_pd( _mm_add_pd( _mm_cvtps_pd( _mm_movehl_ps(a, a) ), _mm_cvtps_pd( _mm_movehl_ps(b, b) ) ),
+                             _mm_add_pd( _mm_cvtps_pd( _mm_movehl_ps(c, c) ), _mm_cvtps_pd( _mm_movehl_ps(d, d) ) ) );
+
+    return _mm_movelh_ps( _mm_cvtpd_ps( _mm_mul_pd(lo, quarter) ), _mm_cvtpd_ps( _mm_mul_pd(hi, quarter) ) );
+}
+
+std::size_t
+halveRowSSE2(const float* src0,
+             const float* src1,
+             float* dst,
+             int nComps,
+             std::size_t n)
+{
+    std::size_t p = 0;
+
+    if (nComps == 1) {
+        for (; p + 4 <= n; p += 4) {
+            __m128 r0a = _mm_loadu_ps(src0 + 2 * p);
+            __m128 r0b = _mm_loadu_ps(src0 + 2 * p + 4);
+            __m128 r1a = _mm_loadu_ps(src1 + 2 * p);
+            __m128 r1b = _mm_loadu_ps(src1 + 2 * p + 4);
+            __m128 a = _mm_shuffle_ps( r0a, r0b, _MM_SHUFFLE(2, 0, 2, 0) );
+            __m128 b = _mm_shuffle_ps( r0a, r0b, _MM_SHUFFLE(3, 1, 3, 1) );
+            __m128 c = _mm_shuffle_ps( r1a, r1b, _MM_SHUFFLE(2, 0, 2, 0) );
+            __m128 d = _mm_shuffle_ps( r1a, r1b, _MM_SHUFFLE(3, 1, 3, 1) );
+            _mm_storeu_ps( dst + p, average4SSE2(a, b, c, d) );
+        }
+    } else if (nComps == 4) {
+        for (; p < n; ++p) {
+            const float* s0 = src0 + 8 * p;
+            const float* s1 = src1 + 8 * p;
+            _mm_storeu_ps( dst + 4 * p, average4SSE2( _mm_loadu_ps(s0), _mm_loadu_ps(s0 + 4), _mm_loadu_ps(s1), _mm_loadu_ps(s1 + 4) ) );
+        }
+    }
+
+    return p;
+}
+
+// Packs 8 32-bit values in [0, 65535] to unsigned shorts
+inline __m128i
+packUnsigned32To16ForHalveSSE2(__m128i a,
+                                __m128i b)
+{
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16( (short)0x8000 );
+
+    return _mm_xor_si128( _mm_packs_epi32( _mm_sub_epi32(a, bias32), _mm_sub_epi32(b, bias32) ), bias16 );
+}
+
+// Sum of the pairs of unsigned shorts of v as 32-bit integers
+inline __m128i
+sumPairs16SSE2(__m128i v)
+{
+    const __m128i lowMask = _mm_set1_epi32(0xffff);
+
+    return _mm_add_epi32( _mm_and_si128(v, lowMask), _mm_srli_epi32(v, 16) );
+}
+
+std::size_t
+halveRowSSE2(const unsigned short* src0,
+             const unsigned short* src1,
+             unsigned short* dst,
+             int nComps,
+             std::size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t p = 0;
+
+    if (nComps == 1) {
+        for (; p + 8 <= n; p += 8) {
+            __m128i lo = _mm_add_epi32( sumPairs16SSE2( _mm_loadu_si128( (const __m128i*)(src0 + 2 * p) ) ),
+                                        sumPairs16SSE2( _mm_loadu_si128( (const __m128i*)(src1 + 2 * p) ) ) );
+            __m128i hi = _mm_add_epi32( sumPairs16SSE2( _mm_loadu_si128( (const __m128i*)(src0 + 2 * p + 8) ) ),
+                                        sumPairs16SSE2( _mm_loadu_si128( (const __m128i*)(src1 + 2 * p + 8) ) ) );
+            _mm_storeu_si128( (__m128i*)(dst + p), packUnsigned32To16ForHalveSSE2( _mm_srli_epi32(lo, 2), _mm_srli_epi32(hi, 2) ) );
+        }
+    } else if (nComps == 4) {
+        for (; p + 2 <= n; p += 2) {
+            __m128i sums[2];
+            for (int i = 0; i < 2; ++i) {
+                __m128i v0 = _mm_loadu_si128( (const __m128i*)(src0 + 8 * (p + i)) );
+                __m128i v1 = _mm_loadu_si128( (const __m128i*)(src1 + 8 * (p + i)) );
+                __m128i sum = _mm_add_epi32( _mm_unpacklo_epi16(v0, zero), _mm_unpackhi_epi16(v0, zero) );
+                sum = _mm_add_epi32( sum, _mm_add_epi32( _mm_unpacklo_epi16(v1, zero), _mm_unpackhi_epi16(v1, zero) ) );
+                sums[i] = _mm_srli_epi32(sum, 2);
+            }
+            _mm_storeu_si128( (__m128i*)(dst + 4 * p), packUnsigned32To16ForHalveSSE2(sums[0], sums[1]) );
+        }
+    }
+
+    return p;
+}
+
+// Sum of the pairs of bytes of v as 16-bit integers
+inline __m128i
+sumPairs8SSE2(__m128i v)
+{
+    const __m128i lowMask = _mm_set1_epi16(0xff);
+
+    return _mm_add_epi16( _mm_and_si128(v, lowMask), _mm_srli_epi16(v, 8) );
+}
+
+// Sum of the 2 consecutive packed RGBA pixels for each pair of pixels of v as 16-bit integers
+inline __m128i
+sumPixelPairs8SSE2(__m128i v)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+    return _mm_unpacklo_epi64( _mm_add_epi16( lo, _mm_srli_si128(lo, 8) ), _mm_add_epi16( hi, _mm_srli_si128(hi, 8) ) );
+}
+
+std::size_t
+halveRowSSE2(const unsigned char* src0,
+             const unsigned char* src1,
+             unsigned char* dst,
+             int nComps,
+             std::size_t n)
+{
+    std::size_t p = 0;
+
+    if (nComps == 1) {
+        for (; p + 16 <= n; p += 16) {
+            __m128i lo = _mm_add_epi16( sumPairs8SSE2( _mm_loadu_si128( (const __m128i*)(src0 + 2 * p) ) ),
+                                        sumPairs8SSE2( _mm_loadu_si128( (const __m128i*)(src1 + 2 * p) ) ) );
+            __m128i hi = _mm_add_epi16( sumPairs8SSE2( _mm_loadu_si128( (const __m128i*)(src0 + 2 * p + 16) ) ),
+                                        sumPairs8SSE2( _mm_loadu_si128( (const __m128i*)(src1 + 2 * p + 16) ) ) );
+            _mm_storeu_si128( (__m128i*)(dst + p), _mm_packus_epi16( _mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2) ) );
+        }
+    } else if (nComps == 4) {
+        for (; p + 4 <= n; p += 4) {
+            __m128i lo = _mm_add_epi16( sumPixelPairs8SSE2( _mm_loadu_si128( (const __m128i*)(src0 + 8 * p) ) ),
+                                        sumPixelPairs8SSE2( _mm_loadu_si128( (const __m128i*)(src1 + 8 * p) ) ) );
+            __m128i hi = _mm_add_epi16( sumPixelPairs8SSE2( _mm_loadu_si128( (const __m128i*)(src0 + 8 * p + 16) ) ),
+                                        sumPixelPairs8SSE2( _mm_loadu_si128( (const __m128i*)(src1 + 8 * p + 16) ) ) );
+            _mm_storeu_si128( (__m128i*)(dst + 4 * p), _mm_packus_epi16( _mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2) ) );
+        }
+    }
+
+    return p;
+}
+
+std::size_t
+scaleOffsetSSE2(float* buf,
+                std::size_t n,
+                double scale,
+                double offset)
+{
+    const __m128d s = _mm_set1_pd(scale);
+    const __m128d o = _mm_set1_pd(offset);
+    std::size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(buf + i);
+        __m128d lo = _mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(v), s), o);
+        __m128d hi = _mm_add_pd(_mm_mul_pd(_mm_cvtps_pd( _mm_movehl_ps(v, v) ), s), o);
+        _mm_storeu_ps( buf + i, _mm_movelh_ps( _mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi) ) );
+    }
+
+    return i;
+}
+
+// The 32-bit pixels are stored in little-endian order: b, g, r, a
+std::size_t
+packBGRASSE2(const unsigned char* r,
+             const unsigned char* g,
+             const unsigned char* b,
+             const unsigned char* a,
+             unsigned int* dst,
+             std::size_t n)
+{
+    std::size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i rv = _mm_loadu_si128( (const __m128i*)(r + i) );
+        __m128i gv = _mm_loadu_si128( (const __m128i*)(g + i) );
+        __m128i bv = _mm_loadu_si128( (const __m128i*)(b + i) );
+        __m128i av = _mm_loadu_si128( (const __m128i*)(a + i) );
+        __m128i bgLo = _mm_unpacklo_epi8(bv, gv);
+        __m128i bgHi = _mm_unpackhi_epi8(bv, gv);
+        __m128i raLo = _mm_unpacklo_epi8(rv, av);
+        __m128i raHi = _mm_unpackhi_epi8(rv, av);
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm_unpacklo_epi16(bgLo, raLo) );
+        _mm_storeu_si128( (__m128i*)(dst + i + 4), _mm_unpackhi_epi16(bgLo, raLo) );
+        _mm_storeu_si128( (__m128i*)(dst + i + 8), _mm_unpacklo_epi16(bgHi, raHi) );
+        _mm_storeu_si128( (__m128i*)(dst + i + 12), _mm_unpackhi_epi16(bgHi, raHi) );
+    }
+
+    return i;
+}
+
+std::size_t
+maskMixAlphaSSE2(float* buf,
+                 std::size_t n,
+                 double mix,
+                 bool maskInvert)
+{
+    const __m128d m = _mm_set1_pd(mix);
+    const __m128 one = _mm_set1_ps(1.f);
+    std::size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(buf + i);
+        if (maskInvert) {
+            v = _mm_sub_ps(one, v);
+        }
+        __m128d lo = _mm_mul_pd(_mm_cvtps_pd(v), m);
+        __m128d hi = _mm_mul_pd(_mm_cvtps_pd( _mm_movehl_ps(v, v) ), m);
+        _mm_storeu_ps( buf + i, _mm_movelh_ps( _mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi) ) );
+    }
+
+    return i;
+}
+
+std::size_t
+mixSSE2(const float* src,
+        const float* alpha,
+        float* dst,
+        std::size_t n)
+{
+    const __m128 one = _mm_set1_ps(1.f);
+    std::size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 a = _mm_loadu_ps(alpha + i);
+        __m128 d = _mm_mul_ps(_mm_loadu_ps(dst + i), a);
+        __m128 s = _mm_mul_ps(_mm_sub_ps(one, a), _mm_loadu_ps(src + i));
+        _mm_storeu_ps( dst + i, _mm_add_ps(d, s) );
+    }
+
+    return i;
+}
+
+std::size_t
+replaceNaNsSSE2(float* buf,
+                std::size_t n,
+                float value,
+                bool* foundNaN)
+{
+    const __m128 v = _mm_set1_ps(value);
+    __m128 found = _mm_setzero_ps();
+    std::size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(buf + i);
+        __m128 isNaN = _mm_cmpunord_ps(x, x);
+        found = _mm_or_ps(found, isNaN);
+        _mm_storeu_ps( buf + i, _mm_or_ps( _mm_andnot_ps(isNaN, x), _mm_and_ps(isNaN, v) ) );
+    }
+    if ( _mm_movemask_ps(found) ) {
+        *foundNaN = true;
+    }
+
+    return i;
+}
+
+#endif // NATRON_IMAGE_SIMD_SSE2
+
+/////////////// AVX2
+
+#ifdef NATRON_IMAGE_SIMD_AVX2
+
+NATRON_IMAGE_SIMD_AVX2_FUNCTION
+inline __m256i
+floatToIntAVX2(__m256 v,
+               __m256 scale,
+               __m256i maxValue)
+{
+    __m256i i = _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps(v, scale), _mm256_set1_ps(0.5f) ) );
+    __m256i le0 = _mm256_castps_si256( _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_LE_OQ) );
+    __m256i ge1 = _mm256_castps_si256( _mm256_cmp_ps(v, _mm256_set1_ps(1.f), _CMP_GE_OQ) );
+
+    i = _mm256_andnot_si256(le0, i);
+
+    return _mm256_or_si256( _mm256_andnot_si256(ge1, i), _mm256_and_si256(ge1, maxValue) );
+}
+
+// Packs 8 signed 32 bits integers to 8 signed 16 bits integers, in order
+NATRON_IMAGE_SIMD_AVX2_FUNCTION
+inline __m128i
+pack32To16AVX2(__m256i v)
+{
+    return _mm_packs_epi32( _mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1) );
+}
+
+NATRON_IMAGE_SIMD_AVX2_FUNCTION
+std::size_t
+floatToByteAVX2(const float* src,
+                unsigned char* dst,
+                std::size_t n)
+{
+    const __m256 scale = _mm256_set1_ps(255.f);
+    const __m256i maxValue = _mm256_set1_epi32(255);
+    std::size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m256i a = floatToIntAVX2(_mm256_loadu_ps(src + i), scale, maxValue);
+        __m256i b = floatToIntAVX2(_mm256_loadu_ps(src + i + 8), scale, maxValue);
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm_packus_epi16( pack32To16AVX2(a), pack32To16AVX2(b) ) );
+    }
+
+    return i;
+}
+
+NATRON_IMAGE_SIMD_AVX2_FUNCTION
+std::size_t
+floatToShortAVX2(const float* src,
+                 unsigned short* dst,
+                 std::size_t n)
+{
+    const __m256 scale = _mm256_set1_ps(65535.f);
+    const __m256i maxValue = _mm256_set1_epi32(65535);
+    std::size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i a = floatToIntAVX2(_mm256_loadu_ps(src + i), scale, maxValue);
+        // _mm256_packus_epi32 interleaves the 128 bits lanes, reorder them afterwards
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, a), 0x08);
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm256_castsi256_si128(packed) );
+    }
+
+    return i;
+}
+
+NATRON_IMAGE_SIMD_AVX2_FUNCTION
+std::size_t
+byteToFloatAVX2(const unsigned char* src,
+                float* dst,
+                std::size_t n)
+{
+    const __m256 maxValue = _mm256_set1_ps(255.f);
+    std::size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)(src + i) ) );
+        _mm256_storeu_ps( dst + i, _mm256_div_ps(_mm256_cvtepi32_ps(v), maxValue) );
+    }
+
+    return i;
+}
+
+NATRON_IMAGE_SIMD_AVX2_FUNCTION
+std::size_t
+shortToFloatAVX2(const unsigned short* src,
+                 float* dst,
+                 std::size_t n)
+{
+    const __m256 maxValue = _mm256_set1_ps(65535.f);
+    std::size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*)(src + i) ) );
+        _mm256_storeu_ps( dst + i, _mm256_div_ps(_mm256_cvtepi32_ps(v), maxValue) );
+    }
+
+    return i;
+}
+
+#endif // NATRON_IMAGE_SIMD_AVX2
+
+/////////////// NEON
+
+#ifdef NATRON_IMAGE_SIMD_NEON
+
+// Float to integer conversions are not vectorized with NEON: the compiler may contract
+// the multiply-add of Color::floatToInt in the scalar code, which would give different roundings.
+
+std::size_t
+byteToFloatNEON(const unsigned char* src,
+                float* dst,
+                std::size_t n)
+{
+    const float32x4_t maxValue = vdupq_n_f32(255.f);
+    std::size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t v = vmovl_u8( vld1_u8(src + i) );
+        vst1q_f32( dst + i, vdivq_f32(vcvtq_f32_u32( vmovl_u16( vget_low_u16(v) ) ), maxValue) );
+        vst1q_f32( dst + i + 4, vdivq_f32(vcvtq_f32_u32( vmovl_u16( vget_high_u16(v) ) ), maxValue) );
+    }
+
+    return i;
+}
+
+std::size_t
+shortToFloatNEON(const unsigned short* src,
+                 float* dst,
+                 std::size_t n)
+{
+    const float32x4_t maxValue = vdupq_n_f32(65535.f);
+    std::size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t v = vld1q_u16(src + i);
+        vst1q_f32( dst + i, vdivq_f32(vcvtq_f32_u32( vmovl_u16( vget_low_u16(v) ) ), maxValue) );
+        vst1q_f32( dst + i + 4, vdivq_f32(vcvtq_f32_u32( vmovl_u16( vget_high_u16(v) ) ), maxValue) );
+    }
+
+    return i;
+}
+
+std::size_t
+byteToShortNEON(const unsigned char* src,
+                unsigned short* dst,
+                std::size_t n)
+{
+    std::size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        vst1q_u16( dst + i, vmulq_n_u16(vmovl_u8( vld1_u8(src + i) ), 257) );
+    }
+
+    return i;
+}
+
+inline uint16x4_t
+shortToByte32NEON(uint16x4_t v)
+{
+    uint32x4_t t = vaddq_u32( vmovl_u16(v), vdupq_n_u32(128) );
+
+    return vmovn_u32( vshrq_n_u32(vsubq_u32( t, vshrq_n_u32(t, 8) ), 8) );
+}
+
+std::size_t
+shortToByteNEON(const unsigned short* src,
+                unsigned char* dst,
+                std::size_t n)
+{
+    std::size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t v = vld1q_u16(src + i);
+        uint16x8_t r = vcombine_u16( shortToByte32NEON( vget_low_u16(v) ), shortToByte32NEON( vget_high_u16(v) ) );
+        vst1_u8( dst + i, vmovn_u16(r) );
+    }
+
+    return i;
+}
+
+#ifndef __AARCH64EB__
+// The 32-bit pixels are stored in little-endian order: b, g, r, a
+std::size_t
+packBGRANEON(const unsigned char* r,
+             const unsigned char* g,
+             const unsigned char* b,
+             const unsigned char* a,
+             unsigned int* dst,
+             std::size_t n)
+{
+    std::size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x4_t v;
+        v.val[0] = vld1q_u8(b + i);
+        v.val[1] = vld1q_u8(g + i);
+        v.val[2] = vld1q_u8(r + i);
+        v.val[3] = vld1q_u8(a + i);
+        vst4q_u8( (uint8_t*)(dst + i), v );
+    }
+
+    return i;
+}
+#endif
+
+std::size_t
+replaceNaNsNEON(float* buf,
+                std::size_t n,
+                float value,
+                bool* foundNaN)
+{
+    const float32x4_t v = vdupq_n_f32(value);
+    uint32x4_t notNaNs = vdupq_n_u32(0xffffffff);
+    std::size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t x = vld1q_f32(buf + i);
+        uint32x4_t notNaN = vceqq_f32(x, x);
+        notNaNs = vandq_u32(notNaNs, notNaN);
+        vst1q_f32( buf + i, vbslq_f32(notNaN, x, v) );
+    }
+    if (vminvq_u32(notNaNs) == 0) {
+        *foundNaN = true;
+    }
+
+    return i;
+}
+
+#endif // NATRON_IMAGE_SIMD_NEON
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+InstructionSetEnum
+getInstructionSet()
+{
+    return (int)simdEnabled ? getSupportedInstructionSet() : eInstructionSetNone;
+}
+
+const char*
+getInstructionSetName(InstructionSetEnum set)
+{
+    switch (set) {
+    case eInstructionSetSSE2:
+        return "SSE2";
+    case eInstructionSetAVX2:
+        return "AVX2";
+    case eInstructionSetNEON:
+        return "NEON";
+    case eInstructionSetNone:
+    default:
+        return "Scalar";
+    }
+}
+
+void
+setEnabled(bool enabled)
+{
+    simdEnabled.fetchAndStoreOrdered(enabled ? 1 : 0);
+}
+
+bool
+isEnabled()
+{
+    return (int)simdEnabled != 0;
+}
+
+void
+convertPixelDepthRow(const float* src,
+                     unsigned char* dst,
+                     std::size_t n)
+{
+    std::size_t i = 0;
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_AVX2
+    case eInstructionSetAVX2:
+        i = floatToByteAVX2(src, dst, n);
+        break;
+#endif
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetSSE2:
+        i = floatToByteSSE2(src, dst, n);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (; i < n; ++i) {
+        dst[i] = floatToByte(src[i]);
+    }
+}
+
+void
+convertPixelDepthRow(const float* src,
+                     unsigned short* dst,
+                     std::size_t n)
+{
+    std::size_t i = 0;
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_AVX2
+    case eInstructionSetAVX2:
+        i = floatToShortAVX2(src, dst, n);
+        break;
+#endif
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetSSE2:
+        i = floatToShortSSE2(src, dst, n);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (; i < n; ++i) {
+        dst[i] = floatToShort(src[i]);
+    }
+}
+
+void
+convertPixelDepthRow(const unsigned char* src,
+                     float* dst,
+                     std::size_t n)
+{
+    std::size_t i = 0;
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_AVX2
+    case eInstructionSetAVX2:
+        i = byteToFloatAVX2(src, dst, n);
+        break;
+#endif
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetSSE2:
+        i = byteToFloatSSE2(src, dst, n);
+        break;
+#endif
+#ifdef NATRON_IMAGE_SIMD_NEON
+    case eInstructionSetNEON:
+        i = byteToFloatNEON(src, dst, n);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (; i < n; ++i) {
+        dst[i] = byteToFloat(src[i]);
+    }
+}
+
+void
+convertPixelDepthRow(const unsigned short* src,
+                     float* dst,
+                     std::size_t n)
+{
+    std::size_t i = 0;
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_AVX2
+    case eInstructionSetAVX2:
+        i = shortToFloatAVX2(src, dst, n);
+        break;
+#endif
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetSSE2:
+        i = shortToFloatSSE2(src, dst, n);
+        break;
+#endif
+#ifdef NATRON_IMAGE_SIMD_NEON
+    case eInstructionSetNEON:
+        i = shortToFloatNEON(src, dst, n);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (; i < n; ++i) {
+        dst[i] = shortToFloat(src[i]);
+    }
+}
+
+void
+convertPixelDepthRow(const unsigned char* src,
+                     unsigned short* dst,
+                     std::size_t n)
+{
+    std::size_t i = 0;
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE2:
+        i = byteToShortSSE2(src, dst, n);
+        break;
+#endif
+#ifdef NATRON_IMAGE_SIMD_NEON
+    case eInstructionSetNEON:
+        i = byteToShortNEON(src, dst, n);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (; i < n; ++i) {
+        dst[i] = byteToShort(src[i]);
+    }
+}
+
+void
+convertPixelDepthRow(const unsigned short* src,
+                     unsigned char* dst,
+                     std::size_t n)
+{
+    std::size_t i = 0;
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE2:
+        i = shortToByteSSE2(src, dst, n);
+        break;
+#endif
+#ifdef NATRON_IMAGE_SIMD_NEON
+    case eInstructionSetNEON:
+        i = shortToByteNEON(src, dst, n);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (; i < n; ++i) {
+        dst[i] = shortToByte(src[i]);
+    }
+}
+
+void
+halveRow(const float* src0,
+         const float* src1,
+         float* dst,
+         int nComps,
+         std::size_t n)
+{
+    std::size_t p = 0;
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE2:
+        p = halveRowSSE2(src0, src1, dst, nComps, n);
+        break;
+#endif
+    default:
+        break;
+    }
+    halveRowScalar(src0, src1, dst, nComps, p, n);
+}
+
+void
+halveRow(const unsigned short* src0,
+         const unsigned short* src1,
+         unsigned short* dst,
+         int nComps,
+         std::size_t n)
+{
+    std::size_t p = 0;
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE2:
+        p = halveRowSSE2(src0, src1, dst, nComps, n);
+        break;
+#endif
+    default:
+        break;
+    }
+    halveRowScalar(src0, src1, dst, nComps, p, n);
+}
+
+void
+halveRow(const unsigned char* src0,
+         const unsigned char* src1,
+         unsigned char* dst,
+         int nComps,
+         std::size_t n)
+{
+    std::size_t p = 0;
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE2:
+        p = halveRowSSE2(src0, src1, dst, nComps, n);
+        break;
+#endif
+    default:
+        break;
+    }
+    halveRowScalar(src0, src1, dst, nComps, p, n);
+}
+
+void
+scaleOffsetRow(float* buf,
+               std::size_t n,
+               double scale,
+               double offset)
+{
+    std::size_t i = 0;
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE2:
+        i = scaleOffsetSSE2(buf, n, scale, offset);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (; i < n; ++i) {
+        buf[i] = buf[i] * scale + offset;
+    }
+}
+
+void
+packBGRARow(const unsigned char* r,
+            const unsigned char* g,
+            const unsigned char* b,
+            const unsigned char* a,
+            unsigned int* dst,
+            std::size_t n)
+{
+    std::size_t i = 0;
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE2:
+        i = packBGRASSE2(r, g, b, a, dst, n);
+        break;
+#endif
+#if defined(NATRON_IMAGE_SIMD_NEON) && !defined(__AARCH64EB__)
+    case eInstructionSetNEON:
+        i = packBGRANEON(r, g, b, a, dst, n);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (; i < n; ++i) {
+        dst[i] = toBGRA(r[i], g[i], b[i], a[i]);
+    }
+}
+
+void
+maskMixAlphaRow(float* buf,
+                std::size_t n,
+                double mix,
+                bool maskInvert)
+{
+    std::size_t i = 0;
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE2:
+        i = maskMixAlphaSSE2(buf, n, mix, maskInvert);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (; i < n; ++i) {
+        float maskScale = maskInvert ? 1.f - buf[i] : buf[i];
+        buf[i] = mix * maskScale;
+    }
+}
+
+void
+mixRow(const float* src,
+       const float* alpha,
+       float* dst,
+       std::size_t n)
+{
+    std::size_t i = 0;
+
+    // Not vectorized with NEON: the compiler may contract the scalar code below into a fused multiply-add
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE2:
+        i = mixSSE2(src, alpha, dst, n);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (; i < n; ++i) {
+        dst[i] = dst[i] * alpha[i] + (1.f - alpha[i]) * src[i];
+    }
+}
+
+bool
+replaceNaNsRow(float* buf,
+               std::size_t n,
+               float value)
+{
+    bool foundNaN = false;
+    std::size_t i = 0;
+
+    switch ( getInstructionSet() ) {
+#ifdef NATRON_IMAGE_SIMD_SSE2
+    case eInstructionSetAVX2:
+    case eInstructionSetSSE2:
+        i = replaceNaNsSSE2(buf, n, value, &foundNaN);
+        break;
+#endif
+#ifdef NATRON_IMAGE_SIMD_NEON
+    case eInstructionSetNEON:
+        i = replaceNaNsNEON(buf, n, value, &foundNaN);
+        break;
+#endif
+    default:
+        break;
+    }
+    for (; i < n; ++i) {
+        if ( (boost::math::isnan)(buf[i]) ) {
+            buf[i] = value;
+            foundNaN = true;
+        }
+    }
+
+    return foundNaN;
+}
+
+} // namespace ImageSIMD
+
+NATRON_NAMESPACE_EXIT
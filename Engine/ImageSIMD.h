@@ -0,0 +1,210 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_IMAGESIMD_H
+#define NATRON_ENGINE_IMAGESIMD_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "Engine/EngineFwd.h"
+
+// Number of pixels processed at once by the strided functions below
+#define NATRON_IMAGE_SIMD_CHUNK_SIZE 256
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Vectorized kernels for the most common operations on image scan-lines.
+ * The instruction set is selected at runtime depending on the CPU, and each kernel falls
+ * back on a scalar implementation if no instruction set is available.
+ * All kernels produce exactly the same results as their scalar implementation.
+ **/
+namespace ImageSIMD {
+
+enum InstructionSetEnum
+{
+    eInstructionSetNone = 0,
+    eInstructionSetSSE2,
+    eInstructionSetAVX2,
+    eInstructionSetNEON
+};
+
+/**
+ * @brief Returns the instruction set used by the kernels, which is the best one supported
+ * by the CPU, or eInstructionSetNone if disabled with setEnabled().
+ **/
+InstructionSetEnum getInstructionSet();
+
+const char* getInstructionSetName(InstructionSetEnum set);
+
+/**
+ * @brief When disabled, all kernels use their scalar implementation. This is used to
+ * compare the vectorized implementation with the scalar one. Enabled by default.
+ **/
+void setEnabled(bool enabled);
+
+bool isEnabled();
+
+/**
+ * @brief Convert n contiguous values from one bit depth to another, with the same rounding as
+ * Image::convertPixelDepth.
+ **/
+void convertPixelDepthRow(const float* src, unsigned char* dst, std::size_t n);
+void convertPixelDepthRow(const float* src, unsigned short* dst, std::size_t n);
+void convertPixelDepthRow(const unsigned char* src, float* dst, std::size_t n);
+void convertPixelDepthRow(const unsigned short* src, float* dst, std::size_t n);
+void convertPixelDepthRow(const unsigned char* src, unsigned short* dst, std::size_t n);
+void convertPixelDepthRow(const unsigned short* src, unsigned char* dst, std::size_t n);
+
+template <typename PIX>
+inline void
+convertPixelDepthRow(const PIX* src,
+                     PIX* dst,
+                     std::size_t n)
+{
+    std::memcpy(dst, src, n * sizeof(PIX));
+}
+
+/**
+ * @brief Same as convertPixelDepthRow except that consecutive values are separated by srcStride
+ * elements in src and dstStride elements in dst, e.g: to extract one channel of a packed RGBA buffer.
+ **/
+template <typename SRCPIX, typename DSTPIX>
+void
+convertPixelDepthStrided(const SRCPIX* src,
+                         int srcStride,
+                         DSTPIX* dst,
+                         int dstStride,
+                         std::size_t n)
+{
+    if ( (srcStride == 1) && (dstStride == 1) ) {
+        convertPixelDepthRow(src, dst, n);
+
+        return;
+    }
+    SRCPIX srcChunk[NATRON_IMAGE_SIMD_CHUNK_SIZE];
+    DSTPIX dstChunk[NATRON_IMAGE_SIMD_CHUNK_SIZE];
+    while (n > 0) {
+        std::size_t count = std::min(n, (std::size_t)NATRON_IMAGE_SIMD_CHUNK_SIZE);
+        const SRCPIX* srcPixels = src;
+        if (srcStride != 1) {
+            for (std::size_t i = 0; i < count; ++i) {
+                srcChunk[i] = src[i * srcStride];
+            }
+            srcPixels = srcChunk;
+        }
+        if (dstStride == 1) {
+            convertPixelDepthRow(srcPixels, dst, count);
+        } else {
+            convertPixelDepthRow(srcPixels, dstChunk, count);
+            for (std::size_t i = 0; i < count; ++i) {
+                dst[i * dstStride] = dstChunk[i];
+            }
+        }
+        src += count * srcStride;
+        dst += count * dstStride;
+        n -= count;
+    }
+}
+
+/**
+ * @brief Set n values separated by stride elements to value.
+ **/
+template <typename PIX>
+void
+fillStrided(PIX value,
+            PIX* dst,
+            int stride,
+            std::size_t n)
+{
+    if (stride == 1) {
+        std::fill(dst, dst + n, value);
+    } else {
+        for (std::size_t i = 0; i < n; ++i, dst += stride) {
+            *dst = value;
+        }
+    }
+}
+
+/**
+ * @brief Box-filter two consecutive scan-lines of 2*n pixels with nComps packed components into n pixels:
+ * each component is the average of the 2x2 source pixels above it. The sum is done in double precision for
+ * float, and truncated for integer types.
+ **/
+void halveRow(const float* src0, const float* src1, float* dst, int nComps, std::size_t n);
+void halveRow(const unsigned short* src0, const unsigned short* src1, unsigned short* dst, int nComps, std::size_t n);
+void halveRow(const unsigned char* src0, const unsigned char* src1, unsigned char* dst, int nComps, std::size_t n);
+
+/**
+ * @brief Computes buf[i] = buf[i] * scale + offset for n contiguous values. The computation is done
+ * in double precision, as the scalar code does when the coefficients are doubles.
+ **/
+void scaleOffsetRow(float* buf, std::size_t n, double scale, double offset);
+
+/**
+ * @brief Interleave n values of each of the r, g, b and a planes into n 32-bit pixels
+ * (a << 24) | (r << 16) | (g << 8) | b, which is the layout of the GL_BGRA viewer textures.
+ **/
+void packBGRARow(const unsigned char* r,
+                 const unsigned char* g,
+                 const unsigned char* b,
+                 const unsigned char* a,
+                 unsigned int* dst,
+                 std::size_t n);
+
+/**
+ * @brief Converts n mask values in [0, 1] to the mix factors used by Image::applyMaskMix:
+ * buf[i] = mix * buf[i], or mix * (1 - buf[i]) if maskInvert is true.
+ **/
+void maskMixAlphaRow(float* buf, std::size_t n, double mix, bool maskInvert);
+
+/**
+ * @brief Dissolves n values to the src values: dst[i] = dst[i] * alpha[i] + (1 - alpha[i]) * src[i].
+ **/
+void mixRow(const float* src, const float* alpha, float* dst, std::size_t n);
+
+/**
+ * @brief Replaces NaNs in n contiguous values by value. Returns true if any NaN was found.
+ **/
+bool replaceNaNsRow(float* buf, std::size_t n, float value);
+
+// Integer values cannot be NaN
+template <typename PIX>
+inline bool
+replaceNaNsRow(PIX* /*buf*/,
+               std::size_t /*n*/,
+               PIX /*value*/)
+{
+    return false;
+}
+
+} // namespace ImageSIMD
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_IMAGESIMD_H
@@ -410,25 +410,18 @@ Interpolation::solveQuartic(double c0,
     return num;
 } // solveQuartic
 
-/**
- * @brief Interpolates using the control points P0(t0,v0) , P3(t3,v3)
- * and the derivatives P1(t1,v1) (being the derivative at P0 with respect to
- * t \in [t1,t2]) and P2(t2,v2) (being the derivative at P3 with respect to
- * t \in [t1,t2]) the value at 'currentTime' using the
- * interpolation method "interp".
- * Note that for CATMULL-ROM you must use the function interpolate_catmullRom
- * which will compute the derivatives for you.
- **/
-double
-Interpolation::interpolate(double tcur,
-                           const double vcur,              //start control point
-                           const double vcurDerivRight, //being the derivative dv/dt at tcur
-                           const double vnextDerivLeft, //being the derivative dv/dt at tnext
-                           double tnext,
-                           const double vnext,               //end control point
-                           double currentTime,
-                           KeyframeTypeEnum interp,
-                           KeyframeTypeEnum interpNext)
+void
+Interpolation::getCubicCoefficients(double tcur,
+                                    const double vcur,              //start control point
+                                    const double vcurDerivRight, //being the derivative dv/dt at tcur
+                                    const double vnextDerivLeft, //being the derivative dv/dt at tnext
+                                    double tnext,
+                                    const double vnext,               //end control point
+                                    KeyframeTypeEnum interp,
+                                    KeyframeTypeEnum interpNext,
+                                    double* segmentStart,
+                                    double* segmentEnd,
+                                    double coeffs[4])
 {
     double P0 = vcur;
     double P3 = vnext;
@@ -456,11 +449,43 @@ Interpolation::interpolate(double tcur,
         P3 = P0 + P0pr;
         tnext = tcur + 1;
     }
-    double c0, c1, c2, c3;
-    hermiteToCubicCoeffs(P0, P0pr, P3pl, P3, &c0, &c1, &c2, &c3);
+    hermiteToCubicCoeffs(P0, P0pr, P3pl, P3, &coeffs[0], &coeffs[1], &coeffs[2], &coeffs[3]);
+    *segmentStart = tcur;
+    *segmentEnd = tnext;
+}
+
+double
+Interpolation::evaluateCubic(const double coeffs[4],
+                             double x)
+{
+    return cubicEval(coeffs[0], coeffs[1], coeffs[2], coeffs[3], x);
+}
+
+/**
+ * @brief Interpolates using the control points P0(t0,v0) , P3(t3,v3)
+ * and the derivatives P1(t1,v1) (being the derivative at P0 with respect to
+ * t \in [t1,t2]) and P2(t2,v2) (being the derivative at P3 with respect to
+ * t \in [t1,t2]) the value at 'currentTime' using the
+ * interpolation method "interp".
+ * Note that for CATMULL-ROM you must use the function interpolate_catmullRom
+ * which will compute the derivatives for you.
+ **/
+double
+Interpolation::interpolate(double tcur,
+                           const double vcur,              //start control point
+                           const double vcurDerivRight, //being the derivative dv/dt at tcur
+                           const double vnextDerivLeft, //being the derivative dv/dt at tnext
+                           double tnext,
+                           const double vnext,               //end control point
+                           double currentTime,
+                           KeyframeTypeEnum interp,
+                           KeyframeTypeEnum interpNext)
+{
+    double c[4];
+    getCubicCoefficients(tcur, vcur, vcurDerivRight, vnextDerivLeft, tnext, vnext, interp, interpNext, &tcur, &tnext, c);
 
     const double t = (currentTime - tcur) / (tnext - tcur);
-    double ret = cubicEval(c0, c1, c2, c3, t);
+    double ret = cubicEval(c[0], c[1], c[2], c[3], t);
 
     // cubicDerive: divide the result by (tnext-tcur)
 
@@ -50,6 +50,27 @@ double interpolate(double tcur, const double vcur, //start control point
                    KeyframeTypeEnum interp,
                    KeyframeTypeEnum interpNext) WARN_UNUSED_RETURN;
 
+/**
+ * @brief Returns the coefficients of the cubic c0 + c1.x + c2.x^2 + c3.x^3 that interpolate() evaluates
+ * between the given control points, with x = (currentTime - segmentStart) / (segmentEnd - segmentStart).
+ * segmentStart and segmentEnd differ from tcur and tnext when interp or interpNext is eKeyframeTypeNone.
+ * This is used to evaluate many times the same segment without recomputing the coefficients.
+ **/
+void getCubicCoefficients(double tcur, const double vcur, //start control point
+                          const double vcurDerivRight, //being the derivative dv/dt at tcur
+                          const double vnextDerivLeft, //being the derivative dv/dt at tnext
+                          double tnext, const double vnext, //end control point
+                          KeyframeTypeEnum interp,
+                          KeyframeTypeEnum interpNext,
+                          double* segmentStart,
+                          double* segmentEnd,
+                          double coeffs[4]);
+
+/**
+ * @brief Evaluates the cubic returned by getCubicCoefficients() at x. The result is exactly the one of interpolate().
+ **/
+double evaluateCubic(const double coeffs[4], double x) WARN_UNUSED_RETURN;
+
 /// derive at currentTime. The derivative is with respect to currentTime
 double derive(double tcur, const double vcur, //start control point
               const double vcurDerivRight, //being the derivative dv/dt at tcur
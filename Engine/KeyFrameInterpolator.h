@@ -43,6 +43,15 @@ public:
 
     virtual KeyFrameInterpolatorPtr createCopy() const;
 
+    /**
+     * @brief Returns true if interpolate() is overridden: the curve can then not be evaluated from
+     * the cubic segments of its snapshot.
+     **/
+    virtual bool isCustomInterpolator() const
+    {
+        return false;
+    }
+
     /**
      * @brief For a periodic curve, ensure t and the iterator point to keyframes in the periodic range
      **/
@@ -104,6 +113,11 @@ public:
 
     virtual KeyFrameInterpolatorPtr createCopy() const OVERRIDE;
 
+    virtual bool isCustomInterpolator() const OVERRIDE FINAL
+    {
+        return true;
+    }
+
     virtual KeyFrame interpolate(TimeValue t,
                                  KeyFrameSet::const_iterator itup,
                                  const KeyFrameSet& keyframes,
@@ -51,6 +51,9 @@
 #include "Engine/Hash64.h"
 #include "Engine/KnobFile.h"
 #include "Engine/KnobTypes.h"
+#include "Engine/RenderStats.h"
+#include "Engine/Settings.h"
+#include "Engine/Timer.h"
 #include "Engine/TreeRender.h"
 
 #include "Serialization/ProjectSerialization.h"
@@ -636,6 +639,22 @@ KnobHelper::isExpressionsResultsCachingEnabled() const
     return _imp->common->enableExpressionCaching;
 }
 
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// Protects lastExpressionResultsID
+static QMutex expressionResultsIDMutex;
+static U64 lastExpressionResultsID = 0;
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+U64
+KnobHelper::generateExpressionResultsID()
+{
+    QMutexLocker k(&expressionResultsIDMutex);
+
+    return ++lastExpressionResultsID;
+}
+
 void
 KnobDimViewBase::notifyCurveChanged()
 {
@@ -2212,6 +2231,11 @@ KnobHelper::cloneExpressions(const KnobIPtr& other, ViewSetSpec view, ViewSetSpe
 bool
 KnobHelper::invalidateHashCacheInternal(std::set<HashableObject*>* invalidatedObjects)
 {
+    // The knob may have become animated or driven by an expression
+    KnobHolderPtr holder = getHolder();
+    if (holder) {
+        holder->invalidateStaticKnobsHash();
+    }
     return HashableObject::invalidateHashCacheInternal(invalidatedObjects);
 }
 
@@ -4030,6 +4054,58 @@ KnobHelper::restoreKnobLinks(const boost::shared_ptr<SERIALIZATION_NAMESPACE::Kn
 
 typedef std::map<FrameViewRenderKey, KnobHolderWPtr, FrameViewRenderKey_compare_less> RenderCloneMap;
 
+// Maximum number of render clones of a holder kept to be recycled once their render is finished.
+// This is enough to cover the frames rendered concurrently during playback.
+#define NATRON_MAX_RECYCLED_RENDER_CLONES 8
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// The state of the main instance knobs that a recycled render clone depends on: the clone shares the
+// values of the main instance knobs but was created with the knobs the main instance had at that time
+U64
+computeRenderCloneKnobsHash(const KnobHolder& holder)
+{
+    Hash64 hash;
+    KnobsVec knobs = holder.getKnobs_mt_safe();
+    hash.append( (U64)knobs.size() );
+
+    HashableObject::ComputeHashArgs args;
+    args.hashType = HashableObject::eComputeHashTypeTimeViewInvariant;
+    for (KnobsVec::const_iterator it = knobs.begin(); it != knobs.end(); ++it) {
+        // Clones use the main instance knobs directly for knobs that do not evaluate on change
+        if ( !(*it)->getEvaluateOnChange() ) {
+            continue;
+        }
+        hash.append( (*it)->computeHash(args) );
+    }
+    hash.computeHash();
+
+    return hash.value();
+}
+
+// Removes the given recycled clone and the outdated ones from the recycled clones list
+class RecycledRenderCloneMatches
+{
+    KnobHolderPtr _recycled;
+    const std::list<KnobHolderPtr>* _outdated;
+
+public:
+
+    RecycledRenderCloneMatches(const KnobHolderPtr& recycled,
+                               const std::list<KnobHolderPtr>& outdated)
+    : _recycled(recycled)
+    , _outdated(&outdated)
+    {
+    }
+
+    bool operator()(const std::pair<U64, KnobHolderPtr>& item) const
+    {
+        return item.second == _recycled || std::find(_outdated->begin(), _outdated->end(), item.second) != _outdated->end();
+    }
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
 struct KnobItemsTableData
 {
     // Strong ref to the table
@@ -4104,6 +4180,14 @@ struct KnobHolderCommonData
     mutable QMutex renderClonesMutex;
     RenderCloneMap renderClones;
 
+    // Render clones whose render is finished, kept to be recycled by a later render.
+    // Each clone is stored with the hash of the main instance knobs at the time it was released.
+    // Protected by renderClonesMutex
+    std::list<std::pair<U64, KnobHolderPtr> > recycledRenderClones;
+
+    // Number of render clones created with createRenderCopy() and recycled, protected by renderClonesMutex
+    U64 nRenderClonesCreated, nRenderClonesRecycled;
+
     KnobHolderCommonData()
     : app()
     , evaluationBlockedMutex(QMutex::Recursive)
@@ -4122,11 +4206,23 @@ struct KnobHolderCommonData
     , overlaySlaves()
     , renderClonesMutex()
     , renderClones()
+    , recycledRenderClones()
+    , nRenderClonesCreated(0)
+    , nRenderClonesRecycled(0)
     {
 
     }
 };
 
+// The hash of the knobs of a holder that are constant over time, for a given view
+struct StaticKnobsHash
+{
+    U64 hash;
+
+    // The knobs that are not part of the hash because they vary over time
+    KnobsVec timeVaryingKnobs;
+};
+
 struct KnobHolder::KnobHolderPrivate
 {
     boost::shared_ptr<KnobHolderCommonData> common;
@@ -4147,6 +4243,17 @@ struct KnobHolder::KnobHolderPrivate
     // effects.
     FrameViewRenderKey currentRender;
 
+    // For each view, the hash of the knobs that do not vary over time, so that the time/view variant hash
+    // only needs to hash the animated knobs at each frame.
+    // Cleared whenever a knob changes: the age is incremented to not store a hash computed concurrently.
+    // Protected by staticKnobsHashMutex
+    mutable QMutex staticKnobsHashMutex;
+    std::map<ViewIdx, StaticKnobsHash> staticKnobsHash;
+    U64 staticKnobsHashAge;
+
+    // On a render clone, set once the Python expressions were evaluated for the current render
+    QAtomicInt pythonExpressionsEvaluated;
+
     KnobHolderPrivate(const AppInstancePtr& appInstance)
     : common(new KnobHolderCommonData)
     , knobsMutex()
@@ -4156,6 +4263,10 @@ struct KnobHolder::KnobHolderPrivate
     , isInitializingKnobs(false)
     , mainInstance()
     , currentRender()
+    , staticKnobsHashMutex()
+    , staticKnobsHash()
+    , staticKnobsHashAge(0)
+    , pythonExpressionsEvaluated(0)
     {
         common->app = appInstance;
         
@@ -4170,6 +4281,10 @@ struct KnobHolder::KnobHolderPrivate
     , isInitializingKnobs(false)
     , mainInstance()
     , currentRender()
+    , staticKnobsHashMutex()
+    , staticKnobsHash()
+    , staticKnobsHashAge(0)
+    , pythonExpressionsEvaluated(0)
     {
         // If the other is also a clone, forward to the other main instance
         mainInstance = other->getMainInstance();
@@ -4179,6 +4294,8 @@ struct KnobHolder::KnobHolderPrivate
     }
 
     void pushUndoCommandInternal(const UndoCommandPtr& command);
+
+    U64 getStaticKnobsHash(const HashableObject::ComputeHashArgs& args, KnobsVec* timeVaryingKnobs);
 };
 
 KnobHolder::KnobHolder(const AppInstancePtr& appInstance)
@@ -4228,6 +4345,60 @@ KnobHolder::getCurrentRender() const
     return _imp->currentRender.render.lock();
 }
 
+static bool
+hasPythonExpression(const KnobIPtr& knob,
+                    ViewIdx view)
+{
+    ViewIdx view_i = knob->checkIfViewExistsOrFallbackMainView(view);
+    int nDims = knob->getNDimensions();
+
+    for (int i = 0; i < nDims; ++i) {
+        if ( knob->hasExpression(DimIdx(i), view_i) && (knob->getExpressionLanguage(view_i, DimIdx(i)) == eExpressionLanguagePython) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void
+KnobHolder::evaluatePythonExpressionsForRender()
+{
+    if ( !_imp->mainInstance || !_imp->pythonExpressionsEvaluated.testAndSetOrdered(0, 1) ) {
+        return;
+    }
+
+    TimeValue time = getCurrentRenderTime();
+    ViewIdx view = getCurrentRenderView();
+    KnobsVec pythonKnobs;
+    {
+        KnobsVec knobs = getKnobs_mt_safe();
+        for (KnobsVec::const_iterator it = knobs.begin(); it != knobs.end(); ++it) {
+            if ( hasPythonExpression(*it, view) ) {
+                pythonKnobs.push_back(*it);
+            }
+        }
+    }
+    if ( pythonKnobs.empty() ) {
+        return;
+    }
+
+    std::vector<ViewIdx> views(1, view);
+    TimeLapse timer;
+    PythonGILLocker pgl;
+    double gilWaitTime = timer.getTimeSinceCreation();
+
+    for (KnobsVec::const_iterator it = pythonKnobs.begin(); it != pythonKnobs.end(); ++it) {
+        (*it)->prefetchPythonExpressionsResults(time, time, TimeValue(1.), views);
+    }
+
+    TreeRenderPtr render = getCurrentRender();
+    RenderStatsPtr stats = render ? render->getStatsObject() : RenderStatsPtr();
+    if (stats) {
+        stats->addPythonExpressionsBatch( gilWaitTime, (int)pythonKnobs.size() );
+    }
+} // evaluatePythonExpressionsForRender
+
 KnobHolderPtr
 KnobHolder::getMainInstance() const
 {
@@ -4403,7 +4574,7 @@ KnobHolder::addKnob(const KnobIPtr& k)
         _imp->knobs.push_back(k);
         assert(_imp->knobsOrdered.size() == _imp->knobs.size());
     }
-
+    invalidateStaticKnobsHash();
 }
 
 void
@@ -4413,6 +4584,8 @@ KnobHolder::insertKnob(int index,
     if (index < 0) {
         return;
     }
+    invalidateStaticKnobsHash();
+
     QMutexLocker kk(&_imp->knobsMutex);
     {
         std::map<std::string, KnobIWPtr>::iterator found = _imp->knobsOrdered.find(k->getName());
@@ -4435,6 +4608,8 @@ KnobHolder::insertKnob(int index,
 bool
 KnobHolder::removeKnobFromList(const KnobIConstPtr& knob)
 {
+    invalidateStaticKnobsHash();
+
     QMutexLocker kk(&_imp->knobsMutex);
     bool foundInVec = false;
     for (KnobsVec::iterator it = _imp->knobs.begin(); it != _imp->knobs.end(); ++it) {
@@ -5235,7 +5410,10 @@ KnobHolder::removeRenderClone(const TreeRenderPtr& render)
         RenderCloneMap newMap;
         for (RenderCloneMap::iterator it = _imp->common->renderClones.begin(); it != _imp->common->renderClones.end(); ++it) {
             if (it->first.render.lock() == render) {
-                clones.push_back(it->second.lock());
+                KnobHolderPtr clone = it->second.lock();
+                if (clone) {
+                    clones.push_back(clone);
+                }
                 continue;
             }
             newMap.insert(*it);
@@ -5246,6 +5424,33 @@ KnobHolder::removeRenderClone(const TreeRenderPtr& render)
     if (clones.empty()) {
         return false;
     }
+
+    // Keep the clones so that the next render may reuse them if the knobs did not change in between.
+    std::list<KnobHolderPtr> clonesToDestroy;
+    if ( isRenderCloneRecyclable() && _imp->common->knobsTables.empty() && appPTR->getCurrentSettings()->isRenderCloneRecyclingEnabled() ) {
+        U64 knobsHash = computeRenderCloneKnobsHash(*this);
+        for (std::list<KnobHolderPtr>::const_iterator it = clones.begin(); it != clones.end(); ++it) {
+            (*it)->releaseRenderCloneData();
+
+            QMutexLocker locker(&_imp->common->renderClonesMutex);
+            if ( (int)_imp->common->recycledRenderClones.size() < NATRON_MAX_RECYCLED_RENDER_CLONES ) {
+                _imp->common->recycledRenderClones.push_back( std::make_pair(knobsHash, *it) );
+            } else {
+                clonesToDestroy.push_back(*it);
+            }
+        }
+    } else {
+        clonesToDestroy = clones;
+    }
+
+    unregisterRenderCloneKnobs(clonesToDestroy);
+
+    return true;
+}
+
+void
+KnobHolder::unregisterRenderCloneKnobs(const std::list<KnobHolderPtr>& clones) const
+{
     for (std::list<KnobHolderPtr>::const_iterator it = clones.begin(); it != clones.end(); ++it) {
         // For each knob, remove the clone from the map
         for (std::size_t i = 0; i < _imp->knobs.size(); ++i) {
@@ -5257,8 +5462,74 @@ KnobHolder::removeRenderClone(const TreeRenderPtr& render)
             }
         }
     }
+}
 
-    return true;
+void
+KnobHolder::clearRecycledRenderClones()
+{
+    assert(!_imp->mainInstance);
+    std::list<KnobHolderPtr> clones;
+    {
+        QMutexLocker locker(&_imp->common->renderClonesMutex);
+        for (std::list<std::pair<U64, KnobHolderPtr> >::const_iterator it = _imp->common->recycledRenderClones.begin(); it != _imp->common->recycledRenderClones.end(); ++it) {
+            clones.push_back(it->second);
+        }
+        _imp->common->recycledRenderClones.clear();
+    }
+    unregisterRenderCloneKnobs(clones);
+}
+
+void
+KnobHolder::getRenderCloneAllocationCounts(U64* nCreated,
+                                           U64* nRecycled) const
+{
+    assert(!_imp->mainInstance);
+    QMutexLocker locker(&_imp->common->renderClonesMutex);
+    *nCreated = _imp->common->nRenderClonesCreated;
+    *nRecycled = _imp->common->nRenderClonesRecycled;
+}
+
+void
+KnobHolder::releaseRenderCloneData()
+{
+    assert(_imp->mainInstance);
+    _imp->currentRender = FrameViewRenderKey();
+
+    // Values cached for the previous render may depend on its time and view
+    for (std::size_t i = 0; i < _imp->knobs.size(); ++i) {
+        _imp->knobs[i]->clearRenderValuesCache();
+    }
+    _imp->pythonExpressionsEvaluated.fetchAndStoreOrdered(0);
+    invalidateRenderCloneHashCache();
+}
+
+void
+KnobHolder::recycleRenderCopy(const KnobHolderPtr& clone,
+                              const FrameViewRenderKey& key) const
+{
+    assert(clone->_imp->mainInstance.get() == this);
+    clone->_imp->currentRender = key;
+
+    // The main instance or the nodes upstream may have changed since the clone was released
+    clone->invalidateRenderCloneHashCache();
+}
+
+void
+KnobHolder::invalidateRenderCloneHashCache()
+{
+    assert(_imp->mainInstance);
+
+    // Only clear the cache of the clone: invalidateHashCacheInternal() on an effect also invalidates
+    // the outputs of its node, which are main instances
+    std::set<HashableObject*> invalidatedObjects;
+    HashableObject::invalidateHashCacheInternal(&invalidatedObjects);
+    for (std::size_t i = 0; i < _imp->knobs.size(); ++i) {
+        // Skip the knobs shared with the main instance
+        if (_imp->knobs[i]->getHolder().get() != this) {
+            continue;
+        }
+        _imp->knobs[i]->invalidateHashCacheInternal(&invalidatedObjects);
+    }
 }
 
 KnobHolderPtr
@@ -5278,6 +5549,35 @@ KnobHolder::createRenderClone(const FrameViewRenderKey& key) const
         }
     }
 
+    RenderStatsPtr stats = key.render.lock()->getStatsObject();
+
+    // Reuse a clone released by a previous render if the knobs did not change since then.
+    // Clones released with a different knobs state will never match again.
+    if ( !_imp->common->recycledRenderClones.empty() && appPTR->getCurrentSettings()->isRenderCloneRecyclingEnabled() ) {
+        U64 knobsHash = computeRenderCloneKnobsHash(*this);
+        KnobHolderPtr recycled;
+        std::list<KnobHolderPtr> outdatedClones;
+        for (std::list<std::pair<U64, KnobHolderPtr> >::const_iterator it = _imp->common->recycledRenderClones.begin(); it != _imp->common->recycledRenderClones.end(); ++it) {
+            if (!recycled && it->first == knobsHash) {
+                recycled = it->second;
+            } else if (it->first != knobsHash) {
+                outdatedClones.push_back(it->second);
+            }
+        }
+        _imp->common->recycledRenderClones.remove_if( RecycledRenderCloneMatches(recycled, outdatedClones) );
+        unregisterRenderCloneKnobs(outdatedClones);
+
+        if (recycled) {
+            recycleRenderCopy(recycled, key);
+            key.render.lock()->registerRenderClone(recycled);
+            _imp->common->renderClones[key] = recycled;
+            ++_imp->common->nRenderClonesRecycled;
+            if (stats) {
+                stats->addRenderCloneAllocation(true);
+            }
+            return recycled;
+        }
+    }
 
     KnobHolderPtr copy = createRenderCopy(key);
     if (!copy) {
@@ -5291,6 +5591,10 @@ KnobHolder::createRenderClone(const FrameViewRenderKey& key) const
 
 
     _imp->common->renderClones[key] = copy;
+    ++_imp->common->nRenderClonesCreated;
+    if (stats) {
+        stats->addRenderCloneAllocation(false);
+    }
 
     copy->initializeKnobsPublic();
     return copy;
@@ -5524,9 +5828,78 @@ KnobHolder::updateHasAnimation()
     _imp->common->hasAnimation = hasAnimation;
 }
 
+U64
+KnobHolder::KnobHolderPrivate::getStaticKnobsHash(const HashableObject::ComputeHashArgs& args,
+                                                  KnobsVec* timeVaryingKnobs)
+{
+    U64 age;
+    {
+        QMutexLocker k(&staticKnobsHashMutex);
+        std::map<ViewIdx, StaticKnobsHash>::const_iterator found = staticKnobsHash.find(args.view);
+        if ( found != staticKnobsHash.end() ) {
+            *timeVaryingKnobs = found->second.timeVaryingKnobs;
+
+            return found->second.hash;
+        }
+        age = staticKnobsHashAge;
+    }
+
+    KnobsVec allKnobs;
+    {
+        QMutexLocker k(&knobsMutex);
+        allKnobs = knobs;
+    }
+
+    Hash64 hash;
+    for (KnobsVec::const_iterator it = allKnobs.begin(); it != allKnobs.end(); ++it) {
+        if ( !(*it)->getEvaluateOnChange() ) {
+            continue;
+        }
+        if ( (*it)->isHashConstantOverTime(args.view) ) {
+            hash.append( (*it)->computeHash(args) );
+        } else {
+            timeVaryingKnobs->push_back(*it);
+        }
+    }
+    hash.computeHash();
+
+    StaticKnobsHash data;
+    data.hash = hash.value();
+    data.timeVaryingKnobs = *timeVaryingKnobs;
+
+    QMutexLocker k(&staticKnobsHashMutex);
+    // A knob changed while computing the hash: it may be out of date
+    if (age == staticKnobsHashAge) {
+        staticKnobsHash[args.view] = data;
+    }
+
+    return data.hash;
+} // getStaticKnobsHash
+
+void
+KnobHolder::invalidateStaticKnobsHash()
+{
+    QMutexLocker k(&_imp->staticKnobsHashMutex);
+
+    _imp->staticKnobsHash.clear();
+    ++_imp->staticKnobsHashAge;
+}
+
 void
 KnobHolder::appendToHash(const ComputeHashArgs& args, Hash64* hash)
 {
+    if (args.hashType == eComputeHashTypeTimeViewVariant) {
+        // Knobs that are neither animated nor driven by an expression are hashed once per view:
+        // only the other knobs are hashed at each frame
+        KnobsVec timeVaryingKnobs;
+        hash->append( _imp->getStaticKnobsHash(args, &timeVaryingKnobs) );
+        for (KnobsVec::const_iterator it = timeVaryingKnobs.begin(); it != timeVaryingKnobs.end(); ++it) {
+            hash->append( (*it)->computeHash(args) );
+        }
+
+        return;
+    }
+
     KnobsVec knobs = getKnobs_mt_safe();
     for (KnobsVec::const_iterator it = knobs.begin(); it!=knobs.end(); ++it) {
         if (!(*it)->getEvaluateOnChange()) {
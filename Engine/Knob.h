@@ -27,6 +27,7 @@
 
 #include "Global/Macros.h"
 
+#include <list>
 #include <vector>
 #include <string>
 #include <set>
@@ -37,6 +38,7 @@
 #include <boost/scoped_ptr.hpp>
 #endif
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QMutex>
 #include <QtCore/QString>
@@ -47,6 +49,7 @@
 #include "Engine/Cache.h" // CacheEntryLockerPtr - could we put this in EngineFwd.h?
 #include "Engine/DimensionIdx.h"
 #include "Engine/HashableObject.h"
+#include "Engine/KnobExpressionResultsCache.h"
 #include "Engine/KnobFactory.h"
 #include "Engine/Variant.h"
 #include "Engine/ViewIdx.h"
@@ -560,6 +563,16 @@ public:
 
     virtual void clearExpressionsResults(DimSpec dimension, ViewSetSpec view) = 0;
 
+    /**
+     * @brief Evaluates the Python expressions of this knob at each frame of the range and for each view
+     * so that their results are in the cache when rendering.
+     * The caller should take the Python GIL once around calls for all knobs, so that the render threads do not
+     * each wait for the GIL to evaluate expressions.
+     * On a render clone, the results are kept for the duration of the render, otherwise this does nothing
+     * if the results of expressions are not cached.
+     **/
+    virtual void prefetchPythonExpressionsResults(TimeValue firstFrame, TimeValue lastFrame, TimeValue frameStep, const std::vector<ViewIdx>& views) = 0;
+
     /**
      * @brief When enabled, results of expressions are cached. By default this is enabled.
      * This can be turned off in case the expression depends on external stuff that the caching
@@ -1645,6 +1658,9 @@ protected:
     
     ExpressionReturnValueTypeEnum executeExprTkExpression(TimeValue time, ViewIdx view, DimIdx dimension, double* retValueIsScalar, std::string* retValueIsString, std::string* error);
 
+    /// Returns a new identifier for the results of the expressions of a knob in the expression results cache
+    static U64 generateExpressionResultsID();
+
     /// The return value must be Py_DECRREF
     /// The expression must put its result in the Python variable named "ret"
     static bool executePythonExpression(const std::string& expr, PyObject** ret, std::string* error);
@@ -1657,6 +1673,10 @@ public:
     /// The expression must put its result in the Python variable named "ret"
     static ExpressionReturnValueTypeEnum evaluateExpression(const std::string& expr, ExpressionLanguageEnum language, double* retIsScalar, std::string* retIsString, std::string* error);
 
+    /// Returns the number of times exprtk expressions of knobs were compiled since the application started.
+    /// A compiled expression is shared by all threads, so this only grows with the number of concurrent evaluations.
+    static U64 getExprTkCompilationsCount();
+
 
     virtual bool getSharingMaster(DimIdx dimension, ViewIdx view, KnobDimViewKey* linkData) const OVERRIDE FINAL;
     virtual void getSharedValues(DimIdx dimension, ViewIdx view, KnobDimViewKeySet* sharedKnobs) const OVERRIDE FINAL;
@@ -1863,6 +1883,10 @@ public:
 
     virtual void appendToHash(const ComputeHashArgs& args, Hash64* hash) OVERRIDE;
 
+    /**
+     * @brief Returns true if no dimension is animated nor driven by an expression in the given view
+     **/
+    virtual bool isHashConstantOverTime(ViewIdx view) const OVERRIDE;
 
     virtual T getValueForHash(DimIdx dim, ViewIdx view);
 
@@ -2052,6 +2076,8 @@ public:
 
     virtual void clearExpressionsResults(DimSpec dimension, ViewSetSpec view) OVERRIDE FINAL;
 
+    virtual void prefetchPythonExpressionsResults(TimeValue firstFrame, TimeValue lastFrame, TimeValue frameStep, const std::vector<ViewIdx>& views) OVERRIDE FINAL;
+
 protected:
 
 
@@ -2092,6 +2118,8 @@ private:
 
     bool getValueFromExpression_pod(TimeValue time, ViewIdx view, DimIdx dimension, bool clamp, double* ret);
 
+    typename KnobExpressionResultsCache<T>::Key getExpressionResultsKey(TimeValue time, ViewIdx view, DimIdx dimension) const;
+
     //////////////////////////////////////////////////////////////////////
     /////////////////////////////////// End implementation of KnobI
     //////////////////////////////////////////////////////////////////////
@@ -2102,44 +2130,6 @@ private:
     };
 
 
-    struct TimeViewPair
-    {
-        TimeValue time;
-        ViewIdx view;
-    };
-
-
-    struct TimeView_compare_less
-    {
-        bool operator() (const TimeViewPair & lhs,
-                         const TimeViewPair & rhs) const
-        {
-
-            if (std::abs(lhs.time - rhs.time) < 1e-6) {
-                if (lhs.view == -1 || rhs.view == -1 || lhs.view == rhs.view) {
-                    return false;
-                }
-                if (lhs.view < rhs.view) {
-                    return true;
-                } else {
-                    // lhs.view > rhs.view
-                    return false;
-                }
-            } else if (lhs.time < rhs.time) {
-                return true;
-            } else {
-                assert(lhs.time > rhs.time);
-                return false;
-            }
-        }
-
-
-    };
-
-    typedef std::map<TimeViewPair, T, TimeView_compare_less> ExpressionCache;
-    typedef std::map<ViewIdx, ExpressionCache> PerViewExpressionCache;
-    typedef std::vector<PerViewExpressionCache> PerDimensionExpressionCache;
-
     typedef std::map<DimTimeView, T, ValueDimTimeViewCompareLess> ValuesCacheMap;
 
 
@@ -2155,8 +2145,11 @@ private:
         mutable QMutex minMaxMutex;
         std::vector<T>  minimums, maximums, displayMins, displayMaxs;
 
-        mutable QMutex expressionResultsMutex;
-        PerDimensionExpressionCache expressionResults;
+        // Identifies the results of the expressions of this knob in the expression results cache
+        U64 expressionResultsID;
+
+        // Incremented to invalidate the results of the expressions of this knob in the cache
+        QAtomicInt expressionResultsGeneration;
 
         Data(int nDims)
         : defaultValueMutex()
@@ -2166,13 +2159,18 @@ private:
         , maximums(nDims)
         , displayMins(nDims)
         , displayMaxs(nDims)
-        , expressionResultsMutex()
-        , expressionResults()
+        , expressionResultsID( KnobHelper::generateExpressionResultsID() )
+        , expressionResultsGeneration(0)
         {
 
         }
     };
 
+    typedef KnobExpressionResultsCache<T> ExpressionResultsCache;
+
+    // Results of the expressions of all knobs of this type
+    static ExpressionResultsCache _expressionResultsCache;
+
 
 
 
@@ -2544,6 +2542,12 @@ public:
      **/
     virtual bool isFullAnimationToHashEnabled() const;
 
+    /**
+     * @brief Clears the hash of the knobs of this holder that do not vary over time.
+     * This is called whenever one of the knobs changes.
+     **/
+    void invalidateStaticKnobsHash();
+
     enum KnobItemsTablePositionEnum
     {
         // The table will be placed at the bottom of all pages
@@ -2568,6 +2572,13 @@ public:
     virtual ViewIdx getCurrentRenderView() const;
 
     TreeRenderPtr getCurrentRender() const;
+
+    /**
+     * @brief On a render clone, evaluates the Python expressions of all knobs at the time and view of the render
+     * while holding the Python GIL once, so that the render actions then read the results without waiting for the GIL.
+     * Only the first call on a render clone does something.
+     **/
+    void evaluatePythonExpressionsForRender();
     
 
 protected:
@@ -2642,6 +2653,16 @@ public:
         return false;
     }
 
+    /**
+     * @brief Return true if a render clone of this knob holder may be kept once its render is finished
+     * to be reused by a later render, as long as the knobs of the main instance did not change in between.
+     * If this is implemented, also implement releaseRenderCloneData() and recycleRenderCopy()
+     **/
+    virtual bool isRenderCloneRecyclable() const
+    {
+        return false;
+    }
+
 
 protected:
 
@@ -2707,6 +2728,19 @@ public:
      **/
     KnobHolderPtr getRenderClone(const FrameViewRenderKey& key) const;
 
+    /**
+     * @brief Destroy the render clones that were kept to be recycled by later renders.
+     * Can only be called on the main instance!
+     **/
+    void clearRecycledRenderClones();
+
+    /**
+     * @brief Returns the number of render clones created with createRenderCopy() and the number
+     * of render clones that were recycled instead since this object was created.
+     * Can only be called on the main instance!
+     **/
+    void getRenderCloneAllocationCounts(U64* nCreated, U64* nRecycled) const;
+
 protected:
 
 
@@ -2731,6 +2765,29 @@ protected:
      * Derived implementation should call base-class version
      **/
     virtual void fetchRenderCloneKnobs();
+
+    /**
+     * @brief Called on a render clone when its render is finished and it is kept to be recycled:
+     * this should release any data tied to the render.
+     * Derived implementation should call base-class version
+     **/
+    virtual void releaseRenderCloneData();
+
+    /**
+     * @brief Called on the main instance to prepare a render clone released with releaseRenderCloneData()
+     * for the given render, instead of creating a new one with createRenderCopy().
+     * Derived implementation should call base-class version
+     **/
+    virtual void recycleRenderCopy(const KnobHolderPtr& clone, const FrameViewRenderKey& key) const;
+
+private:
+
+    // Remove the knobs of the given clones from the render clones of the main instance knobs
+    void unregisterRenderCloneKnobs(const std::list<KnobHolderPtr>& clones) const;
+
+    // Clear the hashes memoized by a render clone and its knobs: render clones are not notified of the changes
+    // of their main instance, so a recycled clone must not reuse the hashes of the previous render
+    void invalidateRenderCloneHashCache();
 };
 
 
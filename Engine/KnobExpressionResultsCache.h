@@ -0,0 +1,194 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_KNOBEXPRESSIONRESULTSCACHE_H
+#define NATRON_ENGINE_KNOBEXPRESSIONRESULTSCACHE_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <utility>
+
+#include <QtCore/QMutex>
+
+#include "Global/GlobalDefines.h"
+#include "Engine/Hash64.h"
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Caches the results of the expressions of all knobs holding values of type T, so that an expression
+ * is evaluated once for a given time and view.
+ *
+ * The results are spread over kNumShards shards, each protected by its own mutex, so that render threads reading
+ * the results of different knobs or different frames do not wait on each other. Each shard keeps at most
+ * kMaxEntriesPerShard results and evicts the least recently used ones.
+ *
+ * A result is identified by the knob and its generation: to invalidate all results of a knob, the knob only
+ * increments its generation. The stale results are never returned again and are evicted over time.
+ **/
+template <typename T>
+class KnobExpressionResultsCache
+{
+public:
+
+    static const int kNumShards = 32;
+    static const std::size_t kMaxEntriesPerShard = 2048;
+
+    struct Key
+    {
+        // Unique identifier of the knob. Render clones of a knob have the same identifier as the main instance.
+        U64 knobID;
+
+        // Incremented by the knob each time its results are invalidated
+        int generation;
+
+        int dimension;
+        int view;
+        double time;
+
+        bool operator<(const Key& other) const
+        {
+            if (knobID != other.knobID) {
+                return knobID < other.knobID;
+            }
+            if (generation != other.generation) {
+                return generation < other.generation;
+            }
+            if (dimension != other.dimension) {
+                return dimension < other.dimension;
+            }
+            if (view != other.view) {
+                return view < other.view;
+            }
+
+            return time < other.time;
+        }
+    };
+
+    KnobExpressionResultsCache()
+    {
+    }
+
+    /**
+     * @brief Returns true and the cached result in value if the expression was already evaluated for the key.
+     **/
+    bool get(const Key& key,
+             T* value)
+    {
+        Shard& shard = _shards[getShardIndex(key)];
+        QMutexLocker k(&shard.lock);
+        typename EntriesMap::iterator found = shard.entries.find(key);
+
+        if ( found == shard.entries.end() ) {
+            return false;
+        }
+
+        // Move the entry to the front of the LRU list
+        shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+        *value = found->second->second;
+
+        return true;
+    }
+
+    void insert(const Key& key,
+                const T& value)
+    {
+        Shard& shard = _shards[getShardIndex(key)];
+        QMutexLocker k(&shard.lock);
+        typename EntriesMap::iterator found = shard.entries.find(key);
+
+        if ( found != shard.entries.end() ) {
+            // Another thread evaluated the same expression concurrently
+            found->second->second = value;
+            shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+
+            return;
+        }
+
+        shard.lru.push_front( std::make_pair(key, value) );
+        shard.entries.insert( std::make_pair( key, shard.lru.begin() ) );
+        while (shard.entries.size() > kMaxEntriesPerShard) {
+            shard.entries.erase(shard.lru.back().first);
+            shard.lru.pop_back();
+        }
+    }
+
+    void clear()
+    {
+        for (int i = 0; i < kNumShards; ++i) {
+            QMutexLocker k(&_shards[i].lock);
+            _shards[i].entries.clear();
+            _shards[i].lru.clear();
+        }
+    }
+
+    std::size_t size() const
+    {
+        std::size_t ret = 0;
+
+        for (int i = 0; i < kNumShards; ++i) {
+            QMutexLocker k(&_shards[i].lock);
+            ret += _shards[i].entries.size();
+        }
+
+        return ret;
+    }
+
+private:
+
+    typedef std::list<std::pair<Key, T> > EntriesList;
+    typedef std::map<Key, typename EntriesList::iterator> EntriesMap;
+
+    struct Shard
+    {
+        mutable QMutex lock;
+
+        // Most recently used first
+        EntriesList lru;
+        EntriesMap entries;
+    };
+
+    static int getShardIndex(const Key& key)
+    {
+        // The results of a knob at successive frames go to different shards
+        U64 h = key.knobID * 31 + Hash64::toU64(key.time);
+
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+
+        return (int)(h % kNumShards);
+    }
+
+    Shard _shards[kNumShards];
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_KNOBEXPRESSIONRESULTSCACHE_H
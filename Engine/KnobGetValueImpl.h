@@ -55,25 +55,17 @@ Knob<T>::getValueFromExpression(TimeValue time,
 
     ViewIdx view_i = checkIfViewExistsOrFallbackMainView(view);
 
-    // Check for a cached expression result
-    // TODO
-
     bool cachingEnabled = isExpressionsResultsCachingEnabled();
     bool exprWasValid = isLinkValid(dimension, view_i, 0);
     {
         EXPR_RECURSION_LEVEL();
 
-        TimeViewPair key = {time, view};
+        typename ExpressionResultsCache::Key key = getExpressionResultsKey(time, view_i, dimension);
 
+        // Check for a cached expression result
         bool exprOk = false;
         if (cachingEnabled) {
-            QMutexLocker k(&_data->expressionResultsMutex);
-            assert(dimension < (int)_data->expressionResults.size());
-            typename ExpressionCache::const_iterator foundCached = _data->expressionResults[dimension][view].find(key);
-            if (foundCached != _data->expressionResults[dimension][view].end()) {
-                exprOk = true;
-                *ret = foundCached->second;
-            }
+            exprOk = _expressionResultsCache.get(key, ret);
         }
         std::string error;
         if (!exprOk) {
@@ -86,8 +78,7 @@ Knob<T>::getValueFromExpression(TimeValue time,
             
             exprOk = evaluateExpression(time, view_i,  dimension, ret, &error);
             if (exprOk && cachingEnabled) {
-                QMutexLocker k(&_data->expressionResultsMutex);
-                _data->expressionResults[dimension][view].insert(std::make_pair(key, *ret));
+                _expressionResultsCache.insert(key, *ret);
             }
         }
         if (!exprOk) {
@@ -169,31 +160,27 @@ Knob<T>::getValueFromExpression_pod(TimeValue time,
     }
 
     ViewIdx view_i = checkIfViewExistsOrFallbackMainView(view);
-    
-    // Check for a cached expression result
-    // Todo
 
     bool cachingEnabled = isExpressionsResultsCachingEnabled();
     bool exprWasValid = isLinkValid(dimension, view_i, 0);
     {
         EXPR_RECURSION_LEVEL();
         std::string error;
+        typename ExpressionResultsCache::Key key = getExpressionResultsKey(time, view_i, dimension);
+
+        // Check for a cached expression result
         bool exprOk = false;
-        TimeViewPair key = {time, view};
         if (cachingEnabled) {
-            QMutexLocker k(&_data->expressionResultsMutex);
-            assert(dimension < (int)_data->expressionResults.size());
-            typename ExpressionCache::const_iterator foundCached = _data->expressionResults[dimension][view].find(key);
-            if (foundCached != _data->expressionResults[dimension][view].end()) {
-                exprOk = true;
-                *ret = (double)foundCached->second;
+            T cachedValue;
+            exprOk = _expressionResultsCache.get(key, &cachedValue);
+            if (exprOk) {
+                *ret = (double)cachedValue;
             }
         }
         if (!exprOk) {
             exprOk = evaluateExpression_pod(time, view_i, dimension, ret, &error);
             if (exprOk && cachingEnabled) {
-                QMutexLocker k(&_data->expressionResultsMutex);
-                _data->expressionResults[dimension][view].insert(std::make_pair(key, (T)*ret));
+                _expressionResultsCache.insert(key, (T)*ret);
             }
         }
         if (!exprOk) {
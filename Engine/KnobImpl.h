@@ -601,30 +601,71 @@ Knob<T>::evaluateExpression_pod(TimeValue time,
     throw std::invalid_argument("KnobHelper::evaluateExpression_pod(): Unknown expression type");
 } // evaluateExpression_pod
 
+template <typename T>
+typename Knob<T>::ExpressionResultsCache Knob<T>::_expressionResultsCache;
+
+template <typename T>
+typename KnobExpressionResultsCache<T>::Key
+Knob<T>::getExpressionResultsKey(TimeValue time,
+                                 ViewIdx view,
+                                 DimIdx dimension) const
+{
+    typename ExpressionResultsCache::Key key;
+
+    key.knobID = _data->expressionResultsID;
+    key.generation = (int)_data->expressionResultsGeneration;
+    key.dimension = dimension;
+    key.view = view;
+    key.time = time;
+
+    return key;
+}
+
 template <typename T>
 void
-Knob<T>::clearExpressionsResults(DimSpec dimension, ViewSetSpec view)
+Knob<T>::clearExpressionsResults(DimSpec /*dimension*/, ViewSetSpec /*view*/)
 {
-    QMutexLocker k(&_data->expressionResultsMutex);
-    std::list<ViewIdx> views = getViewsList();
-    ViewIdx view_i;
-    if (!view.isAll()) {
-        view_i = checkIfViewExistsOrFallbackMainView(ViewIdx(view));
+    // The results of all dimensions and views are invalidated at once: the cache does not have to be searched
+    // for them, they will just never be returned again.
+    _data->expressionResultsGeneration.fetchAndAddOrdered(1);
+}
+
+template <typename T>
+void
+Knob<T>::prefetchPythonExpressionsResults(TimeValue firstFrame,
+                                          TimeValue lastFrame,
+                                          TimeValue frameStep,
+                                          const std::vector<ViewIdx>& views)
+{
+    // A render clone keeps the values read during the render
+    bool isRenderClone = (bool)_valuesCache;
+    if ( ( !isRenderClone && !isExpressionsResultsCachingEnabled() ) || ( (double)frameStep <= 0. ) ) {
+        return;
     }
+
+    // Do not evaluate more frames than the cache can hold for this knob
+    const int maxFrames = (int)( ExpressionResultsCache::kNumShards * ExpressionResultsCache::kMaxEntriesPerShard / 4 );
+    int nFrames = 0;
     int nDims = getNDimensions();
-    for (std::list<ViewIdx>::const_iterator it = views.begin(); it!=views.end(); ++it) {
-        if (!view.isAll() && *it != view_i) {
-            continue;
-        }
+    for (std::vector<ViewIdx>::const_iterator it = views.begin(); it != views.end(); ++it) {
+        ViewIdx view_i = checkIfViewExistsOrFallbackMainView(*it);
         for (int i = 0; i < nDims; ++i) {
-            if (!dimension.isAll() && i != dimension) {
+            if ( getExpression(DimIdx(i), view_i).empty() || (getExpressionLanguage(view_i, DimIdx(i)) != eExpressionLanguagePython) ) {
                 continue;
             }
-            _data->expressionResults[i][*it].clear();
+            for (double t = (double)firstFrame; t <= (double)lastFrame && nFrames < maxFrames; t += (double)frameStep, ++nFrames) {
+                if (isRenderClone) {
+                    // Read the value the way the render does so that it finds it in the values cache
+                    ignore_result( getValueAtTime(TimeValue(t), DimIdx(i), view_i, true) );
+                } else {
+                    T value;
+                    // The result is cached by getValueFromExpression
+                    ignore_result( getValueFromExpression(TimeValue(t), view_i, DimIdx(i), false, &value) );
+                }
+            }
         }
     }
-
-}
+} // prefetchPythonExpressionsResults
 
 
 template<typename T>
@@ -920,7 +961,6 @@ Knob<T>::populate()
         _valuesCache.reset(new ValuesCacheMap);
     }
     int nDims = getNDimensions();
-    _data->expressionResults.resize(nDims);
 
     if (!getMainInstance()) {
         for (int i = 0; i < nDims; ++i) {
@@ -1184,6 +1224,21 @@ Knob<T>::appendToHash(const ComputeHashArgs& args, Hash64* hash)
     }
 } // appendToHash
 
+template <typename T>
+bool
+Knob<T>::isHashConstantOverTime(ViewIdx view) const
+{
+    int nDims = getNDimensions();
+
+    for (int i = 0; i < nDims; ++i) {
+        if ( isAnimated(DimIdx(i), view) || hasExpression(DimIdx(i), view) ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 template <>
 CurveTypeEnum
 Knob<int>::getKeyFrameDataType() const
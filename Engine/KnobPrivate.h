@@ -31,6 +31,7 @@
 
 #include <algorithm> // min, max
 #include <cassert>
+#include <list>
 #include <stdexcept>
 
 #include <QtCore/QDataStream>
@@ -130,11 +131,14 @@ public:
     typedef boost::shared_ptr<ExpressionData> ExpressionDataPtr;
     typedef boost::weak_ptr<ExpressionData> ExpressionDataWPtr;
 
-    typedef std::map<QThread*, ExpressionDataPtr> PerThreadDataMap;
-
-    // Protects data
+    // Protects idleData
     mutable QMutex lock;
-    PerThreadDataMap data;
+
+    // The compiled expressions that are not being evaluated. An exprtk expression cannot be evaluated
+    // concurrently, thus a thread takes one out of this list for the time of the evaluation and puts it back after.
+    // The expression is only compiled again when all the compiled ones are being evaluated concurrently,
+    // so there are at most as many compiled expressions as concurrent evaluations, whatever the number of threads.
+    std::list<ExpressionDataPtr> idleData;
 
 
     // knob values dependencies mapped against their variable name in the expression
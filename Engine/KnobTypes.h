@@ -1483,6 +1483,12 @@ public:
 
     virtual void appendToHash(const ComputeHashArgs& args, Hash64* hash) OVERRIDE FINAL;
 
+    virtual bool isHashConstantOverTime(ViewIdx /*view*/) const OVERRIDE FINAL
+    {
+        // The whole curves are hashed
+        return true;
+    }
+
     virtual void clearRenderValuesCache() OVERRIDE FINAL;
 
     //////////// Overriden from AnimatingObjectI
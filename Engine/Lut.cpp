@@ -27,8 +27,12 @@
 #include <cstring> // for std::memcpy
 #include <algorithm> // min, max
 #include <cassert>
+#include <limits>
 #include <stdexcept>
 
+#include "Global/GlobalDefines.h"
+
+#include "Engine/ImageSIMD.h"
 #include "Engine/RectI.h"
 
 /*
@@ -93,6 +97,23 @@ hipart(const float f)
     }
 }
 
+union FloatBits
+{
+    float f;
+    U32 u;
+};
+
+/// the float whose 16 high bits are i and 16 low bits are 0
+static float
+hipart_to_float(const unsigned short i)
+{
+    FloatBits tmp;
+
+    tmp.u = (U32)i << 16;
+
+    return tmp.f;
+}
+
 static float
 index_to_float(const unsigned short i)
 {
@@ -285,62 +306,89 @@ Lut::toColorSpaceUint8xxFromLinearFloatFast(float v) const
     return toFunc_hipart_to_uint8xx[hipart(v)];
 }
 
-// the following only works for increasing LUTs
+void
+Lut::toColorSpaceUint8xxFromLinearFloatFast(const float* from,
+                                            int inDelta,
+                                            unsigned short* to,
+                                            int outDelta,
+                                            int n) const
+{
+    assert(init_);
+    for (int i = 0; i < n; ++i, from += inDelta, to += outDelta) {
+        *to = toFunc_hipart_to_uint8xx[hipart(*from)];
+    }
+}
+
+float
+Lut::toColorSpaceFloatFromLinearFloatInterpolated(float v) const
+{
+    // Within an interval of floats sharing the same 16 high bits, the value of the float
+    // is linear in its 16 low bits: interpolate between both ends of the interval.
+    FloatBits tmp;
+
+    tmp.f = v;
+    U32 i = tmp.u >> 16;
+    float t = (tmp.u & 0xffff) * (1.f / 0x10000);
+    float prev = toFunc_hipart_to_float[i];
+
+    return prev + (toFunc_hipart_to_float[i + 1] - prev) * t;
+}
+
 unsigned short
 Lut::toColorSpaceUint16FromLinearFloatFast(float v) const
 {
     assert(init_);
-    // algorithm:
-    // - convert to 8 bits -> val8u
-    // - convert val8u-1, val8u and val8u+1 to float
-    // - interpolate linearly in the right interval
-    unsigned char v8u = toColorSpaceUint8FromLinearFloatFast(v);
-    unsigned char v8u_next, v8u_prev;
-    float v32f_next, v32f_prev;
-    if (v8u == 0) {
-        v8u_prev = 0;
-        v8u_next = 1;
-        v32f_prev = fromColorSpaceUint8ToLinearFloatFast(0);
-        v32f_next = fromColorSpaceUint8ToLinearFloatFast(1);
-    } else if (v8u == 255) {
-        v8u_prev = 254;
-        v8u_next = 255;
-        v32f_prev = fromColorSpaceUint8ToLinearFloatFast(254);
-        v32f_next = fromColorSpaceUint8ToLinearFloatFast(255);
-    } else {
-        float v32f = fromColorSpaceUint8ToLinearFloatFast(v8u);
-        // we suppose the LUT is an increasing func
-        if (v < v32f) {
-            v8u_prev = v8u - 1;
-            v32f_prev = fromColorSpaceUint8ToLinearFloatFast(v8u_prev);
-            v8u_next = v8u;
-            v32f_next = v32f;
-        } else {
-            v8u_prev = v8u;
-            v32f_prev = v32f;
-            v8u_next = v8u + 1;
-            v32f_next = fromColorSpaceUint8ToLinearFloatFast(v8u_next);
+
+    return (unsigned short)Color::floatToInt<65536>( toColorSpaceFloatFromLinearFloatInterpolated(v) );
+}
+
+void
+Lut::toColorSpaceUint16FromLinearFloatFast(const float* from,
+                                           int inDelta,
+                                           unsigned short* to,
+                                           int outDelta,
+                                           int n) const
+{
+    assert(init_);
+    // The table lookups are scalar, but the quantization to 16 bits is vectorized
+    float buf[NATRON_IMAGE_SIMD_CHUNK_SIZE];
+    while (n > 0) {
+        int count = std::min(n, NATRON_IMAGE_SIMD_CHUNK_SIZE);
+        for (int i = 0; i < count; ++i) {
+            buf[i] = toColorSpaceFloatFromLinearFloatInterpolated(from[i * inDelta]);
         }
+        ImageSIMD::convertPixelDepthStrided(buf, 1, to, outDelta, count);
+        from += count * inDelta;
+        to += count * outDelta;
+        n -= count;
     }
-
-    // interpolate linearly
-    return (v8u_prev << 8) + v8u_prev + (v - v32f_prev) * ( ( (v8u_next - v8u_prev) << 8 ) + (v8u_next + v8u_prev) ) / (v32f_next - v32f_prev) + 0.5;
 }
 
 float
 Lut::fromColorSpaceUint16ToLinearFloatFast(unsigned short v) const
 {
     assert(init_);
-    // the following is from ImageMagick's quantum.h
-    unsigned char v8u_prev = ( v - (v >> 8) ) >> 8;
-    unsigned char v8u_next = v8u_prev + 1;
-    unsigned short v16u_prev = (v8u_prev << 8) + v8u_prev;
-    unsigned short v16u_next = (v8u_next << 8) + v8u_next;
-    float v32f_prev = fromColorSpaceUint8ToLinearFloatFast(v8u_prev);
-    float v32f_next = fromColorSpaceUint8ToLinearFloatFast(v8u_next);
 
-    // interpolate linearly
-    return v32f_prev + (v - v16u_prev) * (v32f_next - v32f_prev) / (v16u_next - v16u_prev);
+    return fromFunc_uint16_to_float[v];
+}
+
+void
+Lut::fromColorSpaceUint16ToLinearFloatFast(const unsigned short* from,
+                                           int inDelta,
+                                           float* to,
+                                           int outDelta,
+                                           int n) const
+{
+    assert(init_);
+    if ( (inDelta == 1) && (outDelta == 1) ) {
+        for (int i = 0; i < n; ++i) {
+            to[i] = fromFunc_uint16_to_float[from[i]];
+        }
+    } else {
+        for (int i = 0; i < n; ++i, from += inDelta, to += outDelta) {
+            *to = fromFunc_uint16_to_float[*from];
+        }
+    }
 }
 
 void
@@ -366,6 +414,29 @@ Lut::fillTables() const
         int i = hipart(f);
         toFunc_hipart_to_uint8xx[i] = Color::charToUint8xx(b);
     }
+    // fill the 16-bit tables
+    for (int i = 0; i < 0x10000; ++i) {
+        fromFunc_uint16_to_float[i] = _fromFunc( Color::intToFloat<65536>(i) );
+    }
+    for (int i = 0; i <= 0x10000; ++i) {
+        float inp;
+        if ( (i >= 0x7f80) && (i < 0x8000) ) {
+            // infinity and NaNs
+            inp = std::numeric_limits<float>::max();
+        } else if (i >= 0xff80) {
+            inp = -std::numeric_limits<float>::max();
+        } else {
+            inp = hipart_to_float( (unsigned short)i );
+        }
+        float f = _toFunc(inp);
+        // clamp so that the interpolation never produces NaNs or infinities, the result is anyway clamped to [0, 1]
+        if ( !(f >= -1.f) ) { // also catches NaN
+            f = -1.f;
+        } else if (f > 2.f) {
+            f = 2.f;
+        }
+        toFunc_hipart_to_float[i] = f;
+    }
 }
 
 #ifdef DEAD_CODE
@@ -422,20 +493,24 @@ Lut::to_byte_planar(unsigned char* to,
 
 #endif // DEAD_CODE
 
-#ifdef DEAD_CODE
 void
-Lut::to_short_planar(unsigned short* /*to*/,
-                     const float* /*from*/,
-                     int /*W*/,
-                     const float* /*alpha*/,
-                     int /*inDelta*/,
-                     int /*outDelta*/) const
+Lut::to_short_planar(unsigned short* to,
+                     const float* from,
+                     int W,
+                     const float* alpha,
+                     int inDelta,
+                     int outDelta) const
 {
-    throw std::runtime_error("Lut::to_short_planar not implemented yet.");
+    validate();
+    if (!alpha) {
+        toColorSpaceUint16FromLinearFloatFast(from, inDelta, to, outDelta, W);
+    } else {
+        for (int x = 0; x < W; ++x, from += inDelta, alpha += inDelta, to += outDelta) {
+            *to = toColorSpaceUint16FromLinearFloatFast(*from * *alpha);
+        }
+    }
 }
 
-#endif // DEAD_CODE
-
 void
 Lut::to_float_planar(float* to,
                      const float* from,
@@ -540,22 +615,74 @@ Lut::to_byte_packed(unsigned char* to,
     }
 } // to_byte_packed
 
-#ifdef DEAD_CODE
 void
-Lut::to_short_packed(unsigned short* /*to*/,
-                     const float* /*from*/,
-                     const RectI & /*conversionRect*/,
-                     const RectI & /*srcBounds*/,
-                     const RectI & /*dstBounds*/,
-                     PixelPackingEnum /*inputPacking*/,
-                     PixelPackingEnum /*outputPacking*/,
-                     bool /*invertY*/,
-                     bool /*premult*/) const
+Lut::to_short_packed(unsigned short* to,
+                     const float* from,
+                     const RectI & conversionRect,
+                     const RectI & srcBounds,
+                     const RectI & dstBounds,
+                     PixelPackingEnum inputPacking,
+                     PixelPackingEnum outputPacking,
+                     bool invertY,
+                     bool premult) const
 {
-    throw std::runtime_error("Lut::to_short_packed not implemented yet.");
-}
+    ///clip the conversion rect to srcBounds and dstBounds
+    RectI rect = conversionRect;
 
-#endif // DEAD_CODE
+    if ( !clip(&rect, srcBounds) || !clip(&rect, dstBounds) ) {
+        return;
+    }
+
+    bool inputHasAlpha = inputPacking == ePixelPackingBGRA || inputPacking == ePixelPackingRGBA;
+    bool outputHasAlpha = outputPacking == ePixelPackingBGRA || outputPacking == ePixelPackingRGBA;
+    int inROffset, inGOffset, inBOffset, inAOffset;
+    int outROffset, outGOffset, outBOffset, outAOffset;
+    getOffsetsForPacking(inputPacking, &inROffset, &inGOffset, &inBOffset, &inAOffset);
+    getOffsetsForPacking(outputPacking, &outROffset, &outGOffset, &outBOffset, &outAOffset);
+
+    int inPackingSize, outPackingSize;
+    inPackingSize = inputHasAlpha ? 4 : 3;
+    outPackingSize = outputHasAlpha ? 4 : 3;
+
+    validate();
+
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        int srcY = y;
+        if (invertY) {
+            srcY = srcBounds.y2 - y - 1;
+        }
+
+        int dstY = dstBounds.y2 - y - 1;
+        const float *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
+        unsigned short *dst_pixels = to + (dstY * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
+        if (inputHasAlpha && premult) {
+            for (int x = rect.x1; x < rect.x2; ++x) {
+                int inCol = x * inPackingSize;
+                int outCol = x * outPackingSize;
+                float a = src_pixels[inCol + inAOffset];
+                dst_pixels[outCol + outROffset] = toColorSpaceUint16FromLinearFloatFast(src_pixels[inCol + inROffset] * a);
+                dst_pixels[outCol + outGOffset] = toColorSpaceUint16FromLinearFloatFast(src_pixels[inCol + inGOffset] * a);
+                dst_pixels[outCol + outBOffset] = toColorSpaceUint16FromLinearFloatFast(src_pixels[inCol + inBOffset] * a);
+                if (outputHasAlpha) {
+                    // alpha is linear
+                    dst_pixels[outCol + outAOffset] = floatToInt<65536>(a);
+                }
+            }
+        } else {
+            // convert each channel of the scan-line at once
+            int inCol = rect.x1 * inPackingSize;
+            int outCol = rect.x1 * outPackingSize;
+            int width = rect.x2 - rect.x1;
+            toColorSpaceUint16FromLinearFloatFast(src_pixels + inCol + inROffset, inPackingSize, dst_pixels + outCol + outROffset, outPackingSize, width);
+            toColorSpaceUint16FromLinearFloatFast(src_pixels + inCol + inGOffset, inPackingSize, dst_pixels + outCol + outGOffset, outPackingSize, width);
+            toColorSpaceUint16FromLinearFloatFast(src_pixels + inCol + inBOffset, inPackingSize, dst_pixels + outCol + outBOffset, outPackingSize, width);
+            if (outputHasAlpha) {
+                // alpha is linear
+                ImageSIMD::fillStrided( (unsigned short)65535, dst_pixels + outCol + outAOffset, outPackingSize, width );
+            }
+        }
+    }
+} // to_short_packed
 
 void
 Lut::to_float_packed(float* to,
@@ -634,14 +761,23 @@ Lut::from_byte_planar(float* to,
 }
 
 void
-Lut::from_short_planar(float* /*to*/,
-                       const unsigned short* /*from*/,
-                       int /*W*/,
-                       const unsigned short*/* alpha*/,
-                       int /*inDelta*/,
-                       int /* outDelta*/) const
+Lut::from_short_planar(float* to,
+                       const unsigned short* from,
+                       int W,
+                       const unsigned short* alpha,
+                       int inDelta,
+                       int outDelta) const
 {
-    throw std::runtime_error("Lut::from_short_planar not implemented yet.");
+    validate();
+    if (!alpha) {
+        fromColorSpaceUint16ToLinearFloatFast(from, inDelta, to, outDelta, W);
+    } else {
+        for (int x = 0; x < W; ++x, from += inDelta, alpha += inDelta, to += outDelta) {
+            float a = Color::intToFloat<65536>(*alpha);
+            // unpremultiply, quantized to 16 bits to use the table
+            *to = a <= 0 ? 0 : fromColorSpaceUint16ToLinearFloatFast( Color::floatToInt<65536>(Color::intToFloat<65536>(*from) / a) ) * a;
+        }
+    }
 }
 
 void
@@ -746,18 +882,86 @@ Lut::from_byte_packed(float* to,
 } // from_byte_packed
 
 void
-Lut::from_short_packed(float* /*to*/,
-                       const unsigned short* /*from*/,
-                       const RectI & /*conversionRect*/,
-                       const RectI & /*srcBounds*/,
-                       const RectI & /*dstBounds*/,
-                       PixelPackingEnum /*inputPacking*/,
-                       PixelPackingEnum /*outputPacking*/,
-                       bool /*invertY*/,
-                       bool /*premult*/) const
+Lut::from_short_packed(float* to,
+                       const unsigned short* from,
+                       const RectI & conversionRect,
+                       const RectI & srcBounds,
+                       const RectI & dstBounds,
+                       PixelPackingEnum inputPacking,
+                       PixelPackingEnum outputPacking,
+                       bool invertY,
+                       bool premult) const
 {
-    throw std::runtime_error("Lut::from_short_packed not implemented yet.");
-}
+    if ( ( inputPacking == ePixelPackingPLANAR) || ( outputPacking == ePixelPackingPLANAR) ) {
+        throw std::runtime_error("Invalid pixel format.");
+    }
+
+    ///clip the conversion rect to srcBounds and dstBounds
+    RectI rect = conversionRect;
+    if ( !clip(&rect, srcBounds) || !clip(&rect, dstBounds) ) {
+        return;
+    }
+
+
+    bool inputHasAlpha = inputPacking == ePixelPackingBGRA || inputPacking == ePixelPackingRGBA;
+    bool outputHasAlpha = outputPacking == ePixelPackingBGRA || outputPacking == ePixelPackingRGBA;
+    int inROffset, inGOffset, inBOffset, inAOffset;
+    int outROffset, outGOffset, outBOffset, outAOffset;
+    getOffsetsForPacking(inputPacking, &inROffset, &inGOffset, &inBOffset, &inAOffset);
+    getOffsetsForPacking(outputPacking, &outROffset, &outGOffset, &outBOffset, &outAOffset);
+
+    int inPackingSize, outPackingSize;
+    inPackingSize = inputHasAlpha ? 4 : 3;
+    outPackingSize = outputHasAlpha ? 4 : 3;
+
+    validate();
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        int srcY = y;
+        if (invertY) {
+            srcY = srcBounds.y2 - y - 1;
+        }
+
+        const unsigned short *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) * inPackingSize);
+        float *dst_pixels = to + (y * (dstBounds.x2 - dstBounds.x1) * outPackingSize);
+        if (inputHasAlpha && premult) {
+            for (int x = rect.x1; x < rect.x2; ++x) {
+                int inCol = x * inPackingSize;
+                int outCol = x * outPackingSize;
+                float rf = 0., gf = 0., bf = 0.;
+                float a = Color::intToFloat<65536>(src_pixels[inCol + inAOffset]);
+                if (a > 0) {
+                    rf = Color::intToFloat<65536>(src_pixels[inCol + inROffset]) / a;
+                    gf = Color::intToFloat<65536>(src_pixels[inCol + inGOffset]) / a;
+                    bf = Color::intToFloat<65536>(src_pixels[inCol + inBOffset]) / a;
+                }
+                // the unpremultiplied values are quantized to 16 bits to use the table
+                dst_pixels[outCol + outROffset] = fromColorSpaceUint16ToLinearFloatFast( Color::floatToInt<65536>(rf) ) * a;
+                dst_pixels[outCol + outGOffset] = fromColorSpaceUint16ToLinearFloatFast( Color::floatToInt<65536>(gf) ) * a;
+                dst_pixels[outCol + outBOffset] = fromColorSpaceUint16ToLinearFloatFast( Color::floatToInt<65536>(bf) ) * a;
+                if (outputHasAlpha) {
+                    // alpha is linear
+                    dst_pixels[outCol + outAOffset] = a;
+                }
+            }
+        } else {
+            // convert each channel of the scan-line at once
+            int inCol = rect.x1 * inPackingSize;
+            int outCol = rect.x1 * outPackingSize;
+            int width = rect.x2 - rect.x1;
+            fromColorSpaceUint16ToLinearFloatFast(src_pixels + inCol + inROffset, inPackingSize, dst_pixels + outCol + outROffset, outPackingSize, width);
+            fromColorSpaceUint16ToLinearFloatFast(src_pixels + inCol + inGOffset, inPackingSize, dst_pixels + outCol + outGOffset, outPackingSize, width);
+            fromColorSpaceUint16ToLinearFloatFast(src_pixels + inCol + inBOffset, inPackingSize, dst_pixels + outCol + outBOffset, outPackingSize, width);
+            if (outputHasAlpha) {
+                // alpha is linear
+                if (inputHasAlpha) {
+                    ImageSIMD::convertPixelDepthStrided(src_pixels + inCol + inAOffset, inPackingSize, dst_pixels + outCol + outAOffset, outPackingSize, width);
+                } else {
+                    ImageSIMD::fillStrided( 1.f, dst_pixels + outCol + outAOffset, outPackingSize, width );
+                }
+            }
+        }
+    }
+} // from_short_packed
 
 void
 Lut::from_float_packed(float* to,
@@ -928,16 +1132,59 @@ from_byte_packed(float *to,
 }
 
 void
-from_short_packed(float */*to*/,
-                  const unsigned short */*from*/,
-                  const RectI & /*rect*/,
-                  const RectI & /*srcRod*/,
-                  const RectI & /*rod*/,
-                  PixelPackingEnum /*inputFormat*/,
-                  PixelPackingEnum /*format*/,
-                  bool /*invertY*/)
-{
-    throw std::runtime_error("Linear::from_short_packed not yet implemented.");
+from_short_packed(float *to,
+                  const unsigned short *from,
+                  const RectI &conversionRect,
+                  const RectI &srcBounds,
+                  const RectI &dstBounds,
+                  PixelPackingEnum inputPacking,
+                  PixelPackingEnum outputPacking,
+                  bool invertY)
+{
+    if ( ( inputPacking == ePixelPackingPLANAR) || ( outputPacking == ePixelPackingPLANAR) ) {
+        throw std::runtime_error("Invalid pixel format.");
+    }
+
+    ///clip the conversion rect to srcBounds and dstBounds
+    RectI rect = conversionRect;
+    if ( !clip(&rect, srcBounds) || !clip(&rect, dstBounds) ) {
+        return;
+    }
+
+
+    bool inputHasAlpha = inputPacking == ePixelPackingBGRA || inputPacking == ePixelPackingRGBA;
+    bool outputHasAlpha = outputPacking == ePixelPackingBGRA || outputPacking == ePixelPackingRGBA;
+    int inROffset, inGOffset, inBOffset, inAOffset;
+    int outROffset, outGOffset, outBOffset, outAOffset;
+    getOffsetsForPacking(inputPacking, &inROffset, &inGOffset, &inBOffset, &inAOffset);
+    getOffsetsForPacking(outputPacking, &outROffset, &outGOffset, &outBOffset, &outAOffset);
+
+
+    int inPackingSize, outPackingSize;
+    inPackingSize = inputHasAlpha ? 4 : 3;
+    outPackingSize = outputHasAlpha ? 4 : 3;
+
+    int width = rect.x2 - rect.x1;
+
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        int srcY = y;
+        if (invertY) {
+            srcY = srcBounds.y2 - y - 1;
+        }
+        const unsigned short *src_pixels = from + (srcY * (srcBounds.x2 - srcBounds.x1) + rect.x1) * inPackingSize;
+        float *dst_pixels = to + (y * (dstBounds.x2 - dstBounds.x1) + rect.x1) * outPackingSize;
+        ImageSIMD::convertPixelDepthStrided(src_pixels + inROffset, inPackingSize, dst_pixels + outROffset, outPackingSize, width);
+        ImageSIMD::convertPixelDepthStrided(src_pixels + inGOffset, inPackingSize, dst_pixels + outGOffset, outPackingSize, width);
+        ImageSIMD::convertPixelDepthStrided(src_pixels + inBOffset, inPackingSize, dst_pixels + outBOffset, outPackingSize, width);
+        if (outputHasAlpha) {
+            // alpha is linear
+            if (inputHasAlpha) {
+                ImageSIMD::convertPixelDepthStrided(src_pixels + inAOffset, inPackingSize, dst_pixels + outAOffset, outPackingSize, width);
+            } else {
+                ImageSIMD::fillStrided( 1.f, dst_pixels + outAOffset, outPackingSize, width );
+            }
+        }
+    }
 }
 
 void
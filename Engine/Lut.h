@@ -144,7 +144,9 @@ class Lut
     /// the fast lookup tables are mutable, because they are automatically initialized post-construction,
     /// and never change afterwards
     mutable unsigned short toFunc_hipart_to_uint8xx[0x10000];         /// contains  2^16 = 65536 values between 0-255
+    mutable float toFunc_hipart_to_float[0x10001];         /// toFunc of the float whose 16 high bits are the index, interpolated by the 16-bit paths
     mutable float fromFunc_uint8_to_float[256];         /// values between 0-1.f
+    mutable float fromFunc_uint16_to_float[0x10000];         /// values between 0-1.f
     mutable bool init_;         ///< false if the tables are not yet initialized
     mutable QMutex _lock;         ///< protects init_
 
@@ -166,6 +168,9 @@ class Lut
     ///Called by validate()
     void fillTables() const;
 
+    ///Linear interpolation in toFunc_hipart_to_float of the float v
+    float toColorSpaceFloatFromLinearFloatInterpolated(float v) const;
+
 public:
 
     /* @brief Converts a float ranging in [0 - 1.f] in the desired color-space to linear color-space also ranging in [0 - 1.f]
@@ -220,12 +225,22 @@ public:
      */
     unsigned short toColorSpaceUint8xxFromLinearFloatFast(float v) const;
 
+    /* @brief Same as toColorSpaceUint8xxFromLinearFloatFast(float) for n values separated by inDelta elements
+     * in from and outDelta elements in to.
+     */
+    void toColorSpaceUint8xxFromLinearFloatFast(const float* from, int inDelta, unsigned short* to, int outDelta, int n) const;
+
     /* @brief Converts a float ranging in [0 - 1.f] in linear color-space using the look-up tables.
      * @return An unsigned short in [0 - 65535] in the destination color-space.
-     * This function uses localluy linear approximations of the transfer function.
+     * This function uses locally linear approximations of the transfer function.
      */
     unsigned short toColorSpaceUint16FromLinearFloatFast(float v) const;
 
+    /* @brief Same as toColorSpaceUint16FromLinearFloatFast(float) for n values separated by inDelta elements
+     * in from and outDelta elements in to, e.g: to convert one channel of a packed scan-line.
+     */
+    void toColorSpaceUint16FromLinearFloatFast(const float* from, int inDelta, unsigned short* to, int outDelta, int n) const;
+
     /* @brief Converts a byte ranging in [0 - 255] in the destination color-space using the look-up tables.
      * @return A float in [0 - 1.f] in linear color-space.
      */
@@ -236,6 +251,11 @@ public:
      */
     float fromColorSpaceUint16ToLinearFloatFast(unsigned short v) const;
 
+    /* @brief Same as fromColorSpaceUint16ToLinearFloatFast(unsigned short) for n values separated by inDelta elements
+     * in from and outDelta elements in to.
+     */
+    void fromColorSpaceUint16ToLinearFloatFast(const unsigned short* from, int inDelta, float* to, int outDelta, int n) const;
+
 
     /////@TODO the following functions expects a float input buffer, one could extend it to cover all bitdepths.
 
@@ -256,8 +276,8 @@ public:
      **/
     //void to_byte_planar(unsigned char* to, const float* from,int W,const float* alpha = NULL,
     //                    int inDelta = 1, int outDelta = 1) const;
-    //void to_short_planar(unsigned short* to, const float* from,int W,const float* alpha = NULL,
-    //                     int inDelta = 1, int outDelta = 1) const;
+    void to_short_planar(unsigned short* to, const float* from, int W, const float* alpha = NULL,
+                         int inDelta = 1, int outDelta = 1) const;
     void to_float_planar(float* to, const float* from, int W, const float* alpha = NULL,
                          int inDelta = 1, int outDelta = 1) const;
 
@@ -290,9 +310,9 @@ public:
     void to_byte_packed(unsigned char* to, const float* from, const RectI & conversionRect,
                         const RectI & srcRoD, const RectI & dstRoD,
                         PixelPackingEnum inputPacking, PixelPackingEnum outputPacking, bool invertY, bool premult) const; // used by QtWriter
-    //void to_short_packed(unsigned short* to, const float* from,const RectI & conversionRect,
-    //                     const RectI & srcRoD,const RectI & dstRoD,
-    //                     PixelPackingEnum inputPacking,PixelPackingEnum outputPacking,bool invertY,bool premult) const;
+    void to_short_packed(unsigned short* to, const float* from, const RectI & conversionRect,
+                         const RectI & srcRoD, const RectI & dstRoD,
+                         PixelPackingEnum inputPacking, PixelPackingEnum outputPacking, bool invertY, bool premult) const;
     void to_float_packed(float* to, const float* from, const RectI & conversionRect,
                          const RectI & srcRoD, const RectI & dstRoD,
                          PixelPackingEnum inputPacking, PixelPackingEnum outputPacking, bool invertY, bool premult) const;
@@ -36,6 +36,10 @@
 #include <cstring>
 #include <cerrno>
 #include <cstdio>
+#if defined(__NATRON_LINUX__) && !defined(__FreeBSD__)
+#include <sys/vfs.h>       // fstatfs
+#include <sys/syscall.h>   // SYS_mbind
+#endif
 #endif
 #include <sstream> // stringstream
 #include <iostream>
@@ -49,6 +53,12 @@
 
 #define MIN_FILE_SIZE 4096
 
+// f_type of the file systems mounted with hugetlbfs, see statfs(2)
+#define NATRON_HUGETLBFS_MAGIC 0x958458f6
+
+// Memory policy mode for mbind(2), see <linux/mempolicy.h>
+#define NATRON_MPOL_PREFERRED 1
+
 NATRON_NAMESPACE_ENTER
 
 struct MemoryFilePrivate
@@ -57,6 +67,7 @@ struct MemoryFilePrivate
 
     char* data; //< pointer to the begining of the mapped file
     size_t size; //< the effective size of the file
+    size_t hugePageSize; //< if the file is on a hugetlbfs mount point, the size of its pages, otherwise 0
 #if defined(__NATRON_UNIX__)
     int file_handle; //< unix file handle
 #elif defined(__NATRON_WIN32__)
@@ -70,6 +81,7 @@ struct MemoryFilePrivate
         : path(filepath)
         , data(0)
         , size(0)
+        , hugePageSize(0)
 #if defined(__NATRON_UNIX__)
         , file_handle(-1)
 #elif defined(__NATRON_WIN32__)
@@ -84,6 +96,38 @@ struct MemoryFilePrivate
     void closeMapping();
 };
 
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+std::size_t
+getSystemPageSize()
+{
+#if defined(__NATRON_UNIX__)
+    long pageSize = ::sysconf(_SC_PAGESIZE);
+    return pageSize > 0 ? (std::size_t)pageSize : MIN_FILE_SIZE;
+#elif defined(__NATRON_WIN32__)
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    return info.dwPageSize;
+#endif
+}
+
+// Shrinks the range [data, data + size) to whole pages, returns false if it does not contain any page
+bool
+getPageAlignedRange(void* data, std::size_t size, void** alignedData, std::size_t* alignedSize)
+{
+    std::size_t pageSize = getSystemPageSize();
+    std::size_t start = ( (std::size_t)data + pageSize - 1 ) / pageSize * pageSize;
+    std::size_t end = ( (std::size_t)data + size ) / pageSize * pageSize;
+    if (!data || end <= start) {
+        return false;
+    }
+    *alignedData = (void*)start;
+    *alignedSize = end - start;
+    return true;
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
 MemoryFile::MemoryFile()
     : _imp( new MemoryFilePrivate( std::string() ) )
 {
@@ -160,6 +204,16 @@ MemoryFilePrivate::openInternal(MemoryFile::FileOpenModeEnum open_mode)
         throw std::runtime_error( ss.str() );
     }
 
+    // Files on a hugetlbfs mount point are always backed by huge pages but can only be
+    // truncated and mapped to a multiple of the huge page size.
+    hugePageSize = 0;
+#if defined(__NATRON_LINUX__) && !defined(__FreeBSD__)
+    struct statfs fsbuf;
+    if ( (::fstatfs(file_handle, &fsbuf) == 0) && ( (unsigned long)fsbuf.f_type == NATRON_HUGETLBFS_MAGIC ) && (fsbuf.f_bsize > 0) ) {
+        hugePageSize = fsbuf.f_bsize;
+    }
+#endif
+
     /*********************************************************
      ********************************************************
 
@@ -263,6 +317,12 @@ MemoryFile::getData() const
     return _imp->data;
 }
 
+std::size_t
+MemoryFile::getPageSize() const
+{
+    return _imp->hugePageSize ? _imp->hugePageSize : getSystemPageSize();
+}
+
 size_t
 MemoryFile::size() const
 {
@@ -298,6 +358,9 @@ MemoryFile::resize(size_t new_size, bool preserve)
     if (preserve) {
         flush(eFlushTypeSync, _imp->data, _imp->size);
     }
+    if (_imp->hugePageSize) {
+        new_size = (new_size + _imp->hugePageSize - 1) / _imp->hugePageSize * _imp->hugePageSize;
+    }
 #if defined(__NATRON_UNIX__)
     if (_imp->data) {
         if (::munmap(_imp->data, _imp->size) < 0) {
@@ -432,6 +495,84 @@ MemoryFile::flush(FlushTypeEnum type, void* data, std::size_t size)
     return false;
 } // flush
 
+bool
+MemoryFile::adviseAccessPattern(AccessPatternEnum pattern,
+                                void* data,
+                                std::size_t size)
+{
+#if defined(__NATRON_UNIX__) && defined(POSIX_MADV_NORMAL)
+    void* ptr;
+    std::size_t n;
+    if ( !getPageAlignedRange(data, size, &ptr, &n) ) {
+        return false;
+    }
+    int advice;
+    switch (pattern) {
+        case eAccessPatternSequential:
+            advice = POSIX_MADV_SEQUENTIAL;
+            break;
+        case eAccessPatternRandom:
+            advice = POSIX_MADV_RANDOM;
+            break;
+        case eAccessPatternNormal:
+        default:
+            advice = POSIX_MADV_NORMAL;
+            break;
+    }
+    return ::posix_madvise(ptr, n, advice) == 0;
+#else
+    Q_UNUSED(pattern);
+    Q_UNUSED(data);
+    Q_UNUSED(size);
+    return false;
+#endif
+}
+
+bool
+MemoryFile::adviseHugePages(void* data,
+                            std::size_t size)
+{
+#if defined(__NATRON_UNIX__) && defined(MADV_HUGEPAGE)
+    void* ptr;
+    std::size_t n;
+    if ( !getPageAlignedRange(data, size, &ptr, &n) ) {
+        return false;
+    }
+    return ::madvise(ptr, n, MADV_HUGEPAGE) == 0;
+#else
+    Q_UNUSED(data);
+    Q_UNUSED(size);
+    return false;
+#endif
+}
+
+bool
+MemoryFile::bindToNUMANode(int node,
+                           void* data,
+                           std::size_t size)
+{
+#if defined(__NATRON_LINUX__) && defined(SYS_mbind)
+    // The kernel only reads maxnode - 1 bits of the mask
+    const int nBitsPerMask = sizeof(unsigned long) * 8;
+    if ( (node < 0) || (node >= nBitsPerMask - 1) ) {
+        return false;
+    }
+    void* ptr;
+    std::size_t n;
+    if ( !getPageAlignedRange(data, size, &ptr, &n) ) {
+        return false;
+    }
+    // We call the system call directly rather than linking to libnuma
+    unsigned long nodeMask = 1UL << node;
+    return ::syscall(SYS_mbind, ptr, n, NATRON_MPOL_PREFERRED, &nodeMask, (unsigned long)nBitsPerMask, 0) == 0;
+#else
+    Q_UNUSED(node);
+    Q_UNUSED(data);
+    Q_UNUSED(size);
+    return false;
+#endif
+}
+
 void
 MemoryFile::close()
 {
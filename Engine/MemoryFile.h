@@ -131,6 +131,53 @@ public:
      **/
     bool flush(FlushTypeEnum type, void* data, std::size_t size);
 
+    /**
+     * @brief Returns the size of the pages backing the mapping: if the file lives on a hugetlbfs
+     * mount point, this is the huge page size of the mount point and resize() rounds the file size
+     * up to a multiple of it. Otherwise this is the system page size.
+     **/
+    std::size_t getPageSize() const;
+
+    enum AccessPatternEnum
+    {
+        // No special treatment, the system does a moderate amount of read-ahead
+        eAccessPatternNormal,
+
+        // Pages are accessed in increasing order, the system reads ahead aggressively
+        // and may free pages soon after they were accessed
+        eAccessPatternSequential,
+
+        // Pages are accessed in no particular order, read-ahead is disabled
+        eAccessPatternRandom
+    };
+
+    /**
+     * @brief Advise the system how the given portion of memory is going to be accessed.
+     * The range is shrunk to whole pages. This works for any memory range, not only memory files,
+     * but the advice is lost if the memory is unmapped, e.g: when a MemoryFile is resized.
+     * @returns False if the advice is not supported on this system.
+     **/
+    static bool adviseAccessPattern(AccessPatternEnum pattern, void* data, std::size_t size);
+
+    /**
+     * @brief Ask the system to back the given portion of memory with transparent huge pages, reducing
+     * the number of page faults and TLB misses when accessing it. This is only effective
+     * for anonymous memory and files living on a tmpfs mount point on most systems.
+     * For files on a hugetlbfs mount point, this is not needed as huge pages are always used.
+     * @returns False if transparent huge pages are not supported on this system.
+     **/
+    static bool adviseHugePages(void* data, std::size_t size);
+
+    /**
+     * @brief Prefer to allocate the pages of the given portion of memory on the given NUMA node,
+     * instead of the node of the thread that first accesses them.
+     * This only affects pages that are not allocated yet. For files that are not living on a
+     * tmpfs or hugetlbfs mount point, the page cache is always allocated on the node of the
+     * thread that first accesses the page and this has no effect.
+     * @returns False if NUMA is not supported on this system or if node is not a valid node.
+     **/
+    static bool bindToNUMANode(int node, void* data, std::size_t size);
+
     /**
      * @brief Returns the filepath of the backing file.
      **/
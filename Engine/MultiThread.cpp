@@ -33,20 +33,18 @@ CLANG_DIAG_OFF(uninitialized)
 CLANG_DIAG_OFF(deprecated-register) //'register' storage class specifier is deprecated
 CLANG_DIAG_OFF(uninitialized)
 #include <QtCore/QMutex>
-#include <QtCore/QThreadPool>
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDebug>
 #include <QtCore/QThread>
 #include <QtCore/QReadWriteLock>
 #include <QtCore/QAtomicInt>
 #include <QtCore/QThreadStorage>
-#include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt5
+#include <QtCore/QRunnable>
+#include <QtCore/QWaitCondition>
 CLANG_DIAG_ON(deprecated-register)
 CLANG_DIAG_ON(uninitialized)
 
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
-// /usr/local/include/boost/bind/arg.hpp:37:9: warning: unused typedef 'boost_static_assert_typedef_37' [-Wunused-local-typedef]
-#include <boost/bind.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 
@@ -146,8 +144,8 @@ static void copyOFXRenderTLS(const EffectInstancePtr& effect,
 
 }
 
-// Using QtConcurrent doesn't work with The Foundry Furnace plug-ins because they expect fresh threads
-// to be created. As QtConcurrent's thread-pool recycles thread, it seems to make Furnace crash.
+// Using a thread pool doesn't work with The Foundry Furnace plug-ins because they expect fresh threads
+// to be created. As the thread pool recycles threads, it seems to make Furnace crash.
 // We think this is because Furnace must keep an internal thread-local state that becomes then dirty
 // if we re-use the same thread.
 
@@ -189,6 +187,106 @@ threadFunctionWrapper(MultiThreadPrivate* imp,
     return ret;
 } // threadFunctionWrapper
 
+// The thread functions started in the thread pool by one call to launchThreads
+struct MultiThreadTasks
+{
+    // Protects nTasksLeft and status
+    QMutex lock;
+
+    // Notified when nTasksLeft reaches 0
+    QWaitCondition tasksDoneCond;
+
+    int nTasksLeft;
+
+    // The first failure returned by a thread function
+    ActionRetCodeEnum status;
+
+    MultiThreadTasks(int nTasks)
+    : lock()
+    , tasksDoneCond()
+    , nTasksLeft(nTasks)
+    , status(eActionStatusOK)
+    {
+    }
+};
+
+typedef boost::shared_ptr<MultiThreadTasks> MultiThreadTasksPtr;
+
+class MultiThreadTaskRunnable
+: public QRunnable
+{
+public:
+
+    MultiThreadTaskRunnable(const MultiThreadTasksPtr& tasks,
+                            MultiThreadPrivate* imp,
+                            MultiThread::ThreadFunctor func,
+                            unsigned int threadIndex,
+                            unsigned int threadMax,
+                            QThread* spawnerThread,
+                            const EffectInstancePtr& effect,
+                            void *customArg)
+    : QRunnable()
+    , _tasks(tasks)
+    , _imp(imp)
+    , _func(func)
+    , _threadIndex(threadIndex)
+    , _threadMax(threadMax)
+    , _spawnerThread(spawnerThread)
+    , _effect(effect)
+    , _customArg(customArg)
+    {
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL
+    {
+        ActionRetCodeEnum stat = threadFunctionWrapper(_imp, _func, _threadIndex, _threadMax, _spawnerThread, _effect, _customArg);
+
+        QMutexLocker k(&_tasks->lock);
+        if ( isFailureRetCode(stat) && !isFailureRetCode(_tasks->status) ) {
+            _tasks->status = stat;
+        }
+        if (--_tasks->nTasksLeft == 0) {
+            _tasks->tasksDoneCond.wakeAll();
+        }
+    }
+
+    MultiThreadTasksPtr _tasks;
+    MultiThreadPrivate* _imp;
+    MultiThread::ThreadFunctor _func;
+    unsigned int _threadIndex;
+    unsigned int _threadMax;
+    QThread* _spawnerThread;
+    EffectInstancePtr _effect;
+    void *_customArg;
+};
+
+/**
+ * @brief Starts the thread functions with indices in [firstThreadIndex, lastThreadIndex) in the render thread pool
+ **/
+static MultiThreadTasksPtr
+startThreadFunctions(MultiThreadPrivate* imp,
+                     MultiThread::ThreadFunctor func,
+                     unsigned int firstThreadIndex,
+                     unsigned int lastThreadIndex,
+                     unsigned int threadMax,
+                     QThread* spawnerThread,
+                     const EffectInstancePtr& effect,
+                     void *customArg)
+{
+    assert(firstThreadIndex < lastThreadIndex);
+    MultiThreadTasksPtr tasks( new MultiThreadTasks(lastThreadIndex - firstThreadIndex) );
+    WorkStealingThreadPool* threadPool = appPTR->getRenderThreadPool();
+
+    // Thread functions only process pixels: a thread of the pool waiting for a result may run them in the meantime
+    for (unsigned int i = firstThreadIndex; i < lastThreadIndex; ++i) {
+        threadPool->start(new MultiThreadTaskRunnable(tasks, imp, func, i, threadMax, spawnerThread, effect, customArg), true /*canRunWhileWaiting*/);
+    }
+
+    return tasks;
+}
+
 class NonThreadPoolThread
 : public QThread
 , public AbortableThread
@@ -274,19 +372,50 @@ MultiThread::~MultiThread()
 
 struct MultiThreadFuturePrivate
 {
-    boost::scoped_ptr<QFuture<ActionRetCodeEnum> > future;
-    std::vector<unsigned int> threadIndices;
+    MultiThreadTasksPtr tasks;
     ActionRetCodeEnum status;
 
     MultiThreadFuturePrivate(ActionRetCodeEnum initialStatus)
-    : future()
-    , threadIndices()
+    : tasks()
     , status(initialStatus)
     {
 
     }
+
+    ActionRetCodeEnum waitForTasks();
 };
 
+ActionRetCodeEnum
+MultiThreadFuturePrivate::waitForTasks()
+{
+    assert(tasks);
+
+    // Rather than sleeping, run the thread functions that no thread started yet: they are the most recent
+    // tasks started by this thread, hence the first ones it picks.
+    WorkStealingThreadPool* threadPool = appPTR->getRenderThreadPool();
+    bool mustWait;
+    for (;;) {
+        {
+            QMutexLocker k(&tasks->lock);
+            mustWait = tasks->nTasksLeft > 0;
+        }
+        if ( !mustWait || !threadPool->runPendingTaskWhileWaiting() ) {
+            break;
+        }
+    }
+
+    if (mustWait) {
+        ReleaseTPThread_RAII releaser;
+        QMutexLocker k(&tasks->lock);
+        while (tasks->nTasksLeft > 0) {
+            tasks->tasksDoneCond.wait(&tasks->lock);
+        }
+    }
+
+    QMutexLocker k(&tasks->lock);
+    return tasks->status;
+}
+
 MultiThreadFuture::MultiThreadFuture(ActionRetCodeEnum initialStatus)
 : _imp(new MultiThreadFuturePrivate(initialStatus))
 {
@@ -296,19 +425,14 @@ MultiThreadFuture::MultiThreadFuture(ActionRetCodeEnum initialStatus)
 ActionRetCodeEnum
 MultiThreadFuture::waitForFinished()
 {
-    if (_imp->future) {
-        ReleaseTPThread_RAII releaser;
-
-        _imp->future->waitForFinished();
+    if (_imp->tasks) {
+        ActionRetCodeEnum stat = _imp->waitForTasks();
 
         if (isFailureRetCode(_imp->status)) {
             return _imp->status;
         }
-        for (QFuture<ActionRetCodeEnum>::const_iterator it = _imp->future->begin(); it != _imp->future->end(); ++it) {
-            ActionRetCodeEnum stat = *it;
-            if (isFailureRetCode(stat)) {
-                return stat;
-            }
+        if (isFailureRetCode(stat)) {
+            return stat;
         }
     }
     return _imp->status;
@@ -353,19 +477,8 @@ MultiThread::launchThreadsInThreadPool(ThreadFunctor func, void *customArg, unsi
     unsigned int mappedNTasks = (isThreadPoolThread) ? nTasks - 1 : nTasks;
 
     if (mappedNTasks > 0 && startTaskIndex < mappedNTasks) {
-        unsigned int nTasksRemaining = mappedNTasks - startTaskIndex;
-        ret->_imp->threadIndices.resize(nTasksRemaining);
-        {
-            unsigned int index = 0;
-            for (unsigned int i = startTaskIndex; i < mappedNTasks; ++i, ++index) {
-                ret->_imp->threadIndices[index] = i;
-            }
-        }
-
         // DON'T set the maximum thread count: this is a global application setting
-        ret->_imp->future.reset(new QFuture<ActionRetCodeEnum>);
-        *ret->_imp->future = QtConcurrent::mapped( ret->_imp->threadIndices, boost::bind(threadFunctionWrapper, imp, func, _1, nTasks, spawnerThread, effect, customArg) );
-
+        ret->_imp->tasks = startThreadFunctions(imp, func, startTaskIndex, mappedNTasks, nTasks, spawnerThread, effect, customArg);
     }
     
     // Do one iteration in this thread
@@ -374,9 +487,9 @@ MultiThread::launchThreadsInThreadPool(ThreadFunctor func, void *customArg, unsi
         if (isFailureRetCode(stat)) {
             // This thread failed, wait for other threads and exit
             ret->_imp->status = stat;
-            if (ret->_imp->future) {
-                ret->_imp->future->waitForFinished();
-                ret->_imp->future.reset();
+            if (ret->_imp->tasks) {
+                ret->_imp->waitForTasks();
+                ret->_imp->tasks.reset();
             }
         }
     }
@@ -489,17 +602,12 @@ MultiThread::launchThreadsInternal(MultiThread::ThreadFunctor func, unsigned int
         bool isThreadPoolThread = isRunningInThreadPoolThread();
 
         unsigned int nMappedElements = isThreadPoolThread ? nDesiredThreadsArg - 1 : nDesiredThreadsArg;
-        ret->_imp->threadIndices.resize(nMappedElements);
-        for (unsigned int i = 0; i < nMappedElements; ++i) {
-            ret->_imp->threadIndices[i] = i;
-        }
 
         // DON'T set the maximum thread count: this is a global application setting, and see the documentation excerpt above
-        // QThreadPool::globalInstance()->setMaxThreadCount(nThreads);
+        // appPTR->getRenderThreadPool()->setMaxThreadCount(nThreads);
 
         if (nMappedElements > 0) {
-            ret->_imp->future.reset(new QFuture<ActionRetCodeEnum>);
-            *ret->_imp->future = QtConcurrent::mapped( ret->_imp->threadIndices, boost::bind(threadFunctionWrapper, imp, func, _1, nDesiredThreadsArg, spawnerThread, effect, customArg) );
+            ret->_imp->tasks = startThreadFunctions(imp, func, 0, nMappedElements, nDesiredThreadsArg, spawnerThread, effect, customArg);
         }
 
         // Do one iteration in this thread
@@ -508,9 +616,9 @@ MultiThread::launchThreadsInternal(MultiThread::ThreadFunctor func, unsigned int
             if (isFailureRetCode(stat)) {
                 // This thread failed, wait for other threads and exit
                 ret->_imp->status = stat;
-                if (ret->_imp->future) {
-                    ret->_imp->future->waitForFinished();
-                    ret->_imp->future.reset();
+                if (ret->_imp->tasks) {
+                    ret->_imp->waitForTasks();
+                    ret->_imp->tasks.reset();
                 }
                 return ret;
             }
@@ -592,8 +700,10 @@ unsigned int
 MultiThread::getNCPUsAvailable(const EffectInstancePtr& /*effect*/)
 {
 
+    WorkStealingThreadPool* threadPool = appPTR->getRenderThreadPool();
+
     // activeThreadCount may be negative (for example if releaseThread() is called)
-    int activeThreadsCount = QThreadPool::globalInstance()->activeThreadCount();
+    int activeThreadsCount = threadPool->activeThreadCount();
 
     // If we are running in the thread pool already, count this thread as available
     if (isRunningInThreadPoolThread()) {
@@ -604,7 +714,7 @@ MultiThread::getNCPUsAvailable(const EffectInstancePtr& /*effect*/)
     activeThreadsCount = std::max( 0, activeThreadsCount);
 
     // maxThreadCount() is set by the setting the preferences
-    const int maxThreadsCount = std::max(1,QThreadPool::globalInstance()->maxThreadCount());
+    const int maxThreadsCount = std::max(1, threadPool->maxThreadCount());
 
     int ret = std::max(1, maxThreadsCount - activeThreadsCount);
     return ret;
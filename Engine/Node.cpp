@@ -1168,6 +1168,29 @@ Node::getIsNodeRenderingCounter() const
     return _imp->renderStartedCounter;
 }
 
+// Number of samples over which the render time of a node is averaged: older samples fade out so that
+// the estimate follows changes of the node parameters
+#define NATRON_RENDER_TIME_ESTIMATE_WINDOW 8
+
+void
+Node::addRenderTimeSample(double timeSpentSeconds)
+{
+    QMutexLocker l(&_imp->renderTimeEstimateMutex);
+
+    if (_imp->nRenderTimeSamples < NATRON_RENDER_TIME_ESTIMATE_WINDOW) {
+        ++_imp->nRenderTimeSamples;
+    }
+    _imp->renderTimeEstimate += (timeSpentSeconds - _imp->renderTimeEstimate) / _imp->nRenderTimeSamples;
+}
+
+double
+Node::getEstimatedRenderTime() const
+{
+    QMutexLocker l(&_imp->renderTimeEstimateMutex);
+
+    return _imp->renderTimeEstimate;
+}
+
 
 NodePtr
 Node::getIOContainer() const
@@ -853,6 +853,18 @@ public:
 
     int getIsNodeRenderingCounter() const;
 
+    /**
+     * @brief Records the time in seconds it took to render a frame/view of this node, excluding its inputs.
+     **/
+    void addRenderTimeSample(double timeSpentSeconds);
+
+    /**
+     * @brief Returns an estimate of the time in seconds needed to render a frame/view of this node, based on
+     * the samples passed to addRenderTimeSample(), or 0 if the node was never rendered.
+     * This is used by the render scheduler to launch first the tasks on the longest path of the graph.
+     **/
+    double getEstimatedRenderTime() const;
+
     void refreshPreviewsRecursivelyDownstream();
 
     void refreshPreviewsRecursivelyUpstream();
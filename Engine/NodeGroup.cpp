@@ -1711,10 +1711,21 @@ NodeCollection::createNodesFromSerialization(const SERIALIZATION_NAMESPACE::Node
 
     std::map<SERIALIZATION_NAMESPACE::NodeSerializationPtr, NodePtr> localCreatedNodes;
 
-
     // Loop over all node serialization and create them first
     for (SERIALIZATION_NAMESPACE::NodeSerializationList::const_iterator it = serializedNodes.begin(); it != serializedNodes.end(); ++it) {
-        
+
+        // Nodes read from a binary project are decoded right before they are created
+        try {
+            (*it)->decodeIfNeeded();
+        } catch (const std::exception& e) {
+            QString text( tr("ERROR: The node %1 could not be read from the project: %2")
+                         .arg( QString::fromUtf8( (*it)->_nodeScriptName.c_str() ) )
+                         .arg( QString::fromUtf8( e.what() ) ) );
+            appPTR->writeToErrorLog_mt_safe(tr("Project"), QDateTime::currentDateTime(), text);
+            hasError = true;
+            continue;
+        }
+
         NodePtr node = appPTR->createNodeForProjectLoading(*it, thisShared);
         if (createdNodesOut) {
             createdNodesOut->push_back(node);
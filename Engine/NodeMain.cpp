@@ -1729,6 +1729,9 @@ Node::destroyNode()
     // Free all memory used by the plug-in.
     _imp->effect->clearLastRenderedImage();
 
+    // Render clones kept to be recycled hold a reference to the effect
+    _imp->effect->clearRecycledRenderClones();
+
 
     // Run on node deleted Python callback
     AppInstancePtr app = getApp();
@@ -72,6 +72,9 @@ NodePrivate::NodePrivate(Node* publicInterface,
 , renderStartedCounter(0)
 , inputIsRenderingCounter()
 , lastInputNRenderStartedSlotCallTime()
+, renderTimeEstimateMutex()
+, renderTimeEstimate(0.)
+, nRenderTimeSamples(0)
 , persistentMessages()
 , persistentMessageMutex()
 , guiPointer()
@@ -217,6 +217,13 @@ public:
     std::vector<int> inputIsRenderingCounter;
     timeval lastInputNRenderStartedSlotCallTime;
 
+    // Protects renderTimeEstimate & nRenderTimeSamples
+    mutable QMutex renderTimeEstimateMutex;
+
+    // Moving average of the time spent rendering a frame/view of this node, in seconds
+    double renderTimeEstimate;
+    int nRenderTimeSamples;
+
     // The last persistent message posted by the plug-in
     PersistentMessageMap persistentMessages;
 
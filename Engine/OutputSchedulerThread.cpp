@@ -39,6 +39,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
 #include <boost/algorithm/clamp.hpp>
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 
+#include <QtCore/QAtomicInt>
 #include <QtCore/QMetaType>
 #include <QtCore/QMutex>
 #include <QtCore/QWaitCondition>
@@ -59,6 +60,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 
 #include "Engine/AppManager.h"
 #include "Engine/AppInstance.h"
+#include "Engine/CacheEntryBase.h"
 #include "Engine/EffectInstance.h"
 #include "Engine/FrameViewRequest.h"
 #include "Engine/ImageCacheKey.h"
@@ -66,13 +68,16 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/ImageCacheEntry.h"
 #include "Engine/KnobFile.h"
 #include "Engine/Node.h"
+#include "Engine/NodeGroup.h"
 #include "Engine/KnobItemsTable.h"
 #include "Engine/OpenGLViewerI.h"
 #include "Engine/ProcessFrameThread.h"
 #include "Engine/GenericSchedulerThreadWatcher.h"
 #include "Engine/Project.h"
 #include "Engine/RenderStats.h"
+#include "Engine/RenderTracer.h"
 #include "Engine/Settings.h"
+#include "Engine/ThreadPool.h"
 #include "Engine/Timer.h"
 #include "Engine/TimeLine.h"
 #include "Engine/TreeRender.h"
@@ -127,6 +132,48 @@ NATRON_NAMESPACE_ANONYMOUS_EXIT
 
 static MetaTypesRegistration registration;
 
+// Occupancy of the stages of a pipelined render, sampled each time the scheduler thread collects a rendered frame
+struct RenderPipelineStats
+{
+    enum PipelineLimitEnum
+    {
+        ePipelineLimitNone = 0,
+        ePipelineLimitFramesAhead,
+        ePipelineLimitMemoryBudget
+    };
+
+    int nSamples;
+
+    // Frames launched and not collected yet, and frames waiting to be processed
+    double framesRenderingSum, framesProcessingSum;
+    int maxFramesRendering, maxFramesProcessing;
+    U64 maxBytesRendering;
+
+    // Number of times the render stage was full after the scheduler launched renders, by limit
+    int nFullForFramesAhead, nFullForMemoryBudget;
+
+    // The limit that prevented the last launch
+    PipelineLimitEnum lastLimit;
+
+    // Seconds the scheduler thread spent waiting for the next frame to render, and for room in the processing stage
+    double renderWaitTime, processWaitTime;
+
+    RenderPipelineStats()
+    : nSamples(0)
+    , framesRenderingSum(0)
+    , framesProcessingSum(0)
+    , maxFramesRendering(0)
+    , maxFramesProcessing(0)
+    , maxBytesRendering(0)
+    , nFullForFramesAhead(0)
+    , nFullForMemoryBudget(0)
+    , lastLimit(ePipelineLimitNone)
+    , renderWaitTime(0)
+    , processWaitTime(0)
+    {
+    }
+};
+
 
 struct OutputSchedulerThreadPrivate
 {
@@ -191,6 +238,23 @@ struct OutputSchedulerThreadPrivate
 
     ProcessFrameThread processFrameThread;
 
+    // Pipelined render state, see OutputSchedulerThread::isRenderPipeliningEnabled(). This is set in beginSequenceRender()
+    // and protected by launchedFramesMutex, except pipeliningEnabled which is also read by the scheduler thread
+    QAtomicInt pipeliningEnabled;
+    int pipelineMaxFramesAhead;
+    int pipelineMaxFramesProcessing;
+    U64 pipelineMemoryBudget;
+
+    // Estimate of the memory held by a frame being rendered
+    U64 pipelineFrameBytes;
+    RenderPipelineStats pipelineStats;
+
+    // When the Python expressions are evaluated before rendering, the frames [prefetchedFirstFrame, prefetchedLastFrame]
+    // were evaluated already. Reset in beginSequenceRender() and protected by prefetchMutex
+    QMutex prefetchMutex;
+    bool prefetchEnabled;
+    TimeValue prefetchedFirstFrame, prefetchedLastFrame;
+
     OutputSchedulerThreadPrivate(const RenderEnginePtr& engine,
                                  OutputSchedulerThread* publicInterface,
                                  const NodePtr& effect)
@@ -215,9 +279,27 @@ struct OutputSchedulerThreadPrivate
         , sequentialRenderQueueMutex()
         , sequentialRenderQueue()
         , processFrameThread()
+        , pipeliningEnabled(0)
+        , pipelineMaxFramesAhead(0)
+        , pipelineMaxFramesProcessing(0)
+        , pipelineMemoryBudget(0)
+        , pipelineFrameBytes(0)
+        , pipelineStats()
+        , prefetchMutex()
+        , prefetchEnabled(false)
+        , prefetchedFirstFrame(0)
+        , prefetchedLastFrame(-1)
     {
     }
 
+    void initPipeline(const OutputSchedulerThreadStartArgsPtr& args);
+
+    bool canLaunchFrameInPipeline();
+
+    void samplePipelineStats();
+
+    void printPipelineStats() const;
+
     void validateRenderSequenceArgs(RenderSequenceArgs& args) const;
 
     void launchNextSequentialRender();
@@ -251,6 +333,10 @@ struct OutputSchedulerThreadPrivate
 
     void runAfterRenderCallback(bool aborted);
 
+    void prefetchPythonExpressionsResults(TimeValue firstFrame, TimeValue lastFrame, TimeValue frameStep, const std::vector<ViewIdx>& views);
+
+    void prefetchPythonExpressionsResultsIfNeeded(TimeValue frame, const OutputSchedulerThreadStartArgsPtr& args);
+
     void runCallbackWithVariables(const QString& callback);
 
 
@@ -390,7 +476,7 @@ OutputSchedulerThreadPrivate::getNearestInSequence(RenderDirectionEnum direction
 }
 
 
-void
+bool
 OutputSchedulerThread::startFrameRenderFromLastStartedFrame()
 {
 
@@ -400,7 +486,10 @@ OutputSchedulerThread::startFrameRenderFromLastStartedFrame()
     {
         OutputSchedulerThreadStartArgsPtr args = getCurrentRunArgs();
         if (!args) {
-            return;
+            return false;
+        }
+        if ( !_imp->canLaunchFrameInPipeline() ) {
+            return false;
         }
         PlaybackModeEnum pMode = _imp->engine.lock()->getPlaybackMode();
 
@@ -409,7 +498,7 @@ OutputSchedulerThread::startFrameRenderFromLastStartedFrame()
             frame = _imp->lastFrameRequested;
 
             if ( (args->firstFrame == args->lastFrame) && (frame == args->firstFrame) ) {
-                return;
+                return false;
             }
 
             RenderDirectionEnum newDirection = args->direction;
@@ -425,9 +514,10 @@ OutputSchedulerThread::startFrameRenderFromLastStartedFrame()
         }
     }
 
-    if (canContinue) {
-        startFrameRender(frame);
+    if (!canContinue) {
+        return false;
     }
+    return startFrameRender(frame);
 } // startFrameRenderFromLastStartedFrame
 
 void
@@ -436,19 +526,32 @@ OutputSchedulerThread::requestMoreRenders()
     startFrameRenderFromLastStartedFrame();
 } // requestMoreRenders
 
-void
+int
+OutputSchedulerThread::getMaxQueuedRenders(int maxParallelTasks) const
+{
+    QMutexLocker k(&_imp->launchedFramesMutex);
+    if ( !(int)_imp->pipeliningEnabled ) {
+        return maxParallelTasks;
+    }
+    // Whether a render can be launched is decided in startFrameRenderFromLastStartedFrame() with the memory budget
+    return _imp->pipelineMaxFramesAhead;
+}
+
+bool
 OutputSchedulerThread::startFrameRender(TimeValue startingFrame)
 {
 
     OutputSchedulerThreadStartArgsPtr args = getCurrentRunArgs();
 
+    _imp->prefetchPythonExpressionsResultsIfNeeded(startingFrame, args);
+
     _imp->runBeforeFrameRenderCallback(startingFrame);
 
     RenderFrameResultsContainerPtr future;
     ActionRetCodeEnum stat = createFrameRenderResults(startingFrame, args->viewsToRender, args->enableRenderStats, &future);
     if (isFailureRetCode(stat)) {
         notifyRenderFailure(stat);
-        return;
+        return false;
     }
 
 
@@ -461,9 +564,128 @@ OutputSchedulerThread::startFrameRender(TimeValue startingFrame)
     // Launch the render
     future->launchRenders();
 
-
+    return true;
 } // startFrameRender
 
+void
+OutputSchedulerThreadPrivate::initPipeline(const OutputSchedulerThreadStartArgsPtr& args)
+{
+    bool enabled = _publicInterface->isRenderPipeliningEnabled() && processFrameEnabled;
+
+    SettingsPtr settings = appPTR->getCurrentSettings();
+
+    // Estimate the memory held by a frame while it renders with the output image of each view, in the format, components
+    // and bit depth of the writer. Intermediate images go to the cache which has its own limit.
+    NodePtr outputNode = outputEffect.lock();
+    WriteNodePtr isWrite = toWriteNode( outputNode->getEffectInstance() );
+    NodePtr embeddedWriter = isWrite ? isWrite->getEmbeddedWriter() : NodePtr();
+    if (embeddedWriter) {
+        outputNode = embeddedWriter;
+    }
+    EffectInstancePtr outputInstance = outputNode->getEffectInstance();
+    RectI outputFormat = outputInstance->getOutputFormat();
+    ImagePlaneDesc plane, pairedPlane;
+    outputInstance->getMetadataComponents(-1, &plane, &pairedPlane);
+    int nComps = std::max(1, plane.getNumComponents() + pairedPlane.getNumComponents());
+    U64 frameBytes = (U64)outputFormat.area() * nComps * getSizeOfForBitDepth( outputInstance->getBitDepth(-1) ) * std::max( (std::size_t)1, args->viewsToRender.size() );
+
+    int maxFramesAhead = settings->getRenderPipelineMaxFramesAhead();
+    if (maxFramesAhead <= 0) {
+        maxFramesAhead = appPTR->getRenderThreadPool()->maxThreadCount();
+    }
+
+    {
+        QMutexLocker k(&launchedFramesMutex);
+        pipeliningEnabled.fetchAndStoreOrdered(enabled ? 1 : 0);
+        pipelineMaxFramesAhead = std::max(1, maxFramesAhead);
+        pipelineMaxFramesProcessing = std::max(1, settings->getRenderPipelineMaxFramesProcessing());
+        pipelineMemoryBudget = settings->getRenderPipelineMemoryBudget();
+        pipelineFrameBytes = frameBytes;
+        pipelineStats = RenderPipelineStats();
+    }
+
+    processFrameThread.setProcessAllFramesInOrder(enabled);
+} // initPipeline
+
+bool
+OutputSchedulerThreadPrivate::canLaunchFrameInPipeline()
+{
+    QMutexLocker k(&launchedFramesMutex);
+    if ( !(int)pipeliningEnabled ) {
+        return true;
+    }
+
+    // Always keep at least one frame rendering, the scheduler thread waits for it.
+    // Concurrent callers may each pass the test and exceed the limits by a frame, which is fine for an estimate.
+    const int nFramesRendering = (int)launchedFrames.size();
+    if (nFramesRendering == 0) {
+        pipelineStats.lastLimit = RenderPipelineStats::ePipelineLimitNone;
+        return true;
+    }
+    if (nFramesRendering >= pipelineMaxFramesAhead) {
+        pipelineStats.lastLimit = RenderPipelineStats::ePipelineLimitFramesAhead;
+        return false;
+    }
+    if ( (nFramesRendering + 1) * pipelineFrameBytes > pipelineMemoryBudget ) {
+        pipelineStats.lastLimit = RenderPipelineStats::ePipelineLimitMemoryBudget;
+        return false;
+    }
+    pipelineStats.lastLimit = RenderPipelineStats::ePipelineLimitNone;
+    return true;
+} // canLaunchFrameInPipeline
+
+void
+OutputSchedulerThreadPrivate::samplePipelineStats()
+{
+    const int nFramesProcessing = processFrameThread.getNumPendingFrames();
+
+    QMutexLocker k(&launchedFramesMutex);
+    const int nFramesRendering = (int)launchedFrames.size();
+    ++pipelineStats.nSamples;
+    pipelineStats.framesRenderingSum += nFramesRendering;
+    pipelineStats.framesProcessingSum += nFramesProcessing;
+    pipelineStats.maxFramesRendering = std::max(pipelineStats.maxFramesRendering, nFramesRendering);
+    pipelineStats.maxFramesProcessing = std::max(pipelineStats.maxFramesProcessing, nFramesProcessing);
+    pipelineStats.maxBytesRendering = std::max(pipelineStats.maxBytesRendering, nFramesRendering * pipelineFrameBytes);
+    switch (pipelineStats.lastLimit) {
+    case RenderPipelineStats::ePipelineLimitFramesAhead:
+        ++pipelineStats.nFullForFramesAhead;
+        break;
+    case RenderPipelineStats::ePipelineLimitMemoryBudget:
+        ++pipelineStats.nFullForMemoryBudget;
+        break;
+    case RenderPipelineStats::ePipelineLimitNone:
+        break;
+    }
+} // samplePipelineStats
+
+void
+OutputSchedulerThreadPrivate::printPipelineStats() const
+{
+    RenderPipelineStats stats;
+    int maxFramesAhead, maxFramesProcessing;
+    U64 memoryBudget;
+    {
+        QMutexLocker k(&launchedFramesMutex);
+        stats = pipelineStats;
+        maxFramesAhead = pipelineMaxFramesAhead;
+        maxFramesProcessing = pipelineMaxFramesProcessing;
+        memoryBudget = pipelineMemoryBudget;
+    }
+    const int nSamples = std::max(1, stats.nSamples);
+    const double toMiB = 1. / (1024. * 1024.);
+
+    std::cout << "Render pipeline (" << stats.nSamples << " frames):" << std::endl;
+    std::cout << "    Render stage: " << stats.framesRenderingSum / nSamples << " frames on average, " << stats.maxFramesRendering
+              << " at most (limit " << maxFramesAhead << " frames, " << stats.maxBytesRendering * toMiB << " MiB at most of a "
+              << memoryBudget * toMiB << " MiB budget)" << std::endl;
+    std::cout << "    Render stage full: " << stats.nFullForFramesAhead << " times by the frames limit, " << stats.nFullForMemoryBudget
+              << " times by the memory budget" << std::endl;
+    std::cout << "    Processing stage: " << stats.framesProcessingSum / nSamples << " frames on average, " << stats.maxFramesProcessing
+              << " at most (limit " << maxFramesProcessing << " frames)" << std::endl;
+    std::cout << "    Waited " << stats.renderWaitTime << "s for renders, " << stats.processWaitTime << "s for processing" << std::endl;
+} // printPipelineStats
+
 void
 OutputSchedulerThread::setRenderFinished(bool finished)
 {
@@ -587,6 +809,87 @@ OutputSchedulerThreadPrivate::runAfterFrameRenderedCallback(TimeValue frame)
 } // runAfterFrameRenderedCallback
 
 
+static void
+getNodesUpstream(const NodePtr& node,
+                 std::set<NodePtr>* nodes)
+{
+    if ( !node || !nodes->insert(node).second ) {
+        return;
+    }
+    int nInputs = node->getNInputs();
+    for (int i = 0; i < nInputs; ++i) {
+        getNodesUpstream(node->getInput(i), nodes);
+    }
+
+    // The nodes inside a group are not inputs of the group node
+    NodeGroupPtr isGroup = toNodeGroup( node->getEffectInstance() );
+    if (isGroup) {
+        NodesList children;
+        isGroup->getNodes_recursive(children);
+        for (NodesList::const_iterator it = children.begin(); it != children.end(); ++it) {
+            getNodesUpstream(*it, nodes);
+        }
+    }
+}
+
+void
+OutputSchedulerThreadPrivate::prefetchPythonExpressionsResults(TimeValue firstFrame,
+                                                               TimeValue lastFrame,
+                                                               TimeValue frameStep,
+                                                               const std::vector<ViewIdx>& views)
+{
+    std::set<NodePtr> nodes;
+    getNodesUpstream(outputEffect.lock(), &nodes);
+
+    // Take the GIL once for all expressions, instead of once per expression and per frame in each render thread
+    PythonGILLocker pgl;
+    for (std::set<NodePtr>::const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
+        EffectInstancePtr effect = (*it)->getEffectInstance();
+        if (!effect) {
+            continue;
+        }
+        const KnobsVec& knobs = effect->getKnobs();
+        for (KnobsVec::const_iterator it2 = knobs.begin(); it2 != knobs.end(); ++it2) {
+            if ( (*it2)->hasAnyExpression() ) {
+                (*it2)->prefetchPythonExpressionsResults(firstFrame, lastFrame, frameStep, views);
+            }
+        }
+    }
+} // prefetchPythonExpressionsResults
+
+void
+OutputSchedulerThreadPrivate::prefetchPythonExpressionsResultsIfNeeded(TimeValue frame,
+                                                                       const OutputSchedulerThreadStartArgsPtr& args)
+{
+    if ( !args || ( (double)args->frameStep <= 0. ) ) {
+        return;
+    }
+
+    QMutexLocker k(&prefetchMutex);
+    if ( !prefetchEnabled || ( (frame >= prefetchedFirstFrame) && (frame <= prefetchedLastFrame) ) ) {
+        return;
+    }
+
+    // Only evaluate the frames about to be rendered concurrently: the GIL is held meanwhile and the frames further
+    // ahead would wait for the results of the whole range
+    int nFrames;
+    {
+        QMutexLocker l(&launchedFramesMutex);
+        nFrames = (int)pipeliningEnabled ? pipelineMaxFramesAhead : appPTR->getRenderThreadPool()->maxThreadCount();
+    }
+    nFrames = std::max(1, nFrames);
+
+    const double span = (nFrames - 1) * (double)args->frameStep;
+    if (args->direction == eRenderDirectionForward) {
+        prefetchedFirstFrame = frame;
+        prefetchedLastFrame = TimeValue( std::min( (double)args->lastFrame, (double)frame + span ) );
+    } else {
+        prefetchedFirstFrame = TimeValue( std::max( (double)args->firstFrame, (double)frame - span ) );
+        prefetchedLastFrame = frame;
+    }
+    prefetchPythonExpressionsResults(prefetchedFirstFrame, prefetchedLastFrame, args->frameStep, args->viewsToRender);
+} // prefetchPythonExpressionsResultsIfNeeded
+
 void
 OutputSchedulerThreadPrivate::runBeforeRenderCallback()
 {
@@ -720,6 +1023,7 @@ OutputSchedulerThread::beginSequenceRender()
     TimeValue firstFrame, lastFrame;
     TimeValue frameStep;
     RenderDirectionEnum direction;
+    std::vector<ViewIdx> viewsToRender;
 
     {
         OutputSchedulerThreadStartArgsPtr args = getCurrentRunArgs();
@@ -729,9 +1033,18 @@ OutputSchedulerThread::beginSequenceRender()
         frameStep = args->frameStep;
         startingFrame = args->startingFrame;
         direction = args->direction;
+        viewsToRender = args->viewsToRender;
     }
 
     _imp->runBeforeRenderCallback();
+
+    {
+        QMutexLocker k(&_imp->prefetchMutex);
+        _imp->prefetchEnabled = appPTR->getCurrentSettings()->isPythonExpressionsPrefetchEnabled();
+        _imp->prefetchedFirstFrame = TimeValue(0);
+        _imp->prefetchedLastFrame = TimeValue(-1);
+    }
+
     aboutToStartRender();
     
     // Notify everyone that the render is started
@@ -777,7 +1090,13 @@ OutputSchedulerThread::beginSequenceRender()
         _imp->lastFrameRequested = startingFrame;
     }
 
-    startFrameRender(startingFrame);
+    _imp->initPipeline( getCurrentRunArgs() );
+
+    if ( startFrameRender(startingFrame) && (int)_imp->pipeliningEnabled ) {
+        // Fill the render stage
+        while ( startFrameRenderFromLastStartedFrame() ) {
+        }
+    }
 
 
 } // beginSequenceRender
@@ -791,6 +1110,7 @@ OutputSchedulerThread::endSequenceRender()
     _imp->processFrameThread.waitForThreadToQuit_enforce_blocking();
 
     TimeValue firstFrame, lastFrame, frameStep;
+    bool enableRenderStats;
 
     {
         QMutexLocker k(&_imp->lastRunArgsMutex);
@@ -798,9 +1118,18 @@ OutputSchedulerThread::endSequenceRender()
         firstFrame = args->firstFrame;
         lastFrame = args->lastFrame;
         frameStep = args->frameStep;
+        enableRenderStats = args->enableRenderStats;
         _imp->runArgs.reset();
     }
 
+    if ( (int)_imp->pipeliningEnabled && enableRenderStats ) {
+        _imp->printPipelineStats();
+    }
+    // In GUI mode the timeline is exported from the render statistics dialog
+    if ( enableRenderStats && appPTR->isBackground() && RenderTracer::isEnabled() ) {
+        _imp->engine.lock()->reportRenderTrace(firstFrame);
+    }
+
 
     _imp->timer->playState = ePlayStatePause;
 
@@ -934,8 +1263,17 @@ OutputSchedulerThread::threadLoopOnce(const GenericThreadStartArgsPtr &inArgs)
                     break;
                 }
             }
+            if ( (int)_imp->pipeliningEnabled ) {
+                _imp->samplePipelineStats();
+            }
+
             // Wait for the render to finish
+            TimeLapse waitTimer;
             ActionRetCodeEnum status = results->waitForRendersFinished();
+            if ( (int)_imp->pipeliningEnabled ) {
+                QMutexLocker k(&_imp->launchedFramesMutex);
+                _imp->pipelineStats.renderWaitTime += waitTimer.getTimeSinceCreation();
+            }
             if (isFailureRetCode(status)) {
                 notifyRenderFailure(status);
                 renderFinished = true;
@@ -1020,7 +1358,13 @@ OutputSchedulerThread::threadLoopOnce(const GenericThreadStartArgsPtr &inArgs)
             }
 
 
-            startFrameRenderFromLastStartedFrame();
+            if ( (int)_imp->pipeliningEnabled ) {
+                // Fill the render stage up to its limits
+                while ( startFrameRenderFromLastStartedFrame() ) {
+                }
+            } else {
+                startFrameRenderFromLastStartedFrame();
+            }
         }
 
         // Process the frame (for viewer playback this will upload the image to the OpenGL texture).
@@ -1031,7 +1375,23 @@ OutputSchedulerThread::threadLoopOnce(const GenericThreadStartArgsPtr &inArgs)
             processArgs->processor = this;
             processArgs->args = createProcessFrameArgs(args, results);
             processArgs->executeOnMainThread = (_imp->processFrameMode == eProcessFrameByMainThread);
-            if (_imp->processFrameEnabled) {
+            if ( (int)_imp->pipeliningEnabled ) {
+                // Every frame must be processed, in order. Wait for room in the processing stage so that rendered
+                // frames do not pile up in memory if processing is slower than rendering.
+                processArgs->setCanSkip(false);
+                TimeLapse waitTimer;
+                while ( !_imp->processFrameThread.waitForPendingFrames(_imp->pipelineMaxFramesProcessing - 1, 100) ) {
+                    ThreadStateEnum waitState = resolveState();
+                    if ( (waitState == eThreadStateAborted) || (waitState == eThreadStateStopped) ) {
+                        break;
+                    }
+                }
+                {
+                    QMutexLocker k(&_imp->launchedFramesMutex);
+                    _imp->pipelineStats.processWaitTime += waitTimer.getTimeSinceCreation();
+                }
+                _imp->processFrameThread.startProcessFrameTask(processArgs);
+            } else if (_imp->processFrameEnabled) {
                 _imp->processFrameThread.startTask(processArgs);
             } else {
                 // Call onFrameProcessed directly
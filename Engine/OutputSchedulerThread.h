@@ -376,11 +376,19 @@ protected:
      **/
     virtual void onRenderStopped(bool /*aborted*/) {}
 
+    /**
+     * @brief When true, the render is pipelined: frames are rendered ahead of the frame being processed within the limits of a memory budget,
+     * and all frames are processed in order by the processing thread while the scheduler keeps launching renders.
+     * This is read once when the render starts.
+     **/
+    virtual bool isRenderPipeliningEnabled() const { return false; }
+
 
 
 private:
     // Overriden from TreeRenderQueueProvider
     virtual void requestMoreRenders() OVERRIDE FINAL;
+    virtual int getMaxQueuedRenders(int maxParallelTasks) const OVERRIDE FINAL;
 
     // Overriden from GenericSchedulerThread
     virtual void onWaitForAbortCompleted() OVERRIDE FINAL;
@@ -407,9 +415,9 @@ private:
     void endSequenceRender();
 
 
-    void startFrameRenderFromLastStartedFrame();
+    bool startFrameRenderFromLastStartedFrame();
     
-    void startFrameRender(TimeValue startingFrame);
+    bool startFrameRender(TimeValue startingFrame);
 
     friend struct OutputSchedulerThreadPrivate;
     boost::scoped_ptr<OutputSchedulerThreadPrivate> _imp;
@@ -49,6 +49,10 @@ NATRON_NAMESPACE_ANONYMOUS_EXIT
 
 ProcessFrameThread::ProcessFrameThread()
 : GenericSchedulerThread()
+, _pendingFramesMutex()
+, _pendingFramesCond()
+, _nPendingFrames(0)
+, _processAllFramesInOrder(false)
 {
 }
 
@@ -57,6 +61,61 @@ ProcessFrameThread::~ProcessFrameThread()
 
 }
 
+void
+ProcessFrameThread::setProcessAllFramesInOrder(bool processInOrder)
+{
+    QMutexLocker k(&_pendingFramesMutex);
+    _processAllFramesInOrder = processInOrder;
+}
+
+GenericSchedulerThread::TaskQueueBehaviorEnum
+ProcessFrameThread::tasksQueueBehaviour() const
+{
+    QMutexLocker k(&_pendingFramesMutex);
+    return _processAllFramesInOrder ? eTaskQueueBehaviorProcessInOrder : eTaskQueueBehaviorSkipToMostRecent;
+}
+
+void
+ProcessFrameThread::startProcessFrameTask(const ProcessFrameThreadStartArgsPtr& args)
+{
+    {
+        QMutexLocker k(&_pendingFramesMutex);
+        ++_nPendingFrames;
+    }
+    if ( !startTask(args) ) {
+        // The thread is quitting, the frame will never be processed
+        QMutexLocker k(&_pendingFramesMutex);
+        --_nPendingFrames;
+        _pendingFramesCond.wakeAll();
+    }
+}
+
+int
+ProcessFrameThread::getNumPendingFrames() const
+{
+    QMutexLocker k(&_pendingFramesMutex);
+    return _nPendingFrames;
+}
+
+bool
+ProcessFrameThread::waitForPendingFrames(int maxPendingFrames, unsigned long timeoutMS)
+{
+    QMutexLocker k(&_pendingFramesMutex);
+    if (_nPendingFrames > maxPendingFrames) {
+        _pendingFramesCond.wait(&_pendingFramesMutex, timeoutMS);
+    }
+    return _nPendingFrames <= maxPendingFrames;
+}
+
+void
+ProcessFrameThread::onWaitForAbortCompleted()
+{
+    // Pending frames were dropped by the abort
+    QMutexLocker k(&_pendingFramesMutex);
+    _nPendingFrames = 0;
+    _pendingFramesCond.wakeAll();
+}
+
 class ProcessFrameThreadExecOnMainThreadArgs : public GenericThreadExecOnMainThreadArgs
 {
 public:
@@ -111,6 +170,14 @@ ProcessFrameThread::threadLoopOnce(const GenericThreadStartArgsPtr& inArgs)
     
     args->processor->notifyFrameProcessed(*args->args);
 
+    {
+        QMutexLocker k(&_pendingFramesMutex);
+        if (_nPendingFrames > 0) {
+            --_nPendingFrames;
+        }
+        _pendingFramesCond.wakeAll();
+    }
+
     return eThreadStateActive;
 }
 
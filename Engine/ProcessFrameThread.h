@@ -32,6 +32,9 @@
 #include <boost/weak_ptr.hpp>
 #endif
 
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+
 #include "Engine/GenericSchedulerThread.h"
 
 
@@ -150,18 +153,52 @@ public:
 
     virtual ~ProcessFrameThread();
 
+    /**
+     * @brief By default, only the most recent frame is processed and older skippable frames are dropped, which is
+     * what the viewer wants. When processing all frames in order, no frame is ever skipped.
+     * This should be set before starting any task.
+     **/
+    void setProcessAllFramesInOrder(bool processInOrder);
+
+    /**
+     * @brief Same as startTask(), but the frame is counted in getNumPendingFrames() until it is processed.
+     * Frames are only accounted correctly when processing all frames in order, since skipped frames
+     * are never processed.
+     **/
+    void startProcessFrameTask(const ProcessFrameThreadStartArgsPtr& args);
+
+    /**
+     * @brief Returns the number of frames started with startProcessFrameTask() that were not processed yet.
+     **/
+    int getNumPendingFrames() const;
+
+    /**
+     * @brief Blocks until at most maxPendingFrames frames are pending, or until timeoutMS milliseconds elapsed.
+     * Returns true if at most maxPendingFrames frames are pending.
+     **/
+    bool waitForPendingFrames(int maxPendingFrames, unsigned long timeoutMS);
+
 private:
 
     virtual void executeOnMainThread(const ExecOnMTArgsPtr& inArgs) OVERRIDE FINAL;
 
     void processTask(const ProcessFrameThreadStartArgsPtr& task);
 
-    virtual TaskQueueBehaviorEnum tasksQueueBehaviour() const OVERRIDE FINAL {
-        return eTaskQueueBehaviorSkipToMostRecent;
-    }
+    virtual TaskQueueBehaviorEnum tasksQueueBehaviour() const OVERRIDE FINAL;
 
     virtual ThreadStateEnum threadLoopOnce(const GenericThreadStartArgsPtr& inArgs) OVERRIDE FINAL;
 
+    virtual void onWaitForAbortCompleted() OVERRIDE FINAL;
+
+    // Protects all fields below
+    mutable QMutex _pendingFramesMutex;
+
+    // Signaled whenever a pending frame is processed
+    QWaitCondition _pendingFramesCond;
+
+    int _nPendingFrames;
+    bool _processAllFramesInOrder;
+
 };
 
 NATRON_NAMESPACE_EXIT
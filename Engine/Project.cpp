@@ -83,6 +83,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/Settings.h"
 #include "Engine/StubNode.h"
 #include "Engine/StandardPaths.h"
+#include "Engine/ThreadPool.h"
 #include "Engine/ViewerInstance.h"
 #include "Engine/ViewIdx.h"
 
@@ -648,7 +649,7 @@ Project::onAutoSaveTimerTriggered()
 
     ///check that all schedulers are not working.
     ///If so launch an auto-save, otherwise, restart the timer.
-    QThreadPool* tp = QThreadPool::globalInstance();
+    WorkStealingThreadPool* tp = appPTR->getRenderThreadPool();
     bool canAutoSave = tp->activeThreadCount() < tp->maxThreadCount() && !getApp()->isShowingDialog();
 
     if (canAutoSave) {
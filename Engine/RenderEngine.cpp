@@ -43,11 +43,14 @@
 #include "Engine/KnobTypes.h"
 #include "Engine/KnobFile.h"
 #include "Engine/Project.h"
+#include "Engine/TimeLine.h"
 #include "Engine/Timer.h"
 #include "Engine/RenderStats.h"
+#include "Engine/RenderTracer.h"
 #include "Engine/GenericSchedulerThreadWatcher.h"
 #include "Engine/ViewerDisplayScheduler.h"
 #include "Engine/ViewerNode.h"
+#include "Engine/ViewerPrefetchScheduler.h"
 
 
 NATRON_NAMESPACE_ENTER
@@ -66,6 +69,9 @@ struct RenderEnginePrivate
     PlaybackModeEnum pbMode;
     ViewerCurrentFrameRequestSchedulerPtr currentFrameScheduler;
 
+    // Only created for viewers, renders frames ahead in the cache when the viewer is idle
+    ViewerPrefetchSchedulerPtr prefetchScheduler;
+
     // Only used on the main-thread
     boost::scoped_ptr<RenderEngineWatcher> engineWatcher;
     struct RefreshRequest
@@ -90,6 +96,7 @@ struct RenderEnginePrivate
     , pbModeMutex()
     , pbMode(ePlaybackModeLoop)
     , currentFrameScheduler()
+    , prefetchScheduler()
     , refreshQueue()
     {
     }
@@ -106,6 +113,7 @@ RenderEngine::~RenderEngine()
     // All renders should be finished
     assert(!_imp->scheduler || !_imp->scheduler->hasTreeRendersLaunched());
     assert(!_imp->currentFrameScheduler || !_imp->currentFrameScheduler->hasTreeRendersLaunched());
+    assert(!_imp->prefetchScheduler || !_imp->prefetchScheduler->hasTreeRendersLaunched());
 }
 
 OutputSchedulerThreadPtr
@@ -133,6 +141,10 @@ RenderEngine::renderFrameRange(bool isBlocking,
     if (_imp->currentFrameScheduler) {
         _imp->currentFrameScheduler->onAbortRequested(true);
     }
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->abortThreadedTask();
+        _imp->prefetchScheduler->notifyPlaybackStarted(forward);
+    }
 
     setPlaybackAutoRestartEnabled(true);
 
@@ -153,6 +165,10 @@ RenderEngine::renderFromCurrentFrame(bool enableRenderStats,
 {
     // We are going to start playback, abort any current viewer refresh
     _imp->currentFrameScheduler->onAbortRequested(true);
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->abortThreadedTask();
+        _imp->prefetchScheduler->notifyPlaybackStarted(forward);
+    }
 
     setPlaybackAutoRestartEnabled(true);
 
@@ -225,6 +241,10 @@ RenderEngine::renderCurrentFrameNowInternal(bool enableRenderStats)
 {
     assert( QThread::currentThread() == qApp->thread() );
 
+    // Something changed or the user moved in the timeline: frames being prefetched may no longer be needed
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->abortThreadedTask();
+    }
 
     // If the scheduler is already doing playback, continue it
     if (_imp->scheduler) {
@@ -255,6 +275,14 @@ RenderEngine::renderCurrentFrameNowInternal(bool enableRenderStats)
         _imp->currentFrameScheduler = ViewerCurrentFrameRequestScheduler::create(shared_from_this(), output);
     }
 
+    ViewerNodePtr viewer = getOutput()->isEffectViewerNode();
+    if (viewer) {
+        if (!_imp->prefetchScheduler) {
+            _imp->prefetchScheduler = ViewerPrefetchScheduler::create(shared_from_this(), getOutput());
+        }
+        _imp->prefetchScheduler->notifyFrameRequested( TimeValue( viewer->getTimeline()->currentFrame() ) );
+    }
+
     _imp->currentFrameScheduler->renderCurrentFrame(enableRenderStats);
 }
 
@@ -286,6 +314,10 @@ RenderEngine::quitEngine(bool allowRestarts)
     if (_imp->currentFrameScheduler) {
         _imp->currentFrameScheduler->quitThread(allowRestarts);
     }
+
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->quitThread(allowRestarts);
+    }
 }
 
 void
@@ -298,6 +330,10 @@ RenderEngine::waitForEngineToQuit_not_main_thread()
     if (_imp->currentFrameScheduler) {
         _imp->currentFrameScheduler->waitForThreadToQuit_not_main_thread();
     }
+
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->waitForThreadToQuit_not_main_thread();
+    }
 }
 
 void
@@ -320,6 +356,10 @@ RenderEngine::waitForEngineToQuit_enforce_blocking()
     if (_imp->currentFrameScheduler) {
         _imp->currentFrameScheduler->waitForThreadToQuit_enforce_blocking();
     }
+
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->waitForThreadToQuit_enforce_blocking();
+    }
 }
 
 bool
@@ -327,6 +367,11 @@ RenderEngine::abortRenderingInternal(bool keepOldestRender)
 {
     bool ret = false;
 
+    // Aborting the prefetch is not reported: it may be started again as soon as the viewer is idle
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->abortThreadedTask();
+    }
+
     if (_imp->currentFrameScheduler) {
         ret |= _imp->currentFrameScheduler->abortThreadedTask(keepOldestRender);
     }
@@ -373,6 +418,9 @@ RenderEngine::waitForAbortToComplete_not_main_thread()
     if (_imp->scheduler) {
         _imp->scheduler->waitForAbortToComplete_not_main_thread();
     }
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->waitForAbortToComplete_not_main_thread();
+    }
 }
 
 void
@@ -385,6 +433,10 @@ RenderEngine::waitForAbortToComplete_enforce_blocking()
     if (_imp->currentFrameScheduler) {
         _imp->currentFrameScheduler->waitForAbortToComplete_enforce_blocking();
     }
+
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->waitForAbortToComplete_enforce_blocking();
+    }
 }
 
 void
@@ -432,7 +484,12 @@ RenderEngine::hasThreadsAlive() const
         currentFrameSchedulerRunning = _imp->currentFrameScheduler->hasThreadsAlive();
     }
 
-    return schedulerRunning || currentFrameSchedulerRunning;
+    bool prefetchRunning = false;
+    if (_imp->prefetchScheduler) {
+        prefetchRunning = _imp->prefetchScheduler->hasTreeRendersLaunched();
+    }
+
+    return schedulerRunning || currentFrameSchedulerRunning || prefetchRunning;
 }
 
 bool
@@ -451,6 +508,28 @@ RenderEngine::hasActiveRender() const
     return false;
 }
 
+void
+RenderEngine::prefetchViewerFrames()
+{
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->prefetchFrames();
+    }
+}
+
+void
+RenderEngine::notifyViewerFrameDisplayed(U64 viewerProcessHash)
+{
+    if (_imp->prefetchScheduler) {
+        _imp->prefetchScheduler->notifyFrameDisplayed(viewerProcessHash);
+    }
+}
+
+ViewerPrefetchSchedulerPtr
+RenderEngine::getViewerPrefetchScheduler() const
+{
+    return _imp->prefetchScheduler;
+}
+
 bool
 RenderEngine::isDoingSequentialRender() const
 {
@@ -493,16 +572,13 @@ RenderEngine::getDesiredFPS() const
 
 
 
-void
-RenderEngine::reportStats(TimeValue time,
-                          const RenderStatsPtr& stats)
+// Returns the name of the file produced by the output node at the given time, with its extension replaced by suffix,
+// or an empty string if the output node does not write files.
+static std::string
+getOutputFileNameWithSuffix(const NodePtr& output,
+                            TimeValue time,
+                            const char* suffix)
 {
-
-    if (!stats) {
-        return;
-    }
-    std::string filename;
-    NodePtr output = getOutput();
     KnobIPtr fileKnob = output->getKnobByName(kOfxImageEffectFileParamName);
 
     if (fileKnob) {
@@ -510,11 +586,26 @@ RenderEngine::reportStats(TimeValue time,
         if  (strKnob) {
             QString qfileName = QString::fromUtf8( SequenceParsing::generateFileNameFromPattern(strKnob->getValue( DimIdx(0), ViewIdx(0) ), output->getApp()->getProject()->getProjectViewNames(), time, ViewIdx(0)).c_str() );
             QtCompat::removeFileExtension(qfileName);
-            qfileName.append( QString::fromUtf8("-stats.txt") );
-            filename = qfileName.toStdString();
+            qfileName.append( QString::fromUtf8(suffix) );
+
+            return qfileName.toStdString();
         }
     }
 
+    return std::string();
+}
+
+void
+RenderEngine::reportStats(TimeValue time,
+                          const RenderStatsPtr& stats)
+{
+
+    if (!stats) {
+        return;
+    }
+    NodePtr output = getOutput();
+    std::string filename = getOutputFileNameWithSuffix(output, time, "-stats.txt");
+
     //If there's no filename knob, do not write anything
     if ( filename.empty() ) {
         std::cout << tr("Cannot write render statistics file: "
@@ -538,12 +629,41 @@ RenderEngine::reportStats(TimeValue time,
     std::map<NodePtr, NodeRenderStats > statsMap = stats->getStats(&wallTime);
 
     ofile << "Time spent to render frame (wall clock time): " << Timer::printAsTime(wallTime, false).toStdString() << std::endl;
+    int nClonesCreated, nClonesRecycled;
+    stats->getRenderCloneAllocations(&nClonesCreated, &nClonesRecycled);
+    ofile << "Render clones: " << nClonesCreated << " created, " << nClonesRecycled << " recycled" << std::endl;
+    int nPythonBatches, nPythonKnobs;
+    double pythonGILWaitTime;
+    stats->getPythonExpressionsBatches(&nPythonBatches, &nPythonKnobs, &pythonGILWaitTime);
+    if (nPythonBatches > 0) {
+        ofile << "Python expressions: " << nPythonKnobs << " parameters evaluated in " << nPythonBatches << " batches, "
+              << Timer::printAsTime(pythonGILWaitTime, false).toStdString() << " spent waiting for the Python GIL" << std::endl;
+    }
     for (std::map<NodePtr, NodeRenderStats >::const_iterator it = statsMap.begin(); it != statsMap.end(); ++it) {
         ofile << "------------------------------- " << it->first->getScriptName_mt_safe() << "------------------------------- " << std::endl;
         ofile << "Time spent rendering: " << Timer::printAsTime(it->second.getTotalTimeSpentRendering(), false).toStdString() << std::endl;
     }
 } // reportStats
 
+void
+RenderEngine::reportRenderTrace(TimeValue firstFrame)
+{
+    NodePtr output = getOutput();
+    std::string filename = getOutputFileNameWithSuffix(output, firstFrame, "-trace.json");
+
+    if ( filename.empty() ) {
+        std::cout << tr("Cannot write render timeline file: "
+                        "%1 does not seem to have a parameter named \"filename\" "
+                        "to determine the location where to write the timeline file.")
+        .arg( QString::fromUtf8( output->getScriptName_mt_safe().c_str() ) ).toStdString() << std::endl;
+    } else if ( !RenderTracer::exportChromeTrace(filename) ) {
+        std::cout << tr("Failure to write render timeline file.").toStdString() << std::endl;
+    }
+
+    // The next render starts a new timeline
+    RenderTracer::clear();
+} // reportRenderTrace
+
 OutputSchedulerThreadPtr
 ViewerRenderEngine::createScheduler(const NodePtr& effect)
 {
@@ -36,6 +36,7 @@
 
 #include "Engine/EngineFwd.h"
 #include "Global/Enums.h"
+#include "Global/GlobalDefines.h"
 #include "Engine/TimeValue.h"
 #include "Engine/ViewIdx.h"
 
@@ -206,6 +207,22 @@ public:
      **/
     bool isDoingSequentialRender() const;
 
+    /**
+     * @brief For a viewer, start rendering in the cache the frames it is likely to display next.
+     * This is called when the viewer becomes idle and is aborted by any new render request.
+     **/
+    void prefetchViewerFrames();
+
+    /**
+     * @brief Called by the viewer when it displays an image to keep track of the prefetch hit rate.
+     **/
+    void notifyViewerFrameDisplayed(U64 viewerProcessHash);
+
+    /**
+     * @brief Returns the prefetcher of a viewer, or NULL if this is not a viewer or it never rendered.
+     **/
+    ViewerPrefetchSchedulerPtr getViewerPrefetchScheduler() const;
+
 
     /**
      * The following functions are called by the OutputThreadScheduler to Q_EMIT the corresponding signals
@@ -225,6 +242,12 @@ public:
     virtual void reportStats(TimeValue time,
                              const RenderStatsPtr& stats);
 
+    /**
+     * @brief Writes the render timeline recorded by the RenderTracer next to the file produced by the output node
+     * at firstFrame, with a -trace.json extension, then clears the timeline.
+     **/
+    void reportRenderTrace(TimeValue firstFrame);
+
 
     public Q_SLOTS:
 
@@ -97,12 +97,23 @@ struct RenderStatsPrivate
     typedef std::map<NodeWPtr, NodeRenderStats > NodeInfosMap;
     NodeInfosMap nodeInfos;
 
+    // Number of render clones allocated and recycled for the frame
+    int nRenderClonesCreated, nRenderClonesRecycled;
+
+    // Python expressions evaluated at once for each render clone
+    int nPythonExpressionsBatches, nPythonExpressionsKnobs;
+    double pythonGILWaitTime;
 
     RenderStatsPrivate()
         : lock()
         , totalTimeSpentForFrameTimer()
         , doNodesProfiling(false)
         , nodeInfos()
+        , nRenderClonesCreated(0)
+        , nRenderClonesRecycled(0)
+        , nPythonExpressionsBatches(0)
+        , nPythonExpressionsKnobs(0)
+        , pythonGILWaitTime(0.)
     {
     }
 
@@ -181,4 +192,49 @@ RenderStats::getStats(double *totalTimeSpent) const
     return ret;
 }
 
+void
+RenderStats::addRenderCloneAllocation(bool recycled)
+{
+    QMutexLocker k(&_imp->lock);
+
+    if (recycled) {
+        ++_imp->nRenderClonesRecycled;
+    } else {
+        ++_imp->nRenderClonesCreated;
+    }
+}
+
+void
+RenderStats::getRenderCloneAllocations(int* nCreated,
+                                       int* nRecycled) const
+{
+    QMutexLocker k(&_imp->lock);
+
+    *nCreated = _imp->nRenderClonesCreated;
+    *nRecycled = _imp->nRenderClonesRecycled;
+}
+
+void
+RenderStats::addPythonExpressionsBatch(double gilWaitTime,
+                                       int nKnobs)
+{
+    QMutexLocker k(&_imp->lock);
+
+    ++_imp->nPythonExpressionsBatches;
+    _imp->nPythonExpressionsKnobs += nKnobs;
+    _imp->pythonGILWaitTime += gilWaitTime;
+}
+
+void
+RenderStats::getPythonExpressionsBatches(int* nBatches,
+                                         int* nKnobs,
+                                         double* gilWaitTime) const
+{
+    QMutexLocker k(&_imp->lock);
+
+    *nBatches = _imp->nPythonExpressionsBatches;
+    *nKnobs = _imp->nPythonExpressionsKnobs;
+    *gilWaitTime = _imp->pythonGILWaitTime;
+}
+
 NATRON_NAMESPACE_EXIT
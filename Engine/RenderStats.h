@@ -96,6 +96,24 @@ public:
 
     std::map<NodePtr, NodeRenderStats > getStats(double *totalTimeSpent) const;
 
+    /**
+     * @brief Called whenever a render clone of an effect is needed by the render: recycled is true
+     * if a clone released by a previous render was reused instead of allocating a new one.
+     * This is counted even if in-depth profiling is disabled.
+     **/
+    void addRenderCloneAllocation(bool recycled);
+
+    void getRenderCloneAllocations(int* nCreated, int* nRecycled) const;
+
+    /**
+     * @brief Called when the Python expressions of nKnobs knobs of a render clone were evaluated at once,
+     * after waiting gilWaitTime seconds for the Python GIL.
+     * This is counted even if in-depth profiling is disabled.
+     **/
+    void addPythonExpressionsBatch(double gilWaitTime, int nKnobs);
+
+    void getPythonExpressionsBatches(int* nBatches, int* nKnobs, double* gilWaitTime) const;
+
 private:
 
     boost::scoped_ptr<RenderStatsPrivate> _imp;
@@ -0,0 +1,106 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_RENDERTASKSCHEDULING_H
+#define NATRON_ENGINE_RENDERTASKSCHEDULING_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <list>
+
+#include "Engine/EngineFwd.h"
+
+// The choice of the next render task to start when tasks are started on the longest path of the graph first,
+// see TreeRenderExecutionData::executeAvailableTasks(). These functions only depend on the graph through the
+// GRAPH type, which must provide:
+//
+// double getEstimatedRenderTime(const TASK& task) const;
+// void getListeners(const TASK& task, std::list<TASK>* listeners) const;
+//
+// where the listeners of a task are the tasks that need its result.
+
+NATRON_NAMESPACE_ENTER
+
+namespace RenderTaskScheduling {
+
+/**
+ * @brief Returns the estimated time needed to render task and the tasks that depend on it, along the longest
+ * path to the output. The cost of each visited task is memoized in costs, which maps a TASK to a double: since
+ * tasks form a DAG, this keeps the computation linear in the number of tasks.
+ **/
+template <typename GRAPH, typename TASK, typename COST_MAP>
+double
+getRemainingPathCost(const GRAPH& graph,
+                     const TASK& task,
+                     COST_MAP* costs)
+{
+    typename COST_MAP::const_iterator found = costs->find(task);
+    if ( found != costs->end() ) {
+        return found->second;
+    }
+
+    double longestListenerPath = 0.;
+    std::list<TASK> listeners;
+    graph.getListeners(task, &listeners);
+    for (typename std::list<TASK>::const_iterator it = listeners.begin(); it != listeners.end(); ++it) {
+        longestListenerPath = std::max( longestListenerPath, getRemainingPathCost(graph, *it, costs) );
+    }
+
+    double cost = graph.getEstimatedRenderTime(task) + longestListenerPath;
+    (*costs)[task] = cost;
+
+    return cost;
+}
+
+/**
+ * @brief Returns the task in [begin, end[ with the highest getRemainingPathCost(), the first one of them if several
+ * tasks have the same cost, or end if the range is empty.
+ **/
+template <typename GRAPH, typename ITERATOR, typename COST_MAP>
+ITERATOR
+getMostCriticalTask(const GRAPH& graph,
+                    ITERATOR begin,
+                    ITERATOR end,
+                    COST_MAP* costs)
+{
+    ITERATOR ret = end;
+    double maxCost = -1.;
+
+    for (ITERATOR it = begin; it != end; ++it) {
+        double cost = getRemainingPathCost(graph, *it, costs);
+        if (cost > maxCost) {
+            maxCost = cost;
+            ret = it;
+        }
+    }
+
+    return ret;
+}
+
+} // namespace RenderTaskScheduling
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_RENDERTASKSCHEDULING_H
@@ -0,0 +1,347 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "RenderTracer.h"
+
+#include <cstdio>
+#include <list>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
+
+#include "Global/FStreamsSupport.h"
+
+#include "Engine/Timer.h"
+
+NATRON_NAMESPACE_ENTER
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+struct RenderTraceEvent
+{
+    const char* category;
+    const char* name;
+
+    // In microseconds
+    double startTime;
+    double duration;
+
+    std::string detail;
+
+    RenderTraceEvent()
+    : category(0)
+    , name(0)
+    , startTime(0)
+    , duration(0)
+    , detail()
+    {
+    }
+};
+
+// The events recorded by a thread. Only the thread itself writes in it, the mutex
+// is only contended while exporting.
+struct RenderTraceThreadBuffer
+{
+    QMutex lock;
+
+    // Identifies the thread in the trace
+    int threadIndex;
+    std::string threadName;
+
+    // Ring buffer of kEventsPerThread events: the next event overwrites the oldest one
+    std::vector<RenderTraceEvent> events;
+
+    // Index of the next event to write and number of valid events
+    std::size_t nextEvent, nEvents;
+
+    // True once the thread exited: the buffer may then be used by a new thread.
+    // Protected by RenderTracerGlobalData::buffersLock
+    bool threadExited;
+
+    RenderTraceThreadBuffer()
+    : lock()
+    , threadIndex(0)
+    , threadName()
+    , events(RenderTracer::kEventsPerThread)
+    , nextEvent(0)
+    , nEvents(0)
+    , threadExited(false)
+    {
+    }
+};
+
+typedef boost::shared_ptr<RenderTraceThreadBuffer> RenderTraceThreadBufferPtr;
+
+// Held in the thread local storage. When the thread exits, only the reference is deleted: the events
+// of the thread remain available for export until a new thread recycles the buffer.
+struct RenderTraceThreadBufferRef
+{
+    RenderTraceThreadBufferPtr buffer;
+
+    ~RenderTraceThreadBufferRef();
+};
+
+struct RenderTracerGlobalData
+{
+    // Set by RenderTracer::setEnabled()
+    QAtomicInt enabled;
+
+    // Times all events
+    TimeLapse timer;
+
+    // Protects buffers and nThreads
+    QMutex buffersLock;
+    std::list<RenderTraceThreadBufferPtr> buffers;
+    int nThreads;
+
+    QThreadStorage<RenderTraceThreadBufferRef*> threadBuffer;
+
+    RenderTracerGlobalData()
+    : enabled(0)
+    , timer()
+    , buffersLock()
+    , buffers()
+    , nThreads(0)
+    , threadBuffer()
+    {
+    }
+};
+
+static RenderTracerGlobalData globalData;
+
+RenderTraceThreadBufferRef::~RenderTraceThreadBufferRef()
+{
+    QMutexLocker k(&globalData.buffersLock);
+
+    buffer->threadExited = true;
+}
+
+static RenderTraceThreadBuffer*
+getCurrentThreadBuffer()
+{
+    if ( globalData.threadBuffer.hasLocalData() ) {
+        return globalData.threadBuffer.localData()->buffer.get();
+    }
+
+    QThread* thread = QThread::currentThread();
+    RenderTraceThreadBufferRef* ref = new RenderTraceThreadBufferRef;
+    {
+        QMutexLocker k(&globalData.buffersLock);
+
+        // Recycle the buffer of a thread that exited, so that threads created and destroyed by the thread pools
+        // over a long session do not each keep a buffer. Its events are discarded.
+        for (std::list<RenderTraceThreadBufferPtr>::const_iterator it = globalData.buffers.begin(); it != globalData.buffers.end(); ++it) {
+            if ( (*it)->threadExited ) {
+                ref->buffer = *it;
+                break;
+            }
+        }
+        bool recycled = bool(ref->buffer);
+        if (!recycled) {
+            ref->buffer.reset(new RenderTraceThreadBuffer);
+        }
+
+        QMutexLocker l(&ref->buffer->lock);
+        ref->buffer->threadExited = false;
+        ref->buffer->nextEvent = 0;
+        ref->buffer->nEvents = 0;
+        ref->buffer->threadIndex = ++globalData.nThreads;
+        if ( qApp && (thread == qApp->thread()) ) {
+            ref->buffer->threadName = "Main thread";
+        } else if (thread) {
+            ref->buffer->threadName = thread->objectName().toStdString();
+        } else {
+            ref->buffer->threadName.clear();
+        }
+        if ( ref->buffer->threadName.empty() ) {
+            char name[32];
+            std::sprintf(name, "Thread %d", ref->buffer->threadIndex);
+            ref->buffer->threadName = name;
+        }
+        if (!recycled) {
+            globalData.buffers.push_back(ref->buffer);
+        }
+    }
+    globalData.threadBuffer.setLocalData(ref);
+
+    return ref->buffer.get();
+}
+
+static void
+writeJSONString(const std::string& str,
+                std::ostream& stream)
+{
+    stream << '"';
+    for (std::size_t i = 0; i < str.size(); ++i) {
+        unsigned char c = (unsigned char)str[i];
+        switch (c) {
+        case '"':
+            stream << "\\\"";
+            break;
+        case '\\':
+            stream << "\\\\";
+            break;
+        case '\n':
+            stream << "\\n";
+            break;
+        case '\t':
+            stream << "\\t";
+            break;
+        default:
+            if (c < 0x20) {
+                char escaped[8];
+                std::sprintf(escaped, "\\u%04x", c);
+                stream << escaped;
+            } else {
+                stream << str[i];
+            }
+            break;
+        }
+    }
+    stream << '"';
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+void
+RenderTracer::setEnabled(bool enabled)
+{
+    globalData.enabled.fetchAndStoreOrdered(enabled ? 1 : 0);
+}
+
+bool
+RenderTracer::isEnabled()
+{
+    return (int)globalData.enabled != 0;
+}
+
+void
+RenderTracer::clear()
+{
+    QMutexLocker k(&globalData.buffersLock);
+
+    for (std::list<RenderTraceThreadBufferPtr>::const_iterator it = globalData.buffers.begin(); it != globalData.buffers.end(); ++it) {
+        QMutexLocker l(&(*it)->lock);
+        (*it)->nextEvent = 0;
+        (*it)->nEvents = 0;
+    }
+}
+
+double
+RenderTracer::getCurrentTime()
+{
+    return globalData.timer.getTimeSinceCreation() * 1e6;
+}
+
+void
+RenderTracer::addEvent(const char* category,
+                       const char* name,
+                       double startTime,
+                       double duration,
+                       const std::string& detail)
+{
+    RenderTraceThreadBuffer* buffer = getCurrentThreadBuffer();
+    QMutexLocker k(&buffer->lock);
+    RenderTraceEvent& e = buffer->events[buffer->nextEvent];
+
+    e.category = category;
+    e.name = name;
+    e.startTime = startTime;
+    e.duration = duration;
+    e.detail = detail;
+    buffer->nextEvent = (buffer->nextEvent + 1) % buffer->events.size();
+    if ( buffer->nEvents < buffer->events.size() ) {
+        ++buffer->nEvents;
+    }
+}
+
+void
+RenderTracer::writeChromeTrace(std::ostream& stream)
+{
+    std::list<RenderTraceThreadBufferPtr> buffers;
+    {
+        QMutexLocker k(&globalData.buffersLock);
+        buffers = globalData.buffers;
+    }
+
+    stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (std::list<RenderTraceThreadBufferPtr>::const_iterator it = buffers.begin(); it != buffers.end(); ++it) {
+        QMutexLocker k(&(*it)->lock);
+        if ( (*it)->nEvents == 0 ) {
+            continue;
+        }
+
+        // Name the thread
+        stream << (first ? "\n" : ",\n");
+        first = false;
+        stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << (*it)->threadIndex << ",\"args\":{\"name\":";
+        writeJSONString( (*it)->threadName, stream );
+        stream << "}}";
+
+        // Write the events from the oldest to the most recent
+        std::size_t bufferSize = (*it)->events.size();
+        std::size_t firstEvent = ( (*it)->nextEvent + bufferSize - (*it)->nEvents ) % bufferSize;
+        for (std::size_t i = 0; i < (*it)->nEvents; ++i) {
+            const RenderTraceEvent& e = (*it)->events[(firstEvent + i) % bufferSize];
+            stream << ",\n{\"name\":";
+            writeJSONString(e.name, stream);
+            stream << ",\"cat\":";
+            writeJSONString(e.category, stream);
+            stream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << (*it)->threadIndex << ",\"ts\":" << e.startTime << ",\"dur\":" << e.duration;
+            if ( !e.detail.empty() ) {
+                stream << ",\"args\":{\"detail\":";
+                writeJSONString(e.detail, stream);
+                stream << "}";
+            }
+            stream << "}";
+        }
+    }
+    stream << "\n]}\n";
+} // writeChromeTrace
+
+bool
+RenderTracer::exportChromeTrace(const std::string& filePath)
+{
+    FStreamsSupport::ofstream ofile;
+
+    FStreamsSupport::open(&ofile, filePath);
+    if (!ofile) {
+        return false;
+    }
+    ofile.precision(15);
+    writeChromeTrace(ofile);
+
+    return !ofile.fail();
+}
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,153 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_RENDERTRACER_H
+#define NATRON_ENGINE_RENDERTRACER_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Records a timeline of what each thread does during renders: render tasks, cache lookups and waits,
+ * plane conversions and plug-in actions. The timeline can be exported in the Chrome trace event format
+ * to be displayed in chrome://tracing or Perfetto, to find out where threads wait on each other.
+ *
+ * Each thread records its events in its own ring buffer which only keeps the most recent events.
+ * Recording is disabled by default: a trace point then costs a single atomic read.
+ * Trace points are compiled out entirely when NATRON_DISABLE_RENDER_TRACE is defined.
+ **/
+class RenderTracer
+{
+public:
+
+    // The number of events kept for each thread
+    static const std::size_t kEventsPerThread = 16384;
+
+    static void setEnabled(bool enabled);
+
+    static bool isEnabled();
+
+    /**
+     * @brief Discard all events recorded so far.
+     **/
+    static void clear();
+
+    /**
+     * @brief Returns the time in microseconds since the application started, used to time the events.
+     **/
+    static double getCurrentTime();
+
+    /**
+     * @brief Record an event on the calling thread.
+     * @param category and name must be string literals: they are not copied.
+     * @param detail An optional description, e.g: the name of the node.
+     **/
+    static void addEvent(const char* category,
+                         const char* name,
+                         double startTime,
+                         double duration,
+                         const std::string& detail);
+
+    /**
+     * @brief Writes the events recorded so far in the Chrome trace event JSON format.
+     **/
+    static void writeChromeTrace(std::ostream& stream);
+
+    /**
+     * @brief Same as writeChromeTrace, to a file.
+     * @returns False if the file could not be written.
+     **/
+    static bool exportChromeTrace(const std::string& filePath);
+};
+
+/**
+ * @brief Records an event on the calling thread lasting from the constructor to the destructor.
+ * Use the NATRON_RENDER_TRACE_SCOPE macros rather than this class directly.
+ **/
+class RenderTraceScope
+{
+    const char* _category;
+    const char* _name;
+    double _startTime;
+    std::string _detail;
+
+public:
+
+    RenderTraceScope(const char* category,
+                     const char* name)
+    : _category(category)
+    , _name(name)
+    , _startTime(-1.)
+    , _detail()
+    {
+        if ( RenderTracer::isEnabled() ) {
+            _startTime = RenderTracer::getCurrentTime();
+        }
+    }
+
+    RenderTraceScope(const char* category,
+                     const char* name,
+                     const std::string& detail)
+    : _category(category)
+    , _name(name)
+    , _startTime(-1.)
+    , _detail(detail)
+    {
+        if ( RenderTracer::isEnabled() ) {
+            _startTime = RenderTracer::getCurrentTime();
+        }
+    }
+
+    ~RenderTraceScope()
+    {
+        if (_startTime >= 0.) {
+            RenderTracer::addEvent(_category, _name, _startTime, RenderTracer::getCurrentTime() - _startTime, _detail);
+        }
+    }
+
+    bool isRecording() const
+    {
+        return _startTime >= 0.;
+    }
+};
+
+#ifndef NATRON_DISABLE_RENDER_TRACE
+#define NATRON_RENDER_TRACE_SCOPE(category, name) RenderTraceScope natronRenderTraceScope(category, name)
+// detail is only evaluated when recording
+#define NATRON_RENDER_TRACE_SCOPE_DETAIL(category, name, detail) RenderTraceScope natronRenderTraceScope( category, name, RenderTracer::isEnabled() ? std::string(detail) : std::string() )
+#else
+#define NATRON_RENDER_TRACE_SCOPE(category, name) (void)0
+#define NATRON_RENDER_TRACE_SCOPE_DETAIL(category, name, detail) (void)0
+#endif
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_RENDERTRACER_H
@@ -84,6 +84,12 @@ public:
 
     virtual void appendToHash(const ComputeHashArgs& args, Hash64* hash)  OVERRIDE FINAL;
 
+    // Each clone renders a clone of the roto item for its render
+    virtual bool isRenderCloneRecyclable() const OVERRIDE FINAL
+    {
+        return false;
+    }
+
 private:
 
     virtual KnobHolderPtr createRenderCopy(const FrameViewRenderKey& key) const OVERRIDE FINAL;
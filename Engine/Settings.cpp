@@ -31,7 +31,6 @@
 #include <QtCore/QDebug>
 #include <QtCore/QDir>
 #include <QtCore/QSettings>
-#include <QtCore/QThreadPool>
 #include <QtCore/QThread>
 #include <QtCore/QTextStream>
 
@@ -57,6 +56,7 @@
 #include "Engine/Plugin.h"
 #include "Engine/Project.h"
 #include "Engine/StandardPaths.h"
+#include "Engine/ThreadPool.h"
 #include "Engine/Utils.h"
 #include "Engine/ViewIdx.h"
 #include "Engine/ViewerInstance.h"
@@ -125,6 +125,20 @@ public:
     KnobIntPtr _numberOfThreads;
     KnobBoolPtr _renderInSeparateProcess;
     KnobBoolPtr _queueRenders;
+    KnobBoolPtr _pinThreadsToNUMANodes;
+    KnobBoolPtr _criticalPathScheduling;
+    KnobBoolPtr _preemptBackgroundRenders;
+    KnobIntPtr _nThreadsReservedForInteractiveRenders;
+    KnobBoolPtr _recycleRenderClones;
+    KnobBoolPtr _prefetchPythonExpressions;
+    KnobBoolPtr _pipelineRendersOnDisk;
+    KnobIntPtr _pipelineMaxFramesAhead;
+    KnobIntPtr _pipelineMemoryBudgetMB;
+    KnobIntPtr _pipelineMaxFramesProcessing;
+    KnobBoolPtr _streamTileRenders;
+    KnobBoolPtr _viewerPrefetch;
+    KnobIntPtr _viewerPrefetchMaxFrames;
+    KnobIntPtr _viewerPrefetchMemoryBudgetMB;
 
     // General/Rendering
     KnobPagePtr _renderingPage;
@@ -181,11 +195,18 @@ public:
 
     // The total disk space allowed for all Natron's caches
     KnobIntPtr _maxDiskCacheSizeGb;
+
+    // The disk space allowed for compressed tiles evicted from the cache
+    KnobIntPtr _maxCompressedDiskCacheSizeGb;
+    KnobChoicePtr _cacheEvictionPolicy;
+    KnobBoolPtr _cacheUseHugePages;
+    KnobBoolPtr _cacheSpreadOnNUMANodes;
     KnobPathPtr _diskCachePath;
 
     // Viewer
     KnobPagePtr _viewersTab;
     KnobChoicePtr _texturesMode;
+    KnobBoolPtr _viewerOrderedDithering;
     KnobIntPtr _checkerboardTileSize;
     KnobColorPtr _checkerboardColor1;
     KnobColorPtr _checkerboardColor2;
@@ -955,6 +976,138 @@ SettingsPrivate::initializeKnobsThreading()
     _queueRenders->setHintToolTip( tr("When checked, renders will be queued in the Progress Panel and will start only when all "
                                       "other prior tasks are done.") );
     _threadingPage->addKnob(_queueRenders);
+
+    _pinThreadsToNUMANodes = _publicInterface->createKnob<KnobBool>("pinThreadsToNUMANodes");
+    _pinThreadsToNUMANodes->setLabel(tr("Pin render threads to NUMA nodes"));
+    _pinThreadsToNUMANodes->setHintToolTip( tr("On computers with several processor sockets (NUMA nodes), when checked, each render thread "
+                                               "only runs on the cores of one node so that the memory it allocates stays close to it. "
+                                               "Render threads are distributed evenly across nodes.\n"
+                                               "Changing this requires a restart of the application to take effect.") );
+    _pinThreadsToNUMANodes->setDefaultValue(false);
+    _threadingPage->addKnob(_pinThreadsToNUMANodes);
+
+    _criticalPathScheduling = _publicInterface->createKnob<KnobBool>("criticalPathScheduling");
+    _criticalPathScheduling->setLabel(tr("Render the longest branches first"));
+    _criticalPathScheduling->setHintToolTip( tr("When checked, the nodes that are ready to render are started in order of the estimated "
+                                                "time left to render the output through them, based on how long each node took to render "
+                                                "previously. This helps keep all threads busy on graphs with a few slow nodes.\n"
+                                                "When unchecked, the nodes are started in the order they become ready.") );
+    _criticalPathScheduling->setDefaultValue(false);
+    _threadingPage->addKnob(_criticalPathScheduling);
+
+    _preemptBackgroundRenders = _publicInterface->createKnob<KnobBool>("preemptBackgroundRenders");
+    _preemptBackgroundRenders->setLabel(tr("Prioritize viewer renders over background renders"));
+    _preemptBackgroundRenders->setHintToolTip( tr("When checked, renders on disk, playback and speculative renders pause between two tiles "
+                                                  "while the viewer is waiting for a render to start, and some threads are kept for the "
+                                                  "renders of the viewer, so that it stays responsive while rendering on disk in the same "
+                                                  "process.") );
+    _preemptBackgroundRenders->setDefaultValue(true);
+    _threadingPage->addKnob(_preemptBackgroundRenders);
+
+    _nThreadsReservedForInteractiveRenders = _publicInterface->createKnob<KnobInt>("threadsReservedForViewerRenders");
+    _nThreadsReservedForInteractiveRenders->setLabel(tr("Threads reserved for viewer renders"));
+    _nThreadsReservedForInteractiveRenders->setHintToolTip( tr("When viewer renders are prioritized, this is the number of render threads "
+                                                               "that renders on disk, playback and speculative renders may not use while a viewer render is running.") );
+    _nThreadsReservedForInteractiveRenders->disableSlider();
+    _nThreadsReservedForInteractiveRenders->setRange(0, hwThreadsCount);
+    _nThreadsReservedForInteractiveRenders->setDisplayRange(0, hwThreadsCount);
+    _nThreadsReservedForInteractiveRenders->setDefaultValue(1);
+    _threadingPage->addKnob(_nThreadsReservedForInteractiveRenders);
+
+    _recycleRenderClones = _publicInterface->createKnob<KnobBool>("recycleRenderClones");
+    _recycleRenderClones->setLabel(tr("Reuse node copies across frames"));
+    _recycleRenderClones->setHintToolTip( tr("Each render works on a copy of the nodes it renders. When checked, these copies are "
+                                             "kept once the render is finished and reused by the next renders as long as the "
+                                             "parameters of the node did not change, which reduces the overhead of each frame during "
+                                             "playback and renders on disk.") );
+    _recycleRenderClones->setDefaultValue(true);
+    _threadingPage->addKnob(_recycleRenderClones);
+
+    _prefetchPythonExpressions = _publicInterface->createKnob<KnobBool>("prefetchPythonExpressions");
+    _prefetchPythonExpressions->setLabel(tr("Evaluate Python expressions before rendering"));
+    _prefetchPythonExpressions->setHintToolTip( tr("When checked, the Python expressions of the parameters of the nodes rendered are "
+                                                   "evaluated for the frames about to be rendered before their render starts, a few frames at a time. "
+                                                   "Only one thread at a time may run Python: this avoids that render threads wait on "
+                                                   "each other to evaluate expressions. Expressions whose results are not cached are not evaluated.") );
+    _prefetchPythonExpressions->setDefaultValue(false);
+    _threadingPage->addKnob(_prefetchPythonExpressions);
+
+    _pipelineRendersOnDisk = _publicInterface->createKnob<KnobBool>("pipelineRendersOnDisk");
+    _pipelineRendersOnDisk->setLabel(tr("Pipeline renders on disk"));
+    _pipelineRendersOnDisk->setHintToolTip( tr("When checked, renders on disk render frames ahead of the frame being written, "
+                                               "as long as the frames being rendered fit in the memory budget below, and rendered "
+                                               "frames are finished in order while the next ones render. Statistics about the occupancy "
+                                               "of each stage are printed when rendering with --stats.") );
+    _pipelineRendersOnDisk->setDefaultValue(false);
+    _threadingPage->addKnob(_pipelineRendersOnDisk);
+
+    _pipelineMaxFramesAhead = _publicInterface->createKnob<KnobInt>("pipelineMaxFramesAhead");
+    _pipelineMaxFramesAhead->setLabel(tr("Max. frames rendered ahead"));
+    _pipelineMaxFramesAhead->setHintToolTip( tr("When renders on disk are pipelined, this is the maximum number of frames rendering at the same time. "
+                                                "When 0, this is the number of render threads.") );
+    _pipelineMaxFramesAhead->disableSlider();
+    _pipelineMaxFramesAhead->setRange(0, 256);
+    _pipelineMaxFramesAhead->setDisplayRange(0, 64);
+    _pipelineMaxFramesAhead->setDefaultValue(0);
+    _threadingPage->addKnob(_pipelineMaxFramesAhead);
+
+    _pipelineMemoryBudgetMB = _publicInterface->createKnob<KnobInt>("pipelineMemoryBudgetMB");
+    _pipelineMemoryBudgetMB->setLabel(tr("Memory budget of frames rendered ahead (MiB)"));
+    _pipelineMemoryBudgetMB->setHintToolTip( tr("When renders on disk are pipelined, no more frames are rendered ahead once the images "
+                                                "of the frames being rendered would exceed this amount of memory. At least one frame is always rendered.") );
+    _pipelineMemoryBudgetMB->disableSlider();
+    _pipelineMemoryBudgetMB->setRange(1, INT_MAX);
+    _pipelineMemoryBudgetMB->setDisplayRange(256, 16384);
+    _pipelineMemoryBudgetMB->setDefaultValue(2048);
+    _threadingPage->addKnob(_pipelineMemoryBudgetMB);
+
+    _pipelineMaxFramesProcessing = _publicInterface->createKnob<KnobInt>("pipelineMaxFramesProcessing");
+    _pipelineMaxFramesProcessing->setLabel(tr("Max. frames waiting to be finished"));
+    _pipelineMaxFramesProcessing->setHintToolTip( tr("When renders on disk are pipelined, this is the maximum number of rendered frames "
+                                                     "waiting to be finished. When reached, no frame is collected until one is finished.") );
+    _pipelineMaxFramesProcessing->disableSlider();
+    _pipelineMaxFramesProcessing->setRange(1, 64);
+    _pipelineMaxFramesProcessing->setDisplayRange(1, 16);
+    _pipelineMaxFramesProcessing->setDefaultValue(4);
+    _threadingPage->addKnob(_pipelineMaxFramesProcessing);
+
+    _streamTileRenders = _publicInterface->createKnob<KnobBool>("streamTileRenders");
+    _streamTileRenders->setLabel(tr("Render images in groups of tiles"));
+    _streamTileRenders->setHintToolTip( tr("When checked, the image of the output node of a render is split in groups of tiles "
+                                           "and each group is rendered through the whole node graph on its own, so that the first "
+                                           "tiles are available before all the nodes upstream are done with the whole image. "
+                                           "This only applies if the output node supports tiles and can render concurrently.") );
+    _streamTileRenders->setDefaultValue(false);
+    _threadingPage->addKnob(_streamTileRenders);
+
+    _viewerPrefetch = _publicInterface->createKnob<KnobBool>("viewerPrefetch");
+    _viewerPrefetch->setLabel(tr("Prefetch viewer frames when idle"));
+    _viewerPrefetch->setHintToolTip( tr("When checked, once the viewer is done rendering, the frames it is likely to display next "
+                                        "are rendered in the cache with the lowest priority. The frames are predicted from the "
+                                        "direction of the last playback or the speed at which the timeline is scrubbed, within the "
+                                        "in/out points. Prefetching stops as soon as a parameter is changed or another render starts.") );
+    _viewerPrefetch->setDefaultValue(true);
+    _threadingPage->addKnob(_viewerPrefetch);
+
+    _viewerPrefetchMaxFrames = _publicInterface->createKnob<KnobInt>("viewerPrefetchMaxFrames");
+    _viewerPrefetchMaxFrames->setLabel(tr("Max. frames prefetched"));
+    _viewerPrefetchMaxFrames->setHintToolTip( tr("Maximum number of frames prefetched each time the viewer becomes idle.") );
+    _viewerPrefetchMaxFrames->disableSlider();
+    _viewerPrefetchMaxFrames->setRange(1, 1000);
+    _viewerPrefetchMaxFrames->setDisplayRange(1, 100);
+    _viewerPrefetchMaxFrames->setDefaultValue(24);
+    _threadingPage->addKnob(_viewerPrefetchMaxFrames);
+
+    _viewerPrefetchMemoryBudgetMB = _publicInterface->createKnob<KnobInt>("viewerPrefetchMemoryBudgetMB");
+    _viewerPrefetchMemoryBudgetMB->setLabel(tr("Memory budget of prefetched frames (MiB)"));
+    _viewerPrefetchMemoryBudgetMB->setHintToolTip( tr("Prefetching stops once the frames it rendered take this amount of memory in the "
+                                                      "image cache, or when the image cache is full, so that prefetched frames do not "
+                                                      "evict images that are already cached.") );
+    _viewerPrefetchMemoryBudgetMB->disableSlider();
+    _viewerPrefetchMemoryBudgetMB->setRange(1, INT_MAX);
+    _viewerPrefetchMemoryBudgetMB->setDisplayRange(256, 16384);
+    _viewerPrefetchMemoryBudgetMB->setDefaultValue(1024);
+    _threadingPage->addKnob(_viewerPrefetchMemoryBudgetMB);
 } // Settings::initializeKnobsThreading
 
 void
@@ -1993,6 +2146,15 @@ SettingsPrivate::initializeKnobsViewers()
     _texturesMode->setDefaultValue(0);
     _viewersTab->addKnob(_texturesMode);
 
+    _viewerOrderedDithering = _publicInterface->createKnob<KnobBool>("viewerOrderedDithering");
+    _viewerOrderedDithering->setLabel(tr("Ordered dithering of 8-bit textures"));
+    _viewerOrderedDithering->setHintToolTip( tr("When checked, the viewer uses an ordered dither to convert images to 8-bit textures. "
+                                                "Each pixel is processed independently, which allows the vectorized and multi-threaded "
+                                                "processing of the image. When unchecked, error diffusion is used instead, which processes "
+                                                "each scan-line pixel after pixel and is slower.") );
+    _viewerOrderedDithering->setDefaultValue(false);
+    _viewersTab->addKnob(_viewerOrderedDithering);
+
     _checkerboardTileSize = _publicInterface->createKnob<KnobInt>("checkerboardTileSize");
     _checkerboardTileSize->setLabel(tr("Checkerboard tile size (pixels)"));
     _checkerboardTileSize->setRange(1, INT_MAX);
@@ -2177,6 +2339,62 @@ SettingsPrivate::initializeKnobsCaching()
 
     _cachingTab->addKnob(_maxDiskCacheSizeGb);
 
+    _maxCompressedDiskCacheSizeGb = _publicInterface->createKnob<KnobInt>("maxCompressedDiskCacheGb");
+    _maxCompressedDiskCacheSizeGb->setLabel(tr("Maximum Compressed Disk Cache Size (GiB)"));
+    _maxCompressedDiskCacheSizeGb->disableSlider();
+    _maxCompressedDiskCacheSizeGb->setRange(0, INT_MAX);
+    _maxCompressedDiskCacheSizeGb->setHintToolTip( tr("When non zero, images evicted from the Cache are compressed and kept on disk "
+                                                      "up to this size (in GiB) so that they can be read back instead of being rendered again.\n"
+                                                      "This is only used when the Cache is persistent.") );
+    _maxCompressedDiskCacheSizeGb->setDefaultValue(0);
+
+    _cachingTab->addKnob(_maxCompressedDiskCacheSizeGb);
+
+    _cacheEvictionPolicy = _publicInterface->createKnob<KnobChoice>("cacheEvictionPolicy");
+    _cacheEvictionPolicy->setLabel(tr("Cache Eviction Policy"));
+    {
+        std::vector<ChoiceOption> policies;
+        assert(policies.size() == eCacheEvictionPolicyTypeLRU);
+        policies.push_back(ChoiceOption("lru",
+                                        tr("Least Recently Used").toStdString(),
+                                        tr("When the Cache is full, the images that were not used for the longest time are removed first.").toStdString()));
+        assert(policies.size() == eCacheEvictionPolicyTypeCLOCK);
+        policies.push_back(ChoiceOption("clock",
+                                        tr("Second Chance").toStdString(),
+                                        tr("An approximation of Least Recently Used which has less overhead when many threads access the Cache.").toStdString()));
+        assert(policies.size() == eCacheEvictionPolicyTypeCostAware);
+        policies.push_back(ChoiceOption("cost",
+                                        tr("Render Time").toStdString(),
+                                        tr("When the Cache is full, the images that were the fastest to render relative to the memory they take "
+                                           "are removed first, so that the output of expensive nodes is kept longer.").toStdString()));
+        _cacheEvictionPolicy->populateChoices(policies);
+    }
+    _cacheEvictionPolicy->setHintToolTip( tr("Controls which images are removed from the Cache when it is full."
+                                             " Hover each option with the mouse for a detailed description.") );
+    _cacheEvictionPolicy->setDefaultValue(0);
+
+    _cachingTab->addKnob(_cacheEvictionPolicy);
+
+    _cacheUseHugePages = _publicInterface->createKnob<KnobBool>("cacheUseHugePages");
+    _cacheUseHugePages->setLabel(tr("Use Huge Pages for the Cache"));
+    _cacheUseHugePages->setHintToolTip( tr("When checked, the system is asked to back the images in the Cache with huge memory pages, "
+                                           "which reduces the time spent handling page faults when reading and writing images. "
+                                           "This is only supported on Linux.\n"
+                                           "To use explicit huge pages, set the Disk Cache Path to a directory on a hugetlbfs mount point.") );
+    _cacheUseHugePages->setDefaultValue(false);
+
+    _cachingTab->addKnob(_cacheUseHugePages);
+
+    _cacheSpreadOnNUMANodes = _publicInterface->createKnob<KnobBool>("cacheSpreadOnNUMANodes");
+    _cacheSpreadOnNUMANodes->setLabel(tr("Spread the Cache on NUMA nodes"));
+    _cacheSpreadOnNUMANodes->setHintToolTip( tr("On computers with several processor sockets (NUMA nodes), when checked, the memory of the Cache "
+                                                "is split evenly across nodes. When \"Pin render threads to NUMA nodes\" is also checked, "
+                                                "each render thread allocates images in the memory of the node it runs on. "
+                                                "This is only supported on Linux.") );
+    _cacheSpreadOnNUMANodes->setDefaultValue(false);
+
+    _cachingTab->addKnob(_cacheSpreadOnNUMANodes);
+
 
     _diskCachePath = _publicInterface->createKnob<KnobPath>("diskCachePath");
     _diskCachePath->setLabel(tr("Disk Cache Path (empty = default)"));
@@ -2555,6 +2773,9 @@ Settings::loadSettingsFromFile(LoadSettingsType loadType)
         // Restore number of threads
         _imp->restoreNumThreads();
 
+        // Must be set before the thread pool threads are started
+        setThreadPoolThreadsNUMAPinningEnabled( _imp->_pinThreadsToNUMANodes->getValue() );
+
 
         // If the appearance changed, flag it
         try {
@@ -2760,10 +2981,10 @@ SettingsPrivate::restoreNumThreads()
         int idealCount = appPTR->getHardwareIdealThreadCount();
         assert(idealCount > 0);
         idealCount = std::max(idealCount, 1);
-        QThreadPool::globalInstance()->setMaxThreadCount(idealCount);
-    } else {
-        QThreadPool::globalInstance()->setMaxThreadCount(nbThreads);
+        nbThreads = idealCount;
     }
+    // Only renders are bounded by this setting: other asynchronous tasks run in the global QThreadPool
+    appPTR->getRenderThreadPool()->setMaxThreadCount(nbThreads);
 }
 
 void
@@ -2772,6 +2993,9 @@ SettingsPrivate::refreshCacheSize()
     CacheBasePtr tileCache = appPTR->getTileCache();
     if (tileCache) {
         tileCache->setMaximumCacheSize(_publicInterface->getTileCacheSize());
+        tileCache->setMaximumCompressedTilesSize(_publicInterface->getCompressedTileCacheSize());
+        tileCache->setEvictionPolicy(_publicInterface->getCacheEvictionPolicy());
+        tileCache->setTileStorageMemoryHints(_publicInterface->isCacheHugePagesEnabled(), _publicInterface->isCacheSpreadOnNUMANodesEnabled());
     }
 
     CacheBasePtr cache = appPTR->getGeneralPurposeCache();
@@ -2799,6 +3023,34 @@ Settings::getTileCacheSize() const
     return maxDiskBytes;
 }
 
+std::size_t
+Settings::getCompressedTileCacheSize() const
+{
+    std::size_t kb = 1024;
+    std::size_t mb = kb * kb;
+    std::size_t gb = mb * kb;
+    std::size_t maxDiskBytes = (std::size_t)_imp->_maxCompressedDiskCacheSizeGb->getValue() * gb;
+    return maxDiskBytes;
+}
+
+CacheEvictionPolicyTypeEnum
+Settings::getCacheEvictionPolicy() const
+{
+    return (CacheEvictionPolicyTypeEnum)_imp->_cacheEvictionPolicy->getValue();
+}
+
+bool
+Settings::isCacheHugePagesEnabled() const
+{
+    return _imp->_cacheUseHugePages->getValue();
+}
+
+bool
+Settings::isCacheSpreadOnNUMANodesEnabled() const
+{
+    return _imp->_cacheSpreadOnNUMANodes->getValue();
+}
+
 bool
 Settings::onKnobValueChanged(const KnobIPtr& k,
                              ValueChangedReasonEnum reason,
@@ -2809,7 +3061,8 @@ Settings::onKnobValueChanged(const KnobIPtr& k,
     Q_EMIT settingChanged(k, reason);
     bool ret = true;
 
-    if ( k == _imp->_maxDiskCacheSizeGb ) {
+    if ( k == _imp->_maxDiskCacheSizeGb || k == _imp->_maxCompressedDiskCacheSizeGb || k == _imp->_cacheEvictionPolicy ||
+         k == _imp->_cacheUseHugePages || k == _imp->_cacheSpreadOnNUMANodes ) {
         _imp->refreshCacheSize();
     }  else if ( k == _imp->_numberOfThreads ) {
         _imp->restoreNumThreads();
@@ -2965,6 +3218,12 @@ Settings::isViewerKeysEnabled() const
     return _imp->_viewerKeys->getValue();
 }
 
+bool
+Settings::isViewerOrderedDitheringEnabled() const
+{
+    return _imp->_viewerOrderedDithering->getValue();
+}
+
 ///////////////////////////////////////////////////////
 // "Caching" pane
 
@@ -4065,6 +4324,114 @@ Settings::isRenderQueuingEnabled() const
     return _imp->_queueRenders->getValue();
 }
 
+bool
+Settings::isCriticalPathSchedulingEnabled() const
+{
+    return _imp->_criticalPathScheduling->getValue();
+}
+
+bool
+Settings::isBackgroundRenderPreemptionEnabled() const
+{
+    return _imp->_preemptBackgroundRenders->getValue();
+}
+
+void
+Settings::setBackgroundRenderPreemptionEnabled(bool enabled)
+{
+    _imp->_preemptBackgroundRenders->setValue(enabled);
+}
+
+int
+Settings::getNumThreadsReservedForInteractiveRenders() const
+{
+    return _imp->_nThreadsReservedForInteractiveRenders->getValue();
+}
+
+bool
+Settings::isRenderCloneRecyclingEnabled() const
+{
+    return _imp->_recycleRenderClones->getValue();
+}
+
+void
+Settings::setRenderCloneRecyclingEnabled(bool enabled)
+{
+    _imp->_recycleRenderClones->setValue(enabled);
+}
+
+bool
+Settings::isPythonExpressionsPrefetchEnabled() const
+{
+    return _imp->_prefetchPythonExpressions->getValue();
+}
+
+bool
+Settings::isRenderPipeliningEnabled() const
+{
+    return _imp->_pipelineRendersOnDisk->getValue();
+}
+
+void
+Settings::setRenderPipeliningEnabled(bool enabled)
+{
+    _imp->_pipelineRendersOnDisk->setValue(enabled);
+}
+
+int
+Settings::getRenderPipelineMaxFramesAhead() const
+{
+    return _imp->_pipelineMaxFramesAhead->getValue();
+}
+
+U64
+Settings::getRenderPipelineMemoryBudget() const
+{
+    return (U64)_imp->_pipelineMemoryBudgetMB->getValue() * 1024 * 1024;
+}
+
+int
+Settings::getRenderPipelineMaxFramesProcessing() const
+{
+    return _imp->_pipelineMaxFramesProcessing->getValue();
+}
+
+bool
+Settings::isTileStreamingEnabled() const
+{
+    return _imp->_streamTileRenders->getValue();
+}
+
+void
+Settings::setTileStreamingEnabled(bool enabled)
+{
+    _imp->_streamTileRenders->setValue(enabled);
+}
+
+bool
+Settings::isViewerPrefetchEnabled() const
+{
+    return _imp->_viewerPrefetch->getValue();
+}
+
+void
+Settings::setViewerPrefetchEnabled(bool enabled)
+{
+    _imp->_viewerPrefetch->setValue(enabled);
+}
+
+int
+Settings::getViewerPrefetchMaxFrames() const
+{
+    return _imp->_viewerPrefetchMaxFrames->getValue();
+}
+
+U64
+Settings::getViewerPrefetchMemoryBudget() const
+{
+    return (U64)_imp->_viewerPrefetchMemoryBudgetMB->getValue() * 1024 * 1024;
+}
+
 bool
 Settings::isFileDialogEnabledForNewWriters() const
 {
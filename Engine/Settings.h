@@ -127,6 +127,14 @@ public:
 
     std::size_t getTileCacheSize() const;
 
+    std::size_t getCompressedTileCacheSize() const;
+
+    CacheEvictionPolicyTypeEnum getCacheEvictionPolicy() const;
+
+    bool isCacheHugePagesEnabled() const;
+
+    bool isCacheSpreadOnNUMANodesEnabled() const;
+
     bool getColorPickerLinear() const;
 
     int getNumberOfThreads() const;
@@ -184,6 +192,44 @@ public:
 
     void setRenderQueuingEnabled(bool enabled);
 
+    bool isCriticalPathSchedulingEnabled() const;
+
+    bool isBackgroundRenderPreemptionEnabled() const;
+
+    void setBackgroundRenderPreemptionEnabled(bool enabled);
+
+    int getNumThreadsReservedForInteractiveRenders() const;
+
+    bool isRenderCloneRecyclingEnabled() const;
+
+    void setRenderCloneRecyclingEnabled(bool enabled);
+
+    bool isPythonExpressionsPrefetchEnabled() const;
+
+    bool isRenderPipeliningEnabled() const;
+
+    void setRenderPipeliningEnabled(bool enabled);
+
+    int getRenderPipelineMaxFramesAhead() const;
+
+    // In bytes
+    U64 getRenderPipelineMemoryBudget() const;
+
+    int getRenderPipelineMaxFramesProcessing() const;
+
+    bool isTileStreamingEnabled() const;
+
+    void setTileStreamingEnabled(bool enabled);
+
+    bool isViewerPrefetchEnabled() const;
+
+    void setViewerPrefetchEnabled(bool enabled);
+
+    int getViewerPrefetchMaxFrames() const;
+
+    // In bytes
+    U64 getViewerPrefetchMemoryBudget() const;
+
     void restoreAllSettingsToDefaults();
 
     void restorePageToDefaults(const KnobPagePtr& tab);
@@ -262,6 +308,7 @@ public:
     unsigned int getAutoProxyMipMapLevel() const;
     int getMaxOpenedNodesViewerContext() const;
     bool isViewerKeysEnabled() const;
+    bool isViewerOrderedDitheringEnabled() const;
     ///////////////////////////////////////////////////////
 
     bool areRGBPixelComponentsSupported() const;
@@ -24,19 +24,58 @@
 
 #include "ThreadPool.h"
 
+#include <algorithm>
+#include <cassert>
+#include <deque>
 #include <string>
 #include <sstream> // stringstream
+#include <vector>
 
 #include <QtCore/QAtomicInt>
+#include <QtCore/QDebug>
 #include <QtCore/QMutex>
 #include <QtCore/QThread>
 #include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
+
+#include "Global/ProcInfo.h"
 
 #include "Engine/Node.h"
+#include "Engine/Timer.h"
 #include "Engine/TreeRender.h"
 
+//#define TRACE_THREAD_POOL_WORKERS_LIMIT
+
 NATRON_NAMESPACE_ENTER
 
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// Set by setThreadPoolThreadsNUMAPinningEnabled()
+static QAtomicInt pinThreadsToNUMANodes(0);
+
+// Incremented each time a thread is pinned, to distribute the threads across nodes
+static QAtomicInt nThreadsPinned(0);
+
+static void
+pinCurrentThreadToNUMANodeIfEnabled()
+{
+    if ( (int)pinThreadsToNUMANodes ) {
+        int nNodes = ProcInfo::getNUMANodesCount();
+        if (nNodes > 1) {
+            int threadIndex = nThreadsPinned.fetchAndAddRelaxed(1);
+            ProcInfo::pinCurrentThreadToNUMANode(threadIndex % nNodes);
+        }
+    }
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+void
+setThreadPoolThreadsNUMAPinningEnabled(bool enabled)
+{
+    pinThreadsToNUMANodes.fetchAndStoreOrdered(enabled ? 1 : 0);
+}
+
 
 struct AbortableThreadPrivate
 {
@@ -117,6 +156,588 @@ AbortableThread::getThread() const
 
 
 
+struct WorkStealingTask
+{
+    QRunnable* runnable;
+    bool canRunWhileWaiting;
+    int priority;
+};
+
+typedef std::deque<WorkStealingTask> WorkStealingTaskQueue;
+
+class WorkStealingThreadPoolThread;
+
+struct WorkStealingWorker
+{
+    WorkStealingThreadPoolThread* thread;
+
+    // Protects queue and the stats below
+    QMutex queueMutex;
+
+    // Tasks started by this thread: the owner thread pops at the back, other threads steal at the front
+    WorkStealingTaskQueue queue;
+
+    U64 nTasksRun;
+    U64 nTasksStolen;
+    U64 nTasksRunWhileWaiting;
+    double idleTimeSeconds;
+
+    WorkStealingWorker()
+    : thread(0)
+    , queueMutex()
+    , queue()
+    , nTasksRun(0)
+    , nTasksStolen(0)
+    , nTasksRunWhileWaiting(0)
+    , idleTimeSeconds(0)
+    {
+    }
+};
+
+struct WorkStealingThreadPoolPrivate
+{
+    WorkStealingThreadPool* _publicInterface;
+
+    // Threads are only destroyed with the pool. This vector is allocated once with room for all the threads the
+    // pool may create, so that a thread looking for a task to steal may read it without locking: only the first
+    // nWorkers elements are valid.
+    std::vector<WorkStealingWorker*> workers;
+    QAtomicInt nWorkers;
+
+    // Serializes the creation of threads
+    QMutex createWorkerMutex;
+
+#ifdef TRACE_THREAD_POOL_WORKERS_LIMIT
+    // True once a thread could not be created because workers is full. Protected by createWorkerMutex
+    bool workersLimitReached;
+#endif
+
+    // Protects globalQueue
+    QMutex globalQueueMutex;
+
+    // Tasks started from threads that do not belong to the pool, sorted by priority
+    WorkStealingTaskQueue globalQueue;
+
+    // Number of tasks in all queues
+    QAtomicInt nQueuedTasks;
+
+    // Number of tasks queued or running, for waitForDone()
+    QAtomicInt nPendingTasks;
+
+    // Number of threads currently running a task
+    QAtomicInt nActiveThreads;
+
+    // See releaseThread()
+    QAtomicInt nReleasedThreads;
+
+    QAtomicInt maxThreadCount;
+
+    // Protects mustQuit, and used with idleCond and doneCond
+    QMutex idleMutex;
+
+    // Threads without task wait in this condition
+    QWaitCondition idleCond;
+
+    // Threads calling waitForDone() wait in this condition
+    QWaitCondition doneCond;
+
+    // Number of threads waiting in idleCond
+    QAtomicInt nIdleThreads;
+
+    bool mustQuit;
+
+    WorkStealingThreadPoolPrivate(WorkStealingThreadPool* publicInterface, int maxThreads)
+    : _publicInterface(publicInterface)
+    , workers(std::max(256, 4 * QThread::idealThreadCount()), (WorkStealingWorker*)0)
+    , nWorkers(0)
+    , createWorkerMutex()
+#ifdef TRACE_THREAD_POOL_WORKERS_LIMIT
+    , workersLimitReached(false)
+#endif
+    , globalQueueMutex()
+    , globalQueue()
+    , nQueuedTasks(0)
+    , nPendingTasks(0)
+    , nActiveThreads(0)
+    , nReleasedThreads(0)
+    , maxThreadCount( std::max(1, maxThreads) )
+    , idleMutex()
+    , idleCond()
+    , doneCond()
+    , nIdleThreads(0)
+    , mustQuit(false)
+    {
+    }
+
+    bool hasThreadSlot() const
+    {
+        return (int)nActiveThreads < (int)maxThreadCount + (int)nReleasedThreads;
+    }
+
+    bool tryAcquireThreadSlot();
+
+    void wakeIdleThread();
+
+    void startThreadIfNeeded();
+
+    int getCurrentWorkerIndex() const;
+
+    bool popTask(int workerIndex, bool onlyTasksThatCanRunWhileWaiting, WorkStealingTask* task, bool* stolen);
+
+    void runTask(int workerIndex, const WorkStealingTask& task, bool stolen, bool whileWaiting);
+
+    // Must be called once the thread that ran a task does not count as active anymore
+    void onTaskDone();
+
+    void runWorker(int workerIndex);
+};
+
+class WorkStealingThreadPoolThread
+    : public QThread
+    , public AbortableThread
+{
+    WorkStealingThreadPoolPrivate* _pool;
+    int _index;
+
+public:
+
+    WorkStealingThreadPoolThread(WorkStealingThreadPoolPrivate* pool,
+                                 int index)
+        : QThread()
+        , AbortableThread(this)
+        , _pool(pool)
+        , _index(index)
+    {
+        setThreadName("Render Thread (Pooled)");
+    }
+
+    virtual ~WorkStealingThreadPoolThread() {}
+
+    virtual bool isThreadPoolThread() const OVERRIDE FINAL { return true; }
+
+    WorkStealingThreadPoolPrivate* getPool() const
+    {
+        return _pool;
+    }
+
+    int getIndex() const
+    {
+        return _index;
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL
+    {
+        pinCurrentThreadToNUMANodeIfEnabled();
+        _pool->runWorker(_index);
+    }
+};
+
+bool
+WorkStealingThreadPoolPrivate::tryAcquireThreadSlot()
+{
+    for (;;) {
+        int nActive = (int)nActiveThreads;
+        if ( nActive >= (int)maxThreadCount + (int)nReleasedThreads ) {
+            return false;
+        }
+        if ( nActiveThreads.testAndSetOrdered(nActive, nActive + 1) ) {
+            return true;
+        }
+    }
+}
+
+void
+WorkStealingThreadPoolPrivate::wakeIdleThread()
+{
+    // If all slots are taken, one of the running threads will pick the task when done
+    if ( ( (int)nQueuedTasks <= 0 ) || !hasThreadSlot() ) {
+        return;
+    }
+    // A thread going idle increments nIdleThreads before checking nQueuedTasks, whereas we incremented nQueuedTasks
+    // before checking nIdleThreads: either it sees the task or we see it and wake it
+    if ( (int)nIdleThreads > 0 ) {
+        QMutexLocker k(&idleMutex);
+        idleCond.wakeOne();
+
+        return;
+    }
+    startThreadIfNeeded();
+}
+
+void
+WorkStealingThreadPoolPrivate::startThreadIfNeeded()
+{
+    QMutexLocker k(&createWorkerMutex);
+    int nThreads = (int)nWorkers;
+
+    // Threads are never destroyed: only create one if all existing threads may be running a task
+    if ( nThreads >= (int)maxThreadCount + (int)nReleasedThreads ) {
+        return;
+    }
+    if ( nThreads >= (int)workers.size() ) {
+        // Threads that released their slot (see releaseThread()) are waiting for tasks that are queued until
+        // a thread finishes its task
+#ifdef TRACE_THREAD_POOL_WORKERS_LIMIT
+        if (!workersLimitReached) {
+            workersLimitReached = true;
+            qDebug() << "WorkStealingThreadPool: cannot create more than" << nThreads << "threads, queued tasks wait for a running task to finish";
+        }
+#endif
+
+        return;
+    }
+    WorkStealingWorker* worker = new WorkStealingWorker;
+    worker->thread = new WorkStealingThreadPoolThread(this, nThreads);
+    workers[nThreads] = worker;
+
+    // Publish the worker before starting it
+    nWorkers.fetchAndStoreOrdered(nThreads + 1);
+    worker->thread->start();
+}
+
+int
+WorkStealingThreadPoolPrivate::getCurrentWorkerIndex() const
+{
+    WorkStealingThreadPoolThread* thread = dynamic_cast<WorkStealingThreadPoolThread*>( QThread::currentThread() );
+    if ( !thread || (thread->getPool() != this) ) {
+        return -1;
+    }
+
+    return thread->getIndex();
+}
+
+static bool
+popTaskFromQueue(WorkStealingTaskQueue& queue,
+                 bool fromBack,
+                 bool onlyTasksThatCanRunWhileWaiting,
+                 WorkStealingTask* task)
+{
+    if ( queue.empty() ) {
+        return false;
+    }
+    if (!onlyTasksThatCanRunWhileWaiting) {
+        if (fromBack) {
+            *task = queue.back();
+            queue.pop_back();
+        } else {
+            *task = queue.front();
+            queue.pop_front();
+        }
+
+        return true;
+    }
+    if (fromBack) {
+        for (WorkStealingTaskQueue::iterator it = queue.end(); it != queue.begin();) {
+            --it;
+            if (it->canRunWhileWaiting) {
+                *task = *it;
+                queue.erase(it);
+
+                return true;
+            }
+        }
+    } else {
+        for (WorkStealingTaskQueue::iterator it = queue.begin(); it != queue.end(); ++it) {
+            if (it->canRunWhileWaiting) {
+                *task = *it;
+                queue.erase(it);
+
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool
+WorkStealingThreadPoolPrivate::popTask(int workerIndex,
+                                       bool onlyTasksThatCanRunWhileWaiting,
+                                       WorkStealingTask* task,
+                                       bool* stolen)
+{
+    if ( (int)nQueuedTasks <= 0 ) {
+        return false;
+    }
+
+    *stolen = false;
+    bool found = false;
+
+    // Our own most recent task first
+    if (workerIndex != -1) {
+        WorkStealingWorker* worker = workers[workerIndex];
+        QMutexLocker k(&worker->queueMutex);
+        found = popTaskFromQueue(worker->queue, true, onlyTasksThatCanRunWhileWaiting, task);
+    }
+
+    // Then the oldest task started from outside of the pool
+    if (!found) {
+        QMutexLocker k(&globalQueueMutex);
+        found = popTaskFromQueue(globalQueue, false, onlyTasksThatCanRunWhileWaiting, task);
+    }
+
+    // Then steal the oldest task of another thread, starting with the next one so that thieves spread across threads
+    if (!found) {
+        int nThreads = (int)nWorkers;
+        for (int i = 1; i <= nThreads && !found; ++i) {
+            int victimIndex = (workerIndex + i) % nThreads;
+            if (victimIndex == workerIndex) {
+                continue;
+            }
+            WorkStealingWorker* victim = workers[victimIndex];
+            QMutexLocker k(&victim->queueMutex);
+            found = popTaskFromQueue(victim->queue, false, onlyTasksThatCanRunWhileWaiting, task);
+            *stolen = found;
+        }
+    }
+
+    if (found) {
+        nQueuedTasks.fetchAndAddOrdered(-1);
+    }
+
+    return found;
+} // popTask
+
+void
+WorkStealingThreadPoolPrivate::runTask(int workerIndex,
+                                       const WorkStealingTask& task,
+                                       bool stolen,
+                                       bool whileWaiting)
+{
+    bool autoDelete = task.runnable->autoDelete();
+
+    task.runnable->run();
+    if (autoDelete) {
+        delete task.runnable;
+    }
+
+    {
+        WorkStealingWorker* worker = workers[workerIndex];
+        QMutexLocker k(&worker->queueMutex);
+        ++worker->nTasksRun;
+        if (stolen) {
+            ++worker->nTasksStolen;
+        }
+        if (whileWaiting) {
+            ++worker->nTasksRunWhileWaiting;
+        }
+    }
+}
+
+void
+WorkStealingThreadPoolPrivate::onTaskDone()
+{
+    if (nPendingTasks.fetchAndAddOrdered(-1) == 1) {
+        QMutexLocker k(&idleMutex);
+        doneCond.wakeAll();
+    }
+}
+
+void
+WorkStealingThreadPoolPrivate::runWorker(int workerIndex)
+{
+    WorkStealingWorker* worker = workers[workerIndex];
+
+    for (;;) {
+        if ( tryAcquireThreadSlot() ) {
+            WorkStealingTask task;
+            bool stolen;
+            bool found = popTask(workerIndex, false, &task, &stolen);
+            if (found) {
+                runTask(workerIndex, task, stolen, false);
+            }
+            nActiveThreads.fetchAndAddOrdered(-1);
+            if (found) {
+                onTaskDone();
+                continue;
+            }
+        }
+
+        double idleTime;
+        bool quit;
+        {
+            QMutexLocker k(&idleMutex);
+            nIdleThreads.fetchAndAddOrdered(1);
+            TimeLapse idleTimer;
+            while ( !mustQuit && ( ( (int)nQueuedTasks <= 0 ) || !hasThreadSlot() ) ) {
+                idleCond.wait(&idleMutex);
+            }
+            nIdleThreads.fetchAndAddOrdered(-1);
+            quit = mustQuit;
+            idleTime = idleTimer.getTimeSinceCreation();
+        }
+        {
+            QMutexLocker k(&worker->queueMutex);
+            worker->idleTimeSeconds += idleTime;
+        }
+        if (quit) {
+            return;
+        }
+    }
+} // runWorker
+
+WorkStealingThreadPool::WorkStealingThreadPool(int maxThreadCount)
+    : _imp( new WorkStealingThreadPoolPrivate(this, maxThreadCount) )
+{
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool()
+{
+    waitForDone();
+    {
+        QMutexLocker k(&_imp->idleMutex);
+        _imp->mustQuit = true;
+        _imp->idleCond.wakeAll();
+    }
+    QMutexLocker k(&_imp->createWorkerMutex);
+    int nThreads = (int)_imp->nWorkers;
+    // Other threads may still look at the queue of a thread until they all stopped
+    for (int i = 0; i < nThreads; ++i) {
+        _imp->workers[i]->thread->wait();
+    }
+    for (int i = 0; i < nThreads; ++i) {
+        delete _imp->workers[i]->thread;
+        delete _imp->workers[i];
+    }
+}
+
+void
+WorkStealingThreadPool::setMaxThreadCount(int maxThreadCount)
+{
+    _imp->maxThreadCount.fetchAndStoreOrdered( std::max(1, maxThreadCount) );
+
+    // Use the new slots, if any
+    int nQueued = (int)_imp->nQueuedTasks;
+    for (int i = 0; i < nQueued && _imp->hasThreadSlot(); ++i) {
+        _imp->wakeIdleThread();
+    }
+}
+
+int
+WorkStealingThreadPool::maxThreadCount() const
+{
+    return (int)_imp->maxThreadCount;
+}
+
+int
+WorkStealingThreadPool::activeThreadCount() const
+{
+    return (int)_imp->nActiveThreads - (int)_imp->nReleasedThreads;
+}
+
+void
+WorkStealingThreadPool::start(QRunnable* runnable,
+                              bool canRunWhileWaiting,
+                              int priority)
+{
+    assert(runnable);
+    WorkStealingTask task = {runnable, canRunWhileWaiting, priority};
+
+    _imp->nPendingTasks.fetchAndAddOrdered(1);
+
+    int workerIndex = _imp->getCurrentWorkerIndex();
+    if (workerIndex != -1) {
+        WorkStealingWorker* worker = _imp->workers[workerIndex];
+        QMutexLocker k(&worker->queueMutex);
+        worker->queue.push_back(task);
+    } else {
+        QMutexLocker k(&_imp->globalQueueMutex);
+
+        // Insert after the tasks with the same or a higher priority. Most tasks have the same priority so
+        // this is usually at the back.
+        WorkStealingTaskQueue::iterator it = _imp->globalQueue.end();
+        while ( it != _imp->globalQueue.begin() ) {
+            WorkStealingTaskQueue::iterator prev = it;
+            --prev;
+            if (prev->priority <= priority) {
+                break;
+            }
+            it = prev;
+        }
+        _imp->globalQueue.insert(it, task);
+    }
+    _imp->nQueuedTasks.fetchAndAddOrdered(1);
+
+    _imp->wakeIdleThread();
+}
+
+void
+WorkStealingThreadPool::releaseThread()
+{
+    _imp->nReleasedThreads.fetchAndAddOrdered(1);
+    _imp->wakeIdleThread();
+}
+
+void
+WorkStealingThreadPool::reserveThread()
+{
+    _imp->nReleasedThreads.fetchAndAddOrdered(-1);
+}
+
+bool
+WorkStealingThreadPool::runPendingTaskWhileWaiting()
+{
+    int workerIndex = _imp->getCurrentWorkerIndex();
+    if (workerIndex == -1) {
+        return false;
+    }
+    WorkStealingTask task;
+    bool stolen;
+    if ( !_imp->popTask(workerIndex, true, &task, &stolen) ) {
+        return false;
+    }
+    _imp->runTask(workerIndex, task, stolen, true);
+    _imp->onTaskDone();
+
+    return true;
+}
+
+bool
+WorkStealingThreadPool::isCurrentThreadInPool() const
+{
+    return _imp->getCurrentWorkerIndex() != -1;
+}
+
+void
+WorkStealingThreadPool::waitForDone()
+{
+    QMutexLocker k(&_imp->idleMutex);
+    while ( (int)_imp->nPendingTasks > 0 ) {
+        _imp->doneCond.wait(&_imp->idleMutex);
+    }
+}
+
+void
+WorkStealingThreadPool::getStats(Stats* stats) const
+{
+    *stats = Stats();
+    stats->nThreads = (int)_imp->nWorkers;
+    for (int i = 0; i < stats->nThreads; ++i) {
+        WorkStealingWorker* worker = _imp->workers[i];
+        QMutexLocker k(&worker->queueMutex);
+        stats->nTasksRun += worker->nTasksRun;
+        stats->nTasksStolen += worker->nTasksStolen;
+        stats->nTasksRunWhileWaiting += worker->nTasksRunWhileWaiting;
+        stats->idleTimeSeconds += worker->idleTimeSeconds;
+    }
+}
+
+void
+WorkStealingThreadPool::resetStats()
+{
+    int nThreads = (int)_imp->nWorkers;
+    for (int i = 0; i < nThreads; ++i) {
+        WorkStealingWorker* worker = _imp->workers[i];
+        QMutexLocker k(&worker->queueMutex);
+        worker->nTasksRun = 0;
+        worker->nTasksStolen = 0;
+        worker->nTasksRunWhileWaiting = 0;
+        worker->idleTimeSeconds = 0;
+    }
+}
+
 // We patched Qt to be able to derive QThreadPool to control the threads that are spawned to improve performances
 // of the EffectInstance::aborted() function
 #ifdef QT_CUSTOM_THREADPOOL
@@ -138,6 +759,14 @@ public:
     virtual bool isThreadPoolThread() const { return true; }
 
     virtual ~ThreadPoolThread() {}
+
+private:
+
+    virtual void run() OVERRIDE FINAL
+    {
+        pinCurrentThreadToNUMANodeIfEnabled();
+        QThreadPoolThread::run();
+    }
 };
 
 NATRON_NAMESPACE_ANONYMOUS_EXIT
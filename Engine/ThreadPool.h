@@ -33,6 +33,7 @@
 
 #include <QtCore/QThreadPool> // defines QT_CUSTOM_THREADPOOL (or not)
 
+#include "Global/GlobalDefines.h"
 #include "Engine/EngineFwd.h"
 
 
@@ -86,16 +87,16 @@ private:
 };
 
 /**
- * @brief Returns true if the current thread belongs to the global thread pool
+ * @brief Returns true if the current thread belongs to the global thread pool or to a WorkStealingThreadPool
  **/
 inline bool isRunningInThreadPoolThread()
 {
-#ifdef QT_CUSTOM_THREADPOOL
     AbortableThread* isAbortable = dynamic_cast<AbortableThread*>(QThread::currentThread());
-    if (!isAbortable || !isAbortable->isThreadPoolThread()) {
-        return false;
+    if (isAbortable && isAbortable->isThreadPoolThread()) {
+        return true;
     }
-    return true;
+#ifdef QT_CUSTOM_THREADPOOL
+    return false;
 #else
     // If Qt is not patched, we cannot inherit AbortableThread, hence just attempt to check if the thread object name matches one
     // of the thread pool thread
@@ -106,6 +107,15 @@ inline bool isRunningInThreadPoolThread()
 #endif
 }
 
+/**
+ * @brief When enabled, each thread of the global thread pool is pinned to the CPUs of a NUMA node when it starts,
+ * distributing the threads across the NUMA nodes of the system in a round-robin fashion. Memory that the thread
+ * accesses first is then allocated on its node. This only affects threads started afterwards, hence it is only called
+ * when the settings are loaded, before the thread pool threads are started.
+ * This has no effect if the system has a single NUMA node or if Qt is not patched to let us control the thread pool threads.
+ **/
+void setThreadPoolThreadsNUMAPinningEnabled(bool enabled);
+
 #define REPORT_CURRENT_THREAD_ACTION(actionName, node) \
     { \
         QThread* thread = QThread::currentThread(); \
@@ -115,6 +125,110 @@ inline bool isRunningInThreadPoolThread()
         } \
     } \
 
+/**
+ * @brief A thread pool where each thread has its own queue of tasks instead of a single queue shared by all threads.
+ * A task started from a thread of the pool is pushed on the queue of that thread, which runs its most recent task first
+ * (LIFO) so that its data is still in the CPU cache. A thread that has no task left steals the oldest task (FIFO) of another
+ * thread. Tasks started from other threads are appended to a global queue processed in FIFO order.
+ *
+ * As for QThreadPool, at most maxThreadCount() tasks run concurrently, except when a thread about to block calls
+ * releaseThread(). A thread waiting for a result computed by another thread may also call runPendingTaskWhileWaiting()
+ * to run tasks that can never block in the meantime.
+ *
+ * Threads of the pool are AbortableThread and isRunningInThreadPoolThread() returns true for them.
+ **/
+struct WorkStealingThreadPoolPrivate;
+class WorkStealingThreadPool
+{
+public:
+
+    struct Stats
+    {
+        // Number of threads created by the pool
+        int nThreads;
+
+        // Number of tasks that were run
+        U64 nTasksRun;
+
+        // Number of tasks run by a thread that took them from the queue of another thread
+        U64 nTasksStolen;
+
+        // Number of tasks run by a thread while it was waiting, see runPendingTaskWhileWaiting()
+        U64 nTasksRunWhileWaiting;
+
+        // Total time spent by the threads waiting for a task, in seconds
+        double idleTimeSeconds;
+
+        Stats()
+        : nThreads(0)
+        , nTasksRun(0)
+        , nTasksStolen(0)
+        , nTasksRunWhileWaiting(0)
+        , idleTimeSeconds(0)
+        {
+        }
+    };
+
+    WorkStealingThreadPool(int maxThreadCount);
+
+    /**
+     * @brief Waits for all tasks to be done and stops all threads.
+     **/
+    ~WorkStealingThreadPool();
+
+    void setMaxThreadCount(int maxThreadCount);
+
+    int maxThreadCount() const;
+
+    /**
+     * @brief Returns the number of threads currently running a task, minus the number of threads released by
+     * releaseThread(). As for QThreadPool, this may be negative.
+     **/
+    int activeThreadCount() const;
+
+    /**
+     * @brief Queues the runnable. It is deleted after running if its autoDelete() property is true.
+     * @param canRunWhileWaiting True if the runnable never waits for other tasks or for results computed by other threads,
+     * in which case it may be run by a thread calling runPendingTaskWhileWaiting().
+     * @param priority Runnables started from threads that do not belong to the pool are run by increasing priority,
+     * then in the order they were started. This is ignored for runnables started by a thread of the pool.
+     **/
+    void start(QRunnable* runnable, bool canRunWhileWaiting = false, int priority = 0);
+
+    /**
+     * @brief Same as QThreadPool::releaseThread(): lets the pool run one more task concurrently while the caller thread is
+     * blocked. Must be balanced by a call to reserveThread().
+     **/
+    void releaseThread();
+
+    void reserveThread();
+
+    /**
+     * @brief If the caller is a thread of this pool, runs one of the queued tasks that were started with canRunWhileWaiting,
+     * preferably one that the caller started itself. Returns false if no such task was found.
+     * This is meant to be called by a thread that waits for a result instead of sleeping.
+     **/
+    bool runPendingTaskWhileWaiting();
+
+    /**
+     * @brief Returns true if the caller thread belongs to this pool
+     **/
+    bool isCurrentThreadInPool() const;
+
+    /**
+     * @brief Blocks until all queued tasks have been run.
+     **/
+    void waitForDone();
+
+    void getStats(Stats* stats) const;
+
+    void resetStats();
+
+private:
+
+    boost::scoped_ptr<WorkStealingThreadPoolPrivate> _imp;
+};
+
 // We patched Qt to be able to derive QThreadPool to control the threads that are spawned to improve performances
 // of the EffectInstance::aborted() function. This is done by enabling QThreadPoolThread* to derive AbortableThread.
 #ifdef QT_CUSTOM_THREADPOOL
@@ -0,0 +1,327 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "TileCompression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "Global/GlobalDefines.h"
+
+// The first byte of the compressed data identifies how it was encoded
+#define TILE_COMPRESSION_FORMAT_STORED 0 // Raw copy of the input, used when the data does not compress
+#define TILE_COMPRESSION_FORMAT_SHUFFLE_LZ 1 // Byte planes shuffle + delta + LZ77
+
+// LZ77 parameters: matches are at least 4 bytes long and at most 64KiB behind.
+#define TILE_COMPRESSION_HASH_LOG 14
+#define TILE_COMPRESSION_MIN_MATCH 4
+#define TILE_COMPRESSION_MAX_OFFSET 65535
+
+// Do not start a match in the last bytes so that the last sequence always holds a few literals
+#define TILE_COMPRESSION_END_LITERALS 12
+
+NATRON_NAMESPACE_ENTER
+
+namespace TileCompression {
+
+static inline U32
+read32(const unsigned char* p)
+{
+    U32 v;
+    std::memcpy(&v, p, sizeof(U32));
+    return v;
+}
+
+static inline U32
+hash32(U32 v)
+{
+    return (v * 2654435761U) >> (32 - TILE_COMPRESSION_HASH_LOG);
+}
+
+// Group bytes of same significance together and delta code each plane
+static void
+shuffleAndDelta(const unsigned char* src, std::size_t nBytes, int elementSize, unsigned char* dst)
+{
+    const std::size_t nElements = nBytes / elementSize;
+    for (int p = 0; p < elementSize; ++p) {
+        unsigned char* plane = dst + p * nElements;
+        const unsigned char* s = src + p;
+        unsigned char prev = 0;
+        for (std::size_t i = 0; i < nElements; ++i, s += elementSize) {
+            plane[i] = (unsigned char)(*s - prev);
+            prev = *s;
+        }
+    }
+}
+
+static void
+unDeltaAndUnShuffle(const unsigned char* src, std::size_t nBytes, int elementSize, unsigned char* dst)
+{
+    const std::size_t nElements = nBytes / elementSize;
+    for (int p = 0; p < elementSize; ++p) {
+        const unsigned char* plane = src + p * nElements;
+        unsigned char* d = dst + p;
+        unsigned char prev = 0;
+        for (std::size_t i = 0; i < nElements; ++i, d += elementSize) {
+            prev = (unsigned char)(prev + plane[i]);
+            *d = prev;
+        }
+    }
+}
+
+// Writes a length that did not fit in a token nibble: a sequence of 255 terminated by a byte < 255
+static inline bool
+writeLength(std::size_t len, unsigned char** op, const unsigned char* oend)
+{
+    while (len >= 255) {
+        if (*op >= oend) {
+            return false;
+        }
+        *(*op)++ = 255;
+        len -= 255;
+    }
+    if (*op >= oend) {
+        return false;
+    }
+    *(*op)++ = (unsigned char)len;
+    return true;
+}
+
+static inline bool
+readLength(const unsigned char** ip, const unsigned char* iend, std::size_t* len)
+{
+    unsigned char b;
+    do {
+        if (*ip >= iend) {
+            return false;
+        }
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return true;
+}
+
+// Emits a token, the literals and optionnally the match. A matchLen of 0 means there is no match (last sequence)
+static bool
+writeSequence(const unsigned char* literals, std::size_t litLen, std::size_t offset, std::size_t matchLen, unsigned char** op, const unsigned char* oend)
+{
+    if (*op >= oend) {
+        return false;
+    }
+    unsigned char* token = (*op)++;
+    std::size_t matchCode = matchLen ? matchLen - TILE_COMPRESSION_MIN_MATCH : 0;
+    *token = (unsigned char)( ( (litLen < 15 ? litLen : 15) << 4 ) | (matchCode < 15 ? matchCode : 15) );
+    if ( (litLen >= 15) && !writeLength(litLen - 15, op, oend) ) {
+        return false;
+    }
+    if ( (std::size_t)(oend - *op) < litLen ) {
+        return false;
+    }
+    std::memcpy(*op, literals, litLen);
+    *op += litLen;
+    if (!matchLen) {
+        return true;
+    }
+    if (oend - *op < 2) {
+        return false;
+    }
+    *(*op)++ = (unsigned char)(offset & 0xff);
+    *(*op)++ = (unsigned char)(offset >> 8);
+    if ( (matchCode >= 15) && !writeLength(matchCode - 15, op, oend) ) {
+        return false;
+    }
+    return true;
+}
+
+static std::size_t
+compressLZ(const unsigned char* in, std::size_t n, unsigned char* out, std::size_t outCapacity)
+{
+    unsigned char* op = out;
+    const unsigned char* oend = out + outCapacity;
+
+    std::size_t anchor = 0;
+    if (n > TILE_COMPRESSION_END_LITERALS) {
+        std::vector<U32> table(1 << TILE_COMPRESSION_HASH_LOG, 0);
+        const std::size_t matchLimit = n - TILE_COMPRESSION_END_LITERALS;
+        std::size_t ip = 1;
+        while (ip < matchLimit) {
+            U32 seq = read32(in + ip);
+            U32 h = hash32(seq);
+            std::size_t ref = table[h];
+            table[h] = (U32)ip;
+            if ( (ref < ip) && (ip - ref <= TILE_COMPRESSION_MAX_OFFSET) && (read32(in + ref) == seq) ) {
+                std::size_t len = TILE_COMPRESSION_MIN_MATCH;
+                while ( (ip + len < matchLimit) && (in[ref + len] == in[ip + len]) ) {
+                    ++len;
+                }
+                if ( !writeSequence(in + anchor, ip - anchor, ip - ref, len, &op, oend) ) {
+                    return 0;
+                }
+                ip += len;
+                anchor = ip;
+                if (ip < matchLimit) {
+                    table[hash32( read32(in + ip - 2) )] = (U32)(ip - 2);
+                }
+            } else {
+                // Skip faster over data that does not compress
+                ip += 1 + ( (ip - anchor) >> 6 );
+            }
+        }
+    }
+    if ( !writeSequence(in + anchor, n - anchor, 0, 0, &op, oend) ) {
+        return 0;
+    }
+    return op - out;
+} // compressLZ
+
+static bool
+decompressLZ(const unsigned char* in, std::size_t inSize, unsigned char* out, std::size_t n)
+{
+    const unsigned char* ip = in;
+    const unsigned char* iend = in + inSize;
+    std::size_t op = 0;
+
+    while (ip < iend) {
+        unsigned char token = *ip++;
+
+        std::size_t litLen = token >> 4;
+        if ( (litLen == 15) && !readLength(&ip, iend, &litLen) ) {
+            return false;
+        }
+        if ( ( (std::size_t)(iend - ip) < litLen ) || (n - op < litLen) ) {
+            return false;
+        }
+        std::memcpy(out + op, ip, litLen);
+        ip += litLen;
+        op += litLen;
+
+        if (ip == iend) {
+            // The last sequence has no match
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        std::size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if ( (offset == 0) || (offset > op) ) {
+            return false;
+        }
+        std::size_t matchLen = token & 15;
+        if ( (matchLen == 15) && !readLength(&ip, iend, &matchLen) ) {
+            return false;
+        }
+        matchLen += TILE_COMPRESSION_MIN_MATCH;
+        if (n - op < matchLen) {
+            return false;
+        }
+        // The match may overlap the output, copy byte per byte
+        const unsigned char* match = out + op - offset;
+        unsigned char* dst = out + op;
+        for (std::size_t i = 0; i < matchLen; ++i) {
+            dst[i] = match[i];
+        }
+        op += matchLen;
+    }
+    return op == n;
+} // decompressLZ
+
+std::size_t
+getCompressBound(std::size_t nBytes)
+{
+    // Format byte + worst case of a single literal run
+    return 1 + nBytes + nBytes / 255 + 16;
+}
+
+std::size_t
+compress(const void* src, std::size_t nBytes, int elementSize, void* dst, std::size_t dstCapacity)
+{
+    if (elementSize < 1 || nBytes % elementSize != 0) {
+        elementSize = 1;
+    }
+    if (dstCapacity < 1) {
+        return 0;
+    }
+    unsigned char* out = (unsigned char*)dst;
+
+    std::vector<unsigned char> shuffled(nBytes);
+    if (nBytes) {
+        shuffleAndDelta((const unsigned char*)src, nBytes, elementSize, &shuffled[0]);
+    }
+
+    // Do not bother keeping the compressed data if it is larger than the input
+    std::size_t lzCapacity = std::min(dstCapacity - 1, nBytes);
+    std::size_t lzSize = nBytes ? compressLZ(&shuffled[0], nBytes, out + 1, lzCapacity) : 0;
+    if (lzSize > 0) {
+        out[0] = TILE_COMPRESSION_FORMAT_SHUFFLE_LZ;
+        return 1 + lzSize;
+    }
+
+    if (dstCapacity < nBytes + 1) {
+        return 0;
+    }
+    out[0] = TILE_COMPRESSION_FORMAT_STORED;
+    if (nBytes) {
+        std::memcpy(out + 1, src, nBytes);
+    }
+    return 1 + nBytes;
+} // compress
+
+bool
+decompress(const void* src, std::size_t compressedBytes, int elementSize, void* dst, std::size_t nBytes)
+{
+    if (elementSize < 1 || nBytes % elementSize != 0) {
+        elementSize = 1;
+    }
+    if (compressedBytes < 1) {
+        return false;
+    }
+    const unsigned char* in = (const unsigned char*)src;
+    switch (in[0]) {
+    case TILE_COMPRESSION_FORMAT_STORED:
+        if (compressedBytes - 1 != nBytes) {
+            return false;
+        }
+        if (nBytes) {
+            std::memcpy(dst, in + 1, nBytes);
+        }
+        return true;
+    case TILE_COMPRESSION_FORMAT_SHUFFLE_LZ: {
+        std::vector<unsigned char> shuffled(nBytes);
+        if ( !nBytes || !decompressLZ(in + 1, compressedBytes - 1, &shuffled[0], nBytes) ) {
+            return false;
+        }
+        unDeltaAndUnShuffle(&shuffled[0], nBytes, elementSize, (unsigned char*)dst);
+        return true;
+    }
+    default:
+        return false;
+    }
+} // decompress
+
+} // namespace TileCompression
+
+NATRON_NAMESPACE_EXIT
@@ -0,0 +1,71 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_TILECOMPRESSION_H
+#define NATRON_ENGINE_TILECOMPRESSION_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <cstddef>
+
+#include "Engine/EngineFwd.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Fast lossless compression of cache tiles.
+ * The tile is first split in byte planes: the bytes of same significance of each element are grouped together
+ * (e.g: for float data, all the exponent bytes end up next to each other), then each plane is delta coded and
+ * the result is compressed with a LZ77 byte-oriented codec.
+ * The element size is only a hint: any element size yields a lossless round-trip as long as the same value is
+ * passed to compress() and decompress().
+ **/
+namespace TileCompression {
+
+/**
+ * @brief Returns the maximum number of bytes that compress() may need in output for nBytes of input.
+ **/
+std::size_t getCompressBound(std::size_t nBytes);
+
+/**
+ * @brief Compresses nBytes bytes from src to dst.
+ * @param elementSize The size in bytes of one element of the data (1, 2 or 4). nBytes must be a multiple of it.
+ * @param dstCapacity The number of bytes available in dst. Must be at least getCompressBound(nBytes) to
+ * be guaranteed to succeed.
+ * @returns The number of bytes written to dst, or 0 if the output did not fit in dstCapacity.
+ **/
+std::size_t compress(const void* src, std::size_t nBytes, int elementSize, void* dst, std::size_t dstCapacity);
+
+/**
+ * @brief Decompresses data produced by compress() with the same elementSize.
+ * @param nBytes The number of bytes that were compressed, dst must have room for them.
+ * @returns True if the data could be decoded to exactly nBytes, false if it is corrupted.
+ **/
+bool decompress(const void* src, std::size_t compressedBytes, int elementSize, void* dst, std::size_t nBytes);
+
+} // namespace TileCompression
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_TILECOMPRESSION_H
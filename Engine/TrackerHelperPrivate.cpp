@@ -25,12 +25,14 @@
 #include "TrackerHelperPrivate.h"
 
 #include <sstream> // stringstream
-#include <QtCore/QThreadPool>
+#include <QtCore/QThread>
 #include <QDebug>
 
 #include "Engine/AppInstance.h"
+#include "Engine/AppManager.h"
 #include "Engine/Curve.h"
 #include "Engine/Project.h"
+#include "Engine/ThreadPool.h"
 #include "Engine/TimeLine.h"
 #include "Engine/KnobTypes.h"
 #include "Engine/Image.h"
@@ -444,7 +446,7 @@ TrackerHelperPrivate::trackStepLibMV(int trackIndex,
 
 #ifdef CERES_USE_OPENMP
         // Set the number of threads Ceres may use
-        QThreadPool* tp = QThreadPool::globalInstance();
+        WorkStealingThreadPool* tp = appPTR->getRenderThreadPool();
 
         // Allocate max threads for tracking and reserve them from the thread pool
         int nOmpThreads = tp->maxThreadCount() - tp->activeThreadCount() + 1;
@@ -25,6 +25,7 @@
 
 #include "TreeRender.h"
 
+#include <algorithm>
 #include <set>
 #include <QtCore/QThread>
 #include <QMutex>
@@ -32,6 +33,7 @@
 #include <QDebug>
 #include <QWaitCondition>
 
+#include "Engine/Cache.h"
 #include "Engine/Image.h"
 #include "Engine/EffectInstance.h"
 #include "Engine/FrameViewRequest.h"
@@ -39,6 +41,8 @@
 #include "Engine/GroupInput.h"
 #include "Engine/Node.h"
 #include "Engine/NodeGroup.h"
+#include "Engine/RenderTaskScheduling.h"
+#include "Engine/RenderTracer.h"
 #include "Engine/RotoStrokeItem.h"
 #include "Engine/Settings.h"
 #include "Engine/Timer.h"
@@ -48,6 +52,10 @@
 
 //#define TRACE_RENDER_DEPENDENCIES
 
+// In tile streaming mode, number of groups of tiles in the RoI of the tree root per render thread.
+// More groups than threads lets the first groups finish early.
+#define NATRON_TILE_STREAMING_GROUPS_PER_THREAD 4
+
 NATRON_NAMESPACE_ENTER
 
 typedef std::set<AbortableThread*> ThreadSet;
@@ -100,10 +108,28 @@ struct TreeRenderPrivate
     // Are we aborted ?
     QAtomicInt aborted;
 
+    // Started when the render is created, to measure the time to first pixel
+    TimeLapse creationTimer;
+
+    // Set to 1 by the first call to notifyFirstPixelRendered()
+    QAtomicInt firstPixelRendered;
+
+    // Protected by stateMutex
+    double timeToFirstPixel;
+
+    // @see addCachedTilesSize. Protected by stateMutex
+    U64 cachedTilesSize;
+
 
     bool handleNaNs;
     bool useConcatenations;
 
+    // The render that created this one with createTileGroupRender()
+    TreeRenderWPtr parentRender;
+
+    // Renders created with createTileGroupRender(), protected by stateMutex
+    std::list<TreeRenderWPtr> tileGroupRenders;
+
 
     TreeRenderPrivate(TreeRender* publicInterface)
     : _publicInterface(publicInterface)
@@ -120,8 +146,14 @@ struct TreeRenderPrivate
     , openGLContext()
     , cpuOpenGLContext()
     , aborted()
+    , creationTimer()
+    , firstPixelRendered()
+    , timeToFirstPixel(-1.)
+    , cachedTilesSize(0)
     , handleNaNs(true)
     , useConcatenations(true)
+    , parentRender()
+    , tileGroupRenders()
     {
         aborted.fetchAndStoreAcquire(0);
 
@@ -172,6 +204,7 @@ TreeRender::CtorArgs::CtorArgs()
 , playback(false)
 , byPassCache(false)
 , preventConcurrentTreeRenders(false)
+, priority(eRenderPriorityInteractive)
 {
 
 }
@@ -263,6 +296,18 @@ void
 TreeRender::setRenderAborted()
 {
     _imp->aborted.fetchAndAddAcquire(1);
+
+    std::list<TreeRenderWPtr> tileGroupRenders;
+    {
+        QMutexLocker k(&_imp->stateMutex);
+        tileGroupRenders = _imp->tileGroupRenders;
+    }
+    for (std::list<TreeRenderWPtr>::const_iterator it = tileGroupRenders.begin(); it != tileGroupRenders.end(); ++it) {
+        TreeRenderPtr render = it->lock();
+        if (render) {
+            render->setRenderAborted();
+        }
+    }
 }
 
 bool
@@ -271,6 +316,57 @@ TreeRender::isPlayback() const
     return _imp->ctorArgs->playback;
 }
 
+RenderPriorityEnum
+TreeRender::getPriority() const
+{
+    return _imp->ctorArgs->priority;
+}
+
+double
+TreeRender::getTimeToFirstPixel() const
+{
+    QMutexLocker k(&_imp->stateMutex);
+    return _imp->timeToFirstPixel;
+}
+
+void
+TreeRender::notifyFirstPixelRendered()
+{
+    if ( !_imp->firstPixelRendered.testAndSetOrdered(0, 1) ) {
+        return;
+    }
+    {
+        QMutexLocker k(&_imp->stateMutex);
+        _imp->timeToFirstPixel = _imp->creationTimer.getTimeSinceCreation();
+    }
+
+    // The tiles of a group are the first pixels of the render that created it
+    TreeRenderPtr parent = _imp->parentRender.lock();
+    if (parent) {
+        parent->notifyFirstPixelRendered();
+    }
+}
+
+void
+TreeRender::addCachedTilesSize(std::size_t nBytes)
+{
+    {
+        QMutexLocker k(&_imp->stateMutex);
+        _imp->cachedTilesSize += nBytes;
+    }
+
+    TreeRenderPtr parent = _imp->parentRender.lock();
+    if (parent) {
+        parent->addCachedTilesSize(nBytes);
+    }
+}
+
+U64
+TreeRender::getCachedTilesSize() const
+{
+    QMutexLocker k(&_imp->stateMutex);
+    return _imp->cachedTilesSize;
+}
 
 bool
 TreeRender::isDraftRender() const
@@ -572,6 +668,10 @@ struct TreeRenderExecutionDataPrivate
     // instead. See discussion in @FrameViewRequest: this is to overcome thread-safety for host frame-threading effects.
     bool createTreeRenderIfUnrenderedImage;
 
+    // For each request, the estimated time needed to render it and the requests that depend on it, along the longest
+    // path to the output request. Computed lazily, protected by dependencyFreeRendersMutex
+    std::map<FrameViewRequestWPtr, double> remainingPathCost;
+
     TreeRenderExecutionDataPrivate(TreeRenderExecutionData* publicInterface, bool createTreeRenderIfUnrenderedImage)
     : _publicInterface(publicInterface)
     , isMainExecutionOfTree(false)
@@ -584,6 +684,7 @@ struct TreeRenderExecutionDataPrivate
     , outputRequest()
     , launchedRunnables()
     , createTreeRenderIfUnrenderedImage(createTreeRenderIfUnrenderedImage)
+    , remainingPathCost()
     {
         
     }
@@ -592,6 +693,10 @@ struct TreeRenderExecutionDataPrivate
 
     void removeDependencyLinkFromRequest(const FrameViewRequestPtr& request);
 
+    double getRemainingPathCost_nolock(const FrameViewRequestPtr& request);
+
+    DependencyFreeRenderSet::iterator getMostCriticalTask_nolock();
+
 
 };
 
@@ -677,6 +782,69 @@ TreeRenderExecutionDataPrivate::removeDependencyLinkFromRequest(const FrameViewR
 
 }
 
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// The cost assumed for a node that was never rendered: when nothing is known, the longest path
+// is the one with the most nodes to render.
+static const double kUnknownRenderTimeEstimate = 1e-3;
+
+static double
+getEstimatedRequestRenderTime(const FrameViewRequestPtr& request)
+{
+    if (request->getStatus() != FrameViewRequest::eFrameViewRequestStatusNotRendered) {
+        // Pass-through or already cached
+        return 0.;
+    }
+    EffectInstancePtr effect = request->getEffect();
+    NodePtr node;
+    if (effect) {
+        node = effect->getNode();
+    }
+    double estimate = node ? node->getEstimatedRenderTime() : 0.;
+    return estimate > 0. ? estimate : kUnknownRenderTimeEstimate;
+}
+
+// The requests of an execution, as seen by the RenderTaskScheduling functions
+class FrameViewRequestGraph
+{
+    TreeRenderExecutionDataPtr _execution;
+
+public:
+
+    FrameViewRequestGraph(const TreeRenderExecutionDataPtr& execution)
+    : _execution(execution)
+    {
+    }
+
+    double getEstimatedRenderTime(const FrameViewRequestPtr& request) const
+    {
+        return getEstimatedRequestRenderTime(request);
+    }
+
+    void getListeners(const FrameViewRequestPtr& request, std::list<FrameViewRequestPtr>* listeners) const
+    {
+        *listeners = request->getListeners(_execution);
+    }
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+double
+TreeRenderExecutionDataPrivate::getRemainingPathCost_nolock(const FrameViewRequestPtr& request)
+{
+    assert(!dependencyFreeRendersMutex.tryLock());
+
+    return RenderTaskScheduling::getRemainingPathCost(FrameViewRequestGraph( _publicInterface->shared_from_this() ), request, &remainingPathCost);
+}
+
+DependencyFreeRenderSet::iterator
+TreeRenderExecutionDataPrivate::getMostCriticalTask_nolock()
+{
+    assert(!dependencyFreeRendersMutex.tryLock());
+
+    return RenderTaskScheduling::getMostCriticalTask(FrameViewRequestGraph( _publicInterface->shared_from_this() ), dependencyFreeRenders->begin(), dependencyFreeRenders->end(), &remainingPathCost);
+}
+
 void
 TreeRenderExecutionDataPrivate::onTaskFinished(const FrameViewRequestPtr& request, ActionRetCodeEnum requestStatus)
 {
@@ -747,6 +915,10 @@ FrameViewRenderRunnable::run()
 
     TreeRenderExecutionDataPtr sharedData = _imp->sharedData.lock();
 
+    if ( isRunningInThreadPoolThread() ) {
+        appPTR->getTasksQueueManager()->notifyTaskInRenderStarted(sharedData);
+    }
+
     // Check the status of the execution tasks because another concurrent render might have failed
     ActionRetCodeEnum stat = sharedData->getStatus();
 
@@ -755,7 +927,16 @@ FrameViewRenderRunnable::run()
         qDebug() << sharedData.get() << "Launching render of" << renderClone->getScriptName_mt_safe().c_str() << request->getPlaneDesc().getPlaneLabel().c_str();
 #endif
         EffectInstancePtr renderClone = _imp->request->getEffect();
+
+        NATRON_RENDER_TRACE_SCOPE_DETAIL("task", "Render", renderClone->getScriptName_mt_safe() + " " + _imp->request->getPlaneDesc().getPlaneLabel());
+
+        // Time the renders that actually process images to estimate the cost of the node for the scheduler
+        const bool mustRender = _imp->request->getStatus() == FrameViewRequest::eFrameViewRequestStatusNotRendered;
+        TimeLapse timeRecorder;
         stat = renderClone->launchNodeRender(sharedData, _imp->request);
+        if (mustRender && stat == eActionStatusOK) {
+            renderClone->getNode()->addRenderTimeSample( timeRecorder.getTimeSinceCreation() );
+        }
     }
 
     sharedData->_imp->onTaskFinished(_imp->request, stat);
@@ -861,6 +1042,176 @@ TreeRender::createMainExecutionData()
     return _imp->createExecutionDataInternal(true /*removeRenderClonesWhenFinished*/, _imp->ctorArgs->treeRootEffect, _imp->ctorArgs->time, _imp->ctorArgs->view, _imp->ctorArgs->proxyScale, _imp->ctorArgs->mipMapLevel, _imp->ctorArgs->plane.getNumComponents() == 0 ? 0 : &_imp->ctorArgs->plane, _imp->ctorArgs->canonicalRoI.isNull() ? 0 : &_imp->ctorArgs->canonicalRoI, concatenationFlags, false);
 }
 
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// Returns false if a node upstream of effect does not support tiles or does not cache its output.
+// Group nodes are walked through their output node and GroupInput nodes through the input of their group.
+static bool
+canStreamTilesOfUpstreamNodes(const EffectInstancePtr& effect,
+                              std::set<EffectInstancePtr>* visited)
+{
+    NodeGroupPtr isGroup = toNodeGroup(effect);
+    std::vector<EffectInstancePtr> inputs;
+    if (isGroup) {
+        NodePtr outputNodeInput = isGroup->getOutputNodeInput();
+        if (outputNodeInput) {
+            inputs.push_back( outputNodeInput->getEffectInstance() );
+        }
+    } else {
+        int nInputs = effect->getNInputs();
+        for (int i = 0; i < nInputs; ++i) {
+            EffectInstancePtr input = effect->getInputMainInstance(i);
+            if (input) {
+                inputs.push_back(input);
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        EffectInstancePtr input = inputs[i];
+        if ( dynamic_cast<GroupInput*>( input.get() ) ) {
+            NodeGroupPtr enclosingNodeGroup = toNodeGroup( input->getNode()->getGroup() );
+            NodePtr realInput = enclosingNodeGroup ? enclosingNodeGroup->getRealInputForInput( input->getNode() ) : NodePtr();
+            if (!realInput) {
+                continue;
+            }
+            input = realInput->getEffectInstance();
+        }
+        if ( !visited->insert(input).second ) {
+            continue;
+        }
+        if ( !toNodeGroup(input) ) {
+            const bool isFrameVaryingOrAnimated = input->isFrameVarying() || input->getHasAnimation();
+            if ( !input->supportsTiles() || !input->shouldCacheOutput(isFrameVaryingOrAnimated, 1) ) {
+                return false;
+            }
+        }
+        if ( !canStreamTilesOfUpstreamNodes(input, visited) ) {
+            return false;
+        }
+    }
+
+    return true;
+} // canStreamTilesOfUpstreamNodes
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+bool
+TreeRender::getStreamingTileGroups(std::vector<RectD>* tileGroups)
+{
+    tileGroups->clear();
+
+    SettingsPtr settings = appPTR->getCurrentSettings();
+    if ( !settings || !settings->isTileStreamingEnabled() || isFailureRetCode( getStatus() ) ) {
+        return false;
+    }
+
+    // Renders that need images of other nodes than the tree root, that must not run concurrently or that
+    // render on the GPU are rendered as a whole
+    const CtorArgsPtr& args = _imp->ctorArgs;
+    if ( isTileGroupRender() || !args->extraNodesToSample.empty() || args->activeRotoDrawableItem || args->preventConcurrentTreeRenders ||
+         args->byPassCache || getGPUOpenGLContext() ) {
+        return false;
+    }
+
+    // The main execution gathers the tiles of the tree root from the cache: it must be cached and support tiles.
+    // Each group renders on its own thread, so the tree root must also be safe to render concurrently.
+    EffectInstancePtr treeRoot = args->treeRootEffect;
+    RenderSafetyEnum safety = treeRoot->getRenderThreadSafety();
+    if ( !treeRoot->supportsTiles() || treeRoot->isWriter() || treeRoot->isAccumulationEnabled() ||
+         ( (safety != eRenderSafetyFullySafe) && (safety != eRenderSafetyFullySafeFrame) ) ) {
+        return false;
+    }
+
+    // Each group renders the part of the tree upstream that it needs: the nodes upstream must also support tiles and
+    // cache their output, otherwise the parts shared by the groups would be rendered once per group.
+    {
+        std::set<EffectInstancePtr> visited;
+        if ( !canStreamTilesOfUpstreamNodes(treeRoot, &visited) ) {
+            return false;
+        }
+    }
+
+    EffectInstancePtr rootRenderClone;
+    {
+        FrameViewRenderKey key = {args->time, args->view, shared_from_this()};
+        rootRenderClone = toEffectInstance( treeRoot->createRenderClone(key) );
+    }
+
+    const RenderScale combinedScale = EffectInstance::getCombinedScale(args->mipMapLevel, args->proxyScale);
+    RectD canonicalRoI = args->canonicalRoI;
+    if ( canonicalRoI.isNull() ) {
+        ActionRetCodeEnum stat = TreeRenderPrivate::getTreeRootRoD(rootRenderClone, args->time, args->view, combinedScale, &canonicalRoI);
+        if ( isFailureRetCode(stat) || canonicalRoI.isNull() ) {
+            return false;
+        }
+    }
+
+    // Split the RoI in bands of whole rows of tiles
+    const double par = rootRenderClone->getAspectRatio(-1);
+    RectI pixelRoI;
+    canonicalRoI.toPixelEnclosing(combinedScale, par, &pixelRoI);
+    int tileSizeX, tileSizeY;
+    CacheBase::getTileSizePx(rootRenderClone->getBitDepth(-1), &tileSizeX, &tileSizeY);
+    RectI tiledRoI = pixelRoI;
+    tiledRoI.roundToTileSize(tileSizeX, tileSizeY);
+
+    const int nTileRows = tiledRoI.height() / tileSizeY;
+    const int nThreads = appPTR->getRenderThreadPool()->maxThreadCount();
+    const int nGroups = std::min(nTileRows, NATRON_TILE_STREAMING_GROUPS_PER_THREAD * nThreads);
+    if (nGroups < 2) {
+        return false;
+    }
+    const int groupHeight = ( (nTileRows + nGroups - 1) / nGroups ) * tileSizeY;
+
+    for (int y = tiledRoI.y1; y < tiledRoI.y2; y += groupHeight) {
+        RectI group(tiledRoI.x1, y, tiledRoI.x2, std::min(y + groupHeight, tiledRoI.y2));
+        if ( !group.intersect(pixelRoI, &group) ) {
+            continue;
+        }
+        RectD groupCanonical;
+        group.toCanonical(combinedScale, par, canonicalRoI, &groupCanonical);
+        tileGroups->push_back(groupCanonical);
+    }
+
+    return tileGroups->size() > 1;
+} // getStreamingTileGroups
+
+TreeRenderPtr
+TreeRender::createTileGroupRender(const RectD& canonicalRoI)
+{
+    CtorArgsPtr args( new CtorArgs(*_imp->ctorArgs) );
+
+    // The render is launched on behalf of the tree root so that the provider of this render is not notified about it
+    args->provider = args->treeRootEffect;
+    args->canonicalRoI = canonicalRoI;
+
+    TreeRenderPtr render = TreeRender::create(args);
+    render->_imp->parentRender = shared_from_this();
+    {
+        QMutexLocker k(&_imp->stateMutex);
+        _imp->tileGroupRenders.push_back(render);
+    }
+    if ( isRenderAborted() ) {
+        render->setRenderAborted();
+    }
+
+    return render;
+} // createTileGroupRender
+
+int
+TreeRender::getTileGroupRendersCount() const
+{
+    QMutexLocker k(&_imp->stateMutex);
+    return (int)_imp->tileGroupRenders.size();
+}
+
+bool
+TreeRender::isTileGroupRender() const
+{
+    return bool( _imp->parentRender.lock() );
+}
+
 std::list<TreeRenderExecutionDataPtr>
 TreeRender::getExtraRequestedResultsExecutionData()
 {
@@ -892,17 +1243,31 @@ TreeRender::getStatus() const
 }
 
 
+double
+TreeRenderExecutionData::getMostCriticalTaskCost()
+{
+    QMutexLocker k(&_imp->dependencyFreeRendersMutex);
+
+    if ( !_imp->dependencyFreeRenders || _imp->dependencyFreeRenders->empty() ) {
+        return -1.;
+    }
+    return _imp->getRemainingPathCost_nolock( *_imp->getMostCriticalTask_nolock() );
+}
+
 int
-TreeRenderExecutionData::executeAvailableTasks(int nTasksToLaunch)
+TreeRenderExecutionData::executeAvailableTasks(int nTasksToLaunch, bool criticalPathFirst)
 {
 
     assert(nTasksToLaunch != 0);
 
-    QThreadPool* threadPool = QThreadPool::globalInstance();
+    WorkStealingThreadPool* threadPool = appPTR->getRenderThreadPool();
+    TreeRenderQueueManagerPtr manager = appPTR->getTasksQueueManager();
 
     int nTasksRemaining = nTasksToLaunch;
 
     TreeRenderExecutionDataPtr thisShared = shared_from_this();
+    TreeRenderPtr render = getTreeRender();
+    RenderPriorityEnum priority = render ? render->getPriority() : eRenderPriorityInteractive;
 
     QMutexLocker k(&_imp->dependencyFreeRendersMutex);
 
@@ -915,8 +1280,9 @@ TreeRenderExecutionData::executeAvailableTasks(int nTasksToLaunch)
     // Launch all dependency-free tasks in parallel
     while ((nTasksRemaining == -1 || nTasksRemaining > 0) && _imp->dependencyFreeRenders->size() > 0) {
 
-        FrameViewRequestPtr request = *_imp->dependencyFreeRenders->begin();
-        _imp->dependencyFreeRenders->erase(_imp->dependencyFreeRenders->begin());
+        DependencyFreeRenderSet::iterator toLaunch = criticalPathFirst ? _imp->getMostCriticalTask_nolock() : _imp->dependencyFreeRenders->begin();
+        FrameViewRequestPtr request = *toLaunch;
+        _imp->dependencyFreeRenders->erase(toLaunch);
 #ifdef TRACE_RENDER_DEPENDENCIES
         qDebug() << this <<  "Queuing " << request->getEffect()->getScriptName_mt_safe().c_str() << " in task pool";
 #endif
@@ -926,7 +1292,8 @@ TreeRenderExecutionData::executeAvailableTasks(int nTasksToLaunch)
             // Only launch the runnable in a separate thread if its actually going to do any rendering.
             runnable->setAutoDelete(false);
             _imp->launchedRunnables.insert(runnable);
-            threadPool->start(runnable.get());
+            manager->notifyTaskInRenderQueued(thisShared);
+            threadPool->start(runnable.get(), false, (int)priority);
 
             --nTasksRemaining;
             ++nTasksStarted;
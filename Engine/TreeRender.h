@@ -28,6 +28,7 @@
 #include "Global/Macros.h"
 
 #include <map>
+#include <vector>
 
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/scoped_ptr.hpp>
@@ -93,9 +94,18 @@ public:
      * @brief Starts tasks that are available for rendering and queue them in the thread pool
      * @param launchAllTasksPossible A boolean indicating how many tasks to start. If -1 is passed, all available tasks
      * should be started.
+     * @param criticalPathFirst If true, tasks are started in decreasing order of getMostCriticalTaskCost() instead
+     * of an arbitrary order, so that the longest branches of the graph get a thread first.
      * @returns The number of parallel tasks that were queued.
      **/
-    int executeAvailableTasks(int nTasksToLaunch);
+    int executeAvailableTasks(int nTasksToLaunch, bool criticalPathFirst = false);
+
+    /**
+     * @brief Returns the estimated time needed to render the available task that is on the longest path
+     * to the output of the tree, including all tasks downstream on that path, or -1 if no task is available.
+     * Costs are estimated from the previous render times of each node, see Node::getEstimatedRenderTime().
+     **/
+    double getMostCriticalTaskCost();
 
 private:
 
@@ -218,6 +228,11 @@ public:
         // mouse move event renders are processed in order.
         bool preventConcurrentTreeRenders;
 
+        // The priority class of the render: the TreeRenderQueueManager schedules the tasks of a render
+        // before those of the renders with a lower priority and may pause the latter at tile boundaries
+        // to let it start sooner. Sub-renders should use the priority of their parent render.
+        RenderPriorityEnum priority;
+
         CtorArgs();
     };
 
@@ -295,6 +310,44 @@ public:
      **/
     bool isPlayback() const;
 
+    /**
+     * @brief Returns the priority passed in the CtorArgs
+     **/
+    RenderPriorityEnum getPriority() const;
+
+    /**
+     * @brief Returns the time in seconds between the creation of the render and the first tile of the tree root
+     * that was rendered, or the end of the render if all the tree root was cached. Returns -1 if none of them happened yet.
+     **/
+    double getTimeToFirstPixel() const;
+
+    /**
+     * @brief Called when a tile of the tree root or the whole render is done: the first call sets the time returned
+     * by getTimeToFirstPixel().
+     **/
+    void notifyFirstPixelRendered();
+
+    /**
+     * @brief Called when tiles rendered by this render are allocated in the tile cache. The size is also
+     * added to the render that created this one with createTileGroupRender().
+     **/
+    void addCachedTilesSize(std::size_t nBytes);
+
+    /**
+     * @brief Returns the number of bytes of tiles this render allocated in the tile cache so far.
+     **/
+    U64 getCachedTilesSize() const;
+
+    /**
+     * @brief Returns the number of renders this render created to stream the tiles of the tree root, @see getStreamingTileGroups.
+     **/
+    int getTileGroupRendersCount() const;
+
+    /**
+     * @brief Returns true if this render was created by createTileGroupRender()
+     **/
+    bool isTileGroupRender() const;
+
     /**
      * @brief Returns whether this render is a bad quality render (typically used when scrubbing a slider or the timeline) or normal quality render
      **/
@@ -377,6 +430,19 @@ private:
      **/
     TreeRenderExecutionDataPtr createMainExecutionData();
 
+    /**
+     * @brief When tile streaming is enabled in the settings, returns in tileGroups the portions of the RoI of the tree root, in canonical
+     * coordinates, that are rendered first each by its own render created with createTileGroupRender(), so that the nodes downstream of
+     * a group of tiles do not wait for the whole RoI of the nodes upstream. The main execution then gathers the tiles from the cache.
+     * Returns false if the RoI is rendered as a whole, e.g: if the tree root or a node upstream does not support tiles or is not cached.
+     **/
+    bool getStreamingTileGroups(std::vector<RectD>* tileGroups);
+
+    /**
+     * @brief Creates a render of the given portion of the RoI with the same arguments as this render. Aborting this render aborts it too.
+     **/
+    TreeRenderPtr createTileGroupRender(const RectD& canonicalRoI);
+
     /**
      * @brief Create execution data for a sub-execution of the tree render: this is used in the implementation of getImagePlane to re-use the same render clones
      * for the same TreeRender.
@@ -26,19 +26,62 @@
 
 #include "TreeRenderQueueManager.h"
 
+#include <algorithm>
+#include <vector>
+
 #include <QMutex>
 #include <QWaitCondition>
 #include <QThreadPool>
+#include <QtCore/QThreadStorage>
 
 #include <QtConcurrentRun>
 
 #include "Engine/AppManager.h"
 #include "Engine/FrameViewRequest.h"
+#include "Engine/Settings.h"
 #include "Engine/TreeRender.h"
 #include "Engine/ThreadPool.h"
 
+//#define TRACE_TIME_TO_FIRST_PIXEL
+
 NATRON_NAMESPACE_ENTER;
 
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// Number of values in RenderPriorityEnum
+static const int kNumRenderPriorities = (int)eRenderPriorityPrefetch + 1;
+
+// The priorities of the render tasks running on a thread, the most recent last: a thread waiting in a task may run
+// other tasks of the thread pool
+struct ThreadRunningTaskPriorities
+{
+    std::vector<RenderPriorityEnum> priorities;
+};
+
+// While paused by pauseIfPreempted(), a thread wakes up at this interval to check whether its render was aborted
+static const unsigned long kPreemptionAbortCheckIntervalMS = 100;
+
+struct TimeToFirstPixelAccumulator
+{
+    U64 nRenders;
+    double totalTime;
+    double maxTime;
+    U64 nRendersUnderBackgroundLoad;
+    double totalTimeUnderBackgroundLoad;
+    double maxTimeUnderBackgroundLoad;
+
+    TimeToFirstPixelAccumulator()
+    : nRenders(0)
+    , totalTime(0)
+    , maxTime(0)
+    , nRendersUnderBackgroundLoad(0)
+    , totalTimeUnderBackgroundLoad(0)
+    , maxTimeUnderBackgroundLoad(0)
+    {
+    }
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
 
 
 struct PerProviderRenders
@@ -126,6 +169,23 @@ struct TreeRenderQueueManager::Implementation
     // True when somebody called quitThread()
     bool mustQuit;
 
+    // For each priority class, the number of tasks started in the thread pool that did not start running yet,
+    // and the number of tasks running
+    QAtomicInt nQueuedTasks[kNumRenderPriorities];
+    QAtomicInt nRunningTasks[kNumRenderPriorities];
+
+    // For each thread of the thread pool, the priorities of the tasks it runs. A task that released its thread, e.g: to
+    // wait for a sub-render, is not counted in nRunningTasks until it reserves it again.
+    QThreadStorage<ThreadRunningTaskPriorities*> runningTaskPriorities;
+
+    // Threads paused in pauseIfPreempted() wait in preemptionCond until the tasks of higher priority renders started
+    QMutex preemptionMutex;
+    QWaitCondition preemptionCond;
+
+    // Protects timeToFirstPixelStats
+    mutable QMutex timeToFirstPixelStatsMutex;
+    TimeToFirstPixelAccumulator timeToFirstPixelStats[kNumRenderPriorities];
+
     Implementation(TreeRenderQueueManager* publicInterface)
     : _publicInterface(publicInterface)
     , executionQueueMutex()
@@ -138,10 +198,43 @@ struct TreeRenderQueueManager::Implementation
     , mustQuitMutex()
     , mustQuitCond()
     , mustQuit(false)
+    , runningTaskPriorities()
+    , preemptionMutex()
+    , preemptionCond()
+    , timeToFirstPixelStatsMutex()
     {
 
     }
 
+    /**
+     * @brief Returns true if tasks of renders with a higher priority than the given one are waiting for a thread
+     **/
+    bool hasHigherPriorityTasksQueued(RenderPriorityEnum priority) const;
+
+    /**
+     * @brief Returns the number of tasks queued or running of renders with a lower priority than the given one
+     **/
+    int getNumLowerPriorityTasks(RenderPriorityEnum priority) const;
+
+    /**
+     * @brief Returns how many tasks of the given execution may be started, given the threads reserved for interactive renders
+     * and the tasks of the other renders already started. If nTasksWanted is -1, returns -1 if there is no limit.
+     **/
+    int getNumTasksAllowed(const TreeRenderExecutionDataPtr& execution, int nTasksWanted, int maxParallelTasks, int nReservedThreads) const;
+
+    /**
+     * @brief Returns the number of threads reserved for interactive renders: none if there is no interactive render
+     * to use them, or in background mode where there is no viewer.
+     **/
+    int getNumReservedThreads(const std::list<TreeRenderExecutionDataWPtr>& queue, int maxParallelTasks) const;
+
+    /**
+     * @brief Returns in priority the priority of the render task running on the current thread, if any
+     **/
+    bool getCurrentThreadTaskPriority(RenderPriorityEnum* priority);
+
+    void recordTimeToFirstPixel(const TreeRenderPtr& render);
+
     /**
      * @brief Called in a separate thread once the main execution of a render finishes. 
      * This will launch the extra requested executions (including image(s) for color-picker)
@@ -209,7 +302,7 @@ TreeRenderQueueManager::launchRender(const TreeRenderPtr& render)
     }
 
 
-    QThreadPool::globalInstance()->start(new LaunchRenderRunnable(render, _imp.get()));
+    appPTR->getRenderThreadPool()->start(new LaunchRenderRunnable(render, _imp.get()), false, (int)render->getPriority());
 
 } // launchRender
 
@@ -261,8 +354,15 @@ TreeRenderQueueManager::launchSubRender(const EffectInstancePtr& treeRoot,
 void
 TreeRenderQueueManager::releaseTask()
 {
-    if (isRunningInThreadPoolThread()) {
-        QThreadPool::globalInstance()->releaseThread();
+    WorkStealingThreadPool* threadPool = appPTR->getRenderThreadPool();
+    if ( threadPool->isCurrentThreadInPool() ) {
+        threadPool->releaseThread();
+
+        // The task waits: it must not prevent the tasks it waits for from starting, @see getNumTasksAllowed
+        RenderPriorityEnum priority;
+        if ( _imp->getCurrentThreadTaskPriority(&priority) ) {
+            _imp->nRunningTasks[priority].fetchAndAddOrdered(-1);
+        }
 
         // We are making a thread available, notify the manager which may be able to load more renders.
         _imp->notifyManagerThreadForModifications();
@@ -273,9 +373,30 @@ TreeRenderQueueManager::releaseTask()
 void
 TreeRenderQueueManager::reserveTask()
 {
-    if (isRunningInThreadPoolThread()) {
-        QThreadPool::globalInstance()->reserveThread();
+    WorkStealingThreadPool* threadPool = appPTR->getRenderThreadPool();
+    if ( threadPool->isCurrentThreadInPool() ) {
+        threadPool->reserveThread();
+
+        RenderPriorityEnum priority;
+        if ( _imp->getCurrentThreadTaskPriority(&priority) ) {
+            _imp->nRunningTasks[priority].fetchAndAddOrdered(1);
+        }
+    }
+}
+
+bool
+TreeRenderQueueManager::Implementation::getCurrentThreadTaskPriority(RenderPriorityEnum* priority)
+{
+    if ( !runningTaskPriorities.hasLocalData() ) {
+        return false;
+    }
+    const std::vector<RenderPriorityEnum>& priorities = runningTaskPriorities.localData()->priorities;
+    if ( priorities.empty() ) {
+        return false;
     }
+    *priority = priorities.back();
+
+    return true;
 }
 
 
@@ -511,7 +632,22 @@ TreeRenderQueueManager::Implementation::appendTreeRenderExecution(const TreeRend
     // Push the execution to the queue and notify the thread
     {
         QMutexLocker k(&executionQueueMutex);
-        executionQueue.push_back(render);
+
+        // Keep the queue sorted by priority: the execution goes after all executions of the same or a higher priority.
+        // launchMoreTasks() gives most threads to the first execution in the queue.
+        TreeRenderPtr treeRender = render->getTreeRender();
+        RenderPriorityEnum priority = treeRender ? treeRender->getPriority() : eRenderPriorityInteractive;
+        std::list<TreeRenderExecutionDataPtr>::iterator it = executionQueue.end();
+        while ( it != executionQueue.begin() ) {
+            std::list<TreeRenderExecutionDataPtr>::iterator prev = it;
+            --prev;
+            TreeRenderPtr prevTreeRender = *prev ? (*prev)->getTreeRender() : TreeRenderPtr();
+            if ( !prevTreeRender || (prevTreeRender->getPriority() <= priority) ) {
+                break;
+            }
+            it = prev;
+        }
+        executionQueue.insert(it, render);
 
         if (!_publicInterface->isRunning()) {
             _publicInterface->start();
@@ -573,6 +709,12 @@ TreeRenderQueueManager::Implementation::onTaskRenderFinished(const TreeRenderExe
 
     if (render->isTreeMainExecution()) {
         TreeRenderPtr treeRender = render->getTreeRender();
+        if ( !isFailureRetCode( render->getStatus() ) && !treeRender->isTileGroupRender() ) {
+            // If the tree root was cached, no tile was rendered: its pixels are available now
+            treeRender->notifyFirstPixelRendered();
+            recordTimeToFirstPixel(treeRender);
+        }
+
         TreeRenderQueueProviderPtr provider = boost::const_pointer_cast<TreeRenderQueueProvider>(treeRender->getProvider());
         provider->notifyTreeRenderFinished(treeRender);
     }
@@ -618,13 +760,195 @@ TreeRenderQueueManager::Implementation::notifyTaskInRenderFinishedInternal(const
 
 } // notifyTaskInRenderFinishedInternal
 
+void
+TreeRenderQueueManager::notifyTaskInRenderQueued(const TreeRenderExecutionDataPtr& render)
+{
+    TreeRenderPtr treeRender = render->getTreeRender();
+    if (treeRender) {
+        _imp->nQueuedTasks[treeRender->getPriority()].fetchAndAddOrdered(1);
+    }
+}
+
+void
+TreeRenderQueueManager::notifyTaskInRenderStarted(const TreeRenderExecutionDataPtr& render)
+{
+    TreeRenderPtr treeRender = render->getTreeRender();
+    if (!treeRender) {
+        return;
+    }
+    RenderPriorityEnum priority = treeRender->getPriority();
+    if ( !_imp->runningTaskPriorities.hasLocalData() ) {
+        _imp->runningTaskPriorities.setLocalData(new ThreadRunningTaskPriorities);
+    }
+    _imp->runningTaskPriorities.localData()->priorities.push_back(priority);
+    _imp->nRunningTasks[priority].fetchAndAddOrdered(1);
+    if (_imp->nQueuedTasks[priority].fetchAndAddOrdered(-1) == 1) {
+        // No more tasks of this priority waiting for a thread: resume the threads that were paused for them
+        QMutexLocker k(&_imp->preemptionMutex);
+        _imp->preemptionCond.wakeAll();
+    }
+}
+
 void
 TreeRenderQueueManager::notifyTaskInRenderFinished(const TreeRenderExecutionDataPtr& render, bool isExecutionFinished, bool isRunningInThreadPoolThread)
 {
+    if (isRunningInThreadPoolThread) {
+        TreeRenderPtr treeRender = render->getTreeRender();
+        if (treeRender) {
+            _imp->nRunningTasks[treeRender->getPriority()].fetchAndAddOrdered(-1);
+            if ( _imp->runningTaskPriorities.hasLocalData() && !_imp->runningTaskPriorities.localData()->priorities.empty() ) {
+                _imp->runningTaskPriorities.localData()->priorities.pop_back();
+            }
+        }
+    }
     _imp->notifyTaskInRenderFinishedInternal(render, isExecutionFinished, true /*notifyTaskInRenderFinishedInternal*/, isRunningInThreadPoolThread);
     
 } // notifyTaskInRenderFinished
 
+bool
+TreeRenderQueueManager::Implementation::hasHigherPriorityTasksQueued(RenderPriorityEnum priority) const
+{
+    for (int i = 0; i < (int)priority; ++i) {
+        if ( (int)nQueuedTasks[i] > 0 ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int
+TreeRenderQueueManager::Implementation::getNumLowerPriorityTasks(RenderPriorityEnum priority) const
+{
+    int ret = 0;
+    for (int i = (int)priority + 1; i < kNumRenderPriorities; ++i) {
+        ret += (int)nQueuedTasks[i] + (int)nRunningTasks[i];
+    }
+    return ret;
+}
+
+int
+TreeRenderQueueManager::Implementation::getNumTasksAllowed(const TreeRenderExecutionDataPtr& execution,
+                                                           int nTasksWanted,
+                                                           int maxParallelTasks,
+                                                           int nReservedThreads) const
+{
+    TreeRenderPtr treeRender = execution->getTreeRender();
+    if ( (nReservedThreads == 0) || !treeRender || (treeRender->getPriority() == eRenderPriorityInteractive) ) {
+        return nTasksWanted;
+    }
+
+    // Never hold back the sub-renders and groups of tiles of a render already running: it waits for them
+    if ( !execution->isTreeMainExecution() || treeRender->isTileGroupRender() ) {
+        return nTasksWanted;
+    }
+
+    // Renders other than interactive ones may not use the reserved threads
+    int nAvailableThreads = maxParallelTasks - nReservedThreads - getNumLowerPriorityTasks(eRenderPriorityInteractive);
+    if (nAvailableThreads <= 0) {
+        return 0;
+    }
+    return nTasksWanted == -1 ? nAvailableThreads : std::min(nTasksWanted, nAvailableThreads);
+}
+
+int
+TreeRenderQueueManager::Implementation::getNumReservedThreads(const std::list<TreeRenderExecutionDataWPtr>& queue,
+                                                              int maxParallelTasks) const
+{
+    SettingsPtr settings = appPTR->getCurrentSettings();
+    if ( appPTR->isBackground() || !settings->isBackgroundRenderPreemptionEnabled() ) {
+        return 0;
+    }
+
+    bool hasInteractiveRender = ( (int)nQueuedTasks[eRenderPriorityInteractive] + (int)nRunningTasks[eRenderPriorityInteractive] ) > 0;
+    for (std::list<TreeRenderExecutionDataWPtr>::const_iterator it = queue.begin(); !hasInteractiveRender && it != queue.end(); ++it) {
+        TreeRenderExecutionDataPtr execution = it->lock();
+        TreeRenderPtr treeRender = execution ? execution->getTreeRender() : TreeRenderPtr();
+        hasInteractiveRender = treeRender && treeRender->getPriority() == eRenderPriorityInteractive;
+    }
+    if (!hasInteractiveRender) {
+        return 0;
+    }
+
+    return std::max( 0, std::min(settings->getNumThreadsReservedForInteractiveRenders(), maxParallelTasks - 1) );
+}
+
+void
+TreeRenderQueueManager::Implementation::recordTimeToFirstPixel(const TreeRenderPtr& render)
+{
+    double time = render->getTimeToFirstPixel();
+    if ( (time < 0.) || render->isRenderAborted() ) {
+        return;
+    }
+    RenderPriorityEnum priority = render->getPriority();
+    bool underBackgroundLoad = getNumLowerPriorityTasks(priority) > 0;
+
+    {
+        QMutexLocker k(&timeToFirstPixelStatsMutex);
+        TimeToFirstPixelAccumulator& stats = timeToFirstPixelStats[priority];
+        ++stats.nRenders;
+        stats.totalTime += time;
+        stats.maxTime = std::max(stats.maxTime, time);
+        if (underBackgroundLoad) {
+            ++stats.nRendersUnderBackgroundLoad;
+            stats.totalTimeUnderBackgroundLoad += time;
+            stats.maxTimeUnderBackgroundLoad = std::max(stats.maxTimeUnderBackgroundLoad, time);
+        }
+    }
+
+#ifdef TRACE_TIME_TO_FIRST_PIXEL
+    qDebug() << "Render" << render.get() << "of priority" << (int)priority << "time to first pixel:" << time * 1000. << "ms" << (underBackgroundLoad ? "(under background load)" : "");
+#endif
+} // recordTimeToFirstPixel
+
+void
+TreeRenderQueueManager::getTimeToFirstPixelStats(RenderPriorityEnum priority,
+                                                 TimeToFirstPixelStats* stats) const
+{
+    QMutexLocker k(&_imp->timeToFirstPixelStatsMutex);
+    const TimeToFirstPixelAccumulator& acc = _imp->timeToFirstPixelStats[priority];
+
+    stats->nRenders = acc.nRenders;
+    stats->averageTime = acc.nRenders ? acc.totalTime / acc.nRenders : 0.;
+    stats->maxTime = acc.maxTime;
+    stats->nRendersUnderBackgroundLoad = acc.nRendersUnderBackgroundLoad;
+    stats->averageTimeUnderBackgroundLoad = acc.nRendersUnderBackgroundLoad ? acc.totalTimeUnderBackgroundLoad / acc.nRendersUnderBackgroundLoad : 0.;
+    stats->maxTimeUnderBackgroundLoad = acc.maxTimeUnderBackgroundLoad;
+}
+
+void
+TreeRenderQueueManager::resetTimeToFirstPixelStats()
+{
+    QMutexLocker k(&_imp->timeToFirstPixelStatsMutex);
+    for (int i = 0; i < kNumRenderPriorities; ++i) {
+        _imp->timeToFirstPixelStats[i] = TimeToFirstPixelAccumulator();
+    }
+}
+
+void
+TreeRenderQueueManager::pauseIfPreempted(const TreeRenderPtr& render)
+{
+    if (!render) {
+        return;
+    }
+    RenderPriorityEnum priority = render->getPriority();
+
+    // Fast path, called for every tile
+    if ( !_imp->hasHigherPriorityTasksQueued(priority) ) {
+        return;
+    }
+    if ( !appPTR->getCurrentSettings()->isBackgroundRenderPreemptionEnabled() || !appPTR->getRenderThreadPool()->isCurrentThreadInPool() ) {
+        return;
+    }
+
+    // Let the thread pool start the tasks of the higher priority renders in place of this thread
+    ReleaseTPThread_RAII tpThreadRelease;
+
+    QMutexLocker k(&_imp->preemptionMutex);
+    while ( _imp->hasHigherPriorityTasksQueued(priority) && !render->isRenderAborted() ) {
+        _imp->preemptionCond.wait(&_imp->preemptionMutex, kPreemptionAbortCheckIntervalMS);
+    }
+} // pauseIfPreempted
+
 void
 TreeRenderQueueManager::quitThread()
 {
@@ -693,11 +1017,28 @@ TreeRenderQueueManager::Implementation::launchMoreTasks()
 
 
     // In one run of launchMoreTasks(), start at most maxTasksToLaunch.
-    const int maxParallelTasks = QThreadPool::globalInstance()->maxThreadCount();
-    const int maxTasksToLaunch = std::max(1, maxParallelTasks  - QThreadPool::globalInstance()->activeThreadCount());
+    WorkStealingThreadPool* threadPool = appPTR->getRenderThreadPool();
+    const int maxParallelTasks = threadPool->maxThreadCount();
+    const int maxTasksToLaunch = std::max(1, maxParallelTasks  - threadPool->activeThreadCount());
+
+    SettingsPtr settings = appPTR->getCurrentSettings();
+
+    // When enabled, the tasks on the longest path of the graph (in estimated render time) are started first, so that
+    // a slow node does not start last while the other threads idle.
+    const bool criticalPathFirst = settings->isCriticalPathSchedulingEnabled();
 
-    // Start as many concurrent renders as we can on the first task: this is the oldest task that was requested by the user
-    int nTasksLaunched = firstRenderExecution->executeAvailableTasks(-1);
+    // Threads that only interactive renders may use, so that they start right away even when a render on disk is running
+    const int nReservedThreads = getNumReservedThreads(queue, maxParallelTasks);
+
+    // Start as many concurrent renders as we can on the first task: this is the render with the highest priority
+    // that was requested first
+    int nTasksLaunched = 0;
+    {
+        int nTasksAllowed = getNumTasksAllowed(firstRenderExecution, -1, maxParallelTasks, nReservedThreads);
+        if (nTasksAllowed != 0) {
+            nTasksLaunched = firstRenderExecution->executeAvailableTasks(nTasksAllowed, criticalPathFirst);
+        }
+    }
 
     // A TreeRender may not allow rendering of concurrent TreeRenders (e.g: when drawing, to ensure renders are processed in order)
     const bool allowConcurrentRenders = firstRenderTree->isConcurrentRendersAllowed();
@@ -705,6 +1046,7 @@ TreeRenderQueueManager::Implementation::launchMoreTasks()
 
     // If we've got remaining threads, cycle through other execution trees in the queue to launch other tasks
     // until we reach the max threads count
+    std::vector<TreeRenderExecutionDataPtr> otherExecutions;
     std::list<TreeRenderExecutionDataWPtr>::iterator it = queue.begin();
     ++it; // skip the first execution
     for (; it != queue.end(); ++it) {
@@ -722,26 +1064,57 @@ TreeRenderQueueManager::Implementation::launchMoreTasks()
             continue;
         }
 
+        if (criticalPathFirst) {
+            otherExecutions.push_back(renderExecution);
+            continue;
+        }
 
         // Launch tasks in non priority render. Launch at most 1 parallel task in these render to let a chance to the first render in the queue
         // to use more threads.
-        int nLaunched = renderExecution->executeAvailableTasks(1);
-        nTasksLaunched += nLaunched;
+        if (getNumTasksAllowed(renderExecution, 1, maxParallelTasks, nReservedThreads) > 0) {
+            int nLaunched = renderExecution->executeAvailableTasks(1);
+            nTasksLaunched += nLaunched;
+        }
+
+    }
 
+    // Give each remaining thread to the most critical task across all other executions
+    while ( nTasksLaunched < maxTasksToLaunch && !otherExecutions.empty() ) {
+        TreeRenderExecutionDataPtr mostCritical;
+        double maxCost = -1.;
+        std::vector<TreeRenderExecutionDataPtr> executionsWithTasks;
+        for (std::vector<TreeRenderExecutionDataPtr>::const_iterator it2 = otherExecutions.begin(); it2 != otherExecutions.end(); ++it2) {
+            double cost = (*it2)->getMostCriticalTaskCost();
+            if ( (cost < 0.) || (getNumTasksAllowed(*it2, 1, maxParallelTasks, nReservedThreads) == 0) ) {
+                // No task available in this execution: do not look at it again
+                continue;
+            }
+            executionsWithTasks.push_back(*it2);
+            if (cost > maxCost) {
+                maxCost = cost;
+                mostCritical = *it2;
+            }
+        }
+        otherExecutions.swap(executionsWithTasks);
+        if (!mostCritical) {
+            break;
+        }
+        nTasksLaunched += mostCritical->executeAvailableTasks(1, true);
     }
 
 
     // If we still have threads idle and the last request is playback, fetch more renders for that provider
     if (allowConcurrentRenders && firstRenderTree->isPlayback() && !provider->isWaitingForAllTreeRenders() && nTasksLaunched < maxTasksToLaunch) {
 
-        // If more than maxThreadsCount renders are finished or launched, do not launch more for this provider
+        // If more than maxThreadsCount renders (or the number the provider allows) are finished or launched, do not launch more for this provider
+        const int maxQueuedRenders = std::max(1, provider->getMaxQueuedRenders(maxParallelTasks));
         bool providerMaxQueueReached = true;
         {
             QMutexLocker k(&perProviderRendersMutex);
             PerProviderRendersMap::iterator foundProvider = perProviderRenders.find(provider);
             // The provider may no longer be in the queue, because the executionQueue might be already empty since we made a copy of it.
             if (foundProvider != perProviderRenders.end()) {
-                providerMaxQueueReached = ((int)foundProvider->second->finishedRenders.size() >= maxParallelTasks || (int)foundProvider->second->queuedRenders.size() >= maxParallelTasks);
+                providerMaxQueueReached = ((int)foundProvider->second->finishedRenders.size() >= maxQueuedRenders || (int)foundProvider->second->queuedRenders.size() >= maxQueuedRenders);
             }
         }
 
@@ -759,6 +1132,22 @@ void
 LaunchRenderRunnable::run()
 {
 
+    // In tile streaming mode, render the groups of tiles of the tree root first, each as its own render so that they
+    // go through the whole tree independently. The main execution then finds the tiles of the tree root in the cache.
+    std::vector<RectD> tileGroups;
+    if ( render->getStreamingTileGroups(&tileGroups) ) {
+        std::vector<TreeRenderPtr> tileGroupRenders;
+        for (std::size_t i = 0; i < tileGroups.size(); ++i) {
+            TreeRenderPtr tileGroupRender = render->createTileGroupRender(tileGroups[i]);
+            imp->_publicInterface->launchRender(tileGroupRender);
+            tileGroupRenders.push_back(tileGroupRender);
+        }
+
+        // A failed or aborted group is rendered again or reports its status in the main execution
+        for (std::size_t i = 0; i < tileGroupRenders.size(); ++i) {
+            ignore_result( imp->_publicInterface->waitForRenderFinished(tileGroupRenders[i]) );
+        }
+    }
 
     TreeRenderExecutionDataPtr execData = render->createMainExecutionData();
 
@@ -25,6 +25,7 @@
 #include <Python.h>
 // ***** END PYTHON BLOCK *****
 
+#include "Global/GlobalDefines.h"
 #include "Engine/EngineFwd.h"
 
 #include <QThread>
@@ -68,6 +69,46 @@ public:
      **/
     void getRenderIndex(const TreeRenderPtr& render, int* index, int* numRenders) const;
 
+    /**
+     * @brief Called by render threads at tile boundaries: if preemption is enabled in the settings and tasks of renders with
+     * a higher priority than the given render are waiting for a thread, the calling thread is released from the thread pool
+     * and paused until they have all started or the render is aborted.
+     **/
+    void pauseIfPreempted(const TreeRenderPtr& render);
+
+    struct TimeToFirstPixelStats
+    {
+        // Number of renders finished
+        U64 nRenders;
+
+        // Average and maximum time between the creation of a render and its first pixel, in seconds
+        double averageTime;
+        double maxTime;
+
+        // Same as above for the renders that finished while tasks of lower priority renders were running
+        U64 nRendersUnderBackgroundLoad;
+        double averageTimeUnderBackgroundLoad;
+        double maxTimeUnderBackgroundLoad;
+
+        TimeToFirstPixelStats()
+        : nRenders(0)
+        , averageTime(0)
+        , maxTime(0)
+        , nRendersUnderBackgroundLoad(0)
+        , averageTimeUnderBackgroundLoad(0)
+        , maxTimeUnderBackgroundLoad(0)
+        {
+        }
+    };
+
+    /**
+     * @brief Returns the time to first pixel (see TreeRender::getTimeToFirstPixel()) of the renders of the given priority
+     * finished since the application started or the last call to resetTimeToFirstPixelStats().
+     **/
+    void getTimeToFirstPixelStats(RenderPriorityEnum priority, TimeToFirstPixelStats* stats) const;
+
+    void resetTimeToFirstPixelStats();
+
 private:
 
 
@@ -126,6 +167,16 @@ private:
     virtual void run() OVERRIDE FINAL;
 
 
+    /**
+     * @brief Called by TreeRenderExecutionData when a FrameViewRenderRunnable is started in the thread pool
+     **/
+    void notifyTaskInRenderQueued(const TreeRenderExecutionDataPtr& render);
+
+    /**
+     * @brief Executed on a thread-pool thread when a FrameViewRenderRunnable starts running
+     **/
+    void notifyTaskInRenderStarted(const TreeRenderExecutionDataPtr& render);
+
     /**
      * @brief Executed on a thread-pool thread when a FrameViewRenderRunnable is finished
      **/
@@ -135,6 +186,7 @@ private:
     friend struct TreeRenderExecutionDataPrivate;
     friend class ReleaseTPThread_RAII;
     friend class LaunchRenderRunnable;
+    friend class FrameViewRenderRunnable;
     boost::scoped_ptr<Implementation> _imp;
 };
 
@@ -142,6 +142,14 @@ protected:
      **/
     virtual void requestMoreRenders() { };
 
+    /**
+     * @brief Returns the maximum number of renders of this provider that may be queued or finished but not yet
+     * collected before the TreeRenderQueueManager stops calling requestMoreRenders().
+     * By default this is the number of threads of the render thread pool.
+     * This is called on the TreeRenderQueueManager thread.
+     **/
+    virtual int getMaxQueuedRenders(int maxParallelTasks) const { return maxParallelTasks; }
+
     /**
      * @brief Callback called on a thread-pool thread once a render is finished. Even if implementing this callback, you must call
      * waitForRenderFinished(render) to remove data associated to that render. If called within this function, this would return
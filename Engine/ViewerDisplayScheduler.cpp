@@ -28,6 +28,7 @@
 #include "Engine/TimeLine.h"
 #include "Engine/Image.h"
 #include "Engine/ImageCacheEntry.h"
+#include "Engine/ImageCacheKey.h"
 #include "Engine/Node.h"
 #include "Engine/RenderEngine.h"
 #include "Engine/RotoStrokeItem.h"
@@ -210,7 +211,7 @@ static ActionRetCodeEnum createFrameRenderResultsForView(const ViewerNodePtr& vi
                                                          const ViewerRenderFrameResultsContainerPtr& results,
                                                          ViewIdx view,
                                                          const RenderStatsPtr& stats,
-                                                         bool isPlayback,
+                                                         RenderPriorityEnum priority,
                                                          const RectD* partialUpdateRoIParam,
                                                          unsigned int mipMapLevel,
                                                          ViewerCompositingOperatorEnum viewerBlend,
@@ -282,10 +283,11 @@ static ActionRetCodeEnum createFrameRenderResultsForView(const ViewerNodePtr& vi
         initArgs->stats = stats;
         initArgs->activeRotoDrawableItem = activeDrawingStroke;
         initArgs->draftMode = draftModeEnabled;
-        initArgs->playback = isPlayback;
+        initArgs->playback = priority == eRenderPriorityPlayback;
+        initArgs->priority = priority;
         initArgs->byPassCache = byPassCache;
         initArgs->preventConcurrentTreeRenders = (activeDrawingStroke || partialUpdateRoIParam);
-        if (!isPlayback && subResult->textureTransferType == OpenGLViewerI::TextureTransferArgs::eTextureTransferTypeReplace && !activeDrawingStroke) {
+        if (priority == eRenderPriorityInteractive && subResult->textureTransferType == OpenGLViewerI::TextureTransferArgs::eTextureTransferTypeReplace && !activeDrawingStroke) {
             subResult->perInputsData[viewerInputIndex].colorPickerNode = viewerInputIndex == 0 ? viewer->getCurrentAInput() : viewer->getCurrentBInput();
             if (subResult->perInputsData[viewerInputIndex].colorPickerNode) {
                 // Also sample the "main" input of the color picker node, this is useful for keyers.
@@ -313,7 +315,7 @@ ActionRetCodeEnum
 ViewerDisplayScheduler::createFrameRenderResultsGeneric(const ViewerNodePtr& viewer,
                                                         const TreeRenderQueueProviderPtr& provider,
                                                         TimeValue time,
-                                                        bool isPlayback,
+                                                        RenderPriorityEnum priority,
                                                         const RotoStrokeItemPtr& activeDrawingStroke,
                                                         const std::vector<ViewIdx>& viewsToRender,
                                                         bool enableRenderStats,
@@ -330,7 +332,8 @@ ViewerDisplayScheduler::createFrameRenderResultsGeneric(const ViewerNodePtr& vie
     bool fullFrameProcessing = viewer->isFullFrameProcessingEnabled();
     bool draftModeEnabled = viewer->getApp()->isDraftRenderEnabled();
     unsigned int mipMapLevel = getViewerMipMapLevel(viewer, draftModeEnabled, fullFrameProcessing);
-    bool byPassCache = viewer->isRenderWithoutCacheEnabledAndTurnOff();
+    // Prefetched frames are only useful if they are cached: do not consume the request to render without cache
+    bool byPassCache = priority == eRenderPriorityPrefetch ? false : viewer->isRenderWithoutCacheEnabledAndTurnOff();
     ViewerCompositingOperatorEnum viewerBlend = viewer->getCurrentOperator();
     bool viewerBEqualsViewerA = viewer->getCurrentAInput() == viewer->getCurrentBInput();
 
@@ -358,7 +361,7 @@ ViewerDisplayScheduler::createFrameRenderResultsGeneric(const ViewerNodePtr& vie
     for (std::list<RectD>::const_iterator it = rois.begin(); it != rois.end(); ++it) {
         // Render all requested views
         for (std::size_t view_i = 0; view_i < viewsToRender.size(); ++view_i) {
-            ActionRetCodeEnum stat = createFrameRenderResultsForView(viewer, provider, results, viewsToRender[view_i], stats, isPlayback, it->isNull() ? 0 : &(*it), mipMapLevel, viewerBlend, byPassCache, draftModeEnabled, fullFrameProcessing, viewerBEqualsViewerA, activeDrawingStroke);
+            ActionRetCodeEnum stat = createFrameRenderResultsForView(viewer, provider, results, viewsToRender[view_i], stats, priority, it->isNull() ? 0 : &(*it), mipMapLevel, viewerBlend, byPassCache, draftModeEnabled, fullFrameProcessing, viewerBEqualsViewerA, activeDrawingStroke);
             if (isFailureRetCode(stat)) {
                 return stat;
             }
@@ -375,7 +378,7 @@ ViewerDisplayScheduler::createFrameRenderResults(TimeValue time, const std::vect
 
     ViewerNodePtr viewer = toViewerNode(getOutputNode()->getEffectInstance());
     assert(viewer);
-    return createFrameRenderResultsGeneric(viewer, shared_from_this(), time, true /*isPlayback*/, RotoStrokeItemPtr(), viewsToRender, enableRenderStats, results);
+    return createFrameRenderResultsGeneric(viewer, shared_from_this(), time, eRenderPriorityPlayback, RotoStrokeItemPtr(), viewsToRender, enableRenderStats, results);
 } // createFrameRenderResults
 
 void
@@ -481,6 +484,7 @@ ViewerDisplayScheduler::processFramesResults(const ViewerNodePtr& viewer,const R
     assert(viewerResults);
 
     bool didSomething = false;
+    RenderEnginePtr engine = viewer->getNode()->getRenderEngine();
 
     for (std::list<RenderFrameSubResultPtr>::const_iterator it = viewerResults->frames.begin(); it != viewerResults->frames.end(); ++it) {
         ViewerRenderFrameSubResult* viewerObject = dynamic_cast<ViewerRenderFrameSubResult*>(it->get());
@@ -513,6 +517,14 @@ ViewerDisplayScheduler::processFramesResults(const ViewerNodePtr& viewer,const R
         if (!args.viewerUploads[0].empty() || !args.viewerUploads[1].empty()) {
             viewer->updateViewer(args);
             didSomething = true;
+
+            // Count whether the full image displayed by the viewer was prefetched
+            if (engine && args.type == OpenGLViewerI::TextureTransferArgs::eTextureTransferTypeReplace) {
+                const ImageCacheKeyPtr& key = !args.viewerUploads[0].empty() ? args.viewerUploads[0].front().viewerProcessImageKey : args.viewerUploads[1].front().viewerProcessImageKey;
+                if (key) {
+                    engine->notifyViewerFrameDisplayed( key->getNodeTimeVariantHashKey() );
+                }
+            }
         }
     }
     viewer->redrawViewer();
@@ -569,6 +581,9 @@ ViewerDisplayScheduler::onRenderStopped(bool /*/aborted*/)
     if ( effect->getApp()->isGuiFrozen() ) {
         getEngine()->s_refreshAllKnobs();
     }
+
+    // The viewer is idle: render the next frames in the direction of the playback
+    getEngine()->prefetchViewerFrames();
 }
 
 TimeValue
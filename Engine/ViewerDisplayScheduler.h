@@ -143,13 +143,15 @@ public:
     static bool processFramesResults(const ViewerNodePtr& viewer,const RenderFrameResultsContainerPtr& results);
 
     /**
-     * @brief Generic function for the viewer to launch a render. Used by CurrentFrameRequestScheduler and
-     * ViewerDisplayScheduler
+     * @brief Generic function for the viewer to launch a render. Used by CurrentFrameRequestScheduler,
+     * ViewerDisplayScheduler and ViewerPrefetchScheduler.
+     * @param priority eRenderPriorityPlayback for playback, eRenderPriorityInteractive for the current frame
+     * and eRenderPriorityPrefetch for frames rendered ahead in the cache.
      **/
     static ActionRetCodeEnum createFrameRenderResultsGeneric(const ViewerNodePtr& viewer,
                                                        const TreeRenderQueueProviderPtr& provider,
                                                        TimeValue time,
-                                                       bool isPlayback,
+                                                       RenderPriorityEnum priority,
                                                        const RotoStrokeItemPtr& activeDrawingStroke,
                                                        const std::vector<ViewIdx>& viewsToRender,
                                                        bool enableRenderStats,
@@ -37,6 +37,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/AppInstance.h"
 #include "Engine/AppManager.h"
 #include "Engine/Image.h"
+#include "Engine/ImageSIMD.h"
 #include "Engine/Lut.h"
 #include "Engine/NodeMetadata.h"
 #include "Engine/Node.h"
@@ -1023,6 +1024,7 @@ struct RenderViewerArgs
     const Color::Lut* srcColorspace;
     const Color::Lut* dstColorspace;
     const float* gammaLut;
+    bool orderedDithering;
 };
 
 
@@ -1154,6 +1156,44 @@ toBGRA(unsigned char r,
     return (a << 24) | (r << 16) | (g << 8) | b;
 }
 
+/**
+ * @brief 16x16 Bayer matrix used for ordered dithering, with thresholds in [0, 255].
+ * Unlike error diffusion, the quantization of a pixel only depends on its position, so that
+ * scan-lines and tiles can be processed independently and always produce the same result.
+ **/
+class OrderedDitherMatrix
+{
+public:
+
+    OrderedDitherMatrix()
+    {
+        for (int y = 0; y < 16; ++y) {
+            for (int x = 0; x < 16; ++x) {
+                // The lowest bits of the coordinates give the highest bits of the threshold
+                int value = 0;
+                for (int bit = 0; bit < 4; ++bit) {
+                    int xb = (x >> bit) & 1;
+                    int yb = (y >> bit) & 1;
+                    value |= ( ( (xb ^ yb) << 1 ) | yb ) << ( 2 * (3 - bit) );
+                }
+                _thresholds[y][x] = (unsigned char)value;
+            }
+        }
+    }
+
+    // Returns the threshold to add to a [0 - 0xff00] value before dividing it by 256
+    unsigned char getThreshold(int x, int y) const
+    {
+        return _thresholds[y & 15][x & 15];
+    }
+
+private:
+
+    unsigned char _thresholds[16][16];
+};
+
+const OrderedDitherMatrix orderedDitherMatrix;
+
 template <typename PIX, int maxValue, int srcNComps, DisplayChannelsEnum channels>
 ActionRetCodeEnum
 applyViewerProcess8bit_generic(const RenderViewerArgs& args, const RectI & roi)
@@ -1168,10 +1208,11 @@ applyViewerProcess8bit_generic(const RenderViewerArgs& args, const RectI & roi)
         }
 
         // For error diffusion, we start at each line at a random pixel along the line so it does
-        // not create a pattern in the output image.
-        const int startX = rand() % roi.width() + roi.x1;
+        // not create a pattern in the output image. The ordered dither only needs a forward pass.
+        const int startX = args.orderedDithering ? roi.x1 : rand() % roi.width() + roi.x1;
+        const int nPasses = args.orderedDithering ? 1 : 2;
 
-        for (int backward = 0; backward < 2; ++backward) {
+        for (int backward = 0; backward < nPasses; ++backward) {
 
             int x = backward ? std::max(roi.x1 - 1, startX - 1) : startX;
 
@@ -1212,6 +1253,12 @@ applyViewerProcess8bit_generic(const RenderViewerArgs& args, const RectI & roi)
                     for (int i = 0 ; i < 4; ++i) {
                         uTmpPix[i] = Color::floatToInt<256>(tmpPix[i]);
                     }
+                } else if (args.orderedDithering) {
+                    const unsigned threshold = orderedDitherMatrix.getThreshold(x, y);
+                    for (int i = 0; i < 3; ++i) {
+                        uTmpPix[i] = (unsigned char)( (args.dstColorspace->toColorSpaceUint8xxFromLinearFloatFast(tmpPix[i]) + threshold) >> 8 );
+                    }
+                    uTmpPix[3] = Color::floatToInt<256>(tmpPix[3]);
                 } else {
                     for (int i = 0; i < 3; ++i) {
                         error[i] = (error[i] & 0xff) + args.dstColorspace->toColorSpaceUint8xxFromLinearFloatFast(tmpPix[i]);
@@ -1271,25 +1318,226 @@ applyViewerProcess8bit_generic(const RenderViewerArgs& args, const RectI & roi)
     return eActionStatusOK;
 } // applyViewerProcess8bit_generic
 
+// Fetch n values of a channel to float, converted to linear if the image has a color-space
+template <typename PIX>
+void
+fetchViewerChannelRow(const PIX* pixels,
+                      int pixelStride,
+                      const Color::Lut* srcColorspace,
+                      float* dst,
+                      int n)
+{
+    if (!pixels) {
+        std::fill(dst, dst + n, 0.f);
+        return;
+    }
+    ImageSIMD::convertPixelDepthStrided(pixels, pixelStride, dst, 1, n);
+    if (srcColorspace) {
+        for (int i = 0; i < n; ++i) {
+            dst[i] = srcColorspace->fromColorSpaceFloatToLinearFloat(dst[i]);
+        }
+    }
+}
+
+/**
+ * @brief Same as applyViewerProcess8bit_generic, but each scan-line is processed in chunks of
+ * NATRON_IMAGE_SIMD_CHUNK_SIZE pixels: every step of genericViewerProcessFunctor runs in a tight loop
+ * over one channel, using the vectorized kernels when possible, and the result is packed to BGRA at once.
+ * This may only be used when the quantization of a pixel does not depend on its neighbours, i.e: when there
+ * is no destination color-space or when the ordered dither is used. The result is the same as
+ * applyViewerProcess8bit_generic in these cases.
+ **/
+template <typename PIX, int maxValue, int srcNComps, DisplayChannelsEnum channels>
+ActionRetCodeEnum
+applyViewerProcess8bit_rows(const RenderViewerArgs& args, const RectI & roi)
+{
+    assert(!args.dstColorspace || args.orderedDithering);
+
+    float tmpPix[4][NATRON_IMAGE_SIMD_CHUNK_SIZE];
+    float alphaMatteValue[NATRON_IMAGE_SIMD_CHUNK_SIZE];
+    unsigned char uTmpPix[4][NATRON_IMAGE_SIMD_CHUNK_SIZE];
+    unsigned short uint8xxPix[NATRON_IMAGE_SIMD_CHUNK_SIZE];
+    unsigned short thresholds[NATRON_IMAGE_SIMD_CHUNK_SIZE];
+
+    for (int y = roi.y1; y < roi.y2; ++y) {
+
+        // Check for abort on every scan-line
+        if (args.renderArgs && args.renderArgs->isRenderAborted()) {
+            return eActionStatusAborted;
+        }
+
+        int colorPixelStride;
+        const PIX* color_pixels[4] = {NULL, NULL, NULL, NULL};
+        Image::getChannelPointers<PIX, srcNComps>((const PIX**)args.colorImage.ptrs, roi.x1, y, args.colorImage.bounds, (PIX**)color_pixels, &colorPixelStride);
+
+        int alphaPixelStride = 0;
+        const PIX* alpha_pixels[4] = {NULL, NULL, NULL, NULL};
+        if (channels == eDisplayChannelsMatte || channels == eDisplayChannelsA) {
+            Image::getChannelPointers<PIX>((const PIX**)args.alphaImage.ptrs, roi.x1, y, args.alphaImage.bounds, args.alphaImage.nComps, (PIX**)alpha_pixels, &alphaPixelStride);
+        }
+
+        int dstPixelStride;
+        unsigned char* dst_pixels[4] = {NULL, NULL, NULL, NULL};
+        Image::getChannelPointers<unsigned char>((const unsigned char**)args.dstImage.ptrs, roi.x1, y, args.dstImage.bounds, args.dstImage.nComps, (unsigned char**)dst_pixels, &dstPixelStride);
+        unsigned int *dst_pixels_uint = reinterpret_cast<unsigned int*>(dst_pixels[0]);
+
+        for (int x = roi.x1; x < roi.x2; x += NATRON_IMAGE_SIMD_CHUNK_SIZE) {
+
+            const int n = std::min(roi.x2 - x, NATRON_IMAGE_SIMD_CHUNK_SIZE);
+
+            // Fetch the channels to display, see genericViewerProcessFunctor
+            if ( (channels == eDisplayChannelsMatte || channels == eDisplayChannelsA) &&
+                 args.alphaChannelIndex != -1 && alpha_pixels[args.alphaChannelIndex] ) {
+                ImageSIMD::convertPixelDepthStrided(alpha_pixels[args.alphaChannelIndex], alphaPixelStride, tmpPix[3], 1, n);
+            } else {
+                std::fill(tmpPix[3], tmpPix[3] + n, 1.f);
+            }
+            switch (channels) {
+                case eDisplayChannelsA:
+                    for (int i = 0; i < 3; ++i) {
+                        std::copy(tmpPix[3], tmpPix[3] + n, tmpPix[i]);
+                    }
+                    break;
+                case eDisplayChannelsR:
+                case eDisplayChannelsG:
+                case eDisplayChannelsB: {
+                    const int c = channels == eDisplayChannelsR ? 0 : (channels == eDisplayChannelsG ? 1 : 2);
+                    fetchViewerChannelRow(color_pixels[c], colorPixelStride, args.srcColorspace, tmpPix[0], n);
+                    std::copy(tmpPix[0], tmpPix[0] + n, tmpPix[1]);
+                    std::copy(tmpPix[0], tmpPix[0] + n, tmpPix[2]);
+                    break;
+                }
+                case eDisplayChannelsY:
+                case eDisplayChannelsRGB:
+                case eDisplayChannelsMatte:
+                    for (int i = 0; i < 3; ++i) {
+                        fetchViewerChannelRow(color_pixels[i], colorPixelStride, args.srcColorspace, tmpPix[i], n);
+                    }
+                    if (srcNComps == 1) {
+                        for (int i = 1; i < 4; ++i) {
+                            std::copy(tmpPix[0], tmpPix[0] + n, tmpPix[i]);
+                        }
+                    }
+                    break;
+            }
+
+            // Apply gain gamma and offset to the RGB channels
+            for (int i = 0; i < 3; ++i) {
+                ImageSIMD::scaleOffsetRow(tmpPix[i], n, args.gain, args.offset);
+            }
+            if (args.gamma <= 0.) {
+                for (int i = 0; i < 3; ++i) {
+                    for (int k = 0; k < n; ++k) {
+                        tmpPix[i][k] = (tmpPix[i][k] < 1.) ? 0. : (tmpPix[i][k] == 1. ? 1. : std::numeric_limits<double>::infinity() );
+                    }
+                }
+            } else if (args.gamma != 1.) {
+                for (int i = 0; i < 3; ++i) {
+                    for (int k = 0; k < n; ++k) {
+                        tmpPix[i][k] = ViewerInstancePrivate::lookupGammaLut(tmpPix[i][k], args.gammaLut);
+                    }
+                }
+            }
+
+            if (channels == eDisplayChannelsY) {
+                for (int k = 0; k < n; ++k) {
+                    tmpPix[0][k] = 0.299 * tmpPix[1][k] + 0.587 * tmpPix[2][k] + 0.114 * tmpPix[3][k];
+                }
+                std::copy(tmpPix[0], tmpPix[0] + n, tmpPix[1]);
+                std::copy(tmpPix[0], tmpPix[0] + n, tmpPix[2]);
+            } else if (channels == eDisplayChannelsMatte) {
+                // If this is the same image, use the already processed tmpPix
+                if (args.colorImage.ptrs == args.alphaImage.ptrs) {
+                    std::copy(tmpPix[args.alphaChannelIndex], tmpPix[args.alphaChannelIndex] + n, alphaMatteValue);
+                } else {
+                    const PIX* matte_pixels = args.alphaChannelIndex != -1 ? alpha_pixels[args.alphaChannelIndex] : NULL;
+                    fetchViewerChannelRow(matte_pixels, alphaPixelStride, args.srcColorspace, alphaMatteValue, n);
+                }
+            }
+
+            // Quantize to 8-bit
+            if (!args.dstColorspace) {
+                for (int i = 0; i < 4; ++i) {
+                    ImageSIMD::convertPixelDepthRow(tmpPix[i], uTmpPix[i], n);
+                }
+            } else {
+                for (int k = 0; k < n; ++k) {
+                    thresholds[k] = orderedDitherMatrix.getThreshold(x + k, y);
+                }
+                for (int i = 0; i < 3; ++i) {
+                    args.dstColorspace->toColorSpaceUint8xxFromLinearFloatFast(tmpPix[i], 1, uint8xxPix, 1, n);
+                    for (int k = 0; k < n; ++k) {
+                        uTmpPix[i][k] = (unsigned char)( (uint8xxPix[k] + thresholds[k]) >> 8 );
+                    }
+                }
+                ImageSIMD::convertPixelDepthRow(tmpPix[3], uTmpPix[3], n);
+            }
+
+            if (channels == eDisplayChannelsMatte) {
+                // Add to the red channel the matte value
+                for (int k = 0; k < n; ++k) {
+                    unsigned char matteA;
+                    if (args.dstColorspace) {
+                        matteA = args.dstColorspace->toColorSpaceUint8FromLinearFloatFast(alphaMatteValue[k]) / 2;
+                    } else {
+                        matteA = Color::floatToInt<256>(alphaMatteValue[k]) / 2;
+                    }
+                    uTmpPix[0][k] = Image::clampIfInt<unsigned char>( (double)uTmpPix[0][k] + matteA );
+                }
+            }
+
+            // The viewer has the particularity to write-out BGRA 8-bit images instead of RGBA since the resulting
+            // image is directly fed to the GL_BGRA OpenGL texture format.
+            ImageSIMD::packBGRARow(uTmpPix[0], uTmpPix[1], uTmpPix[2], uTmpPix[3], dst_pixels_uint, n);
+
+            dst_pixels_uint += n;
+            for (int i = 0; i < 4; ++i) {
+                if (color_pixels[i]) {
+                    color_pixels[i] += n * colorPixelStride;
+                }
+                if (alpha_pixels[i]) {
+                    alpha_pixels[i] += n * alphaPixelStride;
+                }
+            }
+
+        } // for each chunk of the line
+
+    } // for each scan-line
+    return eActionStatusOK;
+} // applyViewerProcess8bit_rows
+
+template <typename PIX, int maxValue, int srcNComps, DisplayChannelsEnum channels>
+ActionRetCodeEnum
+applyViewerProcess8bitForChannels(const RenderViewerArgs& args, const RectI & roi)
+{
+    // Error diffusion is serial along each scan-line: it can only be done pixel per pixel.
+    // When the vectorized kernels are disabled, the per-pixel code is faster.
+    if ( (!args.dstColorspace || args.orderedDithering) && ImageSIMD::isEnabled() ) {
+        return applyViewerProcess8bit_rows<PIX, maxValue, srcNComps, channels>(args, roi);
+    } else {
+        return applyViewerProcess8bit_generic<PIX, maxValue, srcNComps, channels>(args, roi);
+    }
+}
+
 template <typename PIX, int maxValue, int srcNComps>
 ActionRetCodeEnum
 applyViewerProcess8bitForComponents(const RenderViewerArgs& args, const RectI & roi)
 {
     switch (args.channels) {
         case eDisplayChannelsA:
-            return applyViewerProcess8bit_generic<PIX, maxValue, srcNComps, eDisplayChannelsA>(args, roi);
+            return applyViewerProcess8bitForChannels<PIX, maxValue, srcNComps, eDisplayChannelsA>(args, roi);
         case eDisplayChannelsR:
-            return applyViewerProcess8bit_generic<PIX, maxValue, srcNComps, eDisplayChannelsR>(args, roi);
+            return applyViewerProcess8bitForChannels<PIX, maxValue, srcNComps, eDisplayChannelsR>(args, roi);
         case eDisplayChannelsG:
-            return applyViewerProcess8bit_generic<PIX, maxValue, srcNComps, eDisplayChannelsG>(args, roi);
+            return applyViewerProcess8bitForChannels<PIX, maxValue, srcNComps, eDisplayChannelsG>(args, roi);
         case eDisplayChannelsB:
-            return applyViewerProcess8bit_generic<PIX, maxValue, srcNComps, eDisplayChannelsB>(args, roi);
+            return applyViewerProcess8bitForChannels<PIX, maxValue, srcNComps, eDisplayChannelsB>(args, roi);
         case eDisplayChannelsRGB:
-            return applyViewerProcess8bit_generic<PIX, maxValue, srcNComps, eDisplayChannelsRGB>(args, roi);
+            return applyViewerProcess8bitForChannels<PIX, maxValue, srcNComps, eDisplayChannelsRGB>(args, roi);
         case eDisplayChannelsY:
-            return applyViewerProcess8bit_generic<PIX, maxValue, srcNComps, eDisplayChannelsY>(args, roi);
+            return applyViewerProcess8bitForChannels<PIX, maxValue, srcNComps, eDisplayChannelsY>(args, roi);
         case eDisplayChannelsMatte:
-            return applyViewerProcess8bit_generic<PIX, maxValue, srcNComps, eDisplayChannelsMatte>(args, roi);
+            return applyViewerProcess8bitForChannels<PIX, maxValue, srcNComps, eDisplayChannelsMatte>(args, roi);
 
     }
     assert(false);
@@ -1648,6 +1896,7 @@ ViewerInstance::render(const RenderActionArgs& args)
 
     renderViewerArgs.srcColorspace = lutFromColorspace(getApp()->getDefaultColorSpaceForBitDepth(getBitDepth(0)));
     renderViewerArgs.dstColorspace = lutFromColorspace((ViewerColorSpaceEnum)_imp->outputColorspace.lock()->getValue());
+    renderViewerArgs.orderedDithering = appPTR->getCurrentSettings()->isViewerOrderedDitheringEnabled();
 
 
     ViewerProcessor processor(shared_from_this());
@@ -1657,5 +1906,44 @@ ViewerInstance::render(const RenderActionArgs& args)
     return stat;
 } // render
 
+ActionRetCodeEnum
+ViewerInstance::applyViewerProcess(const Image::CPUData& colorImage,
+                                   const Image::CPUData& alphaImage,
+                                   int alphaChannelIndex,
+                                   DisplayChannelsEnum channels,
+                                   double gamma,
+                                   double gain,
+                                   double offset,
+                                   ViewerColorSpaceEnum srcColorspace,
+                                   ViewerColorSpaceEnum dstColorspace,
+                                   bool orderedDithering,
+                                   const Image::CPUData& dstImage,
+                                   const RectI& roi)
+{
+    RenderViewerArgs renderViewerArgs;
+    renderViewerArgs.colorImage = colorImage;
+    renderViewerArgs.alphaImage = alphaImage;
+    renderViewerArgs.dstImage = dstImage;
+    renderViewerArgs.alphaChannelIndex = alphaChannelIndex;
+    renderViewerArgs.channels = channels;
+    renderViewerArgs.gamma = gamma;
+    renderViewerArgs.gain = gain;
+    renderViewerArgs.offset = offset;
+    renderViewerArgs.srcColorspace = lutFromColorspace(srcColorspace);
+    renderViewerArgs.dstColorspace = lutFromColorspace(dstColorspace);
+    renderViewerArgs.orderedDithering = orderedDithering;
+
+    RamBuffer<float> gammaLut;
+    ViewerInstancePrivate::buildGammaLut(gamma, &gammaLut);
+    renderViewerArgs.gammaLut = gammaLut.getData();
+
+    if (dstImage.bitDepth == eImageBitDepthFloat) {
+        return applyViewerProcess32bit(renderViewerArgs, roi);
+    } else if (dstImage.bitDepth == eImageBitDepthByte) {
+        return applyViewerProcess8bit(renderViewerArgs, roi);
+    }
+    return eActionStatusFailed;
+} // applyViewerProcess
+
 
 NATRON_NAMESPACE_EXIT
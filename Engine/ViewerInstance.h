@@ -34,6 +34,7 @@
 #endif
 
 #include "Engine/EffectInstance.h"
+#include "Engine/Image.h"
 #include "Engine/ViewIdx.h"
 
 #include "Engine/EngineFwd.h"
@@ -127,6 +128,24 @@ public:
 
     static const Color::Lut* lutFromColorspace(ViewerColorSpaceEnum cs) WARN_UNUSED_RETURN;
 
+    /**
+     * @brief Applies the viewer process (channels selection, gain, gamma and color-space conversion) to the
+     * roi of colorImage and writes the result to dstImage, which is either 8-bit BGRA or float RGBA.
+     * This is what render() does on each thread, on the calling thread only: it is used by the tests.
+     **/
+    static ActionRetCodeEnum applyViewerProcess(const Image::CPUData& colorImage,
+                                                const Image::CPUData& alphaImage,
+                                                int alphaChannelIndex,
+                                                DisplayChannelsEnum channels,
+                                                double gamma,
+                                                double gain,
+                                                double offset,
+                                                ViewerColorSpaceEnum srcColorspace,
+                                                ViewerColorSpaceEnum dstColorspace,
+                                                bool orderedDithering,
+                                                const Image::CPUData& dstImage,
+                                                const RectI& roi) WARN_UNUSED_RETURN;
+
     NodePtr getInputRecursive(int inputIndex) const;
 
     void getChannelOptions(TimeValue time, ImagePlaneDesc* rgbLayer, ImagePlaneDesc* alphaLayer, int* alphaChannelIndex, ImagePlaneDesc* displayChannels) const;
@@ -0,0 +1,579 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ViewerPrefetchScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+#include <QMutex>
+
+#include "Engine/AppManager.h"
+#include "Engine/Cache.h"
+#include "Engine/FrameViewRequest.h"
+#include "Engine/Image.h"
+#include "Engine/ImageCacheEntry.h"
+#include "Engine/ImageCacheKey.h"
+#include "Engine/Node.h"
+#include "Engine/RenderEngine.h"
+#include "Engine/Settings.h"
+#include "Engine/TimeLine.h"
+#include "Engine/Timer.h"
+#include "Engine/TreeRender.h"
+#include "Engine/ViewerDisplayScheduler.h"
+#include "Engine/ViewerNode.h"
+
+// Only the frames requested in the last NATRON_PREFETCH_SCRUB_WINDOW seconds are used to estimate the scrubbing speed
+#define NATRON_PREFETCH_SCRUB_WINDOW 0.5
+
+// Number of frame requests remembered to estimate the scrubbing speed
+#define NATRON_PREFETCH_SCRUB_HISTORY_SIZE 8
+
+// Beyond this number of prefetched frames not displayed yet, the oldest ones are forgotten
+#define NATRON_PREFETCH_MAX_REMEMBERED_FRAMES 10000
+
+NATRON_NAMESPACE_ENTER
+
+class ViewerPrefetchStartArgs : public GenericThreadStartArgs
+{
+public:
+
+    ViewerPrefetchStartArgs()
+    : GenericThreadStartArgs()
+    {
+    }
+
+    virtual ~ViewerPrefetchStartArgs()
+    {
+    }
+};
+
+struct ViewerPrefetchSchedulerPrivate
+{
+    RenderEngineWPtr renderEngine;
+    NodeWPtr viewer;
+
+    // Used to timestamp frame requests
+    TimeLapse clock;
+
+    mutable QMutex historyMutex; // protects history, playbackDirection, hasPlaybackDirection
+
+    // The last frames requested by the viewer, the most recent last
+    std::list<ViewerPrefetchScheduler::FrameRequest> history;
+
+    // The direction of the last playback, if the timeline was not scrubbed since
+    RenderDirectionEnum playbackDirection;
+    bool hasPlaybackDirection;
+
+    mutable QMutex currentResultsMutex;
+
+    // The renders of the frame being prefetched, to abort them
+    RenderFrameResultsContainerPtr currentResults;
+
+    mutable QMutex statsMutex; // protects stats, prefetchedHashes, prefetchedHashesOrder
+
+    ViewerPrefetchScheduler::Stats stats;
+
+    // Hash of the viewer process node at the time/view of each prefetched image that was not displayed yet
+    std::set<U64> prefetchedHashes;
+    std::list<U64> prefetchedHashesOrder;
+
+    ViewerPrefetchSchedulerPrivate(const RenderEnginePtr& renderEngine,
+                                   const NodePtr& viewer)
+    : renderEngine(renderEngine)
+    , viewer(viewer)
+    , clock()
+    , historyMutex()
+    , history()
+    , playbackDirection(eRenderDirectionForward)
+    , hasPlaybackDirection(false)
+    , currentResultsMutex()
+    , currentResults()
+    , statsMutex()
+    , stats()
+    , prefetchedHashes()
+    , prefetchedHashesOrder()
+    {
+    }
+
+    void getFramesToPrefetch(const ViewerNodePtr& viewer, int maxFrames, std::vector<TimeValue>* frames);
+
+    /**
+     * @brief Renders the given frame and waits for it. Returns false if aborted.
+     * The size of the tiles the renders allocated in the cache is set in cachedBytes, even if aborted.
+     **/
+    bool prefetchFrame(const ViewerNodePtr& viewer,
+                       const TreeRenderQueueProviderPtr& provider,
+                       TimeValue frame,
+                       ViewIdx view,
+                       U64* cachedBytes);
+
+    void addPrefetchedHash(U64 hash);
+};
+
+ViewerPrefetchScheduler::ViewerPrefetchScheduler(const RenderEnginePtr& renderEngine,
+                                                 const NodePtr& viewer)
+: _imp( new ViewerPrefetchSchedulerPrivate(renderEngine, viewer) )
+{
+}
+
+ViewerPrefetchScheduler::~ViewerPrefetchScheduler()
+{
+}
+
+void
+ViewerPrefetchScheduler::prefetchFrames()
+{
+    if ( !appPTR->getCurrentSettings()->isViewerPrefetchEnabled() ) {
+        return;
+    }
+    startTask( GenericThreadStartArgsPtr(new ViewerPrefetchStartArgs) );
+}
+
+void
+ViewerPrefetchScheduler::notifyFrameRequested(TimeValue frame)
+{
+    FrameRequest request;
+    request.frame = frame;
+    request.timestamp = _imp->clock.getTimeSinceCreation();
+
+    QMutexLocker k(&_imp->historyMutex);
+    _imp->history.push_back(request);
+    while (_imp->history.size() > NATRON_PREFETCH_SCRUB_HISTORY_SIZE) {
+        _imp->history.pop_front();
+    }
+}
+
+void
+ViewerPrefetchScheduler::notifyPlaybackStarted(RenderDirectionEnum direction)
+{
+    QMutexLocker k(&_imp->historyMutex);
+    _imp->history.clear();
+    _imp->playbackDirection = direction;
+    _imp->hasPlaybackDirection = true;
+}
+
+void
+ViewerPrefetchSchedulerPrivate::addPrefetchedHash(U64 hash)
+{
+    QMutexLocker k(&statsMutex);
+    if ( !prefetchedHashes.insert(hash).second ) {
+        return;
+    }
+    prefetchedHashesOrder.push_back(hash);
+    while (prefetchedHashesOrder.size() > NATRON_PREFETCH_MAX_REMEMBERED_FRAMES) {
+        prefetchedHashes.erase( prefetchedHashesOrder.front() );
+        prefetchedHashesOrder.pop_front();
+    }
+}
+
+void
+ViewerPrefetchScheduler::notifyFrameDisplayed(U64 viewerProcessHash)
+{
+    QMutexLocker k(&_imp->statsMutex);
+    ++_imp->stats.nFramesDisplayed;
+
+    // Each prefetched frame counts once: displaying it again afterwards is a regular cache hit
+    std::set<U64>::iterator found = _imp->prefetchedHashes.find(viewerProcessHash);
+    if ( found != _imp->prefetchedHashes.end() ) {
+        ++_imp->stats.nFramesDisplayedPrefetched;
+        _imp->prefetchedHashes.erase(found);
+        _imp->prefetchedHashesOrder.remove(viewerProcessHash);
+    }
+}
+
+void
+ViewerPrefetchScheduler::getStats(Stats* stats) const
+{
+    QMutexLocker k(&_imp->statsMutex);
+    *stats = _imp->stats;
+}
+
+void
+ViewerPrefetchScheduler::resetStats()
+{
+    QMutexLocker k(&_imp->statsMutex);
+    _imp->stats = Stats();
+}
+
+bool
+ViewerPrefetchScheduler::isPrefetching() const
+{
+    QMutexLocker k(&_imp->currentResultsMutex);
+    return (bool)_imp->currentResults;
+}
+
+bool
+ViewerPrefetchScheduler::getScrubDirection(const std::list<FrameRequest>& history,
+                                           double now,
+                                           double windowSeconds,
+                                           int* direction,
+                                           int* step)
+{
+    *direction = 0;
+    *step = 1;
+
+    const FrameRequest* first = 0;
+    const FrameRequest* last = 0;
+    int nRequests = 0;
+    for (std::list<FrameRequest>::const_iterator it = history.begin(); it != history.end(); ++it) {
+        if (now - it->timestamp > windowSeconds) {
+            continue;
+        }
+        if (!first) {
+            first = &(*it);
+        }
+        last = &(*it);
+        ++nRequests;
+    }
+    if (nRequests < 2) {
+        return false;
+    }
+
+    // The viewer only renders some of the frames the timeline goes through when scrubbing fast:
+    // prefetch with the same step between frames
+    double delta = last->frame - first->frame;
+    if (delta != 0) {
+        *direction = delta > 0 ? 1 : -1;
+        *step = std::max( 1, (int)std::floor(std::abs(delta) / (nRequests - 1) + 0.5) );
+    }
+
+    return true;
+} // getScrubDirection
+
+void
+ViewerPrefetchScheduler::predictFrames(TimeValue currentFrame,
+                                       int direction,
+                                       int step,
+                                       int firstFrame,
+                                       int lastFrame,
+                                       PlaybackModeEnum mode,
+                                       int maxFrames,
+                                       std::vector<TimeValue>* frames)
+{
+    frames->clear();
+    const int nFramesInRange = lastFrame - firstFrame + 1;
+    const int current = (int)std::floor(currentFrame + 0.5);
+    if ( (nFramesInRange <= 1) || (maxFrames <= 0) ) {
+        return;
+    }
+
+    std::set<int> predicted;
+    predicted.insert(current);
+
+    if (direction == 0) {
+        // No motion: prefetch around the current frame, first after it
+        for (int offset = 1; (int)frames->size() < maxFrames && offset < nFramesInRange; ++offset) {
+            if (current + offset <= lastFrame && current + offset >= firstFrame) {
+                frames->push_back( TimeValue(current + offset) );
+            }
+            if ( (int)frames->size() < maxFrames && current - offset >= firstFrame && current - offset <= lastFrame) {
+                frames->push_back( TimeValue(current - offset) );
+            }
+        }
+
+        return;
+    }
+
+    step = std::max(1, step);
+    int frame = current;
+    // Stop once every frame of the range could have been visited
+    for (int i = 0; i < 2 * nFramesInRange && (int)frames->size() < maxFrames; ++i) {
+        frame += direction * step;
+        if ( (frame > lastFrame) || (frame < firstFrame) ) {
+            switch (mode) {
+            case ePlaybackModeLoop:
+                frame = firstFrame + ( (frame - firstFrame) % nFramesInRange + nFramesInRange ) % nFramesInRange;
+                break;
+            case ePlaybackModeBounce:
+                while ( (frame > lastFrame) || (frame < firstFrame) ) {
+                    frame = frame > lastFrame ? 2 * lastFrame - frame : 2 * firstFrame - frame;
+                    direction = -direction;
+                }
+                break;
+            case ePlaybackModeOnce:
+            default:
+                return;
+            }
+        }
+        if ( predicted.insert(frame).second ) {
+            frames->push_back( TimeValue(frame) );
+        }
+    }
+} // predictFrames
+
+void
+ViewerPrefetchSchedulerPrivate::getFramesToPrefetch(const ViewerNodePtr& viewer,
+                                                    int maxFrames,
+                                                    std::vector<TimeValue>* frames)
+{
+    int direction = 0;
+    int step = 1;
+    {
+        QMutexLocker k(&historyMutex);
+        bool scrubbed = ViewerPrefetchScheduler::getScrubDirection(history, clock.getTimeSinceCreation(), NATRON_PREFETCH_SCRUB_WINDOW, &direction, &step);
+        if (scrubbed && direction != 0) {
+            // The user took over the timeline: forget about the last playback
+            hasPlaybackDirection = false;
+        } else if (!scrubbed && hasPlaybackDirection) {
+            direction = playbackDirection == eRenderDirectionForward ? 1 : -1;
+        }
+    }
+
+    int firstFrame, lastFrame;
+    viewer->getTimelineBounds(&firstFrame, &lastFrame);
+    TimeValue currentFrame( viewer->getTimeline()->currentFrame() );
+    RenderEnginePtr engine = renderEngine.lock();
+    PlaybackModeEnum mode = engine ? engine->getPlaybackMode() : ePlaybackModeLoop;
+
+    ViewerPrefetchScheduler::predictFrames(currentFrame, direction, step, firstFrame, lastFrame, mode, maxFrames, frames);
+}
+
+bool
+ViewerPrefetchSchedulerPrivate::prefetchFrame(const ViewerNodePtr& viewer,
+                                              const TreeRenderQueueProviderPtr& provider,
+                                              TimeValue frame,
+                                              ViewIdx view,
+                                              U64* cachedBytes)
+{
+    *cachedBytes = 0;
+    std::vector<ViewIdx> views(1, view);
+    RenderFrameResultsContainerPtr results;
+    ActionRetCodeEnum stat = ViewerDisplayScheduler::createFrameRenderResultsGeneric(viewer, provider, frame, eRenderPriorityPrefetch, RotoStrokeItemPtr(), views, false /*enableRenderStats*/, &results);
+    if ( isFailureRetCode(stat) ) {
+        return true;
+    }
+
+    {
+        QMutexLocker k(&currentResultsMutex);
+        currentResults = results;
+    }
+
+    results->launchRenders();
+
+    // Do not wait with results->waitForRendersFinished(): this would convert the images for display
+    bool aborted = false;
+    std::vector<U64> hashes;
+    for (std::list<RenderFrameSubResultPtr>::const_iterator it = results->frames.begin(); it != results->frames.end(); ++it) {
+        ViewerRenderFrameSubResult* viewerResult = dynamic_cast<ViewerRenderFrameSubResult*>(it->get());
+        assert(viewerResult);
+        for (int i = 0; i < 2; ++i) {
+            const TreeRenderPtr& render = viewerResult->perInputsData[i].render;
+            if (!render) {
+                continue;
+            }
+            stat = provider->waitForRenderFinished(render);
+            // Tiles rendered before an abort stay in the cache
+            *cachedBytes += render->getCachedTilesSize();
+            if (stat == eActionStatusAborted) {
+                aborted = true;
+            }
+            if ( isFailureRetCode(stat) ) {
+                continue;
+            }
+            FrameViewRequestPtr outputRequest = render->getOutputRequest();
+            ImagePtr image = outputRequest ? outputRequest->getRequestedScaleImagePlane() : ImagePtr();
+            ImageCacheEntryPtr cacheEntry = image ? image->getCacheEntry() : ImageCacheEntryPtr();
+            ImageCacheKeyPtr key = cacheEntry ? cacheEntry->getCacheKey() : ImageCacheKeyPtr();
+            if (key) {
+                hashes.push_back( key->getNodeTimeVariantHashKey() );
+            }
+        }
+    }
+
+    {
+        QMutexLocker k(&currentResultsMutex);
+        currentResults.reset();
+    }
+
+    {
+        QMutexLocker k(&statsMutex);
+        stats.prefetchedBytes += *cachedBytes;
+    }
+
+    if (aborted) {
+        QMutexLocker k(&statsMutex);
+        ++stats.nFramesAborted;
+
+        return false;
+    }
+
+    for (std::size_t i = 0; i < hashes.size(); ++i) {
+        addPrefetchedHash(hashes[i]);
+    }
+    if ( !hashes.empty() ) {
+        QMutexLocker k(&statsMutex);
+        ++stats.nFramesPrefetched;
+    }
+
+    return true;
+} // prefetchFrame
+
+void
+ViewerPrefetchScheduler::onAbortRequested(bool /*keepOldestRender*/)
+{
+    RenderFrameResultsContainerPtr results;
+    {
+        QMutexLocker k(&_imp->currentResultsMutex);
+        results = _imp->currentResults;
+    }
+    if (results) {
+        results->abortRenders();
+    }
+}
+
+void
+ViewerPrefetchScheduler::onWaitForAbortCompleted()
+{
+    waitForAllTreeRenders();
+}
+
+void
+ViewerPrefetchScheduler::onWaitForThreadToQuit()
+{
+    waitForAllTreeRenders();
+}
+
+int
+ViewerPrefetchScheduler::renderFramesWithinBudget(const std::vector<TimeValue>& frames,
+                                                  U64 memoryBudget,
+                                                  FrameRenderer* renderer,
+                                                  U64* cachedBytes)
+{
+    *cachedBytes = 0;
+    int nFramesRendered = 0;
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        if (*cachedBytes >= memoryBudget) {
+            break;
+        }
+        U64 frameBytes = 0;
+        bool mustContinue = renderer->renderFrame(frames[i], &frameBytes);
+
+        // Count the tiles of an aborted frame as well: they stay in the cache
+        *cachedBytes += frameBytes;
+        if (!mustContinue) {
+            break;
+        }
+        ++nFramesRendered;
+    }
+
+    return nFramesRendered;
+} // renderFramesWithinBudget
+
+class ViewerPrefetchScheduler::PrefetchFrameRenderer
+    : public ViewerPrefetchScheduler::FrameRenderer
+{
+    ViewerPrefetchScheduler* _scheduler;
+    ViewerNodePtr _viewer;
+    RenderEnginePtr _engine;
+    ViewIdx _view;
+    CacheBasePtr _cache;
+    bool _hasResolvedState;
+    ThreadStateEnum _resolvedState;
+
+public:
+
+    PrefetchFrameRenderer(ViewerPrefetchScheduler* scheduler,
+                          const ViewerNodePtr& viewer,
+                          const RenderEnginePtr& engine,
+                          ViewIdx view)
+    : FrameRenderer()
+    , _scheduler(scheduler)
+    , _viewer(viewer)
+    , _engine(engine)
+    , _view(view)
+    , _cache( appPTR->getTileCache() )
+    , _hasResolvedState(false)
+    , _resolvedState(eThreadStateActive)
+    {
+    }
+
+    virtual ~PrefetchFrameRenderer()
+    {
+    }
+
+    // The state returned by resolveState() when it stopped the prefetch: resolveState() must not be called again
+    bool getResolvedState(ThreadStateEnum* state) const
+    {
+        *state = _resolvedState;
+        return _hasResolvedState;
+    }
+
+    virtual bool renderFrame(TimeValue frame, U64* cachedBytes) OVERRIDE FINAL
+    {
+        *cachedBytes = 0;
+        ThreadStateEnum state = _scheduler->resolveState();
+        if (state != eThreadStateActive) {
+            _hasResolvedState = true;
+            _resolvedState = state;
+
+            return false;
+        }
+
+        // Only prefetch while the viewer does not render anything else
+        if ( _engine->hasActiveRender() || _engine->isDoingSequentialRender() ) {
+            return false;
+        }
+
+        // Do not evict images already in the cache to make room for frames that may never be displayed
+        if ( _cache->getCurrentSize() >= _cache->getMaximumCacheSize() ) {
+            return false;
+        }
+
+        return _scheduler->_imp->prefetchFrame(_viewer, _scheduler->shared_from_this(), frame, _view, cachedBytes);
+    }
+};
+
+GenericSchedulerThread::ThreadStateEnum
+ViewerPrefetchScheduler::threadLoopOnce(const GenericThreadStartArgsPtr& /*inArgs*/)
+{
+    NodePtr viewerNode = _imp->viewer.lock();
+    RenderEnginePtr engine = _imp->renderEngine.lock();
+    if (!viewerNode || !engine) {
+        return resolveState();
+    }
+    ViewerNodePtr viewer = viewerNode->isEffectViewerNode();
+    if ( !viewer || !viewer->isViewerUIVisible() || viewer->isDoingPartialUpdates() ) {
+        return resolveState();
+    }
+
+    SettingsPtr settings = appPTR->getCurrentSettings();
+    std::vector<TimeValue> frames;
+    _imp->getFramesToPrefetch(viewer, settings->getViewerPrefetchMaxFrames(), &frames);
+
+    ViewIdx view = viewer->getRenderViewsCount() > 0 ? viewer->getCurrentRenderView() : ViewIdx(0);
+    PrefetchFrameRenderer renderer(this, viewer, engine, view);
+    U64 cachedBytes;
+    renderFramesWithinBudget(frames, settings->getViewerPrefetchMemoryBudget(), &renderer, &cachedBytes);
+
+    ThreadStateEnum state;
+    if ( renderer.getResolvedState(&state) ) {
+        return state;
+    }
+
+    return resolveState();
+} // threadLoopOnce
+
+NATRON_NAMESPACE_EXIT
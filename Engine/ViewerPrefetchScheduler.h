@@ -0,0 +1,234 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_VIEWERPREFETCHSCHEDULER_H
+#define NATRON_ENGINE_VIEWERPREFETCHSCHEDULER_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <list>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#endif
+
+#include "Global/Enums.h"
+#include "Global/GlobalDefines.h"
+#include "Engine/EngineFwd.h"
+#include "Engine/GenericSchedulerThread.h"
+#include "Engine/TimeValue.h"
+#include "Engine/TreeRenderQueueProvider.h"
+
+NATRON_NAMESPACE_ENTER
+
+/**
+ * @brief Renders in the cache, while the viewer is idle, the frames it is likely to display next, so that playback
+ * and scrubbing find them already rendered.
+ * The frames are predicted from the direction of the last playback, or from the speed and direction at which the
+ * timeline was scrubbed, and stay within the in/out points of the timeline.
+ * Prefetch renders have the eRenderPriorityPrefetch priority so that any other render preempts them, and the
+ * prefetch is aborted by the RenderEngine as soon as a new render of the viewer is requested (e.g: because
+ * a parameter changed) or playback starts. Prefetching stops once the tiles allocated in the image cache by the
+ * prefetch renders reach the memory budget.
+ *
+ * Like ViewerCurrentFrameRequestScheduler, this is not the thread rendering the frames: it launches the renders
+ * of each frame one after another and waits for them.
+ **/
+struct ViewerPrefetchSchedulerPrivate;
+class ViewerPrefetchScheduler
+: public GenericSchedulerThread
+, public TreeRenderQueueProvider
+, public boost::enable_shared_from_this<ViewerPrefetchScheduler>
+{
+protected:
+
+    ViewerPrefetchScheduler(const RenderEnginePtr& renderEngine, const NodePtr& viewer);
+
+    virtual TreeRenderQueueProviderConstPtr getThisTreeRenderQueueProviderShared() const OVERRIDE FINAL
+    {
+        return shared_from_this();
+    }
+
+public:
+
+    static ViewerPrefetchSchedulerPtr create(const RenderEnginePtr& renderEngine, const NodePtr& viewer)
+    {
+        return ViewerPrefetchSchedulerPtr(new ViewerPrefetchScheduler(renderEngine, viewer));
+    }
+
+    virtual ~ViewerPrefetchScheduler();
+
+    struct Stats
+    {
+        // Number of frames rendered by the prefetcher
+        U64 nFramesPrefetched;
+
+        // Number of prefetch renders aborted before they finished
+        U64 nFramesAborted;
+
+        // Size of the tiles allocated in the image cache by the prefetch renders
+        U64 prefetchedBytes;
+
+        // Number of frames displayed by the viewer
+        U64 nFramesDisplayed;
+
+        // Number of frames displayed by the viewer that were prefetched and were still valid
+        U64 nFramesDisplayedPrefetched;
+
+        Stats()
+        : nFramesPrefetched(0)
+        , nFramesAborted(0)
+        , prefetchedBytes(0)
+        , nFramesDisplayed(0)
+        , nFramesDisplayedPrefetched(0)
+        {
+        }
+
+        double getHitRate() const
+        {
+            return nFramesDisplayed ? (double)nFramesDisplayedPrefetched / nFramesDisplayed : 0.;
+        }
+    };
+
+    /**
+     * @brief Start prefetching the frames around the current frame of the timeline. This returns immediately.
+     **/
+    void prefetchFrames();
+
+    /**
+     * @brief Called when the viewer requests a render of the given frame of the timeline, to estimate the
+     * direction and speed of scrubbing.
+     **/
+    void notifyFrameRequested(TimeValue frame);
+
+    /**
+     * @brief Called when playback starts in the given direction. The next prefetches continue in this direction
+     * until the timeline is scrubbed.
+     **/
+    void notifyPlaybackStarted(RenderDirectionEnum direction);
+
+    /**
+     * @brief Called when the viewer displays an image: if the image was prefetched and the parameters did not change
+     * since, this counts as a hit.
+     * @param viewerProcessHash The time/view variant hash of the viewer process node that rendered the image.
+     **/
+    void notifyFrameDisplayed(U64 viewerProcessHash);
+
+    void getStats(Stats* stats) const;
+
+    void resetStats();
+
+    bool isPrefetching() const;
+
+    struct FrameRequest
+    {
+        TimeValue frame;
+
+        // In seconds
+        double timestamp;
+    };
+
+    /**
+     * @brief Returns the direction of scrubbing (-1, 0 or 1) from the frames requested in the last windowSeconds
+     * seconds before now, and the number of frames skipped between two requested frames.
+     * @returns False if not enough frames were requested recently to tell.
+     **/
+    static bool getScrubDirection(const std::list<FrameRequest>& history,
+                                  double now,
+                                  double windowSeconds,
+                                  int* direction,
+                                  int* step);
+
+    /**
+     * @brief Returns in frames the frames to prefetch, in the order they should be rendered.
+     * If direction is 0, the frames around currentFrame are returned, alternatively after and before it.
+     * Otherwise frames are returned every step frames in the given direction, and wrap around or bounce on the
+     * bounds of [firstFrame, lastFrame] depending on the playback mode.
+     * currentFrame is never returned since it is rendered by the viewer.
+     **/
+    static void predictFrames(TimeValue currentFrame,
+                              int direction,
+                              int step,
+                              int firstFrame,
+                              int lastFrame,
+                              PlaybackModeEnum mode,
+                              int maxFrames,
+                              std::vector<TimeValue>* frames);
+
+    /**
+     * @brief Renders the frames passed to renderFramesWithinBudget()
+     **/
+    class FrameRenderer
+    {
+    public:
+
+        FrameRenderer()
+        {
+        }
+
+        virtual ~FrameRenderer()
+        {
+        }
+
+        /**
+         * @brief Renders the given frame in the cache and sets in cachedBytes the size of the tiles the render allocated
+         * in the cache, @see TreeRender::getCachedTilesSize.
+         * @returns False if the prefetch must stop, e.g: because the render was aborted.
+         **/
+        virtual bool renderFrame(TimeValue frame, U64* cachedBytes) = 0;
+    };
+
+    /**
+     * @brief Renders the given frames in order until the tiles allocated in the cache by these renders reach memoryBudget
+     * bytes or the renderer returns false.
+     * @returns The number of frames rendered. The size of the tiles they allocated in the cache is set in cachedBytes.
+     **/
+    static int renderFramesWithinBudget(const std::vector<TimeValue>& frames,
+                                        U64 memoryBudget,
+                                        FrameRenderer* renderer,
+                                        U64* cachedBytes);
+
+private:
+
+    class PrefetchFrameRenderer;
+
+    virtual TaskQueueBehaviorEnum tasksQueueBehaviour() const OVERRIDE FINAL
+    {
+        return eTaskQueueBehaviorSkipToMostRecent;
+    }
+
+    virtual void onAbortRequested(bool keepOldestRender) OVERRIDE FINAL;
+    virtual void onWaitForAbortCompleted() OVERRIDE FINAL;
+    virtual void onWaitForThreadToQuit() OVERRIDE FINAL;
+
+    virtual ThreadStateEnum threadLoopOnce(const GenericThreadStartArgsPtr& inArgs) OVERRIDE FINAL;
+
+    boost::scoped_ptr<ViewerPrefetchSchedulerPrivate> _imp;
+};
+
+NATRON_NAMESPACE_EXIT
+
+#endif // NATRON_ENGINE_VIEWERPREFETCHSCHEDULER_H
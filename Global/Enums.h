@@ -621,6 +621,18 @@ enum CacheAccessModeEnum
     eCacheAccessModeWriteOnly
 };
 
+enum CacheEvictionPolicyTypeEnum
+{
+    // Evict the least recently used entry across the whole cache
+    eCacheEvictionPolicyTypeLRU,
+
+    // Second chance algorithm: an approximation of LRU which is cheaper to maintain on access
+    eCacheEvictionPolicyTypeCLOCK,
+
+    // Evict first entries that were the fastest to render relative to their size (GreedyDual-Size)
+    eCacheEvictionPolicyTypeCostAware
+};
+
 enum ImageBufferLayoutEnum
 {
     // This will make an image with an internal storage composed
@@ -655,6 +667,22 @@ enum RenderBackendTypeEnum
     eRenderBackendTypeOSMesa
 };
 
+// The priority class of a render: renders of a class are scheduled before renders of the classes below it
+enum RenderPriorityEnum
+{
+    // A render the user is waiting for, e.g: the viewer refreshing after a parameter change or while scrubbing
+    eRenderPriorityInteractive = 0,
+
+    // Viewer playback
+    eRenderPriorityPlayback,
+
+    // Render on disk
+    eRenderPriorityBatch,
+
+    // Speculative render of frames that may be needed later
+    eRenderPriorityPrefetch
+};
+
 enum RenderScaleSupportEnum
 {
     eSupportsMaybe = -1, // We don't know yet if the effect supports render scale
@@ -36,6 +36,10 @@
 #include <cstdlib> // malloc
 #include <string.h> // strdup
 #endif
+#if defined(__NATRON_LINUX__) && !defined(__FreeBSD__)
+#include <sched.h> // sched_setaffinity
+#include <fstream>
+#endif
 
 #include "StrUtils.h"
 
@@ -566,6 +570,98 @@ ProcInfo::ensureCommandLineArgsUtf8(int argc, wchar_t **argv, std::vector<std::s
     }
 }
 
+#if defined(__NATRON_LINUX__) && !defined(__FreeBSD__)
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+// The node set by pinCurrentThreadToNUMANode() for the calling thread, -1 if it is not pinned
+static __thread int currentThreadPinnedNUMANode = -1;
+
+// Reads a list such as "0-3,8,10-11" from a sysfs file, as used for node and cpu lists
+static bool
+readSysfsList(const std::string& filePath,
+              std::vector<int>* values)
+{
+    std::ifstream ifs( filePath.c_str() );
+    std::string line;
+    if ( !ifs || !std::getline(ifs, line) ) {
+        return false;
+    }
+    std::stringstream ss(line);
+    std::string range;
+    while ( std::getline(ss, range, ',') ) {
+        int first, last;
+        int nRead = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (nRead <= 0) {
+            continue;
+        } else if (nRead == 1) {
+            last = first;
+        }
+        for (int i = first; i <= last; ++i) {
+            values->push_back(i);
+        }
+    }
+    return !values->empty();
+}
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+#endif // if defined(__NATRON_LINUX__) && !defined(__FreeBSD__)
+
+int
+ProcInfo::getNUMANodesCount()
+{
+#if defined(__NATRON_LINUX__) && !defined(__FreeBSD__)
+    std::vector<int> nodes;
+    if ( !readSysfsList("/sys/devices/system/node/online", &nodes) ) {
+        return 1;
+    }
+    return nodes.back() + 1;
+#else
+    return 1;
+#endif
+}
+
+bool
+ProcInfo::pinCurrentThreadToNUMANode(int node)
+{
+#if defined(__NATRON_LINUX__) && !defined(__FreeBSD__)
+    if (node < 0) {
+        return false;
+    }
+    std::stringstream ss;
+    ss << "/sys/devices/system/node/node" << node << "/cpulist";
+    std::vector<int> cpus;
+    if ( !readSysfsList(ss.str(), &cpus) ) {
+        return false;
+    }
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (std::size_t i = 0; i < cpus.size(); ++i) {
+        if (cpus[i] < CPU_SETSIZE) {
+            CPU_SET(cpus[i], &cpuSet);
+        }
+    }
+    // A pid of 0 is the calling thread
+    if (sched_setaffinity(0, sizeof(cpuSet), &cpuSet) != 0) {
+        return false;
+    }
+    currentThreadPinnedNUMANode = node;
+    return true;
+#else
+    (void)node;
+    return false;
+#endif
+}
+
+int
+ProcInfo::getCurrentThreadPinnedNUMANode()
+{
+#if defined(__NATRON_LINUX__) && !defined(__FreeBSD__)
+    return currentThreadPinnedNUMANode;
+#else
+    return -1;
+#endif
+}
+
 long long
 ProcInfo::getCurrentProcessPID()
 {
@@ -90,6 +90,24 @@ std::string getenv_wrapper(const char *varName);
 void ensureCommandLineArgsUtf8(int argc, char **argv, std::vector<std::string>* utf8Args);
 void ensureCommandLineArgsUtf8(int argc, wchar_t **argv, std::vector<std::string>* utf8Args);
 
+/**
+ * @brief Returns the number of NUMA nodes of the system. On systems without NUMA support, this returns 1.
+ **/
+int getNUMANodesCount();
+
+/**
+ * @brief Restricts the calling thread to run only on the CPUs of the given NUMA node.
+ * Memory allocated by the thread is then allocated on this node.
+ * Returns false if NUMA is not supported or if the node does not exist.
+ **/
+bool pinCurrentThreadToNUMANode(int node);
+
+/**
+ * @brief Returns the NUMA node the calling thread was pinned to with pinCurrentThreadToNUMANode(),
+ * or -1 if it was not pinned.
+ **/
+int getCurrentThreadPinnedNUMANode();
+
 } // namespace ProcInfo
 
 NATRON_NAMESPACE_EXIT
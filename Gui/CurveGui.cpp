@@ -544,11 +544,17 @@ CurveGui::drawCurve(int curveIndex,
             KeyFrame x1Key;
             KeyFrameSet::const_iterator lastUpperIt = keyframes.end();
 
+            // The points that are not keyframes are evaluated all at once once their abscissa is known
+            std::vector<TimeValue> evaluatedTimes;
+            std::vector<std::size_t> evaluatedVertices;
+
             while ( x1 < (widgetWidth - 1) ) {
                 double x, y;
                 if (!isX1AKey) {
                     x = _imp->curveWidget->toZoomCoordinates(x1, 0).x();
-                    y = evaluate(false, x);
+                    y = 0.;
+                    evaluatedTimes.push_back( TimeValue(x) );
+                    evaluatedVertices.push_back( vertices.size() + 1 );
                 } else {
                     x = x1Key.getTime();
                     y = x1Key.getValue();
@@ -562,9 +568,17 @@ CurveGui::drawCurve(int curveIndex,
             //also add the last point
             {
                 double x = _imp->curveWidget->toZoomCoordinates(x1, 0).x();
-                double y = evaluate(false, x);
+                evaluatedTimes.push_back( TimeValue(x) );
+                evaluatedVertices.push_back( vertices.size() + 1 );
                 vertices.push_back( (float)x );
-                vertices.push_back( (float)y );
+                vertices.push_back( 0.f );
+            }
+
+            // Same as evaluate(false, x): the curve is animated
+            std::vector<double> values( evaluatedTimes.size() );
+            getInternalCurve()->getValuesAt(&evaluatedTimes[0], evaluatedTimes.size(), &values[0], false /*doClamp*/);
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                vertices[evaluatedVertices[i]] = (float)values[i];
             }
         } catch (...) {
         }
@@ -35,7 +35,9 @@
 #include <QItemSelectionModel>
 #include <QtCore/QRegExp>
 
+#include "Engine/AppManager.h" // Dialogs
 #include "Engine/Node.h"
+#include "Engine/RenderTracer.h"
 #include "Engine/Timer.h"
 #include "Engine/Utils.h" // convertFromPlainText
 #include "Engine/ViewIdx.h"
@@ -45,6 +47,7 @@
 #include "Gui/Label.h"
 #include "Gui/LineEdit.h"
 #include "Gui/NodeGui.h"
+#include "Gui/SequenceFileDialog.h"
 #include "Gui/TableModelView.h"
 
 
@@ -272,6 +275,9 @@ struct RenderStatsDialogPrivate
     Label* totalTimeSpentValueLabel;
     double totalSpentTime;
     Button* resetButton;
+    Label* recordTimelineLabel;
+    QCheckBox* recordTimelineCheckbox;
+    Button* exportTimelineButton;
     QWidget* filterContainer;
     QHBoxLayout* filterLayout;
     Label* filtersLabel;
@@ -296,6 +302,9 @@ struct RenderStatsDialogPrivate
         , totalTimeSpentValueLabel(0)
         , totalSpentTime(0)
         , resetButton(0)
+        , recordTimelineLabel(0)
+        , recordTimelineCheckbox(0)
+        , exportTimelineButton(0)
         , filterContainer(0)
         , filterLayout(0)
         , filtersLabel(0)
@@ -369,6 +378,27 @@ RenderStatsDialog::RenderStatsDialog(Gui* gui)
     QObject::connect( _imp->resetButton, SIGNAL(clicked(bool)), this, SLOT(resetStats()) );
     _imp->globalInfosLayout->addWidget(_imp->resetButton);
 
+    _imp->globalInfosLayout->addSpacing(10);
+
+    QString timelineTt = NATRON_NAMESPACE::convertFromPlainText(tr("When checked, the tasks run by each thread during renders are recorded "
+                                                                   "so that they can be exported as a timeline.\n"
+                                                                   "The timeline is in the Chrome trace event format and can be opened "
+                                                                   "in chrome://tracing or https://ui.perfetto.dev. Only the most recent tasks "
+                                                                   "of each thread are kept."), NATRON_NAMESPACE::WhiteSpaceNormal);
+    _imp->recordTimelineLabel = new Label(tr("Record timeline:"), _imp->globalInfosContainer);
+    _imp->recordTimelineLabel->setToolTip(timelineTt);
+    _imp->recordTimelineCheckbox = new QCheckBox(_imp->globalInfosContainer);
+    _imp->recordTimelineCheckbox->setChecked( RenderTracer::isEnabled() );
+    _imp->recordTimelineCheckbox->setToolTip(timelineTt);
+    QObject::connect( _imp->recordTimelineCheckbox, SIGNAL(toggled(bool)), this, SLOT(onRecordTimelineToggled(bool)) );
+    _imp->globalInfosLayout->addWidget(_imp->recordTimelineLabel);
+    _imp->globalInfosLayout->addWidget(_imp->recordTimelineCheckbox);
+
+    _imp->exportTimelineButton = new Button(tr("Export Timeline..."), _imp->globalInfosContainer);
+    _imp->exportTimelineButton->setToolTip(timelineTt);
+    QObject::connect( _imp->exportTimelineButton, SIGNAL(clicked(bool)), this, SLOT(onExportTimelineClicked()) );
+    _imp->globalInfosLayout->addWidget(_imp->exportTimelineButton);
+
     _imp->globalInfosLayout->addStretch();
 
     _imp->mainLayout->addWidget(_imp->globalInfosContainer);
@@ -491,6 +521,31 @@ RenderStatsDialog::resetStats()
     _imp->model->clearRows();
     _imp->totalTimeSpentValueLabel->setText( QString::fromUtf8("0.0 sec") );
     _imp->totalSpentTime = 0;
+    RenderTracer::clear();
+}
+
+void
+RenderStatsDialog::onRecordTimelineToggled(bool recording)
+{
+    RenderTracer::setEnabled(recording);
+}
+
+void
+RenderStatsDialog::onExportTimelineClicked()
+{
+    std::vector<std::string> filters;
+    filters.push_back("json");
+    SequenceFileDialog dialog(this, filters, false, SequenceFileDialog::eFileDialogModeSave, "", _imp->gui, false);
+    if ( !dialog.exec() ) {
+        return;
+    }
+    std::string file = dialog.filesToSave();
+    if ( file.empty() ) {
+        return;
+    }
+    if ( !RenderTracer::exportChromeTrace(file) ) {
+        Dialogs::errorDialog( tr("Export Timeline").toStdString(), tr("Failure to write the timeline to %1.").arg( QString::fromUtf8( file.c_str() ) ).toStdString() );
+    }
 }
 
 void
@@ -521,6 +576,7 @@ void
 RenderStatsDialog::closeEvent(QCloseEvent * /*event*/)
 {
     _imp->gui->setRenderStatsEnabled(false);
+    _imp->recordTimelineCheckbox->setChecked(false);
 }
 
 void
@@ -51,6 +51,7 @@
 
 #include "Gui/BackdropGui.h"
 
+#include "Serialization/BinaryProjectSerialization.h"
 #include "Serialization/WorkspaceSerialization.h"
 #include "Serialization/ProjectSerialization.h"
 #include "Serialization/SerializationIO.h"
@@ -367,7 +368,13 @@ printUsage(const std::string& programName)
                               "              The original file(s) will be renamed with the .bak extension.\n"
                               "              If not set the converted file(s) will have the same name as \n"
                               "              the input file with the \"-converted\" suffix before the file\n"
-                              "              extension. When the -o option is set, this option has no effect.\n\n").arg(QString::fromUtf8(programName.c_str()));
+                              "              extension. When the -o option is set, this option has no effect.\n\n"
+                              "-b: Optional: Instead of converting older files, convert .ntp files made with\n"
+                              "              Natron 2.2 or newer to the binary project format, in which\n"
+                              "              animation curves and roto control points are stored in binary\n"
+                              "              and nodes are decoded one at a time when the project is loaded.\n\n"
+                              "-y: Optional: Instead of converting older files, convert binary .ntp files\n"
+                              "              back to the YAML project format.\n\n").arg(QString::fromUtf8(programName.c_str()));
     std::cout << msg.toStdString() << std::endl;
 } // printUsage
 
@@ -381,7 +388,19 @@ static QStringList::iterator hasToken(QStringList &localArgs, const QString& tok
     return localArgs.end();
 } // hasToken
 
-static void parseArgs(const QStringList& appArgs, QString* inputPath, QString* outputPath, bool* replaceOriginal, bool* recurse)
+enum ProjectFormatConversionEnum
+{
+    // Convert files made with Natron 2.1.x and older
+    eProjectFormatConversionNone = 0,
+
+    // Convert projects to the binary project format
+    eProjectFormatConversionToBinary,
+
+    // Convert binary projects to the YAML project format
+    eProjectFormatConversionToYAML
+};
+
+static void parseArgs(const QStringList& appArgs, QString* inputPath, QString* outputPath, bool* replaceOriginal, bool* recurse, ProjectFormatConversionEnum* formatConversion)
 {
     *recurse = false;
     *replaceOriginal = false;
@@ -429,6 +448,19 @@ static void parseArgs(const QStringList& appArgs, QString* inputPath, QString* o
         }
 
     }
+    *formatConversion = eProjectFormatConversionNone;
+    {
+        bool toBinary = hasToken(localArgs, QLatin1String("-b")) != localArgs.end();
+        bool toYAML = hasToken(localArgs, QLatin1String("-y")) != localArgs.end();
+        if (toBinary && toYAML) {
+            throw std::invalid_argument(QString::fromUtf8("-b and -y switches cannot be used together").toStdString());
+        }
+        if (toBinary) {
+            *formatConversion = eProjectFormatConversionToBinary;
+        } else if (toYAML) {
+            *formatConversion = eProjectFormatConversionToYAML;
+        }
+    }
 } // parseArgs
 
 
@@ -576,6 +608,57 @@ static void tryReadAndConvertOlderLayoutFile(const QString& filename, const QStr
 
 } // tryReadAndConvertOlderLayoutFile
 
+/**
+ * @brief Converts a project made with Natron 2.2 or newer, in the YAML or binary project format, to the given format.
+ * Upon failure an exception is thrown.
+ **/
+static void convertProjectFormat(const QString& filename, const QString& outFileName, bool toBinary)
+{
+    SERIALIZATION_NAMESPACE::ProjectSerialization project;
+    // Read the project file in either format
+    {
+        FStreamsSupport::ifstream ifile;
+        FStreamsSupport::open(&ifile, filename.toStdString(), std::ios_base::in | std::ios_base::binary);
+        if (!ifile) {
+            QString message = QString::fromUtf8("Could not open %1").arg(filename);
+            throw std::invalid_argument(message.toStdString());
+        }
+
+        try {
+            if ( SERIALIZATION_NAMESPACE::isBinaryProject(ifile) ) {
+                SERIALIZATION_NAMESPACE::BinaryProjectDataPtr data( new SERIALIZATION_NAMESPACE::BinaryProjectBuffer(ifile) );
+                SERIALIZATION_NAMESPACE::readBinaryProject(data, &project, false);
+            } else {
+                SERIALIZATION_NAMESPACE::read(NATRON_PROJECT_FILE_HEADER, ifile, &project);
+            }
+        } catch (...) {
+            QString message = QString::fromUtf8("%1: Invalid project file").arg(filename);
+            throw std::invalid_argument(message.toStdString());
+        }
+    }
+
+    // Write to converted file
+    {
+        FStreamsSupport::ofstream ofile;
+        FStreamsSupport::open(&ofile, outFileName.toStdString(), std::ios_base::out | std::ios_base::binary);
+        if (!ofile) {
+            QString message = QString::fromUtf8("Could not open %1").arg(outFileName);
+            throw std::invalid_argument(message.toStdString());
+        }
+
+        if (toBinary) {
+            SERIALIZATION_NAMESPACE::writeBinaryProject(ofile, project);
+        } else {
+            SERIALIZATION_NAMESPACE::write(ofile, project, NATRON_PROJECT_FILE_HEADER);
+        }
+        if (!ofile) {
+            QString message = QString::fromUtf8("Failed to write %1").arg(outFileName);
+            throw std::invalid_argument(message.toStdString());
+        }
+    }
+
+} // convertProjectFormat
+
 struct ProcessData
 {
     std::list<std::string> bakFiles;
@@ -583,7 +666,7 @@ struct ProcessData
 };
 
 
-static void convertFile(const QString& filename, const QString& outputFilePathArgs, bool replaceOriginal, ProcessData* data)
+static void convertFile(const QString& filename, const QString& outputFilePathArgs, bool replaceOriginal, ProjectFormatConversionEnum formatConversion, ProcessData* data)
 {
 
     if (!QFile::exists(filename)) {
@@ -599,6 +682,10 @@ static void convertFile(const QString& filename, const QString& outputFilePathAr
         QString message = QString::fromUtf8("%1 does not appear to be a project file or PyPlug script or layout file.").arg(filename);
         throw std::invalid_argument(message.toStdString());
     }
+    if (formatConversion != eProjectFormatConversionNone && !isProjectFile) {
+        QString message = QString::fromUtf8("%1 does not appear to be a project file.").arg(filename);
+        throw std::invalid_argument(message.toStdString());
+    }
 
 
     QString outFileName;
@@ -639,7 +726,9 @@ static void convertFile(const QString& filename, const QString& outputFilePathAr
     }
 
 
-    if (isProjectFile) {
+    if (formatConversion != eProjectFormatConversionNone) {
+        convertProjectFormat(filename, outFileName, formatConversion == eProjectFormatConversionToBinary);
+    } else if (isProjectFile) {
         tryReadAndConvertOlderProject(filename, outFileName);
     } else if (isWorkspaceFile) {
         tryReadAndConvertOlderLayoutFile(filename, outFileName);
@@ -704,7 +793,7 @@ static void convertFile(const QString& filename, const QString& outputFilePathAr
 
 } // convertFile
 
-static bool convertDirectory(const QString& dirPath, bool replaceOriginal, bool recurse, unsigned int recursionLevel, ProcessData* data)
+static bool convertDirectory(const QString& dirPath, bool replaceOriginal, bool recurse, unsigned int recursionLevel, ProjectFormatConversionEnum formatConversion, ProcessData* data)
 {
     QDir originalDir(dirPath);
     if (!originalDir.exists()) {
@@ -723,15 +812,19 @@ static bool convertDirectory(const QString& dirPath, bool replaceOriginal, bool
             QDir subDir(absoluteOriginalFilePath);
             if (subDir.exists()) {
                 if (recurse) {
-                    didSomething |= convertDirectory(absoluteOriginalFilePath, replaceOriginal, recurse, recursionLevel + 1, data);
+                    didSomething |= convertDirectory(absoluteOriginalFilePath, replaceOriginal, recurse, recursionLevel + 1, formatConversion, data);
                 }
                 continue;
             }
         }
 
-        if (it->endsWith(QLatin1String(".ntp")) || it->endsWith(QLatin1String(".nl")) || it->endsWith(QLatin1String(".py"))) {
+        bool isProjectFile = it->endsWith(QLatin1String(".ntp"));
+        if ( (formatConversion != eProjectFormatConversionNone) && !isProjectFile ) {
+            continue;
+        }
+        if (isProjectFile || it->endsWith(QLatin1String(".nl")) || it->endsWith(QLatin1String(".py"))) {
             try {
-                convertFile(absoluteOriginalFilePath, QString(),replaceOriginal, data);
+                convertFile(absoluteOriginalFilePath, QString(),replaceOriginal, formatConversion, data);
             } catch (const std::exception& e) {
                 std::cerr << QString::fromUtf8("Error: %1").arg(QString::fromUtf8(e.what())).toStdString() << std::endl;
                 continue;
@@ -813,8 +906,9 @@ int main(int argc, char *argv[])
     // Parse app args
     QString inputPath, outputPath;
     bool recurse, replaceOriginal;
+    ProjectFormatConversionEnum formatConversion;
     try {
-        parseArgs(arguments, &inputPath, &outputPath, &replaceOriginal, &recurse);
+        parseArgs(arguments, &inputPath, &outputPath, &replaceOriginal, &recurse, &formatConversion);
     } catch (const std::exception &e) {
         std::cerr << QString::fromUtf8("Error while parsing command line arguments: %1").arg(QString::fromUtf8(e.what())).toStdString() << std::endl;
         printUsage(arguments[0].toStdString());
@@ -834,10 +928,10 @@ int main(int argc, char *argv[])
 
         if (info.isDir()) {
             setNatronPathEnvVar(inputPath);
-            convertDirectory(inputPath, replaceOriginal, recurse, 0, &convertData);
+            convertDirectory(inputPath, replaceOriginal, recurse, 0, formatConversion, &convertData);
         } else {
             setNatronPathEnvVar(info.path());
-            convertFile(inputPath, outputPath, replaceOriginal, &convertData);
+            convertFile(inputPath, outputPath, replaceOriginal, formatConversion, &convertData);
         }
     } catch (const std::exception& e) {
         cleanupCreatedFiles(convertData);
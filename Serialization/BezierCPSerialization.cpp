@@ -29,8 +29,21 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
 #include <yaml-cpp/yaml.h>
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 
+#include "Serialization/BinaryProjectSerialization.h"
+
 SERIALIZATION_NAMESPACE_ENTER
 
+void
+BezierCPSerialization::encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const
+{
+    // In a binary project, the point is not written in YAML
+    if (dataBlock) {
+        dataBlock->encodeControlPoint(*this, em);
+    } else {
+        encode(em);
+    }
+}
+
 void
 BezierCPSerialization::encode(YAML::Emitter& em) const
 {
@@ -69,6 +82,16 @@ static void decodeBezierCPCurve(const YAML::Node& node, double* x, CurveSerializ
     }
 }
 
+void
+BezierCPSerialization::decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock)
+{
+    if ( dataBlock && BinaryProjectDataBlock::isReference(node) ) {
+        dataBlock->decodeControlPoint(node, this);
+    } else {
+        decode(node);
+    }
+}
+
 void
 BezierCPSerialization::decode(const YAML::Node& node)
 {
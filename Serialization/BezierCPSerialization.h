@@ -67,6 +67,10 @@ public:
     virtual void encode(YAML::Emitter& em) const OVERRIDE FINAL;
 
     virtual void decode(const YAML::Node& node) OVERRIDE FINAL;
+
+    virtual void encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const OVERRIDE FINAL;
+
+    virtual void decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock) OVERRIDE FINAL;
 };
 
 
@@ -34,11 +34,11 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 SERIALIZATION_NAMESPACE_ENTER
 
 void
-BezierSerialization::encode(YAML::Emitter& em) const
+BezierSerialization::encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const
 {
     em << YAML::BeginMap;
 
-    KnobTableItemSerialization::encode(em);
+    KnobTableItemSerialization::encodeWithDataBlock(em, dataBlock);
     if (_isOpenBezier) {
         em << YAML::Key << "OpenBezier" << YAML::Value << true;
     }
@@ -63,10 +63,10 @@ BezierSerialization::encode(YAML::Emitter& em) const
             for (std::list< ControlPoint >::const_iterator it2 = it->second.controlPoints.begin(); it2 != it->second.controlPoints.end(); ++it2) {
                 em << YAML::BeginMap;
                 em << YAML::Key << "Inner" << YAML::Value;
-                it2->innerPoint.encode(em);
+                it2->innerPoint.encodeWithDataBlock(em, dataBlock);
                 if (it2->featherPoint) {
                     em << YAML::Key << "Feather" << YAML::Value;
-                    it2->featherPoint->encode(em);
+                    it2->featherPoint->encodeWithDataBlock(em, dataBlock);
                 }
                 em << YAML::EndMap;
             }
@@ -83,7 +83,7 @@ BezierSerialization::encode(YAML::Emitter& em) const
     em << YAML::EndMap;
 }
 
-static void decodeShape(const YAML::Node& shapeNode, BezierSerialization::Shape* shape)
+static void decodeShape(const YAML::Node& shapeNode, const BinaryProjectDataBlock* dataBlock, BezierSerialization::Shape* shape)
 {
     if (shapeNode["Finished"]) {
         shape->closed = true;
@@ -96,11 +96,11 @@ static void decodeShape(const YAML::Node& shapeNode, BezierSerialization::Shape*
             BezierSerialization::ControlPoint cp;
             const YAML::Node& cpNode = cpListNode[i];
             if (cpNode["Inner"]) {
-                cp.innerPoint.decode(cpNode["Inner"]);
+                cp.innerPoint.decodeWithDataBlock(cpNode["Inner"], dataBlock);
             }
             if (cpNode["Feather"]) {
                 cp.featherPoint.reset(new BezierCPSerialization);
-                cp.featherPoint->decode(cpNode["Feather"]);
+                cp.featherPoint->decodeWithDataBlock(cpNode["Feather"], dataBlock);
             }
             shape->controlPoints.push_back(cp);
         }
@@ -108,9 +108,9 @@ static void decodeShape(const YAML::Node& shapeNode, BezierSerialization::Shape*
 }
 
 void
-BezierSerialization::decode(const YAML::Node& node)
+BezierSerialization::decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock)
 {
-    KnobTableItemSerialization::decode(node);
+    KnobTableItemSerialization::decodeWithDataBlock(node, dataBlock);
     if (node["OpenBezier"]) {
         _isOpenBezier = true;
     } else {
@@ -123,11 +123,11 @@ BezierSerialization::decode(const YAML::Node& node)
             for (YAML::const_iterator it = shapeNode.begin(); it != shapeNode.end(); ++it) {
                 std::string view = it->first.as<std::string>();
                 Shape& shape = _shapes[view];
-                decodeShape(it->second, &shape);
+                decodeShape(it->second, dataBlock, &shape);
             }
         } else {
             Shape& shape = _shapes["Main"];
-            decodeShape(shapeNode, &shape);
+            decodeShape(shapeNode, dataBlock, &shape);
         }
 
     }
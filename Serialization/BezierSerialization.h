@@ -51,9 +51,9 @@ public:
     {
     }
 
-    virtual void encode(YAML::Emitter& em) const OVERRIDE;
+    virtual void encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const OVERRIDE;
 
-    virtual void decode(const YAML::Node& node) OVERRIDE;
+    virtual void decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock) OVERRIDE;
     
 
     struct ControlPoint
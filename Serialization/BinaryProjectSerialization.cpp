@@ -0,0 +1,632 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "BinaryProjectSerialization.h"
+
+#include <cassert>
+#include <cstring>
+#include <list>
+#include <iterator>
+#include <stdexcept>
+#include <streambuf>
+#include <vector>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/cstdint.hpp>
+#endif
+
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
+#include <yaml-cpp/yaml.h>
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+
+#include "Serialization/BezierCPSerialization.h"
+#include "Serialization/CurveSerialization.h"
+#include "Serialization/NodeSerialization.h"
+#include "Serialization/ProjectSerialization.h"
+#include "Serialization/SerializationIO.h"
+
+// A binary project file is laid out as follows, all integers being little-endian:
+//
+// char[8]  NATRON_BINARY_PROJECT_FILE_MAGIC
+// uint32   NATRON_BINARY_PROJECT_FILE_VERSION
+// uint32   number of top-level nodes
+// uint64   offset of the project block
+// uint64   size of the project block
+// For each top-level node, its index entry:
+//     uint64  offset of the node block
+//     uint64  size of the node block
+//     int32   plug-in major version
+//     int32   plug-in minor version
+//     string  node script-name
+//     string  plug-in ID
+// The project block: the project without its nodes
+// The node blocks
+//
+// A string is its uint32 size followed by its characters.
+//
+// A block is:
+// uint64   size of the YAML part
+// The YAML part: the output of the encode() function of the serialization classes in the YAML flow style
+// The binary part: see BinaryProjectDataBlock
+//
+// Most of the data of a large project is in the keyframes of animation curves and in roto control points.
+// These are written in the binary part, and the YAML part only holds a reference to them:
+// the offset of their data in the binary part, tagged with kBinaryProjectReferenceTag.
+//
+// A curve of type eCurveSerializationTypeScalar is:
+// uint32   number of keyframes
+// For each keyframe:
+//     uint8   interpolation, one of the kKeyframeSerializationType letters, or 0 if none
+//     double  time
+//     double  value
+//     double  right derivative, only for kKeyframeSerializationTypeFree and kKeyframeSerializationTypeBroken
+//     double  left derivative, only for kKeyframeSerializationTypeBroken
+//
+// A roto control point is:
+// uint8    1 if the point is animated, 0 otherwise
+// If animated: the curves x, y, left x, left y, right x, right y
+// Otherwise: the doubles x, y, left x, left y, right x, right y
+//
+// A double is the uint64 holding its IEEE 754 representation.
+
+SERIALIZATION_NAMESPACE_ENTER
+
+static const std::size_t kBinaryProjectMagicSize = 8;
+
+// The tag of the references to the binary part of a block
+#define kBinaryProjectReferenceTag "b"
+
+NATRON_NAMESPACE_ANONYMOUS_ENTER
+
+class BinaryProjectWriter
+{
+    std::string* _buffer;
+
+public:
+
+    explicit BinaryProjectWriter(std::string* buffer)
+    : _buffer(buffer)
+    {
+    }
+
+    void writeU8(unsigned char value)
+    {
+        _buffer->push_back( (char)value );
+    }
+
+    void writeU32(boost::uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i) {
+            _buffer->push_back( (char)( (value >> (i * 8) ) & 0xff ) );
+        }
+    }
+
+    void writeU64(boost::uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i) {
+            _buffer->push_back( (char)( (value >> (i * 8) ) & 0xff ) );
+        }
+    }
+
+    void writeI32(int value)
+    {
+        writeU32( (boost::uint32_t)value );
+    }
+
+    void writeDouble(double value)
+    {
+        boost::uint64_t bits;
+
+        std::memcpy( &bits, &value, sizeof(bits) );
+        writeU64(bits);
+    }
+
+    void writeString(const std::string& str)
+    {
+        writeU32( (boost::uint32_t)str.size() );
+        _buffer->append(str);
+    }
+
+    void writeBytes(const char* data,
+                    std::size_t size)
+    {
+        _buffer->append(data, size);
+    }
+};
+
+class BinaryProjectReader
+{
+    const char* _data;
+    std::size_t _size;
+    std::size_t _pos;
+
+public:
+
+    BinaryProjectReader(const char* data,
+                        std::size_t size)
+    : _data(data)
+    , _size(size)
+    , _pos(0)
+    {
+    }
+
+    void skip(std::size_t size)
+    {
+        ensureAvailable(size);
+        _pos += size;
+    }
+
+    void seek(boost::uint64_t pos)
+    {
+        if (pos > _size) {
+            throw std::runtime_error("Truncated binary project file");
+        }
+        _pos = (std::size_t)pos;
+    }
+
+    unsigned char readU8()
+    {
+        ensureAvailable(1);
+
+        return (unsigned char)_data[_pos++];
+    }
+
+    boost::uint32_t readU32()
+    {
+        ensureAvailable(4);
+        boost::uint32_t ret = 0;
+        for (int i = 0; i < 4; ++i) {
+            ret |= (boost::uint32_t)(unsigned char)_data[_pos + i] << (i * 8);
+        }
+        _pos += 4;
+
+        return ret;
+    }
+
+    boost::uint64_t readU64()
+    {
+        ensureAvailable(8);
+        boost::uint64_t ret = 0;
+        for (int i = 0; i < 8; ++i) {
+            ret |= (boost::uint64_t)(unsigned char)_data[_pos + i] << (i * 8);
+        }
+        _pos += 8;
+
+        return ret;
+    }
+
+    int readI32()
+    {
+        return (int)readU32();
+    }
+
+    double readDouble()
+    {
+        boost::uint64_t bits = readU64();
+        double ret;
+
+        std::memcpy( &ret, &bits, sizeof(ret) );
+
+        return ret;
+    }
+
+    std::string readString()
+    {
+        std::size_t size = readU32();
+
+        ensureAvailable(size);
+        std::string ret(_data + _pos, size);
+        _pos += size;
+
+        return ret;
+    }
+
+private:
+
+    void ensureAvailable(std::size_t size) const
+    {
+        if (size > _size - _pos) {
+            throw std::runtime_error("Truncated binary project file");
+        }
+    }
+};
+
+// Reads a block of the memory of a binary project without copying it
+class BinaryProjectBlockStreamBuf
+    : public std::streambuf
+{
+public:
+
+    BinaryProjectBlockStreamBuf(const char* data,
+                                std::size_t size)
+    {
+        char* begin = const_cast<char*>(data);
+
+        setg(begin, begin, begin + size);
+    }
+};
+
+static void
+encodeBlock(const SerializationObjectBase& obj,
+            std::string* block)
+{
+    YAML::Emitter em;
+    std::string binaryPart;
+    BinaryProjectDataBlock dataBlock(&binaryPart);
+
+    // The flow style does not indent, which makes blocks smaller and faster to parse
+    em.SetMapFormat(YAML::Flow);
+    em.SetSeqFormat(YAML::Flow);
+    obj.encodeWithDataBlock(em, &dataBlock);
+
+    block->clear();
+    BinaryProjectWriter writer(block);
+    writer.writeU64( em.size() );
+    writer.writeBytes( em.c_str(), em.size() );
+    writer.writeBytes( binaryPart.data(), binaryPart.size() );
+}
+
+static void
+checkBlock(const BinaryProjectData& data,
+           boost::uint64_t offset,
+           boost::uint64_t size)
+{
+    if ( (offset > data.getSize()) || (size > data.getSize() - offset) ) {
+        throw std::runtime_error("Truncated binary project file");
+    }
+}
+
+static void
+decodeBlock(const BinaryProjectData& data,
+            boost::uint64_t offset,
+            boost::uint64_t size,
+            SerializationObjectBase* obj)
+{
+    checkBlock(data, offset, size);
+    const char* blockData = data.getData() + offset;
+    BinaryProjectReader reader(blockData, size);
+    boost::uint64_t yamlSize = reader.readU64();
+    reader.skip(yamlSize);
+
+    BinaryProjectDataBlock dataBlock(blockData + 8 + yamlSize, size - 8 - yamlSize);
+    BinaryProjectBlockStreamBuf buf(blockData + 8, yamlSize);
+    std::istream stream(&buf);
+    obj->decodeWithDataBlock(YAML::Load(stream), &dataBlock);
+}
+
+// Decodes a top-level node the first time it is needed
+class BinaryProjectNodeDecoder
+    : public NodeSerializationDecoderI
+{
+    BinaryProjectDataPtr _data;
+    boost::uint64_t _offset, _size;
+
+public:
+
+    BinaryProjectNodeDecoder(const BinaryProjectDataPtr& data,
+                             boost::uint64_t offset,
+                             boost::uint64_t size)
+    : NodeSerializationDecoderI()
+    , _data(data)
+    , _offset(offset)
+    , _size(size)
+    {
+    }
+
+    virtual ~BinaryProjectNodeDecoder()
+    {
+    }
+
+    virtual void decodeNode(NodeSerialization* serialization) OVERRIDE FINAL
+    {
+        decodeBlock(*_data, _offset, _size, serialization);
+    }
+};
+
+NATRON_NAMESPACE_ANONYMOUS_EXIT
+
+BinaryProjectDataBlock::BinaryProjectDataBlock(std::string* buffer)
+: _buffer(buffer)
+, _data(0)
+, _size(0)
+{
+}
+
+BinaryProjectDataBlock::BinaryProjectDataBlock(const char* data,
+                                               std::size_t size)
+: _buffer(0)
+, _data(data)
+, _size(size)
+{
+}
+
+bool
+BinaryProjectDataBlock::isReference(const YAML::Node& node)
+{
+    return node.IsScalar() && node.Tag() == "!" kBinaryProjectReferenceTag;
+}
+
+static void
+writeCurveKeyFrames(const CurveSerialization& curve,
+                    BinaryProjectWriter* writer)
+{
+    assert(curve.curveType == eCurveSerializationTypeScalar);
+    writer->writeU32( (boost::uint32_t)curve.keys.size() );
+    for (std::list<KeyFrameSerialization>::const_iterator it = curve.keys.begin(); it != curve.keys.end(); ++it) {
+        // Interpolations are single letters, see KeyFrameSerialization
+        if ( it->interpolation.size() > 1 ) {
+            throw std::invalid_argument("Invalid keyframe interpolation " + it->interpolation);
+        }
+        writer->writeU8( it->interpolation.empty() ? 0 : (unsigned char)it->interpolation[0] );
+        writer->writeDouble(it->time);
+        writer->writeDouble(it->value);
+        if ( (it->interpolation == kKeyframeSerializationTypeFree) || (it->interpolation == kKeyframeSerializationTypeBroken) ) {
+            writer->writeDouble(it->rightDerivative);
+        }
+        if (it->interpolation == kKeyframeSerializationTypeBroken) {
+            writer->writeDouble(it->leftDerivative);
+        }
+    }
+}
+
+static void
+readCurveKeyFrames(BinaryProjectReader* reader,
+                   CurveSerialization* curve)
+{
+    curve->curveType = eCurveSerializationTypeScalar;
+    curve->keys.clear();
+
+    boost::uint32_t nKeys = reader->readU32();
+    for (boost::uint32_t i = 0; i < nKeys; ++i) {
+        KeyFrameSerialization keyframe;
+        unsigned char interpolation = reader->readU8();
+        if (interpolation) {
+            keyframe.interpolation.assign(1, (char)interpolation);
+        }
+        keyframe.time = reader->readDouble();
+        keyframe.value = reader->readDouble();
+        keyframe.rightDerivative = keyframe.leftDerivative = 0.;
+        if ( (keyframe.interpolation == kKeyframeSerializationTypeFree) || (keyframe.interpolation == kKeyframeSerializationTypeBroken) ) {
+            keyframe.rightDerivative = reader->readDouble();
+        }
+        if (keyframe.interpolation == kKeyframeSerializationTypeBroken) {
+            keyframe.leftDerivative = reader->readDouble();
+        }
+        curve->keys.push_back(keyframe);
+    }
+}
+
+void
+BinaryProjectDataBlock::encodeCurve(const CurveSerialization& curve,
+                                    YAML::Emitter& em)
+{
+    assert(_buffer);
+    boost::uint64_t offset = _buffer->size();
+    BinaryProjectWriter writer(_buffer);
+    writeCurveKeyFrames(curve, &writer);
+    em << YAML::LocalTag(kBinaryProjectReferenceTag) << offset;
+}
+
+void
+BinaryProjectDataBlock::decodeCurve(const YAML::Node& reference,
+                                    CurveSerialization* curve) const
+{
+    if (!_data) {
+        throw std::runtime_error("Binary project data referenced outside of a binary project");
+    }
+    BinaryProjectReader reader(_data, _size);
+    reader.seek( reference.as<boost::uint64_t>() );
+    readCurveKeyFrames(&reader, curve);
+}
+
+void
+BinaryProjectDataBlock::encodeControlPoint(const BezierCPSerialization& cp,
+                                           YAML::Emitter& em)
+{
+    assert(_buffer);
+    boost::uint64_t offset = _buffer->size();
+    BinaryProjectWriter writer(_buffer);
+    if ( cp.xCurve.keys.empty() ) {
+        writer.writeU8(0);
+        writer.writeDouble(cp.x);
+        writer.writeDouble(cp.y);
+        writer.writeDouble(cp.leftX);
+        writer.writeDouble(cp.leftY);
+        writer.writeDouble(cp.rightX);
+        writer.writeDouble(cp.rightY);
+    } else {
+        writer.writeU8(1);
+        writeCurveKeyFrames(cp.xCurve, &writer);
+        writeCurveKeyFrames(cp.yCurve, &writer);
+        writeCurveKeyFrames(cp.leftCurveX, &writer);
+        writeCurveKeyFrames(cp.leftCurveY, &writer);
+        writeCurveKeyFrames(cp.rightCurveX, &writer);
+        writeCurveKeyFrames(cp.rightCurveY, &writer);
+    }
+    em << YAML::LocalTag(kBinaryProjectReferenceTag) << offset;
+}
+
+static void
+readControlPointCurve(BinaryProjectReader* reader,
+                      double* x,
+                      CurveSerialization* curve)
+{
+    readCurveKeyFrames(reader, curve);
+    // Same as when decoding from YAML: the static value is the value of the first keyframe
+    if ( !curve->keys.empty() ) {
+        *x = curve->keys.front().value;
+    }
+}
+
+void
+BinaryProjectDataBlock::decodeControlPoint(const YAML::Node& reference,
+                                           BezierCPSerialization* cp) const
+{
+    if (!_data) {
+        throw std::runtime_error("Binary project data referenced outside of a binary project");
+    }
+    BinaryProjectReader reader(_data, _size);
+    reader.seek( reference.as<boost::uint64_t>() );
+    if ( reader.readU8() ) {
+        readControlPointCurve(&reader, &cp->x, &cp->xCurve);
+        readControlPointCurve(&reader, &cp->y, &cp->yCurve);
+        readControlPointCurve(&reader, &cp->leftX, &cp->leftCurveX);
+        readControlPointCurve(&reader, &cp->leftY, &cp->leftCurveY);
+        readControlPointCurve(&reader, &cp->rightX, &cp->rightCurveX);
+        readControlPointCurve(&reader, &cp->rightY, &cp->rightCurveY);
+    } else {
+        cp->x = reader.readDouble();
+        cp->y = reader.readDouble();
+        cp->leftX = reader.readDouble();
+        cp->leftY = reader.readDouble();
+        cp->rightX = reader.readDouble();
+        cp->rightY = reader.readDouble();
+    }
+}
+
+BinaryProjectBuffer::BinaryProjectBuffer(std::istream& stream)
+: BinaryProjectData()
+, _buffer( (std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>() )
+{
+}
+
+bool
+isBinaryProject(std::istream& stream)
+{
+    std::istream::pos_type pos = stream.tellg();
+    char magic[kBinaryProjectMagicSize];
+
+    stream.read(magic, kBinaryProjectMagicSize);
+    bool ret = stream.gcount() == (std::streamsize)kBinaryProjectMagicSize && std::memcmp(magic, NATRON_BINARY_PROJECT_FILE_MAGIC, kBinaryProjectMagicSize) == 0;
+    stream.clear();
+    stream.seekg(pos);
+
+    return ret;
+}
+
+void
+writeBinaryProject(std::ostream& stream,
+                   const ProjectSerialization& obj)
+{
+    // Encode the project without its nodes, and each node separately
+    std::string projectBlock;
+    {
+        ProjectSerialization projectWithoutNodes = obj;
+        projectWithoutNodes._nodes.clear();
+        encodeBlock(projectWithoutNodes, &projectBlock);
+    }
+    std::vector<std::string> nodeBlocks( obj._nodes.size() );
+    {
+        std::size_t i = 0;
+        for (NodeSerializationList::const_iterator it = obj._nodes.begin(); it != obj._nodes.end(); ++it, ++i) {
+            (*it)->decodeIfNeeded();
+            encodeBlock(**it, &nodeBlocks[i]);
+        }
+    }
+
+    // The index is written before the blocks: compute its size first to know the blocks offsets
+    std::size_t headerSize = kBinaryProjectMagicSize + 4 + 4 + 8 + 8;
+    for (NodeSerializationList::const_iterator it = obj._nodes.begin(); it != obj._nodes.end(); ++it) {
+        headerSize += 8 + 8 + 4 + 4 + 4 + (*it)->_nodeScriptName.size() + 4 + (*it)->_pluginID.size();
+    }
+
+    std::string header;
+    BinaryProjectWriter writer(&header);
+    writer.writeBytes(NATRON_BINARY_PROJECT_FILE_MAGIC, kBinaryProjectMagicSize);
+    writer.writeU32(NATRON_BINARY_PROJECT_FILE_VERSION);
+    writer.writeU32( (boost::uint32_t)obj._nodes.size() );
+    writer.writeU64(headerSize);
+    writer.writeU64( projectBlock.size() );
+
+    boost::uint64_t offset = headerSize + projectBlock.size();
+    {
+        std::size_t i = 0;
+        for (NodeSerializationList::const_iterator it = obj._nodes.begin(); it != obj._nodes.end(); ++it, ++i) {
+            writer.writeU64(offset);
+            writer.writeU64( nodeBlocks[i].size() );
+            writer.writeI32( (*it)->_pluginMajorVersion );
+            writer.writeI32( (*it)->_pluginMinorVersion );
+            writer.writeString( (*it)->_nodeScriptName );
+            writer.writeString( (*it)->_pluginID );
+            offset += nodeBlocks[i].size();
+        }
+    }
+    assert(header.size() == headerSize);
+
+    stream.write( header.data(), header.size() );
+    stream.write( projectBlock.data(), projectBlock.size() );
+    for (std::size_t i = 0; i < nodeBlocks.size(); ++i) {
+        stream.write( nodeBlocks[i].data(), nodeBlocks[i].size() );
+    }
+} // writeBinaryProject
+
+void
+readBinaryProject(const BinaryProjectDataPtr& data,
+                  ProjectSerialization* obj,
+                  bool decodeNodesLazily)
+{
+    if (!data || !obj) {
+        throw std::invalid_argument("Invalid serialization object");
+    }
+    if ( (data->getSize() < kBinaryProjectMagicSize) || (std::memcmp(data->getData(), NATRON_BINARY_PROJECT_FILE_MAGIC, kBinaryProjectMagicSize) != 0) ) {
+        throw InvalidSerializationFileException();
+    }
+
+    BinaryProjectReader reader( data->getData(), data->getSize() );
+    reader.skip(kBinaryProjectMagicSize);
+    boost::uint32_t version = reader.readU32();
+    if (version != NATRON_BINARY_PROJECT_FILE_VERSION) {
+        throw std::runtime_error("Unsupported binary project file version");
+    }
+    boost::uint32_t nNodes = reader.readU32();
+    boost::uint64_t projectOffset = reader.readU64();
+    boost::uint64_t projectSize = reader.readU64();
+
+    // Read the index. Each node only holds what is needed to create it until it is decoded
+    NodeSerializationList nodes;
+    for (boost::uint32_t i = 0; i < nNodes; ++i) {
+        boost::uint64_t nodeOffset = reader.readU64();
+        boost::uint64_t nodeSize = reader.readU64();
+        checkBlock(*data, nodeOffset, nodeSize);
+
+        NodeSerializationPtr node(new NodeSerialization);
+        node->_pluginMajorVersion = reader.readI32();
+        node->_pluginMinorVersion = reader.readI32();
+        node->_nodeScriptName = reader.readString();
+        node->_nodeLabel = node->_nodeScriptName;
+        node->_pluginID = reader.readString();
+        node->_pendingDecoder.reset( new BinaryProjectNodeDecoder(data, nodeOffset, nodeSize) );
+        nodes.push_back(node);
+    }
+
+    decodeBlock(*data, projectOffset, projectSize, obj);
+    if (!decodeNodesLazily) {
+        for (NodeSerializationList::const_iterator it = nodes.begin(); it != nodes.end(); ++it) {
+            (*it)->decodeIfNeeded();
+        }
+    }
+    obj->_nodes.insert( obj->_nodes.end(), nodes.begin(), nodes.end() );
+} // readBinaryProject
+
+SERIALIZATION_NAMESPACE_EXIT
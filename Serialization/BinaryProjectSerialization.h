@@ -0,0 +1,183 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef BINARYPROJECTSERIALIZATION_H
+#define BINARYPROJECTSERIALIZATION_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include "Global/Macros.h"
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include "Serialization/SerializationFwd.h"
+
+// The first bytes of a binary project file
+#define NATRON_BINARY_PROJECT_FILE_MAGIC "NatronBP"
+
+// Incremented each time the layout of binary project files changes
+#define NATRON_BINARY_PROJECT_FILE_VERSION 2
+
+SERIALIZATION_NAMESPACE_ENTER
+
+/**
+ * @brief The memory holding an entire binary project file, e.g: a memory mapped file.
+ * It is kept alive as long as some nodes read from it were not decoded.
+ **/
+class BinaryProjectData
+{
+public:
+
+    BinaryProjectData()
+    {
+
+    }
+
+    virtual ~BinaryProjectData()
+    {
+
+    }
+
+    virtual const char* getData() const = 0;
+
+    virtual std::size_t getSize() const = 0;
+};
+
+typedef boost::shared_ptr<BinaryProjectData> BinaryProjectDataPtr;
+
+/**
+ * @brief A binary project file read from a stream into memory, for files that cannot be mapped.
+ **/
+class BinaryProjectBuffer
+    : public BinaryProjectData
+{
+    std::string _buffer;
+
+public:
+
+    explicit BinaryProjectBuffer(std::istream& stream);
+
+    virtual ~BinaryProjectBuffer()
+    {
+
+    }
+
+    virtual const char* getData() const OVERRIDE FINAL
+    {
+        return _buffer.data();
+    }
+
+    virtual std::size_t getSize() const OVERRIDE FINAL
+    {
+        return _buffer.size();
+    }
+};
+
+/**
+ * @brief The binary part of a block of a binary project: the keyframes of the scalar curves and the roto control points.
+ * It is passed to the encodeWithDataBlock() and decodeWithDataBlock() functions of the serialization objects:
+ * CurveSerialization and BezierCPSerialization objects write (or read) their data in this block and only a reference
+ * to it in the YAML part of the block.
+ **/
+class BinaryProjectDataBlock
+{
+public:
+
+    /**
+     * @brief Curves and control points encoded with this block are appended to buffer.
+     **/
+    explicit BinaryProjectDataBlock(std::string* buffer);
+
+    /**
+     * @brief Curves and control points decoded with this block are read from the given memory.
+     **/
+    BinaryProjectDataBlock(const char* data, std::size_t size);
+
+    /**
+     * @brief Returns true if node is a reference written by encodeCurve() or encodeControlPoint().
+     **/
+    static bool isReference(const YAML::Node& node);
+
+    /**
+     * @brief Appends the keyframes of a curve of type eCurveSerializationTypeScalar and writes a reference to them.
+     **/
+    void encodeCurve(const CurveSerialization& curve, YAML::Emitter& em);
+
+    /**
+     * @brief Reads the keyframes of a curve from a reference. Upon failure an exception is thrown.
+     **/
+    void decodeCurve(const YAML::Node& reference, CurveSerialization* curve) const;
+
+    /**
+     * @brief Appends a control point, static or animated, and writes a reference to it.
+     **/
+    void encodeControlPoint(const BezierCPSerialization& cp, YAML::Emitter& em);
+
+    /**
+     * @brief Reads a control point from a reference. Upon failure an exception is thrown.
+     **/
+    void decodeControlPoint(const YAML::Node& reference, BezierCPSerialization* cp) const;
+
+private:
+
+    // When encoding, where the data is appended
+    std::string* _buffer;
+
+    // When decoding, the data to read
+    const char* _data;
+    std::size_t _size;
+};
+
+/**
+ * @brief Returns true if the stream starts with NATRON_BINARY_PROJECT_FILE_MAGIC.
+ * The position of the stream is left unchanged.
+ **/
+bool isBinaryProject(std::istream& stream);
+
+/**
+ * @brief Write a project in the binary project format. In this format each top-level node is encoded
+ * separately and indexed at the start of the file, so that nodes can be decoded one at a time when loading.
+ * The keyframes of curves and the roto control points are stored in binary, see BinaryProjectDataBlock.
+ * Nodes of the project that were not decoded yet are decoded first.
+ **/
+void writeBinaryProject(std::ostream& stream, const ProjectSerialization& obj);
+
+/**
+ * @brief Read a project written with writeBinaryProject(). Upon failure an exception is thrown:
+ * if the data is not a binary project, this function throws a InvalidSerializationFileException exception.
+ * @param decodeNodesLazily If true, only the script-name, plug-in ID and plug-in version of the top-level nodes
+ * are read from the index: each node is decoded by NodeSerialization::decodeIfNeeded(), which keeps
+ * a reference to data until then. Otherwise all nodes are decoded by this function.
+ **/
+void readBinaryProject(const BinaryProjectDataPtr& data, ProjectSerialization* obj, bool decodeNodesLazily);
+
+SERIALIZATION_NAMESPACE_EXIT
+
+#endif // BINARYPROJECTSERIALIZATION_H
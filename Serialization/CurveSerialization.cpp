@@ -29,8 +29,21 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
 #include <yaml-cpp/yaml.h>
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 
+#include "Serialization/BinaryProjectSerialization.h"
+
 SERIALIZATION_NAMESPACE_ENTER
 
+void
+CurveSerialization::encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const
+{
+    // In a binary project, the keyframes are not written in YAML
+    if (dataBlock && curveType == eCurveSerializationTypeScalar) {
+        dataBlock->encodeCurve(*this, em);
+    } else {
+        encode(em);
+    }
+}
+
 void
 CurveSerialization::encode(YAML::Emitter& em) const
 {
@@ -134,9 +147,23 @@ enum CurveDecodeStateEnum
 
 };
 
+void
+CurveSerialization::decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock)
+{
+    if ( dataBlock && BinaryProjectDataBlock::isReference(node) ) {
+        dataBlock->decodeCurve(node, this);
+    } else {
+        decode(node);
+    }
+}
+
 void
 CurveSerialization::decode(const YAML::Node& node)
 {
+    if ( BinaryProjectDataBlock::isReference(node) ) {
+        // A reference to the binary part of a block of a binary project, see decodeWithDataBlock()
+        throw YAML::InvalidNode();
+    }
     if (!node.IsSequence()) {
         return;
     }
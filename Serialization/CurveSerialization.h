@@ -134,6 +134,10 @@ public:
 
     virtual void decode(const YAML::Node& node) OVERRIDE FINAL;
 
+    virtual void encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const OVERRIDE FINAL;
+
+    virtual void decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock) OVERRIDE FINAL;
+
 };
 
 SERIALIZATION_NAMESPACE_EXIT
@@ -101,7 +101,7 @@ static SerializationValueVariantTypeEnum dataTypeFromString(const std::string& t
     throw std::invalid_argument("Unknown value type " + type);
 }
 
-static void encodeCurve(YAML::Emitter& em, const CurveSerialization& curve)
+static void encodeCurve(YAML::Emitter& em, const CurveSerialization& curve, BinaryProjectDataBlock* dataBlock)
 {
     switch (curve.curveType) {
         case eCurveSerializationTypeString:
@@ -115,12 +115,18 @@ static void encodeCurve(YAML::Emitter& em, const CurveSerialization& curve)
             break;
     }
 
-    curve.encode(em);
+    curve.encodeWithDataBlock(em, dataBlock);
 
 }
 
 void
 KnobSerialization::encode(YAML::Emitter& em) const
+{
+    encodeWithDataBlock(em, 0);
+}
+
+void
+KnobSerialization::encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const
 {
     if (!_mustSerialize || _values.empty()) {
         return;
@@ -211,7 +217,7 @@ KnobSerialization::encode(YAML::Emitter& em) const
                         }
                         // Also serialize the curve in case the expression fails to restore correctly
                         if (!val._animationCurve.keys.empty()) {
-                            encodeCurve(em, val._animationCurve);
+                            encodeCurve(em, val._animationCurve, dataBlock);
                         }
 
                         em << YAML::EndMap;
@@ -236,13 +242,13 @@ KnobSerialization::encode(YAML::Emitter& em) const
 
                         // Also serialize the curve in case the expression fails to restore correctly
                         if (!val._animationCurve.keys.empty()) {
-                            encodeCurve(em, val._animationCurve);
+                            encodeCurve(em, val._animationCurve, dataBlock);
                         }
 
                         em << YAML::EndMap;
                     } else if (!val._animationCurve.keys.empty()) {
                         em << YAML::Flow << YAML::BeginMap;
-                        encodeCurve(em, val._animationCurve);
+                        encodeCurve(em, val._animationCurve, dataBlock);
                         em << YAML::EndMap;
                     } else {
                         // No animation or link, directly write the value without a map
@@ -372,7 +378,7 @@ KnobSerialization::encode(YAML::Emitter& em) const
 
                     em << YAML::BeginSeq;
                     for (std::list<CurveSerialization>::const_iterator it2 = it->second.begin(); it2!=it->second.end(); ++it2) {
-                        it2->encode(em);
+                        it2->encodeWithDataBlock(em, dataBlock);
                     }
                     em << YAML::EndSeq;
 
@@ -551,7 +557,7 @@ KnobSerialization::encode(YAML::Emitter& em) const
     }
 
     em << YAML::EndMap;
-} // KnobSerialization::encode
+} // KnobSerialization::encodeWithDataBlock
 
 template <typename T>
 static T* getOrCreateExtraData(boost::scoped_ptr<TypeExtraData>& extraData)
@@ -620,7 +626,7 @@ static void initValuesVec(KnobSerialization* knob, KnobSerialization::PerDimensi
 }
 
 void
-KnobSerialization::decodeValueNode(const std::string& viewName, const YAML::Node& node)
+KnobSerialization::decodeValueNode(const std::string& viewName, const YAML::Node& node, const BinaryProjectDataBlock* dataBlock)
 {
 
     int nDims = 1;
@@ -646,13 +652,13 @@ KnobSerialization::decodeValueNode(const std::string& viewName, const YAML::Node
             if (dimNode["Curve"]) {
                 // Curve
                 dimVec[i]._animationCurve.curveType = eCurveSerializationTypeScalar;
-                dimVec[i]._animationCurve.decode(dimNode["Curve"]);
+                dimVec[i]._animationCurve.decodeWithDataBlock(dimNode["Curve"], dataBlock);
             } else if (dimNode["StringAnimation"]) {
                 dimVec[i]._animationCurve.curveType = eCurveSerializationTypeString;
-                dimVec[i]._animationCurve.decode(dimNode["StringAnimation"]);
+                dimVec[i]._animationCurve.decodeWithDataBlock(dimNode["StringAnimation"], dataBlock);
             } else if (dimNode["CustomAnimation"]) {
                 dimVec[i]._animationCurve.curveType = eCurveSerializationTypePropertiesOnly;
-                dimVec[i]._animationCurve.decode(dimNode["CustomAnimation"]);
+                dimVec[i]._animationCurve.decodeWithDataBlock(dimNode["CustomAnimation"], dataBlock);
             }
 
             // Look for a link or expression
@@ -702,7 +708,7 @@ KnobSerialization::decodeValueNode(const std::string& viewName, const YAML::Node
 } //decodeValueNode
 
 bool
-KnobSerialization::checkForValueNode(const YAML::Node& node, const std::string& nodeType)
+KnobSerialization::checkForValueNode(const YAML::Node& node, const std::string& nodeType, const BinaryProjectDataBlock* dataBlock)
 {
 
     if (!node[nodeType]) {
@@ -718,15 +724,15 @@ KnobSerialization::checkForValueNode(const YAML::Node& node, const std::string&
     // Check to find any of the keys of a single dimension map. If we find it, that means
     // this is not the multi-view map and that this is a single-dimensional knob
     if (!valueNode.IsMap()) {
-        decodeValueNode("Main", valueNode);
+        decodeValueNode("Main", valueNode, dataBlock);
     } else {
         if (valueNode["Curve"] || valueNode["StringAnimation"] || valueNode["CustomAnimation"] || valueNode["pyMultiExpr"] || valueNode["pyExpr"] || valueNode["exprtk"] || valueNode["N"] || valueNode["T"] ||
             valueNode["K"] || valueNode["D"] || valueNode["V"]) {
-            decodeValueNode("Main", valueNode);
+            decodeValueNode("Main", valueNode, dataBlock);
         } else {
             // Multi-view
             for (YAML::const_iterator it = valueNode.begin(); it != valueNode.end(); ++it) {
-                decodeValueNode(it->first.as<std::string>(), it->second);
+                decodeValueNode(it->first.as<std::string>(), it->second, dataBlock);
             }
         }
     }
@@ -768,6 +774,12 @@ KnobSerialization::checkForDefaultValueNode(const YAML::Node& node, const std::s
 
 void
 KnobSerialization::decode(const YAML::Node& node)
+{
+    decodeWithDataBlock(node, 0);
+}
+
+void
+KnobSerialization::decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock)
 {
     if (!node.IsMap()) {
         return;
@@ -782,7 +794,7 @@ KnobSerialization::decode(const YAML::Node& node)
     bool dataTypeSet = false;
     static const std::string typesToCheck[6] = { kKnobSerializationDataTypeKeyBool, kKnobSerializationDataTypeKeyInt, kKnobSerializationDataTypeKeyDouble, kKnobSerializationDataTypeKeyString, kKnobSerializationDataTypeKeyTable, kKnobSerializationDataTypeKeyNone };
     for (int i = 0; i < 6; ++i) {
-        if (checkForValueNode(node, typesToCheck[i])) {
+        if (checkForValueNode(node, typesToCheck[i], dataBlock)) {
             dataTypeSet = true;
             break;
         }
@@ -806,7 +818,7 @@ KnobSerialization::decode(const YAML::Node& node)
                 for (std::size_t i = 0; i < curvesViewNode.size(); ++i) {
                     CurveSerialization s;
                     s.curveType = eCurveSerializationTypeScalar;
-                    s.decode(curvesViewNode[i]);
+                    s.decodeWithDataBlock(curvesViewNode[i], dataBlock);
                     curvesList.push_back(s);
                 }
 
@@ -816,7 +828,7 @@ KnobSerialization::decode(const YAML::Node& node)
             for (std::size_t i = 0; i < curveNode.size(); ++i) {
                 CurveSerialization s;
                 s.curveType = eCurveSerializationTypeScalar;
-                s.decode(curveNode[i]);
+                s.decodeWithDataBlock(curveNode[i], dataBlock);
                 curvesList.push_back(s);
             }
         }
@@ -996,11 +1008,17 @@ KnobSerialization::decode(const YAML::Node& node)
 
     }
     
-} // KnobSerialization::decode
+} // KnobSerialization::decodeWithDataBlock
 
 
 void
 GroupKnobSerialization::encode(YAML::Emitter& em) const
+{
+    encodeWithDataBlock(em, 0);
+}
+
+void
+GroupKnobSerialization::encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const
 {
     em << YAML::BeginMap;
 
@@ -1013,7 +1031,7 @@ GroupKnobSerialization::encode(YAML::Emitter& em) const
     if (!_children.empty()) {
         em << YAML::Key << "Params" << YAML::Value << YAML::BeginSeq;
         for (std::list <boost::shared_ptr<KnobSerializationBase> >::const_iterator it = _children.begin(); it!=_children.end(); ++it) {
-            (*it)->encode(em);
+            (*it)->encodeWithDataBlock(em, dataBlock);
         }
         em << YAML::EndSeq;
     }
@@ -1038,10 +1056,16 @@ GroupKnobSerialization::encode(YAML::Emitter& em) const
         em << YAML::EndSeq;
     }
     em << YAML::EndMap;
-} // GroupKnobSerialization::encode
+} // GroupKnobSerialization::encodeWithDataBlock
 
 void
 GroupKnobSerialization::decode(const YAML::Node& node)
+{
+    decodeWithDataBlock(node, 0);
+}
+
+void
+GroupKnobSerialization::decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock)
 {
     _typeName = node["TypeName"].as<std::string>();
     _name = node["Name"].as<std::string>();
@@ -1062,11 +1086,11 @@ GroupKnobSerialization::decode(const YAML::Node& node)
 
             if (typeName == kKnobPageTypeName || typeName == kKnobGroupTypeName) {
                 GroupKnobSerializationPtr s(new GroupKnobSerialization);
-                s->decode(paramsNode[i]);
+                s->decodeWithDataBlock(paramsNode[i], dataBlock);
                 _children.push_back(s);
             } else {
                 KnobSerializationPtr s (new KnobSerialization);
-                s->decode(paramsNode[i]);
+                s->decodeWithDataBlock(paramsNode[i], dataBlock);
                 _children.push_back(s);
             }
         }
@@ -1085,6 +1109,6 @@ GroupKnobSerialization::decode(const YAML::Node& node)
             }
         }
     }
-} // GroupKnobSerialization::decode
+} // GroupKnobSerialization::decodeWithDataBlock
 
 SERIALIZATION_NAMESPACE_EXIT
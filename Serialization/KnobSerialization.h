@@ -495,17 +495,21 @@ public:
 
     virtual void decode(const YAML::Node& node) OVERRIDE;
 
+    virtual void encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const OVERRIDE;
+
+    virtual void decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock) OVERRIDE;
+
 
     template<class Archive>
     void serialize(Archive & ar, const unsigned int version);
 
 private:
 
-    bool checkForValueNode(const YAML::Node& node, const std::string& nodeType);
+    bool checkForValueNode(const YAML::Node& node, const std::string& nodeType, const BinaryProjectDataBlock* dataBlock);
 
     bool checkForDefaultValueNode(const YAML::Node& node, const std::string& nodeType, bool dataTypeSet);
 
-    void decodeValueNode(const std::string& viewName, const YAML::Node& node);
+    void decodeValueNode(const std::string& viewName, const YAML::Node& node, const BinaryProjectDataBlock* dataBlock);
 
 };
 
@@ -556,6 +560,10 @@ public:
 
     virtual void decode(const YAML::Node& node) OVERRIDE;
 
+    virtual void encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const OVERRIDE;
+
+    virtual void decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock) OVERRIDE;
+
 
     template<class Archive>
     void serialize(Archive & ar, const unsigned int version);
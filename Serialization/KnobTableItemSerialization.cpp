@@ -70,6 +70,12 @@ static KnobTableItemSerializationPtr createSerializationObjectForItemTag(const s
 
 void
 KnobTableItemSerialization::encode(YAML::Emitter& em) const
+{
+    encodeWithDataBlock(em, 0);
+}
+
+void
+KnobTableItemSerialization::encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const
 {
     if (_emitMap) {
         em << YAML::BeginMap;
@@ -98,14 +104,14 @@ KnobTableItemSerialization::encode(YAML::Emitter& em) const
         for (std::list<KnobTableItemSerializationPtr>::const_iterator it = children.begin(); it != children.end(); ++it) {
             assert(!(*it)->verbatimTag.empty());
             em << YAML::VerbatimTag((*it)->verbatimTag);
-            (*it)->encode(em);
+            (*it)->encodeWithDataBlock(em, dataBlock);
         }
         em << YAML::EndSeq;
     }
     if (!knobs.empty()) {
         em << YAML::Key << "Params" << YAML::Value << YAML::BeginSeq;
         for (KnobSerializationList::const_iterator it = knobs.begin(); it!=knobs.end(); ++it) {
-            (*it)->encode(em);
+            (*it)->encodeWithDataBlock(em, dataBlock);
         }
         em << YAML::EndSeq;
     }
@@ -118,7 +124,7 @@ KnobTableItemSerialization::encode(YAML::Emitter& em) const
             if (animationCurves.size() > 1) {
                 em << YAML::Key << it->first << YAML::Value;
             }
-            it->second.encode(em);
+            it->second.encodeWithDataBlock(em, dataBlock);
         }
         if (animationCurves.size() > 1) {
             em << YAML::EndMap;
@@ -132,6 +138,12 @@ KnobTableItemSerialization::encode(YAML::Emitter& em) const
 
 void
 KnobTableItemSerialization::decode(const YAML::Node& node)
+{
+    decodeWithDataBlock(node, 0);
+}
+
+void
+KnobTableItemSerialization::decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock)
 {
     if (!node.IsMap()) {
         throw YAML::InvalidNode();
@@ -161,7 +173,7 @@ KnobTableItemSerialization::decode(const YAML::Node& node)
                 continue;
             }
             child->verbatimTag = nodeTag;
-            child->decode(childrenNode[i]);
+            child->decodeWithDataBlock(childrenNode[i], dataBlock);
             children.push_back(child);
         }
     }
@@ -169,7 +181,7 @@ KnobTableItemSerialization::decode(const YAML::Node& node)
         const YAML::Node& paramsNode = node["Params"];
         for (std::size_t i = 0; i < paramsNode.size(); ++i) {
             KnobSerializationPtr child(new KnobSerialization);
-            child->decode(paramsNode[i]);
+            child->decodeWithDataBlock(paramsNode[i], dataBlock);
             knobs.push_back(child);
         }
     }
@@ -180,12 +192,12 @@ KnobTableItemSerialization::decode(const YAML::Node& node)
             for (YAML::const_iterator it = animNode.begin(); it!=animNode.end(); ++it) {
                 std::string viewName = it->first.as<std::string>();
                 CurveSerialization c;
-                c.decode(it->second);
+                c.decodeWithDataBlock(it->second, dataBlock);
                 animationCurves.insert(std::make_pair(viewName, c));
             }
         } else {
             CurveSerialization c;
-            c.decode(animNode);
+            c.decodeWithDataBlock(animNode, dataBlock);
             animationCurves.insert(std::make_pair("Main", c));
         }
 
@@ -194,6 +206,12 @@ KnobTableItemSerialization::decode(const YAML::Node& node)
 
 void
 KnobItemsTableSerialization::encode(YAML::Emitter& em) const
+{
+    encodeWithDataBlock(em, 0);
+}
+
+void
+KnobItemsTableSerialization::encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const
 {
     if (nodeScriptName.empty() && items.empty()) {
         return;
@@ -210,7 +228,7 @@ KnobItemsTableSerialization::encode(YAML::Emitter& em) const
         for (std::list<KnobTableItemSerializationPtr>::const_iterator it = items.begin(); it!= items.end(); ++it) {
             assert(!(*it)->verbatimTag.empty());
             em << YAML::VerbatimTag((*it)->verbatimTag);
-            (*it)->encode(em);
+            (*it)->encodeWithDataBlock(em, dataBlock);
         }
     }
     em << YAML::EndSeq;
@@ -219,6 +237,12 @@ KnobItemsTableSerialization::encode(YAML::Emitter& em) const
 
 void
 KnobItemsTableSerialization::decode(const YAML::Node& node)
+{
+    decodeWithDataBlock(node, 0);
+}
+
+void
+KnobItemsTableSerialization::decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock)
 {
     if (!node.IsMap()) {
         throw YAML::InvalidNode();
@@ -241,7 +265,7 @@ KnobItemsTableSerialization::decode(const YAML::Node& node)
                 continue;
             }
             s->verbatimTag = nodeTag;
-            s->decode(itemsNode[i]);
+            s->decodeWithDataBlock(itemsNode[i], dataBlock);
             items.push_back(s);
         }
     }
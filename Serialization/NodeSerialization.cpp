@@ -99,6 +99,12 @@ ImagePlaneDescSerialization::decode(const YAML::Node& node)
 
 void
 NodeSerialization::encode(YAML::Emitter& em) const
+{
+    encodeWithDataBlock(em, 0);
+}
+
+void
+NodeSerialization::encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const
 {
     em << YAML::BeginMap;
 
@@ -166,7 +172,7 @@ NodeSerialization::encode(YAML::Emitter& em) const
     if (!_knobsValues.empty()) {
         em << YAML::Key << "Params" << YAML::Value << YAML::BeginSeq;
         for (KnobSerializationList::const_iterator it = _knobsValues.begin(); it!=_knobsValues.end(); ++it) {
-            (*it)->encode(em);
+            (*it)->encodeWithDataBlock(em, dataBlock);
         }
         em << YAML::EndSeq;
     }
@@ -174,7 +180,7 @@ NodeSerialization::encode(YAML::Emitter& em) const
     if (!_userPages.empty()) {
         em << YAML::Key << "UserPages" << YAML::Value << YAML::BeginSeq;
         for (std::list<boost::shared_ptr<GroupKnobSerialization> >::const_iterator it = _userPages.begin(); it!=_userPages.end(); ++it) {
-            (*it)->encode(em);
+            (*it)->encodeWithDataBlock(em, dataBlock);
         }
         em << YAML::EndSeq;
     }
@@ -190,7 +196,7 @@ NodeSerialization::encode(YAML::Emitter& em) const
     if (!_children.empty()) {
         em << YAML::Key << "Children" << YAML::Value << YAML::BeginSeq;
         for (NodeSerializationList::const_iterator it = _children.begin(); it!=_children.end(); ++it) {
-            (*it)->encode(em);
+            (*it)->encodeWithDataBlock(em, dataBlock);
         }
         em << YAML::EndSeq;
     }
@@ -199,7 +205,7 @@ NodeSerialization::encode(YAML::Emitter& em) const
         em << YAML::Key << "Tables" << YAML::Value;
         em << YAML::BeginSeq;
         for (std::list<KnobItemsTableSerializationPtr>::const_iterator it = _tables.begin(); it != _tables.end(); ++it) {
-            (*it)->encode(em);
+            (*it)->encodeWithDataBlock(em, dataBlock);
         }
         em << YAML::EndSeq;
     }
@@ -231,7 +237,7 @@ NodeSerialization::encode(YAML::Emitter& em) const
         em << YAML::EndSeq;
     }
     em << YAML::EndMap;
-} // NodeSerialization::encode
+} // NodeSerialization::encodeWithDataBlock
 
 static void tryDecodeInputsMap(const YAML::Node& node, const std::string& token, std::map<std::string, std::string>* container)
 {
@@ -251,6 +257,12 @@ static void tryDecodeInputsMap(const YAML::Node& node, const std::string& token,
 
 void
 NodeSerialization::decode(const YAML::Node& node)
+{
+    decodeWithDataBlock(node, 0);
+}
+
+void
+NodeSerialization::decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock)
 {
     if (!node.IsMap()) {
         throw YAML::InvalidNode();
@@ -324,7 +336,7 @@ NodeSerialization::decode(const YAML::Node& node)
         const YAML::Node& paramsNode = node["Params"];
         for (std::size_t i = 0; i < paramsNode.size(); ++i) {
             KnobSerializationPtr s(new KnobSerialization);
-            s->decode(paramsNode[i]);
+            s->decodeWithDataBlock(paramsNode[i], dataBlock);
             _knobsValues.push_back(s);
         }
     }
@@ -332,7 +344,7 @@ NodeSerialization::decode(const YAML::Node& node)
         const YAML::Node& pagesNode = node["UserPages"];
         for (std::size_t i = 0; i < pagesNode.size(); ++i) {
             GroupKnobSerializationPtr s(new GroupKnobSerialization);
-            s->decode(pagesNode[i]);
+            s->decodeWithDataBlock(pagesNode[i], dataBlock);
             _userPages.push_back(s);
         }
     }
@@ -346,7 +358,7 @@ NodeSerialization::decode(const YAML::Node& node)
         const YAML::Node& childrenNode = node["Children"];
         for (std::size_t i = 0; i < childrenNode.size(); ++i) {
             NodeSerializationPtr s(new NodeSerialization);
-            s->decode(childrenNode[i]);
+            s->decodeWithDataBlock(childrenNode[i], dataBlock);
             _children.push_back(s);
         }
     }
@@ -354,7 +366,7 @@ NodeSerialization::decode(const YAML::Node& node)
         const YAML::Node& tablesNode = node["Tables"];
         for (std::size_t i = 0; i < tablesNode.size(); ++i) {
             KnobItemsTableSerializationPtr table(new KnobItemsTableSerialization);
-            table->decode(tablesNode[i]);
+            table->decodeWithDataBlock(tablesNode[i], dataBlock);
             _tables.push_back(table);
         }
     }
@@ -406,7 +418,19 @@ NodeSerialization::decode(const YAML::Node& node)
     }
 
 
-} // NodeSerialization::decode
+} // NodeSerialization::decodeWithDataBlock
+
+void
+NodeSerialization::decodeIfNeeded()
+{
+    if (!_pendingDecoder) {
+        return;
+    }
+    // Reset it first so the decoder is released even if decoding fails
+    NodeSerializationDecoderIPtr decoder = _pendingDecoder;
+    _pendingDecoder.reset();
+    decoder->decodeNode(this);
+}
 
 
 SERIALIZATION_NAMESPACE_EXIT
@@ -80,6 +80,32 @@ struct OutputNodeConnection
 };
 
 
+/**
+ * @brief Decodes the rest of a NodeSerialization of which only a few fields were read,
+ * see NodeSerialization::decodeIfNeeded()
+ **/
+class NodeSerializationDecoderI
+{
+public:
+
+    NodeSerializationDecoderI()
+    {
+
+    }
+
+    virtual ~NodeSerializationDecoderI()
+    {
+
+    }
+
+    /**
+     * @brief Implement to decode the given serialization. Upon failure an exception is thrown.
+     **/
+    virtual void decodeNode(NodeSerialization* serialization) = 0;
+};
+
+typedef boost::shared_ptr<NodeSerializationDecoderI> NodeSerializationDecoderIPtr;
+
 /**
  * @class This is the main class for everything related to the serialization of nodes.
  * It use for the purpose of 3 serialization kinds:
@@ -131,6 +157,7 @@ public:
     , _nodeColor()
     , _overlayColor()
     , _viewerUIKnobsOrder()
+    , _pendingDecoder()
     {
         _nodePositionCoords[0] = _nodePositionCoords[1] = INT_MIN;
         _nodeSize[0] = _nodeSize[1] = -1;
@@ -223,10 +250,25 @@ public:
     // Ordering of the knobs in the viewer UI for this node
     std::list<std::string> _viewerUIKnobsOrder;
 
+    // If set, only the script-name, plug-in ID and plug-in version of the node were decoded so far,
+    // e.g: when the node was read from a binary project. See decodeIfNeeded()
+    NodeSerializationDecoderIPtr _pendingDecoder;
+
     virtual void encode(YAML::Emitter& em) const OVERRIDE;
 
     virtual void decode(const YAML::Node& node) OVERRIDE;
 
+    virtual void encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const OVERRIDE;
+
+    virtual void decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock) OVERRIDE;
+
+    /**
+     * @brief If the node was not entirely decoded yet, decode it now. This must be called
+     * before reading any other field than the script-name, plug-in ID and plug-in version.
+     * Upon failure an exception is thrown.
+     **/
+    void decodeIfNeeded();
+
     template<class Archive>
     void serialize(Archive & ar, const unsigned int version);
 };
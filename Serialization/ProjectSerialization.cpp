@@ -63,13 +63,19 @@ ProjectBeingLoadedInfo::decode(const YAML::Node& node)
 
 void
 ProjectSerialization::encode(YAML::Emitter& em) const
+{
+    encodeWithDataBlock(em, 0);
+}
+
+void
+ProjectSerialization::encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const
 {
     em << YAML::BeginMap;
 
     if (!_nodes.empty()) {
         em << YAML::Key << "Nodes" << YAML::Value << YAML::BeginSeq;
         for (NodeSerializationList::const_iterator it = _nodes.begin(); it!=_nodes.end(); ++it) {
-            (*it)->encode(em);
+            (*it)->encodeWithDataBlock(em, dataBlock);
         }
         em << YAML::EndSeq;
     }
@@ -85,7 +91,7 @@ ProjectSerialization::encode(YAML::Emitter& em) const
     if (!_projectKnobs.empty()) {
         em << YAML::Key << "Params" << YAML::Value << YAML::BeginSeq;
         for (KnobSerializationList::const_iterator it = _projectKnobs.begin(); it!=_projectKnobs.end(); ++it) {
-            (*it)->encode(em);
+            (*it)->encodeWithDataBlock(em, dataBlock);
         }
         em << YAML::EndSeq;
     }
@@ -116,16 +122,22 @@ ProjectSerialization::encode(YAML::Emitter& em) const
         em << YAML::EndSeq;
     }
     em << YAML::EndMap;
-} // ProjectSerialization::encode
+} // ProjectSerialization::encodeWithDataBlock
 
 void
 ProjectSerialization::decode(const YAML::Node& node)
+{
+    decodeWithDataBlock(node, 0);
+}
+
+void
+ProjectSerialization::decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock)
 {
     if (node["Nodes"]) {
         const YAML::Node& n = node["Nodes"];
         for (std::size_t i = 0; i < n.size(); ++i) {
             NodeSerializationPtr ns(new NodeSerialization);
-            ns->decode(n[i]);
+            ns->decodeWithDataBlock(n[i], dataBlock);
             _nodes.push_back(ns);
         }
     }
@@ -141,7 +153,7 @@ ProjectSerialization::decode(const YAML::Node& node)
         const YAML::Node& n = node["Params"];
         for (std::size_t i = 0; i < n.size(); ++i) {
             KnobSerializationPtr s(new KnobSerialization);
-            s->decode(n[i]);
+            s->decodeWithDataBlock(n[i], dataBlock);
             _projectKnobs.push_back(s);
         }
     }
@@ -170,7 +182,7 @@ ProjectSerialization::decode(const YAML::Node& node)
         }
     }
 
-} // ProjectSerialization::decode
+} // ProjectSerialization::decodeWithDataBlock
 
 SERIALIZATION_NAMESPACE_EXIT
 
@@ -136,6 +136,10 @@ public:
 
     virtual void decode(const YAML::Node& node) OVERRIDE;
 
+    virtual void encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const OVERRIDE;
+
+    virtual void decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock) OVERRIDE;
+
 
     template<class Archive>
     void serialize(Archive & ar, const unsigned int version);
@@ -33,10 +33,10 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 SERIALIZATION_NAMESPACE_ENTER
 
 void
-RotoStrokeItemSerialization::encode(YAML::Emitter& em) const
+RotoStrokeItemSerialization::encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* dataBlock) const
 {
     em << YAML::BeginMap;
-    KnobTableItemSerialization::encode(em);
+    KnobTableItemSerialization::encodeWithDataBlock(em, dataBlock);
    
     if (!_subStrokes.empty()) {
         em << YAML::Key << "SubStrokes" << YAML::Value;
@@ -45,11 +45,11 @@ RotoStrokeItemSerialization::encode(YAML::Emitter& em) const
             em << YAML::Flow;
             em << YAML::BeginMap;
             em << YAML::Key << "x" << YAML::Value;
-            it->x->encode(em);
+            it->x->encodeWithDataBlock(em, dataBlock);
             em << YAML::Key << "y" << YAML::Value;
-            it->y->encode(em);
+            it->y->encodeWithDataBlock(em, dataBlock);
             em << YAML::Key << "pressure" << YAML::Value;
-            it->pressure->encode(em);
+            it->pressure->encodeWithDataBlock(em, dataBlock);
             em << YAML::EndMap;
         }
         em << YAML::EndSeq;
@@ -60,13 +60,13 @@ RotoStrokeItemSerialization::encode(YAML::Emitter& em) const
 
 
 void
-RotoStrokeItemSerialization::decode(const YAML::Node& node)
+RotoStrokeItemSerialization::decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* dataBlock)
 {
 
     if (!node.IsMap()) {
         throw YAML::InvalidNode();
     }
-    KnobTableItemSerialization::decode(node);
+    KnobTableItemSerialization::decodeWithDataBlock(node, dataBlock);
 
     if (node["SubStrokes"]) {
         const YAML::Node& strokesNode = node["SubStrokes"];
@@ -76,9 +76,9 @@ RotoStrokeItemSerialization::decode(const YAML::Node& node)
             p.x.reset(new CurveSerialization);
             p.y.reset(new CurveSerialization);
             p.pressure.reset(new CurveSerialization);
-            p.x->decode(strokeN["x"]);
-            p.y->decode(strokeN["y"]);
-            p.pressure->decode(strokeN["pressure"]);
+            p.x->decodeWithDataBlock(strokeN["x"], dataBlock);
+            p.y->decodeWithDataBlock(strokeN["y"], dataBlock);
+            p.pressure->decodeWithDataBlock(strokeN["pressure"], dataBlock);
             _subStrokes.push_back(p);
         }
     }
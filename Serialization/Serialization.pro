@@ -46,6 +46,7 @@ INCLUDEPATH += $$PWD/../libs/SequenceParsing
 HEADERS += \
     BezierSerialization.h \
     BezierCPSerialization.h \
+    BinaryProjectSerialization.h \
     CurveSerialization.h \
     FormatSerialization.h \
     KnobSerialization.h \
@@ -71,6 +72,7 @@ HEADERS += \
 SOURCES += \
     BezierCPSerialization.cpp \
     BezierSerialization.cpp \
+    BinaryProjectSerialization.cpp \
     CurveSerialization.cpp \
     FormatSerialization.cpp \
     KnobSerialization.cpp \
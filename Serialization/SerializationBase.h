@@ -55,6 +55,24 @@ public:
      * @brief Implement to read the content of the object from the yaml node
      **/
     virtual void decode(const YAML::Node& node) = 0;
+
+    /**
+     * @brief Same as encode(), except that the curves and roto control points are written to the binary part
+     * of a block of a binary project. The objects holding some implement it and pass dataBlock down to their
+     * children. If dataBlock is NULL, this is the same as encode().
+     **/
+    virtual void encodeWithDataBlock(YAML::Emitter& em, BinaryProjectDataBlock* /*dataBlock*/) const
+    {
+        encode(em);
+    }
+
+    /**
+     * @brief Same as decode() for an object encoded by encodeWithDataBlock().
+     **/
+    virtual void decodeWithDataBlock(const YAML::Node& node, const BinaryProjectDataBlock* /*dataBlock*/)
+    {
+        decode(node);
+    }
 };
 
 /**
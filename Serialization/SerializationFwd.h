@@ -37,6 +37,8 @@ template<class T> class shared_ptr;
 
 SERIALIZATION_NAMESPACE_ENTER
 
+class BezierCPSerialization;
+class BinaryProjectDataBlock;
 class BezierSerialization;
 class CurveSerialization;
 struct DefaultValueSerialization;
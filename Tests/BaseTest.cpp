@@ -24,12 +24,20 @@
 
 #include "Global/Macros.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <iostream>
+#include <vector>
 
 #include "BaseTest.h"
 
 #include <QtCore/QFile>
 
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/thread/thread.hpp>
+#endif
+
 // ofxhPropertySuite.h:565:37: warning: 'this' pointer cannot be null in well-defined C++ code; comparison may be assumed to always evaluate to true [-Wtautological-undefined-compare]
 CLANG_DIAG_OFF(unknown-pragmas)
 CLANG_DIAG_OFF(tautological-undefined-compare) // appeared in clang 3.5
@@ -47,15 +55,31 @@ CLANG_DIAG_ON(unknown-pragmas)
 #include "Engine/Project.h"
 #include "Engine/AppManager.h"
 #include "Engine/AppInstance.h"
+#include "Engine/Cache.h"
 #include "Engine/KnobTypes.h"
 #include "Engine/EffectInstance.h"
 #include "Engine/Plugin.h"
 #include "Engine/Curve.h"
 #include "Engine/CLArgs.h"
+#include "Engine/FrameViewRequest.h"
+#include "Engine/Image.h"
+#include "Engine/RenderEngine.h"
 #include "Engine/RenderQueue.h"
+#include "Engine/RenderStats.h"
 #include "Engine/Settings.h"
+#include "Engine/StandardPaths.h"
+#include "Engine/Timer.h"
+#include "Engine/TreeRender.h"
+#include "Engine/TreeRenderQueueManager.h"
+#include "Engine/ViewerPrefetchScheduler.h"
 #include "Engine/ViewIdx.h"
 
+#include "Global/FStreamsSupport.h"
+
+#include "Serialization/BinaryProjectSerialization.h"
+#include "Serialization/ProjectSerialization.h"
+#include "Serialization/SerializationIO.h"
+
 NATRON_NAMESPACE_USING
 
 static AppManager* g_manager = 0;
@@ -218,6 +242,45 @@ BaseTest::disconnectNodes(const NodePtr& input,
     }
 } // disconnectNodes
 
+TreeRender::CtorArgsPtr
+BaseTest::createRenderTreeArgs(const EffectInstancePtr& treeRoot,
+                               TimeValue time,
+                               const RenderStatsPtr& stats)
+{
+    TreeRender::CtorArgsPtr args(new TreeRender::CtorArgs);
+
+    args->provider = treeRoot;
+    args->treeRootEffect = treeRoot;
+    args->time = time;
+    args->view = ViewIdx(0);
+    args->mipMapLevel = 0;
+    args->proxyScale = RenderScale(1.);
+    args->stats = stats;
+
+    return args;
+}
+
+TreeRenderPtr
+BaseTest::renderTree(const TreeRender::CtorArgsPtr& args)
+{
+    TreeRenderPtr render = TreeRender::create(args);
+
+    args->treeRootEffect->launchRender(render);
+    ActionRetCodeEnum stat = args->treeRootEffect->waitForRenderFinished(render);
+    EXPECT_FALSE( isFailureRetCode(stat) );
+    EXPECT_TRUE( bool( render->getOutputRequest() ) );
+
+    return render;
+}
+
+TreeRenderPtr
+BaseTest::renderTree(const EffectInstancePtr& treeRoot,
+                     TimeValue time,
+                     const RenderStatsPtr& stats)
+{
+    return renderTree( createRenderTreeArgs(treeRoot, time, stats) );
+}
+
 ///High level test: render 1 frame of dot generator
 TEST_F(BaseTest, GenerateDot)
 {
@@ -296,3 +359,832 @@ TEST_F(BaseTest, SimpleNodeConnections) {
     disconnectNodes(generator, writer, false);
     connectNodes(generator, writer, 0, true);
 }
+
+///Render a long chain of no-op nodes, with and without recycling the render clones of the nodes
+TEST_F(BaseTest, RenderCloneRecycling)
+{
+    const int nDots = 200;
+    const int nFrames = 50;
+
+    NodePtr generator = createNode(_generatorPluginID);
+    NodePtr writer = createNode(_writeOIIOPluginID);
+    ASSERT_TRUE( bool(generator) && bool(writer) );
+
+    std::vector<NodePtr> dots;
+    NodePtr input = generator;
+    for (int i = 0; i < nDots; ++i) {
+        NodePtr dot = createNode( QString::fromUtf8(PLUGINID_NATRON_DOT) );
+        ASSERT_TRUE( bool(dot) );
+        connectNodes(input, dot, 0, true);
+        dots.push_back(dot);
+        input = dot;
+    }
+    connectNodes(input, writer, 0, true);
+
+    // Keep the frames small so that the overhead of each frame dominates
+    Format f(0, 0, 16, 16, "tiny", 1.);
+    getApp()->getProject()->setOrAddProjectFormat(f);
+
+    std::string binPath = appPTR->getApplicationBinaryDirPath();
+    std::string filePattern = binPath + std::string("/test_render_clones###.jpg");
+    writer->getEffectInstance()->setOutputFilesForWriter(filePattern);
+
+    U64 nClonesCreated[2];
+    for (int recycle = 0; recycle < 2; ++recycle) {
+        appPTR->getCurrentSettings()->setRenderCloneRecyclingEnabled(recycle);
+
+        U64 nCreatedBefore = 0, nRecycledBefore = 0;
+        for (std::size_t i = 0; i < dots.size(); ++i) {
+            U64 nCreated, nRecycled;
+            dots[i]->getEffectInstance()->getRenderCloneAllocationCounts(&nCreated, &nRecycled);
+            nCreatedBefore += nCreated;
+            nRecycledBefore += nRecycled;
+        }
+
+        std::list<RenderQueue::RenderWork> works;
+        RenderQueue::RenderWork w;
+        w.treeRoot = writer;
+        w.firstFrame = TimeValue(1);
+        w.lastFrame = TimeValue(nFrames);
+        w.frameStep = TimeValue(1);
+        works.push_back(w);
+
+        getApp()->getRenderQueue()->renderBlocking(works);
+
+        U64 nCreatedAfter = 0, nRecycledAfter = 0;
+        for (std::size_t i = 0; i < dots.size(); ++i) {
+            U64 nCreated, nRecycled;
+            dots[i]->getEffectInstance()->getRenderCloneAllocationCounts(&nCreated, &nRecycled);
+            nCreatedAfter += nCreated;
+            nRecycledAfter += nRecycled;
+        }
+
+        nClonesCreated[recycle] = nCreatedAfter - nCreatedBefore;
+        if (recycle) {
+            // The knobs do not change during the render: all but the clones of the first frames are recycled
+            EXPECT_GT(nRecycledAfter - nRecycledBefore, nClonesCreated[recycle]);
+        } else {
+            EXPECT_EQ(nRecycledBefore, nRecycledAfter);
+            // Each frame creates the clones of the nodes
+            EXPECT_GE(nClonesCreated[recycle], (U64)nFrames);
+        }
+    }
+    // The recycled clones are not created again
+    EXPECT_LT(nClonesCreated[1], nClonesCreated[0]);
+
+    for (int i = 1; i <= nFrames; ++i) {
+        std::string filePath = binPath + std::string("/test_render_clones") + QString::number(i).rightJustified(3, QLatin1Char('0')).toStdString() + std::string(".jpg");
+        QFile::remove( QString::fromUtf8( filePath.c_str() ) );
+    }
+    appPTR->getCurrentSettings()->setRenderCloneRecyclingEnabled(true);
+}
+
+///A pipelined render should write the same files as a render that is not pipelined and process the frames in order
+TEST_F(BaseTest, RenderPipeliningOutputInOrder)
+{
+    const int nFrames = 20;
+
+    NodePtr generator = createNode(_generatorPluginID);
+    NodePtr writer = createNode(_writeOIIOPluginID);
+    ASSERT_TRUE( bool(generator) && bool(writer) );
+    connectNodes(generator, writer, 0, true);
+
+    // Animate the noise so that each frame is different
+    KnobDoublePtr noiseZ = toKnobDouble( generator->getKnobByName("noiseZ") );
+    ASSERT_TRUE( bool(noiseZ) );
+    noiseZ->setValueAtTime(TimeValue(1), 0., ViewSetSpec::all(), DimIdx(0));
+    noiseZ->setValueAtTime(TimeValue(nFrames), 1., ViewSetSpec::all(), DimIdx(0));
+
+    Format f(0, 0, 64, 64, "small", 1.);
+    getApp()->getProject()->setOrAddProjectFormat(f);
+
+    std::string binPath = appPTR->getApplicationBinaryDirPath();
+    std::string filePattern = binPath + std::string("/test_render_pipelining###.png");
+    writer->getEffectInstance()->setOutputFilesForWriter(filePattern);
+
+    FrameRenderedRecorder recorder;
+    QObject::connect( writer->getRenderEngine().get(), SIGNAL(frameRendered(int,double)), &recorder, SLOT(onFrameRendered(int,double)), Qt::DirectConnection );
+
+    std::vector<QByteArray> files[2];
+    for (int pipelined = 0; pipelined < 2; ++pipelined) {
+        appPTR->getCurrentSettings()->setRenderPipeliningEnabled(pipelined);
+
+        std::size_t nFramesBefore = recorder.getFrames().size();
+
+        std::list<RenderQueue::RenderWork> works;
+        RenderQueue::RenderWork w;
+        w.treeRoot = writer;
+        w.firstFrame = TimeValue(1);
+        w.lastFrame = TimeValue(nFrames);
+        w.frameStep = TimeValue(1);
+        works.push_back(w);
+        getApp()->getRenderQueue()->renderBlocking(works);
+
+        std::vector<int> frames = recorder.getFrames();
+        ASSERT_EQ( nFramesBefore + nFrames, frames.size() );
+        for (int i = 0; i < nFrames; ++i) {
+            EXPECT_EQ(i + 1, frames[nFramesBefore + i]);
+        }
+
+        for (int i = 1; i <= nFrames; ++i) {
+            QString filePath = QString::fromUtf8( (binPath + std::string("/test_render_pipelining")).c_str() ) + QString::number(i).rightJustified(3, QLatin1Char('0')) + QString::fromUtf8(".png");
+            QFile file(filePath);
+            ASSERT_TRUE( file.open(QIODevice::ReadOnly) );
+            files[pipelined].push_back( file.readAll() );
+            file.close();
+            QFile::remove(filePath);
+        }
+    }
+
+    for (int i = 0; i < nFrames; ++i) {
+        EXPECT_TRUE(files[0][i] == files[1][i]);
+    }
+    appPTR->getCurrentSettings()->setRenderPipeliningEnabled(false);
+}
+
+namespace {
+
+// Copies the pixels of the image rendered for the tree root by a finished render
+void
+getOutputImagePixels(const TreeRenderPtr& render,
+                     std::vector<unsigned char>* pixels)
+{
+    pixels->clear();
+    FrameViewRequestPtr outputRequest = render->getOutputRequest();
+    ASSERT_TRUE( bool(outputRequest) );
+    ImagePtr image = outputRequest->getRequestedScaleImagePlane();
+    ASSERT_TRUE( bool(image) );
+
+    Image::CPUData data;
+    image->getCPUData(&data);
+
+    // Packed components are all in the first buffer, otherwise each channel has its own
+    std::size_t bufferSize = data.bounds.area() * getSizeOfForBitDepth(data.bitDepth) * (data.ptrs[1] ? 1 : data.nComps);
+    for (int c = 0; c < 4 && data.ptrs[c]; ++c) {
+        const unsigned char* buffer = (const unsigned char*)data.ptrs[c];
+        pixels->insert(pixels->end(), buffer, buffer + bufferSize);
+    }
+}
+
+} // anon namespace
+
+///A recycled render clone should render the same images as a new clone after a change upstream and at another time
+TEST_F(BaseTest, RenderCloneRecyclingAfterChanges)
+{
+    Format f(0, 0, 64, 64, "small", 1.);
+    getApp()->getProject()->setOrAddProjectFormat(f);
+
+    // For each pass, the images rendered after a change upstream and at another time
+    std::vector<unsigned char> upstreamChangePixels[2], timeChangePixels[2];
+    for (int recycle = 0; recycle < 2; ++recycle) {
+        appPTR->getCurrentSettings()->setRenderCloneRecyclingEnabled(recycle);
+        appPTR->getTileCache()->clear();
+
+        NodePtr generator = createNode(_generatorPluginID);
+        NodePtr filter = createNode( QString::fromUtf8(PLUGINID_OFX_INVERT) );
+        ASSERT_TRUE( bool(generator) && bool(filter) );
+        connectNodes(generator, filter, 0, true);
+        KnobDoublePtr upstreamKnob = toKnobDouble( generator->getKnobByName("noiseZ") );
+        KnobDoublePtr animatedKnob = toKnobDouble( filter->getKnobByName("mix") );
+        ASSERT_TRUE( bool(upstreamKnob) && bool(animatedKnob) );
+        animatedKnob->setValueAtTime(TimeValue(1), 0.25, ViewSetSpec::all(), DimIdx(0));
+        animatedKnob->setValueAtTime(TimeValue(10), 1., ViewSetSpec::all(), DimIdx(0));
+        EffectInstancePtr treeRoot = filter->getEffectInstance();
+
+        U64 nCreatedBefore, nRecycledBefore;
+        treeRoot->getRenderCloneAllocationCounts(&nCreatedBefore, &nRecycledBefore);
+
+        // The first render releases the clone of the filter, the next ones may recycle it: the knobs of the filter do not change
+        const double times[3] = {1, 1, 5};
+        for (int i = 0; i < 3; ++i) {
+            if (i == 1) {
+                upstreamKnob->setValue(0.5);
+            }
+
+            TreeRenderPtr render = renderTree( treeRoot, TimeValue(times[i]) );
+
+            if (i == 1) {
+                getOutputImagePixels(render, &upstreamChangePixels[recycle]);
+            } else if (i == 2) {
+                getOutputImagePixels(render, &timeChangePixels[recycle]);
+            }
+        }
+
+        U64 nCreatedAfter, nRecycledAfter;
+        treeRoot->getRenderCloneAllocationCounts(&nCreatedAfter, &nRecycledAfter);
+        if (recycle) {
+            EXPECT_GT(nRecycledAfter, nRecycledBefore);
+        } else {
+            EXPECT_EQ(nRecycledBefore, nRecycledAfter);
+        }
+    }
+
+    EXPECT_FALSE( upstreamChangePixels[0].empty() );
+    EXPECT_TRUE(upstreamChangePixels[0] == upstreamChangePixels[1]);
+    EXPECT_FALSE( timeChangePixels[0].empty() );
+    EXPECT_TRUE(timeChangePixels[0] == timeChangePixels[1]);
+
+    appPTR->getCurrentSettings()->setRenderCloneRecyclingEnabled(true);
+}
+
+///Stream the tiles of the tree root of a chain of filters: the image and the tiles rendered in the cache should not change
+TEST_F(BaseTest, TileStreaming)
+{
+    const int nFilters = 20;
+
+    NodePtr generator = createNode(_generatorPluginID);
+    ASSERT_TRUE( bool(generator) );
+    // Tiles are only streamed if the nodes upstream of the tree root cache their output
+    generator->getEffectInstance()->setForceCachingEnabled(true);
+
+    NodePtr input = generator;
+    for (int i = 0; i < nFilters; ++i) {
+        NodePtr filter = createNode( QString::fromUtf8(PLUGINID_OFX_INVERT) );
+        ASSERT_TRUE( bool(filter) );
+        filter->getEffectInstance()->setForceCachingEnabled(true);
+        connectNodes(input, filter, 0, true);
+        input = filter;
+    }
+    EffectInstancePtr treeRoot = input->getEffectInstance();
+
+    Format f(0, 0, 2048, 2048, "2K square", 1.);
+    getApp()->getProject()->setOrAddProjectFormat(f);
+
+    int nTileGroupRenders[2];
+    U64 cachedTilesSize[2];
+    std::vector<unsigned char> pixels[2];
+    for (int streaming = 0; streaming < 2; ++streaming) {
+        appPTR->getCurrentSettings()->setTileStreamingEnabled(streaming);
+
+        // Render everything again
+        appPTR->getTileCache()->clear();
+
+        TreeRenderPtr render = renderTree( treeRoot, TimeValue(1) );
+        ASSERT_FALSE( isFailureRetCode( render->getStatus() ) );
+        EXPECT_GE(render->getTimeToFirstPixel(), 0.);
+        nTileGroupRenders[streaming] = render->getTileGroupRendersCount();
+        cachedTilesSize[streaming] = render->getCachedTilesSize();
+        getOutputImagePixels(render, &pixels[streaming]);
+    }
+
+    // The tiles of the tree root were streamed by several renders only when streaming is enabled
+    EXPECT_EQ(nTileGroupRenders[0], 0);
+    EXPECT_GT(nTileGroupRenders[1], 1);
+
+    // Each group of tiles renders its own part of the nodes upstream: nothing is rendered twice
+    EXPECT_GT(cachedTilesSize[0], 0U);
+    EXPECT_EQ(cachedTilesSize[0], cachedTilesSize[1]);
+
+    // Streaming changes the order in which tiles are rendered, not the image
+    EXPECT_FALSE( pixels[0].empty() );
+    EXPECT_TRUE(pixels[0] == pixels[1]);
+
+    appPTR->getCurrentSettings()->setTileStreamingEnabled(false);
+}
+
+///A viewer render requested while renders on disk use all the render threads should not wait for them
+TEST_F(BaseTest, InteractiveRenderUnderBackgroundLoad)
+{
+    const int nFilters = 20;
+    const int nBatchRenders = 4;
+
+    // A long chain of filters rendered on disk and a short one rendered in the viewer
+    NodePtr batchGenerator = createNode(_generatorPluginID);
+    NodePtr interactiveGenerator = createNode(_generatorPluginID);
+    NodePtr interactiveFilter = createNode( QString::fromUtf8(PLUGINID_OFX_INVERT) );
+    ASSERT_TRUE( bool(batchGenerator) && bool(interactiveGenerator) && bool(interactiveFilter) );
+    connectNodes(interactiveGenerator, interactiveFilter, 0, true);
+
+    NodePtr input = batchGenerator;
+    for (int i = 0; i < nFilters; ++i) {
+        NodePtr filter = createNode( QString::fromUtf8(PLUGINID_OFX_INVERT) );
+        ASSERT_TRUE( bool(filter) );
+        connectNodes(input, filter, 0, true);
+        input = filter;
+    }
+    EffectInstancePtr batchTreeRoot = input->getEffectInstance();
+    EffectInstancePtr interactiveTreeRoot = interactiveFilter->getEffectInstance();
+
+    Format f(0, 0, 1024, 1024, "1K square", 1.);
+    getApp()->getProject()->setOrAddProjectFormat(f);
+
+    // Few threads, so that the renders on disk keep them all busy
+    appPTR->getCurrentSettings()->setNumberOfThreads(2);
+    appPTR->getCurrentSettings()->setBackgroundRenderPreemptionEnabled(true);
+    TreeRenderQueueManagerPtr manager = appPTR->getTasksQueueManager();
+    appPTR->getTileCache()->clear();
+    manager->resetTimeToFirstPixelStats();
+
+    std::vector<TreeRenderPtr> batchRenders;
+    for (int i = 0; i < nBatchRenders; ++i) {
+        TreeRender::CtorArgsPtr args = createRenderTreeArgs( batchTreeRoot, TimeValue(i + 1) );
+        args->priority = eRenderPriorityBatch;
+
+        TreeRenderPtr render = TreeRender::create(args);
+        batchTreeRoot->launchRender(render);
+        batchRenders.push_back(render);
+    }
+
+    // A small region of the viewer, requested while the renders on disk are running
+    TreeRender::CtorArgsPtr args = createRenderTreeArgs( interactiveTreeRoot, TimeValue(1) );
+    args->canonicalRoI = RectD(0, 0, 64, 64);
+    args->priority = eRenderPriorityInteractive;
+    TreeRenderPtr interactiveRender = renderTree(args);
+    EXPECT_FALSE( isFailureRetCode( interactiveRender->getStatus() ) );
+
+    // The renders on disk are not needed anymore: the last one cannot have finished if the viewer render did not wait for it
+    for (std::size_t i = 0; i < batchRenders.size(); ++i) {
+        batchRenders[i]->setRenderAborted();
+    }
+    ActionRetCodeEnum lastBatchRenderStatus = eActionStatusOK;
+    for (std::size_t i = 0; i < batchRenders.size(); ++i) {
+        lastBatchRenderStatus = batchTreeRoot->waitForRenderFinished(batchRenders[i]);
+    }
+    EXPECT_TRUE( isFailureRetCode(lastBatchRenderStatus) );
+
+    // The viewer render finished while tasks of the renders on disk were running
+    TreeRenderQueueManager::TimeToFirstPixelStats stats;
+    manager->getTimeToFirstPixelStats(eRenderPriorityInteractive, &stats);
+    EXPECT_EQ( (U64)1, stats.nRenders );
+    EXPECT_EQ( (U64)1, stats.nRendersUnderBackgroundLoad );
+}
+
+///A render on disk whose nodes launch sub-renders should not wait for threads reserved for viewer renders that do not exist
+TEST_F(BaseTest, BatchRenderWithSubRenders)
+{
+    // TimeBlur fetches its source between frames: these images are not requested before the render and each of them
+    // is rendered by a sub-render while the task of TimeBlur waits
+    NodePtr generator = createNode(_generatorPluginID);
+    NodePtr timeBlur = createNode( QString::fromUtf8(PLUGINID_OFX_TIMEBLUR) );
+    ASSERT_TRUE( bool(generator) && bool(timeBlur) );
+    connectNodes(generator, timeBlur, 0, true);
+    EffectInstancePtr treeRoot = timeBlur->getEffectInstance();
+
+    Format f(0, 0, 256, 256, "256 square", 1.);
+    getApp()->getProject()->setOrAddProjectFormat(f);
+
+    appPTR->getCurrentSettings()->setNumberOfThreads(2);
+    appPTR->getCurrentSettings()->setBackgroundRenderPreemptionEnabled(true);
+    appPTR->getTileCache()->clear();
+
+    for (int i = 0; i < 2; ++i) {
+        TreeRender::CtorArgsPtr args = createRenderTreeArgs( treeRoot, TimeValue(i + 1) );
+        args->priority = eRenderPriorityBatch;
+        TreeRenderPtr render = renderTree(args);
+        EXPECT_FALSE( isFailureRetCode( render->getStatus() ) );
+    }
+}
+
+///Drag a parameter of the generator of a 1000 nodes graph and compute again the hash of the tree roots after each change
+TEST_F(BaseTest, HashRecomputeOnKnobDrag)
+{
+    const int nBranches = 9;
+    const int nFiltersPerBranch = 111;
+    const int nChanges = 100;
+
+    NodePtr generator = createNode(_generatorPluginID);
+    ASSERT_TRUE( bool(generator) );
+    KnobDoublePtr knob = toKnobDouble( generator->getKnobByName("noiseZ") );
+    ASSERT_TRUE( bool(knob) );
+
+    // The generator feeds a few long branches of filters: 1 + 9 * 111 = 1000 nodes
+    std::vector<EffectInstancePtr> treeRoots;
+    for (int i = 0; i < nBranches; ++i) {
+        NodePtr input = generator;
+        for (int j = 0; j < nFiltersPerBranch; ++j) {
+            NodePtr filter = createNode( QString::fromUtf8(PLUGINID_OFX_INVERT) );
+            ASSERT_TRUE( bool(filter) );
+            connectNodes(input, filter, 0, true);
+            input = filter;
+        }
+        treeRoots.push_back( input->getEffectInstance() );
+    }
+
+    HashableObject::ComputeHashArgs args;
+    args.time = TimeValue(1);
+    args.view = ViewIdx(0);
+    args.hashType = HashableObject::eComputeHashTypeTimeViewVariant;
+
+    std::vector<U64> hashes(nBranches);
+    for (int i = 0; i < nBranches; ++i) {
+        hashes[i] = treeRoots[i]->computeHash(args);
+    }
+
+    for (int i = 0; i < nChanges; ++i) {
+        knob->setValue( (i + 1) * 0.01 );
+        for (int j = 0; j < nBranches; ++j) {
+            U64 hash = treeRoots[j]->computeHash(args);
+            EXPECT_NE(hashes[j], hash);
+            hashes[j] = hash;
+        }
+    }
+
+    // Changing the time only hashes again what is animated: the hashes computed at other frames
+    // do not replace the ones of the first frame
+    HashableObject::ComputeHashArgs argsAtOtherFrame = args;
+    for (int i = 0; i < nChanges; ++i) {
+        argsAtOtherFrame.time = TimeValue(i + 2);
+        for (int j = 0; j < nBranches; ++j) {
+            U64 hash = treeRoots[j]->computeHash(argsAtOtherFrame);
+            EXPECT_EQ( hash, treeRoots[j]->computeHash(argsAtOtherFrame) );
+        }
+    }
+    for (int j = 0; j < nBranches; ++j) {
+        EXPECT_EQ( hashes[j], treeRoots[j]->computeHash(args) );
+    }
+
+    // The knobs hashed once per view must be hashed at each frame again once they are animated or driven by an expression
+    NodePtr filter = createNode( QString::fromUtf8(PLUGINID_OFX_INVERT) );
+    ASSERT_TRUE( bool(filter) );
+    EffectInstancePtr filterEffect = filter->getEffectInstance();
+    KnobDoublePtr mix = toKnobDouble( filter->getKnobByName("mix") );
+    ASSERT_TRUE( bool(mix) );
+
+    HashableObject::ComputeHashArgs argsAtFrame1 = args, argsAtFrame5 = args;
+    argsAtFrame1.time = TimeValue(1);
+    argsAtFrame5.time = TimeValue(5);
+    EXPECT_EQ( filterEffect->computeHash(argsAtFrame1), filterEffect->computeHash(argsAtFrame5) );
+
+    mix->setValueAtTime(TimeValue(1), 0.25, ViewSetSpec::all(), DimIdx(0));
+    mix->setValueAtTime(TimeValue(10), 0.75, ViewSetSpec::all(), DimIdx(0));
+    EXPECT_NE( filterEffect->computeHash(argsAtFrame1), filterEffect->computeHash(argsAtFrame5) );
+
+    mix->removeAnimation(ViewSetSpec::all(), DimSpec::all(), eValueChangedReasonUserEdited);
+    EXPECT_EQ( filterEffect->computeHash(argsAtFrame1), filterEffect->computeHash(argsAtFrame5) );
+
+    mix->setExpression(DimSpec(0), ViewSetSpec(0), "frame * 0.01", eExpressionLanguageExprTk, false, true);
+    EXPECT_NE( filterEffect->computeHash(argsAtFrame1), filterEffect->computeHash(argsAtFrame5) );
+}
+
+///Rendering the same window twice should find the results of getRegionsOfInterest in the cache
+TEST_F(BaseTest, RegionsOfInterestCache)
+{
+    NodePtr generator = createNode(_generatorPluginID);
+    NodePtr filter = createNode( QString::fromUtf8(PLUGINID_OFX_INVERT) );
+    ASSERT_TRUE( bool(generator) && bool(filter) );
+    connectNodes(generator, filter, 0, true);
+    EffectInstancePtr treeRoot = filter->getEffectInstance();
+
+    Format f(0, 0, 256, 256, "small", 1.);
+    getApp()->getProject()->setOrAddProjectFormat(f);
+
+    EffectInstance::ActionCacheStats stats[2];
+    for (int i = 0; i < 2; ++i) {
+        // Render everything again, only the action results remain cached
+        appPTR->getTileCache()->clear();
+
+        renderTree( treeRoot, TimeValue(1) );
+
+        treeRoot->getActionCacheStats(&stats[i]);
+    }
+    // The second render did not call the action again but found its results in the cache
+    EXPECT_GT(stats[0].nRoICalls, (U64)0);
+    EXPECT_EQ(stats[0].nRoICalls, stats[1].nRoICalls);
+    EXPECT_GT(stats[1].nRoICallsSaved, stats[0].nRoICallsSaved);
+
+    // The regions of interest found in the cache are the ones computed by the plug-in
+    RoIMap rois[2];
+    appPTR->getGeneralPurposeCache()->clear();
+    const RectD renderWindow(0, 0, 256, 256);
+    for (int i = 0; i < 2; ++i) {
+        EffectInstance::ActionCacheStats statsBefore, statsAfter;
+        treeRoot->getActionCacheStats(&statsBefore);
+        ActionRetCodeEnum stat = treeRoot->getRegionsOfInterest_public(TimeValue(1), RenderScale(1.), renderWindow, ViewIdx(0), &rois[i]);
+        EXPECT_FALSE( isFailureRetCode(stat) );
+        treeRoot->getActionCacheStats(&statsAfter);
+        if (i == 0) {
+            EXPECT_EQ(statsBefore.nRoICalls + 1, statsAfter.nRoICalls);
+        } else {
+            EXPECT_EQ(statsBefore.nRoICallsSaved + 1, statsAfter.nRoICallsSaved);
+        }
+    }
+    EXPECT_FALSE( rois[0].empty() );
+    EXPECT_TRUE(rois[0] == rois[1]);
+}
+
+namespace {
+
+// Returns the number of times the expressions set by PythonExpressionsBatchedPerRenderClone were evaluated
+int
+getNumPythonExpressionEvaluations()
+{
+    std::string error, output;
+    EXPECT_TRUE( NATRON_PYTHON_NAMESPACE::interpretPythonScript("print(len(natronTestEvaluations))\n", &error, &output) );
+
+    return std::atoi( output.c_str() );
+}
+
+} // anon namespace
+
+///The Python expressions of a render clone should be evaluated at once, before its actions read them
+TEST_F(BaseTest, PythonExpressionsBatchedPerRenderClone)
+{
+    NodePtr generator = createNode(_generatorPluginID);
+    ASSERT_TRUE( bool(generator) );
+    KnobDoublePtr knob = toKnobDouble( generator->getKnobByName("noiseZ") );
+    ASSERT_TRUE( bool(knob) );
+
+    // The expression records each of its evaluations. Its results are not cached, so that each read of the knob
+    // outside of the values of the render clone evaluates it again, taking the GIL.
+    std::string error;
+    ASSERT_TRUE( NATRON_PYTHON_NAMESPACE::interpretPythonScript("natronTestEvaluations = []\n", &error, 0) );
+    knob->setExpression(DimSpec(0), ViewSetSpec(0), "natronTestEvaluations.append(frame) or frame * 0.01", eExpressionLanguagePython, false, true);
+    knob->setExpressionsResultsCachingEnabled(false);
+
+    Format f(0, 0, 64, 64, "small", 1.);
+    getApp()->getProject()->setOrAddProjectFormat(f);
+
+    EffectInstancePtr treeRoot = generator->getEffectInstance();
+    RenderStatsPtr stats( new RenderStats(false) );
+
+    int nEvaluationsBefore = getNumPythonExpressionEvaluations();
+    renderTree(treeRoot, TimeValue(3), stats);
+    int nEvaluations = getNumPythonExpressionEvaluations() - nEvaluationsBefore;
+
+    // One batch for the clone of the generator, with the knob holding the expression
+    int nBatches, nKnobs;
+    double gilWaitTime;
+    stats->getPythonExpressionsBatches(&nBatches, &nKnobs, &gilWaitTime);
+    EXPECT_GE(nBatches, 1);
+    EXPECT_EQ(nBatches, nKnobs);
+
+    // The render actions did not evaluate the expression again
+    EXPECT_EQ(nKnobs, nEvaluations);
+
+    // The value read by the actions of a render clone is the one evaluated in the batch
+    TreeRenderPtr render = TreeRender::create( createRenderTreeArgs( treeRoot, TimeValue(3) ) );
+    FrameViewRenderKey key = {TimeValue(3), ViewIdx(0), render};
+    EffectInstancePtr clone = toEffectInstance( treeRoot->createRenderClone(key) );
+    ASSERT_TRUE( bool(clone) );
+    KnobDoublePtr cloneKnob = toKnobDouble( clone->getKnobByName("noiseZ") );
+    ASSERT_TRUE( bool(cloneKnob) );
+
+    nEvaluationsBefore = getNumPythonExpressionEvaluations();
+    clone->evaluatePythonExpressionsForRender();
+    EXPECT_EQ( nEvaluationsBefore + 1, getNumPythonExpressionEvaluations() );
+    EXPECT_DOUBLE_EQ( 3 * 0.01, cloneKnob->getValueAtTime( TimeValue(3) ) );
+    EXPECT_DOUBLE_EQ( 3 * 0.01, cloneKnob->getValue() );
+    EXPECT_EQ( nEvaluationsBefore + 1, getNumPythonExpressionEvaluations() );
+    treeRoot->removeRenderClone(render);
+}
+
+///A cached expression result must be evaluated again after a change of a knob it depends on, and after
+///clearExpressionsResults() on the main instance for the render clones too
+TEST_F(BaseTest, ExpressionResultsInvalidation)
+{
+    NodePtr generator = createNode(_generatorPluginID);
+    NodePtr filter = createNode( QString::fromUtf8(PLUGINID_OFX_INVERT) );
+    ASSERT_TRUE( bool(generator) && bool(filter) );
+    KnobDoublePtr noiseZ = toKnobDouble( generator->getKnobByName("noiseZ") );
+    KnobDoublePtr mix = toKnobDouble( filter->getKnobByName("mix") );
+    ASSERT_TRUE( bool(noiseZ) && bool(mix) );
+
+    // Changing the knob read by the expression invalidates its results
+    noiseZ->setValue(0.25);
+    mix->setExpression(DimSpec(0), ViewSetSpec(0), generator->getScriptName_mt_safe() + ".noiseZ.get()", eExpressionLanguagePython, false, true);
+    EXPECT_DOUBLE_EQ( 0.25, mix->getValueAtTime( TimeValue(1) ) );
+    noiseZ->setValue(0.5);
+    EXPECT_DOUBLE_EQ( 0.5, mix->getValueAtTime( TimeValue(1) ) );
+
+    // A Python variable is not a dependency of the expression: its results remain cached until they are cleared
+    std::string error;
+    ASSERT_TRUE( NATRON_PYTHON_NAMESPACE::interpretPythonScript("natronTestExpressionOffset = 0.25\n", &error, 0) );
+    noiseZ->setExpression(DimSpec(0), ViewSetSpec(0), "natronTestExpressionOffset", eExpressionLanguagePython, false, true);
+    EXPECT_DOUBLE_EQ( 0.25, noiseZ->getValueAtTime( TimeValue(1) ) );
+    ASSERT_TRUE( NATRON_PYTHON_NAMESPACE::interpretPythonScript("natronTestExpressionOffset = 0.75\n", &error, 0) );
+    EXPECT_DOUBLE_EQ( 0.25, noiseZ->getValueAtTime( TimeValue(1) ) );
+
+    noiseZ->clearExpressionsResults( DimSpec::all(), ViewSetSpec::all() );
+
+    // A render clone shares the results of its main instance
+    EffectInstancePtr generatorEffect = generator->getEffectInstance();
+    TreeRenderPtr render = TreeRender::create( createRenderTreeArgs( generatorEffect, TimeValue(1) ) );
+    FrameViewRenderKey key = {TimeValue(1), ViewIdx(0), render};
+    EffectInstancePtr clone = toEffectInstance( generatorEffect->createRenderClone(key) );
+    ASSERT_TRUE( bool(clone) );
+    KnobDoublePtr cloneNoiseZ = toKnobDouble( clone->getKnobByName("noiseZ") );
+    ASSERT_TRUE( bool(cloneNoiseZ) );
+    EXPECT_TRUE(cloneNoiseZ != noiseZ);
+    EXPECT_DOUBLE_EQ( 0.75, cloneNoiseZ->getValueAtTime( TimeValue(1) ) );
+    generatorEffect->removeRenderClone(render);
+
+    EXPECT_DOUBLE_EQ( 0.75, noiseZ->getValueAtTime( TimeValue(1) ) );
+}
+
+namespace {
+
+struct ExpressionEvaluationThread
+{
+    KnobDoublePtr knob;
+    int nEvaluations;
+    double* sum;
+
+    ExpressionEvaluationThread(const KnobDoublePtr& knob,
+                               int nEvaluations,
+                               double* sum)
+    : knob(knob)
+    , nEvaluations(nEvaluations)
+    , sum(sum)
+    {
+    }
+
+    void operator()()
+    {
+        double s = 0.;
+        for (int i = 0; i < nEvaluations; ++i) {
+            s += knob->getValueAtTime( TimeValue(i % 100) );
+        }
+        *sum = s;
+    }
+};
+} // anon namespace
+
+///Evaluating an exprtk expression from many threads should not compile it for each thread
+TEST_F(BaseTest, ExprTkExpressionSharedAcrossThreads)
+{
+    const int nEvaluationsPerThread = 10000;
+
+    NodePtr generator = createNode(_generatorPluginID);
+    ASSERT_TRUE( bool(generator) );
+    KnobDoublePtr knob = toKnobDouble( generator->getKnobByName("noiseZ") );
+    ASSERT_TRUE( bool(knob) );
+
+    knob->setExpression(DimSpec(0), ViewSetSpec(0), "sin(frame * 0.1) * 0.5 + frame / 100", eExpressionLanguageExprTk, false, true);
+    // Evaluate the expression each time instead of reading its cached results
+    knob->setExpressionsResultsCachingEnabled(false);
+
+    // The values the expression should give
+    double expectedSum = 0.;
+    for (int i = 0; i < nEvaluationsPerThread; ++i) {
+        double frame = i % 100;
+        expectedSum += std::sin(frame * 0.1) * 0.5 + frame / 100;
+    }
+
+    const int nThreads = 4;
+    const int nRuns = 3;
+    U64 nCompilationsBefore = KnobHelper::getExprTkCompilationsCount();
+    for (int run = 0; run < nRuns; ++run) {
+        std::vector<double> sums(nThreads);
+        {
+            boost::thread_group threads;
+            for (int i = 0; i < nThreads; ++i) {
+                threads.create_thread( ExpressionEvaluationThread(knob, nEvaluationsPerThread, &sums[i]) );
+            }
+            threads.join_all();
+        }
+
+        // All threads compute the values of the expression
+        for (int i = 0; i < nThreads; ++i) {
+            EXPECT_NEAR(expectedSum, sums[i], 1e-6);
+        }
+    }
+
+    // Compiled expressions are kept from one run to the next: at most as many as the threads evaluating concurrently
+    // were compiled in total, instead of one per thread ever created
+    U64 nCompilations = KnobHelper::getExprTkCompilationsCount() - nCompilationsBefore;
+    EXPECT_LE( nCompilations, (U64)nThreads );
+}
+
+///Renders the frames prefetched by the viewer with tree renders: viewer renders need a viewer UI
+class TreeFrameRenderer
+    : public ViewerPrefetchScheduler::FrameRenderer
+{
+    TreeRender::CtorArgsPtr _args;
+
+public:
+
+    std::vector<TimeValue> renderedFrames;
+
+    // args are the arguments of the render of any frame
+    TreeFrameRenderer(const TreeRender::CtorArgsPtr& args)
+    : ViewerPrefetchScheduler::FrameRenderer()
+    , _args(args)
+    , renderedFrames()
+    {
+    }
+
+    virtual bool renderFrame(TimeValue frame, U64* cachedBytes) OVERRIDE FINAL
+    {
+        TreeRender::CtorArgsPtr args( new TreeRender::CtorArgs(*_args) );
+        args->time = frame;
+        TreeRenderPtr render = TreeRender::create(args);
+        args->treeRootEffect->launchRender(render);
+        ActionRetCodeEnum stat = args->treeRootEffect->waitForRenderFinished(render);
+        *cachedBytes = render->getCachedTilesSize();
+        renderedFrames.push_back(frame);
+
+        return !isFailureRetCode(stat);
+    }
+};
+
+///The prefetch should stop once the tiles its own renders allocated in the cache reach the memory budget,
+///whatever else the cache contains
+TEST_F(BaseTest, ViewerPrefetchStopsAtMemoryBudget)
+{
+    NodePtr generator = createNode(_generatorPluginID);
+    ASSERT_TRUE( bool(generator) );
+    generator->getEffectInstance()->setForceCachingEnabled(true);
+    EffectInstancePtr treeRoot = generator->getEffectInstance();
+
+    Format f(0, 0, 512, 512, "512 square", 1.);
+    getApp()->getProject()->setOrAddProjectFormat(f);
+
+    TreeRender::CtorArgsPtr args = createRenderTreeArgs( treeRoot, TimeValue(0) );
+
+    // The size in the cache of one frame
+    appPTR->getTileCache()->clear();
+    U64 frameBytes;
+    {
+        TreeFrameRenderer renderer(args);
+        ASSERT_TRUE( renderer.renderFrame(TimeValue(0), &frameBytes) );
+        ASSERT_GT(frameBytes, 0U);
+    }
+
+    // A frame already in the cache does not allocate any tile
+    {
+        TreeFrameRenderer renderer(args);
+        U64 cachedBytes;
+        ASSERT_TRUE( renderer.renderFrame(TimeValue(0), &cachedBytes) );
+        EXPECT_EQ(cachedBytes, 0U);
+    }
+
+    std::vector<TimeValue> frames;
+    for (int i = 1; i <= 10; ++i) {
+        frames.push_back( TimeValue(i) );
+    }
+
+    // The frame rendered above stays in the cache and does not count in the budget
+    TreeFrameRenderer renderer(args);
+    U64 cachedBytes;
+    int nFramesRendered = ViewerPrefetchScheduler::renderFramesWithinBudget(frames, frameBytes * 5 / 2, &renderer, &cachedBytes);
+    EXPECT_EQ(nFramesRendered, 3);
+    ASSERT_EQ(renderer.renderedFrames.size(), 3U);
+    for (std::size_t i = 0; i < renderer.renderedFrames.size(); ++i) {
+        EXPECT_EQ(renderer.renderedFrames[i], frames[i]);
+    }
+    EXPECT_EQ(cachedBytes, frameBytes * 3);
+
+    // A budget already reached does not render anything
+    TreeFrameRenderer noBudgetRenderer(args);
+    EXPECT_EQ(ViewerPrefetchScheduler::renderFramesWithinBudget(frames, 0, &noBudgetRenderer, &cachedBytes), 0);
+    EXPECT_TRUE( noBudgetRenderer.renderedFrames.empty() );
+    EXPECT_EQ(cachedBytes, 0U);
+}
+
+///Load a project in the YAML and binary formats: reading the file, decoding it and creating the nodes
+TEST_F(BaseTest, BinaryProjectLoad)
+{
+    const int nFilters = 50;
+    const int nKeyframes = 200;
+
+    // A chain of filters with animated knobs, as in a typical comp
+    NodePtr generator = createNode(_generatorPluginID);
+    ASSERT_TRUE( bool(generator) );
+    NodePtr input = generator;
+    for (int i = 0; i < nFilters; ++i) {
+        NodePtr filter = createNode( QString::fromUtf8(PLUGINID_OFX_INVERT) );
+        ASSERT_TRUE( bool(filter) );
+        connectNodes(input, filter, 0, true);
+        KnobDoublePtr mix = toKnobDouble( filter->getKnobByName("mix") );
+        ASSERT_TRUE( bool(mix) );
+        for (int t = 0; t < nKeyframes; ++t) {
+            mix->setValueAtTime(TimeValue(t), (double)t / nKeyframes, ViewSetSpec::all(), DimIdx(0));
+        }
+        input = filter;
+    }
+    std::string lastFilterName = input->getScriptName();
+    std::size_t nNodes = getApp()->getProject()->getNodes().size();
+
+    QString path = StandardPaths::writableLocation(StandardPaths::eStandardLocationTemp);
+    StrUtils::ensureLastPathSeparator(path);
+    const QString names[2] = {QString::fromUtf8("BinaryProjectLoad.ntp"), QString::fromUtf8("BinaryProjectLoad_binary.ntp")};
+    {
+        SERIALIZATION_NAMESPACE::ProjectSerialization serialization;
+        getApp()->getProject()->toSerialization(&serialization);
+
+        FStreamsSupport::ofstream yamlFile;
+        FStreamsSupport::open( &yamlFile, (path + names[0]).toStdString() );
+        ASSERT_TRUE( bool(yamlFile) );
+        SERIALIZATION_NAMESPACE::write(yamlFile, serialization, NATRON_PROJECT_FILE_HEADER);
+
+        FStreamsSupport::ofstream binaryFile;
+        FStreamsSupport::open( &binaryFile, (path + names[1]).toStdString(), std::ios_base::out | std::ios_base::binary );
+        ASSERT_TRUE( bool(binaryFile) );
+        SERIALIZATION_NAMESPACE::writeBinaryProject(binaryFile, serialization);
+    }
+
+    for (int binary = 0; binary < 2; ++binary) {
+        EXPECT_TRUE( getApp()->getProject()->loadProject(path, names[binary]) );
+
+        // All the nodes and their animation were restored
+        EXPECT_EQ( nNodes, getApp()->getProject()->getNodes().size() );
+        NodePtr lastFilter = getApp()->getProject()->getNodeByName(lastFilterName);
+        ASSERT_TRUE( bool(lastFilter) );
+        KnobDoublePtr mix = toKnobDouble( lastFilter->getKnobByName("mix") );
+        ASSERT_TRUE( bool(mix) );
+        EXPECT_EQ( nKeyframes, mix->getAnimationCurve( ViewIdx(0), DimIdx(0) )->getKeyFramesCount() );
+        EXPECT_EQ( 0.5, mix->getValueAtTime( TimeValue(nKeyframes / 2) ) );
+
+        QFile::remove(path + names[binary]);
+    }
+}
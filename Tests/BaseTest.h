@@ -37,13 +37,61 @@
 #include <gtest/gtest.h>
 
 CLANG_DIAG_OFF(deprecated)
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
 #include <QtCore/QString>
 CLANG_DIAG_ON(deprecated)
 
 #include "Engine/EngineFwd.h"
+#include "Engine/TreeRender.h"
 
 NATRON_NAMESPACE_ENTER
 
+///Records the frames notified by the frameRendered signal of a RenderEngine, in the order they were processed.
+///Connect it with a direct connection: the signal is emitted by the threads of the render.
+class FrameRenderedRecorder
+    : public QObject
+{
+GCC_DIAG_SUGGEST_OVERRIDE_OFF
+    Q_OBJECT
+GCC_DIAG_SUGGEST_OVERRIDE_ON
+
+public:
+
+    FrameRenderedRecorder()
+        : QObject()
+        , _framesMutex()
+        , _frames()
+    {
+    }
+
+    virtual ~FrameRenderedRecorder()
+    {
+    }
+
+    std::vector<int> getFrames() const
+    {
+        QMutexLocker k(&_framesMutex);
+
+        return _frames;
+    }
+
+public Q_SLOTS:
+
+    void onFrameRendered(int time,
+                         double /*progress*/)
+    {
+        QMutexLocker k(&_framesMutex);
+
+        _frames.push_back(time);
+    }
+
+private:
+
+    mutable QMutex _framesMutex;
+    std::vector<int> _frames;
+};
+
 class BaseTest
     : public testing::Test
 {
@@ -78,6 +126,16 @@ protected:
     ///disconnection is expected to succeed, and vice versa.
     void disconnectNodes(const NodePtr& input, const NodePtr& output, bool expectedReturnvalue);
 
+    ///Returns the arguments to render the tree upstream of treeRoot at the given time, in the first view at full scale.
+    ///stats may be NULL.
+    TreeRender::CtorArgsPtr createRenderTreeArgs(const EffectInstancePtr& treeRoot, TimeValue time, const RenderStatsPtr& stats = RenderStatsPtr());
+
+    ///Launches a render with the given arguments and waits for it to finish. The render is expected to succeed.
+    TreeRenderPtr renderTree(const TreeRender::CtorArgsPtr& args);
+
+    ///Same as renderTree(createRenderTreeArgs(treeRoot, time, stats))
+    TreeRenderPtr renderTree(const EffectInstancePtr& treeRoot, TimeValue time, const RenderStatsPtr& stats = RenderStatsPtr());
+
     void registerTestPlugins();
 
     ///////////////Pointers to plug-ins that might be used by all the tests. This makes
@@ -0,0 +1,413 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <gtest/gtest.h>
+
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
+#include <yaml-cpp/yaml.h>
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+
+#include "Serialization/BezierCPSerialization.h"
+#include "Serialization/BinaryProjectSerialization.h"
+#include "Serialization/CurveSerialization.h"
+#include "Serialization/NodeSerialization.h"
+#include "Serialization/ProjectSerialization.h"
+#include "Serialization/SerializationIO.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+
+// A curve using all the interpolations that store derivatives differently
+static void
+makeCurve(int nKeyframes,
+          double offset,
+          SERIALIZATION_NAMESPACE::CurveSerialization* curve)
+{
+    static const char* interpolations[4] = {kKeyframeSerializationTypeLinear, kKeyframeSerializationTypeSmooth, kKeyframeSerializationTypeFree, kKeyframeSerializationTypeBroken};
+
+    curve->curveType = SERIALIZATION_NAMESPACE::eCurveSerializationTypeScalar;
+    for (int i = 0; i < nKeyframes; ++i) {
+        SERIALIZATION_NAMESPACE::KeyFrameSerialization keyframe;
+        keyframe.time = i * 1.5;
+        keyframe.value = offset + i * 0.1;
+        keyframe.interpolation = interpolations[(i / 3) % 4];
+        keyframe.rightDerivative = keyframe.interpolation == kKeyframeSerializationTypeFree || keyframe.interpolation == kKeyframeSerializationTypeBroken ? i * 0.25 : 0.;
+        keyframe.leftDerivative = keyframe.interpolation == kKeyframeSerializationTypeBroken ? -i * 0.25 : 0.;
+        curve->keys.push_back(keyframe);
+    }
+}
+
+static SERIALIZATION_NAMESPACE::KnobSerializationPtr
+makeDoubleKnob(const std::string& scriptName,
+               double value,
+               const std::string& expression,
+               int nKeyframes)
+{
+    SERIALIZATION_NAMESPACE::KnobSerializationPtr knob(new SERIALIZATION_NAMESPACE::KnobSerialization);
+
+    knob->_scriptName = scriptName;
+    knob->_dimension = 2;
+    knob->_dataType = SERIALIZATION_NAMESPACE::eSerializationValueVariantTypeDouble;
+    knob->_mustSerialize = true;
+    SERIALIZATION_NAMESPACE::KnobSerialization::PerDimensionValueSerializationVec& values = knob->_values["Main"];
+    values.resize(2);
+    for (int i = 0; i < 2; ++i) {
+        values[i]._mustSerialize = true;
+        values[i]._serializeValue = true;
+        values[i]._dimension = i;
+        values[i]._value.isDouble = value + i;
+        values[i]._expression = expression;
+        if ( !expression.empty() ) {
+            values[i]._expressionLanguage = kKnobSerializationExpressionLanguagePython;
+        }
+        makeCurve(nKeyframes, value + i, &values[i]._animationCurve);
+    }
+
+    return knob;
+}
+
+static SERIALIZATION_NAMESPACE::KnobSerializationPtr
+makeStringKnob(const std::string& scriptName,
+               const std::string& value)
+{
+    SERIALIZATION_NAMESPACE::KnobSerializationPtr knob(new SERIALIZATION_NAMESPACE::KnobSerialization);
+
+    knob->_scriptName = scriptName;
+    knob->_dimension = 1;
+    knob->_dataType = SERIALIZATION_NAMESPACE::eSerializationValueVariantTypeString;
+    knob->_mustSerialize = true;
+    SERIALIZATION_NAMESPACE::KnobSerialization::PerDimensionValueSerializationVec& values = knob->_values["Main"];
+    values.resize(1);
+    values[0]._mustSerialize = true;
+    values[0]._serializeValue = true;
+    values[0]._dimension = 0;
+    values[0]._value.isString = value;
+
+    return knob;
+}
+
+static SERIALIZATION_NAMESPACE::NodeSerializationPtr
+makeNode(int index,
+         int nKnobs,
+         const std::string& inputScriptName)
+{
+    SERIALIZATION_NAMESPACE::NodeSerializationPtr node(new SERIALIZATION_NAMESPACE::NodeSerialization);
+    std::stringstream ss;
+
+    ss << "Blur" << index;
+    node->_nodeScriptName = ss.str();
+    node->_nodeLabel = node->_nodeScriptName;
+    node->_pluginID = "net.sf.cimg.CImgBlur";
+    node->_pluginMajorVersion = 4;
+    node->_pluginMinorVersion = 0;
+    node->_nodePositionCoords[0] = index * 100;
+    node->_nodePositionCoords[1] = 50;
+    if ( !inputScriptName.empty() ) {
+        node->_inputs["Source"] = inputScriptName;
+    }
+    for (int i = 0; i < nKnobs; ++i) {
+        std::stringstream knobName;
+        knobName << "param" << i;
+        // Some knobs are animated, as in a typical comp
+        node->_knobsValues.push_back( makeDoubleKnob(knobName.str(), index + i * 0.5, i % 4 == 0 ? "thisNode.param1.get()[dimension] * 2" : "", i % 4 == 1 ? 50 : 0) );
+    }
+    // Characters that must be escaped in the YAML flow style
+    node->_knobsValues.push_back( makeStringKnob("note", "first line\nsecond line: {with, [flow], \"quotes\"} # not a comment") );
+
+    return node;
+}
+
+static void
+makeProject(int nNodes,
+            int nKnobs,
+            SERIALIZATION_NAMESPACE::ProjectSerialization* project)
+{
+    for (int i = 0; i < nNodes; ++i) {
+        std::string inputScriptName;
+        if (i > 0) {
+            inputScriptName = project->_nodes.back()->_nodeScriptName;
+        }
+        project->_nodes.push_back( makeNode(i, nKnobs, inputScriptName) );
+    }
+
+    // A group with its own children
+    SERIALIZATION_NAMESPACE::NodeSerializationPtr group = makeNode(nNodes, nKnobs, std::string());
+    group->_nodeScriptName = "Group1";
+    group->_nodeLabel = "My Group";
+    group->_pluginID = "fr.inria.built-in.Group";
+    group->_children.push_back( makeNode(nNodes + 1, nKnobs, std::string()) );
+    project->_nodes.push_back(group);
+
+    project->_projectKnobs.push_back( makeDoubleKnob("frameRange", 1, std::string(), 0) );
+    project->_timelineCurrent = 12;
+    project->_projectLoadedInfo.vMajor = 3;
+    project->_projectLoadedInfo.osStr = kOSTypeNameLinux;
+    project->_openedPanelsOrdered.push_back("Blur0");
+}
+
+static std::string
+toYAML(const SERIALIZATION_NAMESPACE::ProjectSerialization& project)
+{
+    std::stringstream ss;
+
+    SERIALIZATION_NAMESPACE::write(ss, project, NATRON_PROJECT_FILE_HEADER);
+
+    return ss.str();
+}
+
+static SERIALIZATION_NAMESPACE::BinaryProjectDataPtr
+toBinary(const SERIALIZATION_NAMESPACE::ProjectSerialization& project)
+{
+    std::stringstream ss;
+
+    SERIALIZATION_NAMESPACE::writeBinaryProject(ss, project);
+
+    return SERIALIZATION_NAMESPACE::BinaryProjectDataPtr( new SERIALIZATION_NAMESPACE::BinaryProjectBuffer(ss) );
+}
+} // anon namespace
+
+TEST(BinaryProject, RoundTrip)
+{
+    SERIALIZATION_NAMESPACE::ProjectSerialization project;
+
+    makeProject(10, 8, &project);
+    std::string yaml = toYAML(project);
+    SERIALIZATION_NAMESPACE::BinaryProjectDataPtr data = toBinary(project);
+
+    {
+        std::stringstream ss( std::string( data->getData(), data->getSize() ) );
+        EXPECT_TRUE( SERIALIZATION_NAMESPACE::isBinaryProject(ss) );
+        // The stream can still be read from the start
+        EXPECT_EQ( 0, (int)ss.tellg() );
+    }
+    {
+        std::stringstream ss(yaml);
+        EXPECT_FALSE( SERIALIZATION_NAMESPACE::isBinaryProject(ss) );
+    }
+
+    // Only what is needed to create the nodes is decoded
+    SERIALIZATION_NAMESPACE::ProjectSerialization lazyProject;
+    SERIALIZATION_NAMESPACE::readBinaryProject(data, &lazyProject, true);
+    ASSERT_EQ( project._nodes.size(), lazyProject._nodes.size() );
+    EXPECT_EQ(12, lazyProject._timelineCurrent);
+    EXPECT_EQ( (std::size_t)1, lazyProject._projectKnobs.size() );
+
+    SERIALIZATION_NAMESPACE::NodeSerializationList::const_iterator itOrig = project._nodes.begin();
+    for (SERIALIZATION_NAMESPACE::NodeSerializationList::const_iterator it = lazyProject._nodes.begin(); it != lazyProject._nodes.end(); ++it, ++itOrig) {
+        EXPECT_TRUE( (bool)(*it)->_pendingDecoder );
+        EXPECT_TRUE( (*it)->_knobsValues.empty() );
+        EXPECT_EQ( (*itOrig)->_nodeScriptName, (*it)->_nodeScriptName );
+        EXPECT_EQ( (*itOrig)->_pluginID, (*it)->_pluginID );
+        EXPECT_EQ( (*itOrig)->_pluginMajorVersion, (*it)->_pluginMajorVersion );
+        EXPECT_EQ( (*itOrig)->_pluginMinorVersion, (*it)->_pluginMinorVersion );
+    }
+
+    // Decoding a node does not decode the others
+    lazyProject._nodes.front()->decodeIfNeeded();
+    EXPECT_FALSE( (bool)lazyProject._nodes.front()->_pendingDecoder );
+    EXPECT_EQ( project._nodes.front()->_knobsValues.size(), lazyProject._nodes.front()->_knobsValues.size() );
+    EXPECT_TRUE( (bool)lazyProject._nodes.back()->_pendingDecoder );
+
+    // Writing the project decodes the nodes that were not decoded yet
+    SERIALIZATION_NAMESPACE::ProjectSerialization decodedProject;
+    SERIALIZATION_NAMESPACE::readBinaryProject(toBinary(lazyProject), &decodedProject, false);
+    for (SERIALIZATION_NAMESPACE::NodeSerializationList::const_iterator it = decodedProject._nodes.begin(); it != decodedProject._nodes.end(); ++it) {
+        EXPECT_FALSE( (bool)(*it)->_pendingDecoder );
+    }
+    EXPECT_EQ( yaml, toYAML(lazyProject) );
+    EXPECT_EQ( yaml, toYAML(decodedProject) );
+    ASSERT_EQ( (std::size_t)1, decodedProject._nodes.back()->_children.size() );
+    EXPECT_EQ( "My Group", decodedProject._nodes.back()->_nodeLabel );
+}
+
+TEST(BinaryProject, InvalidFile)
+{
+    SERIALIZATION_NAMESPACE::ProjectSerialization project;
+
+    makeProject(2, 2, &project);
+
+    // A YAML project is not a binary project
+    {
+        std::stringstream ss( toYAML(project) );
+        SERIALIZATION_NAMESPACE::BinaryProjectDataPtr data( new SERIALIZATION_NAMESPACE::BinaryProjectBuffer(ss) );
+        SERIALIZATION_NAMESPACE::ProjectSerialization readProject;
+        EXPECT_THROW(SERIALIZATION_NAMESPACE::readBinaryProject(data, &readProject, true), SERIALIZATION_NAMESPACE::InvalidSerializationFileException);
+    }
+
+    // A truncated file fails to load instead of reading past its end
+    SERIALIZATION_NAMESPACE::BinaryProjectDataPtr data = toBinary(project);
+    std::size_t sizes[] = {12, 40, data->getSize() - 1};
+    for (int i = 0; i < 3; ++i) {
+        std::stringstream ss( std::string(data->getData(), sizes[i]) );
+        SERIALIZATION_NAMESPACE::BinaryProjectDataPtr truncated( new SERIALIZATION_NAMESPACE::BinaryProjectBuffer(ss) );
+        SERIALIZATION_NAMESPACE::ProjectSerialization readProject;
+        EXPECT_ANY_THROW( SERIALIZATION_NAMESPACE::readBinaryProject(truncated, &readProject, false) );
+    }
+}
+
+static void
+expectSameCurves(const SERIALIZATION_NAMESPACE::CurveSerialization& expected,
+                 const SERIALIZATION_NAMESPACE::CurveSerialization& curve)
+{
+    ASSERT_EQ( expected.keys.size(), curve.keys.size() );
+    std::list<SERIALIZATION_NAMESPACE::KeyFrameSerialization>::const_iterator it2 = curve.keys.begin();
+    for (std::list<SERIALIZATION_NAMESPACE::KeyFrameSerialization>::const_iterator it = expected.keys.begin(); it != expected.keys.end(); ++it, ++it2) {
+        EXPECT_EQ(it->time, it2->time);
+        EXPECT_EQ(it->value, it2->value);
+        EXPECT_EQ(it->interpolation, it2->interpolation);
+        EXPECT_EQ(it->rightDerivative, it2->rightDerivative);
+        EXPECT_EQ(it->leftDerivative, it2->leftDerivative);
+    }
+}
+
+TEST(BinaryProject, CurvesAndControlPoints)
+{
+    SERIALIZATION_NAMESPACE::CurveSerialization curve;
+    makeCurve(20, 0.1, &curve);
+
+    SERIALIZATION_NAMESPACE::BezierCPSerialization staticPoint;
+    staticPoint.x = 1.5;
+    staticPoint.y = -2.25;
+    staticPoint.leftX = 1. / 3.;
+    staticPoint.leftY = 4;
+    staticPoint.rightX = 5;
+    staticPoint.rightY = 6;
+
+    SERIALIZATION_NAMESPACE::BezierCPSerialization animatedPoint;
+    makeCurve(10, 1, &animatedPoint.xCurve);
+    makeCurve(10, 2, &animatedPoint.yCurve);
+    makeCurve(10, 3, &animatedPoint.leftCurveX);
+    makeCurve(10, 4, &animatedPoint.leftCurveY);
+    makeCurve(10, 5, &animatedPoint.rightCurveX);
+    makeCurve(10, 6, &animatedPoint.rightCurveY);
+
+    // Only references to the binary part are written in YAML
+    std::string binaryPart;
+    SERIALIZATION_NAMESPACE::BinaryProjectDataBlock writeBlock(&binaryPart);
+    YAML::Emitter em;
+    em << YAML::Flow << YAML::BeginSeq;
+    curve.encodeWithDataBlock(em, &writeBlock);
+    staticPoint.encodeWithDataBlock(em, &writeBlock);
+    animatedPoint.encodeWithDataBlock(em, &writeBlock);
+    em << YAML::EndSeq;
+    EXPECT_LT( em.size(), (std::size_t)32 );
+
+    YAML::Node node = YAML::Load( em.c_str() );
+    ASSERT_EQ( (std::size_t)3, node.size() );
+    for (std::size_t i = 0; i < 3; ++i) {
+        EXPECT_TRUE( SERIALIZATION_NAMESPACE::BinaryProjectDataBlock::isReference(node[i]) );
+    }
+
+    // Without a block, the same objects are written in YAML
+    {
+        YAML::Emitter yamlEm;
+        curve.encode(yamlEm);
+        YAML::Node yamlNode = YAML::Load( yamlEm.c_str() );
+        EXPECT_FALSE( SERIALIZATION_NAMESPACE::BinaryProjectDataBlock::isReference(yamlNode) );
+        EXPECT_TRUE( yamlNode.IsSequence() );
+
+        YAML::Emitter noBlockEm;
+        curve.encodeWithDataBlock(noBlockEm, 0);
+        EXPECT_EQ( std::string( yamlEm.c_str() ), std::string( noBlockEm.c_str() ) );
+    }
+
+    // References cannot be read without the binary part
+    {
+        SERIALIZATION_NAMESPACE::CurveSerialization readCurve;
+        EXPECT_ANY_THROW( readCurve.decode(node[0]) );
+        SERIALIZATION_NAMESPACE::BezierCPSerialization readPoint;
+        EXPECT_ANY_THROW( readPoint.decodeWithDataBlock(node[1], 0) );
+    }
+
+    SERIALIZATION_NAMESPACE::BinaryProjectDataBlock block( binaryPart.data(), binaryPart.size() );
+
+    SERIALIZATION_NAMESPACE::CurveSerialization readCurve;
+    readCurve.decodeWithDataBlock(node[0], &block);
+    expectSameCurves(curve, readCurve);
+
+    SERIALIZATION_NAMESPACE::BezierCPSerialization readStaticPoint;
+    readStaticPoint.decodeWithDataBlock(node[1], &block);
+    EXPECT_TRUE( readStaticPoint.xCurve.keys.empty() );
+    EXPECT_EQ(staticPoint.x, readStaticPoint.x);
+    EXPECT_EQ(staticPoint.y, readStaticPoint.y);
+    EXPECT_EQ(staticPoint.leftX, readStaticPoint.leftX);
+    EXPECT_EQ(staticPoint.leftY, readStaticPoint.leftY);
+    EXPECT_EQ(staticPoint.rightX, readStaticPoint.rightX);
+    EXPECT_EQ(staticPoint.rightY, readStaticPoint.rightY);
+
+    SERIALIZATION_NAMESPACE::BezierCPSerialization readAnimatedPoint;
+    readAnimatedPoint.decodeWithDataBlock(node[2], &block);
+    expectSameCurves(animatedPoint.xCurve, readAnimatedPoint.xCurve);
+    expectSameCurves(animatedPoint.yCurve, readAnimatedPoint.yCurve);
+    expectSameCurves(animatedPoint.leftCurveX, readAnimatedPoint.leftCurveX);
+    expectSameCurves(animatedPoint.leftCurveY, readAnimatedPoint.leftCurveY);
+    expectSameCurves(animatedPoint.rightCurveX, readAnimatedPoint.rightCurveX);
+    expectSameCurves(animatedPoint.rightCurveY, readAnimatedPoint.rightCurveY);
+    EXPECT_EQ(animatedPoint.xCurve.keys.front().value, readAnimatedPoint.x);
+    EXPECT_EQ(animatedPoint.rightCurveY.keys.front().value, readAnimatedPoint.rightY);
+
+    // A truncated binary part fails to load instead of reading past its end
+    {
+        SERIALIZATION_NAMESPACE::BinaryProjectDataBlock truncated( binaryPart.data(), binaryPart.size() - 1 );
+        SERIALIZATION_NAMESPACE::BezierCPSerialization point;
+        EXPECT_ANY_THROW( point.decodeWithDataBlock(node[2], &truncated) );
+    }
+}
+
+TEST(BinaryProject, DecodeWholeProject)
+{
+    SERIALIZATION_NAMESPACE::ProjectSerialization project;
+
+    makeProject(100, 40, &project);
+    std::string yaml = toYAML(project);
+    SERIALIZATION_NAMESPACE::BinaryProjectDataPtr data = toBinary(project);
+
+    // Every node, with its animation curves, reads back as it was written
+    SERIALIZATION_NAMESPACE::ProjectSerialization readProject;
+    SERIALIZATION_NAMESPACE::readBinaryProject(data, &readProject, true);
+    ASSERT_EQ( project._nodes.size(), readProject._nodes.size() );
+    SERIALIZATION_NAMESPACE::NodeSerializationList::const_iterator itOrig = project._nodes.begin();
+    for (SERIALIZATION_NAMESPACE::NodeSerializationList::const_iterator it = readProject._nodes.begin(); it != readProject._nodes.end(); ++it, ++itOrig) {
+        (*it)->decodeIfNeeded();
+        ASSERT_EQ( (*itOrig)->_knobsValues.size(), (*it)->_knobsValues.size() );
+        SERIALIZATION_NAMESPACE::KnobSerializationList::const_iterator itOrigKnob = (*itOrig)->_knobsValues.begin();
+        for (SERIALIZATION_NAMESPACE::KnobSerializationList::const_iterator itKnob = (*it)->_knobsValues.begin(); itKnob != (*it)->_knobsValues.end(); ++itKnob, ++itOrigKnob) {
+            EXPECT_EQ( (*itOrigKnob)->_scriptName, (*itKnob)->_scriptName );
+            const SERIALIZATION_NAMESPACE::KnobSerialization::PerDimensionValueSerializationVec& origValues = (*itOrigKnob)->_values["Main"];
+            const SERIALIZATION_NAMESPACE::KnobSerialization::PerDimensionValueSerializationVec& values = (*itKnob)->_values["Main"];
+            ASSERT_EQ( origValues.size(), values.size() );
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                expectSameCurves(origValues[i]._animationCurve, values[i]._animationCurve);
+                EXPECT_EQ(origValues[i]._expression, values[i]._expression);
+            }
+        }
+    }
+    EXPECT_EQ( yaml, toYAML(readProject) );
+}
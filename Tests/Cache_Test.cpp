@@ -0,0 +1,758 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <QtCore/QDir>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/thread/thread.hpp>
+#endif
+
+#include "Global/ProcInfo.h"
+
+#include "Engine/Cache.h"
+#include "Engine/CacheEntryBase.h"
+#include "Engine/CacheEvictionPolicy.h"
+#include "Engine/CompressedTilesStorage.h"
+#include "Engine/ImageCacheKey.h"
+#include "Engine/MemoryFile.h"
+#include "Engine/TileCompression.h"
+
+NATRON_NAMESPACE_USING
+
+// Number of full frames each thread allocates and frees
+#define TILES_ALLOCATION_N_FRAMES 10
+
+namespace {
+
+// Allocate and free the tiles of a 1920x1080 RGBA float image, as done when rendering a HD frame
+class TileAllocationThread
+{
+    CacheBasePtr _cache;
+    int _threadIndex;
+    int* _ok;
+
+public:
+
+    TileAllocationThread(const CacheBasePtr& cache, int threadIndex, int* ok)
+    : _cache(cache)
+    , _threadIndex(threadIndex)
+    , _ok(ok)
+    {
+    }
+
+    void operator()() const
+    {
+        // Each thread allocates tiles for its own entry
+        CacheEntryBasePtr entry(new CacheEntryBase(_cache));
+        CacheEntryKeyBasePtr key(new ImageCacheKey(_threadIndex + 1, 0, RenderScale(1.), std::string()));
+        entry->setKey(key);
+        {
+            CacheEntryLockerBasePtr locker = _cache->get(entry);
+            if (locker->getStatus() != CacheEntryLockerBase::eCacheEntryStatusMustCompute) {
+                *_ok = 0;
+                return;
+            }
+            locker->insertInCache();
+            entry = locker->getProcessLocalEntry();
+        }
+
+        int tileSizeX, tileSizeY;
+        CacheBase::getTileSizePx(eImageBitDepthFloat, &tileSizeX, &tileSizeY);
+        const int nTilesX = (1920 + tileSizeX - 1) / tileSizeX;
+        const int nTilesY = (1080 + tileSizeY - 1) / tileSizeY;
+
+        std::vector<TileHash> tilesToAlloc;
+        for (int c = 0; c < 4; ++c) {
+            for (int ty = 0; ty < nTilesY; ++ty) {
+                for (int tx = 0; tx < nTilesX; ++tx) {
+                    tilesToAlloc.push_back(CacheBase::makeTileCacheIndex(tx, ty, 0, c, entry->getHashKey()));
+                }
+            }
+        }
+
+        for (int i = 0; i < TILES_ALLOCATION_N_FRAMES; ++i) {
+            std::vector<void*> existingTilesData;
+            std::vector<std::pair<TileInternalIndex, void*> > allocatedTilesData;
+            void* cacheData = 0;
+            bool gotTiles = _cache->retrieveAndLockTiles(entry, 0, &tilesToAlloc, &existingTilesData, &allocatedTilesData, &cacheData);
+            if (!gotTiles || allocatedTilesData.size() != tilesToAlloc.size()) {
+                *_ok = 0;
+            }
+
+            // A free tile must never be handed out twice
+            std::vector<void*> tilesPtr(allocatedTilesData.size());
+            for (std::size_t t = 0; t < allocatedTilesData.size(); ++t) {
+                tilesPtr[t] = allocatedTilesData[t].second;
+            }
+            std::sort(tilesPtr.begin(), tilesPtr.end());
+            if (std::adjacent_find(tilesPtr.begin(), tilesPtr.end()) != tilesPtr.end()) {
+                *_ok = 0;
+            }
+            if (cacheData) {
+                // Free the tiles
+                _cache->unLockTiles(cacheData, true /*invalidate*/);
+            }
+        }
+        _cache->removeEntry(entry);
+    }
+};
+
+} // anon namespace
+
+// Tiles are allocated from the free tiles of each thread and from the buckets concurrently
+TEST(Cache, TileAllocationFromManyThreads)
+{
+    CacheBasePtr cache = Cache<false>::create(true /*enableTileStorage*/);
+    ASSERT_TRUE(cache);
+
+    const int nThreads = std::max(2, (int)boost::thread::hardware_concurrency());
+    std::size_t sizeBefore = cache->getCurrentSize();
+    std::vector<int> threadsOk(nThreads, 1);
+    {
+        boost::thread_group threads;
+        for (int i = 0; i < nThreads; ++i) {
+            threads.create_thread(TileAllocationThread(cache, i, &threadsOk[i]));
+        }
+        threads.join_all();
+    }
+    for (int i = 0; i < nThreads; ++i) {
+        EXPECT_TRUE(threadsOk[i]);
+    }
+    // All tiles were freed, whether they went back to a bucket or to the free tiles of their thread
+    EXPECT_EQ(sizeBefore, cache->getCurrentSize());
+}
+
+namespace {
+
+// Allocate and free tiles from a new thread and return the number of times it locked the free tiles list of a bucket
+U64
+getFreeTilesListAccessesForAllocation(const CacheBasePtr& cache, int threadIndex, int* ok)
+{
+    CacheTierStats tilesTier, compressedTilesTier;
+    cache->getTilesTierStats(&tilesTier, &compressedTilesTier);
+    U64 accessesBefore = tilesTier.nFreeTilesListAccesses;
+
+    boost::thread thread(TileAllocationThread(cache, threadIndex, ok));
+    thread.join();
+
+    cache->getTilesTierStats(&tilesTier, &compressedTilesTier);
+    return tilesTier.nFreeTilesListAccesses - accessesBefore;
+}
+
+} // anon namespace
+
+// The free tiles of each thread are refilled in batches: allocating a frame must lock far fewer buckets than
+// when each tile is taken from its bucket
+TEST(Cache, ThreadLocalFreeTilesLockFewerBuckets)
+{
+    CacheBasePtr cache = Cache<false>::create(true /*enableTileStorage*/);
+    ASSERT_TRUE(cache);
+
+    int tileSizeX, tileSizeY;
+    CacheBase::getTileSizePx(eImageBitDepthFloat, &tileSizeX, &tileSizeY);
+    const U64 nTiles = 4 * ((1920 + tileSizeX - 1) / tileSizeX) * ((1080 + tileSizeY - 1) / tileSizeY) * TILES_ALLOCATION_N_FRAMES;
+
+    int bucketTilesOk = 1;
+    cache->setThreadLocalFreeTilesEnabled(false);
+    U64 bucketTilesAccesses = getFreeTilesListAccessesForAllocation(cache, 0, &bucketTilesOk);
+
+    int threadTilesOk = 1;
+    cache->setThreadLocalFreeTilesEnabled(true);
+    U64 threadTilesAccesses = getFreeTilesListAccessesForAllocation(cache, 1, &threadTilesOk);
+
+    EXPECT_TRUE(bucketTilesOk);
+    EXPECT_TRUE(threadTilesOk);
+
+    // Each tile locks its bucket when allocated
+    EXPECT_GE(bucketTilesAccesses, nTiles);
+    EXPECT_GT(threadTilesAccesses, 0U);
+    EXPECT_LT(threadTilesAccesses * 4, bucketTilesAccesses);
+}
+
+namespace {
+
+// Fill a float tile with a smooth gradient, similar to what a render produces
+void
+fillTileWithGradient(std::vector<float>* tile, int tileSizeX, int tileSizeY, float phase)
+{
+    tile->resize(tileSizeX * tileSizeY);
+    for (int y = 0; y < tileSizeY; ++y) {
+        for (int x = 0; x < tileSizeX; ++x) {
+            (*tile)[y * tileSizeX + x] = 0.5f + 0.5f * std::sin(phase + x * 0.05f) * std::cos(y * 0.03f);
+        }
+    }
+}
+
+} // anon namespace
+
+TEST(Cache, TileCompressionRoundTrip)
+{
+    int tileSizeX, tileSizeY;
+    CacheBase::getTileSizePx(eImageBitDepthFloat, &tileSizeX, &tileSizeY);
+
+    std::vector<std::vector<float> > tiles(3);
+    // Black tile
+    tiles[0].resize(tileSizeX * tileSizeY, 0.f);
+    // Smooth tile
+    fillTileWithGradient(&tiles[1], tileSizeX, tileSizeY, 0.f);
+    // Noise that does not compress
+    tiles[2].resize(tileSizeX * tileSizeY);
+    U32 seed = 1;
+    for (std::size_t i = 0; i < tiles[2].size(); ++i) {
+        seed = seed * 1664525 + 1013904223;
+        std::memcpy(&tiles[2][i], &seed, sizeof(float));
+    }
+
+    const std::size_t nBytes = tileSizeX * tileSizeY * sizeof(float);
+    std::vector<char> compressed(TileCompression::getCompressBound(nBytes));
+    std::vector<float> decompressed(tileSizeX * tileSizeY);
+    for (std::size_t i = 0; i < tiles.size(); ++i) {
+        std::size_t compressedSize = TileCompression::compress(&tiles[i][0], nBytes, sizeof(float), &compressed[0], compressed.size());
+        ASSERT_TRUE(compressedSize > 0 && compressedSize <= compressed.size());
+
+        EXPECT_TRUE(TileCompression::decompress(&compressed[0], compressedSize, sizeof(float), &decompressed[0], nBytes));
+        EXPECT_EQ(0, std::memcmp(&tiles[i][0], &decompressed[0], nBytes));
+
+        // Corrupted data must be rejected without reading or writing out of bounds
+        if (compressedSize > 1) {
+            EXPECT_FALSE(TileCompression::decompress(&compressed[0], compressedSize - 1, sizeof(float), &decompressed[0], nBytes));
+        }
+    }
+    // The black and smooth tiles must compress
+    EXPECT_TRUE(TileCompression::compress(&tiles[0][0], nBytes, sizeof(float), &compressed[0], compressed.size()) < nBytes / 100);
+    EXPECT_TRUE(TileCompression::compress(&tiles[1][0], nBytes, sizeof(float), &compressed[0], compressed.size()) < nBytes);
+}
+
+TEST(Cache, CompressedTilesStoragePersistence)
+{
+    QDir tmpDir(QDir::tempPath());
+    QString storageDirName = QString::fromUtf8("NatronCompressedTilesTest");
+    tmpDir.mkpath(storageDirName);
+    std::string storagePath = tmpDir.absoluteFilePath(storageDirName).toStdString() + "/";
+
+    int tileSizeX, tileSizeY;
+    CacheBase::getTileSizePx(eImageBitDepthFloat, &tileSizeX, &tileSizeY);
+    const std::size_t nBytes = tileSizeX * tileSizeY * sizeof(float);
+    const int nTiles = 16;
+
+    std::vector<float> tile, restored(tileSizeX * tileSizeY);
+    {
+        CompressedTilesStorage storage(storagePath);
+        EXPECT_FALSE(storage.isEnabled());
+        storage.setMaximumSize(128 * 1024 * 1024);
+        ASSERT_TRUE(storage.isEnabled());
+        storage.clear();
+
+        for (int i = 0; i < nTiles; ++i) {
+            fillTileWithGradient(&tile, tileSizeX, tileSizeY, (float)i);
+            EXPECT_TRUE(storage.insertTile(i + 1, &tile[0], nBytes, sizeof(float)));
+        }
+        for (int i = 0; i < nTiles; ++i) {
+            EXPECT_TRUE(storage.containsTile(i + 1));
+        }
+        EXPECT_FALSE(storage.containsTile(nTiles + 1));
+
+        // Restore and erase the first tile
+        fillTileWithGradient(&tile, tileSizeX, tileSizeY, 0.f);
+        EXPECT_TRUE(storage.restoreTile(1, &restored[0], nBytes, true));
+        EXPECT_EQ(0, std::memcmp(&tile[0], &restored[0], nBytes));
+        EXPECT_FALSE(storage.containsTile(1));
+
+        std::size_t nStoredTiles, nCompressedBytes, nUncompressedBytes;
+        storage.getStats(&nStoredTiles, &nCompressedBytes, &nUncompressedBytes);
+        EXPECT_EQ( (std::size_t)nTiles - 1, nStoredTiles );
+        EXPECT_EQ( (nTiles - 1) * nBytes, nUncompressedBytes );
+        EXPECT_TRUE(nCompressedBytes < nUncompressedBytes);
+    }
+
+    // The tiles must survive across sessions
+    {
+        CompressedTilesStorage storage(storagePath);
+        storage.setMaximumSize(128 * 1024 * 1024);
+        EXPECT_FALSE(storage.containsTile(1));
+        for (int i = 1; i < nTiles; ++i) {
+            fillTileWithGradient(&tile, tileSizeX, tileSizeY, (float)i);
+            EXPECT_TRUE(storage.restoreTile(i + 1, &restored[0], nBytes, false));
+            EXPECT_EQ(0, std::memcmp(&tile[0], &restored[0], nBytes));
+        }
+
+        // Disabling the storage removes its files
+        storage.setMaximumSize(0);
+        EXPECT_FALSE(storage.isEnabled());
+        EXPECT_FALSE(storage.containsTile(2));
+    }
+    tmpDir.rmdir(storageDirName);
+}
+
+namespace {
+
+// An access to the cache: either a lookup which on a miss inserts the entry with the given cost, or a removal
+struct CacheTraceEvent
+{
+    bool remove;
+    U64 hash;
+    std::size_t size;
+
+    // Time in seconds to compute the entry
+    double cost;
+};
+
+// Reads a trace where each line is "g <hash> <size in bytes> <compute time in seconds>" for a lookup or "r <hash>" for a removal
+bool
+readCacheTrace(const char* filename, std::vector<CacheTraceEvent>* trace)
+{
+    std::ifstream ifile(filename);
+    if (!ifile) {
+        return false;
+    }
+    char type;
+    while (ifile >> type) {
+        CacheTraceEvent e;
+        e.remove = type == 'r';
+        e.size = 0;
+        e.cost = 0;
+        ifile >> e.hash;
+        if (!e.remove) {
+            ifile >> e.size >> e.cost;
+        }
+        trace->push_back(e);
+    }
+    return !trace->empty();
+}
+
+void
+appendTraceLookup(U64 hash, std::size_t size, double cost, std::vector<CacheTraceEvent>* trace)
+{
+    CacheTraceEvent e;
+    e.remove = false;
+    e.hash = hash;
+    e.size = size;
+    e.cost = cost;
+    trace->push_back(e);
+}
+
+// Playback of a Read -> Blur -> Grade graph in a loop, each node output being looked up in the cache.
+// Between each loop the Grade is tweaked, so all its outputs change, and the user scrubs back to the first frames.
+void
+makePlaybackCacheTrace(int nFrames, int nLoops, std::size_t imageSize, std::vector<CacheTraceEvent>* trace)
+{
+    const double readCost = 0.005, blurCost = 0.2, gradeCost = 0.01;
+    for (int loop = 0; loop < nLoops; ++loop) {
+        for (int f = 0; f < nFrames; ++f) {
+            U64 readHash = 1000000 + f;
+            U64 blurHash = 2000000 + f;
+            U64 gradeHash = 3000000 + loop * nFrames + f;
+
+            appendTraceLookup(readHash, imageSize, readCost, trace);
+            appendTraceLookup(blurHash, imageSize, blurCost, trace);
+            appendTraceLookup(gradeHash, imageSize, gradeCost, trace);
+        }
+        // Scrub back to the first frames
+        for (int f = 0; f < nFrames / 4; ++f) {
+            appendTraceLookup(3000000 + loop * nFrames + f, imageSize, gradeCost, trace);
+        }
+    }
+}
+
+struct CacheTraceReplayResults
+{
+    std::size_t nHits, nMisses;
+
+    // Time that was spent recomputing entries that were not found in the cache
+    double recomputeTime;
+};
+
+// Replays the trace against a cache of the given capacity using the given policy
+CacheTraceReplayResults
+replayCacheTrace(CacheEvictionPolicyTypeEnum type, std::size_t capacity, const std::vector<CacheTraceEvent>& trace)
+{
+    CacheTraceReplayResults results;
+    results.nHits = results.nMisses = 0;
+    results.recomputeTime = 0;
+
+    CacheEvictionPolicyPtr policy = CacheEvictionPolicy::create(type);
+    std::map<U64, std::size_t> residents;
+    std::size_t curSize = 0;
+    for (std::size_t i = 0; i < trace.size(); ++i) {
+        const CacheTraceEvent& e = trace[i];
+        double time = (double)i;
+        std::map<U64, std::size_t>::iterator found = residents.find(e.hash);
+        if (e.remove) {
+            if ( found != residents.end() ) {
+                curSize -= found->second;
+                residents.erase(found);
+                policy->removeEntry(e.hash);
+            }
+            continue;
+        }
+        if ( found != residents.end() ) {
+            ++results.nHits;
+            policy->touchEntry(e.hash, e.size, time);
+            continue;
+        }
+        ++results.nMisses;
+        results.recomputeTime += e.cost;
+
+        policy->insertEntry(e.hash, e.size, time);
+        policy->addEntryCost(e.hash, e.cost);
+        residents[e.hash] = e.size;
+        curSize += e.size;
+
+        while (curSize > capacity) {
+            U64 victim;
+            if ( !policy->peekVictim(&victim) ) {
+                break;
+            }
+            policy->removeEntry(victim);
+            std::map<U64, std::size_t>::iterator victimIt = residents.find(victim);
+            EXPECT_TRUE( victimIt != residents.end() );
+            if ( victimIt != residents.end() ) {
+                curSize -= victimIt->second;
+                residents.erase(victimIt);
+            }
+        }
+        EXPECT_EQ( residents.size(), policy->getNumEntries() );
+    }
+    return results;
+}
+
+} // anon namespace
+
+// The victim must stay in the policy until the cache actually evicted it
+TEST(Cache, EvictionPolicyPeekVictim)
+{
+    for (int i = 0; i < 3; ++i) {
+        CacheEvictionPolicyPtr policy = CacheEvictionPolicy::create( (CacheEvictionPolicyTypeEnum)i );
+        for (U64 hash = 1; hash <= 3; ++hash) {
+            policy->insertEntry(hash, 1024, (double)hash);
+        }
+
+        U64 victim, sameVictim;
+        ASSERT_TRUE( policy->peekVictim(&victim) );
+        EXPECT_EQ( (std::size_t)3, policy->getNumEntries() );
+        ASSERT_TRUE( policy->peekVictim(&sameVictim) );
+        EXPECT_EQ(victim, sameVictim);
+
+        policy->removeEntry(victim);
+        EXPECT_EQ( (std::size_t)2, policy->getNumEntries() );
+        U64 nextVictim;
+        ASSERT_TRUE( policy->peekVictim(&nextVictim) );
+        EXPECT_NE(victim, nextVictim);
+    }
+}
+
+TEST(Cache, EvictionPolicyTraceReplay)
+{
+    const std::size_t imageSize = 1920 * 1080 * 4 * sizeof(float);
+    std::vector<CacheTraceEvent> trace;
+
+    // A recorded trace may be replayed instead of the synthetic one
+    const char* traceFile = std::getenv("NATRON_CACHE_TRACE_FILE");
+    std::size_t capacity;
+    if ( traceFile && readCacheTrace(traceFile, &trace) ) {
+        const char* capacityStr = std::getenv("NATRON_CACHE_TRACE_CAPACITY_MB");
+        capacity = (std::size_t)(capacityStr ? std::atof(capacityStr) : 4096.) * 1024 * 1024;
+    } else {
+        makePlaybackCacheTrace(100, 4, imageSize, &trace);
+        // Room for 150 images whereas a loop needs 300
+        capacity = 150 * imageSize;
+    }
+
+    CacheTraceReplayResults results[3];
+    for (int i = 0; i < 3; ++i) {
+        results[i] = replayCacheTrace( (CacheEvictionPolicyTypeEnum)i, capacity, trace );
+        // All policies see the same lookups
+        EXPECT_EQ(results[0].nHits + results[0].nMisses, results[i].nHits + results[i].nMisses);
+    }
+
+    if (!traceFile) {
+        // The Blur outputs are the most expensive to recompute: the cost aware policy must keep them
+        EXPECT_TRUE(results[eCacheEvictionPolicyTypeCostAware].recomputeTime < results[eCacheEvictionPolicyTypeLRU].recomputeTime);
+    }
+}
+
+namespace {
+
+// Inserts in the cache an entry with the given number of float tiles
+CacheEntryBasePtr
+insertEntryWithTiles(const CacheBasePtr& cache, U64 keyHash, int nTiles)
+{
+    CacheEntryBasePtr entry(new CacheEntryBase(cache));
+    entry->setKey( CacheEntryKeyBasePtr( new ImageCacheKey(keyHash, 0, RenderScale(1.), std::string()) ) );
+    {
+        CacheEntryLockerBasePtr locker = cache->get(entry);
+        if (locker->getStatus() != CacheEntryLockerBase::eCacheEntryStatusMustCompute) {
+            return CacheEntryBasePtr();
+        }
+        locker->insertInCache();
+        entry = locker->getProcessLocalEntry();
+    }
+    if (nTiles > 0) {
+        std::vector<TileHash> tilesToAlloc;
+        for (int i = 0; i < nTiles; ++i) {
+            tilesToAlloc.push_back( CacheBase::makeTileCacheIndex(i, 0, 0, 0, entry->getHashKey()) );
+        }
+        std::vector<std::pair<TileInternalIndex, void*> > allocatedTilesData;
+        void* cacheData = 0;
+        bool gotTiles = cache->retrieveAndLockTiles(entry, 0, &tilesToAlloc, 0, &allocatedTilesData, &cacheData);
+        if (cacheData) {
+            cache->unLockTiles(cacheData, false /*invalidate*/);
+        }
+        if (!gotTiles) {
+            return CacheEntryBasePtr();
+        }
+    }
+    return entry;
+}
+
+} // anon namespace
+
+// The size of the entries given to the eviction policy must be the size they take in the cache, tiles included
+TEST(Cache, EvictionPolicyEntrySize)
+{
+    CacheBasePtr cache = Cache<false>::create(true /*enableTileStorage*/);
+    ASSERT_TRUE(cache);
+    cache->setEvictionPolicy(eCacheEvictionPolicyTypeCostAware);
+    cache->setMaximumCacheSize( (std::size_t)1024 * 1024 * 1024 );
+
+    const int nTiles = 4;
+    std::size_t size0 = cache->getCurrentSize();
+    CacheEntryBasePtr entryWithoutTiles = insertEntryWithTiles(cache, 1, 0);
+    ASSERT_TRUE(entryWithoutTiles);
+    std::size_t size1 = cache->getCurrentSize();
+    CacheEntryBasePtr entryWithTiles = insertEntryWithTiles(cache, 2, nTiles);
+    ASSERT_TRUE(entryWithTiles);
+    std::size_t size2 = cache->getCurrentSize();
+    ASSERT_TRUE(size2 - size1 > (std::size_t)nTiles * NATRON_TILE_SIZE_BYTES);
+
+    // Look-up the entry with tiles again so that the policy is told its size with the tiles
+    {
+        CacheEntryBasePtr lookup(new CacheEntryBase(cache));
+        lookup->setKey( entryWithTiles->getKey() );
+        CacheEntryLockerBasePtr locker = cache->get(lookup);
+        ASSERT_EQ(CacheEntryLockerBase::eCacheEntryStatusCached, locker->getStatus());
+    }
+
+    // The cost aware policy evicts first the entry with the lowest cost / size (sizes in MiB, at least 1KiB).
+    // Choose the costs so that the entry without tiles is evicted first with the real sizes, whereas
+    // the entry with tiles would be evicted first if its tiles were counted twice.
+    const double mb = 1024. * 1024.;
+    double sizeWithoutTiles = std::max( (double)(size1 - size0), 1024. ) / mb;
+    double sizeWithTiles = (double)(size2 - size1) / mb;
+    double sizeWithTilesCountedTwice = (double)(size2 - size1 + nTiles * NATRON_TILE_SIZE_BYTES) / mb;
+    const double costWithTiles = 1.;
+    double costWithoutTiles = sizeWithoutTiles * (costWithTiles / sizeWithTiles + costWithTiles / sizeWithTilesCountedTwice) / 2.;
+    cache->addEntryComputeCost(entryWithoutTiles->getHashKey(), costWithoutTiles);
+    cache->addEntryComputeCost(entryWithTiles->getHashKey(), costWithTiles);
+
+    // Evict a single entry
+    cache->setMaximumCacheSize(size2);
+    cache->evictLRUEntries(1);
+    EXPECT_FALSE( cache->hasCacheEntryForHash( entryWithoutTiles->getHashKey() ) );
+    EXPECT_TRUE( cache->hasCacheEntryForHash( entryWithTiles->getHashKey() ) );
+
+    cache->removeEntry(entryWithTiles);
+}
+
+namespace {
+
+// Allocate tiles from a thread pinned to the given NUMA node and check that they come from the buckets of the node
+class NUMANodeTilesAllocationThread
+{
+    CacheBasePtr _cache;
+    int _node, _nNodes;
+    int* _ok;
+
+public:
+
+    NUMANodeTilesAllocationThread(const CacheBasePtr& cache, int node, int nNodes, int* ok)
+    : _cache(cache)
+    , _node(node)
+    , _nNodes(nNodes)
+    , _ok(ok)
+    {
+    }
+
+    void operator()() const
+    {
+        if ( (_nNodes > 1) && !ProcInfo::pinCurrentThreadToNUMANode(_node) ) {
+            // Nothing to check
+            return;
+        }
+        CacheEntryBasePtr entry(new CacheEntryBase(_cache));
+        entry->setKey( CacheEntryKeyBasePtr( new ImageCacheKey(1000 + _node, 0, RenderScale(1.), std::string()) ) );
+        {
+            CacheEntryLockerBasePtr locker = _cache->get(entry);
+            if (locker->getStatus() != CacheEntryLockerBase::eCacheEntryStatusMustCompute) {
+                *_ok = 0;
+                return;
+            }
+            locker->insertInCache();
+            entry = locker->getProcessLocalEntry();
+        }
+        std::vector<TileHash> tilesToAlloc;
+        for (int i = 0; i < 1024; ++i) {
+            tilesToAlloc.push_back( CacheBase::makeTileCacheIndex(i, 0, 0, 0, entry->getHashKey()) );
+        }
+        std::vector<std::pair<TileInternalIndex, void*> > allocatedTilesData;
+        void* cacheData = 0;
+        if ( !_cache->retrieveAndLockTiles(entry, 0, &tilesToAlloc, 0, &allocatedTilesData, &cacheData) ) {
+            *_ok = 0;
+        }
+        // The cache has 256 buckets, @see CacheBase::getBucketCacheBucketIndex
+        const int firstBucket = _node * 256 / _nNodes;
+        const int endBucket = (_node + 1) * 256 / _nNodes;
+        for (std::size_t i = 0; i < allocatedTilesData.size(); ++i) {
+            int bucketIndex = allocatedTilesData[i].first.bucketIndex;
+            if ( (bucketIndex < firstBucket) || (bucketIndex >= endBucket) ) {
+                *_ok = 0;
+            }
+        }
+        if (cacheData) {
+            _cache->unLockTiles(cacheData, false /*invalidate*/);
+        }
+        _cache->removeEntry(entry);
+    }
+};
+
+} // anon namespace
+
+// When the tile storage is spread on NUMA nodes, a thread must allocate tiles whose memory lives on its node
+TEST(Cache, TileStorageSpreadOnNUMANodes)
+{
+    CacheBasePtr cache = Cache<false>::create(true /*enableTileStorage*/);
+    ASSERT_TRUE(cache);
+    cache->setTileStorageMemoryHints(false /*useHugePages*/, true /*spreadOnNUMANodes*/);
+
+    const int nNodes = std::max(1, ProcInfo::getNUMANodesCount());
+    for (int node = 0; node < nNodes; ++node) {
+        int ok = 1;
+        boost::thread t( NUMANodeTilesAllocationThread(cache, node, nNodes, &ok) );
+        t.join();
+        EXPECT_TRUE(ok) << "node " << node;
+    }
+}
+
+namespace {
+
+struct TileStorageConfig
+{
+    const char* name;
+    MemoryFile::AccessPatternEnum accessPattern;
+    bool useHugePages;
+    int numaNode;
+};
+
+// Write tiles in random order to a new tile storage file with the given memory hints, then read them back,
+// as done when rendering images to the cache and then reading them. Returns false if a tile read back differs.
+bool
+writeAndReadTileStorage(const std::string& filePath,
+                        std::size_t fileSize,
+                        const TileStorageConfig& config)
+{
+    MemoryFile file;
+    file.open(filePath, MemoryFile::eFileOpenModeOpenTruncateOrCreate);
+    file.resize(fileSize, false);
+    char* data = file.getData();
+    MemoryFile::adviseAccessPattern(config.accessPattern, data, fileSize);
+    if (config.useHugePages) {
+        MemoryFile::adviseHugePages(data, fileSize);
+    }
+    if (config.numaNode >= 0) {
+        MemoryFile::bindToNUMANode(config.numaNode, data, fileSize);
+    }
+
+    const std::size_t nTiles = fileSize / NATRON_TILE_SIZE_BYTES;
+    std::vector<std::size_t> order(nTiles);
+    for (std::size_t i = 0; i < nTiles; ++i) {
+        order[i] = i;
+    }
+    U32 seed = 1;
+    for (std::size_t i = nTiles - 1; i > 0; --i) {
+        seed = seed * 1664525 + 1013904223;
+        std::swap(order[i], order[seed % (i + 1)]);
+    }
+    std::vector<char> tile(NATRON_TILE_SIZE_BYTES, 1);
+
+    for (std::size_t i = 0; i < nTiles; ++i) {
+        // Stamp each tile with its index to check it when reading it back
+        std::memcpy(&tile[0], &order[i], sizeof(std::size_t));
+        std::memcpy(data + order[i] * NATRON_TILE_SIZE_BYTES, &tile[0], NATRON_TILE_SIZE_BYTES);
+    }
+    bool dataOk = true;
+    for (std::size_t i = 0; i < nTiles; ++i) {
+        std::memcpy(&tile[0], data + order[i] * NATRON_TILE_SIZE_BYTES, NATRON_TILE_SIZE_BYTES);
+        std::size_t index;
+        std::memcpy(&index, &tile[0], sizeof(std::size_t));
+        dataOk &= (index == order[i]);
+    }
+    file.remove();
+
+    return dataOk;
+}
+
+} // anon namespace
+
+TEST(Cache, TileStorageMemoryHints)
+{
+    // The memory hints only affect performance: the tiles must be read back as written with any of them
+    QDir tmpDir(QDir::tempPath());
+    std::string filePath = tmpDir.absoluteFilePath( QString::fromUtf8("NatronTileStorageTest") ).toStdString();
+    const std::size_t fileSize = 16 * 1024 * 1024;
+
+    std::vector<TileStorageConfig> configs;
+    {
+        TileStorageConfig c = {"Default", MemoryFile::eAccessPatternNormal, false, -1};
+        configs.push_back(c);
+    }
+    {
+        TileStorageConfig c = {"Random access", MemoryFile::eAccessPatternRandom, false, -1};
+        configs.push_back(c);
+    }
+    {
+        TileStorageConfig c = {"Random access + huge pages", MemoryFile::eAccessPatternRandom, true, -1};
+        configs.push_back(c);
+    }
+    // On a multi-socket system, bind the memory to each node
+    int nNodes = ProcInfo::getNUMANodesCount();
+    for (int i = 0; i < nNodes && nNodes > 1; ++i) {
+        TileStorageConfig c = {"Random access + NUMA node", MemoryFile::eAccessPatternRandom, false, i};
+        configs.push_back(c);
+    }
+
+    for (std::size_t i = 0; i < configs.size(); ++i) {
+        EXPECT_TRUE( writeAndReadTileStorage(filePath, fileSize, configs[i]) ) << configs[i].name << " " << configs[i].numaNode;
+    }
+}
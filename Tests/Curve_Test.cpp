@@ -24,11 +24,17 @@
 
 #include "Global/Macros.h"
 
+#include <algorithm>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include <QtCore/QString>
 #include <QtCore/QDir>
 
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/thread/thread.hpp>
+#endif
+
 #include "Engine/Curve.h"
 
 NATRON_NAMESPACE_USING
@@ -123,4 +129,236 @@ TEST(Curve, Basic)
 
 }
 
+TEST(Curve, BatchEvaluation)
+{
+    Curve c;
+
+    c.setOrAddKeyframe( KeyFrame(0., 10.) );
+    c.setOrAddKeyframe( KeyFrame(10., 20., 0., 0., eKeyframeTypeLinear) );
+    c.setOrAddKeyframe( KeyFrame(15., -5., 0., 0., eKeyframeTypeConstant) );
+    c.setOrAddKeyframe( KeyFrame(30., 40., 0., 0., eKeyframeTypeCatmullRom) );
+
+    // Increasing times, then times in any order: the results must be the same as getValueAt
+    std::vector<TimeValue> times;
+    for (double t = -10.; t <= 40.; t += 0.25) {
+        times.push_back( TimeValue(t) );
+    }
+    times.push_back( TimeValue(12.) );
+    times.push_back( TimeValue(-3.) );
+    times.push_back( TimeValue(30.) );
+    times.push_back( TimeValue(0.) );
+
+    std::vector<double> values( times.size() );
+    c.getValuesAt(&times[0], times.size(), &values[0]);
+    for (std::size_t i = 0; i < times.size(); ++i) {
+        EXPECT_EQ( c.getValueAt(times[i]).getValue(), values[i] );
+    }
+
+    // The values follow changes to the curve
+    c.setOrAddKeyframe( KeyFrame(0., 100.) );
+    EXPECT_EQ( 100., c.getValueAt(TimeValue(0.)).getValue() );
+    c.getValuesAt(&times[0], times.size(), &values[0]);
+    for (std::size_t i = 0; i < times.size(); ++i) {
+        EXPECT_EQ( c.getValueAt(times[i]).getValue(), values[i] );
+    }
+
+    // Periodic curve
+    Curve p;
+    p.setPeriodic(true);
+    p.setXRange(0., 1.);
+    p.setOrAddKeyframe( KeyFrame(0.25, 1.) );
+    p.setOrAddKeyframe( KeyFrame(0.75, 3.) );
+    std::vector<TimeValue> periodicTimes;
+    for (double t = -2.; t <= 2.; t += 0.05) {
+        periodicTimes.push_back( TimeValue(t) );
+    }
+    std::vector<double> periodicValues( periodicTimes.size() );
+    p.getValuesAt(&periodicTimes[0], periodicTimes.size(), &periodicValues[0]);
+    for (std::size_t i = 0; i < periodicTimes.size(); ++i) {
+        EXPECT_EQ( p.getValueAt(periodicTimes[i]).getValue(), periodicValues[i] );
+    }
+
+    // Integer curves are rounded
+    Curve i(eCurveTypeInt);
+    i.setOrAddKeyframe( KeyFrame(0., 0.) );
+    i.setOrAddKeyframe( KeyFrame(1., 1.) );
+    TimeValue middle(0.6);
+    double middleValue;
+    i.getValuesAt(&middle, 1, &middleValue);
+    EXPECT_EQ( 1., middleValue );
+
+    // An empty curve is 0 everywhere
+    Curve empty;
+    empty.getValuesAt(&times[0], times.size(), &values[0]);
+    EXPECT_EQ( (std::size_t)times.size(), (std::size_t)std::count( values.begin(), values.end(), 0. ) );
+}
+
+namespace {
+
+// A flat curve at the given value, with enough keyframes for the searches to matter
+KeyFrameSet
+makeFlatKeyFrames(double value)
+{
+    KeyFrameSet keys;
+
+    for (int i = 0; i < 100; ++i) {
+        keys.insert( KeyFrame(i, value, 0., 0., eKeyframeTypeLinear) );
+    }
+
+    return keys;
+}
+
+#define CURVE_STRESS_N_ITERATIONS 20000
+
+struct CurveWriterThread
+{
+    Curve* curve;
+    KeyFrameSet first, second;
+
+    CurveWriterThread(Curve* curve, const KeyFrameSet& first, const KeyFrameSet& second)
+    : curve(curve)
+    , first(first)
+    , second(second)
+    {
+    }
+
+    void operator()()
+    {
+        for (int i = 0; i < CURVE_STRESS_N_ITERATIONS; ++i) {
+            curve->setKeyframes( (i % 2) ? second : first, false );
+        }
+    }
+};
+
+struct CurveReaderThread
+{
+    Curve* curve;
+    int* ok;
+
+    CurveReaderThread(Curve* curve, int* ok)
+    : curve(curve)
+    , ok(ok)
+    {
+    }
+
+    void operator()()
+    {
+        std::vector<TimeValue> times;
+        for (double t = -10.; t < 110.; t += 1.5) {
+            times.push_back( TimeValue(t) );
+        }
+        std::vector<double> values( times.size() );
+
+        for (int i = 0; i < CURVE_STRESS_N_ITERATIONS; ++i) {
+            double v = curve->getValueAt( TimeValue(i % 100) ).getValue();
+            if ( (v != 1.) && (v != 2.) ) {
+                *ok = 0;
+            }
+
+            // All the values of a batch come from the same version of the curve
+            curve->getValuesAt(&times[0], times.size(), &values[0]);
+            if ( ( (values[0] != 1.) && (values[0] != 2.) ) ||
+                 ( std::count( values.begin(), values.end(), values[0] ) != (int)values.size() ) ) {
+                *ok = 0;
+            }
+        }
+    }
+};
+
+// Samples the curve as the curve editor does and checks that each batch of values matches one of two versions of the curve
+struct CurveSnapshotReaderThread
+{
+    const Curve* curve;
+    const std::vector<TimeValue>* times;
+    const std::vector<double>* firstValues;
+    const std::vector<double>* secondValues;
+    int* ok;
+
+    CurveSnapshotReaderThread(const Curve* curve,
+                              const std::vector<TimeValue>* times,
+                              const std::vector<double>* firstValues,
+                              const std::vector<double>* secondValues,
+                              int* ok)
+    : curve(curve)
+    , times(times)
+    , firstValues(firstValues)
+    , secondValues(secondValues)
+    , ok(ok)
+    {
+    }
+
+    void operator()()
+    {
+        std::vector<double> values( times->size() );
+        for (int i = 0; i < CURVE_STRESS_N_ITERATIONS / 100; ++i) {
+            curve->getValuesAt(&(*times)[0], times->size(), &values[0]);
+            if ( (values != *firstValues) && (values != *secondValues) ) {
+                *ok = 0;
+            }
+        }
+    }
+};
+
+} // anon namespace
+
+TEST(Curve, ConcurrentReadWrite)
+{
+    Curve c;
+    c.setKeyframes(makeFlatKeyFrames(1.), false);
+
+    const int nReaders = std::max(2, (int)boost::thread::hardware_concurrency() - 1);
+    std::vector<int> readersOk(nReaders, 1);
+    {
+        boost::thread_group threads;
+        threads.create_thread( CurveWriterThread( &c, makeFlatKeyFrames(1.), makeFlatKeyFrames(2.) ) );
+        for (int i = 0; i < nReaders; ++i) {
+            threads.create_thread( CurveReaderThread(&c, &readersOk[i]) );
+        }
+        threads.join_all();
+    }
+    for (int i = 0; i < nReaders; ++i) {
+        EXPECT_TRUE(readersOk[i]);
+    }
+}
+
+TEST(Curve, ConcurrentSamplingMatchesSnapshot)
+{
+    // Two curves with different interpolations and keyframe times
+    KeyFrameSet first, second;
+    for (int i = 0; i < 100; ++i) {
+        first.insert( KeyFrame(i, (i * 37) % 11) );
+        second.insert( KeyFrame(i + 0.5, (i * 13) % 7, 0., 0., eKeyframeTypeLinear) );
+    }
+
+    // Sample the curves as the curve editor does: one sample per pixel over the keyframes range
+    std::vector<TimeValue> times(2000);
+    for (std::size_t i = 0; i < times.size(); ++i) {
+        times[i] = TimeValue(i * 0.05);
+    }
+    std::vector<double> firstValues( times.size() ), secondValues( times.size() );
+    {
+        Curve firstCurve, secondCurve;
+        firstCurve.setKeyframes(first, false);
+        secondCurve.setKeyframes(second, false);
+        firstCurve.getValuesAt(&times[0], times.size(), &firstValues[0]);
+        secondCurve.getValuesAt(&times[0], times.size(), &secondValues[0]);
+    }
+    ASSERT_TRUE(firstValues != secondValues);
 
+    Curve c;
+    c.setKeyframes(first, false);
+
+    const int nReaders = std::max(2, (int)boost::thread::hardware_concurrency() - 1);
+    std::vector<int> readersOk(nReaders, 1);
+    {
+        boost::thread_group threads;
+        threads.create_thread( CurveWriterThread(&c, first, second) );
+        for (int i = 0; i < nReaders; ++i) {
+            threads.create_thread( CurveSnapshotReaderThread(&c, &times, &firstValues, &secondValues, &readersOk[i]) );
+        }
+        threads.join_all();
+    }
+    for (int i = 0; i < nReaders; ++i) {
+        EXPECT_TRUE(readersOk[i]);
+    }
+}
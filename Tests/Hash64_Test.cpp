@@ -24,7 +24,9 @@
 
 #include "Global/Macros.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include "Engine/Hash64.h"
@@ -90,3 +92,132 @@ TEST(Hash64,
     EXPECT_NE(hash1, hash2);
 } // TEST
 
+
+TEST(Hash64,
+     Streaming)
+{
+    srand(2000);
+    std::vector<U64> elements;
+    for (int i = 0; i < 37; ++i) {
+        // coverity[dont_call]
+        elements.push_back( Hash64::toU64<int>( rand() ) );
+    }
+
+    Hash64 reference;
+    for (std::size_t i = 0; i < elements.size(); ++i) {
+        reference.append<U64>(elements[i]);
+    }
+    reference.computeHash();
+
+    // The hash must not depend on how the values were split between calls
+    for (std::size_t split = 0; split <= elements.size(); ++split) {
+        Hash64 hash;
+        std::vector<U64> first(elements.begin(), elements.begin() + split);
+        std::vector<U64> second(elements.begin() + split, elements.end());
+        hash.insert(first);
+        hash.insert(second);
+        hash.computeHash();
+        EXPECT_EQ( reference.value(), hash.value() ) << "split at " << split;
+    }
+
+    // Computing the hash must not prevent appending more values afterwards
+    Hash64 partial;
+    for (std::size_t i = 0; i < elements.size(); ++i) {
+        partial.append<U64>(elements[i]);
+        partial.computeHash();
+        ASSERT_TRUE( partial.valid() );
+    }
+    EXPECT_EQ( reference.value(), partial.value() );
+
+    // Hashes of sequences that are prefixes of each other must differ
+    Hash64 longer = reference;
+    longer.append<U64>(0);
+    longer.computeHash();
+    EXPECT_NE( reference.value(), longer.value() );
+}
+
+// Hash tile-like coordinates (x, y, channel) as done to build tile cache indices
+static void
+computeCoordinatesHashes(std::vector<U64>* hashes)
+{
+    for (int c = 0; c < 4; ++c) {
+        for (int y = 0; y < 256; ++y) {
+            for (int x = 0; x < 256; ++x) {
+                Hash64 hash;
+                hash.append<int>(x);
+                hash.append<int>(y);
+                hash.append<int>(c);
+                hash.computeHash();
+                hashes->push_back( hash.value() );
+            }
+        }
+    }
+}
+
+TEST(Hash64,
+     Collisions)
+{
+    std::vector<U64> hashes;
+    computeCoordinatesHashes(&hashes);
+
+    std::sort( hashes.begin(), hashes.end() );
+    std::size_t nUnique = std::unique( hashes.begin(), hashes.end() ) - hashes.begin();
+    EXPECT_EQ( hashes.size(), nUnique ) << "Distinct inputs should not collide";
+}
+
+// Chi-square of the distribution of 8 bits of the hashes, starting at the given bit, over 256 bins
+static double
+getChiSquare(const std::vector<U64>& hashes, int shift)
+{
+    std::vector<double> bins(256, 0.);
+    for (std::size_t i = 0; i < hashes.size(); ++i) {
+        bins[(hashes[i] >> shift) & 0xff] += 1.;
+    }
+    double expected = hashes.size() / 256.;
+    double chi2 = 0.;
+    for (int i = 0; i < 256; ++i) {
+        chi2 += (bins[i] - expected) * (bins[i] - expected) / expected;
+    }
+    return chi2;
+}
+
+TEST(Hash64,
+     Distribution)
+{
+    std::vector<U64> hashes;
+    computeCoordinatesHashes(&hashes);
+
+    // The cache selects buckets from the high bits of the hash, but check the whole range.
+    // With 255 degrees of freedom, the chi-square exceeds 400 with a probability below 1e-8.
+    for (int shift = 0; shift <= 56; shift += 8) {
+        EXPECT_LT(getChiSquare(hashes, shift), 400.) << "bits " << shift << " to " << shift + 7;
+    }
+
+#ifndef NATRON_HASH64_USE_CRC64
+    // Avalanche: flipping a single input bit should flip half of the output bits on average.
+    // CRC-64 is linear and does not have this property.
+    srand(2000);
+    double nFlippedBits = 0.;
+    int nSamples = 0;
+    for (int i = 0; i < 256; ++i) {
+        // coverity[dont_call]
+        U64 value = ( (U64)rand() << 32 ) ^ (U64)rand();
+        Hash64 hash;
+        hash.append<U64>(value);
+        hash.computeHash();
+        for (int bit = 0; bit < 64; ++bit) {
+            Hash64 flipped;
+            flipped.append<U64>( value ^ ( (U64)1 << bit ) );
+            flipped.computeHash();
+            U64 diff = hash.value() ^ flipped.value();
+            for (; diff; diff &= diff - 1) {
+                nFlippedBits += 1.;
+            }
+            ++nSamples;
+        }
+    }
+    double meanFlippedBits = nFlippedBits / nSamples;
+    EXPECT_GT(meanFlippedBits, 31.);
+    EXPECT_LT(meanFlippedBits, 33.);
+#endif
+}
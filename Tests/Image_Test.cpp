@@ -24,12 +24,20 @@
 
 #include "Global/Macros.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <limits>
+#include <vector>
 #include <gtest/gtest.h>
 
+#include "Engine/Cache.h"
 #include "Engine/Image.h"
 #include "Engine/ImageCacheKey.h"
 #include "Engine/ImageCacheEntryProcessing.h"
+#include "Engine/ImagePrivate.h"
+#include "Engine/ImageSIMD.h"
 #include "Engine/CacheEntryKeyBase.h"
 #include "Engine/ViewIdx.h"
 
@@ -310,4 +318,527 @@ TEST(ImageCacheEntryProcessing, RepeatEdgesGeneralCase) {
 
 #undef getBufAt
 
+namespace {
+
+std::size_t
+getBitDepthSize(ImageBitDepthEnum depth)
+{
+    switch (depth) {
+    case eImageBitDepthByte:
+        return sizeof(unsigned char);
+    case eImageBitDepthShort:
+        return sizeof(unsigned short);
+    case eImageBitDepthFloat:
+    default:
+        return sizeof(float);
+    }
+}
+
+const char*
+getBitDepthName(ImageBitDepthEnum depth)
+{
+    switch (depth) {
+    case eImageBitDepthByte:
+        return "byte";
+    case eImageBitDepthShort:
+        return "short";
+    case eImageBitDepthFloat:
+    default:
+        return "float";
+    }
+}
+
+void
+fillRandomBuffer(ImageBitDepthEnum depth,
+                 std::vector<unsigned char>* buf)
+{
+    std::size_t nElements = buf->size() / getBitDepthSize(depth);
+
+    switch (depth) {
+    case eImageBitDepthByte:
+        for (std::size_t i = 0; i < nElements; ++i) {
+            (*buf)[i] = (unsigned char)(rand() & 0xff);
+        }
+        break;
+    case eImageBitDepthShort: {
+        unsigned short* data = (unsigned short*)&(*buf)[0];
+        for (std::size_t i = 0; i < nElements; ++i) {
+            data[i] = (unsigned short)(rand() & 0xffff);
+        }
+    }   break;
+    case eImageBitDepthFloat:
+    default: {
+        // Also test values outside of the [0, 1] range
+        float* data = (float*)&(*buf)[0];
+        for (std::size_t i = 0; i < nElements; ++i) {
+            data[i] = rand() / (float)RAND_MAX * 1.5f - 0.25f;
+        }
+    }   break;
+    }
+}
+
+// Converts a buffer with packed or coplanar components to a packed buffer
+void
+convertImage(const RectI& renderWindow,
+             const RectI& bounds,
+             int conversionChannel,
+             Image::AlphaChannelHandlingEnum alphaHandling,
+             Image::MonoToPackedConversionEnum monoConversion,
+             const std::vector<unsigned char>& src,
+             int srcNComps,
+             bool srcCoplanar,
+             ImageBitDepthEnum srcDepth,
+             std::vector<unsigned char>* dst,
+             int dstNComps,
+             ImageBitDepthEnum dstDepth)
+{
+    const void* srcPtrs[4] = {NULL, NULL, NULL, NULL};
+    if (srcCoplanar) {
+        std::size_t planeSize = bounds.area() * getBitDepthSize(srcDepth);
+        for (int c = 0; c < srcNComps; ++c) {
+            srcPtrs[c] = &src[c * planeSize];
+        }
+    } else {
+        srcPtrs[0] = &src[0];
+    }
+    void* dstPtrs[4] = {&(*dst)[0], NULL, NULL, NULL};
+
+    // Channels that are not converted must be the same in both outputs
+    std::memset(&(*dst)[0], 0x5a, dst->size());
+
+    // Conversions with dithering use rand()
+    srand(2000);
+
+    ActionRetCodeEnum stat = ImagePrivate::convertCPUImage(renderWindow, eViewerColorSpaceLinear, eViewerColorSpaceLinear, false, conversionChannel, alphaHandling, monoConversion, srcPtrs, srcNComps, srcDepth, bounds, dstPtrs, dstNComps, dstDepth, bounds, EffectInstancePtr());
+
+    EXPECT_EQ(eActionStatusOK, stat);
+}
+
+} // anon namespace
+
+// Check that the vectorized conversions give exactly the same results as the scalar ones,
+// for all combinations of bit depths and components
+TEST(ImageConvert, SIMDMatchesScalar) {
+    const ImageBitDepthEnum depths[3] = {eImageBitDepthByte, eImageBitDepthShort, eImageBitDepthFloat};
+    const Image::AlphaChannelHandlingEnum alphaModes[3] = {
+        Image::eAlphaChannelHandlingCreateFill0, Image::eAlphaChannelHandlingCreateFill1, Image::eAlphaChannelHandlingFillFromChannel
+    };
+    const Image::MonoToPackedConversionEnum monoModes[3] = {
+        Image::eMonoToPackedConversionCopyToChannelAndFillOthers, Image::eMonoToPackedConversionCopyToChannelAndLeaveOthers, Image::eMonoToPackedConversionCopyToAll
+    };
+
+    // Odd sizes and a render window not aligned on the bounds to test the scalar tails of the kernels
+    const RectI bounds(0, 0, 1031, 67);
+    const RectI renderWindow(3, 1, 1030, 66);
+
+    srand(2000);
+
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            std::vector<unsigned char> src(bounds.area() * 4 * getBitDepthSize(depths[i]));
+            std::vector<unsigned char> scalarDst(bounds.area() * 4 * getBitDepthSize(depths[j]));
+            std::vector<unsigned char> simdDst(scalarDst.size());
+            fillRandomBuffer(depths[i], &src);
+
+            for (int srcNComps = 1; srcNComps <= 4; ++srcNComps) {
+                for (int dstNComps = 1; dstNComps <= 4; ++dstNComps) {
+                    for (int srcCoplanar = 0; srcCoplanar < 2; ++srcCoplanar) {
+                        if (srcCoplanar && srcNComps == 1) {
+                            continue;
+                        }
+                        int conversionChannel;
+                        if (dstNComps == 1) {
+                            conversionChannel = srcNComps - 1;
+                        } else if (srcNComps == 1) {
+                            conversionChannel = dstNComps - 1;
+                        } else {
+                            conversionChannel = std::min(srcNComps, dstNComps) - 1;
+                        }
+                        for (int mode = 0; mode < 3; ++mode) {
+                            ImageSIMD::setEnabled(false);
+                            convertImage(renderWindow, bounds, conversionChannel, alphaModes[mode], monoModes[mode], src, srcNComps, srcCoplanar, depths[i], &scalarDst, dstNComps, depths[j]);
+                            ImageSIMD::setEnabled(true);
+                            convertImage(renderWindow, bounds, conversionChannel, alphaModes[mode], monoModes[mode], src, srcNComps, srcCoplanar, depths[i], &simdDst, dstNComps, depths[j]);
+
+                            EXPECT_TRUE(std::memcmp(&scalarDst[0], &simdDst[0], scalarDst.size()) == 0)
+                                << getBitDepthName(depths[i]) << " " << srcNComps << (srcCoplanar ? " coplanar" : "") << " -> "
+                                << getBitDepthName(depths[j]) << " " << dstNComps << ", mode " << mode;
+                        }
+                    }
+                }
+            }
+        }
+    }
+} // TEST(ImageConvert, SIMDMatchesScalar)
+
+namespace {
+
+// Halves an image with packed or coplanar components
+void
+halveBuffer(const std::vector<unsigned char>& src,
+            const RectI& srcBounds,
+            std::vector<unsigned char>* dst,
+            const RectI& dstBounds,
+            int nComps,
+            bool coplanar,
+            ImageBitDepthEnum depth)
+{
+    const void* srcPtrs[4] = {NULL, NULL, NULL, NULL};
+    void* dstPtrs[4] = {NULL, NULL, NULL, NULL};
+    if (coplanar && nComps > 1) {
+        for (int c = 0; c < nComps; ++c) {
+            srcPtrs[c] = &src[c * srcBounds.area() * getBitDepthSize(depth)];
+            dstPtrs[c] = &(*dst)[c * dstBounds.area() * getBitDepthSize(depth)];
+        }
+    } else {
+        srcPtrs[0] = &src[0];
+        dstPtrs[0] = &(*dst)[0];
+    }
+
+    ActionRetCodeEnum stat = ImagePrivate::halveImage(srcPtrs, nComps, depth, srcBounds, dstPtrs, dstBounds, EffectInstancePtr());
+
+    EXPECT_EQ(eActionStatusOK, stat);
+}
+
+// Returns the number of samples of dst that differ from the average of the src samples within srcBounds that they
+// cover, computed pixel by pixel from their coordinates. Float samples may differ by the rounding of the sum.
+template <typename PIX>
+int
+countHalvedImageErrors(const std::vector<unsigned char>& src,
+                       const RectI& srcBounds,
+                       const std::vector<unsigned char>& dst,
+                       const RectI& dstBounds,
+                       int nComps,
+                       bool coplanar)
+{
+    const PIX* srcPixels = (const PIX*)&src[0];
+    const PIX* dstPixels = (const PIX*)&dst[0];
+    int nErrors = 0;
+
+    for (int y = dstBounds.y1; y < dstBounds.y2; ++y) {
+        for (int x = dstBounds.x1; x < dstBounds.x2; ++x) {
+            for (int c = 0; c < nComps; ++c) {
+                double sum = 0.;
+                int count = 0;
+                for (int srcy = y * 2; srcy < y * 2 + 2; ++srcy) {
+                    for (int srcx = x * 2; srcx < x * 2 + 2; ++srcx) {
+                        if ( !srcBounds.contains(srcx, srcy) ) {
+                            continue;
+                        }
+                        const std::size_t srcPixel = (srcy - srcBounds.y1) * srcBounds.width() + (srcx - srcBounds.x1);
+                        sum += coplanar ? srcPixels[c * srcBounds.area() + srcPixel] : srcPixels[srcPixel * nComps + c];
+                        ++count;
+                    }
+                }
+                const std::size_t dstPixel = (y - dstBounds.y1) * dstBounds.width() + (x - dstBounds.x1);
+                const PIX value = coplanar ? dstPixels[c * dstBounds.area() + dstPixel] : dstPixels[dstPixel * nComps + c];
+                if (std::numeric_limits<PIX>::is_integer) {
+                    // Integer samples are truncated
+                    if ( value != (PIX)( (int)sum / count ) ) {
+                        ++nErrors;
+                    }
+                } else if (std::fabs(value - sum / count) > 1e-6) {
+                    ++nErrors;
+                }
+            }
+        }
+    }
+
+    return nErrors;
+} // countHalvedImageErrors
+
+int
+countHalvedImageErrors(ImageBitDepthEnum depth,
+                       const std::vector<unsigned char>& src,
+                       const RectI& srcBounds,
+                       const std::vector<unsigned char>& dst,
+                       const RectI& dstBounds,
+                       int nComps,
+                       bool coplanar)
+{
+    switch (depth) {
+    case eImageBitDepthByte:
+        return countHalvedImageErrors<unsigned char>(src, srcBounds, dst, dstBounds, nComps, coplanar);
+    case eImageBitDepthShort:
+        return countHalvedImageErrors<unsigned short>(src, srcBounds, dst, dstBounds, nComps, coplanar);
+    case eImageBitDepthFloat:
+    default:
+        return countHalvedImageErrors<float>(src, srcBounds, dst, dstBounds, nComps, coplanar);
+    }
+}
+
+// One channel of an image split in tiles of the cache, for each mipmap level
+class TilePyramid
+{
+    int _tileSizeX, _tileSizeY;
+    std::vector<int> _nTilesX, _nTilesY;
+    std::vector<std::vector<float> > _levels;
+
+public:
+
+    TilePyramid(int width, int height, int tileSizeX, int tileSizeY, unsigned int nLevels)
+    : _tileSizeX(tileSizeX)
+    , _tileSizeY(tileSizeY)
+    , _nTilesX(nLevels + 1)
+    , _nTilesY(nLevels + 1)
+    , _levels(nLevels + 1)
+    {
+        _nTilesX[0] = (width + tileSizeX - 1) / tileSizeX;
+        _nTilesY[0] = (height + tileSizeY - 1) / tileSizeY;
+        for (unsigned int i = 1; i <= nLevels; ++i) {
+            _nTilesX[i] = (_nTilesX[i - 1] + 1) / 2;
+            _nTilesY[i] = (_nTilesY[i - 1] + 1) / 2;
+        }
+        for (unsigned int i = 0; i <= nLevels; ++i) {
+            _levels[i].resize(_nTilesX[i] * _nTilesY[i] * tileSizeX * tileSizeY);
+        }
+        for (std::size_t i = 0; i < _levels[0].size(); ++i) {
+            _levels[0][i] = rand() / (float)RAND_MAX;
+        }
+    }
+
+    int getNTilesX(unsigned int level) const
+    {
+        return _nTilesX[level];
+    }
+
+    int getNTilesY(unsigned int level) const
+    {
+        return _nTilesY[level];
+    }
+
+    const std::vector<float>& getLevel(unsigned int level) const
+    {
+        return _levels[level];
+    }
+
+    float* getTile(unsigned int level, int tx, int ty)
+    {
+        if ( (tx >= _nTilesX[level]) || (ty >= _nTilesY[level]) ) {
+            return NULL;
+        }
+        return &_levels[level][(ty * _nTilesX[level] + tx) * _tileSizeX * _tileSizeY];
+    }
+
+    // Produce the tile at level from the 4 tiles above it at level - 1
+    void downscaleTile(unsigned int level, int tx, int ty)
+    {
+        const void* srcTiles[4] = {
+            getTile(level - 1, tx * 2, ty * 2), getTile(level - 1, tx * 2 + 1, ty * 2),
+            getTile(level - 1, tx * 2, ty * 2 + 1), getTile(level - 1, tx * 2 + 1, ty * 2 + 1)
+        };
+        RectI tileBounds(tx * _tileSizeX, ty * _tileSizeY, (tx + 1) * _tileSizeX, (ty + 1) * _tileSizeY);
+        ImageCacheEntryProcessing::downscaleMipMap(eImageBitDepthFloat, srcTiles, getTile(level, tx, ty), tileBounds, _tileSizeX, _tileSizeY);
+    }
+
+    // Produce the tile at level and all the tiles it depends on in the lower levels, depth first
+    void downscaleTileRecursive(unsigned int level, int tx, int ty)
+    {
+        if (level > 1) {
+            for (int y = 0; y < 2; ++y) {
+                for (int x = 0; x < 2; ++x) {
+                    if (getTile(level - 1, tx * 2 + x, ty * 2 + y)) {
+                        downscaleTileRecursive(level - 1, tx * 2 + x, ty * 2 + y);
+                    }
+                }
+            }
+        }
+        downscaleTile(level, tx, ty);
+    }
+};
+
+} // anon namespace
+
+// Check that halving an image with the scalar code and with the vectorized kernels averages the src pixels covered
+// by each dst pixel and that both give exactly the same results, for bounds that are not aligned on even coordinates
+// and a dst window that does not cover the whole image
+TEST(ImageHalve, SIMDMatchesScalar) {
+    const ImageBitDepthEnum depths[3] = {eImageBitDepthByte, eImageBitDepthShort, eImageBitDepthFloat};
+    const RectI srcBounds(-7, 3, 1030, 70);
+    const RectI dstBounds = srcBounds.downscalePowerOfTwoSmallestEnclosing(1);
+    const RectI dstWindows[2] = {dstBounds, RectI(dstBounds.x1 + 3, dstBounds.y1 + 2, dstBounds.x2 - 5, dstBounds.y2 - 1)};
+
+    srand(2000);
+
+    for (int i = 0; i < 3; ++i) {
+        std::vector<unsigned char> src(srcBounds.area() * 4 * getBitDepthSize(depths[i]));
+        fillRandomBuffer(depths[i], &src);
+        for (int w = 0; w < 2; ++w) {
+            std::vector<unsigned char> scalarDst(dstWindows[w].area() * 4 * getBitDepthSize(depths[i]));
+            std::vector<unsigned char> simdDst(scalarDst.size());
+            for (int nComps = 1; nComps <= 4; ++nComps) {
+                for (int coplanar = 0; coplanar < 2; ++coplanar) {
+                    ImageSIMD::setEnabled(false);
+                    halveBuffer(src, srcBounds, &scalarDst, dstWindows[w], nComps, coplanar, depths[i]);
+                    ImageSIMD::setEnabled(true);
+                    halveBuffer(src, srcBounds, &simdDst, dstWindows[w], nComps, coplanar, depths[i]);
+
+                    EXPECT_EQ( 0, countHalvedImageErrors(depths[i], src, srcBounds, scalarDst, dstWindows[w], nComps, coplanar) )
+                        << "scalar " << getBitDepthName(depths[i]) << " " << nComps << (coplanar ? " coplanar" : "") << ", window " << w;
+                    EXPECT_EQ( 0, countHalvedImageErrors(depths[i], src, srcBounds, simdDst, dstWindows[w], nComps, coplanar) )
+                        << "SIMD " << getBitDepthName(depths[i]) << " " << nComps << (coplanar ? " coplanar" : "") << ", window " << w;
+                    EXPECT_TRUE(std::memcmp(&scalarDst[0], &simdDst[0], scalarDst.size()) == 0)
+                        << getBitDepthName(depths[i]) << " " << nComps << (coplanar ? " coplanar" : "") << ", window " << w;
+                }
+            }
+        }
+    }
+} // TEST(ImageHalve, SIMDMatchesScalar)
+
+// Check the mipmap levels 1 to 4 of a float RGBA image: halving the image level after level must average the pixels
+// of the level above at each level, and on cache tiles, downscaling all the tiles of a level before the next one or
+// each sub-pyramid depth first must produce the same levels.
+TEST(ImageHalve, MipMapLevels) {
+    const unsigned int nLevels = 4;
+    const RectI bounds(0, 0, 1031, 541);
+
+    srand(2000);
+
+    std::vector<unsigned char> src(bounds.area() * 4 * sizeof(float));
+    fillRandomBuffer(eImageBitDepthFloat, &src);
+
+    RectI srcBounds = bounds;
+    for (unsigned int level = 1; level <= nLevels; ++level) {
+        RectI dstBounds = srcBounds.downscalePowerOfTwoSmallestEnclosing(1);
+        std::vector<unsigned char> dst(dstBounds.area() * 4 * sizeof(float));
+        halveBuffer(src, srcBounds, &dst, dstBounds, 4, false, eImageBitDepthFloat);
+        EXPECT_EQ( 0, countHalvedImageErrors(eImageBitDepthFloat, src, srcBounds, dst, dstBounds, 4, false) ) << "level " << level;
+        src.swap(dst);
+        srcBounds = dstBounds;
+    }
+
+    // Tiles of the cache hold a single channel
+    const int tileSizeX = NATRON_TILE_SIZE_X_32_BIT;
+    const int tileSizeY = NATRON_TILE_SIZE_Y_32_BIT;
+    const int nComps = 4;
+    std::vector<boost::shared_ptr<TilePyramid> > levelByLevel(nComps), depthFirst(nComps);
+    for (int c = 0; c < nComps; ++c) {
+        srand(2000 + c);
+        levelByLevel[c].reset(new TilePyramid(bounds.width(), bounds.height(), tileSizeX, tileSizeY, nLevels));
+        srand(2000 + c);
+        depthFirst[c].reset(new TilePyramid(bounds.width(), bounds.height(), tileSizeX, tileSizeY, nLevels));
+    }
+
+    for (unsigned int level = 1; level <= nLevels; ++level) {
+        for (int c = 0; c < nComps; ++c) {
+            for (int ty = 0; ty < levelByLevel[c]->getNTilesY(level); ++ty) {
+                for (int tx = 0; tx < levelByLevel[c]->getNTilesX(level); ++tx) {
+                    levelByLevel[c]->downscaleTile(level, tx, ty);
+                }
+            }
+        }
+    }
+
+    for (int c = 0; c < nComps; ++c) {
+        for (int ty = 0; ty < depthFirst[c]->getNTilesY(nLevels); ++ty) {
+            for (int tx = 0; tx < depthFirst[c]->getNTilesX(nLevels); ++tx) {
+                depthFirst[c]->downscaleTileRecursive(nLevels, tx, ty);
+            }
+        }
+    }
+
+    // Both orders must produce the same levels
+    for (int c = 0; c < nComps; ++c) {
+        for (unsigned int level = 1; level <= nLevels; ++level) {
+            EXPECT_TRUE(levelByLevel[c]->getLevel(level) == depthFirst[c]->getLevel(level)) << "channel " << c << ", level " << level;
+        }
+    }
+} // TEST(ImageHalve, MipMapLevels)
+
+namespace {
+
+// Dissolves a buffer with packed or coplanar components to the original buffer through a mask, replacing NaNs
+// if foundNan is not NULL. If checkNaNsFirst is true, NaNs are replaced in a separate pass before mixing instead.
+void
+applyMaskMix(const std::vector<unsigned char>& src,
+             const std::vector<unsigned char>& mask,
+             bool masked,
+             bool maskInvert,
+             std::vector<unsigned char>* dst,
+             const RectI& bounds,
+             const RectI& roi,
+             int nComps,
+             bool coplanar,
+             ImageBitDepthEnum depth,
+             bool checkNaNsFirst,
+             bool* foundNan)
+{
+    const void* srcPtrs[4] = {NULL, NULL, NULL, NULL};
+    void* dstPtrs[4] = {NULL, NULL, NULL, NULL};
+    if (coplanar && nComps > 1) {
+        for (int c = 0; c < nComps; ++c) {
+            srcPtrs[c] = &src[c * bounds.area() * getBitDepthSize(depth)];
+            dstPtrs[c] = &(*dst)[c * bounds.area() * getBitDepthSize(depth)];
+        }
+    } else {
+        srcPtrs[0] = &src[0];
+        dstPtrs[0] = &(*dst)[0];
+    }
+    const void* maskPtrs[4] = {masked ? &mask[0] : NULL, NULL, NULL, NULL};
+
+    if (checkNaNsFirst) {
+        EXPECT_EQ( eActionStatusOK, ImagePrivate::checkForNaNs(dstPtrs, nComps, depth, bounds, roi, EffectInstancePtr(), foundNan) );
+    }
+    ActionRetCodeEnum stat = ImagePrivate::applyMaskMixCPU(srcPtrs, bounds, nComps, maskPtrs, bounds, dstPtrs, depth, nComps, 0.37, maskInvert, bounds, roi, EffectInstancePtr(), checkNaNsFirst ? NULL : foundNan);
+
+    EXPECT_EQ(eActionStatusOK, stat);
+}
+
+void
+addRandomNaNs(std::vector<unsigned char>* buf)
+{
+    float* data = (float*)&(*buf)[0];
+    std::size_t nElements = buf->size() / sizeof(float);
+    for (std::size_t i = 0; i < nElements; i += 97) {
+        data[i] = std::numeric_limits<float>::quiet_NaN();
+    }
+}
+
+} // anon namespace
+
+// Check that the vectorized mask/mix gives exactly the same results as the scalar code, and that replacing NaNs
+// in the same pass gives the same results as replacing them with checkForNaNs before mixing
+TEST(ImageMaskMix, SIMDMatchesScalar) {
+    const ImageBitDepthEnum depths[3] = {eImageBitDepthByte, eImageBitDepthShort, eImageBitDepthFloat};
+    const RectI bounds(0, 0, 1031, 37);
+    const RectI roi(3, 1, 1030, 36);
+
+    srand(2000);
 
+    for (int i = 0; i < 3; ++i) {
+        std::vector<unsigned char> src(bounds.area() * 4 * getBitDepthSize(depths[i]));
+        std::vector<unsigned char> mask(bounds.area() * getBitDepthSize(depths[i]));
+        std::vector<unsigned char> originalDst(src.size());
+        fillRandomBuffer(depths[i], &src);
+        fillRandomBuffer(depths[i], &mask);
+        fillRandomBuffer(depths[i], &originalDst);
+        const bool withNaNs = depths[i] == eImageBitDepthFloat;
+        if (withNaNs) {
+            addRandomNaNs(&originalDst);
+        }
+
+        for (int nComps = 1; nComps <= 4; ++nComps) {
+            for (int coplanar = 0; coplanar < 2; ++coplanar) {
+                for (int maskMode = 0; maskMode < 3; ++maskMode) {
+                    const bool masked = maskMode > 0;
+                    const bool maskInvert = maskMode == 2;
+
+                    std::vector<unsigned char> scalarDst = originalDst;
+                    bool scalarFoundNaN = false;
+                    ImageSIMD::setEnabled(false);
+                    applyMaskMix(src, mask, masked, maskInvert, &scalarDst, bounds, roi, nComps, coplanar, depths[i], true, &scalarFoundNaN);
+
+                    std::vector<unsigned char> simdDst = originalDst;
+                    bool simdFoundNaN = false;
+                    ImageSIMD::setEnabled(true);
+                    applyMaskMix(src, mask, masked, maskInvert, &simdDst, bounds, roi, nComps, coplanar, depths[i], false, &simdFoundNaN);
+
+                    EXPECT_TRUE(std::memcmp(&scalarDst[0], &simdDst[0], scalarDst.size()) == 0)
+                        << getBitDepthName(depths[i]) << " " << nComps << (coplanar ? " coplanar" : "") << ", mask mode " << maskMode;
+                    EXPECT_EQ(withNaNs, scalarFoundNaN);
+                    EXPECT_EQ(withNaNs, simdFoundNaN);
+                }
+            }
+        }
+    }
+} // TEST(ImageMaskMix, SIMDMatchesScalar)
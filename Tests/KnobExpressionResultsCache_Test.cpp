@@ -0,0 +1,160 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <vector>
+#include <gtest/gtest.h>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/thread/thread.hpp>
+#endif
+
+#include "Engine/KnobExpressionResultsCache.h"
+
+NATRON_NAMESPACE_USING
+
+typedef KnobExpressionResultsCache<double> DoubleResultsCache;
+
+namespace {
+
+DoubleResultsCache::Key
+makeKey(U64 knobID,
+        int generation,
+        double time)
+{
+    DoubleResultsCache::Key key;
+
+    key.knobID = knobID;
+    key.generation = generation;
+    key.dimension = 0;
+    key.view = 0;
+    key.time = time;
+
+    return key;
+}
+
+struct ResultsCacheThread
+{
+    DoubleResultsCache* cache;
+    U64 knobID;
+    int nFrames;
+    int* ok;
+
+    ResultsCacheThread(DoubleResultsCache* cache,
+                       U64 knobID,
+                       int nFrames,
+                       int* ok)
+    : cache(cache)
+    , knobID(knobID)
+    , nFrames(nFrames)
+    , ok(ok)
+    {
+    }
+
+    void operator()()
+    {
+        for (int pass = 0; pass < 10; ++pass) {
+            for (int i = 0; i < nFrames; ++i) {
+                DoubleResultsCache::Key key = makeKey(knobID, 0, i);
+                double value;
+                if ( cache->get(key, &value) ) {
+                    if ( value != (double)(knobID * 1000 + i) ) {
+                        *ok = 0;
+                    }
+                } else {
+                    cache->insert(key, (double)(knobID * 1000 + i));
+                }
+            }
+        }
+    }
+};
+} // anon namespace
+
+TEST(KnobExpressionResultsCache, Invalidation)
+{
+    DoubleResultsCache cache;
+    double value = 0.;
+
+    EXPECT_FALSE( cache.get(makeKey(1, 0, 10.), &value) );
+    cache.insert(makeKey(1, 0, 10.), 42.);
+    ASSERT_TRUE( cache.get(makeKey(1, 0, 10.), &value) );
+    EXPECT_EQ(42., value);
+
+    // Other knobs, frames and generations do not see this result
+    EXPECT_FALSE( cache.get(makeKey(2, 0, 10.), &value) );
+    EXPECT_FALSE( cache.get(makeKey(1, 0, 11.), &value) );
+    EXPECT_FALSE( cache.get(makeKey(1, 1, 10.), &value) );
+
+    // Inserting the same key again replaces the result
+    cache.insert(makeKey(1, 0, 10.), 43.);
+    ASSERT_TRUE( cache.get(makeKey(1, 0, 10.), &value) );
+    EXPECT_EQ(43., value);
+    EXPECT_EQ( (std::size_t)1, cache.size() );
+
+    cache.clear();
+    EXPECT_FALSE( cache.get(makeKey(1, 0, 10.), &value) );
+}
+
+TEST(KnobExpressionResultsCache, LeastRecentlyUsedEviction)
+{
+    DoubleResultsCache cache;
+    const int maxEntries = DoubleResultsCache::kNumShards * (int)DoubleResultsCache::kMaxEntriesPerShard;
+
+    // Frame 0 is read after each insertion so that it remains the most recently used
+    cache.insert(makeKey(1, 0, 0.), 0.);
+    for (int i = 1; i < maxEntries * 2; ++i) {
+        cache.insert(makeKey(1, 0, i), i);
+        double value;
+        ASSERT_TRUE( cache.get(makeKey(1, 0, 0.), &value) );
+    }
+    EXPECT_LE( cache.size(), (std::size_t)maxEntries );
+
+    // The most recent results remain, the oldest were evicted
+    double value;
+    EXPECT_TRUE( cache.get(makeKey(1, 0, maxEntries * 2 - 1), &value) );
+    EXPECT_FALSE( cache.get(makeKey(1, 0, 1.), &value) );
+}
+
+TEST(KnobExpressionResultsCache, ConcurrentAccess)
+{
+    DoubleResultsCache cache;
+    const int nFrames = 500;
+    int nThreads = std::max(2, (int)boost::thread::hardware_concurrency());
+    std::vector<int> ok(nThreads, 1);
+
+    {
+        // Threads work on 2 knobs only, so that they read the results inserted by the others
+        boost::thread_group threads;
+        for (int i = 0; i < nThreads; ++i) {
+            threads.create_thread( ResultsCacheThread(&cache, i % 2, nFrames, &ok[i]) );
+        }
+        threads.join_all();
+    }
+    for (int i = 0; i < nThreads; ++i) {
+        EXPECT_EQ(1, ok[i]);
+    }
+    EXPECT_EQ( (std::size_t)(2 * nFrames), cache.size() );
+}
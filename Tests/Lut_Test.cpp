@@ -24,9 +24,12 @@
 
 #include "Global/Macros.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <vector>
 #include <gtest/gtest.h>
 #include "Engine/Lut.h"
+#include "Engine/RectI.h"
 
 NATRON_NAMESPACE_USING
 using namespace NATRON_NAMESPACE::Color;
@@ -51,3 +54,104 @@ TEST(Lut, IntConversions) {
         EXPECT_EQ( i, uint8xxToChar( charToUint8xx(i) ) );
     }
 }
+
+static std::vector<const Lut*>
+getAllLuts()
+{
+    std::vector<const Lut*> luts;
+    luts.push_back( LutManager::sRGBLut() );
+    luts.push_back( LutManager::Rec709Lut() );
+    luts.push_back( LutManager::CineonLut() );
+    luts.push_back( LutManager::Gamma1_8Lut() );
+    luts.push_back( LutManager::Gamma2_2Lut() );
+    luts.push_back( LutManager::PanalogLut() );
+    luts.push_back( LutManager::ViperLogLut() );
+    luts.push_back( LutManager::REDLogLut() );
+    luts.push_back( LutManager::AlexaV3LogCLut() );
+    luts.push_back( LutManager::SLog1Lut() );
+    luts.push_back( LutManager::SLog2Lut() );
+    luts.push_back( LutManager::SLog3Lut() );
+    luts.push_back( LutManager::VLogLut() );
+    for (std::size_t i = 0; i < luts.size(); ++i) {
+        luts[i]->validate();
+    }
+
+    return luts;
+}
+
+TEST(Lut, Uint16Conversions) {
+    std::vector<const Lut*> luts = getAllLuts();
+
+    for (std::size_t l = 0; l < luts.size(); ++l) {
+        const Lut* lut = luts[l];
+        int maxToError = 0;
+        int maxRoundTripError = 0;
+
+        // The from table is exact
+        for (int i = 0; i < 0x10000; ++i) {
+            EXPECT_EQ( lut->fromColorSpaceFloatToLinearFloat( intToFloat<65536>(i) ), lut->fromColorSpaceUint16ToLinearFloatFast(i) ) << lut->getName();
+        }
+
+        // The to table is interpolated
+        for (int i = -1000; i <= 1200000; ++i) {
+            float v = i / 1000000.f;
+            int exact = floatToInt<65536>( lut->toColorSpaceFloatFromLinearFloat(v) );
+            int fast = lut->toColorSpaceUint16FromLinearFloatFast(v);
+            maxToError = std::max( maxToError, std::abs(exact - fast) );
+        }
+
+        // Not all transfer functions are exactly invertible: compare with the round-trip of the exact functions
+        for (int i = 0; i < 0x10000; ++i) {
+            int exact = floatToInt<65536>( lut->toColorSpaceFloatFromLinearFloat( lut->fromColorSpaceFloatToLinearFloat( intToFloat<65536>(i) ) ) );
+            int fast = lut->toColorSpaceUint16FromLinearFloatFast( lut->fromColorSpaceUint16ToLinearFloatFast(i) );
+            maxRoundTripError = std::max( maxRoundTripError, std::abs(exact - fast) );
+        }
+
+        EXPECT_LE(maxToError, 2) << lut->getName();
+        EXPECT_LE(maxRoundTripError, 1) << lut->getName();
+    }
+}
+
+TEST(Lut, Uint16ScanLines) {
+    const Lut* lut = LutManager::sRGBLut();
+    lut->validate();
+
+    // Batched conversions must give the same results as the per-value ones
+    const int width = 1001;
+    std::vector<unsigned short> shortPixels(width * 3);
+    std::vector<float> floatPixels(width * 3);
+    for (int i = 0; i < width * 3; ++i) {
+        shortPixels[i] = (unsigned short)(i * 65);
+    }
+    lut->fromColorSpaceUint16ToLinearFloatFast(&shortPixels[1], 3, &floatPixels[1], 3, width);
+    for (int i = 0; i < width; ++i) {
+        EXPECT_EQ( lut->fromColorSpaceUint16ToLinearFloatFast(shortPixels[i * 3 + 1]), floatPixels[i * 3 + 1] );
+    }
+    std::vector<unsigned short> converted(width);
+    lut->toColorSpaceUint16FromLinearFloatFast(&floatPixels[1], 3, &converted[0], 1, width);
+    for (int i = 0; i < width; ++i) {
+        EXPECT_EQ( lut->toColorSpaceUint16FromLinearFloatFast(floatPixels[i * 3 + 1]), converted[i] );
+        // sRGB round-trips exactly
+        EXPECT_EQ(shortPixels[i * 3 + 1], converted[i]);
+    }
+
+    // Packed RGBA round-trip
+    RectI bounds(0, 0, 67, 13);
+    std::vector<unsigned short> src(bounds.width() * bounds.height() * 4);
+    std::vector<float> linear( src.size() );
+    std::vector<unsigned short> dst( src.size() );
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        src[i] = (unsigned short)( (i * 977) & 0xffff );
+    }
+    lut->from_short_packed(&linear[0], &src[0], bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingRGBA, false, false);
+    // to_short_packed flips the output vertically: flip the input as well
+    lut->to_short_packed(&dst[0], &linear[0], bounds, bounds, bounds, ePixelPackingRGBA, ePixelPackingRGBA, true, false);
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        if (i % 4 == 3) {
+            // alpha is not premultiplied
+            EXPECT_EQ(65535, dst[i]);
+        } else {
+            EXPECT_EQ(src[i], dst[i]);
+        }
+    }
+}
@@ -0,0 +1,147 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/thread/thread.hpp>
+#endif
+
+#include "Engine/RenderTracer.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+
+int nDetailsEvaluated = 0;
+
+std::string
+getDetail()
+{
+    ++nDetailsEvaluated;
+
+    return std::string("Blur1 \"RGBA\"");
+}
+
+std::size_t
+countOccurrences(const std::string& str,
+                 const std::string& pattern)
+{
+    std::size_t n = 0;
+    for (std::size_t pos = str.find(pattern); pos != std::string::npos; pos = str.find(pattern, pos + 1)) {
+        ++n;
+    }
+
+    return n;
+}
+
+// Records an event on its own thread, then exits
+struct TraceEventThread
+{
+    void operator()()
+    {
+        RenderTracer::addEvent("test", "Worker", 0., 1., std::string());
+    }
+};
+
+} // anon namespace
+
+TEST(RenderTracer, ChromeTraceExport)
+{
+    RenderTracer::clear();
+
+    // Nothing is recorded when disabled, and the detail is not evaluated
+    RenderTracer::setEnabled(false);
+    nDetailsEvaluated = 0;
+    {
+        NATRON_RENDER_TRACE_SCOPE_DETAIL( "task", "Ignored", getDetail() );
+        EXPECT_FALSE( natronRenderTraceScope.isRecording() );
+    }
+    EXPECT_EQ(0, nDetailsEvaluated);
+
+    RenderTracer::setEnabled(true);
+    {
+        NATRON_RENDER_TRACE_SCOPE_DETAIL( "task", "Render", getDetail() );
+        ASSERT_TRUE( natronRenderTraceScope.isRecording() );
+    }
+    EXPECT_EQ(1, nDetailsEvaluated);
+    RenderTracer::setEnabled(false);
+
+    std::stringstream ss;
+    RenderTracer::writeChromeTrace(ss);
+    std::string trace = ss.str();
+
+    EXPECT_EQ( std::string::npos, trace.find("Ignored") );
+    EXPECT_NE( std::string::npos, trace.find("\"name\":\"Render\",\"cat\":\"task\",\"ph\":\"X\"") );
+    EXPECT_NE( std::string::npos, trace.find("\"detail\":\"Blur1 \\\"RGBA\\\"\"") );
+    EXPECT_NE( std::string::npos, trace.find("\"thread_name\"") );
+
+    // Cleared events are not exported
+    RenderTracer::clear();
+    ss.str( std::string() );
+    RenderTracer::writeChromeTrace(ss);
+    EXPECT_EQ( std::string::npos, ss.str().find("\"Render\"") );
+}
+
+TEST(RenderTracer, RingBufferKeepsMostRecentEvents)
+{
+    RenderTracer::clear();
+    RenderTracer::setEnabled(true);
+
+    // Overflow the ring buffer of this thread: the first event is overwritten
+    RenderTracer::addEvent("test", "First", 0., 1., std::string());
+    for (std::size_t i = 0; i < RenderTracer::kEventsPerThread; ++i) {
+        RenderTracer::addEvent("test", "Next", 1., 1., std::string());
+    }
+    RenderTracer::setEnabled(false);
+
+    std::stringstream ss;
+    RenderTracer::writeChromeTrace(ss);
+    EXPECT_EQ( std::string::npos, ss.str().find("\"First\"") );
+    EXPECT_NE( std::string::npos, ss.str().find("\"Next\"") );
+    RenderTracer::clear();
+}
+
+TEST(RenderTracer, ExitedThreadBuffersAreRecycled)
+{
+    RenderTracer::clear();
+    RenderTracer::setEnabled(true);
+
+    // Each thread exits before the next one starts: they all record in the same buffer
+    for (int i = 0; i < 4; ++i) {
+        boost::thread t( (TraceEventThread()) );
+        t.join();
+    }
+    RenderTracer::setEnabled(false);
+
+    std::stringstream ss;
+    RenderTracer::writeChromeTrace(ss);
+    EXPECT_EQ( (std::size_t)1, countOccurrences(ss.str(), "\"thread_name\"") );
+    EXPECT_EQ( (std::size_t)1, countOccurrences(ss.str(), "\"Worker\"") );
+    RenderTracer::clear();
+}
@@ -49,12 +49,20 @@ SOURCES += \
     google-test/src/gtest_main.cc \
     google-mock/src/gmock-all.cc \
     BaseTest.cpp \
+    BinaryProject_Test.cpp \
+    Cache_Test.cpp \
     Hash64_Test.cpp \
     Image_Test.cpp \
     Lut_Test.cpp \
+    KnobExpressionResultsCache_Test.cpp \
     KnobFile_Test.cpp \
     Curve_Test.cpp \
+    RenderTracer_Test.cpp \
+    ThreadPool_Test.cpp \
     Tracker_Test.cpp \
+    TreeRenderScheduling_Test.cpp \
+    ViewerInstance_Test.cpp \
+    ViewerPrefetch_Test.cpp \
     wmain.cpp
 
 HEADERS += \
@@ -0,0 +1,332 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtCore/QWaitCondition>
+
+#include "Engine/ThreadPool.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+
+// A task that keeps a thread busy for a few microseconds, as a render of a small tile would
+class ComputeTask
+    : public QRunnable
+{
+    QAtomicInt* _nTasksDone;
+
+public:
+
+    ComputeTask(QAtomicInt* nTasksDone)
+    : QRunnable()
+    , _nTasksDone(nTasksDone)
+    {
+    }
+
+    virtual void run() OVERRIDE FINAL
+    {
+        volatile double x = 0.;
+        for (int i = 0; i < 20000; ++i) {
+            x += i * 0.5;
+        }
+        _nTasksDone->fetchAndAddOrdered(1);
+    }
+};
+
+// A task that splits its work in nChildren tasks and waits for them, as the multi-thread suite does
+class ForkJoinTask
+    : public QRunnable
+{
+    WorkStealingThreadPool* _pool;
+    int _nChildren;
+    QAtomicInt* _nTasksDone;
+
+public:
+
+    ForkJoinTask(WorkStealingThreadPool* pool,
+                 int nChildren,
+                 QAtomicInt* nTasksDone)
+    : QRunnable()
+    , _pool(pool)
+    , _nChildren(nChildren)
+    , _nTasksDone(nTasksDone)
+    {
+    }
+
+    virtual void run() OVERRIDE FINAL
+    {
+        QAtomicInt nChildrenDone;
+        for (int i = 0; i < _nChildren; ++i) {
+            _pool->start(new ComputeTask(&nChildrenDone), true);
+        }
+        while ( (int)nChildrenDone < _nChildren ) {
+            if ( !_pool->runPendingTaskWhileWaiting() ) {
+                QThread::yieldCurrentThread();
+            }
+        }
+        _nTasksDone->fetchAndAddOrdered(_nChildren + 1);
+    }
+};
+
+// A task that blocks until another task wakes it up
+class BlockingTask
+    : public QRunnable
+{
+    WorkStealingThreadPool* _pool;
+    QMutex* _mutex;
+    QWaitCondition* _cond;
+    bool* _woken;
+
+public:
+
+    BlockingTask(WorkStealingThreadPool* pool,
+                 QMutex* mutex,
+                 QWaitCondition* cond,
+                 bool* woken)
+    : QRunnable()
+    , _pool(pool)
+    , _mutex(mutex)
+    , _cond(cond)
+    , _woken(woken)
+    {
+    }
+
+    virtual void run() OVERRIDE FINAL
+    {
+        // Let the pool run the task that wakes us up
+        _pool->releaseThread();
+        {
+            QMutexLocker k(_mutex);
+            while (!*_woken) {
+                _cond->wait(_mutex);
+            }
+        }
+        _pool->reserveThread();
+    }
+};
+
+// Same as BlockingTask, but keeps its thread
+class WaitTask
+    : public QRunnable
+{
+    QMutex* _mutex;
+    QWaitCondition* _cond;
+    bool* _woken;
+
+public:
+
+    WaitTask(QMutex* mutex,
+             QWaitCondition* cond,
+             bool* woken)
+    : QRunnable()
+    , _mutex(mutex)
+    , _cond(cond)
+    , _woken(woken)
+    {
+    }
+
+    virtual void run() OVERRIDE FINAL
+    {
+        QMutexLocker k(_mutex);
+        while (!*_woken) {
+            _cond->wait(_mutex);
+        }
+    }
+};
+
+class WakeUpTask
+    : public QRunnable
+{
+    QMutex* _mutex;
+    QWaitCondition* _cond;
+    bool* _woken;
+
+public:
+
+    WakeUpTask(QMutex* mutex,
+               QWaitCondition* cond,
+               bool* woken)
+    : QRunnable()
+    , _mutex(mutex)
+    , _cond(cond)
+    , _woken(woken)
+    {
+    }
+
+    virtual void run() OVERRIDE FINAL
+    {
+        QMutexLocker k(_mutex);
+        *_woken = true;
+        _cond->wakeAll();
+    }
+};
+
+// Appends its index to a list shared by all tasks
+class RecordOrderTask
+    : public QRunnable
+{
+    QMutex* _mutex;
+    std::vector<int>* _order;
+    int _index;
+
+public:
+
+    RecordOrderTask(QMutex* mutex,
+                    std::vector<int>* order,
+                    int index)
+    : QRunnable()
+    , _mutex(mutex)
+    , _order(order)
+    , _index(index)
+    {
+    }
+
+    virtual void run() OVERRIDE FINAL
+    {
+        QMutexLocker k(_mutex);
+        _order->push_back(_index);
+    }
+};
+} // anon namespace
+
+TEST(WorkStealingThreadPool, RunsAllTasks)
+{
+    WorkStealingThreadPool pool(4);
+    QAtomicInt nTasksDone;
+    const int nTasks = 1000;
+
+    for (int i = 0; i < nTasks; ++i) {
+        pool.start(new ComputeTask(&nTasksDone), i % 2);
+    }
+    pool.waitForDone();
+    EXPECT_EQ(nTasks, (int)nTasksDone);
+    EXPECT_FALSE( pool.isCurrentThreadInPool() );
+
+    // The main thread is not part of the pool and may not run tasks
+    EXPECT_FALSE( pool.runPendingTaskWhileWaiting() );
+
+    WorkStealingThreadPool::Stats stats;
+    pool.getStats(&stats);
+    EXPECT_EQ( (U64)nTasks, stats.nTasksRun );
+    EXPECT_LE(stats.nThreads, 4);
+}
+
+TEST(WorkStealingThreadPool, NestedTasksWithASingleThread)
+{
+    // With a single thread, the parent task must run its children while waiting for them
+    WorkStealingThreadPool pool(1);
+    QAtomicInt nTasksDone;
+
+    pool.start( new ForkJoinTask(&pool, 16, &nTasksDone) );
+    pool.waitForDone();
+    EXPECT_EQ(17, (int)nTasksDone);
+
+    WorkStealingThreadPool::Stats stats;
+    pool.getStats(&stats);
+    EXPECT_EQ(1, stats.nThreads);
+    EXPECT_EQ( (U64)16, stats.nTasksRunWhileWaiting );
+}
+
+TEST(WorkStealingThreadPool, ReleaseThread)
+{
+    // The blocking task releases the only thread so that the pool can run the task that wakes it up
+    WorkStealingThreadPool pool(1);
+    QMutex mutex;
+    QWaitCondition cond;
+    bool woken = false;
+
+    pool.start( new BlockingTask(&pool, &mutex, &cond, &woken) );
+    pool.start( new WakeUpTask(&mutex, &cond, &woken) );
+    pool.waitForDone();
+    EXPECT_TRUE(woken);
+    EXPECT_EQ(0, pool.activeThreadCount());
+}
+
+TEST(WorkStealingThreadPool, Priorities)
+{
+    // The only thread is blocked while the tasks are queued, then runs them by increasing priority, in the order they were started
+    WorkStealingThreadPool pool(1);
+    QMutex mutex;
+    QWaitCondition cond;
+    bool woken = false;
+    QMutex orderMutex;
+    std::vector<int> order;
+    const int priorities[] = {2, 1, 2, 0, 1};
+
+    {
+        QMutexLocker k(&mutex);
+        pool.start( new WaitTask(&mutex, &cond, &woken) );
+        for (int i = 0; i < 5; ++i) {
+            pool.start(new RecordOrderTask(&orderMutex, &order, i), false, priorities[i]);
+        }
+        woken = true;
+        cond.wakeAll();
+    }
+    pool.waitForDone();
+
+    const int expectedOrder[] = {3, 1, 4, 0, 2};
+    ASSERT_EQ( 5, (int)order.size() );
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(expectedOrder[i], order[i]);
+    }
+}
+
+TEST(WorkStealingThreadPool, ForkJoinTasks)
+{
+    // Parents wait for their children on each thread count up to the number of cores
+    const int nForkJoinTasks = 64;
+    const int nChildren = 64;
+    const int nTasks = nForkJoinTasks * (nChildren + 1);
+    const int idealThreadCount = std::max(1, QThread::idealThreadCount());
+
+    for (int nThreads = 1; nThreads <= idealThreadCount; nThreads *= 2) {
+        QAtomicInt nTasksDone;
+        WorkStealingThreadPool::Stats stats;
+        {
+            WorkStealingThreadPool pool(nThreads);
+            for (int i = 0; i < nForkJoinTasks; ++i) {
+                pool.start( new ForkJoinTask(&pool, nChildren, &nTasksDone) );
+            }
+            pool.waitForDone();
+            pool.getStats(&stats);
+        }
+        EXPECT_EQ(nTasks, (int)nTasksDone);
+        EXPECT_EQ( (U64)nTasks, stats.nTasksRun );
+        EXPECT_LE(stats.nThreads, nThreads);
+        if (nThreads == 1) {
+            // Nothing to steal from
+            EXPECT_EQ( (U64)0, stats.nTasksStolen );
+        }
+    }
+}
@@ -0,0 +1,251 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <list>
+#include <map>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "Engine/RenderTaskScheduling.h"
+
+// These tests simulate the execution of render graphs with the two policies of TreeRenderQueueManager::launchMoreTasks():
+// starting the ready tasks in the order they became ready (FIFO), or in decreasing order of the estimated time left on
+// the longest path to the output (critical path). The task to start is chosen by the RenderTaskScheduling functions
+// that TreeRenderExecutionData::executeAvailableTasks() uses.
+
+NATRON_NAMESPACE_USING
+
+namespace {
+
+struct SimNode
+{
+    // Actual render time of the node
+    double cost;
+
+    // Render time estimated from previous renders, see Node::getEstimatedRenderTime()
+    double estimatedCost;
+
+    // Nodes that have this node as input
+    std::vector<int> outputs;
+    int nInputs;
+};
+
+typedef std::vector<SimNode> SimGraph;
+
+static int
+addNode(SimGraph& graph,
+        double cost)
+{
+    SimNode node;
+
+    node.cost = cost;
+    node.estimatedCost = cost;
+    node.nInputs = 0;
+    graph.push_back(node);
+
+    return (int)graph.size() - 1;
+}
+
+static void
+connect(SimGraph& graph,
+        int input,
+        int output)
+{
+    graph[input].outputs.push_back(output);
+    ++graph[output].nInputs;
+}
+
+static double
+randomDouble(double min,
+             double max)
+{
+    // coverity[dont_call]
+    return min + (max - min) * ( (double)rand() / RAND_MAX );
+}
+
+/**
+ * @brief Generates a graph that looks like a compositing project: nBranches branches of a reader followed by a few
+ * cheap nodes, merged two by two down to a single output. One branch contains a node much slower than all others
+ * (e.g: a defocus or a denoise). Estimated costs are off by up to 50% of the actual cost.
+ **/
+static SimGraph
+generateProjectGraph(int nBranches)
+{
+    SimGraph graph;
+    std::vector<int> branchOutputs;
+    // coverity[dont_call]
+    int slowBranch = rand() % nBranches;
+
+    for (int b = 0; b < nBranches; ++b) {
+        int prev = addNode( graph, randomDouble(0.5, 2.) );
+        // coverity[dont_call]
+        int nNodes = 1 + rand() % 5;
+        for (int i = 0; i < nNodes; ++i) {
+            double cost = (b == slowBranch && i == nNodes / 2) ? randomDouble(15., 30.) : randomDouble(0.2, 2.);
+            int node = addNode(graph, cost);
+            connect(graph, prev, node);
+            prev = node;
+        }
+        branchOutputs.push_back(prev);
+    }
+    while (branchOutputs.size() > 1) {
+        std::vector<int> merged;
+        for (std::size_t i = 0; i + 1 < branchOutputs.size(); i += 2) {
+            int merge = addNode( graph, randomDouble(0.5, 1.) );
+            connect(graph, branchOutputs[i], merge);
+            connect(graph, branchOutputs[i + 1], merge);
+            merged.push_back(merge);
+        }
+        if (branchOutputs.size() % 2) {
+            merged.push_back( branchOutputs.back() );
+        }
+        branchOutputs.swap(merged);
+    }
+    for (std::size_t i = 0; i < graph.size(); ++i) {
+        graph[i].estimatedCost = graph[i].cost * randomDouble(0.5, 1.5);
+    }
+
+    return graph;
+}
+
+// A SimGraph as seen by the RenderTaskScheduling functions, tasks being node indices
+class SimGraphScheduling
+{
+    const SimGraph& _graph;
+
+public:
+
+    SimGraphScheduling(const SimGraph& graph)
+    : _graph(graph)
+    {
+    }
+
+    double getEstimatedRenderTime(int node) const
+    {
+        return _graph[node].estimatedCost;
+    }
+
+    void getListeners(int node, std::list<int>* listeners) const
+    {
+        listeners->assign( _graph[node].outputs.begin(), _graph[node].outputs.end() );
+    }
+};
+
+/**
+ * @brief Returns the time needed to render the graph with nThreads threads.
+ **/
+static double
+simulateRender(const SimGraph& graph,
+               int nThreads,
+               bool criticalPathFirst)
+{
+    std::map<int, double> remainingPathCost;
+    std::vector<int> nInputsLeft( graph.size() );
+    std::vector<int> ready;
+
+    for (std::size_t i = 0; i < graph.size(); ++i) {
+        nInputsLeft[i] = graph[i].nInputs;
+        if (nInputsLeft[i] == 0) {
+            ready.push_back(i);
+        }
+    }
+
+    // The finish time of the node rendered by each busy thread
+    std::vector<std::pair<double, int> > running;
+    double time = 0.;
+    while ( !ready.empty() || !running.empty() ) {
+        while ( (int)running.size() < nThreads && !ready.empty() ) {
+            std::vector<int>::iterator toLaunch = ready.begin();
+            if (criticalPathFirst) {
+                toLaunch = RenderTaskScheduling::getMostCriticalTask(SimGraphScheduling(graph), ready.begin(), ready.end(), &remainingPathCost);
+            }
+            running.push_back( std::make_pair(time + graph[*toLaunch].cost, *toLaunch) );
+            ready.erase(toLaunch);
+        }
+
+        std::vector<std::pair<double, int> >::iterator finished = std::min_element( running.begin(), running.end() );
+        time = finished->first;
+        const SimNode& node = graph[finished->second];
+        running.erase(finished);
+        for (std::size_t i = 0; i < node.outputs.size(); ++i) {
+            if (--nInputsLeft[node.outputs[i]] == 0) {
+                ready.push_back(node.outputs[i]);
+            }
+        }
+    }
+
+    return time;
+}
+} // anon namespace
+
+TEST(TreeRenderScheduling, SlowBranchStartsFirst)
+{
+    // 4 cheap branches and a slow one, which becomes ready last, merged in a single output
+    SimGraph graph;
+    int output = addNode(graph, 1.);
+
+    for (int b = 0; b < 4; ++b) {
+        int reader = addNode(graph, 1.);
+        int grade = addNode(graph, 1.);
+        connect(graph, reader, grade);
+        connect(graph, grade, output);
+    }
+    int slowReader = addNode(graph, 1.);
+    int defocus = addNode(graph, 10.);
+    connect(graph, slowReader, defocus);
+    connect(graph, defocus, output);
+
+    double fifoTime = simulateRender(graph, 2, false);
+    double criticalPathTime = simulateRender(graph, 2, true);
+
+    // The defocus runs on one thread while the other thread renders all the cheap branches
+    EXPECT_EQ(12., criticalPathTime);
+    EXPECT_LT(criticalPathTime, fifoTime);
+}
+
+TEST(TreeRenderScheduling, ProjectGraphsMakespan)
+{
+    const int nGraphs = 200;
+    const int nThreadsCounts[] = {2, 4, 8, 16};
+
+    srand(2000);
+    std::vector<SimGraph> graphs;
+    for (int i = 0; i < nGraphs; ++i) {
+        // coverity[dont_call]
+        graphs.push_back( generateProjectGraph( 2 + rand() % 30 ) );
+    }
+
+    for (int t = 0; t < 4; ++t) {
+        double fifoTotal = 0., criticalPathTotal = 0.;
+        for (int i = 0; i < nGraphs; ++i) {
+            fifoTotal += simulateRender(graphs[i], nThreadsCounts[t], false);
+            criticalPathTotal += simulateRender(graphs[i], nThreadsCounts[t], true);
+        }
+        EXPECT_LE(criticalPathTotal, fifoTotal) << nThreadsCounts[t] << " threads";
+    }
+}
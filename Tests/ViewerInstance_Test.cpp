@@ -0,0 +1,281 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <gtest/gtest.h>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/thread/thread.hpp>
+#endif
+
+#include "Engine/Image.h"
+#include "Engine/ImageSIMD.h"
+#include "Engine/MultiThread.h"
+#include "Engine/ViewerInstance.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+
+const DisplayChannelsEnum allDisplayChannels[7] = {
+    eDisplayChannelsY, eDisplayChannelsRGB, eDisplayChannelsR, eDisplayChannelsG, eDisplayChannelsB, eDisplayChannelsA, eDisplayChannelsMatte
+};
+
+// Allocates a packed buffer of the given bit depth filled with random values and returns its description
+Image::CPUData
+makeRandomImage(const RectI& bounds,
+                int nComps,
+                ImageBitDepthEnum depth,
+                std::vector<float>* floatBuf,
+                std::vector<unsigned char>* byteBuf,
+                std::vector<unsigned short>* shortBuf)
+{
+    Image::CPUData data;
+    data.bounds = bounds;
+    data.nComps = nComps;
+    data.bitDepth = depth;
+
+    std::size_t nElements = bounds.area() * nComps;
+    switch (depth) {
+    case eImageBitDepthByte:
+        byteBuf->resize(nElements);
+        for (std::size_t i = 0; i < nElements; ++i) {
+            (*byteBuf)[i] = (unsigned char)(rand() & 0xff);
+        }
+        data.ptrs[0] = &(*byteBuf)[0];
+        break;
+    case eImageBitDepthShort:
+        shortBuf->resize(nElements);
+        for (std::size_t i = 0; i < nElements; ++i) {
+            (*shortBuf)[i] = (unsigned short)(rand() & 0xffff);
+        }
+        data.ptrs[0] = &(*shortBuf)[0];
+        break;
+    case eImageBitDepthFloat:
+    default:
+        // Also test values outside of the [0, 1] range
+        floatBuf->resize(nElements);
+        for (std::size_t i = 0; i < nElements; ++i) {
+            (*floatBuf)[i] = rand() / (float)RAND_MAX * 1.5f - 0.25f;
+        }
+        data.ptrs[0] = &(*floatBuf)[0];
+        break;
+    }
+
+    return data;
+}
+
+Image::CPUData
+makeBGRAImage(const RectI& bounds,
+              std::vector<unsigned int>* buf)
+{
+    buf->resize( bounds.area() );
+    std::fill(buf->begin(), buf->end(), 0u);
+
+    Image::CPUData data;
+    data.bounds = bounds;
+    data.nComps = 4;
+    data.bitDepth = eImageBitDepthByte;
+    data.ptrs[0] = &(*buf)[0];
+
+    return data;
+}
+
+// Returns the largest difference between two BGRA images on any channel
+int
+getMaxChannelDifference(const std::vector<unsigned int>& a,
+                        const std::vector<unsigned int>& b)
+{
+    int maxDiff = 0;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        for (int c = 0; c < 4; ++c) {
+            int va = (a[i] >> (8 * c)) & 0xff;
+            int vb = (b[i] >> (8 * c)) & 0xff;
+            maxDiff = std::max(maxDiff, std::abs(va - vb));
+        }
+    }
+
+    return maxDiff;
+}
+
+// Processes a band of scan-lines of a frame, as each thread of the ViewerProcessor does
+class ViewerProcessThread
+{
+    Image::CPUData _colorImage, _dstImage;
+    bool _orderedDithering;
+    RectI _roi;
+
+public:
+
+    ViewerProcessThread(const Image::CPUData& colorImage,
+                        const Image::CPUData& dstImage,
+                        bool orderedDithering,
+                        const RectI& roi)
+        : _colorImage(colorImage)
+        , _dstImage(dstImage)
+        , _orderedDithering(orderedDithering)
+        , _roi(roi)
+    {
+    }
+
+    void operator()()
+    {
+        ActionRetCodeEnum stat = ViewerInstance::applyViewerProcess(_colorImage, _colorImage, 3, eDisplayChannelsRGB, 1., 1., 0.,
+                                                                    eViewerColorSpaceLinear, eViewerColorSpaceSRGB, _orderedDithering,
+                                                                    _dstImage, _roi);
+        EXPECT_EQ(eActionStatusOK, stat);
+    }
+};
+
+// Processes a frame split in bands of scan-lines, one per thread
+void
+runViewerProcess(const Image::CPUData& colorImage,
+                 const Image::CPUData& dstImage,
+                 bool orderedDithering,
+                 int nThreads)
+{
+    const RectI& bounds = colorImage.bounds;
+    boost::thread_group threads;
+    for (int t = 0; t < nThreads; ++t) {
+        RectI roi = bounds;
+        ImageMultiThreadProcessorBase::getThreadRange(t, nThreads, bounds.y1, bounds.y2, &roi.y1, &roi.y2);
+        if (roi.y2 > roi.y1) {
+            threads.create_thread( ViewerProcessThread(colorImage, dstImage, orderedDithering, roi) );
+        }
+    }
+    threads.join_all();
+}
+
+} // anon namespace
+
+// Check that the scan-line viewer process gives exactly the same results as the per-pixel one,
+// for all bit depths, components, display channels and color-spaces
+TEST(ViewerInstance, ViewerProcessSIMDMatchesScalar) {
+    const ImageBitDepthEnum depths[3] = {eImageBitDepthByte, eImageBitDepthShort, eImageBitDepthFloat};
+    const double gammas[3] = {1., 0.45, 0.};
+
+    // Odd width larger than NATRON_IMAGE_SIMD_CHUNK_SIZE and a negative origin to test the dither coordinates
+    const RectI bounds(-37, 5, 263, 12);
+
+    srand(2000);
+
+    for (int i = 0; i < 3; ++i) {
+        for (int nComps = 1; nComps <= 4; ++nComps) {
+            std::vector<float> floatBuf;
+            std::vector<unsigned char> byteBuf;
+            std::vector<unsigned short> shortBuf;
+            Image::CPUData colorImage = makeRandomImage(bounds, nComps, depths[i], &floatBuf, &byteBuf, &shortBuf);
+            ViewerColorSpaceEnum srcColorspace = depths[i] == eImageBitDepthFloat ? eViewerColorSpaceLinear : eViewerColorSpaceSRGB;
+
+            std::vector<unsigned int> scalarBuf, simdBuf;
+            Image::CPUData scalarDst = makeBGRAImage(bounds, &scalarBuf);
+            Image::CPUData simdDst = makeBGRAImage(bounds, &simdBuf);
+
+            for (int c = 0; c < 7; ++c) {
+                for (int dstColorspace = eViewerColorSpaceLinear; dstColorspace <= eViewerColorSpaceSRGB; ++dstColorspace) {
+                    for (int g = 0; g < 3; ++g) {
+                        ImageSIMD::setEnabled(false);
+                        EXPECT_EQ(eActionStatusOK, ViewerInstance::applyViewerProcess(colorImage, colorImage, nComps - 1, allDisplayChannels[c], gammas[g], 1.7, 0.01,
+                                                                                      srcColorspace, (ViewerColorSpaceEnum)dstColorspace, true, scalarDst, bounds));
+                        ImageSIMD::setEnabled(true);
+                        EXPECT_EQ(eActionStatusOK, ViewerInstance::applyViewerProcess(colorImage, colorImage, nComps - 1, allDisplayChannels[c], gammas[g], 1.7, 0.01,
+                                                                                      srcColorspace, (ViewerColorSpaceEnum)dstColorspace, true, simdDst, bounds));
+
+                        EXPECT_TRUE(std::memcmp(&scalarBuf[0], &simdBuf[0], scalarBuf.size() * sizeof(unsigned int)) == 0)
+                            << "bit depth " << depths[i] << ", " << nComps << " components, channels " << allDisplayChannels[c]
+                            << ", color-space " << dstColorspace << ", gamma " << gammas[g];
+                    }
+                }
+            }
+        }
+    }
+} // TEST(ViewerInstance, ViewerProcessSIMDMatchesScalar)
+
+// Both dithering methods round each value either up or down: they may only differ by one
+TEST(ViewerInstance, OrderedDitheringMatchesErrorDiffusion) {
+    const RectI bounds(0, 0, 517, 31);
+
+    srand(2000);
+
+    std::vector<float> floatBuf;
+    std::vector<unsigned char> byteBuf;
+    std::vector<unsigned short> shortBuf;
+    Image::CPUData colorImage = makeRandomImage(bounds, 4, eImageBitDepthFloat, &floatBuf, &byteBuf, &shortBuf);
+
+    std::vector<unsigned int> orderedBuf, errorDiffusionBuf;
+    Image::CPUData orderedDst = makeBGRAImage(bounds, &orderedBuf);
+    Image::CPUData errorDiffusionDst = makeBGRAImage(bounds, &errorDiffusionBuf);
+
+    for (int c = 0; c < 7; ++c) {
+        EXPECT_EQ(eActionStatusOK, ViewerInstance::applyViewerProcess(colorImage, colorImage, 3, allDisplayChannels[c], 1., 1., 0.,
+                                                                      eViewerColorSpaceLinear, eViewerColorSpaceSRGB, true, orderedDst, bounds));
+        EXPECT_EQ(eActionStatusOK, ViewerInstance::applyViewerProcess(colorImage, colorImage, 3, allDisplayChannels[c], 1., 1., 0.,
+                                                                      eViewerColorSpaceLinear, eViewerColorSpaceSRGB, false, errorDiffusionDst, bounds));
+        EXPECT_LE(getMaxChannelDifference(orderedBuf, errorDiffusionBuf), 1) << "channels " << allDisplayChannels[c];
+    }
+}
+
+// The ordered dither only depends on the pixel coordinates: splitting a frame in bands of scan-lines processed
+// by several threads must give exactly the same result as processing it at once
+TEST(ViewerInstance, OrderedDitheringIndependentOfThreads) {
+    const RectI bounds(0, 0, 517, 131);
+
+    // A smooth image, as the look-up tables access pattern depends on it
+    std::vector<float> floatBuf(bounds.area() * 4);
+    for (int y = 0; y < bounds.height(); ++y) {
+        for (int x = 0; x < bounds.width(); ++x) {
+            float* pix = &floatBuf[( (std::size_t)y * bounds.width() + x ) * 4];
+            for (int c = 0; c < 4; ++c) {
+                pix[c] = 0.5f + 0.5f * std::sin(x * 0.01f + c) * std::cos(y * 0.013f);
+            }
+        }
+    }
+    Image::CPUData colorImage;
+    colorImage.bounds = bounds;
+    colorImage.nComps = 4;
+    colorImage.bitDepth = eImageBitDepthFloat;
+    colorImage.ptrs[0] = &floatBuf[0];
+
+    std::vector<unsigned int> singlePassBuf;
+    Image::CPUData singlePassDst = makeBGRAImage(bounds, &singlePassBuf);
+    ImageSIMD::setEnabled(true);
+    runViewerProcess(colorImage, singlePassDst, true, 1);
+
+    int maxThreads = std::max(2, (int)boost::thread::hardware_concurrency());
+    for (int nThreads = 2; nThreads <= maxThreads; nThreads *= 2) {
+        for (int simd = 0; simd < 2; ++simd) {
+            ImageSIMD::setEnabled(simd);
+            std::vector<unsigned int> bandsBuf;
+            Image::CPUData bandsDst = makeBGRAImage(bounds, &bandsBuf);
+            runViewerProcess(colorImage, bandsDst, true, nThreads);
+            EXPECT_TRUE(singlePassBuf == bandsBuf) << nThreads << " threads, " << (simd ? "scan-lines" : "per pixel");
+        }
+    }
+} // TEST(ViewerInstance, OrderedDitheringIndependentOfThreads)
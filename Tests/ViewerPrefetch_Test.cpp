@@ -0,0 +1,133 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2013-2018 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "Global/Macros.h"
+
+#include <list>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "Engine/ViewerPrefetchScheduler.h"
+
+NATRON_NAMESPACE_USING
+
+namespace {
+
+static void
+addRequest(std::list<ViewerPrefetchScheduler::FrameRequest>* history,
+           double frame,
+           double timestamp)
+{
+    ViewerPrefetchScheduler::FrameRequest request;
+
+    request.frame = TimeValue(frame);
+    request.timestamp = timestamp;
+    history->push_back(request);
+}
+
+static void
+expectFrames(const std::vector<TimeValue>& frames,
+             const int* expected,
+             int nExpected)
+{
+    ASSERT_EQ( nExpected, (int)frames.size() );
+    for (int i = 0; i < nExpected; ++i) {
+        EXPECT_EQ(expected[i], (int)frames[i]);
+    }
+}
+} // anon namespace
+
+TEST(ViewerPrefetch, ScrubDirection)
+{
+    std::list<ViewerPrefetchScheduler::FrameRequest> history;
+    int direction, step;
+
+    // A single request does not tell anything
+    addRequest(&history, 10, 0.);
+    EXPECT_FALSE( ViewerPrefetchScheduler::getScrubDirection(history, 0.1, 0.5, &direction, &step) );
+
+    // Scrubbing backward, displaying every third frame
+    addRequest(&history, 7, 0.1);
+    addRequest(&history, 4, 0.2);
+    ASSERT_TRUE( ViewerPrefetchScheduler::getScrubDirection(history, 0.25, 0.5, &direction, &step) );
+    EXPECT_EQ(-1, direction);
+    EXPECT_EQ(3, step);
+
+    // Requests older than the window are ignored
+    EXPECT_FALSE( ViewerPrefetchScheduler::getScrubDirection(history, 2., 0.5, &direction, &step) );
+
+    // Parameter changes at the same frame: no motion
+    history.clear();
+    addRequest(&history, 5, 0.);
+    addRequest(&history, 5, 0.1);
+    ASSERT_TRUE( ViewerPrefetchScheduler::getScrubDirection(history, 0.1, 0.5, &direction, &step) );
+    EXPECT_EQ(0, direction);
+}
+
+TEST(ViewerPrefetch, PredictFrames)
+{
+    std::vector<TimeValue> frames;
+
+    // Around the current frame, within the in/out points
+    ViewerPrefetchScheduler::predictFrames(TimeValue(2), 0, 1, 1, 10, ePlaybackModeLoop, 5, &frames);
+    {
+        const int expected[] = {3, 1, 4, 5, 6};
+        expectFrames(frames, expected, 5);
+    }
+
+    // Forward playback wraps around the out point in loop mode
+    ViewerPrefetchScheduler::predictFrames(TimeValue(9), 1, 1, 1, 10, ePlaybackModeLoop, 4, &frames);
+    {
+        const int expected[] = {10, 1, 2, 3};
+        expectFrames(frames, expected, 4);
+    }
+
+    // ...bounces in bounce mode
+    ViewerPrefetchScheduler::predictFrames(TimeValue(9), 1, 1, 1, 10, ePlaybackModeBounce, 3, &frames);
+    {
+        const int expected[] = {10, 8, 7};
+        expectFrames(frames, expected, 3);
+    }
+
+    // ...and stops in once mode
+    ViewerPrefetchScheduler::predictFrames(TimeValue(9), 1, 1, 1, 10, ePlaybackModeOnce, 4, &frames);
+    {
+        const int expected[] = {10};
+        expectFrames(frames, expected, 1);
+    }
+
+    // Fast backward scrub
+    ViewerPrefetchScheduler::predictFrames(TimeValue(50), -1, 5, 1, 100, ePlaybackModeLoop, 3, &frames);
+    {
+        const int expected[] = {45, 40, 35};
+        expectFrames(frames, expected, 3);
+    }
+
+    // A range of a few frames never returns the same frame twice
+    ViewerPrefetchScheduler::predictFrames(TimeValue(1), 1, 1, 1, 3, ePlaybackModeLoop, 10, &frames);
+    {
+        const int expected[] = {2, 3};
+        expectFrames(frames, expected, 2);
+    }
+}
@@ -120,6 +120,12 @@ enable-cairo {
     DEFINES += ROTO_SHAPE_RENDER_ENABLE_CAIRO
 }
 
+disable-render-trace {
+    # Compiles out the trace points of the render timeline (see Engine/RenderTracer.h).
+    # When not specified, the trace points only cost an atomic read unless recording is enabled.
+    DEFINES += NATRON_DISABLE_RENDER_TRACE
+}
+
 CONFIG(noassertions) {
 #See http://doc.qt.io/qt-4.8/debug.html
    DEFINES *= NDEBUG QT_NO_DEBUG QT_NO_DEBUG_OUTPUT QT_NO_WARNING_OUTPUT